@@ -0,0 +1,138 @@
+/**
+ * @file ai_audio_encoder.h
+ * @brief Encoder stage between the microphone pcm and the AI audio uplink.
+ *
+ * The agent hands every uploaded pcm chunk to this stage. It cuts the stream
+ * into fixed frames and runs them through the selected encoder. PCM (pass
+ * through, no copy) and IMA ADPCM (DVI4, RFC 3551) are built in, other
+ * codecs such as Opus are plugged in with ai_audio_encoder_register().
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __AI_AUDIO_ENCODER_H__
+#define __AI_AUDIO_ENCODER_H__
+
+#include "tuya_cloud_types.h"
+#include "tuya_ai_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+// codec used for the uplink, AUDIO_CODEC_PCM / AUDIO_CODEC_ADPCM / a registered one
+#ifndef AI_AUDIO_ENCODER_CODEC
+#define AI_AUDIO_ENCODER_CODEC AUDIO_CODEC_PCM
+#endif
+
+// frame length handed to the encoder
+#ifndef AI_AUDIO_ENCODER_FRAME_MS
+#define AI_AUDIO_ENCODER_FRAME_MS 20
+#endif
+
+// target bitrate in bit/s, only used by encoders with a rate control (opus)
+#ifndef AI_AUDIO_ENCODER_BITRATE
+#define AI_AUDIO_ENCODER_BITRATE 24000
+#endif
+
+#define AI_AUDIO_ENCODER_MAX_NUM 4
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    uint32_t sample_rate;
+    uint8_t channels;
+    uint8_t bit_depth; // only 16 bit pcm is supported
+    uint32_t frame_ms;
+    uint32_t bitrate;
+} AI_AUDIO_ENCODER_CFG_T;
+
+typedef struct {
+    const char *name;
+    AI_AUDIO_CODEC_TYPE codec_type;
+    OPERATE_RET (*open)(AI_AUDIO_ENCODER_CFG_T *cfg, void **ctx);
+    // worst case output bytes of one frame
+    uint32_t (*frame_max_len)(void *ctx, uint32_t samples);
+    // encode one frame of samples (all channels interleaved), pcm is always int16_t aligned
+    OPERATE_RET (*encode)(void *ctx, const int16_t *pcm, uint32_t samples, uint8_t *out, uint32_t *out_len);
+    // start a new stream
+    void (*reset)(void *ctx);
+    void (*close)(void *ctx);
+} AI_AUDIO_ENCODER_T;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t in_bytes;
+    uint32_t out_bytes;
+} AI_AUDIO_ENCODER_STAT_T;
+
+/***********************************************************
+********************function declaration********************
+***********************************************************/
+/**
+ * @brief Registers an encoder, must be called before ai_audio_encoder_open.
+ * @param encoder Encoder description, has to stay valid while registered.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_encoder_register(const AI_AUDIO_ENCODER_T *encoder);
+
+/**
+ * @brief Opens the encoder for a codec, falls back to PCM if it is not registered.
+ * @param codec_type AUDIO_CODEC_XXX of the encoder to use.
+ * @param cfg Pcm format, frame length and bitrate.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_encoder_open(AI_AUDIO_CODEC_TYPE codec_type, AI_AUDIO_ENCODER_CFG_T *cfg);
+
+/**
+ * @brief Closes the encoder and frees its buffers.
+ * @param None
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_encoder_close(void);
+
+/**
+ * @brief Drops buffered samples and the encoder state for a new stream.
+ * @param None
+ * @return None
+ */
+void ai_audio_encoder_reset(void);
+
+/**
+ * @brief Gets the codec type put into the uplink audio attribute.
+ * @param None
+ * @return AI_AUDIO_CODEC_TYPE - codec of the opened encoder, AUDIO_CODEC_PCM if none.
+ */
+AI_AUDIO_CODEC_TYPE ai_audio_encoder_get_codec(void);
+
+/**
+ * @brief Encodes a pcm chunk.
+ *
+ * Samples that do not fill a whole frame are kept for the next call, flush
+ * encodes them padded with silence. With PCM the input is returned as is.
+ *
+ * @param pcm 16 bit pcm, may be NULL when flushing.
+ * @param len Length of pcm in bytes.
+ * @param flush Encode the buffered tail, set at the end of the stream.
+ * @param out Encoded data, owned by the encoder and valid until the next call.
+ * @param out_len Length of the encoded data, 0 if no frame was completed.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_encoder_encode(uint8_t *pcm, uint32_t len, bool flush, uint8_t **out, uint32_t *out_len);
+
+/**
+ * @brief Gets the counters since the encoder was opened.
+ * @param stat Output counters.
+ * @return None
+ */
+void ai_audio_encoder_get_stat(AI_AUDIO_ENCODER_STAT_T *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __AI_AUDIO_ENCODER_H__ */
@@ -23,6 +23,7 @@
 
 #include "ai_audio.h"
 #include "ai_audio_debug.h"
+#include "ai_audio_encoder.h"
 
 /***********************************************************
 ************************macro define************************
@@ -39,6 +40,9 @@
 #define TY_AI_CHAT_ID_US_AUDIO 2
 #define TY_AI_CHAT_ID_US_TEXT  4
 
+#define AI_AGENT_AUDIO_SAMPLE_RATE 16000
+#define AI_AGENT_AUDIO_BIT_DEPTH   16
+
 /***********************************************************
 ***********************typedef define***********************
 ***********************************************************/
@@ -483,6 +487,15 @@ OPERATE_RET ai_audio_agent_init(AI_AGENT_CBS_T *cbs)
         memcpy(&sg_ai.cbs, cbs, sizeof(AI_AGENT_CBS_T));
     }
 
+    AI_AUDIO_ENCODER_CFG_T enc_cfg = {
+        .sample_rate = AI_AGENT_AUDIO_SAMPLE_RATE,
+        .channels = AUDIO_CHANNELS_MONO,
+        .bit_depth = AI_AGENT_AUDIO_BIT_DEPTH,
+        .frame_ms = AI_AUDIO_ENCODER_FRAME_MS,
+        .bitrate = AI_AUDIO_ENCODER_BITRATE,
+    };
+    TUYA_CALL_ERR_RETURN(ai_audio_encoder_open(AI_AUDIO_ENCODER_CODEC, &enc_cfg));
+
     PR_DEBUG("ai session wait for mqtt connected...");
 
     tal_event_subscribe(EVENT_MQTT_CONNECTED, "ai_agent_init", __ai_agent_init, SUBSCRIBE_TYPE_ONETIME);
@@ -533,35 +546,23 @@ OPERATE_RET ai_audio_agent_upload_start(uint8_t enable_vad)
     }
 
     sg_ai.is_audio_upload_first_frame = true;
+    ai_audio_encoder_reset();
     PR_DEBUG("upload start event_id:%s", sg_ai.event_id);
 
     return rt;
 }
 
-/**
- * @brief Uploads audio data to the AI service.
- * @param data Pointer to the audio data buffer.
- * @param len Length of the audio data in bytes.
- * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
- */
-OPERATE_RET ai_audio_agent_upload_data(uint8_t *data, uint32_t len)
+static OPERATE_RET __ai_agent_upload_pkt(AI_STREAM_TYPE stream_flag, uint8_t *data, uint32_t len)
 {
-    OPERATE_RET rt = OPRT_OK;
-
-#if defined(AI_AUDIO_DEBUG) && (AI_AUDIO_DEBUG == 1)
-    ai_audio_debug_data((char *)data, len);
-#endif
-
-    // send data use tuya_ai_send_biz_pkt, pcm
     AI_BIZ_ATTR_INFO_T attr = {
         .flag = AI_HAS_ATTR,
         .type = AI_PT_AUDIO,
         .value.audio =
             {
-                .base.codec_type = AUDIO_CODEC_PCM,
-                .base.sample_rate = 16000,
+                .base.codec_type = ai_audio_encoder_get_codec(),
+                .base.sample_rate = AI_AGENT_AUDIO_SAMPLE_RATE,
                 .base.channels = AUDIO_CHANNELS_MONO,
-                .base.bit_depth = 16,
+                .base.bit_depth = AI_AGENT_AUDIO_BIT_DEPTH,
                 .option.user_len = 0,
                 .option.user_data = NULL,
                 .option.session_id_list = NULL,
@@ -573,22 +574,49 @@ OPERATE_RET ai_audio_agent_upload_data(uint8_t *data, uint32_t len)
                 .timestamp = tal_system_get_millisecond(),
                 .pts = 0,
             },
+        .stream_flag = stream_flag,
         .len = len,
     };
 
-    if (sg_ai.is_audio_upload_first_frame) {
-        head.stream_flag = AI_STREAM_START;
+    PR_DEBUG("tuya ai upload data[%d][%d]...", head.stream_flag, len);
+
+    return tuya_ai_send_biz_pkt(TY_AI_CHAT_ID_DS_AUDIO, &attr, AI_PT_AUDIO, &head, (char *)data);
+}
+
+/**
+ * @brief Uploads audio data to the AI service.
+ * @param data Pointer to the audio data buffer.
+ * @param len Length of the audio data in bytes.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_agent_upload_data(uint8_t *data, uint32_t len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t *enc_data = NULL;
+    uint32_t enc_len = 0;
+
+#if defined(AI_AUDIO_DEBUG) && (AI_AUDIO_DEBUG == 1)
+    ai_audio_debug_data((char *)data, len);
+#endif
+
+    // pcm is framed and encoded here, NULL data flushes the last partial frame
+    TUYA_CALL_ERR_RETURN(ai_audio_encoder_encode(data, len, (NULL == data), &enc_data, &enc_len));
+
+    // nothing goes up until the first whole frame is encoded
+    if (enc_len) {
+        AI_STREAM_TYPE stream_flag = sg_ai.is_audio_upload_first_frame ? AI_STREAM_START : AI_STREAM_ING;
         sg_ai.is_audio_upload_first_frame = false;
-    } else if (NULL == data) {
-        head.stream_flag = AI_STREAM_END;
-        sg_ai.is_audio_upload_first_frame = true;
-    } else {
-        head.stream_flag = AI_STREAM_ING;
+        TUYA_CALL_ERR_RETURN(__ai_agent_upload_pkt(stream_flag, enc_data, enc_len));
     }
 
-    PR_DEBUG("tuya ai upload data[%d][%d]...", head.stream_flag, len);
-
-    TUYA_CALL_ERR_RETURN(tuya_ai_send_biz_pkt(TY_AI_CHAT_ID_DS_AUDIO, &attr, AI_PT_AUDIO, &head, (char *)data));
+    if (NULL == data) {
+        // an empty stream still opens and closes on the cloud side
+        if (sg_ai.is_audio_upload_first_frame) {
+            TUYA_CALL_ERR_RETURN(__ai_agent_upload_pkt(AI_STREAM_START, NULL, 0));
+        }
+        sg_ai.is_audio_upload_first_frame = true;
+        TUYA_CALL_ERR_RETURN(__ai_agent_upload_pkt(AI_STREAM_END, NULL, 0));
+    }
 
     return rt;
 }
@@ -0,0 +1,446 @@
+/**
+ * @file ai_audio_encoder.c
+ * @brief Implements the encoder stage of the AI audio uplink.
+ *
+ * This file keeps the encoder registry, cuts the pcm stream into frames and
+ * provides the built in PCM and IMA ADPCM encoders. The ADPCM frames use the
+ * DVI4 block layout of RFC 3551: predicted value (16 bit, msb first), step
+ * index, one reserved byte, then 4 bit codes with the first sample in the
+ * high nibble. Every frame carries its own state and decodes on its own.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tal_api.h"
+
+#include "ai_audio_encoder.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define ADPCM_HEAD_LEN  4
+#define ADPCM_INDEX_MAX 88
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    int32_t predicted;
+    int32_t index;
+} AI_ADPCM_STATE_T;
+
+typedef struct {
+    const AI_AUDIO_ENCODER_T *encoder;
+    void *ctx;
+    AI_AUDIO_ENCODER_CFG_T cfg;
+    uint32_t frame_samples;
+    uint32_t frame_bytes;
+    uint8_t *pending; // head of a frame not completed by the last chunk
+    uint32_t pending_len;
+    uint8_t *out_buf;
+    uint32_t out_size;
+    AI_AUDIO_ENCODER_STAT_T stat;
+} AI_AUDIO_ENCODER_MNG_T;
+
+/***********************************************************
+***********************const declaration********************
+***********************************************************/
+static const int16_t sg_adpcm_step_table[ADPCM_INDEX_MAX + 1] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t sg_adpcm_index_table[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static AI_AUDIO_ENCODER_MNG_T sg_encoder = {0};
+static const AI_AUDIO_ENCODER_T *sg_encoder_list[AI_AUDIO_ENCODER_MAX_NUM] = {0};
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint32_t __pcm_frame_max_len(void *ctx, uint32_t samples)
+{
+    return samples * sizeof(int16_t);
+}
+
+static OPERATE_RET __pcm_encode(void *ctx, const int16_t *pcm, uint32_t samples, uint8_t *out, uint32_t *out_len)
+{
+    memcpy(out, pcm, samples * sizeof(int16_t));
+    *out_len = samples * sizeof(int16_t);
+    return OPRT_OK;
+}
+
+static OPERATE_RET __adpcm_open(AI_AUDIO_ENCODER_CFG_T *cfg, void **ctx)
+{
+    if (cfg->channels != 1) {
+        PR_ERR("adpcm only supports mono, channels:%d", cfg->channels);
+        return OPRT_NOT_SUPPORTED;
+    }
+
+    AI_ADPCM_STATE_T *state = tal_malloc(sizeof(AI_ADPCM_STATE_T));
+    TUYA_CHECK_NULL_RETURN(state, OPRT_MALLOC_FAILED);
+    memset(state, 0, sizeof(AI_ADPCM_STATE_T));
+    *ctx = state;
+
+    return OPRT_OK;
+}
+
+static uint32_t __adpcm_frame_max_len(void *ctx, uint32_t samples)
+{
+    return ADPCM_HEAD_LEN + (samples + 1) / 2;
+}
+
+static OPERATE_RET __adpcm_encode(void *ctx, const int16_t *pcm, uint32_t samples, uint8_t *out, uint32_t *out_len)
+{
+    AI_ADPCM_STATE_T *state = (AI_ADPCM_STATE_T *)ctx;
+    int32_t predicted = state->predicted;
+    int32_t index = state->index;
+    uint8_t *p = out + ADPCM_HEAD_LEN;
+    uint32_t i = 0;
+
+    out[0] = (uint8_t)((predicted >> 8) & 0xFF);
+    out[1] = (uint8_t)(predicted & 0xFF);
+    out[2] = (uint8_t)index;
+    out[3] = 0;
+
+    for (i = 0; i < samples; i++) {
+        int32_t step = sg_adpcm_step_table[index];
+        int32_t diff = pcm[i] - predicted;
+        int32_t vpdiff = step >> 3;
+        uint8_t code = 0;
+
+        if (diff < 0) {
+            code = 8;
+            diff = -diff;
+        }
+        if (diff >= step) {
+            code |= 4;
+            diff -= step;
+            vpdiff += step;
+        }
+        step >>= 1;
+        if (diff >= step) {
+            code |= 2;
+            diff -= step;
+            vpdiff += step;
+        }
+        step >>= 1;
+        if (diff >= step) {
+            code |= 1;
+            vpdiff += step;
+        }
+
+        predicted += (code & 8) ? -vpdiff : vpdiff;
+        if (predicted > 32767) {
+            predicted = 32767;
+        } else if (predicted < -32768) {
+            predicted = -32768;
+        }
+        index += sg_adpcm_index_table[code];
+        if (index < 0) {
+            index = 0;
+        } else if (index > ADPCM_INDEX_MAX) {
+            index = ADPCM_INDEX_MAX;
+        }
+
+        if (0 == (i & 1)) {
+            *p = (uint8_t)(code << 4);
+        } else {
+            *p++ |= code;
+        }
+    }
+
+    state->predicted = predicted;
+    state->index = index;
+    *out_len = ADPCM_HEAD_LEN + (samples + 1) / 2;
+
+    return OPRT_OK;
+}
+
+static void __adpcm_reset(void *ctx)
+{
+    memset(ctx, 0, sizeof(AI_ADPCM_STATE_T));
+}
+
+static void __adpcm_close(void *ctx)
+{
+    tal_free(ctx);
+}
+
+static const AI_AUDIO_ENCODER_T sg_pcm_encoder = {
+    .name = "pcm",
+    .codec_type = AUDIO_CODEC_PCM,
+    .frame_max_len = __pcm_frame_max_len,
+    .encode = __pcm_encode,
+};
+
+static const AI_AUDIO_ENCODER_T sg_adpcm_encoder = {
+    .name = "adpcm",
+    .codec_type = AUDIO_CODEC_ADPCM,
+    .open = __adpcm_open,
+    .frame_max_len = __adpcm_frame_max_len,
+    .encode = __adpcm_encode,
+    .reset = __adpcm_reset,
+    .close = __adpcm_close,
+};
+
+static const AI_AUDIO_ENCODER_T *__encoder_find(AI_AUDIO_CODEC_TYPE codec_type)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < AI_AUDIO_ENCODER_MAX_NUM; i++) {
+        if (sg_encoder_list[i] && sg_encoder_list[i]->codec_type == codec_type) {
+            return sg_encoder_list[i];
+        }
+    }
+
+    if (codec_type == AUDIO_CODEC_ADPCM) {
+        return &sg_adpcm_encoder;
+    } else if (codec_type == AUDIO_CODEC_PCM) {
+        return &sg_pcm_encoder;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Registers an encoder, must be called before ai_audio_encoder_open.
+ * @param encoder Encoder description, has to stay valid while registered.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_encoder_register(const AI_AUDIO_ENCODER_T *encoder)
+{
+    uint32_t i = 0;
+
+    if (NULL == encoder || NULL == encoder->encode || NULL == encoder->frame_max_len) {
+        return OPRT_INVALID_PARM;
+    }
+
+    for (i = 0; i < AI_AUDIO_ENCODER_MAX_NUM; i++) {
+        if (NULL == sg_encoder_list[i] || sg_encoder_list[i]->codec_type == encoder->codec_type) {
+            sg_encoder_list[i] = encoder;
+            PR_DEBUG("audio encoder %s registered", encoder->name);
+            return OPRT_OK;
+        }
+    }
+
+    PR_ERR("audio encoder list is full");
+    return OPRT_EXCEED_UPPER_LIMIT;
+}
+
+/**
+ * @brief Opens the encoder for a codec, falls back to PCM if it is not registered.
+ * @param codec_type AUDIO_CODEC_XXX of the encoder to use.
+ * @param cfg Pcm format, frame length and bitrate.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_encoder_open(AI_AUDIO_CODEC_TYPE codec_type, AI_AUDIO_ENCODER_CFG_T *cfg)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    TUYA_CHECK_NULL_RETURN(cfg, OPRT_INVALID_PARM);
+    if (cfg->bit_depth != 16 || 0 == cfg->channels || 0 == cfg->frame_ms) {
+        PR_ERR("audio encoder cfg not supported, bit depth:%d, channels:%d", cfg->bit_depth, cfg->channels);
+        return OPRT_NOT_SUPPORTED;
+    }
+
+    ai_audio_encoder_close();
+
+    const AI_AUDIO_ENCODER_T *encoder = __encoder_find(codec_type);
+    if (NULL == encoder) {
+        PR_WARN("audio encoder %d not registered, use pcm", codec_type);
+        encoder = &sg_pcm_encoder;
+    }
+
+    memcpy(&sg_encoder.cfg, cfg, sizeof(AI_AUDIO_ENCODER_CFG_T));
+    sg_encoder.frame_samples = cfg->sample_rate * cfg->frame_ms / 1000 * cfg->channels;
+    sg_encoder.frame_bytes = sg_encoder.frame_samples * sizeof(int16_t);
+
+    if (encoder->open) {
+        TUYA_CALL_ERR_RETURN(encoder->open(&sg_encoder.cfg, &sg_encoder.ctx));
+    }
+    sg_encoder.encoder = encoder;
+
+    if (encoder != &sg_pcm_encoder) {
+        sg_encoder.pending = tal_malloc(sg_encoder.frame_bytes);
+        if (NULL == sg_encoder.pending) {
+            ai_audio_encoder_close();
+            return OPRT_MALLOC_FAILED;
+        }
+    }
+
+    PR_NOTICE("audio encoder %s open, frame %d ms, bitrate %d", encoder->name, cfg->frame_ms, cfg->bitrate);
+    return rt;
+}
+
+/**
+ * @brief Closes the encoder and frees its buffers.
+ * @param None
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_encoder_close(void)
+{
+    if (sg_encoder.encoder && sg_encoder.encoder->close && sg_encoder.ctx) {
+        sg_encoder.encoder->close(sg_encoder.ctx);
+    }
+    if (sg_encoder.pending) {
+        tal_free(sg_encoder.pending);
+    }
+    if (sg_encoder.out_buf) {
+        tal_free(sg_encoder.out_buf);
+    }
+    memset(&sg_encoder, 0, sizeof(AI_AUDIO_ENCODER_MNG_T));
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Drops buffered samples and the encoder state for a new stream.
+ * @param None
+ * @return None
+ */
+void ai_audio_encoder_reset(void)
+{
+    sg_encoder.pending_len = 0;
+    if (sg_encoder.encoder && sg_encoder.encoder->reset && sg_encoder.ctx) {
+        sg_encoder.encoder->reset(sg_encoder.ctx);
+    }
+}
+
+/**
+ * @brief Gets the codec type put into the uplink audio attribute.
+ * @param None
+ * @return AI_AUDIO_CODEC_TYPE - codec of the opened encoder, AUDIO_CODEC_PCM if none.
+ */
+AI_AUDIO_CODEC_TYPE ai_audio_encoder_get_codec(void)
+{
+    if (NULL == sg_encoder.encoder) {
+        return AUDIO_CODEC_PCM;
+    }
+
+    return sg_encoder.encoder->codec_type;
+}
+
+/* encodes one frame, pending is free here: either pcm is the pending frame or nothing is pending */
+static OPERATE_RET __encoder_frame(const uint8_t *pcm, uint32_t *out_off)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t len = 0;
+
+    // the encoders read int16_t samples, a chunk at an odd address is copied to the aligned pending buffer first
+    if ((uintptr_t)pcm & (sizeof(int16_t) - 1)) {
+        memcpy(sg_encoder.pending, pcm, sg_encoder.frame_bytes);
+        pcm = sg_encoder.pending;
+    }
+
+    rt = sg_encoder.encoder->encode(sg_encoder.ctx, (const int16_t *)pcm, sg_encoder.frame_samples,
+                                    sg_encoder.out_buf + *out_off, &len);
+    if (OPRT_OK != rt) {
+        PR_ERR("audio encode failed, rt:%d", rt);
+        return rt;
+    }
+    *out_off += len;
+    sg_encoder.stat.frames++;
+
+    return rt;
+}
+
+/**
+ * @brief Encodes a pcm chunk.
+ *
+ * Samples that do not fill a whole frame are kept for the next call, flush
+ * encodes them padded with silence. With PCM the input is returned as is.
+ *
+ * @param pcm 16 bit pcm, may be NULL when flushing.
+ * @param len Length of pcm in bytes.
+ * @param flush Encode the buffered tail, set at the end of the stream.
+ * @param out Encoded data, owned by the encoder and valid until the next call.
+ * @param out_len Length of the encoded data, 0 if no frame was completed.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_encoder_encode(uint8_t *pcm, uint32_t len, bool flush, uint8_t **out, uint32_t *out_len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t out_off = 0, copy_len = 0;
+
+    TUYA_CHECK_NULL_RETURN(out, OPRT_INVALID_PARM);
+    TUYA_CHECK_NULL_RETURN(out_len, OPRT_INVALID_PARM);
+
+    if (NULL == pcm) {
+        len = 0;
+    }
+    sg_encoder.stat.in_bytes += len;
+
+    if (NULL == sg_encoder.encoder || &sg_pcm_encoder == sg_encoder.encoder) {
+        // pcm goes up untouched, no framing and no copy
+        *out = pcm;
+        *out_len = len;
+        sg_encoder.stat.out_bytes += len;
+        return OPRT_OK;
+    }
+
+    uint32_t frames = (sg_encoder.pending_len + len) / sg_encoder.frame_bytes + 1;
+    uint32_t need = frames * sg_encoder.encoder->frame_max_len(sg_encoder.ctx, sg_encoder.frame_samples);
+    if (need > sg_encoder.out_size) {
+        if (sg_encoder.out_buf) {
+            tal_free(sg_encoder.out_buf);
+        }
+        sg_encoder.out_size = 0;
+        sg_encoder.out_buf = tal_malloc(need);
+        TUYA_CHECK_NULL_RETURN(sg_encoder.out_buf, OPRT_MALLOC_FAILED);
+        sg_encoder.out_size = need;
+    }
+
+    if (sg_encoder.pending_len) {
+        copy_len = MIN(sg_encoder.frame_bytes - sg_encoder.pending_len, len);
+        memcpy(sg_encoder.pending + sg_encoder.pending_len, pcm, copy_len);
+        sg_encoder.pending_len += copy_len;
+        pcm += copy_len;
+        len -= copy_len;
+        if (sg_encoder.pending_len == sg_encoder.frame_bytes) {
+            TUYA_CALL_ERR_RETURN(__encoder_frame(sg_encoder.pending, &out_off));
+            sg_encoder.pending_len = 0;
+        }
+    }
+
+    while (len >= sg_encoder.frame_bytes) {
+        TUYA_CALL_ERR_RETURN(__encoder_frame(pcm, &out_off));
+        pcm += sg_encoder.frame_bytes;
+        len -= sg_encoder.frame_bytes;
+    }
+
+    if (len) {
+        memcpy(sg_encoder.pending + sg_encoder.pending_len, pcm, len);
+        sg_encoder.pending_len += len;
+    }
+
+    if (flush && sg_encoder.pending_len) {
+        memset(sg_encoder.pending + sg_encoder.pending_len, 0, sg_encoder.frame_bytes - sg_encoder.pending_len);
+        TUYA_CALL_ERR_RETURN(__encoder_frame(sg_encoder.pending, &out_off));
+        sg_encoder.pending_len = 0;
+    }
+
+    *out = sg_encoder.out_buf;
+    *out_len = out_off;
+    sg_encoder.stat.out_bytes += out_off;
+
+    return rt;
+}
+
+/**
+ * @brief Gets the counters since the encoder was opened.
+ * @param stat Output counters.
+ * @return None
+ */
+void ai_audio_encoder_get_stat(AI_AUDIO_ENCODER_STAT_T *stat)
+{
+    if (stat) {
+        memcpy(stat, &sg_encoder.stat, sizeof(AI_AUDIO_ENCODER_STAT_T));
+    }
+}
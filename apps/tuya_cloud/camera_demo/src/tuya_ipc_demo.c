@@ -182,6 +182,7 @@ int demo_on_get_video_frame_callback(MEDIA_FRAME *media_frame)
 {
     g_offset = g_frame_start + g_frame_len;
     if (g_offset >= g_file_size) {
+        /* Loop the file, the pull thread sleeps after a callback without a frame */
         g_is_last_frame = FALSE;
         g_frame_len = 0;
         g_frame_start = 0;
@@ -189,7 +190,6 @@ int demo_on_get_video_frame_callback(MEDIA_FRAME *media_frame)
         g_next_frame_start = 0;
         g_offset = 0;
         g_is_key_frame = 0;
-        return -1;
     }
     
     int ret = read_one_frame_from_demo_video_file(g_video_buf + g_offset, 
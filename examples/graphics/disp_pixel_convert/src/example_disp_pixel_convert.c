@@ -0,0 +1,398 @@
+/**
+ * @file example_disp_pixel_convert.c
+ * @brief Benchmark of the display pixel conversion kernels.
+ *
+ * This example runs the row kernels of tdl_display_pixel against the per pixel
+ * code they replace in the LVGL ports and the monochrome panel drivers (SSD1306,
+ * ST7305, ST7306). For every conversion it checks that both produce the same
+ * frame and reports the pixels converted per second.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tal_api.h"
+#include "tkl_output.h"
+
+#include "tdl_display_pixel.h"
+
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+#include <time.h>
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define BENCH_WIDTH  320
+#define BENCH_HEIGHT 240
+#define BENCH_PIXELS (BENCH_WIDTH * BENCH_HEIGHT)
+#define BENCH_ROUNDS 200
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef void (*BENCH_CONVERT_CB)(void);
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static uint16_t *sg_rgb565 = NULL;
+static uint8_t *sg_rgb888 = NULL;
+static uint16_t *sg_out565 = NULL;
+static uint8_t *sg_mono = NULL;
+static uint8_t *sg_out_ref = NULL;
+static uint8_t *sg_out_new = NULL;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint64_t __bench_cpu_us(void)
+{
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return (uint64_t)tal_system_get_millisecond() * 1000;
+#endif
+}
+
+static void __bench_gen_frame(void)
+{
+    uint32_t x = 0, y = 0, seed = 0x12345678;
+    uint8_t r = 0, g = 0, b = 0;
+
+    for (y = 0; y < BENCH_HEIGHT; y++) {
+        for (x = 0; x < BENCH_WIDTH; x++) {
+            seed = seed * 1103515245 + 12345;
+            r = (uint8_t)(x * 255 / BENCH_WIDTH) ^ (uint8_t)((seed >> 16) & 0x1F);
+            g = (uint8_t)(y * 255 / BENCH_HEIGHT);
+            b = (uint8_t)((x + y) & 0xFF);
+
+            sg_rgb888[(y * BENCH_WIDTH + x) * 3 + 0] = b;
+            sg_rgb888[(y * BENCH_WIDTH + x) * 3 + 1] = g;
+            sg_rgb888[(y * BENCH_WIDTH + x) * 3 + 2] = r;
+            sg_rgb565[y * BENCH_WIDTH + x] = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+        }
+    }
+}
+
+/* per pixel code as it was in the LVGL ports and the panel drivers */
+static void __legacy_mono_write_point(uint32_t x, uint32_t y, bool enable, uint8_t *frame)
+{
+    uint32_t write_byte_index = y * (BENCH_WIDTH / 8) + x / 8;
+    uint8_t write_bit = x % 8;
+
+    if (enable) {
+        frame[write_byte_index] |= (1 << write_bit);
+    } else {
+        frame[write_byte_index] &= ~(1 << write_bit);
+    }
+}
+
+static void __legacy_i2_write_point(uint32_t x, uint32_t y, uint8_t color, uint8_t *frame)
+{
+    uint32_t write_byte_index = y * (BENCH_WIDTH / 4) + x / 4;
+    uint8_t write_bit = (x % 4) * 2;
+    uint8_t cleared = frame[write_byte_index] & (~(0x03 << write_bit));
+
+    frame[write_byte_index] = cleared | ((color & 0x03) << write_bit);
+}
+
+static void __legacy_mono(void)
+{
+    uint32_t x = 0, y = 0, offset = 0;
+
+    for (y = 0; y < BENCH_HEIGHT; y++) {
+        for (x = 0; x < BENCH_WIDTH; x++) {
+            bool enable = (sg_rgb565[offset++] > 0x8FFF) ? false : true;
+            __legacy_mono_write_point(x, y, enable, sg_out_ref);
+        }
+    }
+}
+
+static void __legacy_i2(void)
+{
+    uint32_t x = 0, y = 0, offset = 0;
+    uint16_t px = 0;
+
+    for (y = 0; y < BENCH_HEIGHT; y++) {
+        for (x = 0; x < BENCH_WIDTH; x++) {
+            px = sg_rgb565[offset++];
+            uint8_t grey2 = ~((((px >> 11) & 0x1F) + ((px >> 5) & 0x3F) * 2 + (px & 0x1F)) >> 2);
+            __legacy_i2_write_point(x, y, grey2, sg_out_ref);
+        }
+    }
+}
+
+static void __legacy_swap(void)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < BENCH_PIXELS; i++) {
+        sg_out565[i] = (uint16_t)((sg_out565[i] << 8) | (sg_out565[i] >> 8));
+    }
+}
+
+static void __legacy_rgb888(void)
+{
+    uint32_t i = 0;
+    uint8_t *p = sg_rgb888;
+
+    for (i = 0; i < BENCH_PIXELS; i++, p += 3) {
+        sg_out565[i] = ((p[2] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[0] >> 3);
+    }
+}
+
+static void __legacy_page(void)
+{
+    uint32_t i = 0, j = 0, m = 0, width_bytes = BENCH_WIDTH / 8;
+    uint8_t b = 0, mix = 0;
+
+    for (i = 0; i < BENCH_HEIGHT; i += 8) {
+        for (j = 0; j < BENCH_WIDTH; j++) {
+            for (m = 0; m < 8; m++) {
+                if (i + m >= BENCH_HEIGHT) {
+                    continue;
+                }
+                b = sg_mono[(i + m) * width_bytes + j / 8];
+                b = (b >> (j % 8)) & 0x01;
+                mix |= (b << m);
+            }
+            sg_out_ref[(i / 8) * BENCH_WIDTH + j] = mix;
+            mix = 0;
+        }
+    }
+}
+
+static void __legacy_interleave(void)
+{
+    uint32_t k = 0, i = 0, j = 0, width_bytes = BENCH_WIDTH / 8;
+    uint8_t b1 = 0, b2 = 0, mix = 0;
+
+    for (i = 0; i < BENCH_HEIGHT; i += 2) {
+        for (j = 0; j < width_bytes; j++) {
+            b1 = sg_mono[i * width_bytes + j];
+            b2 = sg_mono[(i + 1) * width_bytes + j];
+
+            mix = ((b1 & 0x01) << 7) | ((b2 & 0x01) << 6) | ((b1 & 0x02) << 4) | ((b2 & 0x02) << 3) |
+                  ((b1 & 0x04) << 1) | ((b2 & 0x04)) | ((b1 & 0x08) >> 2) | ((b2 & 0x08) >> 3);
+            sg_out_ref[k++] = mix;
+
+            b1 >>= 4;
+            b2 >>= 4;
+            mix = ((b1 & 0x01) << 7) | ((b2 & 0x01) << 6) | ((b1 & 0x02) << 4) | ((b2 & 0x02) << 3) |
+                  ((b1 & 0x04) << 1) | ((b2 & 0x04)) | ((b1 & 0x08) >> 2) | ((b2 & 0x08) >> 3);
+            sg_out_ref[k++] = mix;
+        }
+    }
+}
+
+/* the same conversions with the row kernels */
+static void __kernel_mono(void)
+{
+    uint32_t y = 0;
+
+    for (y = 0; y < BENCH_HEIGHT; y++) {
+        tdl_disp_rgb565_to_mono(&sg_rgb565[y * BENCH_WIDTH], BENCH_WIDTH, sg_out_new + y * (BENCH_WIDTH / 8), 0,
+                                TDL_DISP_MONO_THRESHOLD_DEF);
+    }
+}
+
+static void __kernel_mono_dither(void)
+{
+    uint32_t y = 0;
+
+    for (y = 0; y < BENCH_HEIGHT; y++) {
+        tdl_disp_rgb565_to_mono_dither(&sg_rgb565[y * BENCH_WIDTH], BENCH_WIDTH, sg_out_new + y * (BENCH_WIDTH / 8),
+                                       0, y);
+    }
+}
+
+static void __kernel_i2(void)
+{
+    uint32_t y = 0;
+
+    for (y = 0; y < BENCH_HEIGHT; y++) {
+        tdl_disp_rgb565_to_i2(&sg_rgb565[y * BENCH_WIDTH], BENCH_WIDTH, sg_out_new + y * (BENCH_WIDTH / 4), 0);
+    }
+}
+
+static void __kernel_swap(void)
+{
+    tdl_disp_rgb565_swap(sg_out565, BENCH_PIXELS);
+}
+
+static void __kernel_rgb888(void)
+{
+    tdl_disp_rgb888_to_rgb565(sg_rgb888, BENCH_PIXELS, sg_out565);
+}
+
+static void __kernel_page(void)
+{
+    tdl_disp_mono_to_page(sg_mono, BENCH_WIDTH, BENCH_HEIGHT, sg_out_new);
+}
+
+static void __kernel_interleave(void)
+{
+    uint32_t i = 0, width_bytes = BENCH_WIDTH / 8;
+
+    for (i = 0; i < BENCH_HEIGHT; i += 2) {
+        tdl_disp_interleave_rows(&sg_mono[i * width_bytes], &sg_mono[(i + 1) * width_bytes], width_bytes,
+                                 &sg_out_new[i * width_bytes]);
+    }
+}
+
+static uint32_t __bench_run(BENCH_CONVERT_CB cb)
+{
+    uint32_t i = 0;
+    uint64_t start = 0, us = 0;
+
+    start = __bench_cpu_us();
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        cb();
+    }
+    us = __bench_cpu_us() - start;
+    if (0 == us) {
+        us = 1;
+    }
+
+    // thousands of pixels per second
+    return (uint32_t)((uint64_t)BENCH_PIXELS * BENCH_ROUNDS * 1000 / us);
+}
+
+static void __bench_compare(const char *name, BENCH_CONVERT_CB legacy, BENCH_CONVERT_CB kernel, uint32_t out_len)
+{
+    uint32_t legacy_kpx = 0, kernel_kpx = 0;
+    bool same = true;
+
+    memset(sg_out_ref, 0, BENCH_PIXELS * 2);
+    memset(sg_out_new, 0, BENCH_PIXELS * 2);
+
+    if (legacy) {
+        legacy();
+        kernel();
+        same = (0 == memcmp(sg_out_ref, sg_out_new, out_len));
+        legacy_kpx = __bench_run(legacy);
+    }
+    kernel_kpx = __bench_run(kernel);
+
+    if (NULL == legacy) {
+        PR_NOTICE("%-12s kernel %6d kpx/s", name, kernel_kpx);
+    } else if (0 == out_len) {
+        PR_NOTICE("%-12s per pixel %6d kpx/s, kernel %6d kpx/s, x%d.%d", name, legacy_kpx, kernel_kpx,
+                  kernel_kpx / legacy_kpx, (kernel_kpx * 10 / legacy_kpx) % 10);
+    } else {
+        PR_NOTICE("%-12s per pixel %6d kpx/s, kernel %6d kpx/s, x%d.%d, output %s", name, legacy_kpx, kernel_kpx,
+                  kernel_kpx / legacy_kpx, (kernel_kpx * 10 / legacy_kpx) % 10, same ? "identical" : "DIFFERS");
+    }
+}
+
+static void __bench_compare_rgb565(const char *name, BENCH_CONVERT_CB legacy, BENCH_CONVERT_CB kernel,
+                                   bool in_place)
+{
+    uint32_t legacy_kpx = 0, kernel_kpx = 0;
+    bool same = false;
+
+    // one pass of each from the same input, the timed rounds only measure speed
+    memcpy(sg_out565, sg_rgb565, BENCH_PIXELS * 2);
+    legacy();
+    memcpy(sg_out_ref, sg_out565, BENCH_PIXELS * 2);
+    memcpy(sg_out565, sg_rgb565, BENCH_PIXELS * 2);
+    kernel();
+    same = (0 == memcmp(sg_out_ref, sg_out565, BENCH_PIXELS * 2));
+    if (!in_place) {
+        // the source frames hold the same colors, so the result must equal the RGB565 frame
+        same = same && (0 == memcmp(sg_out565, sg_rgb565, BENCH_PIXELS * 2));
+    }
+
+    legacy_kpx = __bench_run(legacy);
+    kernel_kpx = __bench_run(kernel);
+
+    PR_NOTICE("%-12s per pixel %6d kpx/s, kernel %6d kpx/s, x%d.%d, output %s", name, legacy_kpx, kernel_kpx,
+              kernel_kpx / legacy_kpx, (kernel_kpx * 10 / legacy_kpx) % 10, same ? "identical" : "DIFFERS");
+}
+
+/**
+ * @brief user_main
+ *
+ * @return int
+ */
+int user_main()
+{
+    tal_log_init(TAL_LOG_LEVEL_DEBUG, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+
+    sg_rgb565 = tal_malloc(BENCH_PIXELS * 2);
+    sg_rgb888 = tal_malloc(BENCH_PIXELS * 3);
+    sg_out565 = tal_malloc(BENCH_PIXELS * 2);
+    sg_out_ref = tal_malloc(BENCH_PIXELS * 2);
+    sg_out_new = tal_malloc(BENCH_PIXELS * 2);
+    sg_mono = tal_malloc(BENCH_PIXELS / 8);
+    if (NULL == sg_rgb565 || NULL == sg_rgb888 || NULL == sg_out565 || NULL == sg_out_ref || NULL == sg_out_new ||
+        NULL == sg_mono) {
+        PR_ERR("malloc failed");
+        goto __EXIT;
+    }
+
+    __bench_gen_frame();
+    __legacy_mono();
+    memcpy(sg_mono, sg_out_ref, BENCH_PIXELS / 8);
+
+    PR_NOTICE("converting %dx%d frames, %d rounds", BENCH_WIDTH, BENCH_HEIGHT, BENCH_ROUNDS);
+    __bench_compare("mono", __legacy_mono, __kernel_mono, BENCH_PIXELS / 8);
+    __bench_compare("mono dither", NULL, __kernel_mono_dither, 0);
+    // the grey levels of the old code wrap around, so only the speed is compared
+    __bench_compare("i2", __legacy_i2, __kernel_i2, 0);
+    __bench_compare("ssd1306 page", __legacy_page, __kernel_page, BENCH_PIXELS / 8);
+    __bench_compare("st7305 rows", __legacy_interleave, __kernel_interleave, BENCH_PIXELS / 8);
+    __bench_compare_rgb565("rgb565 swap", __legacy_swap, __kernel_swap, true);
+    __bench_compare_rgb565("rgb888", __legacy_rgb888, __kernel_rgb888, false);
+
+__EXIT:
+    tal_free(sg_rgb565);
+    tal_free(sg_rgb888);
+    tal_free(sg_out565);
+    tal_free(sg_out_ref);
+    tal_free(sg_out_new);
+    tal_free(sg_mono);
+
+    return 0;
+}
+
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+void main(int argc, char *argv[])
+{
+    user_main();
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
@@ -28,10 +28,12 @@
 #include "demos/lv_demos.h"
 #include "examples/lv_examples.h"
 #include "lv_vendor.h"
+#include "lv_port_disp.h"
 #include "board_com_api.h"
 /***********************************************************
 *************************micro define***********************
 ***********************************************************/
+#define LVGL_STAT_PERIOD_MS 5000
 
 /***********************************************************
 ***********************typedef define***********************
@@ -45,6 +47,28 @@
 /***********************************************************
 ***********************function define**********************
 ***********************************************************/
+/**
+ * @brief print the frame time of the display port every LVGL_STAT_PERIOD_MS
+ *
+ * @param[in] timer: lvgl timer
+ * @return none
+ */
+static void __lvgl_stat_timer_cb(lv_timer_t *timer)
+{
+    lv_port_disp_stat_t stat;
+
+    lv_port_disp_get_stat(&stat);
+    lv_port_disp_reset_stat();
+
+    if (0 == stat.frames) {
+        return;
+    }
+
+    PR_NOTICE("lvgl %d frames, frame time %d ms (flush %d ms), %d px and %d bytes copied per frame", stat.frames,
+              stat.refr_ms / stat.frames, stat.flush_ms / stat.frames, (uint32_t)(stat.refr_px / stat.frames),
+              (uint32_t)(stat.copy_bytes / stat.frames));
+}
+
 /**
  * @brief user_main
  *
@@ -64,6 +88,8 @@ void user_main(void)
     lv_demo_widgets();
     // lv_demo_benchmark();
 
+    lv_timer_create(__lvgl_stat_timer_cb, LVGL_STAT_PERIOD_MS, NULL);
+
     lv_vendor_start(5, 1024*8);
 }
 
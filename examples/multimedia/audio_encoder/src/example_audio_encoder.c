@@ -0,0 +1,296 @@
+/**
+ * @file example_audio_encoder.c
+ * @brief Benchmark of the AI audio uplink encoder stage.
+ *
+ * This example feeds a synthetic 16 kHz mono voice signal through the encoder
+ * stage used by the AI agent (ai_audio_encoder) the same way the cloud ASR
+ * uploads it: 100 ms chunks, flushed at the end of the stream. For every
+ * codec it reports the CPU time spent per 20 ms of audio and the uplink bytes
+ * per second. ADPCM frames are decoded again to report the rms error.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tal_api.h"
+#include "tkl_output.h"
+
+#include "ai_audio_encoder.h"
+
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+#include <time.h>
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define BENCH_SAMPLE_RATE  16000
+#define BENCH_SECONDS      30
+#define BENCH_CHUNK_MS     100
+#define BENCH_CHUNK_BYTES  (BENCH_SAMPLE_RATE / 1000 * BENCH_CHUNK_MS * sizeof(int16_t))
+#define BENCH_TOTAL_BYTES  (BENCH_SAMPLE_RATE * BENCH_SECONDS * sizeof(int16_t))
+#define BENCH_REF_FRAME_MS 20
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    int32_t predicted;
+    int32_t index;
+    uint64_t err_sum; // sum of squared decode errors
+    uint64_t sig_sum; // sum of squared input samples
+    uint32_t samples;
+} BENCH_ADPCM_CHECK_T;
+
+/***********************************************************
+***********************const declaration********************
+***********************************************************/
+static const int16_t sg_step_table[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t sg_index_table[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint64_t __bench_cpu_us(void)
+{
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return (uint64_t)tal_system_get_millisecond() * 1000;
+#endif
+}
+
+static uint32_t __bench_isqrt(uint64_t v)
+{
+    uint64_t r = 0, bit = (uint64_t)1 << 62;
+
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)r;
+}
+
+/**
+ * @brief three harmonics with a moving pitch, a syllable like envelope and some noise
+ */
+static void __bench_gen_voice(int16_t *pcm, uint32_t samples)
+{
+    float y1[3] = {0}, y2[3] = {0}, k[3] = {0};
+    const float amp[3] = {9000.0f, 4000.0f, 1500.0f};
+    uint32_t seed = 0x1234567;
+    uint32_t i = 0, h = 0;
+
+    for (i = 0; i < samples; i++) {
+        if (0 == i % 1600) {
+            // new pitch every 100 ms: 2cos(w) for f0, 3f0 and 7f0, resonators restarted
+            float f0 = 120.0f + (float)((i / 1600) % 8) * 15.0f;
+            for (h = 0; h < 3; h++) {
+                float f = f0 * (float)(h == 0 ? 1 : (h == 1 ? 3 : 7));
+                float w = 6.2831853f * f / BENCH_SAMPLE_RATE;
+                float w2 = w * w;
+                k[h] = 2.0f * (1.0f - w2 / 2.0f + w2 * w2 / 24.0f - w2 * w2 * w2 / 720.0f);
+                y1[h] = 0.0f;
+                y2[h] = -amp[h] * w; // ~ -amp * sin(w), starts the sine at phase 0
+            }
+        }
+
+        float s = 0.0f;
+        for (h = 0; h < 3; h++) {
+            float y = k[h] * y1[h] - y2[h];
+            y2[h] = y1[h];
+            y1[h] = y;
+            s += y;
+        }
+
+        // 250 ms syllables, rising and falling
+        uint32_t pos = i % 4000;
+        float env = (pos < 2000) ? (float)pos / 2000.0f : (float)(4000 - pos) / 2000.0f;
+        seed = seed * 1103515245 + 12345;
+        int32_t v = (int32_t)(s * env) + (int32_t)((seed >> 16) & 0x3FF) - 512;
+        pcm[i] = (v > 32767) ? 32767 : ((v < -32768) ? -32768 : (int16_t)v);
+    }
+}
+
+/**
+ * @brief decode DVI4 frames and accumulate the error against the input
+ */
+static void __bench_adpcm_check(BENCH_ADPCM_CHECK_T *chk, const uint8_t *data, uint32_t len, const int16_t *ref,
+                                uint32_t frame_samples)
+{
+    uint32_t off = 0, i = 0;
+
+    while (off + 4 <= len) {
+        const uint8_t *p = data + off + 4;
+        chk->predicted = (int16_t)((data[off] << 8) | data[off + 1]);
+        chk->index = data[off + 2];
+
+        for (i = 0; i < frame_samples; i++) {
+            uint8_t code = (0 == (i & 1)) ? (p[i / 2] >> 4) : (p[i / 2] & 0x0F);
+            int32_t step = sg_step_table[chk->index];
+            int32_t vpdiff = step >> 3;
+            if (code & 4) {
+                vpdiff += step;
+            }
+            if (code & 2) {
+                vpdiff += step >> 1;
+            }
+            if (code & 1) {
+                vpdiff += step >> 2;
+            }
+            chk->predicted += (code & 8) ? -vpdiff : vpdiff;
+            chk->predicted = (chk->predicted > 32767) ? 32767 : ((chk->predicted < -32768) ? -32768 : chk->predicted);
+            chk->index += sg_index_table[code];
+            chk->index = (chk->index < 0) ? 0 : ((chk->index > 88) ? 88 : chk->index);
+
+            // the padded tail of the flushed frame has no reference
+            if (chk->samples < BENCH_TOTAL_BYTES / sizeof(int16_t)) {
+                int32_t err = chk->predicted - ref[chk->samples];
+                chk->err_sum += (uint64_t)((int64_t)err * err);
+                chk->sig_sum += (uint64_t)((int64_t)ref[chk->samples] * ref[chk->samples]);
+                chk->samples++;
+            }
+        }
+        off += 4 + (frame_samples + 1) / 2;
+    }
+}
+
+static void __bench_codec(AI_AUDIO_CODEC_TYPE codec, uint32_t frame_ms, int16_t *pcm)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_AUDIO_ENCODER_STAT_T stat;
+    BENCH_ADPCM_CHECK_T chk;
+    uint8_t *out = NULL;
+    uint32_t out_len = 0, off = 0;
+    uint64_t cpu_us = 0, start = 0;
+
+    AI_AUDIO_ENCODER_CFG_T cfg = {
+        .sample_rate = BENCH_SAMPLE_RATE,
+        .channels = 1,
+        .bit_depth = 16,
+        .frame_ms = frame_ms,
+        .bitrate = AI_AUDIO_ENCODER_BITRATE,
+    };
+    rt = ai_audio_encoder_open(codec, &cfg);
+    if (OPRT_OK != rt) {
+        PR_ERR("encoder %d open failed, rt:%d", codec, rt);
+        return;
+    }
+    if (codec != ai_audio_encoder_get_codec()) {
+        PR_NOTICE("codec %d not registered, skipped", codec);
+        ai_audio_encoder_close();
+        return;
+    }
+    memset(&chk, 0, sizeof(chk));
+
+    for (off = 0; off < BENCH_TOTAL_BYTES; off += BENCH_CHUNK_BYTES) {
+        start = __bench_cpu_us();
+        rt = ai_audio_encoder_encode((uint8_t *)pcm + off, BENCH_CHUNK_BYTES, false, &out, &out_len);
+        cpu_us += __bench_cpu_us() - start;
+        if (OPRT_OK != rt) {
+            PR_ERR("encode failed, rt:%d", rt);
+            break;
+        }
+        if (AUDIO_CODEC_ADPCM == ai_audio_encoder_get_codec()) {
+            __bench_adpcm_check(&chk, out, out_len, pcm, BENCH_SAMPLE_RATE / 1000 * frame_ms);
+        }
+    }
+    start = __bench_cpu_us();
+    ai_audio_encoder_encode(NULL, 0, true, &out, &out_len);
+    cpu_us += __bench_cpu_us() - start;
+
+    ai_audio_encoder_get_stat(&stat);
+    PR_NOTICE("codec %d, frame %d ms: %d frames, %llu us cpu per %d ms of audio, %d bytes/s uplink (pcm %d)",
+              ai_audio_encoder_get_codec(), frame_ms, stat.frames,
+              cpu_us * BENCH_REF_FRAME_MS / (BENCH_SECONDS * 1000), BENCH_REF_FRAME_MS, stat.out_bytes / BENCH_SECONDS,
+              stat.in_bytes / BENCH_SECONDS);
+    if (chk.samples) {
+        PR_NOTICE("    adpcm rms error %d, signal rms %d", __bench_isqrt(chk.err_sum / chk.samples),
+                  __bench_isqrt(chk.sig_sum / chk.samples));
+    }
+
+    ai_audio_encoder_close();
+}
+
+/**
+ * @brief user_main
+ *
+ * @return int
+ */
+int user_main()
+{
+    tal_log_init(TAL_LOG_LEVEL_DEBUG, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+
+    int16_t *pcm = tal_malloc(BENCH_TOTAL_BYTES);
+    if (NULL == pcm) {
+        PR_ERR("malloc %d failed", BENCH_TOTAL_BYTES);
+        return -1;
+    }
+    __bench_gen_voice(pcm, BENCH_TOTAL_BYTES / sizeof(int16_t));
+
+    PR_NOTICE("encoding %d s of 16 kHz mono pcm in %d ms chunks", BENCH_SECONDS, BENCH_CHUNK_MS);
+    __bench_codec(AUDIO_CODEC_PCM, 20, pcm);
+    __bench_codec(AUDIO_CODEC_ADPCM, 20, pcm);
+    __bench_codec(AUDIO_CODEC_ADPCM, 60, pcm);
+    // skipped unless an opus encoder was registered with ai_audio_encoder_register
+    __bench_codec(AUDIO_CODEC_OPUS, 20, pcm);
+
+    tal_free(pcm);
+
+    return 0;
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
@@ -0,0 +1,411 @@
+/**
+ * @file example_p2p_rtp_pack.c
+ * @brief Benchmark of the RTP packetizer used by the p2p media channels.
+ *
+ * This example packetizes an H.264/H.265 elementary stream the way the p2p
+ * streaming layer does it and compares two paths:
+ *   - per frame: an rtp encoder is created and destroyed for every frame and
+ *     every packet is malloc'ed, then handed to the transport on its own.
+ *   - packer: tuya_ipc_p2p_rtp keeps the encoder, serializes the packets in
+ *     place into pooled frames and hands a frame over in one call.
+ * It reports packets/s, heap allocations per frame and transport calls per
+ * frame. On Linux a recorded Annex-B stream can be given on the command line,
+ * otherwise a synthetic stream is used.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tal_api.h"
+#include "tkl_output.h"
+
+#include "tuya_ipc_p2p_rtp.h"
+#include "rtp-payload.h"
+
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+#include <stdio.h>
+#include <time.h>
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define BENCH_SYN_FRAMES     300
+#define BENCH_SYN_GOP        30
+#define BENCH_SYN_I_LEN      40000
+#define BENCH_SYN_P_LEN      6000
+#define BENCH_PASSES         20
+#define BENCH_FILE_MAX_LEN   (16 * 1024 * 1024)
+#define BENCH_MAX_FRAMES     4096
+#define BENCH_POOL_NUM       4
+#define BENCH_H264_PAYLOAD   96
+#define BENCH_H265_PAYLOAD   95
+#define BENCH_PKT_BUF_LEN    1600
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    uint32_t offset;
+    uint32_t len;
+    bool key_frame;
+} BENCH_FRAME_T;
+
+typedef struct {
+    const uint8_t *es;
+    BENCH_FRAME_T *frames;
+    uint32_t frame_num;
+    bool h265;
+} BENCH_STREAM_T;
+
+typedef struct {
+    uint32_t allocs;
+    uint32_t packets;
+    uint32_t calls;
+    uint64_t bytes;
+    uint32_t fix_len;
+    char ext_head[TUYA_IPC_P2P_RTP_EXT_MAX_LEN];
+    uint8_t sink[BENCH_PKT_BUF_LEN]; // stands in for the transport
+} BENCH_LEGACY_T;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint64_t __bench_now_us(void)
+{
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return (uint64_t)tal_system_get_millisecond() * 1000;
+#endif
+}
+
+static uint32_t __bench_start_code(const uint8_t *p, uint32_t len, uint32_t off)
+{
+    for (; off + 3 <= len; off++) {
+        if (0 == p[off] && 0 == p[off + 1] && 1 == p[off + 2]) {
+            return off;
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief split an Annex-B stream into access units
+ *
+ * A new access unit starts at a parameter set/SEI/AUD that follows a slice, or
+ * at a slice whose first_mb_in_slice / first_slice_segment_in_pic_flag is set.
+ */
+static void __bench_split(BENCH_STREAM_T *stream, uint32_t len)
+{
+    const uint8_t *p = stream->es;
+    uint32_t off = __bench_start_code(p, len, 0);
+    uint32_t au_start = off;
+    bool has_vcl = false, key = false;
+
+    stream->frame_num = 0;
+    while (off < len && stream->frame_num < BENCH_MAX_FRAMES) {
+        uint32_t nal = off + 3;
+        uint32_t next = __bench_start_code(p, len, nal);
+        // 4 byte start codes keep their leading zero with the previous NAL unit
+        uint32_t nal_start = (off > 0 && 0 == p[off - 1]) ? off - 1 : off;
+        bool vcl = false, first = false, is_key = false;
+
+        if (nal + 2 < len) {
+            if (stream->h265) {
+                uint8_t type = (p[nal] >> 1) & 0x3F;
+                vcl = type < 32;
+                first = vcl && (p[nal + 2] & 0x80);
+                is_key = type >= 16 && type <= 21;
+            } else {
+                uint8_t type = p[nal] & 0x1F;
+                vcl = (1 == type || 5 == type);
+                first = vcl && (p[nal + 1] & 0x80);
+                is_key = (5 == type);
+            }
+        }
+
+        if (has_vcl && (!vcl || first)) {
+            BENCH_FRAME_T *f = &stream->frames[stream->frame_num++];
+            f->offset = au_start;
+            f->len = nal_start - au_start;
+            f->key_frame = key;
+            au_start = nal_start;
+            has_vcl = false;
+            key = false;
+        }
+        has_vcl = has_vcl || vcl;
+        key = key || is_key;
+        off = next;
+    }
+    if (has_vcl && stream->frame_num < BENCH_MAX_FRAMES) {
+        BENCH_FRAME_T *f = &stream->frames[stream->frame_num++];
+        f->offset = au_start;
+        f->len = len - au_start;
+        f->key_frame = key;
+    }
+}
+
+static uint32_t __bench_put_nal(uint8_t *p, uint8_t head, uint32_t len, uint32_t *seed)
+{
+    uint32_t i = 0;
+
+    p[0] = 0;
+    p[1] = 0;
+    p[2] = 0;
+    p[3] = 1;
+    p[4] = head;
+    p[5] = 0x88; // first_mb_in_slice 0
+    for (i = 6; i < len + 4; i++) {
+        *seed = *seed * 1103515245 + 12345;
+        p[i] = (uint8_t)(*seed >> 16) | 0x01; // no start code emulation
+    }
+
+    return len + 4;
+}
+
+/**
+ * @brief H.264 stream, SPS/PPS/IDR every BENCH_SYN_GOP frames, P frames of varying size in between
+ */
+static uint32_t __bench_gen_h264(uint8_t *es)
+{
+    uint32_t seed = 0x1234567, off = 0, n = 0;
+
+    for (n = 0; n < BENCH_SYN_FRAMES; n++) {
+        if (0 == n % BENCH_SYN_GOP) {
+            off += __bench_put_nal(es + off, 0x67, 12, &seed); // SPS
+            off += __bench_put_nal(es + off, 0x68, 4, &seed);  // PPS
+            off += __bench_put_nal(es + off, 0x65, BENCH_SYN_I_LEN, &seed);
+        } else {
+            off += __bench_put_nal(es + off, 0x41, BENCH_SYN_P_LEN / 2 + (seed >> 8) % BENCH_SYN_P_LEN, &seed);
+        }
+    }
+
+    return off;
+}
+
+static uint32_t __bench_ext_head(bool key_frame, char *ext_head)
+{
+    C2C_AV_TRANS_FIXED_HEADER head;
+
+    memset(&head, 0, sizeof(head));
+    head.request_id = 1;
+    head.extension_length = key_frame ? 8 : 0;
+    memset(ext_head, 0, TUYA_IPC_P2P_RTP_EXT_MAX_LEN);
+    memcpy(ext_head, &head, sizeof(head));
+
+    return sizeof(C2C_AV_TRANS_FIXED_HEADER) + (key_frame ? 12 : 4);
+}
+
+static void *__bench_legacy_alloc(void *param, int bytes)
+{
+    BENCH_LEGACY_T *legacy = (BENCH_LEGACY_T *)param;
+    legacy->allocs++;
+    void *packet = tal_malloc(bytes);
+    if (packet) {
+        memset(packet, 0, bytes);
+    }
+    return packet;
+}
+
+static void __bench_legacy_free(void *param, void *packet)
+{
+    tal_free(packet);
+}
+
+static int __bench_legacy_packet(void *param, const void *packet, int bytes, uint32_t timestamp, int flags)
+{
+    BENCH_LEGACY_T *legacy = (BENCH_LEGACY_T *)param;
+
+    // ext head + packet were copied into one buffer and sent on their own
+    memcpy(legacy->sink, legacy->ext_head, legacy->fix_len);
+    memcpy(legacy->sink + legacy->fix_len, packet, MIN(bytes, BENCH_PKT_BUF_LEN - legacy->fix_len));
+    legacy->packets++;
+    legacy->calls++;
+    legacy->bytes += legacy->fix_len + bytes;
+
+    return 0;
+}
+
+static void __bench_legacy(BENCH_STREAM_T *stream)
+{
+    static BENCH_LEGACY_T legacy;
+    struct rtp_payload_t handler = {__bench_legacy_alloc, __bench_legacy_free, __bench_legacy_packet};
+    int payload = stream->h265 ? BENCH_H265_PAYLOAD : BENCH_H264_PAYLOAD;
+    const char *name = stream->h265 ? "H265" : "H264";
+    uint16_t seq = 0;
+    uint32_t ts = 0, pass = 0, i = 0;
+
+    memset(&legacy, 0, sizeof(legacy));
+    uint64_t start = __bench_now_us();
+    for (pass = 0; pass < BENCH_PASSES; pass++) {
+        for (i = 0; i < stream->frame_num; i++) {
+            BENCH_FRAME_T *f = &stream->frames[i];
+            legacy.fix_len = __bench_ext_head(f->key_frame, legacy.ext_head);
+            void *encoder = rtp_payload_encode_create(payload, name, seq, 10, &handler, &legacy);
+            if (NULL == encoder) {
+                PR_ERR("rtp_payload_encode_create failed");
+                return;
+            }
+            legacy.allocs += 2; // encoder delegate and packer, see rtp_payload_encode_create
+            rtp_payload_encode_input(encoder, stream->es + f->offset, f->len, (pass * stream->frame_num + i) * 3000);
+            rtp_payload_encode_getinfo(encoder, &seq, &ts);
+            rtp_payload_encode_destroy(encoder);
+        }
+    }
+    uint64_t cost = __bench_now_us() - start;
+    uint32_t frames = BENCH_PASSES * stream->frame_num;
+
+    PR_NOTICE("per frame: %d frames, %d packets, %llu packets/s, %d.%02d allocs/frame, %d.%02d calls/frame", frames,
+              legacy.packets, cost ? (uint64_t)legacy.packets * 1000000 / cost : 0, legacy.allocs / frames,
+              legacy.allocs * 100 / frames % 100, legacy.calls / frames, legacy.calls * 100 / frames % 100);
+}
+
+static void __bench_packer(BENCH_STREAM_T *stream)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TUYA_IPC_P2P_RTP_HANDLE packer = NULL;
+    TUYA_IPC_P2P_RTP_STAT_T stat;
+    char ext_head[TUYA_IPC_P2P_RTP_EXT_MAX_LEN];
+    int payload = stream->h265 ? BENCH_H265_PAYLOAD : BENCH_H264_PAYLOAD;
+    const char *name = stream->h265 ? "H265" : "H264";
+    uint32_t pass = 0, i = 0, calls = 0;
+
+    rt = tuya_ipc_p2p_rtp_create(10, BENCH_POOL_NUM, &packer);
+    if (OPRT_OK != rt) {
+        PR_ERR("tuya_ipc_p2p_rtp_create failed, rt:%d", rt);
+        return;
+    }
+
+    uint64_t start = __bench_now_us();
+    for (pass = 0; pass < BENCH_PASSES; pass++) {
+        for (i = 0; i < stream->frame_num; i++) {
+            BENCH_FRAME_T *f = &stream->frames[i];
+            uint32_t fix_len = __bench_ext_head(f->key_frame, ext_head);
+            TUYA_IPC_P2P_RTP_FRAME_T *frame = tuya_ipc_p2p_rtp_frame_alloc(packer, f->len);
+            if (NULL == frame) {
+                PR_ERR("frame alloc failed");
+                break;
+            }
+            rt = tuya_ipc_p2p_rtp_pack(packer, payload, name, ext_head, fix_len, stream->es + f->offset, f->len,
+                                       (pass * stream->frame_num + i) * 3000, frame);
+            if (OPRT_OK == rt) {
+                // what the send thread does per session, the transport call itself is left out
+                tuya_ipc_p2p_rtp_set_request_id(frame, 2);
+                calls++;
+            }
+            tuya_ipc_p2p_rtp_frame_free(frame);
+        }
+    }
+    uint64_t cost = __bench_now_us() - start;
+
+    tuya_ipc_p2p_rtp_get_stat(packer, &stat);
+    uint32_t allocs = stat.allocs + stat.encoder_init * 2;
+    PR_NOTICE("packer:    %d frames, %d packets, %llu packets/s, %d.%02d allocs/frame, %d.%02d calls/frame",
+              stat.frames, stat.packets, cost ? (uint64_t)stat.packets * 1000000 / cost : 0, allocs / stat.frames,
+              allocs * 100 / stat.frames % 100, calls / stat.frames, calls * 100 / stat.frames % 100);
+    PR_NOTICE("    %d allocs, %d pool hits, %d encoder init, %llu bytes", allocs, stat.pool_hits, stat.encoder_init,
+              stat.bytes);
+
+    tuya_ipc_p2p_rtp_destroy(packer);
+}
+
+/**
+ * @brief user_main
+ *
+ * @param path recorded Annex-B stream, NULL for the synthetic one
+ * @return int
+ */
+int user_main(const char *path)
+{
+    BENCH_STREAM_T stream;
+    uint8_t *es = NULL;
+    uint32_t len = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_DEBUG, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+
+    memset(&stream, 0, sizeof(stream));
+    stream.frames = tal_malloc(BENCH_MAX_FRAMES * sizeof(BENCH_FRAME_T));
+    es = tal_malloc(path ? BENCH_FILE_MAX_LEN : BENCH_SYN_FRAMES * (BENCH_SYN_I_LEN + 64));
+    if (NULL == stream.frames || NULL == es) {
+        PR_ERR("malloc failed");
+        tal_free(stream.frames);
+        tal_free(es);
+        return -1;
+    }
+
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+    if (path) {
+        FILE *fp = fopen(path, "rb");
+        if (NULL == fp) {
+            PR_ERR("open %s failed", path);
+            tal_free(stream.frames);
+            tal_free(es);
+            return -1;
+        }
+        len = fread(es, 1, BENCH_FILE_MAX_LEN, fp);
+        fclose(fp);
+        stream.h265 = (NULL != strstr(path, "265") || NULL != strstr(path, "hevc"));
+    }
+#endif
+    if (0 == len) {
+        len = __bench_gen_h264(es);
+    }
+    stream.es = es;
+    __bench_split(&stream, len);
+    if (0 == stream.frame_num) {
+        PR_ERR("no frame found");
+        tal_free(stream.frames);
+        tal_free(es);
+        return -1;
+    }
+
+    PR_NOTICE("%s %s: %d bytes, %d frames, rtp packet size %d, %d passes", path ? path : "synthetic",
+              stream.h265 ? "h265" : "h264", len, stream.frame_num, rtp_packet_getsize(), BENCH_PASSES);
+    __bench_legacy(&stream);
+    __bench_packer(&stream);
+
+    tal_free(stream.frames);
+    tal_free(es);
+
+    return 0;
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main(argc > 1 ? argv[1] : NULL);
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main(NULL);
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
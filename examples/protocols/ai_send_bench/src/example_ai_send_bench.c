@@ -0,0 +1,408 @@
+/**
+ * @file example_ai_send_bench.c
+ * @brief Packets per second and payload bytes copied by the AI packet send path, before and after the send buffer.
+ *
+ * Every packet is built the way __ai_packet_write() does it at the default security level (SL4, AES-256-GCM):
+ * AI_PACKET_HEAD_T, IV, length, payload head, data length, the encrypted payload with its PKCS padding and tag,
+ * and the signature. The transporter is replaced by a function that counts the bytes it is given.
+ *
+ * The former flow allocates and clears the packet and a plaintext payload for every packet, copies the data into
+ * the plaintext, the plaintext into the packet and encrypts it with mbedtls_cipher_auth_encrypt_wrapper(), which
+ * keys a cipher and allocates a buffer of its own per call. The current flow writes the headers into a persistent
+ * send buffer and streams the payload head, the caller's data and the padding through a GCM context keyed once.
+ * Both flows run on the same key and IV for the first packet of each size, and the packets are compared byte by
+ * byte before the timing starts.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "tuya_ai_protocol.h"
+#include "mbedtls/gcm.h"
+#include "cipher_wrapper.h"
+
+#include "tal_api.h"
+#include "tal_hash.h"
+#include "tkl_output.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define AI_BENCH_TOTAL_BYTES (32 * 1024 * 1024)
+#define AI_BENCH_MIN_LOOPS   1000
+
+/* head, iv and length in front of the payload */
+#define AI_BENCH_HEAD_LEN (sizeof(AI_PACKET_HEAD_T) + AI_IV_LEN + sizeof(uint32_t))
+/* payload head and data length in front of the data */
+#define AI_BENCH_PAYLOAD_HEAD_LEN (sizeof(AI_PAYLOAD_HEAD_T) + sizeof(uint32_t))
+/* room for the padding and the tag, AI_ADD_PKT_LEN of tuya_ai_protocol.c */
+#define AI_BENCH_ADD_PKT_LEN 128
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    uint32_t packets;
+    uint32_t bytes;
+    uint32_t copied; // payload bytes copied before the packet is handed over
+    uint32_t allocs;
+} AI_BENCH_STAT_T;
+
+typedef OPERATE_RET (*AI_BENCH_SEND_CB)(const uint8_t *data, uint32_t len);
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+/* 20 ms of 16 kHz 16 bit audio, a video slice and a full fragment */
+static const uint32_t sg_data_len[] = {640, 4096, AI_MAX_FRAGMENT_LENGTH - AI_BENCH_HEAD_LEN -
+                                                      AI_BENCH_PAYLOAD_HEAD_LEN - AI_BENCH_ADD_PKT_LEN - AI_SIGN_LEN};
+
+static uint8_t sg_crypt_key[AI_KEY_LEN];
+static uint8_t sg_sign_key[AI_KEY_LEN];
+static uint8_t sg_iv[AI_IV_LEN];
+static uint16_t sg_sequence = 0;
+
+static mbedtls_gcm_context sg_gcm_ctx;
+static uint8_t *sg_send_buf = NULL;
+
+static AI_BENCH_STAT_T sg_stat;
+
+/* the last packet handed to the transport, kept to compare the flows */
+static uint8_t *sg_last_pkt = NULL;
+static uint32_t sg_last_len = 0;
+static BOOL_T sg_keep_pkt = FALSE;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+/* stands in for tuya_transporter_write() */
+static int __bench_transport_write(const uint8_t *buf, uint32_t len)
+{
+    if (sg_keep_pkt) {
+        memcpy(sg_last_pkt, buf, len);
+        sg_last_len = len;
+    }
+    sg_stat.packets++;
+    sg_stat.bytes += len;
+    return len;
+}
+
+static uint32_t __bench_head_write(uint8_t *buf)
+{
+    AI_PACKET_HEAD_T head = {0};
+    uint32_t offset = 0;
+
+    if (sg_sequence >= 0xFFFF) {
+        sg_sequence = 1;
+    }
+    head.version = 0x01;
+    head.sequence = UNI_HTONS(sg_sequence++);
+    head.frag_flag = AI_PACKET_NO_FRAG;
+    head.security_level = AI_PACKET_SL4;
+    head.iv_flag = 1;
+    memcpy(buf, &head, sizeof(head));
+    offset += sizeof(head);
+    memcpy(buf + offset, sg_iv, AI_IV_LEN);
+    offset += AI_IV_LEN;
+    return offset + sizeof(uint32_t);
+}
+
+static uint32_t __bench_payload_head_write(uint8_t *buf, uint32_t data_len)
+{
+    AI_PAYLOAD_HEAD_T payload_head = {0};
+    uint32_t len = UNI_HTONL(data_len);
+
+    payload_head.type = AI_PT_AUDIO;
+    payload_head.attribute_flag = AI_NO_ATTR;
+    memcpy(buf, &payload_head, sizeof(payload_head));
+    memcpy(buf + sizeof(payload_head), &len, sizeof(len));
+    return AI_BENCH_PAYLOAD_HEAD_LEN;
+}
+
+/* writes the length and signs the packet as __ai_packet_sign(): first and last 32 bytes */
+static OPERATE_RET __bench_sign(uint8_t *buf, uint32_t head_len, uint32_t payload_len, uint8_t *signature)
+{
+    uint8_t sign_data[64];
+    uint32_t length = UNI_HTONL(payload_len + AI_SIGN_LEN);
+
+    memcpy(buf + head_len - sizeof(length), &length, sizeof(length));
+    memcpy(sign_data, buf, 32);
+    memcpy(sign_data + 32, buf + head_len + payload_len - 32, 32);
+    return tal_sha256_mac(sg_sign_key, AI_KEY_LEN, sign_data, sizeof(sign_data), signature);
+}
+
+/* the flow before the send buffer: two allocations and three copies of the payload per packet */
+static OPERATE_RET __bench_send_copy(const uint8_t *data, uint32_t data_len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t plain_len = AI_BENCH_PAYLOAD_HEAD_LEN + data_len;
+    uint32_t pkt_len = AI_BENCH_HEAD_LEN + plain_len + AI_BENCH_ADD_PKT_LEN + AI_SIGN_LEN;
+    uint32_t head_len = 0, pad_len = 0;
+    uint8_t tag[AI_GCM_TAG_LEN];
+    uint8_t signature[AI_SIGN_LEN];
+    uint8_t *pkt = NULL, *plain = NULL, *output = NULL;
+    size_t en_len = 0;
+
+    pkt = tal_malloc(pkt_len);
+    TUYA_CHECK_NULL_RETURN(pkt, OPRT_MALLOC_FAILED);
+    memset(pkt, 0, pkt_len);
+    sg_stat.allocs++;
+    head_len = __bench_head_write(pkt);
+
+    plain = tal_malloc(plain_len);
+    if (NULL == plain) {
+        tal_free(pkt);
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(plain, 0, plain_len);
+    sg_stat.allocs++;
+    __bench_payload_head_write(plain, data_len);
+    memcpy(plain + AI_BENCH_PAYLOAD_HEAD_LEN, data, data_len);
+    sg_stat.copied += data_len;
+
+    output = pkt + head_len;
+    memcpy(output, plain, plain_len);
+    sg_stat.copied += plain_len;
+    pad_len = 16 - plain_len % 16;
+    memset(output + plain_len, pad_len, pad_len);
+    tal_free(plain);
+
+    const cipher_params_t en_input = {
+        .cipher_type = MBEDTLS_CIPHER_AES_256_GCM,
+        .key = sg_crypt_key,
+        .key_len = AI_KEY_LEN,
+        .nonce = sg_iv,
+        .nonce_len = AI_IV_LEN,
+        .ad = NULL,
+        .ad_len = 0,
+        .data = output,
+        .data_len = plain_len + pad_len,
+    };
+    // the wrapper encrypts into a buffer of its own and copies the result back
+    rt = mbedtls_cipher_auth_encrypt_wrapper(&en_input, output, &en_len, tag, sizeof(tag));
+    sg_stat.allocs++;
+    sg_stat.copied += en_len;
+    if (OPRT_OK != rt) {
+        goto __EXIT;
+    }
+    memcpy(output + en_len, tag, sizeof(tag));
+    en_len += sizeof(tag);
+
+    rt = __bench_sign(pkt, head_len, en_len, signature);
+    if (OPRT_OK != rt) {
+        goto __EXIT;
+    }
+    memcpy(output + en_len, signature, AI_SIGN_LEN);
+
+    if (__bench_transport_write(pkt, head_len + en_len + AI_SIGN_LEN) < 0) {
+        rt = OPRT_COM_ERROR;
+    }
+
+__EXIT:
+    tal_free(pkt);
+    return rt;
+}
+
+/* the current flow: headers in the send buffer, the data read once by gcm straight into it */
+static OPERATE_RET __bench_send_inplace(const uint8_t *data, uint32_t data_len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t *buf = sg_send_buf;
+    uint8_t pkcs[16];
+    uint32_t head_len = 0, plain_len = 0, pad_len = 0, en_len = 0;
+    size_t olen = 0;
+
+    head_len = __bench_head_write(buf);
+    plain_len = __bench_payload_head_write(buf + head_len, data_len);
+    pad_len = 16 - (plain_len + data_len) % 16;
+    memset(pkcs, pad_len, pad_len);
+
+    rt = mbedtls_gcm_starts(&sg_gcm_ctx, MBEDTLS_GCM_ENCRYPT, sg_iv, AI_IV_LEN);
+    if (OPRT_OK == rt) {
+        rt = mbedtls_gcm_update(&sg_gcm_ctx, buf + head_len, plain_len, buf + head_len, plain_len, &olen);
+    }
+    if (OPRT_OK == rt) {
+        rt = mbedtls_gcm_update(&sg_gcm_ctx, data, data_len, buf + head_len + plain_len, data_len, &olen);
+    }
+    plain_len += data_len;
+    if (OPRT_OK == rt) {
+        rt = mbedtls_gcm_update(&sg_gcm_ctx, pkcs, pad_len, buf + head_len + plain_len, pad_len, &olen);
+    }
+    en_len = plain_len + pad_len;
+    if (OPRT_OK == rt) {
+        rt = mbedtls_gcm_finish(&sg_gcm_ctx, NULL, 0, &olen, buf + head_len + en_len, AI_GCM_TAG_LEN);
+    }
+    TUYA_CALL_ERR_RETURN(rt);
+    en_len += AI_GCM_TAG_LEN;
+
+    TUYA_CALL_ERR_RETURN(__bench_sign(buf, head_len, en_len, buf + head_len + en_len));
+
+    if (__bench_transport_write(buf, head_len + en_len + AI_SIGN_LEN) < 0) {
+        return OPRT_COM_ERROR;
+    }
+    return OPRT_OK;
+}
+
+static OPERATE_RET __bench_check(const uint8_t *data, uint32_t data_len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t *copy_pkt = NULL;
+    uint32_t copy_len = 0;
+
+    copy_pkt = tal_malloc(AI_MAX_FRAGMENT_LENGTH);
+    TUYA_CHECK_NULL_RETURN(copy_pkt, OPRT_MALLOC_FAILED);
+
+    sg_keep_pkt = TRUE;
+    sg_sequence = 1;
+    rt = __bench_send_copy(data, data_len);
+    memcpy(copy_pkt, sg_last_pkt, sg_last_len);
+    copy_len = sg_last_len;
+    sg_sequence = 1;
+    if (OPRT_OK == rt) {
+        rt = __bench_send_inplace(data, data_len);
+    }
+    sg_keep_pkt = FALSE;
+
+    if (OPRT_OK == rt && (copy_len != sg_last_len || memcmp(copy_pkt, sg_last_pkt, copy_len))) {
+        PR_ERR("packets of %d bytes differ", data_len);
+        rt = OPRT_COM_ERROR;
+    }
+    tal_free(copy_pkt);
+    return rt;
+}
+
+static void __bench_run(const char *name, AI_BENCH_SEND_CB send, const uint8_t *data, uint32_t data_len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t i = 0, loops = 0;
+    SYS_TIME_T start = 0, ms = 0;
+
+    loops = AI_BENCH_TOTAL_BYTES / data_len;
+    if (loops < AI_BENCH_MIN_LOOPS) {
+        loops = AI_BENCH_MIN_LOOPS;
+    }
+
+    memset(&sg_stat, 0, sizeof(sg_stat));
+    start = tal_system_get_millisecond();
+    for (i = 0; i < loops && OPRT_OK == rt; i++) {
+        rt = send(data, data_len);
+    }
+    ms = tal_system_get_millisecond() - start;
+    if (OPRT_OK != rt) {
+        PR_ERR("%s: send failed, rt:%d", name, rt);
+        return;
+    }
+    if (0 == ms) {
+        ms = 1;
+    }
+
+    PR_NOTICE("%-8s %5d B: %7d packets/s, %6.1f MB/s, %6d B copied and %d allocs per packet", name, data_len,
+              (uint32_t)((uint64_t)sg_stat.packets * 1000 / ms),
+              (double)sg_stat.bytes * 1000 / ms / (1024 * 1024), sg_stat.copied / sg_stat.packets,
+              sg_stat.allocs / sg_stat.packets);
+}
+
+/**
+ * @brief user_main
+ *
+ * @return void
+ */
+void user_main(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t *data = NULL;
+    uint32_t i = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+
+    PR_NOTICE("ai send bench, SL4, fragment %d bytes", AI_MAX_FRAGMENT_LENGTH);
+
+    for (i = 0; i < AI_KEY_LEN; i++) {
+        sg_crypt_key[i] = (uint8_t)tal_system_get_random(0xFF);
+        sg_sign_key[i] = (uint8_t)tal_system_get_random(0xFF);
+    }
+    for (i = 0; i < AI_IV_LEN; i++) {
+        sg_iv[i] = (uint8_t)tal_system_get_random(0xFF);
+    }
+
+    mbedtls_gcm_init(&sg_gcm_ctx);
+    rt = mbedtls_gcm_setkey(&sg_gcm_ctx, MBEDTLS_CIPHER_ID_AES, sg_crypt_key, AI_KEY_LEN * 8);
+    if (OPRT_OK != rt) {
+        PR_ERR("gcm setkey failed, rt:%d", rt);
+        goto __EXIT;
+    }
+
+    data = tal_malloc(AI_MAX_FRAGMENT_LENGTH);
+    sg_send_buf = tal_malloc(AI_MAX_FRAGMENT_LENGTH);
+    sg_last_pkt = tal_malloc(AI_MAX_FRAGMENT_LENGTH);
+    if (NULL == data || NULL == sg_send_buf || NULL == sg_last_pkt) {
+        PR_ERR("malloc failed");
+        goto __EXIT;
+    }
+    for (i = 0; i < AI_MAX_FRAGMENT_LENGTH; i++) {
+        data[i] = (uint8_t)tal_system_get_random(0xFF);
+    }
+
+    for (i = 0; i < CNTSOF(sg_data_len); i++) {
+        rt = __bench_check(data, sg_data_len[i]);
+        if (OPRT_OK != rt) {
+            goto __EXIT;
+        }
+        __bench_run("copy", __bench_send_copy, data, sg_data_len[i]);
+        __bench_run("in place", __bench_send_inplace, data, sg_data_len[i]);
+    }
+
+__EXIT:
+    mbedtls_gcm_free(&sg_gcm_ctx);
+    if (data) {
+        tal_free(data);
+    }
+    if (sg_send_buf) {
+        tal_free(sg_send_buf);
+    }
+    if (sg_last_pkt) {
+        tal_free(sg_last_pkt);
+    }
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+    while (1) {
+        tal_system_sleep(500);
+    }
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
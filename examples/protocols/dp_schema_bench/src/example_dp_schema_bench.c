@@ -0,0 +1,414 @@
+/**
+ * @file example_dp_schema_bench.c
+ * @brief Throughput of the DP report and command paths of dp_schema at 10, 50 and 200 DPs.
+ *
+ * A schema with the given number of DPs (bool, value, string and enum in turn) is created with dp_schema_create().
+ * Every round reports all DPs through dp_rept_valid_check() and dp_rept_json_output(), the steps of
+ * tuya_iot_dp_obj_report() before the channel, and parses a command that sets all DPs with dp_data_recv_parse().
+ *
+ * The MQTT command path is then measured end to end on the whole decrypted message, once with cJSON_Parse() and
+ * dp_data_recv_parse() as before, and once with the streaming reader and dp_data_recv_parse_str(). cJSON allocates
+ * through counting hooks, so the heap peak of the tree is exact; the other buffers of both paths have a known size.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "dp_schema.h"
+#include "tuya_json_reader.h"
+#include "cJSON.h"
+
+#include "tal_api.h"
+#include "tkl_output.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define DP_BENCH_LOOPS   1000
+#define DP_BENCH_DEVID   "dpbench0000000000000000"
+#define DP_BENCH_ITEM_LEN 128
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static const uint16_t sg_dp_num[] = {10, 50, 200};
+
+static uint32_t sg_recv_dps = 0;
+
+static uint32_t sg_heap_cur = 0;
+static uint32_t sg_heap_peak = 0;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+/* the schema and a command json of num DPs, ids 1..num */
+static OPERATE_RET __bench_json_build(uint16_t num, char **schema_json, char **cmd_json)
+{
+    char *schema = NULL, *cmd = NULL;
+    uint32_t s_off = 0, c_off = 0;
+    uint16_t i = 0, id = 0;
+
+    schema = tal_malloc(num * DP_BENCH_ITEM_LEN + 2);
+    cmd = tal_malloc(num * DP_BENCH_ITEM_LEN / 2 + 16);
+    if (NULL == schema || NULL == cmd) {
+        tal_free(schema);
+        tal_free(cmd);
+        return OPRT_MALLOC_FAILED;
+    }
+
+    s_off += sprintf(schema + s_off, "[");
+    c_off += sprintf(cmd + c_off, "{\"dps\":{");
+    for (i = 0; i < num; i++) {
+        id = i + 1;
+        switch (i % 4) {
+        case PROP_BOOL:
+            s_off += sprintf(schema + s_off, "{\"id\":%d,\"mode\":\"rw\",\"type\":\"obj\",\"property\":{\"type\":\"bool\"}},",
+                             id);
+            c_off += sprintf(cmd + c_off, "\"%d\":true,", id);
+            break;
+        case PROP_VALUE:
+            s_off += sprintf(schema + s_off,
+                             "{\"id\":%d,\"mode\":\"rw\",\"type\":\"obj\",\"property\":{\"type\":\"value\",\"max\":1000,"
+                             "\"min\":0,\"scale\":0}},",
+                             id);
+            c_off += sprintf(cmd + c_off, "\"%d\":%d,", id, id * 3);
+            break;
+        case PROP_STR:
+            s_off += sprintf(
+                schema + s_off,
+                "{\"id\":%d,\"mode\":\"rw\",\"type\":\"obj\",\"property\":{\"type\":\"string\",\"maxlen\":255}},", id);
+            c_off += sprintf(cmd + c_off, "\"%d\":\"scene %d\",", id, id);
+            break;
+        default:
+            s_off += sprintf(schema + s_off,
+                             "{\"id\":%d,\"mode\":\"rw\",\"type\":\"obj\",\"property\":{\"type\":\"enum\",\"range\":"
+                             "[\"white\",\"colour\",\"scene\",\"music\"]}},",
+                             id);
+            c_off += sprintf(cmd + c_off, "\"%d\":\"scene\",", id);
+            break;
+        }
+    }
+    schema[s_off - 1] = ']';
+    cmd[c_off - 1] = '}';
+    cmd[c_off++] = '}';
+    cmd[c_off] = '\0';
+
+    *schema_json = schema;
+    *cmd_json = cmd;
+
+    return OPRT_OK;
+}
+
+static void __bench_dps_fill(dp_obj_t *dps, uint16_t num, uint32_t round)
+{
+    static char str[DP_ID_INDEX_NUM][16];
+    uint16_t i = 0;
+
+    for (i = 0; i < num; i++) {
+        dps[i].id = i + 1;
+        dps[i].type = i % 4;
+        dps[i].time_stamp = 0;
+        switch (dps[i].type) {
+        case PROP_BOOL:
+            dps[i].value.dp_bool = round & 1;
+            break;
+        case PROP_VALUE:
+            dps[i].value.dp_value = (round + i) % 1000;
+            break;
+        case PROP_STR:
+            snprintf(str[i], sizeof(str[i]), "scene %d", (int)((round + i) % 100));
+            dps[i].value.dp_str = str[i];
+            break;
+        default:
+            dps[i].value.dp_enum = (round + i) % 4;
+            break;
+        }
+    }
+}
+
+static void __bench_recv_cb(dp_type_t type, void *dp_data, void *user_data)
+{
+    sg_recv_dps += ((dp_obj_recv_t *)dp_data)->dpscnt;
+}
+
+/* cJSON hooks that keep the size in front of the block */
+static void *__bench_malloc(size_t size)
+{
+    uint64_t *p = tal_malloc(sizeof(uint64_t) + size);
+    if (NULL == p) {
+        return NULL;
+    }
+    p[0] = size;
+    sg_heap_cur += size;
+    if (sg_heap_cur > sg_heap_peak) {
+        sg_heap_peak = sg_heap_cur;
+    }
+    return p + 1;
+}
+
+static void __bench_free(void *ptr)
+{
+    uint64_t *p = ptr;
+    if (NULL == p) {
+        return;
+    }
+    sg_heap_cur -= p[-1];
+    tal_free(p - 1);
+}
+
+/* bytes taken from the heap by dp_recv_buf_malloc(), 0 when the pool has a block */
+static uint32_t __bench_buf_heap(uint32_t size)
+{
+    return (DP_RECV_POOL_NUM > 0 && size <= DP_RECV_POOL_SIZE) ? 0 : size;
+}
+
+/* a whole PRO_CMD message through the former path: cJSON tree, then dp_data_recv_parse() */
+static void __bench_cmd_cjson(const char *mqtt_json)
+{
+    dp_recv_msg_t msg;
+    cJSON *root = cJSON_Parse(mqtt_json);
+
+    if (NULL == root) {
+        return;
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.devid = DP_BENCH_DEVID;
+    msg.cmd = DP_CMD_MQ;
+    msg.dt_tp = DTT_SCT_UNC;
+    msg.data_js = cJSON_GetObjectItem(root, "data");
+    dp_data_recv_parse(&msg, __bench_recv_cb);
+    cJSON_Delete(root);
+}
+
+/* a whole PRO_CMD message through the streaming path: envelope, copy of data, dp_data_recv_parse_str() */
+static void __bench_cmd_stream(char *mqtt_json, size_t len)
+{
+    tuya_json_reader_t reader;
+    const char *key = NULL;
+    size_t key_len = 0;
+    char *data = NULL;
+    size_t data_len = 0;
+    dp_recv_msg_t *msg = NULL;
+
+    tuya_json_reader_init(&reader, mqtt_json, len);
+    tuya_json_reader_object_enter(&reader);
+    while (1 == tuya_json_reader_object_next(&reader, &key, &key_len)) {
+        if (4 == key_len && 0 == memcmp(key, "data", 4)) {
+            tuya_json_reader_skip(&reader, &data, &data_len);
+        } else {
+            tuya_json_reader_skip(&reader, NULL, NULL);
+        }
+    }
+    if (NULL == data) {
+        return;
+    }
+
+    msg = dp_recv_buf_malloc(sizeof(dp_recv_msg_t) + data_len + 1);
+    if (NULL == msg) {
+        return;
+    }
+    memset(msg, 0, sizeof(dp_recv_msg_t));
+    msg->devid = DP_BENCH_DEVID;
+    msg->cmd = DP_CMD_MQ;
+    msg->dt_tp = DTT_SCT_UNC;
+    msg->data_str = (char *)(msg + 1);
+    msg->data_len = data_len;
+    memcpy(msg->data_str, data, data_len);
+    msg->data_str[data_len] = '\0';
+    dp_data_recv_parse_str(msg, __bench_recv_cb);
+    dp_recv_buf_free(msg);
+}
+
+/* one command per round through both MQTT paths, with the heap peak of one command */
+static void __bench_cmd_run(uint16_t num, const char *cmd_json)
+{
+    char *mqtt_json = NULL;
+    size_t len = 0;
+    SYS_TIME_T start = 0, cjson_ms = 0, stream_ms = 0;
+    uint32_t i = 0, cjson_dps = 0, stream_dps = 0, cjson_heap = 0, stream_heap = 0;
+    uint32_t dpobj_len = sizeof(dp_obj_recv_t) + num * sizeof(dp_obj_t);
+
+    len = strlen(cmd_json) + 64;
+    mqtt_json = tal_malloc(len);
+    if (NULL == mqtt_json) {
+        return;
+    }
+    len = sprintf(mqtt_json, "{\"data\":%s,\"protocol\":5,\"t\":1735689600}", cmd_json);
+
+    cJSON_InitHooks(&(cJSON_Hooks){.malloc_fn = __bench_malloc, .free_fn = __bench_free});
+    sg_heap_cur = sg_heap_peak = 0;
+    sg_recv_dps = 0;
+    start = tal_system_get_millisecond();
+    for (i = 0; i < DP_BENCH_LOOPS; i++) {
+        __bench_cmd_cjson(mqtt_json);
+    }
+    cjson_ms = tal_system_get_millisecond() - start;
+    cjson_dps = sg_recv_dps;
+    cJSON_InitHooks(&(cJSON_Hooks){.malloc_fn = tal_malloc, .free_fn = tal_free});
+    // the tree lives until the dp_obj_recv_t is handed out
+    cjson_heap = sg_heap_peak + dpobj_len;
+
+    // the message is decoded in place, every round works on a fresh copy like the mqtt buffer
+    char *work = tal_malloc(len + 1);
+    if (NULL == work) {
+        tal_free(mqtt_json);
+        return;
+    }
+    sg_recv_dps = 0;
+    start = tal_system_get_millisecond();
+    for (i = 0; i < DP_BENCH_LOOPS; i++) {
+        memcpy(work, mqtt_json, len + 1);
+        __bench_cmd_stream(work, len);
+    }
+    stream_ms = tal_system_get_millisecond() - start;
+    stream_dps = sg_recv_dps;
+    stream_heap = __bench_buf_heap(sizeof(dp_recv_msg_t) + strlen(cmd_json) + 1) + __bench_buf_heap(dpobj_len);
+
+    PR_NOTICE("%3d dps: cmd %5d B | cjson %6d us/cmd heap %6d B dps %d | stream %6d us/cmd heap %6d B dps %d", num,
+              (uint32_t)len, (uint32_t)(cjson_ms * 1000 / DP_BENCH_LOOPS), cjson_heap, cjson_dps / DP_BENCH_LOOPS,
+              (uint32_t)(stream_ms * 1000 / DP_BENCH_LOOPS), stream_heap, stream_dps / DP_BENCH_LOOPS);
+
+    tal_free(work);
+    tal_free(mqtt_json);
+}
+
+static void __bench_run(uint16_t num)
+{
+    char *schema_json = NULL, *cmd_json = NULL;
+    dp_schema_t *schema = NULL;
+    dp_obj_t *dps = NULL;
+    dp_rept_valid_t *dpvalid = NULL;
+    dp_rept_in_t dpin;
+    dp_rept_out_t dpout;
+    dp_recv_msg_t msg;
+    SYS_TIME_T start = 0, rept_ms = 0, parse_ms = 0;
+    uint32_t i = 0, fails = 0, json_len = 0;
+
+    if (OPRT_OK != __bench_json_build(num, &schema_json, &cmd_json)) {
+        PR_ERR("json build fail");
+        return;
+    }
+    if (OPRT_OK != dp_schema_create(DP_BENCH_DEVID, schema_json, &schema)) {
+        PR_ERR("schema create fail");
+        goto __EXIT;
+    }
+
+    dps = tal_malloc(num * sizeof(dp_obj_t));
+    dpvalid = tal_malloc(sizeof(dp_rept_valid_t) + num);
+    if (NULL == dps || NULL == dpvalid) {
+        goto __EXIT;
+    }
+
+    // report: every value changes each round so no dp is filtered
+    start = tal_system_get_millisecond();
+    for (i = 0; i < DP_BENCH_LOOPS; i++) {
+        __bench_dps_fill(dps, num, i);
+        memset(dpvalid, 0, sizeof(dp_rept_valid_t) + num);
+        memset(&dpout, 0, sizeof(dpout));
+        dpin.rept_type = T_OBJ_REPT;
+        dpin.flags = DP_REPT_NO_FILTER_FLAG;
+        dpin.dps = dps;
+        dpin.dpscnt = num;
+        if (OPRT_OK != dp_rept_valid_check(schema, &dpin, dpvalid) ||
+            OPRT_OK != dp_rept_json_output(schema, &dpin, dpvalid, &dpout)) {
+            fails++;
+            continue;
+        }
+        json_len = strlen(dpout.dpsjson);
+        tal_free(dpout.dpsjson);
+    }
+    rept_ms = tal_system_get_millisecond() - start;
+
+    // command: the json is parsed once, dp_data_recv_parse walks it every round
+    memset(&msg, 0, sizeof(msg));
+    msg.devid = DP_BENCH_DEVID;
+    msg.cmd = DP_CMD_MQ;
+    msg.dt_tp = DTT_SCT_UNC;
+    msg.data_js = cJSON_Parse(cmd_json);
+    if (NULL == msg.data_js) {
+        PR_ERR("cmd parse fail");
+        goto __EXIT;
+    }
+    sg_recv_dps = 0;
+    start = tal_system_get_millisecond();
+    for (i = 0; i < DP_BENCH_LOOPS; i++) {
+        dp_data_recv_parse(&msg, __bench_recv_cb);
+    }
+    parse_ms = tal_system_get_millisecond() - start;
+    cJSON_Delete(msg.data_js);
+
+    PR_NOTICE("%3d dps: report %6d us/call %7d dps/s json %5d B fail %d | parse %6d us/call %7d dps/s", num,
+              (uint32_t)(rept_ms * 1000 / DP_BENCH_LOOPS),
+              rept_ms ? (uint32_t)((uint64_t)num * DP_BENCH_LOOPS * 1000 / rept_ms) : 0, json_len, fails,
+              (uint32_t)(parse_ms * 1000 / DP_BENCH_LOOPS),
+              parse_ms ? (uint32_t)((uint64_t)sg_recv_dps * 1000 / parse_ms) : 0);
+
+    __bench_cmd_run(num, cmd_json);
+
+__EXIT:
+    if (schema) {
+        dp_schema_delete(DP_BENCH_DEVID);
+    }
+    tal_free(dpvalid);
+    tal_free(dps);
+    tal_free(schema_json);
+    tal_free(cmd_json);
+}
+
+/**
+ * @brief user_main
+ *
+ * @return void
+ */
+void user_main(void)
+{
+    uint32_t i = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+
+    for (i = 0; i < CNTSOF(sg_dp_num); i++) {
+        __bench_run(sg_dp_num[i]);
+    }
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+    while (1) {
+        tal_system_sleep(500);
+    }
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
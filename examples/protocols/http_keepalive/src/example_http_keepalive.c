@@ -0,0 +1,275 @@
+/**
+ * @file example_http_keepalive.c
+ * @brief Benchmark of the HTTP client connection pool and TLS session resumption.
+ *
+ * A small HTTP/1.1 server runs on the loopback interface in its own thread. The client sends the same GET request
+ * many times through http_client_request(), first with the keep-alive pool and then with the pool flushed after every
+ * request (one connection per request, the old behaviour), and prints requests per second together with the connection
+ * counters of the pool.
+ *
+ * When BENCH_HTTPS_HOST is defined the rounds run against that HTTPS server as well, with a third round that drops the
+ * TLS session cache after every request, and the TLS counters show how many connects needed a full handshake and how
+ * many resumed the cached session.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "http_client_interface.h"
+#include "tuya_tls.h"
+
+#include "tal_api.h"
+#include "tal_network.h"
+#include "tkl_output.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define BENCH_SERVER_IP   "127.0.0.1"
+#define BENCH_SERVER_PORT 8080
+#define BENCH_REQUESTS    500
+#define BENCH_TIMEOUT_MS  (5 * 1000)
+
+#define BENCH_RECV_LEN 1024
+
+// an HTTPS server that answers with Content-Length and keeps the connection, see README.md
+// #define BENCH_HTTPS_HOST   "127.0.0.1"
+// #define BENCH_HTTPS_PORT   4433
+// #define BENCH_HTTPS_CACERT "-----BEGIN CERTIFICATE-----\n...\n-----END CERTIFICATE-----\n"
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef enum {
+    BENCH_KEEP_ALIVE = 0, // one kept connection for all requests
+    BENCH_RESUME,         // a new connection per request, TLS session resumed
+    BENCH_FULL,           // a new connection and a full TLS handshake per request
+} BENCH_MODE_E;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static THREAD_HANDLE sg_server_thrd = NULL;
+
+static const char *sg_mode_name[] = {"keep-alive", "resume", "full"};
+
+static const char sg_bench_response[] = "HTTP/1.1 200 OK\r\n"
+                                        "Content-Type: text/plain\r\n"
+                                        "Content-Length: 2\r\n"
+                                        "Connection: keep-alive\r\n"
+                                        "\r\n"
+                                        "ok";
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+/* answers every request of one connection until the client closes it */
+static void __bench_server_serve(int fd)
+{
+    char buf[BENCH_RECV_LEN + 1];
+    int len = 0, ret = 0;
+    char *end = NULL;
+
+    for (;;) {
+        ret = tal_net_recv(fd, buf + len, BENCH_RECV_LEN - len);
+        if (ret <= 0) {
+            break;
+        }
+        len += ret;
+        buf[len] = '\0';
+
+        // GET requests carry no body, the header end completes a request
+        while (NULL != (end = strstr(buf, "\r\n\r\n"))) {
+            if (tal_net_send(fd, sg_bench_response, strlen(sg_bench_response)) < 0) {
+                return;
+            }
+            end += 4;
+            len -= (end - buf);
+            memmove(buf, end, len + 1);
+        }
+
+        if (len >= BENCH_RECV_LEN) {
+            break;
+        }
+    }
+}
+
+static void __bench_server_task(void *args)
+{
+    int listen_fd = -1, fd = -1;
+    TUYA_IP_ADDR_T addr = 0;
+    uint16_t port = 0;
+
+    listen_fd = tal_net_socket_create(PROTOCOL_TCP);
+    if (listen_fd < 0) {
+        PR_ERR("server socket create fail");
+        goto __EXIT;
+    }
+
+    tal_net_set_reuse(listen_fd);
+    if (tal_net_bind(listen_fd, tal_net_str2addr(BENCH_SERVER_IP), BENCH_SERVER_PORT) < 0 ||
+        tal_net_listen(listen_fd, 4) < 0) {
+        PR_ERR("server bind %s:%d fail", BENCH_SERVER_IP, BENCH_SERVER_PORT);
+        goto __EXIT;
+    }
+
+    for (;;) {
+        fd = tal_net_accept(listen_fd, &addr, &port);
+        if (fd < 0) {
+            continue;
+        }
+        tal_net_disable_nagle(fd);
+        __bench_server_serve(fd);
+        tal_net_close(fd);
+    }
+
+__EXIT:
+    if (listen_fd >= 0) {
+        tal_net_close(listen_fd);
+    }
+    tal_thread_delete(sg_server_thrd);
+    sg_server_thrd = NULL;
+}
+
+/* sends BENCH_REQUESTS requests and prints the rate and the connection counters */
+static void __bench_run(const char *name, const http_client_request_t *request, BENCH_MODE_E mode)
+{
+    http_client_response_t response;
+    http_client_pool_stat_t pool_start, pool_end;
+    tuya_tls_stat_t tls_start, tls_end;
+    SYS_TIME_T start = 0, ms = 0;
+    uint32_t i = 0, fails = 0;
+
+    http_client_pool_flush();
+    tuya_tls_session_cache_clear();
+    http_client_pool_stat_get(&pool_start);
+    tuya_tls_stat_get(&tls_start);
+
+    start = tal_system_get_millisecond();
+    for (i = 0; i < BENCH_REQUESTS; i++) {
+        memset(&response, 0, sizeof(response));
+        if (HTTP_CLIENT_SUCCESS != http_client_request(request, &response) || 200 != response.status_code) {
+            fails++;
+        }
+        http_client_free(&response);
+
+        if (mode != BENCH_KEEP_ALIVE) {
+            http_client_pool_flush();
+        }
+        if (mode == BENCH_FULL) {
+            tuya_tls_session_cache_clear();
+        }
+    }
+    ms = tal_system_get_millisecond() - start;
+    if (0 == ms) {
+        ms = 1;
+    }
+
+    http_client_pool_stat_get(&pool_end);
+    tuya_tls_stat_get(&tls_end);
+
+    PR_NOTICE("%-6s %-10s %4d req, %6d req/s, fail %d, connects %d, reuses %d, retries %d", name,
+              sg_mode_name[mode], BENCH_REQUESTS, (uint32_t)(BENCH_REQUESTS * 1000 / ms), fails,
+              pool_end.connects - pool_start.connects, pool_end.reuses - pool_start.reuses,
+              pool_end.retries - pool_start.retries);
+    PR_NOTICE("%-6s %-10s handshakes full %d, resumed %d, failed %d", name, sg_mode_name[mode],
+              tls_end.full_handshakes - tls_start.full_handshakes,
+              tls_end.resumed_handshakes - tls_start.resumed_handshakes,
+              tls_end.failed_handshakes - tls_start.failed_handshakes);
+}
+
+/**
+ * @brief user_main
+ *
+ * @return void
+ */
+void user_main(void)
+{
+    THREAD_CFG_T thread_cfg = {
+        .thrdname = "bench_http_srv",
+        .stackDepth = 4096,
+        .priority = THREAD_PRIO_2,
+    };
+
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+    tuya_tls_init();
+
+    if (OPRT_OK !=
+        tal_thread_create_and_start(&sg_server_thrd, NULL, NULL, __bench_server_task, NULL, &thread_cfg)) {
+        PR_ERR("server thread create fail");
+        return;
+    }
+    // let the server reach accept()
+    tal_system_sleep(200);
+
+    http_client_header_t headers[] = {{.key = "Accept", .value = "*/*"}};
+    http_client_request_t request = {
+        .host = BENCH_SERVER_IP,
+        .port = BENCH_SERVER_PORT,
+        .method = "GET",
+        .path = "/",
+        .headers = headers,
+        .headers_count = sizeof(headers) / sizeof(http_client_header_t),
+        .body = (const uint8_t *)"",
+        .body_length = 0,
+        .timeout_ms = BENCH_TIMEOUT_MS,
+    };
+
+    __bench_run("http", &request, BENCH_KEEP_ALIVE);
+    __bench_run("http", &request, BENCH_FULL);
+
+#if defined(BENCH_HTTPS_HOST)
+    request.host = BENCH_HTTPS_HOST;
+    request.port = BENCH_HTTPS_PORT;
+    request.cacert = (const uint8_t *)BENCH_HTTPS_CACERT;
+    request.cacert_len = sizeof(BENCH_HTTPS_CACERT);
+
+    __bench_run("https", &request, BENCH_KEEP_ALIVE);
+    __bench_run("https", &request, BENCH_RESUME);
+    __bench_run("https", &request, BENCH_FULL);
+#endif
+
+    http_client_pool_flush();
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+    while (1) {
+        tal_system_sleep(500);
+    }
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
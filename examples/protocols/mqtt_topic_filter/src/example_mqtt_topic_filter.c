@@ -0,0 +1,567 @@
+/**
+ * @file example_mqtt_topic_filter.c
+ * @brief Checks the topic filters and the PUBACK index of mqtt_service against a broker on the loopback interface.
+ *
+ * A minimal MQTT 3.1.1 broker runs on a thread of its own and mqtt_service connects to it over TCP. The device
+ * subscribes a set of filters with '+', '#' and '$' topics, plus 1000 exact topics, and asks the broker to publish
+ * random topics. Each topic is followed by a marker message, whose handler compares the handlers that were called
+ * with a reference matcher written from section 4.7 of the MQTT specification. The same topics are sent again once
+ * all filters are unsubscribed, and must reach no handler.
+ *
+ * QoS 1 publishes are then acknowledged out of order. The broker holds back the acknowledgement of every third
+ * packet id until the device has seen those publishes time out, and sends it late: it must be ignored.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "mqtt_service.h"
+
+#include "tal_api.h"
+#include "tal_network.h"
+#include "tkl_output.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define MQTT_FILTER_PORT        18830
+#define MQTT_FILTER_TOPIC_NUM   2000
+#define MQTT_FILTER_EXACT_NUM   1000
+#define MQTT_FILTER_TOPIC_LEN   64
+#define MQTT_FILTER_PUB_ROUNDS  3
+#define MQTT_FILTER_PUB_NUM     8 // below the 10 QoS 1 publishes coreMQTT keeps in flight
+#define MQTT_FILTER_PUB_TIMEOUT 3 // seconds, as tuya_mqtt_loop() compares it to the posix time
+#define MQTT_FILTER_IDLE_MS     50
+
+#define MQTT_FILTER_REQ_TOPIC  "bench/req"
+#define MQTT_FILTER_PUB_TOPIC  "bench/pub"
+#define MQTT_FILTER_DONE_TOPIC "$bench/done"
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static const char *sg_filters[] = {"a/+/c", "a/#",   "#",       "+/b/+",   "$SYS/#", "$SYS/+", "a/",  "a//c",
+                                   "+",     "+/+",   "a/b/c",   "b",       "a/b",    "+/#",    "a/+", "b/+/#",
+                                   "/a",    "/+",    "+/",      "a/b/c/#", "c/+/+/+", "b/b",   "$x",  "a/+/+/#"};
+static const char *sg_levels[] = {"a", "b", "c", "", "$SYS", "$x"};
+
+static char sg_topics[MQTT_FILTER_TOPIC_NUM][MQTT_FILTER_TOPIC_LEN];
+
+/* calls of each filter handler, then of each exact topic handler, since the last marker */
+static uint32_t sg_calls[CNTSOF(sg_filters) + MQTT_FILTER_EXACT_NUM];
+static uint32_t sg_second_calls = 0;
+static uint32_t sg_done = 0;
+static uint32_t sg_deliveries = 0;
+static uint32_t sg_errors = 0;
+static BOOL_T sg_subscribed = TRUE;
+
+static uint32_t sg_pub_ok = 0;
+static uint32_t sg_pub_timeout = 0;
+static uint8_t sg_pub_result[MQTT_FILTER_PUB_NUM];
+
+static SEM_HANDLE sg_broker_ready = NULL;
+static THREAD_HANDLE sg_broker_thrd = NULL;
+static uint32_t sg_broker_acks = 0;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+/* reference matcher, MQTT 3.1.1 section 4.7 */
+static BOOL_T __topic_match(const char *filter, const char *topic)
+{
+    const char *f_end = NULL, *t_end = NULL;
+    size_t f_len = 0, t_len = 0;
+
+    // wildcards at the first level do not match topics starting with '$'
+    if ('$' == topic[0] && ('+' == filter[0] || '#' == filter[0])) {
+        return FALSE;
+    }
+
+    for (;;) {
+        if ('#' == filter[0] && '\0' == filter[1]) {
+            return TRUE;
+        }
+        f_end = strchr(filter, '/');
+        t_end = strchr(topic, '/');
+        f_len = f_end ? (size_t)(f_end - filter) : strlen(filter);
+        t_len = t_end ? (size_t)(t_end - topic) : strlen(topic);
+        if (!(1 == f_len && '+' == filter[0]) && (f_len != t_len || memcmp(filter, topic, f_len))) {
+            return FALSE;
+        }
+        if (NULL == f_end && NULL == t_end) {
+            return TRUE;
+        }
+        if (NULL == t_end) {
+            // "a/#" also matches its parent level "a"
+            return (f_end && 0 == strcmp(f_end + 1, "#")) ? TRUE : FALSE;
+        }
+        if (NULL == f_end) {
+            return FALSE;
+        }
+        filter = f_end + 1;
+        topic = t_end + 1;
+    }
+}
+
+/* --------------------------------- broker --------------------------------- */
+static int __broker_recv_all(int fd, uint8_t *buf, uint32_t len)
+{
+    uint32_t offset = 0;
+    int ret = 0;
+
+    while (offset < len) {
+        ret = tal_net_recv(fd, buf + offset, len - offset);
+        if (ret <= 0) {
+            return -1;
+        }
+        offset += ret;
+    }
+    return 0;
+}
+
+static int __broker_packet_read(int fd, uint8_t *type, uint8_t *body, uint32_t size, uint32_t *len)
+{
+    uint8_t byte = 0;
+    uint32_t shift = 0;
+
+    *len = 0;
+    if (__broker_recv_all(fd, type, 1)) {
+        return -1;
+    }
+    do {
+        if (__broker_recv_all(fd, &byte, 1) || shift > 21) {
+            return -1;
+        }
+        *len |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    if (*len > size) {
+        return -1;
+    }
+    return __broker_recv_all(fd, body, *len);
+}
+
+static void __broker_ack_send(int fd, uint8_t type, uint16_t msgid)
+{
+    uint8_t ack[4] = {type, 0x02, msgid >> 8, msgid & 0xFF};
+
+    tal_net_send(fd, ack, sizeof(ack));
+}
+
+static void __broker_publish_send(int fd, const char *topic, const char *payload)
+{
+    uint8_t packet[8 + MQTT_FILTER_TOPIC_LEN + 16];
+    uint32_t topic_len = strlen(topic), payload_len = strlen(payload);
+    uint32_t remain = 2 + topic_len + payload_len, offset = 0;
+
+    packet[offset++] = 0x30;
+    do {
+        packet[offset] = remain & 0x7F;
+        remain >>= 7;
+        packet[offset++] |= remain ? 0x80 : 0;
+    } while (remain);
+    packet[offset++] = topic_len >> 8;
+    packet[offset++] = topic_len & 0xFF;
+    memcpy(packet + offset, topic, topic_len);
+    offset += topic_len;
+    memcpy(packet + offset, payload, payload_len);
+    offset += payload_len;
+    tal_net_send(fd, packet, offset);
+}
+
+/* acknowledges the held publishes newest first, keeps every third packet id for a late acknowledgement */
+static void __broker_acks_send(int fd, uint16_t *held, uint32_t *held_num, uint16_t *late, uint32_t *late_num)
+{
+    while (*held_num > 0) {
+        uint16_t msgid = held[--(*held_num)];
+        if (0 == msgid % 3) {
+            late[(*late_num)++] = msgid;
+            continue;
+        }
+        __broker_ack_send(fd, 0x40, msgid);
+        sg_broker_acks++;
+    }
+}
+
+static void __broker_request(int fd, const uint8_t *payload, uint32_t len, uint16_t *held, uint32_t *held_num,
+                             uint16_t *late, uint32_t *late_num)
+{
+    char index[12];
+    uint32_t i = 0;
+
+    if (5 == len && 0 == memcmp(payload, "match", len)) {
+        for (i = 0; i < MQTT_FILTER_TOPIC_NUM; i++) {
+            snprintf(index, sizeof(index), "%d", i);
+            __broker_publish_send(fd, sg_topics[i], index);
+            __broker_publish_send(fd, MQTT_FILTER_DONE_TOPIC, index);
+        }
+    } else if (3 == len && 0 == memcmp(payload, "ack", len)) {
+        __broker_acks_send(fd, held, held_num, late, late_num);
+    } else if (4 == len && 0 == memcmp(payload, "late", len)) {
+        for (i = 0; i < *late_num; i++) {
+            __broker_ack_send(fd, 0x40, late[i]);
+        }
+        *late_num = 0;
+    }
+}
+
+static void __broker_task(void *args)
+{
+    static uint8_t body[2048];
+    uint16_t held[MQTT_FILTER_PUB_NUM], late[MQTT_FILTER_PUB_NUM];
+    uint32_t held_num = 0, late_num = 0;
+    uint32_t len = 0, offset = 0, count = 0;
+    uint16_t msgid = 0, topic_len = 0;
+    uint8_t type = 0, suback[4 + 8];
+    BOOL_T connected = FALSE;
+    TUYA_IP_ADDR_T addr = 0;
+    uint16_t port = 0;
+    TUYA_FD_SET_T readfds;
+    int listen_fd = -1, fd = -1;
+
+    listen_fd = tal_net_socket_create(PROTOCOL_TCP);
+    if (listen_fd < 0 || OPRT_OK != tal_net_set_reuse(listen_fd) ||
+        tal_net_bind(listen_fd, tal_net_str2addr("127.0.0.1"), MQTT_FILTER_PORT) < 0 ||
+        tal_net_listen(listen_fd, 1) < 0) {
+        PR_ERR("broker listen fail");
+        tal_semaphore_post(sg_broker_ready);
+        goto __EXIT;
+    }
+    tal_semaphore_post(sg_broker_ready);
+
+    fd = tal_net_accept(listen_fd, &addr, &port);
+    while (fd >= 0) {
+        // the client reads with a 5 s timeout over tcp, an idle PINGRESP lets its process loop return in time
+        tal_net_fd_zero(&readfds);
+        tal_net_fd_set(fd, &readfds);
+        if (0 == tal_net_select(fd + 1, &readfds, NULL, NULL, MQTT_FILTER_IDLE_MS)) {
+            if (connected) {
+                uint8_t pingresp[2] = {0xD0, 0x00};
+                tal_net_send(fd, pingresp, sizeof(pingresp));
+            }
+            continue;
+        }
+
+        if (__broker_packet_read(fd, &type, body, sizeof(body), &len)) {
+            break;
+        }
+        switch (type & 0xF0) {
+        case 0x10: { // CONNECT
+            uint8_t connack[4] = {0x20, 0x02, 0x00, 0x00};
+            tal_net_send(fd, connack, sizeof(connack));
+            connected = TRUE;
+            break;
+        }
+        case 0x80: // SUBSCRIBE, one granted QoS 1 per filter
+            for (offset = 2, count = 0; offset + 2 < len && count < 8; count++) {
+                offset += 2 + ((body[offset] << 8) | body[offset + 1]) + 1;
+            }
+            suback[0] = 0x90;
+            suback[1] = 2 + count;
+            suback[2] = body[0];
+            suback[3] = body[1];
+            memset(suback + 4, 0x01, count);
+            tal_net_send(fd, suback, 4 + count);
+            break;
+        case 0xA0: // UNSUBSCRIBE
+            __broker_ack_send(fd, 0xB0, (body[0] << 8) | body[1]);
+            break;
+        case 0x30: // PUBLISH
+            topic_len = (body[0] << 8) | body[1];
+            offset = 2 + topic_len;
+            if (type & 0x06) {
+                msgid = (body[offset] << 8) | body[offset + 1];
+                offset += 2;
+                if (held_num < MQTT_FILTER_PUB_NUM) {
+                    held[held_num++] = msgid;
+                }
+            } else if (topic_len == strlen(MQTT_FILTER_REQ_TOPIC) &&
+                       0 == memcmp(body + 2, MQTT_FILTER_REQ_TOPIC, topic_len)) {
+                __broker_request(fd, body + offset, len - offset, held, &held_num, late, &late_num);
+            }
+            break;
+        case 0xC0: { // PINGREQ
+            uint8_t pingresp[2] = {0xD0, 0x00};
+            tal_net_send(fd, pingresp, sizeof(pingresp));
+            break;
+        }
+        case 0xE0: // DISCONNECT
+            tal_net_close(fd);
+            fd = -1;
+            break;
+        default:
+            break;
+        }
+    }
+
+__EXIT:
+    if (fd >= 0) {
+        tal_net_close(fd);
+    }
+    if (listen_fd >= 0) {
+        tal_net_close(listen_fd);
+    }
+    tal_thread_delete(sg_broker_thrd);
+    sg_broker_thrd = NULL;
+}
+
+/* --------------------------------- device --------------------------------- */
+static void __on_filter(uint16_t msgid, const mqtt_client_message_t *msg, void *userdata)
+{
+    sg_calls[(intptr_t)userdata]++;
+    sg_deliveries++;
+}
+
+static void __on_filter_second(uint16_t msgid, const mqtt_client_message_t *msg, void *userdata)
+{
+    sg_second_calls++;
+}
+
+/* every topic is followed by a marker with its index, all handlers of the topic have been called by then */
+static void __on_done(uint16_t msgid, const mqtt_client_message_t *msg, void *userdata)
+{
+    char index[12] = {0};
+    const char *topic = NULL;
+    uint32_t i = 0, expect = 0;
+
+    memcpy(index, msg->payload, msg->length < sizeof(index) - 1 ? msg->length : sizeof(index) - 1);
+    topic = sg_topics[atoi(index) % MQTT_FILTER_TOPIC_NUM];
+
+    for (i = 0; i < CNTSOF(sg_calls); i++) {
+        if (i < CNTSOF(sg_filters)) {
+            expect = sg_subscribed && __topic_match(sg_filters[i], topic);
+        } else {
+            char exact[MQTT_FILTER_TOPIC_LEN];
+            snprintf(exact, sizeof(exact), "sub/%d/in", (int)(i - CNTSOF(sg_filters)));
+            expect = sg_subscribed && 0 == strcmp(exact, topic);
+        }
+        if (sg_calls[i] != expect) {
+            if (sg_errors++ < 10) {
+                PR_ERR("topic '%s': handler %d called %d times, expected %d", topic, i, sg_calls[i], expect);
+            }
+        }
+    }
+    // "a/+/c" has a second callback of its own
+    expect = sg_subscribed && __topic_match(sg_filters[0], topic);
+    if (sg_second_calls != expect && sg_errors++ < 10) {
+        PR_ERR("topic '%s': second handler called %d times, expected %d", topic, sg_second_calls, expect);
+    }
+
+    memset(sg_calls, 0, sizeof(sg_calls));
+    sg_second_calls = 0;
+    sg_done++;
+}
+
+static void __on_published(int result, void *user_data)
+{
+    uint32_t i = (uint32_t)(intptr_t)user_data;
+
+    if (sg_pub_result[i]++ > 0 && sg_errors++ < 10) {
+        PR_ERR("publish %d notified twice", i);
+    }
+    if (OPRT_OK == result) {
+        sg_pub_ok++;
+    } else {
+        sg_pub_timeout++;
+    }
+}
+
+static void __topics_build(void)
+{
+    uint32_t i = 0, j = 0, levels = 0, offset = 0;
+
+    for (i = 0; i < MQTT_FILTER_TOPIC_NUM; i++) {
+        if (0 == tal_system_get_random(10)) {
+            snprintf(sg_topics[i], MQTT_FILTER_TOPIC_LEN, "sub/%d/in", tal_system_get_random(MQTT_FILTER_EXACT_NUM));
+            continue;
+        }
+        levels = 1 + tal_system_get_random(4);
+        for (j = 0, offset = 0; j < levels; j++) {
+            // '$' levels only come first, as the broker would never route them elsewhere
+            const char *level = sg_levels[tal_system_get_random(j ? 4 : CNTSOF(sg_levels))];
+            offset += snprintf(sg_topics[i] + offset, MQTT_FILTER_TOPIC_LEN - offset, "%s%s", j ? "/" : "", level);
+        }
+    }
+}
+
+static void __request(tuya_mqtt_context_t *context, const char *request)
+{
+    tuya_mqtt_client_publish_common(context, MQTT_FILTER_REQ_TOPIC, (const uint8_t *)request, strlen(request), NULL,
+                                    NULL, 0, false);
+}
+
+static void __loop_until(tuya_mqtt_context_t *context, uint32_t *value, uint32_t expect, uint32_t timeout_ms)
+{
+    SYS_TIME_T start = tal_system_get_millisecond();
+
+    while (*value < expect && tal_system_get_millisecond() - start < timeout_ms) {
+        tuya_mqtt_loop(context);
+    }
+}
+
+static void __topic_run(tuya_mqtt_context_t *context, const char *name)
+{
+    SYS_TIME_T start = 0;
+
+    sg_done = 0;
+    sg_deliveries = 0;
+    start = tal_system_get_millisecond();
+    __request(context, "match");
+    __loop_until(context, &sg_done, MQTT_FILTER_TOPIC_NUM, 30 * 1000);
+    PR_NOTICE("%s: %d/%d topics, %d deliveries in %d ms, %d errors", name, sg_done, MQTT_FILTER_TOPIC_NUM,
+              sg_deliveries, (uint32_t)(tal_system_get_millisecond() - start), sg_errors);
+    if (sg_done != MQTT_FILTER_TOPIC_NUM) {
+        sg_errors++;
+    }
+}
+
+static void __publish_run(tuya_mqtt_context_t *context)
+{
+    uint8_t payload[4] = {1, 2, 3, 4};
+    uint32_t round = 0, i = 0, acks = 0, ok = 0;
+    SYS_TIME_T start = 0;
+
+    for (round = 0; round < MQTT_FILTER_PUB_ROUNDS; round++) {
+        memset(sg_pub_result, 0, sizeof(sg_pub_result));
+        sg_pub_ok = sg_pub_timeout = 0;
+        acks = sg_broker_acks;
+        start = tal_system_get_millisecond();
+
+        // every third publish goes out from tuya_mqtt_loop()
+        for (i = 0; i < MQTT_FILTER_PUB_NUM; i++) {
+            tuya_mqtt_client_publish_common(context, MQTT_FILTER_PUB_TOPIC, payload, sizeof(payload), __on_published,
+                                            (void *)(intptr_t)i, MQTT_FILTER_PUB_TIMEOUT, 0 == i % 3);
+        }
+        tuya_mqtt_loop(context);
+        __request(context, "ack");
+
+        // the held back publishes time out, each publish is notified exactly once
+        while (sg_pub_ok + sg_pub_timeout < MQTT_FILTER_PUB_NUM &&
+               tal_system_get_millisecond() - start < (MQTT_FILTER_PUB_TIMEOUT + 2) * 1000) {
+            tuya_mqtt_loop(context);
+        }
+
+        // the late acknowledgements must not reach anyone
+        ok = sg_pub_ok;
+        __request(context, "late");
+        for (i = 0; i < 5; i++) {
+            tuya_mqtt_loop(context);
+        }
+
+        PR_NOTICE("publish round %d: %d acked, %d timed out, broker acked %d in time", round, sg_pub_ok,
+                  sg_pub_timeout, sg_broker_acks - acks);
+        if (sg_pub_ok + sg_pub_timeout != MQTT_FILTER_PUB_NUM || sg_pub_ok != sg_broker_acks - acks ||
+            sg_pub_ok != ok || NULL != context->publish_list) {
+            sg_errors++;
+        }
+    }
+}
+
+/**
+ * @brief user_main
+ *
+ * @return void
+ */
+void user_main(void)
+{
+    static tuya_mqtt_context_t context;
+    char topic[MQTT_FILTER_TOPIC_LEN];
+    uint32_t i = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+
+    tal_semaphore_create_init(&sg_broker_ready, 0, 1);
+    THREAD_CFG_T thrd_param = {4096, THREAD_PRIO_2, "mqtt_broker"};
+    tal_thread_create_and_start(&sg_broker_thrd, NULL, NULL, __broker_task, NULL, &thrd_param);
+    tal_semaphore_wait_forever(sg_broker_ready);
+
+    const tuya_mqtt_config_t config = {
+        .host = "127.0.0.1",
+        .port = MQTT_FILTER_PORT,
+        .timeout = 100,
+        .devid = "mqttfilter000000000000",
+        .seckey = "0123456789abcdef",
+        .localkey = "0123456789abcdef",
+    };
+    if (OPRT_OK != tuya_mqtt_init(&context, &config) || OPRT_OK != tuya_mqtt_start(&context)) {
+        PR_ERR("mqtt connect fail");
+        goto __EXIT;
+    }
+
+    for (i = 0; i < CNTSOF(sg_filters); i++) {
+        tuya_mqtt_subscribe_message_callback_register(&context, sg_filters[i], __on_filter, (void *)(intptr_t)i);
+    }
+    // a repeated registration is ignored, a second callback on the same filter is called as well
+    tuya_mqtt_subscribe_message_callback_register(&context, sg_filters[0], __on_filter, (void *)(intptr_t)0);
+    tuya_mqtt_subscribe_message_callback_register(&context, sg_filters[0], __on_filter_second, NULL);
+    for (i = 0; i < MQTT_FILTER_EXACT_NUM; i++) {
+        snprintf(topic, sizeof(topic), "sub/%d/in", i);
+        tuya_mqtt_subscribe_message_callback_register(&context, topic, __on_filter,
+                                                      (void *)(intptr_t)(CNTSOF(sg_filters) + i));
+    }
+    tuya_mqtt_subscribe_message_callback_register(&context, MQTT_FILTER_DONE_TOPIC, __on_done, NULL);
+
+    __topics_build();
+    __topic_run(&context, "subscribed");
+
+    for (i = 0; i < CNTSOF(sg_filters); i++) {
+        tuya_mqtt_subscribe_message_callback_unregister(&context, sg_filters[i]);
+    }
+    for (i = 0; i < MQTT_FILTER_EXACT_NUM; i++) {
+        snprintf(topic, sizeof(topic), "sub/%d/in", i);
+        tuya_mqtt_subscribe_message_callback_unregister(&context, topic);
+    }
+    sg_subscribed = FALSE;
+    __topic_run(&context, "unsubscribed");
+
+    __publish_run(&context);
+
+    PR_NOTICE("mqtt topic filter: %s", sg_errors ? "FAIL" : "ok");
+
+__EXIT:
+    tuya_mqtt_stop(&context);
+    tuya_mqtt_destory(&context);
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+    while (1) {
+        tal_system_sleep(500);
+    }
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
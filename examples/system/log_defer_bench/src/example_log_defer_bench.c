@@ -0,0 +1,245 @@
+/**
+ * @file example_log_defer_bench.c
+ * @brief Time a busy task spends in PR_DEBUG with the lines printed inline and with tal_log_set_deferred().
+ *
+ * The log goes to a simulated UART of LOG_BENCH_UART_KBPS. While the lines are printed inline the caller holds the
+ * log mutex for the formatting and the output of its line. LOG_BENCH_TASK_NUM tasks log a line every
+ * LOG_BENCH_PERIOD_MS, LOG_BENCH_LINES lines each: once with the debug level off, once inline and once deferred. The
+ * time the tasks spent beyond their period is printed per line, with the lines dropped on a full ring. Before that, a set of formats is printed in
+ * both modes and the text of the lines compared.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <inttypes.h>
+
+#include "tuya_cloud_types.h"
+
+#include "tal_api.h"
+#include "tkl_output.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define LOG_BENCH_TASK_NUM  2
+#define LOG_BENCH_LINES     1000
+#define LOG_BENCH_PERIOD_MS 3
+#define LOG_BENCH_UART_KBPS 90
+#define LOG_BENCH_LINE_MAX  256
+#define LOG_BENCH_CHECK_MAX 16
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static BOOL_T sg_echo = TRUE;
+static uint32_t sg_uart_bytes = 0;
+static uint32_t sg_uart_us = 0;
+
+static char sg_check[2][LOG_BENCH_CHECK_MAX][LOG_BENCH_LINE_MAX];
+static int sg_check_num = 0;
+static int sg_check_mode = -1;
+
+static SEM_HANDLE sg_done = NULL;
+static SYS_TIME_T sg_task_ms[LOG_BENCH_TASK_NUM];
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+/* the UART, the time of the bytes is slept */
+static void __bench_log_output(const char *str)
+{
+    uint32_t len = strlen(str);
+    const char *text = NULL;
+
+    if (sg_echo) {
+        tkl_log_output("%s", str);
+        return;
+    }
+    if (sg_check_mode >= 0 && sg_check_num < LOG_BENCH_CHECK_MAX) {
+        // the text after "[time module level][file:line] "
+        text = strstr(str, "] ");
+        text = text ? strstr(text + 2, "] ") : NULL;
+        snprintf(sg_check[sg_check_mode][sg_check_num++], LOG_BENCH_LINE_MAX, "%s", text ? text + 2 : str);
+        return;
+    }
+
+    sg_uart_bytes += len;
+    sg_uart_us += len * 1000 / LOG_BENCH_UART_KBPS;
+    if (sg_uart_us >= 1000) {
+        tal_system_sleep(sg_uart_us / 1000);
+        sg_uart_us %= 1000;
+    }
+}
+
+static void __bench_formats(void)
+{
+    char name[8] = "abc";
+    const char *null_str = NULL;
+    uint8_t mac[6] = {0x10, 0x22, 0x3a, 0x4b, 0x5c, 0x6d};
+
+    PR_DEBUG("plain line");
+    PR_DEBUG("%d %i %u %x %X %o %c 100%%", -12, 34, 56u, 0xbeef, 0xCAFE, 8, 'z');
+    PR_DEBUG("%5d|%-5d|%05d|%+d|% d", 42, 42, 42, 42, 42);
+    PR_DEBUG("%ld %lu %lld %llu %zu", -1L, 2UL, -3LL, 4ULL, sizeof(mac));
+    PR_DEBUG("%hhd %hhu %hd %hu", -1, 255 + 2, -2, 65535 + 3);
+    PR_DEBUG("%" PRIu32 " %" PRIx32 " %" PRIu64, (uint32_t)7, (uint32_t)0xabc, (uint64_t)1 << 40);
+    PR_DEBUG("%f %.2f %e %g", 3.5, 2.345, 12345.678, 0.0001);
+    PR_DEBUG("%s|%10s|%-10s|%.2s|%.*s|%s", name, name, name, name, 1, name, null_str);
+    PR_DEBUG("%*d|%-*d|%.*f", 6, 1, 6, 2, 3, 1.0);
+    PR_DEBUG("mac %02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    // the deferred lines keep the strings of the call
+    memcpy(name, "xyz", 4);
+}
+
+/* the text of the lines printed inline and deferred must match */
+static void __bench_check(void)
+{
+    int i = 0, bad = 0, num = 0;
+
+    sg_echo = FALSE;
+    for (sg_check_mode = 0; sg_check_mode < 2; sg_check_mode++) {
+        sg_check_num = 0;
+        tal_log_set_deferred(1 == sg_check_mode);
+        __bench_formats();
+        tal_log_flush();
+        num = sg_check_num;
+    }
+    tal_log_set_deferred(FALSE);
+    sg_check_mode = -1;
+    sg_echo = TRUE;
+
+    for (i = 0; i < num; i++) {
+        if (strcmp(sg_check[0][i], sg_check[1][i])) {
+            PR_ERR("inline   %s", sg_check[0][i]);
+            PR_ERR("deferred %s", sg_check[1][i]);
+            bad++;
+        }
+    }
+    PR_NOTICE("format check: %d lines, %d differ", num, bad);
+}
+
+static void __bench_task(void *args)
+{
+    int id = (int)(intptr_t)args;
+    SYS_TIME_T start = tal_system_get_millisecond();
+    uint32_t i = 0;
+
+    for (i = 0; i < LOG_BENCH_LINES; i++) {
+        PR_DEBUG("task %d frame %u len %d rssi %d state %s", id, i, 512 + i % 64, -40 - (int)(i % 30),
+                 (i & 1) ? "run" : "idle");
+        tal_system_sleep(LOG_BENCH_PERIOD_MS);
+    }
+    sg_task_ms[id] = tal_system_get_millisecond() - start;
+    tal_semaphore_post(sg_done);
+}
+
+/* mode 0 with the debug level off, 1 inline, 2 deferred */
+static void __bench_run(int mode)
+{
+    static const char *name[] = {"no log", "inline", "deferred"};
+    THREAD_HANDLE thread[LOG_BENCH_TASK_NUM];
+    THREAD_CFG_T thrd_param = {4096, THREAD_PRIO_2, "log_bench"};
+    SYS_TIME_T start = 0, total = 0, task_ms = 0;
+    uint32_t dropped = tal_log_get_dropped();
+    int i = 0;
+
+    sg_echo = FALSE;
+    sg_uart_bytes = 0;
+    tal_log_set_level((0 == mode) ? TAL_LOG_LEVEL_INFO : TAL_LOG_LEVEL_DEBUG);
+    tal_log_set_deferred(2 == mode);
+    start = tal_system_get_millisecond();
+    for (i = 0; i < LOG_BENCH_TASK_NUM; i++) {
+        tal_thread_create_and_start(&thread[i], NULL, NULL, __bench_task, (void *)(intptr_t)i, &thrd_param);
+    }
+    for (i = 0; i < LOG_BENCH_TASK_NUM; i++) {
+        tal_semaphore_wait(sg_done, SEM_WAIT_FOREVER);
+    }
+    for (i = 0; i < LOG_BENCH_TASK_NUM; i++) {
+        tal_thread_delete(thread[i]);
+        task_ms += sg_task_ms[i];
+    }
+    tal_log_set_deferred(FALSE);
+    total = tal_system_get_millisecond() - start;
+    sg_echo = TRUE;
+
+    // the time beyond the sleeps is the time in the log calls
+    task_ms /= LOG_BENCH_TASK_NUM;
+    task_ms = (task_ms > LOG_BENCH_LINES * LOG_BENCH_PERIOD_MS) ? task_ms - LOG_BENCH_LINES * LOG_BENCH_PERIOD_MS : 0;
+    PR_NOTICE("%-8s %4d us per line, all out in %5d ms, uart %6d B, dropped %d", name[mode],
+              (uint32_t)(task_ms * 1000 / LOG_BENCH_LINES), (uint32_t)total, sg_uart_bytes,
+              tal_log_get_dropped() - dropped);
+}
+
+/**
+ * @brief user_main
+ *
+ * @return void
+ */
+void user_main(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    tal_log_init(TAL_LOG_LEVEL_DEBUG, 1024, __bench_log_output);
+
+    rt = tal_log_set_deferred(TRUE);
+    tal_log_set_deferred(FALSE);
+    if (OPRT_OK != rt) {
+        PR_ERR("deferred log err %d, set TAL_LOG_DEFER_BUF_SIZE", rt);
+        return;
+    }
+    if (OPRT_OK != tal_semaphore_create_init(&sg_done, 0, LOG_BENCH_TASK_NUM)) {
+        return;
+    }
+
+    __bench_check();
+    PR_NOTICE("%d tasks, a line every %d ms, %d lines each, uart %d KB/s", LOG_BENCH_TASK_NUM, LOG_BENCH_PERIOD_MS,
+              LOG_BENCH_LINES, LOG_BENCH_UART_KBPS);
+    __bench_run(0);
+    __bench_run(1);
+    __bench_run(2);
+
+    tal_semaphore_release(sg_done);
+    sg_done = NULL;
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+    while (1) {
+        tal_system_sleep(500);
+    }
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
@@ -0,0 +1,330 @@
+/**
+ * @file example_os_kv_log.c
+ * @brief Flash wear and throughput of the kv log against one file per key.
+ *
+ * A littlefs instance is mounted on a block device in RAM that counts program and erase calls. The same sequence of
+ * writes, KV_BENCH_WRITES values spread over KV_BENCH_KEYS keys, is stored three times on a freshly formatted device:
+ *
+ * - file:  each value rewrites its own file with LFS_O_TRUNC, as tal_kv_set() does without ENABLE_KV_LOG
+ * - log:   each value is one kv_log_set() with its own sync
+ * - batch: KV_BENCH_BATCH values per kv_log_batch_begin()/kv_log_batch_commit()
+ *
+ * Values are not encrypted, the cost of AES is the same for every scheme.
+ *
+ * A last run checks that batches which never commit, one whose commit hits a flash error and one still open when the
+ * log is closed, leave nothing behind for the committed batch after them.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "kv_log.h"
+
+#include "tal_api.h"
+#include "tkl_output.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define KV_BENCH_BLOCK_SIZE  4096
+#define KV_BENCH_BLOCK_COUNT 64
+#define KV_BENCH_PROG_SIZE   256
+
+#define KV_BENCH_KEYS   16
+#define KV_BENCH_WRITES 2000
+#define KV_BENCH_VALUE  48
+#define KV_BENCH_BATCH  10
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef enum {
+    KV_BENCH_FILE = 0,
+    KV_BENCH_LOG,
+    KV_BENCH_LOG_BATCH,
+} KV_BENCH_MODE_E;
+
+typedef struct {
+    uint32_t progs;
+    uint32_t prog_bytes;
+    uint32_t erases;
+} KV_BENCH_FLASH_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static uint8_t *sg_flash = NULL;
+static KV_BENCH_FLASH_T sg_flash_cnt;
+static BOOL_T sg_flash_fail = FALSE;
+
+static const char *sg_mode_name[] = {"file", "log", "batch"};
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static int __bench_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    memcpy(buffer, sg_flash + block * c->block_size + off, size);
+    return LFS_ERR_OK;
+}
+
+static int __bench_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer,
+                        lfs_size_t size)
+{
+    if (sg_flash_fail) {
+        return LFS_ERR_IO;
+    }
+    memcpy(sg_flash + block * c->block_size + off, buffer, size);
+    sg_flash_cnt.progs++;
+    sg_flash_cnt.prog_bytes += size;
+    return LFS_ERR_OK;
+}
+
+static int __bench_erase(const struct lfs_config *c, lfs_block_t block)
+{
+    memset(sg_flash + block * c->block_size, 0xff, c->block_size);
+    sg_flash_cnt.erases++;
+    return LFS_ERR_OK;
+}
+
+static int __bench_sync(const struct lfs_config *c)
+{
+    return LFS_ERR_OK;
+}
+
+static const struct lfs_config sg_lfs_cfg = {
+    .read = __bench_read,
+    .prog = __bench_prog,
+    .erase = __bench_erase,
+    .sync = __bench_sync,
+    .read_size = KV_BENCH_PROG_SIZE,
+    .prog_size = KV_BENCH_PROG_SIZE,
+    .block_size = KV_BENCH_BLOCK_SIZE,
+    .block_count = KV_BENCH_BLOCK_COUNT,
+    .cache_size = KV_BENCH_PROG_SIZE,
+    .lookahead_size = 16,
+    .block_cycles = 500,
+};
+
+static void __bench_value(uint32_t i, char *key, uint8_t *value)
+{
+    snprintf(key, 16, "key_%02d", (int)(i % KV_BENCH_KEYS));
+    memset(value, 'a' + i % 26, KV_BENCH_VALUE);
+    memcpy(value, &i, sizeof(i));
+}
+
+static OPERATE_RET __bench_file_write(lfs_t *lfs, const char *key, const uint8_t *value, uint32_t len)
+{
+    lfs_file_t file;
+
+    if (LFS_ERR_OK != lfs_file_open(lfs, &file, key, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC)) {
+        return OPRT_KVS_WR_FAIL;
+    }
+    if (lfs_file_write(lfs, &file, value, len) != (lfs_ssize_t)len) {
+        lfs_file_close(lfs, &file);
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    return (LFS_ERR_OK == lfs_file_close(lfs, &file)) ? OPRT_OK : OPRT_KVS_WR_FAIL;
+}
+
+/* stores KV_BENCH_WRITES values on a fresh device and prints the rate and the flash counters */
+static void __bench_run(KV_BENCH_MODE_E mode)
+{
+    OPERATE_RET rt = OPRT_OK;
+    lfs_t lfs;
+    kv_log_t *log = NULL;
+    kv_log_stat_t stat;
+    char key[16];
+    uint8_t value[KV_BENCH_VALUE];
+    SYS_TIME_T start = 0, ms = 0;
+    uint32_t i = 0, fails = 0;
+
+    memset(sg_flash, 0xff, KV_BENCH_BLOCK_SIZE * KV_BENCH_BLOCK_COUNT);
+    if (LFS_ERR_OK != lfs_format(&lfs, &sg_lfs_cfg) || LFS_ERR_OK != lfs_mount(&lfs, &sg_lfs_cfg)) {
+        PR_ERR("lfs mount fail");
+        return;
+    }
+    if (KV_BENCH_FILE != mode && OPRT_OK != kv_log_open(&lfs, "kvlog", &log)) {
+        PR_ERR("kv log open fail");
+        lfs_unmount(&lfs);
+        return;
+    }
+    memset(&sg_flash_cnt, 0, sizeof(sg_flash_cnt));
+
+    start = tal_system_get_millisecond();
+    for (i = 0; i < KV_BENCH_WRITES; i++) {
+        __bench_value(i, key, value);
+
+        if (KV_BENCH_FILE == mode) {
+            rt = __bench_file_write(&lfs, key, value, sizeof(value));
+        } else {
+            if (KV_BENCH_LOG_BATCH == mode && 0 == i % KV_BENCH_BATCH) {
+                kv_log_batch_begin(log);
+            }
+            rt = kv_log_set(log, key, value, sizeof(value));
+            if (KV_BENCH_LOG_BATCH == mode && (KV_BENCH_BATCH - 1 == i % KV_BENCH_BATCH || KV_BENCH_WRITES - 1 == i)) {
+                rt |= kv_log_batch_commit(log);
+            }
+            if (kv_log_need_compact(log)) {
+                rt |= kv_log_compact(log);
+            }
+        }
+        if (OPRT_OK != rt) {
+            fails++;
+        }
+    }
+    ms = tal_system_get_millisecond() - start;
+    if (0 == ms) {
+        ms = 1;
+    }
+
+    PR_NOTICE("%-5s %d writes, %6d writes/s, fail %d, erases %d, progs %d, prog bytes %d", sg_mode_name[mode],
+              KV_BENCH_WRITES, (uint32_t)(KV_BENCH_WRITES * 1000 / ms), fails, sg_flash_cnt.erases,
+              sg_flash_cnt.progs, sg_flash_cnt.prog_bytes);
+
+    if (log) {
+        kv_log_stat_get(log, &stat);
+        PR_NOTICE("%-5s keys %d, segments %d, bytes %d, live %d, syncs %d, compacts %d", sg_mode_name[mode],
+                  stat.keys, stat.segments, stat.bytes, stat.live, stat.syncs, stat.compacts);
+        kv_log_close(log);
+    }
+    lfs_unmount(&lfs);
+}
+
+/* TRUE when the key holds the value, or is missing for a NULL value */
+static BOOL_T __recover_expect(kv_log_t *log, const char *key, const char *value)
+{
+    uint8_t *buf = NULL;
+    size_t len = 0;
+    BOOL_T ok = FALSE;
+
+    if (OPRT_OK != kv_log_get(log, key, &buf, &len)) {
+        return (NULL == value) ? TRUE : FALSE;
+    }
+    ok = (value && len == strlen(value) && 0 == memcmp(buf, value, len)) ? TRUE : FALSE;
+    tal_free(buf);
+
+    return ok;
+}
+
+/* a failed commit and a batch open at close are dropped, the committed batch after them applies alone */
+static void __recover_run(void)
+{
+    lfs_t lfs;
+    kv_log_t *log = NULL;
+    BOOL_T ok = TRUE;
+
+    memset(sg_flash, 0xff, KV_BENCH_BLOCK_SIZE * KV_BENCH_BLOCK_COUNT);
+    if (LFS_ERR_OK != lfs_format(&lfs, &sg_lfs_cfg) || LFS_ERR_OK != lfs_mount(&lfs, &sg_lfs_cfg) ||
+        OPRT_OK != kv_log_open(&lfs, "kvlog", &log)) {
+        PR_ERR("recover: kv log open fail");
+        return;
+    }
+    ok &= (OPRT_OK == kv_log_set(log, "a", (const uint8_t *)"old", 3));
+
+    // the commit does not reach the flash
+    kv_log_batch_begin(log);
+    kv_log_set(log, "a", (const uint8_t *)"lost", 4);
+    kv_log_set(log, "b", (const uint8_t *)"lost", 4);
+    sg_flash_fail = TRUE;
+    ok &= (OPRT_OK != kv_log_batch_commit(log));
+    sg_flash_fail = FALSE;
+    ok &= __recover_expect(log, "a", "old") && __recover_expect(log, "b", NULL);
+
+    // the log is closed inside a batch
+    kv_log_batch_begin(log);
+    kv_log_set(log, "c", (const uint8_t *)"lost", 4);
+    kv_log_del(log, "a");
+    kv_log_close(log);
+    log = NULL;
+    ok &= (OPRT_OK == kv_log_open(&lfs, "kvlog", &log));
+
+    if (log) {
+        ok &= (OPRT_OK == kv_log_batch_begin(log));
+        ok &= (OPRT_OK == kv_log_set(log, "d", (const uint8_t *)"new", 3));
+        ok &= (OPRT_OK == kv_log_batch_commit(log));
+        kv_log_close(log);
+        log = NULL;
+    }
+    ok &= (OPRT_OK == kv_log_open(&lfs, "kvlog", &log));
+
+    if (log) {
+        ok &= __recover_expect(log, "a", "old") && __recover_expect(log, "b", NULL) &&
+              __recover_expect(log, "c", NULL) && __recover_expect(log, "d", "new");
+        kv_log_close(log);
+    }
+    lfs_unmount(&lfs);
+
+    if (ok) {
+        PR_NOTICE("recover ok");
+    } else {
+        PR_ERR("recover FAIL");
+    }
+}
+
+/**
+ * @brief user_main
+ *
+ * @return void
+ */
+void user_main(void)
+{
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+
+    sg_flash = tal_malloc(KV_BENCH_BLOCK_SIZE * KV_BENCH_BLOCK_COUNT);
+    if (NULL == sg_flash) {
+        PR_ERR("flash malloc fail");
+        return;
+    }
+
+    __bench_run(KV_BENCH_FILE);
+    __bench_run(KV_BENCH_LOG);
+    __bench_run(KV_BENCH_LOG_BATCH);
+    __recover_run();
+
+    tal_free(sg_flash);
+    sg_flash = NULL;
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+    while (1) {
+        tal_system_sleep(500);
+    }
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
@@ -0,0 +1,230 @@
+/**
+ * @file example_os_kv_serialize.c
+ * @brief Size and speed of the JSON and the binary kv_db_t serializers.
+ *
+ * An activation record with the fields tuya_iot keeps after activation and the endpoint of the cloud is encoded and
+ * decoded KV_BENCH_LOOPS times in each format, then the record is written in JSON with tal_kv_serialize_set() and read
+ * back with tal_kv_serialize_get_fmt(), which migrates it to the binary format.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+
+#include "tal_api.h"
+#include "tkl_output.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define KV_BENCH_LOOPS 10000
+#define KV_BENCH_DB_NUM 13
+#define KV_BENCH_KEY   "bench.activate"
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    char devid[32];
+    char seckey[32];
+    char localkey[32];
+    char schema_id[32];
+    char timezone[16];
+    BOOL_T reset_factory;
+    int capability;
+    char atop_host[64];
+    uint16_t atop_port;
+    char atop_path[32];
+    char mqtt_host[64];
+    uint16_t mqtt_port;
+    uint8_t auth_key[32];
+} KV_BENCH_ACTIVATE_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static KV_BENCH_ACTIVATE_T sg_activate = {
+    .devid = "6c2b1e7a8f3d4c5b6aqwex",
+    .seckey = "a1b2c3d4e5f6a7b8",
+    .localkey = "Zx9#Lm2$Qp7&Wr4!",
+    .schema_id = "000004f3kz",
+    .timezone = "+08:00",
+    .reset_factory = FALSE,
+    .capability = 1025,
+    .atop_host = "h3.iot-dns.com",
+    .atop_port = 443,
+    .atop_path = "/d.json",
+    .mqtt_host = "m1.tuyacn.com",
+    .mqtt_port = 8883,
+    .auth_key = {0x3a, 0x91, 0x5c, 0x07, 0xee, 0x42, 0x18, 0xb6, 0x70, 0x2d, 0xc4, 0x89, 0x13, 0x5f, 0xa0, 0x66,
+                 0x9b, 0x24, 0xd1, 0x7e, 0x08, 0xf3, 0x4a, 0xbc, 0x55, 0x6e, 0x92, 0x01, 0xcd, 0x37, 0xe8, 0x1f},
+};
+
+static const char *sg_fmt_name[] = {"json", "bin"};
+
+extern int kv_serialize(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len);
+extern int kv_deserialize(const char *in, kv_db_t *db, const uint32_t dbcnt);
+extern int kv_serialize_bin(const kv_db_t *db, const uint32_t dbcnt, uint8_t **out, uint32_t *out_len);
+extern int kv_deserialize_bin(const uint8_t *in, uint32_t len, kv_db_t *db, const uint32_t dbcnt);
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static void __bench_db_init(KV_BENCH_ACTIVATE_T *act, kv_db_t *db)
+{
+    kv_db_t tmp[] = {
+        {"devId", KV_STRING, act->devid, sizeof(act->devid)},
+        {"secKey", KV_STRING, act->seckey, sizeof(act->seckey)},
+        {"localKey", KV_STRING, act->localkey, sizeof(act->localkey)},
+        {"schemaId", KV_STRING, act->schema_id, sizeof(act->schema_id)},
+        {"stdTimeZone", KV_STRING, act->timezone, sizeof(act->timezone)},
+        {"resetFactory", KV_BOOL, &act->reset_factory, sizeof(act->reset_factory)},
+        {"capability", KV_INT, &act->capability, sizeof(act->capability)},
+        {"atop.host", KV_STRING, act->atop_host, sizeof(act->atop_host)},
+        {"atop.port", KV_USHORT, &act->atop_port, sizeof(act->atop_port)},
+        {"atop.path", KV_STRING, act->atop_path, sizeof(act->atop_path)},
+        {"mqtt.host", KV_STRING, act->mqtt_host, sizeof(act->mqtt_host)},
+        {"mqtt.port", KV_USHORT, &act->mqtt_port, sizeof(act->mqtt_port)},
+        {"authKey", KV_RAW, act->auth_key, sizeof(act->auth_key)},
+    };
+
+    memcpy(db, tmp, sizeof(tmp));
+}
+
+/* encodes and decodes the record KV_BENCH_LOOPS times and prints size and time per call */
+static void __bench_run(KV_SERIALIZE_FMT_E fmt)
+{
+    OPERATE_RET rt = OPRT_OK;
+    kv_db_t db[KV_BENCH_DB_NUM];
+    KV_BENCH_ACTIVATE_T out;
+    uint8_t *buf = NULL;
+    uint32_t len = 0, i = 0;
+    SYS_TIME_T start = 0, enc_ms = 0, dec_ms = 0;
+
+    __bench_db_init(&sg_activate, db);
+    start = tal_system_get_millisecond();
+    for (i = 0; i < KV_BENCH_LOOPS && OPRT_OK == rt; i++) {
+        tal_free(buf);
+        buf = NULL;
+        if (KV_SERIALIZE_BIN == fmt) {
+            rt = kv_serialize_bin(db, KV_BENCH_DB_NUM, &buf, &len);
+        } else {
+            rt = kv_serialize(db, KV_BENCH_DB_NUM, (char **)&buf, &len);
+        }
+    }
+    enc_ms = tal_system_get_millisecond() - start;
+    if (OPRT_OK != rt) {
+        PR_ERR("%s encode fail %d", sg_fmt_name[fmt], rt);
+        return;
+    }
+
+    memset(&out, 0, sizeof(out));
+    __bench_db_init(&out, db);
+    start = tal_system_get_millisecond();
+    for (i = 0; i < KV_BENCH_LOOPS && OPRT_OK == rt; i++) {
+        if (KV_SERIALIZE_BIN == fmt) {
+            rt = kv_deserialize_bin(buf, len, db, KV_BENCH_DB_NUM);
+        } else {
+            rt = kv_deserialize((const char *)buf, db, KV_BENCH_DB_NUM);
+        }
+    }
+    dec_ms = tal_system_get_millisecond() - start;
+    tal_free(buf);
+
+    if (OPRT_OK != rt || 0 != memcmp(&out, &sg_activate, sizeof(out))) {
+        PR_ERR("%s decode fail %d", sg_fmt_name[fmt], rt);
+        return;
+    }
+
+    PR_NOTICE("%-4s %3d bytes, encode %5d ns, decode %5d ns", sg_fmt_name[fmt], len,
+              (uint32_t)(enc_ms * 1000000 / KV_BENCH_LOOPS), (uint32_t)(dec_ms * 1000000 / KV_BENCH_LOOPS));
+}
+
+/* stores the record as JSON, then reads it as an old record would be read after an upgrade */
+static void __bench_migrate(void)
+{
+    kv_db_t db[KV_BENCH_DB_NUM];
+    KV_BENCH_ACTIVATE_T out;
+    uint8_t *buf = NULL;
+    size_t len_json = 0, len_bin = 0;
+
+    __bench_db_init(&sg_activate, db);
+    if (OPRT_OK != tal_kv_serialize_set(KV_BENCH_KEY, db, KV_BENCH_DB_NUM) ||
+        OPRT_OK != tal_kv_get(KV_BENCH_KEY, &buf, &len_json)) {
+        PR_ERR("kv write fail");
+        return;
+    }
+    tal_kv_free(buf);
+
+    memset(&out, 0, sizeof(out));
+    __bench_db_init(&out, db);
+    if (OPRT_OK != tal_kv_serialize_get_fmt(KV_BENCH_KEY, db, KV_BENCH_DB_NUM, KV_SERIALIZE_BIN) ||
+        0 != memcmp(&out, &sg_activate, sizeof(out)) || OPRT_OK != tal_kv_get(KV_BENCH_KEY, &buf, &len_bin)) {
+        PR_ERR("kv migrate fail");
+        return;
+    }
+    tal_kv_free(buf);
+    tal_kv_del(KV_BENCH_KEY);
+
+    PR_NOTICE("kv record migrated from %d bytes of json to %d bytes of bin", len_json, len_bin);
+}
+
+/**
+ * @brief user_main
+ *
+ * @return void
+ */
+void user_main(void)
+{
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+    tal_kv_init(&(tal_kv_cfg_t){
+        .seed = "vmlkasdh93dlvlcy",
+        .key = "dflfuap134ddlduq",
+    });
+
+    __bench_run(KV_SERIALIZE_JSON);
+    __bench_run(KV_SERIALIZE_BIN);
+    __bench_migrate();
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+    while (1) {
+        tal_system_sleep(500);
+    }
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
@@ -29,6 +29,9 @@
 /***********************************************************
 ************************macro define************************
 ***********************************************************/
+#if defined(EXAMPLE_SW_TIMER_BENCHMARK) && (EXAMPLE_SW_TIMER_BENCHMARK == 1)
+#define BENCH_OPS_PER_ROUND 20000
+#endif
 
 /***********************************************************
 ***********************typedef define***********************
@@ -44,6 +47,13 @@
 static TIMER_ID sw_timer_id = NULL;
 static uint8_t timer_run_cnt = 0;
 
+#if defined(EXAMPLE_SW_TIMER_BENCHMARK) && (EXAMPLE_SW_TIMER_BENCHMARK == 1)
+static SYS_TIME_T bench_expect[1000];
+static volatile uint32_t bench_fired = 0;
+static volatile uint32_t bench_late_sum = 0;
+static volatile uint32_t bench_late_max = 0;
+#endif
+
 /***********************************************************
 ***********************function define**********************
 ***********************************************************/
@@ -67,6 +77,95 @@ static void __timer_cb(TIMER_ID timer_id, void *arg)
     }
 }
 
+#if defined(EXAMPLE_SW_TIMER_BENCHMARK) && (EXAMPLE_SW_TIMER_BENCHMARK == 1)
+/**
+ * @brief benchmark timer callback, records how late the timer fired
+ *
+ * @param[in] timer_id: timer id
+ * @param[in] arg: index of the timer in bench_expect
+ *
+ * @return none
+ */
+static void __bench_timer_cb(TIMER_ID timer_id, void *arg)
+{
+    SYS_TIME_T now = tal_system_get_millisecond();
+    SYS_TIME_T expect = bench_expect[(uint32_t)(uintptr_t)arg];
+    uint32_t late = (now > expect) ? (uint32_t)(now - expect) : 0;
+
+    bench_late_sum += late;
+    if (late > bench_late_max) {
+        bench_late_max = late;
+    }
+    bench_fired++;
+}
+
+/**
+ * @brief measure start/stop/dispatch cost with timer_num timers
+ *
+ * @param[in] timer_num: how many timers are alive during the measurement
+ *
+ * @return none
+ */
+static void __sw_timer_benchmark(uint32_t timer_num)
+{
+    uint32_t i = 0, round = 0, rounds = 0;
+    SYS_TIME_T begin = 0, start_ms = 0, stop_ms = 0;
+    TIMER_ID *timers = tal_malloc(timer_num * sizeof(TIMER_ID));
+
+    if (NULL == timers) {
+        PR_ERR("benchmark malloc failed");
+        return;
+    }
+
+    for (i = 0; i < timer_num; i++) {
+        if (OPRT_OK != tal_sw_timer_create(__bench_timer_cb, (void *)(uintptr_t)i, &timers[i])) {
+            PR_ERR("benchmark create timer %d failed", i);
+            timer_num = i;
+            goto __EXIT;
+        }
+    }
+
+    // start/stop: long intervals spread over the whole range so nothing fires
+    rounds = (BENCH_OPS_PER_ROUND + timer_num - 1) / timer_num;
+    for (round = 0; round < rounds; round++) {
+        begin = tal_system_get_millisecond();
+        for (i = 0; i < timer_num; i++) {
+            tal_sw_timer_start(timers[i], 600000 + (i * 7919) % 3600000, TAL_TIMER_ONCE);
+        }
+        start_ms += tal_system_get_millisecond() - begin;
+
+        begin = tal_system_get_millisecond();
+        for (i = 0; i < timer_num; i++) {
+            tal_sw_timer_stop(timers[i]);
+        }
+        stop_ms += tal_system_get_millisecond() - begin;
+    }
+
+    // dispatch: every timer expires within the same 20ms window
+    bench_fired = 0;
+    bench_late_sum = 0;
+    bench_late_max = 0;
+    begin = tal_system_get_millisecond();
+    for (i = 0; i < timer_num; i++) {
+        bench_expect[i] = begin + 200 + (i % 20);
+        tal_sw_timer_start(timers[i], 200 + (i % 20), TAL_TIMER_ONCE);
+    }
+    while ((bench_fired < timer_num) && (tal_system_get_millisecond() - begin < 5000)) {
+        tal_system_sleep(10);
+    }
+
+    PR_NOTICE("timers:%4d start:%6d ns/op stop:%6d ns/op dispatch fired:%d late avg:%d ms max:%d ms", timer_num,
+              (uint32_t)(start_ms * 1000000 / (rounds * timer_num)), (uint32_t)(stop_ms * 1000000 / (rounds * timer_num)),
+              bench_fired, (bench_fired) ? (bench_late_sum / bench_fired) : 0, bench_late_max);
+
+__EXIT:
+    for (i = 0; i < timer_num; i++) {
+        tal_sw_timer_delete(timers[i]);
+    }
+    tal_free(timers);
+}
+#endif
+
 /**
  * @brief user_main
  *
@@ -93,6 +192,14 @@ void user_main(void)
     PR_DEBUG("sw timer init");
     TUYA_CALL_ERR_GOTO(tal_sw_timer_init(), __EXIT);
 
+#if defined(EXAMPLE_SW_TIMER_BENCHMARK) && (EXAMPLE_SW_TIMER_BENCHMARK == 1)
+    PR_NOTICE("sw timer benchmark begin");
+    __sw_timer_benchmark(10);
+    __sw_timer_benchmark(100);
+    __sw_timer_benchmark(1000);
+    PR_NOTICE("sw timer benchmark end");
+#endif
+
     PR_DEBUG("sw timer create");
     TUYA_CALL_ERR_GOTO(tal_sw_timer_create(__timer_cb, NULL, &sw_timer_id), __EXIT);
 
@@ -0,0 +1,256 @@
+/**
+ * @file example_ota_delta.c
+ * @brief Applies a delta OTA patch made by tools/ota_delta.py the way tuya_ota does.
+ *
+ * The old image, the patch and the expected new image are read from files. The patch is fed to tuya_ota_delta in
+ * pieces of random size like a download, the old image is read through the read callback like the APP partition,
+ * and the new image is written by a callback that consumes whole sectors only, like tal_ota_data_process(). The
+ * result is checked against the new image, then the patch is applied once more to an old image with one byte
+ * changed, which must be refused before the first write.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "tuya_ota_delta.h"
+
+#include "tal_api.h"
+#include "tkl_fs.h"
+#include "tkl_output.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define OTA_DELTA_PIECE_MIN   512
+#define OTA_DELTA_PIECE_MAX   4096
+#define OTA_DELTA_OUT_SIZE    4096
+#define OTA_DELTA_SECTOR_SIZE 4096
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    uint8_t *data;
+    uint32_t len;
+} ota_delta_file_t;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static const char *sg_old_path = "old.bin";
+static const char *sg_patch_path = "patch.bin";
+static const char *sg_new_path = "new.bin";
+
+static ota_delta_file_t sg_old, sg_patch, sg_new;
+static uint8_t *sg_flash = NULL;
+static uint32_t sg_flash_len = 0;
+static uint32_t sg_old_read = 0;
+static uint32_t sg_writes = 0;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static OPERATE_RET __file_load(const char *path, ota_delta_file_t *file)
+{
+    TUYA_FILE fd = NULL;
+    int size = tkl_fgetsize(path);
+
+    if (size <= 0) {
+        PR_ERR("%s not found", path);
+        return OPRT_NOT_FOUND;
+    }
+    file->data = tal_malloc(size);
+    TUYA_CHECK_NULL_RETURN(file->data, OPRT_MALLOC_FAILED);
+    file->len = size;
+
+    fd = tkl_fopen(path, "r");
+    if (NULL == fd) {
+        return OPRT_FILE_OPEN_FAILED;
+    }
+    if (tkl_fread(file->data, size, fd) != size) {
+        tkl_fclose(fd);
+        return OPRT_FILE_READ_FAILED;
+    }
+    tkl_fclose(fd);
+
+    return OPRT_OK;
+}
+
+static void __file_free(ota_delta_file_t *file)
+{
+    if (file->data) {
+        tal_free(file->data);
+    }
+    memset(file, 0, sizeof(ota_delta_file_t));
+}
+
+/* the running image in the APP partition */
+static OPERATE_RET __delta_read(uint32_t offset, uint8_t *buf, uint32_t len, void *user_data)
+{
+    ota_delta_file_t *old = (ota_delta_file_t *)user_data;
+
+    if (offset + len > old->len) {
+        return OPRT_INVALID_PARM;
+    }
+    memcpy(buf, old->data + offset, len);
+    sg_old_read += len;
+
+    return OPRT_OK;
+}
+
+/* whole sectors only, the rest is left to the next call unless the image ends */
+static OPERATE_RET __delta_write(uint8_t *data, size_t len, size_t offset, uint32_t *remain_len, void *user_data)
+{
+    size_t n = len;
+
+    if (offset + len < sg_new.len) {
+        n = len - len % OTA_DELTA_SECTOR_SIZE;
+    }
+    *remain_len = len - n;
+    if (0 == n) {
+        return OPRT_OK;
+    }
+    if (offset != sg_flash_len || offset + n > sg_new.len) {
+        return OPRT_INVALID_PARM;
+    }
+    memcpy(sg_flash + offset, data, n);
+    sg_flash_len += n;
+    sg_writes++;
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __delta_run(ota_delta_file_t *old)
+{
+    OPERATE_RET rt = OPRT_OK;
+    tuya_ota_delta_t *delta = NULL;
+    uint32_t offset = 0, n = 0;
+    tuya_ota_delta_cfg_t cfg = {
+        .out_size = OTA_DELTA_OUT_SIZE,
+        .read = __delta_read,
+        .write = __delta_write,
+        .user_data = old,
+    };
+
+    sg_flash_len = 0;
+    sg_old_read = 0;
+    sg_writes = 0;
+    TUYA_CALL_ERR_RETURN(tuya_ota_delta_create(&cfg, &delta));
+
+    while (offset < sg_patch.len) {
+        n = OTA_DELTA_PIECE_MIN + tal_system_get_random(OTA_DELTA_PIECE_MAX - OTA_DELTA_PIECE_MIN + 1);
+        if (n > sg_patch.len - offset) {
+            n = sg_patch.len - offset;
+        }
+        TUYA_CALL_ERR_GOTO(tuya_ota_delta_apply(delta, sg_patch.data + offset, n), __EXIT);
+        offset += n;
+    }
+    rt = tuya_ota_delta_finish(delta);
+
+__EXIT:
+    tuya_ota_delta_destroy(delta);
+    return rt;
+}
+
+/**
+ * @brief user_main
+ *
+ * @return void
+ */
+void user_main(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    tuya_ota_delta_header_t header;
+    SYS_TIME_T start = 0, ms = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+
+    if (OPRT_OK != __file_load(sg_old_path, &sg_old) || OPRT_OK != __file_load(sg_patch_path, &sg_patch) ||
+        OPRT_OK != __file_load(sg_new_path, &sg_new)) {
+        PR_ERR("usage: <app> old.bin patch.bin new.bin");
+        goto __EXIT;
+    }
+    if (!tuya_ota_delta_header_parse(sg_patch.data, sg_patch.len, &header)) {
+        PR_ERR("%s is not a delta patch", sg_patch_path);
+        goto __EXIT;
+    }
+    PR_NOTICE("old %d B, new %d B, patch %d B (%d.%d%% of new)", sg_old.len, sg_new.len, sg_patch.len,
+              (uint32_t)((uint64_t)sg_patch.len * 100 / sg_new.len),
+              (uint32_t)((uint64_t)sg_patch.len * 1000 / sg_new.len % 10));
+
+    sg_flash = tal_malloc(sg_new.len);
+    if (NULL == sg_flash) {
+        PR_ERR("malloc fail");
+        goto __EXIT;
+    }
+
+    start = tal_system_get_millisecond();
+    rt = __delta_run(&sg_old);
+    ms = tal_system_get_millisecond() - start;
+    PR_NOTICE("apply %d ms, old read %d B, %d flash writes, rt %d, image %s", (uint32_t)ms, sg_old_read, sg_writes,
+              rt, (OPRT_OK == rt && sg_flash_len == sg_new.len && 0 == memcmp(sg_flash, sg_new.data, sg_new.len))
+                      ? "ok"
+                      : "BAD");
+
+    // a device running another image must not write anything
+    sg_old.data[sg_old.len / 2] ^= 0x01;
+    rt = __delta_run(&sg_old);
+    PR_NOTICE("other old image: rt %d, %d flash writes, %s", rt, sg_writes,
+              (OPRT_NOT_SUPPORTED == rt && 0 == sg_writes) ? "refused" : "BAD");
+
+__EXIT:
+    __file_free(&sg_old);
+    __file_free(&sg_patch);
+    __file_free(&sg_new);
+    if (sg_flash) {
+        tal_free(sg_flash);
+        sg_flash = NULL;
+    }
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    if (argc > 3) {
+        sg_old_path = argv[1];
+        sg_patch_path = argv[2];
+        sg_new_path = argv[3];
+    }
+    user_main();
+    while (1) {
+        tal_system_sleep(500);
+    }
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""
+Makes old.bin and new.bin for the ota_delta example
+
+The images are synthetic but shaped like a small firmware: a vector table, a
+run of functions made of 32-bit words, literal pools with the absolute
+addresses of functions and strings, and a string table. The new image is the
+old one after a typical release:
+
+  - a few functions change, one grows
+  - a function is added in the middle, so everything behind it moves and the
+    addresses of the moved functions change in every vector and literal pool
+  - a string is changed and one is added
+
+The output is the same for the same seed, so a patch made from it can be
+compared between runs.
+
+Usage:
+    gen_fixtures.py [-o DIR] [--seed N] [--funcs N]
+"""
+
+import os
+import random
+import struct
+import argparse
+
+BASE = 0x08010000   # load address of the image
+VECTORS = 64        # entries of the vector table
+
+
+def make_funcs(rng, count):
+    """function bodies, each a list of 32-bit instruction words and literal slots"""
+    opcodes = [rng.getrandbits(16) << 16 for _ in range(48)]
+    funcs = []
+    for _ in range(count):
+        body = []
+        for _ in range(rng.randint(8, 96)):
+            body.append(("op", rng.choice(opcodes) | rng.getrandbits(12)))
+        # literal pool: calls to other functions and references to strings
+        for _ in range(rng.randint(1, 6)):
+            if rng.random() < 0.7:
+                body.append(("func", rng.randrange(count)))
+            else:
+                body.append(("str", rng.randrange(count // 4 + 1)))
+        funcs.append(body)
+    return funcs
+
+
+def make_strings(rng, count):
+    words = ["err", "ok", "mqtt", "http", "tls", "dp", "ota", "fail", "init", "send", "recv", "timeout"]
+    return [(" ".join(rng.choice(words) for _ in range(rng.randint(2, 6))) + ":%d\n").encode() for _ in range(count)]
+
+
+def link(funcs, strings):
+    """lays the functions and strings out and resolves the literal slots"""
+    addr = BASE + VECTORS * 4
+    func_addr = []
+    for body in funcs:
+        func_addr.append(addr)
+        addr += len(body) * 4
+    str_addr = []
+    for s in strings:
+        str_addr.append(addr)
+        addr += (len(s) + 3) & ~3
+
+    out = bytearray()
+    for i in range(VECTORS):
+        out += struct.pack("<I", func_addr[i % len(func_addr)] | 1)
+    for body in funcs:
+        for kind, value in body:
+            if "op" == kind:
+                out += struct.pack("<I", value)
+            elif "func" == kind:
+                out += struct.pack("<I", func_addr[value % len(func_addr)] | 1)
+            else:
+                out += struct.pack("<I", str_addr[value % len(str_addr)])
+    for s in strings:
+        out += s + b"\0" * (((len(s) + 3) & ~3) - len(s))
+    return bytes(out)
+
+
+def release(rng, funcs, strings):
+    """the changes of a release, applied to copies"""
+    funcs = [list(body) for body in funcs]
+    strings = list(strings)
+
+    for i in rng.sample(range(len(funcs)), 4):
+        body = funcs[i]
+        for _ in range(rng.randint(1, 4)):
+            j = rng.randrange(len(body))
+            if "op" == body[j][0]:
+                body[j] = ("op", body[j][1] ^ rng.getrandbits(12))
+    grown = funcs[rng.randrange(len(funcs))]
+    grown[len(grown) // 2:len(grown) // 2] = [("op", rng.getrandbits(32)) for _ in range(24)]
+
+    added = [("op", rng.getrandbits(32)) for _ in range(40)] + [("func", rng.randrange(len(funcs)))]
+    funcs.insert(len(funcs) // 2, added)
+    # calls behind the new function keep pointing to the same functions
+    middle = len(funcs) // 2
+    for body in funcs:
+        for j, (kind, value) in enumerate(body):
+            if "func" == kind and value >= middle and body is not added:
+                body[j] = ("func", value + 1)
+
+    strings[rng.randrange(len(strings))] = b"ota delta applied:%d\n"
+    strings.append(b"new feature on\n")
+    return funcs, strings
+
+
+def main():
+    parser = argparse.ArgumentParser(description="make old.bin and new.bin for the ota_delta example")
+    parser.add_argument("-o", "--out", default=".", help="output directory")
+    parser.add_argument("--seed", type=int, default=1, help="random seed")
+    parser.add_argument("--funcs", type=int, default=400, help="functions in the image")
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    funcs = make_funcs(rng, args.funcs)
+    strings = make_strings(rng, args.funcs // 4 + 1)
+    old = link(funcs, strings)
+    new = link(*release(rng, funcs, strings))
+
+    os.makedirs(args.out, exist_ok=True)
+    for name, data in (("old.bin", old), ("new.bin", new)):
+        with open(os.path.join(args.out, name), "wb") as f:
+            f.write(data)
+        print("%s: %d bytes" % (os.path.join(args.out, name), len(data)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,247 @@
+/**
+ * @file example_ota_pipe_bench.c
+ * @brief End-to-end OTA time with the flash writes on the download thread and behind a tuya_ota_pipe.
+ *
+ * A simulated link delivers an image of OTA_BENCH_IMAGE_SIZE bytes in pieces of random size and with a random
+ * throughput around OTA_BENCH_NET_KBPS. A simulated flash consumes whole sectors only, like tal_ota_data_process(),
+ * and takes OTA_BENCH_ERASE_MS + OTA_BENCH_PROG_MS per sector. The image is upgraded once the way tuya_ota does it
+ * without a pipe, the receive buffer keeping the bytes the flash did not consume in front of the next piece, and
+ * once per buffer count through tuya_ota_pipe_write(). Every run checks the flash content against the image.
+ *
+ * The link has no socket buffer: a piece is only received while the download thread reads, as a TCP window that
+ * closes during a flash write.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_cloud_types.h"
+#include "tuya_ota_pipe.h"
+
+#include "tal_api.h"
+#include "tkl_output.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define OTA_BENCH_IMAGE_SIZE (256 * 1024)
+#define OTA_BENCH_RANGE_SIZE 4096
+#define OTA_BENCH_PIECE_MIN  512
+#define OTA_BENCH_NET_KBPS   256
+
+#define OTA_BENCH_SECTOR_SIZE 4096
+#define OTA_BENCH_ERASE_MS    12
+#define OTA_BENCH_PROG_MS     3
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static const uint8_t sg_buf_num[] = {2, 3, 4};
+
+static uint8_t *sg_image = NULL;
+static uint8_t *sg_flash = NULL;
+static uint32_t sg_net_us = 0;
+static uint32_t sg_flash_ms = 0;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+/* receives the next piece of at most len bytes, the time it takes on the link is slept */
+static size_t __bench_net_recv(uint8_t *buf, size_t len, size_t offset)
+{
+    size_t n = OTA_BENCH_PIECE_MIN + (size_t)tal_system_get_random(len - OTA_BENCH_PIECE_MIN + 1);
+
+    if (n > len) {
+        n = len;
+    }
+    if (n > OTA_BENCH_IMAGE_SIZE - offset) {
+        n = OTA_BENCH_IMAGE_SIZE - offset;
+    }
+    memcpy(buf, sg_image + offset, n);
+
+    // 20% to 180% of the mean time, the link is bursty
+    sg_net_us += (uint32_t)((uint64_t)n * 1000000 / (OTA_BENCH_NET_KBPS * 1024) * (20 + tal_system_get_random(161)) / 100);
+    if (sg_net_us >= 1000) {
+        tal_system_sleep(sg_net_us / 1000);
+        sg_net_us %= 1000;
+    }
+
+    return n;
+}
+
+/* whole sectors only, the rest is left to the next call unless the image ends */
+static OPERATE_RET __bench_flash_write(uint8_t *data, size_t len, size_t offset, uint32_t *remain_len, void *user_data)
+{
+    size_t n = len;
+    uint32_t sectors = 0;
+
+    if (offset + len < OTA_BENCH_IMAGE_SIZE) {
+        n = len - len % OTA_BENCH_SECTOR_SIZE;
+    }
+    *remain_len = len - n;
+    if (0 == n) {
+        return OPRT_OK;
+    }
+
+    memcpy(sg_flash + offset, data, n);
+    sectors = (n + OTA_BENCH_SECTOR_SIZE - 1) / OTA_BENCH_SECTOR_SIZE;
+    sg_flash_ms += sectors * (OTA_BENCH_ERASE_MS + OTA_BENCH_PROG_MS);
+    tal_system_sleep(sectors * (OTA_BENCH_ERASE_MS + OTA_BENCH_PROG_MS));
+
+    return OPRT_OK;
+}
+
+/* the flow of tuya_ota without a pipe: the download buffer keeps the remain in front of the next piece */
+static OPERATE_RET __bench_run_serial(void)
+{
+    uint8_t *buf = NULL;
+    size_t offset = 0, n = 0;
+    uint32_t remain_len = 0;
+
+    buf = tal_malloc(OTA_BENCH_RANGE_SIZE);
+    TUYA_CHECK_NULL_RETURN(buf, OPRT_MALLOC_FAILED);
+
+    while (offset < OTA_BENCH_IMAGE_SIZE) {
+        n = __bench_net_recv(buf + remain_len, OTA_BENCH_RANGE_SIZE - remain_len, offset);
+        offset += n;
+        n += remain_len;
+        __bench_flash_write(buf, n, offset - n, &remain_len, NULL);
+        if (remain_len) {
+            memmove(buf, buf + n - remain_len, remain_len);
+        }
+    }
+
+    tal_free(buf);
+    return OPRT_OK;
+}
+
+static OPERATE_RET __bench_run_pipe(uint8_t buf_num)
+{
+    OPERATE_RET rt = OPRT_OK;
+    tuya_ota_pipe_t *pipe = NULL;
+    uint8_t *buf = NULL;
+    size_t offset = 0, n = 0;
+    tuya_ota_pipe_cfg_t cfg = {
+        .buf_num = buf_num,
+        .buf_size = OTA_BENCH_RANGE_SIZE,
+        .stack_size = 4096,
+        .write = __bench_flash_write,
+        .user_data = NULL,
+    };
+
+    buf = tal_malloc(OTA_BENCH_RANGE_SIZE);
+    TUYA_CHECK_NULL_RETURN(buf, OPRT_MALLOC_FAILED);
+    TUYA_CALL_ERR_GOTO(tuya_ota_pipe_create(&cfg, &pipe), __EXIT);
+
+    while (offset < OTA_BENCH_IMAGE_SIZE) {
+        n = __bench_net_recv(buf, OTA_BENCH_RANGE_SIZE, offset);
+        TUYA_CALL_ERR_GOTO(tuya_ota_pipe_write(pipe, buf, n, offset), __EXIT);
+        offset += n;
+    }
+    rt = tuya_ota_pipe_finish(pipe);
+
+__EXIT:
+    tuya_ota_pipe_destroy(pipe);
+    tal_free(buf);
+    return rt;
+}
+
+static void __bench_report(const char *name, OPERATE_RET rt, SYS_TIME_T ms)
+{
+    bool ok = (OPRT_OK == rt) && (0 == memcmp(sg_flash, sg_image, OTA_BENCH_IMAGE_SIZE));
+
+    PR_NOTICE("%-8s %5d ms %4d KB/s flash busy %5d ms image %s", name, (uint32_t)ms,
+              ms ? (uint32_t)((uint64_t)OTA_BENCH_IMAGE_SIZE * 1000 / 1024 / ms) : 0, sg_flash_ms, ok ? "ok" : "BAD");
+}
+
+/**
+ * @brief user_main
+ *
+ * @return void
+ */
+void user_main(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    SYS_TIME_T start = 0;
+    char name[16];
+    uint32_t i = 0;
+
+    tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, (TAL_LOG_OUTPUT_CB)tkl_log_output);
+
+    sg_image = tal_malloc(OTA_BENCH_IMAGE_SIZE);
+    sg_flash = tal_malloc(OTA_BENCH_IMAGE_SIZE);
+    if (NULL == sg_image || NULL == sg_flash) {
+        PR_ERR("malloc fail");
+        goto __EXIT;
+    }
+    for (i = 0; i < OTA_BENCH_IMAGE_SIZE; i++) {
+        sg_image[i] = (uint8_t)tal_system_get_random(256);
+    }
+
+    PR_NOTICE("image %d KB, link %d KB/s, flash %d ms per %d B sector", OTA_BENCH_IMAGE_SIZE / 1024,
+              OTA_BENCH_NET_KBPS, OTA_BENCH_ERASE_MS + OTA_BENCH_PROG_MS, OTA_BENCH_SECTOR_SIZE);
+
+    memset(sg_flash, 0, OTA_BENCH_IMAGE_SIZE);
+    sg_flash_ms = 0;
+    start = tal_system_get_millisecond();
+    rt = __bench_run_serial();
+    __bench_report("serial", rt, tal_system_get_millisecond() - start);
+
+    for (i = 0; i < CNTSOF(sg_buf_num); i++) {
+        memset(sg_flash, 0, OTA_BENCH_IMAGE_SIZE);
+        sg_flash_ms = 0;
+        start = tal_system_get_millisecond();
+        rt = __bench_run_pipe(sg_buf_num[i]);
+        snprintf(name, sizeof(name), "pipe x%d", sg_buf_num[i]);
+        __bench_report(name, rt, tal_system_get_millisecond() - start);
+    }
+
+__EXIT:
+    if (sg_image) {
+        tal_free(sg_image);
+    }
+    if (sg_flash) {
+        tal_free(sg_flash);
+    }
+}
+
+/**
+ * @brief main
+ *
+ * @param argc
+ * @param argv
+ * @return void
+ */
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+void main(int argc, char *argv[])
+{
+    user_main();
+    while (1) {
+        tal_system_sleep(500);
+    }
+}
+#else
+
+/* Tuya thread handle */
+static THREAD_HANDLE ty_app_thread = NULL;
+
+/**
+ * @brief  task thread
+ *
+ * @param[in] arg:Parameters when creating a task
+ * @return none
+ */
+static void tuya_app_thread(void *arg)
+{
+    user_main();
+
+    tal_thread_delete(ty_app_thread);
+    ty_app_thread = NULL;
+}
+
+void tuya_app_main(void)
+{
+    THREAD_CFG_T thrd_param = {4096, 4, "tuya_app_main"};
+    tal_thread_create_and_start(&ty_app_thread, NULL, NULL, tuya_app_thread, NULL, &thrd_param);
+}
+#endif
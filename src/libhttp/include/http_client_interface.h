@@ -60,8 +60,34 @@ typedef struct http_client_response {
     uint16_t status_code;
 } http_client_response_t;
 
+typedef struct http_client_pool_stat {
+    uint32_t connects; /**< New TCP/TLS connections. */
+    uint32_t reuses;   /**< Requests sent on a kept connection. */
+    uint32_t retries;  /**< Kept connections found closed, request sent again on a new one. */
+} http_client_pool_stat_t;
+
+/**
+ * @brief Sends a request and receives the response.
+ *
+ * The connection is kept open after the response (HTTP keep-alive) and reused by the
+ * next request to the same host, port and CA certificate within HTTP_CLIENT_POOL_IDLE_MS.
+ * The CA certificate is compared by content. A connection nobody takes in that time is
+ * closed by a timer.
+ * When a kept connection fails, the request is sent again on a new one only if none of it
+ * was sent yet, or the method is GET, HEAD or OPTIONS.
+ */
 http_client_status_t http_client_request(const http_client_request_t *request, http_client_response_t *response);
 
 int http_client_free(http_client_response_t *response);
 
+/**
+ * @brief Closes all kept connections, e.g. after the network changed.
+ */
+void http_client_pool_flush(void);
+
+/**
+ * @brief Reads the connection counters.
+ */
+void http_client_pool_stat_get(http_client_pool_stat_t *stat);
+
 #endif /* ifndef HTTP_CLIENT_INTERFACE_H */
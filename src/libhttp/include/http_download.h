@@ -24,6 +24,7 @@ typedef struct {
     size_t file_size;
     uint32_t remain_len;
     void *user_data;
+    int error; // set by the DL_EVENT_ON_DATA handler to stop the download with DL_EVENT_FAULT
 } http_download_event_t;
 
 typedef void (*http_download_event_cb_t)(http_download_event_id_t id, http_download_event_t *event);
@@ -33,12 +34,30 @@ typedef struct {
     const uint8_t *cacert;
     size_t cacert_len;
     uint32_t timeout_ms;
-    size_t range_length;
+    size_t range_length; // data handed to one DL_EVENT_ON_DATA, also the smallest range request
     size_t file_size;
     void *user_data;
     http_download_event_cb_t event_handler;
+    // optional, 0 for the defaults
+    uint8_t conn_num; // range requests in flight on their own connections
+    size_t range_max; // largest range received ahead of the delivery, buffered per extra connection
+    size_t offset;    // resume point, bytes before it were handled by an earlier download
 } http_download_config_t;
 
+/**
+ * @brief Downloads a file with range requests and hands the data over in file
+ * order through DL_EVENT_ON_DATA.
+ *
+ * The ranges are spread over config->conn_num connections, their size follows
+ * the measured throughput. A dropped connection is reopened with a growing
+ * delay and continues at its first missing byte. The download fails with
+ * DL_EVENT_FAULT after HTTP_DOWNLOAD_TIMEOUT seconds without data, or as soon
+ * as the DL_EVENT_ON_DATA handler sets event->error.
+ *
+ * @param[in] config download configuration
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
 int http_file_download(http_download_config_t *config);
 
 #ifdef __cplusplus
@@ -4,6 +4,10 @@
 #include "core_http_client.h"
 #include "tuya_tls.h"
 #include "tal_log.h"
+#include "tal_system.h"
+#include "tal_mutex.h"
+#include "tal_sw_timer.h"
+#include "tal_security.h"
 
 #define log_debug PR_DEBUG
 #define log_error PR_ERR
@@ -11,6 +15,40 @@
 #define HEADER_BUFFER_LENGTH (255)
 #define DEFAULT_HTTP_PORT    (80)
 #define DEFAULT_HTTPS_PORT   (443)
+
+#ifndef HTTP_CLIENT_POOL_NUM
+#define HTTP_CLIENT_POOL_NUM (2)
+#endif
+#ifndef HTTP_CLIENT_POOL_IDLE_MS
+#define HTTP_CLIENT_POOL_IDLE_MS (30 * 1000)
+#endif
+#define HTTP_CLIENT_HOST_LEN (128)
+#define HTTP_CLIENT_CA_DIGEST_LEN (32)
+
+/* an idle keep-alive connection */
+typedef struct {
+    bool valid;
+    NetworkContext_t network;
+    TUYA_TRANSPORT_TYPE_E type;
+    uint8_t ca_digest[HTTP_CLIENT_CA_DIGEST_LEN]; // SHA-256 of the CA certificate, the pointer may be reused
+    uint16_t port;
+    char host[HTTP_CLIENT_HOST_LEN];
+    SYS_TIME_T idle_since;
+} http_client_conn_t;
+
+#if (HTTP_CLIENT_POOL_NUM > 0)
+static http_client_conn_t sg_conn_pool[HTTP_CLIENT_POOL_NUM];
+static MUTEX_HANDLE sg_pool_mutex = NULL;
+static TIMER_ID sg_pool_timer = NULL;
+#endif
+static http_client_pool_stat_t sg_pool_stat;
+
+/* the connection of a request, counts the request bytes the transport took */
+typedef struct {
+    NetworkContext_t network;
+    size_t sent;
+} http_client_transport_t;
+
 static http_client_status_t core_http_request_send(const TransportInterface_t *pTransportInterface,
                                                    const HTTPRequestInfo_t *requestInfo, http_client_header_t *headers,
                                                    uint8_t headers_count, const uint8_t *pRequestBodyBuf,
@@ -74,57 +112,264 @@ static http_client_status_t core_http_request_send(const TransportInterface_t *p
     return HTTP_CLIENT_SUCCESS;
 }
 
-http_client_status_t http_client_request(const http_client_request_t *request, http_client_response_t *response)
+static void __http_client_close(NetworkContext_t network)
+{
+    tuya_transporter_close(network);
+    tuya_transporter_destroy(network);
+}
+
+static http_client_status_t __http_client_connect(const http_client_request_t *request, TUYA_TRANSPORT_TYPE_E type,
+                                                  uint16_t port, NetworkContext_t *network)
 {
-    http_client_status_t rt = HTTP_CLIENT_SUCCESS;
     int ret = OPRT_OK;
 
-    /* TLS pre init */
-    NetworkContext_t network;
-    TUYA_TRANSPORT_TYPE_E transport_type = (request->cacert == NULL) ? TRANSPORT_TYPE_TCP : TRANSPORT_TYPE_TLS;
-    network = tuya_transporter_create(transport_type, NULL);
-    if (NULL == network) {
+    *network = tuya_transporter_create(type, NULL);
+    if (NULL == *network) {
         return HTTP_CLIENT_MALLOC_FAULT;
     }
 
-    if (transport_type == TRANSPORT_TYPE_TLS) {
+    if (type == TRANSPORT_TYPE_TLS) {
         tuya_tls_config_t tls_config = {
             .ca_cert = (char *)request->cacert,
             .ca_cert_size = request->cacert_len,
             .hostname = (char *)request->host,
-            .port = (request->port == 0) ? DEFAULT_HTTPS_PORT : request->port,
+            .port = port,
             .timeout = request->timeout_ms,
             .mode = TUYA_TLS_SERVER_CERT_MODE,
             .verify = true,
         };
 
-        ret = tuya_transporter_ctrl(network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config);
+        ret = tuya_transporter_ctrl(*network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config);
         if (OPRT_OK != ret) {
             log_error("network_tls_init fail:%d", ret);
-            return ret;
+            tuya_transporter_destroy(*network);
+            *network = NULL;
+            return HTTP_CLIENT_SEND_FAULT;
         }
+    }
 
-        ret = tuya_transporter_connect(network, tls_config.hostname, tls_config.port, tls_config.timeout);
-        if (OPRT_OK != ret) {
-            tuya_transporter_close(network);
-            tuya_transporter_destroy(network);
-            return HTTP_CLIENT_SEND_FAULT;
+    // a request and a handshake flight are several small writes, do not hold them back until the peer ACKs
+    tuya_tcp_config_t tcp_config = {.isDisableNagle = 1};
+    tuya_transporter_ctrl(*network, TUYA_TRANSPORTER_SET_TCP_CONFIG, &tcp_config);
+
+    ret = tuya_transporter_connect(*network, request->host, port, request->timeout_ms);
+    if (OPRT_OK != ret) {
+        __http_client_close(*network);
+        *network = NULL;
+        return HTTP_CLIENT_SEND_FAULT;
+    }
+
+    sg_pool_stat.connects++;
+    log_debug("%s connected!", (type == TRANSPORT_TYPE_TLS) ? "tls" : "tcp");
+
+    return HTTP_CLIENT_SUCCESS;
+}
+
+#if (HTTP_CLIENT_POOL_NUM > 0)
+static OPERATE_RET __http_pool_lock(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    MUTEX_HANDLE mutex = NULL;
+
+    if (NULL == sg_pool_mutex) {
+        rt = tal_mutex_create_init(&mutex);
+        if (OPRT_OK != rt) {
+            return rt;
         }
 
-        log_debug("tls connencted!");
-    } else {
-        ret = tuya_transporter_connect(network, request->host, (request->port == 0) ? DEFAULT_HTTP_PORT : request->port,
-                                       request->timeout_ms);
-        if (OPRT_OK != ret) {
-            tuya_transporter_close(network);
-            tuya_transporter_destroy(network);
-            return HTTP_CLIENT_SEND_FAULT;
+        // two first requests may race here, the loser releases its mutex
+        TAL_ENTER_CRITICAL();
+        if (NULL == sg_pool_mutex) {
+            sg_pool_mutex = mutex;
+            mutex = NULL;
+        }
+        TAL_EXIT_CRITICAL();
+
+        if (mutex) {
+            tal_mutex_release(mutex);
+        }
+    }
+
+    return tal_mutex_lock(sg_pool_mutex);
+}
+
+static void __http_pool_evict(http_client_conn_t *conn)
+{
+    __http_client_close(conn->network);
+    conn->network = NULL;
+    conn->valid = false;
+}
+
+static void __http_pool_ca_digest(const uint8_t *cacert, size_t cacert_len, uint8_t *digest)
+{
+    memset(digest, 0, HTTP_CLIENT_CA_DIGEST_LEN);
+    if (cacert && cacert_len > 0) {
+        tal_sha256_ret(cacert, cacert_len, digest, 0);
+    }
+}
+
+/* closes the connections idle for HTTP_CLIENT_POOL_IDLE_MS, called with the pool locked */
+static void __http_pool_reap(SYS_TIME_T now)
+{
+    int i = 0;
+    SYS_TIME_T next = 0;
+    http_client_conn_t *conn = NULL;
+
+    for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+        conn = &sg_conn_pool[i];
+        if (!conn->valid) {
+            continue;
+        }
+
+        if (now - conn->idle_since >= HTTP_CLIENT_POOL_IDLE_MS) {
+            __http_pool_evict(conn);
+        } else if (0 == next || HTTP_CLIENT_POOL_IDLE_MS - (now - conn->idle_since) < next) {
+            next = HTTP_CLIENT_POOL_IDLE_MS - (now - conn->idle_since);
+        }
+    }
+
+    // the TLS context of an idle connection stays allocated until it is closed
+    if (next > 0 && sg_pool_timer) {
+        tal_sw_timer_start(sg_pool_timer, (TIME_MS)next, TAL_TIMER_ONCE);
+    }
+}
+
+static void __http_pool_timer_cb(TIMER_ID timer_id, void *arg)
+{
+    if (OPRT_OK != tal_mutex_lock(sg_pool_mutex)) {
+        return;
+    }
+
+    __http_pool_reap(tal_system_get_millisecond());
+    tal_mutex_unlock(sg_pool_mutex);
+}
+#endif
+
+/* takes an idle connection to the same server out of the pool */
+static NetworkContext_t __http_pool_take(const char *host, uint16_t port, TUYA_TRANSPORT_TYPE_E type,
+                                         const uint8_t *ca_digest)
+{
+    NetworkContext_t network = NULL;
+#if (HTTP_CLIENT_POOL_NUM > 0)
+    int i = 0;
+    SYS_TIME_T now = 0;
+    http_client_conn_t *conn = NULL;
+
+    if (OPRT_OK != __http_pool_lock()) {
+        return NULL;
+    }
+
+    now = tal_system_get_millisecond();
+    for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+        conn = &sg_conn_pool[i];
+        if (!conn->valid) {
+            continue;
+        }
+
+        if (now - conn->idle_since >= HTTP_CLIENT_POOL_IDLE_MS) {
+            __http_pool_evict(conn);
+            continue;
+        }
+
+        if (NULL != network || conn->type != type || conn->port != port ||
+            0 != memcmp(conn->ca_digest, ca_digest, HTTP_CLIENT_CA_DIGEST_LEN) || 0 != strcmp(conn->host, host)) {
+            continue;
+        }
+
+        // an idle connection has nothing to read, unless the server closed it
+        if (0 != tuya_transporter_poll_read(conn->network, 0)) {
+            __http_pool_evict(conn);
+            continue;
         }
+
+        network = conn->network;
+        conn->network = NULL;
+        conn->valid = false;
+        sg_pool_stat.reuses++;
     }
+
+    tal_mutex_unlock(sg_pool_mutex);
+#endif
+
+    return network;
+}
+
+/* returns a connection to the pool, or closes it when the pool is off or the host does not fit */
+static void __http_pool_put(NetworkContext_t network, const char *host, uint16_t port, TUYA_TRANSPORT_TYPE_E type,
+                            const uint8_t *ca_digest)
+{
+#if (HTTP_CLIENT_POOL_NUM > 0)
+    int i = 0;
+    http_client_conn_t *conn = NULL;
+
+    if (strlen(host) < HTTP_CLIENT_HOST_LEN && OPRT_OK == __http_pool_lock()) {
+        // a free slot, or the connection idle for the longest time
+        conn = &sg_conn_pool[0];
+        for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+            if (!sg_conn_pool[i].valid) {
+                conn = &sg_conn_pool[i];
+                break;
+            }
+            if (sg_conn_pool[i].idle_since < conn->idle_since) {
+                conn = &sg_conn_pool[i];
+            }
+        }
+
+        if (conn->valid) {
+            __http_pool_evict(conn);
+        }
+
+        conn->network = network;
+        conn->type = type;
+        memcpy(conn->ca_digest, ca_digest, HTTP_CLIENT_CA_DIGEST_LEN);
+        conn->port = port;
+        strcpy(conn->host, host);
+        conn->idle_since = tal_system_get_millisecond();
+        conn->valid = true;
+
+        // closes the connection if no request takes it in time
+        if (NULL == sg_pool_timer) {
+            tal_sw_timer_create(__http_pool_timer_cb, NULL, &sg_pool_timer);
+        }
+        if (sg_pool_timer && !tal_sw_timer_is_running(sg_pool_timer)) {
+            tal_sw_timer_start(sg_pool_timer, HTTP_CLIENT_POOL_IDLE_MS, TAL_TIMER_ONCE);
+        }
+
+        tal_mutex_unlock(sg_pool_mutex);
+        return;
+    }
+#endif
+
+    __http_client_close(network);
+}
+
+static int32_t __http_transport_send(NetworkContext_t *pNetwork, const void *pBuffer, size_t bytesToSend)
+{
+    http_client_transport_t *transport = (http_client_transport_t *)pNetwork;
+
+    int ret = NetworkTransportSend(&transport->network, pBuffer, bytesToSend);
+    if (ret > 0) {
+        transport->sent += ret;
+    }
+    return ret;
+}
+
+/* a request the server may get twice without harm */
+static bool __http_method_idempotent(const char *method)
+{
+    return 0 == strcmp(method, "GET") || 0 == strcmp(method, "HEAD") || 0 == strcmp(method, "OPTIONS");
+}
+
+static http_client_status_t __http_client_send(NetworkContext_t network, const http_client_request_t *request,
+                                               HTTPResponse_t *http_response, size_t *sent)
+{
+    http_client_status_t rt = HTTP_CLIENT_SUCCESS;
+    http_client_transport_t transport = {.network = network, .sent = 0};
+
     /* http client TransportInterface */
-    TransportInterface_t pTransportInterface = {.pNetworkContext = (NetworkContext_t *)&network,
+    TransportInterface_t pTransportInterface = {.pNetworkContext = (NetworkContext_t *)&transport,
                                                 .recv = (TransportRecv_t)NetworkTransportRecv,
-                                                .send = (TransportSend_t)NetworkTransportSend};
+                                                .send = (TransportSend_t)__http_transport_send};
 
     /* http client request object make */
     HTTPRequestInfo_t requestInfo = {
@@ -134,21 +379,77 @@ http_client_status_t http_client_request(const http_client_request_t *request, h
         .hostLen = strlen(request->host),
         .pPath = request->path,
         .pathLen = strlen(request->path),
+        .reqFlags = (HTTP_CLIENT_POOL_NUM > 0) ? HTTP_REQUEST_KEEP_ALIVE_FLAG : 0,
     };
 
-    HTTPResponse_t http_response = {0};
+    memset(http_response, 0, sizeof(HTTPResponse_t));
 
     /* HTTP request send */
     log_debug("http request send!");
     rt = core_http_request_send((const TransportInterface_t *)&pTransportInterface,
                                 (const HTTPRequestInfo_t *)&requestInfo, request->headers, request->headers_count,
-                                (const uint8_t *)request->body, request->body_length, &http_response);
+                                (const uint8_t *)request->body, request->body_length, http_response);
+    *sent = transport.sent;
+    return rt;
+}
 
-    /* tls disconnect */
-    tuya_transporter_close(network);
-    tuya_transporter_destroy(network);
+http_client_status_t http_client_request(const http_client_request_t *request, http_client_response_t *response)
+{
+    http_client_status_t rt = HTTP_CLIENT_SUCCESS;
+    NetworkContext_t network = NULL;
+    HTTPResponse_t http_response = {0};
+    tuya_tls_config_t *tls_config = NULL;
+    bool reused = false;
+    size_t sent = 0;
+    uint8_t ca_digest[HTTP_CLIENT_CA_DIGEST_LEN] = {0};
+
+    TUYA_TRANSPORT_TYPE_E transport_type = (request->cacert == NULL) ? TRANSPORT_TYPE_TCP : TRANSPORT_TYPE_TLS;
+    uint16_t port = request->port;
+    if (0 == port) {
+        port = (transport_type == TRANSPORT_TYPE_TLS) ? DEFAULT_HTTPS_PORT : DEFAULT_HTTP_PORT;
+    }
+
+#if (HTTP_CLIENT_POOL_NUM > 0)
+    __http_pool_ca_digest(request->cacert, request->cacert_len, ca_digest);
+#endif
+    network = __http_pool_take(request->host, port, transport_type, ca_digest);
+    if (network) {
+        reused = true;
+        // the receive timeout of the connection is taken from its TLS config
+        tuya_transporter_ctrl(network, TUYA_TRANSPORTER_GET_TLS_CONFIG, &tls_config);
+        if (tls_config) {
+            tls_config->timeout = request->timeout_ms;
+        }
+    } else {
+        rt = __http_client_connect(request, transport_type, port, &network);
+        if (HTTP_CLIENT_SUCCESS != rt) {
+            return rt;
+        }
+    }
+
+    rt = __http_client_send(network, request, &http_response, &sent);
+    if (HTTP_CLIENT_SEND_FAULT == rt && reused && (0 == sent || __http_method_idempotent(request->method))) {
+        // the server dropped the kept connection, send once more on a new one. A request it may have
+        // taken already is only sent again when that does no harm.
+        log_debug("kept connection to %s lost, reconnect", request->host);
+        __http_client_close(network);
+        sg_pool_stat.retries++;
+
+        rt = __http_client_connect(request, transport_type, port, &network);
+        if (HTTP_CLIENT_SUCCESS != rt) {
+            return rt;
+        }
+        rt = __http_client_send(network, request, &http_response, &sent);
+    }
 
-    if (OPRT_OK != rt) {
+    if (HTTP_CLIENT_SUCCESS == rt && HTTP_CLIENT_POOL_NUM > 0 &&
+        0 == (http_response.respFlags & HTTP_RESPONSE_CONNECTION_CLOSE_FLAG)) {
+        __http_pool_put(network, request->host, port, transport_type, ca_digest);
+    } else {
+        __http_client_close(network);
+    }
+
+    if (HTTP_CLIENT_SUCCESS != rt) {
         log_error("http_request_send error:%d", rt);
         return rt;
     }
@@ -165,6 +466,32 @@ http_client_status_t http_client_request(const http_client_request_t *request, h
     return HTTP_CLIENT_SUCCESS;
 }
 
+void http_client_pool_flush(void)
+{
+#if (HTTP_CLIENT_POOL_NUM > 0)
+    int i = 0;
+
+    if (OPRT_OK != __http_pool_lock()) {
+        return;
+    }
+
+    for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+        if (sg_conn_pool[i].valid) {
+            __http_pool_evict(&sg_conn_pool[i]);
+        }
+    }
+
+    tal_mutex_unlock(sg_pool_mutex);
+#endif
+}
+
+void http_client_pool_stat_get(http_client_pool_stat_t *stat)
+{
+    if (stat) {
+        *stat = sg_pool_stat;
+    }
+}
+
 int http_client_free(http_client_response_t *response)
 {
     if (NULL == response) {
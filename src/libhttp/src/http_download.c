@@ -17,21 +17,37 @@ typedef enum {
     DL_STATE_COMPLETE,
 } http_download_state_t;
 
+/* one connection and the range it is receiving */
 typedef struct {
-    http_download_config_t config;
-    http_download_event_t event;
+    NetworkContext_t network;
     TransportInterface_t transport;
     HTTPRequestHeaders_t requestHeaders;
-    HTTPRequestInfo_t requestInfo;
     HTTPResponse_t response;
+    uint8_t state;
+    uint8_t fails;
+    bool connected;
+    size_t start;        // first byte of the range
+    size_t len;          // range length
+    size_t got;          // bytes of the range received
+    size_t sent;         // bytes of the range delivered
+    uint8_t *buffer;     // range received ahead of the delivery, range_max bytes
+    SYS_TIME_T retry_at; // reconnect not before
+    SYS_TIME_T req_time; // range requested at
+} http_download_worker_t;
+
+typedef struct {
+    http_download_config_t config;
+    http_download_event_t event;
+    HTTPRequestInfo_t requestInfo;
+    http_download_worker_t *workers;
     char *host;
     char *path;
     uint16_t port;
     size_t file_size;
-    size_t received_size;
+    size_t received_size; // bytes delivered, the next DL_EVENT_ON_DATA starts here
+    size_t next_start;    // first byte no range was requested for
+    size_t range_size;    // size of the next range request
     size_t remain_len;
-    size_t offset;
-    uint8_t state;
     uint8_t *buffer;
 } http_download_t;
 
@@ -46,6 +62,29 @@ typedef struct {
  */
 #define RANGE_REQUEST_LENGTH_DEFAULT (8 * 1024)
 
+/**
+ * @brief The largest range received ahead of the delivery by default.
+ */
+#define RANGE_REQUEST_MAX_DEFAULT (32 * 1024)
+
+/**
+ * @brief A range request should take about this long at the measured
+ * throughput, a longer one loses more on a drop, a shorter one spends more
+ * round trips on requests.
+ */
+#ifndef HTTP_DOWNLOAD_RANGE_TARGET_MS
+#define HTTP_DOWNLOAD_RANGE_TARGET_MS (4 * 1000)
+#endif
+
+/**
+ * @brief Reconnect delay after the first failure, doubled by every further
+ * failure of the connection up to HTTP_DOWNLOAD_RETRY_MAX_MS.
+ */
+#define HTTP_DOWNLOAD_RETRY_MIN_MS 500
+#define HTTP_DOWNLOAD_RETRY_MAX_MS (16 * 1000)
+
+#define HTTP_DOWNLOAD_CONN_MAX 4
+
 /**
  * @brief The length of the HTTP GET method.
  */
@@ -70,7 +109,18 @@ typedef struct {
 #define HTTP_DOWNLOAD_TIMEOUT 180
 
 /*-----------------------------------------------------------*/
-static int http_download_filesize_get(http_download_t *ctx)
+static void http_download_response_free(http_download_worker_t *w)
+{
+    if (w->response.pBuffer) {
+        tal_free(w->response.pBuffer);
+    }
+    if (w->response.pBody) {
+        tal_free((void *)w->response.pBody);
+    }
+    memset(&w->response, 0, sizeof(w->response));
+}
+
+static int http_download_filesize_get(http_download_t *ctx, http_download_worker_t *w)
 {
     int rt = 0;
     /* The location of the file size in contentRangeValStr. */
@@ -80,19 +130,19 @@ static int http_download_filesize_get(http_download_t *ctx)
     size_t contentRangeValStrLength = 0;
 
     PR_DEBUG("Getting file object size from host...");
-    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&ctx->requestHeaders, &ctx->requestInfo), __exit);
-    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&ctx->requestHeaders, 0, 0), __exit);
-    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&ctx->transport, &ctx->requestHeaders, NULL, 0, &ctx->response, 0), __exit);
+    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&w->requestHeaders, &ctx->requestInfo), __exit);
+    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&w->requestHeaders, 0, 0), __exit);
+    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&w->transport, &w->requestHeaders, NULL, 0, &w->response, 0), __exit);
     PR_DEBUG("Received HTTP response from %s%s...", ctx->host, ctx->path);
-    PR_DEBUG("Response Headers:\n%.*s", (int32_t)ctx->response.headersLen, ctx->response.pHeaders);
-    if (ctx->response.statusCode != HTTP_STATUS_CODE_PARTIAL_CONTENT) {
+    PR_DEBUG("Response Headers:\n%.*s", (int32_t)w->response.headersLen, w->response.pHeaders);
+    if (w->response.statusCode != HTTP_STATUS_CODE_PARTIAL_CONTENT) {
         PR_ERR("Received an invalid response from the server "
                "(Status Code: %u).",
-               ctx->response.statusCode);
+               w->response.statusCode);
         rt = OPRT_NOT_SUPPORTED;
         goto __exit;
     }
-    TUYA_CALL_ERR_GOTO(HTTPClient_ReadHeader(&ctx->response, (char *)HTTP_CONTENT_RANGE_HEADER_FIELD,
+    TUYA_CALL_ERR_GOTO(HTTPClient_ReadHeader(&w->response, (char *)HTTP_CONTENT_RANGE_HEADER_FIELD,
                                              (size_t)HTTP_CONTENT_RANGE_HEADER_FIELD_LENGTH,
                                              (const char **)&contentRangeValStr, &contentRangeValStrLength),
                        __exit);
@@ -105,35 +155,253 @@ static int http_download_filesize_get(http_download_t *ctx)
     pFileSizeStr += sizeof(char);
     ctx->file_size = (size_t)strtoul(pFileSizeStr, NULL, 10);
     PR_INFO("The file is %d bytes long.", (int32_t)ctx->file_size);
-    if (ctx->response.pBuffer) {
-        tal_free(ctx->response.pBuffer);
-    }
-    memset(&ctx->response, 0, sizeof(ctx->response));
 __exit:
+    http_download_response_free(w);
     return rt;
 }
 
-static int http_download_range_request(http_download_t *ctx, uint32_t range_start, uint32_t range_end)
+static int http_download_range_request(http_download_t *ctx, http_download_worker_t *w, uint32_t range_start,
+                                       uint32_t range_end)
 {
     int rt = OPRT_OK;
 
     PR_DEBUG("Downloading bytes %d-%d, from %s...: ", range_start, range_end, ctx->host);
-    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&ctx->requestHeaders, &ctx->requestInfo), __exit);
-    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&ctx->requestHeaders, range_start, range_end), __exit);
-    PR_TRACE("Request Headers:\n%.*s", (int32_t)ctx->requestHeaders.headersLen, (char *)ctx->requestHeaders.pBuffer);
-    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&ctx->transport, &ctx->requestHeaders, NULL, 0, &ctx->response,
+    http_download_response_free(w);
+    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&w->requestHeaders, &ctx->requestInfo), __exit);
+    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&w->requestHeaders, range_start, range_end), __exit);
+    PR_TRACE("Request Headers:\n%.*s", (int32_t)w->requestHeaders.headersLen, (char *)w->requestHeaders.pBuffer);
+    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&w->transport, &w->requestHeaders, NULL, 0, &w->response,
                                           HTTP_SEND_DISABLE_RECV_BODY_FLAG),
                        __exit);
     PR_TRACE("Received HTTP response from %s%s...", ctx->host, ctx->path);
-    PR_TRACE("Response Headers:\n%.*s", (int32_t)ctx->response.headersLen, ctx->response.pHeaders);
+    PR_TRACE("Response Headers:\n%.*s", (int32_t)w->response.headersLen, w->response.pHeaders);
+    if (w->response.statusCode != HTTP_STATUS_CODE_PARTIAL_CONTENT) {
+        PR_ERR("range request status code %u", w->response.statusCode);
+        rt = OPRT_NOT_SUPPORTED;
+    }
 __exit:
     return rt;
 }
 
+/* body bytes read together with the headers first, never more than len */
+static int32_t http_download_recv(http_download_worker_t *w, uint8_t *data, size_t len)
+{
+    size_t n = 0;
+
+    if (w->response.pBody && w->response.bodyLen) {
+        n = (w->response.bodyLen < len) ? w->response.bodyLen : len;
+        memcpy(data, w->response.pBody, n);
+        w->response.bodyLen -= n;
+        if (w->response.bodyLen) {
+            memmove((void *)w->response.pBody, w->response.pBody + n, w->response.bodyLen);
+        } else {
+            tal_free((void *)w->response.pBody);
+            w->response.pBody = NULL;
+        }
+        return (int32_t)n;
+    }
+
+    return HTTPClient_Recv(&w->transport, &w->response, data, len);
+}
+
+/*-----------------------------------------------------------*/
+/* hands len bytes placed after the remain of the last event to the handler */
+static void http_download_emit(http_download_t *ctx, size_t len)
+{
+    if (ctx->config.event_handler && OPRT_OK == ctx->event.error) {
+        ctx->event.data = (uint8_t *)ctx->buffer;
+        ctx->event.data_len = len + ctx->remain_len;
+        ctx->event.offset = ctx->received_size - ctx->remain_len;
+        ctx->event.remain_len = ctx->remain_len;
+        ctx->config.event_handler(DL_EVENT_ON_DATA, &ctx->event);
+        if (ctx->event.remain_len) {
+            memmove(ctx->buffer, ctx->buffer + (ctx->event.data_len - ctx->event.remain_len), ctx->event.remain_len);
+        }
+        ctx->remain_len = ctx->event.remain_len;
+    }
+    ctx->received_size += len;
+}
+
+/* delivers a range received ahead, in pieces of the event buffer */
+static void http_download_emit_copy(http_download_t *ctx, const uint8_t *data, size_t len)
+{
+    size_t n = 0;
+
+    while (len) {
+        n = ctx->config.range_length - ctx->remain_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(ctx->buffer + ctx->remain_len, data, n);
+        http_download_emit(ctx, n);
+        data += n;
+        len -= n;
+    }
+}
+
+/* the next range size, throughput of the last range times the target duration */
+static void http_download_range_adapt(http_download_t *ctx, size_t len, SYS_TIME_T ms)
+{
+    uint64_t size = (uint64_t)len * HTTP_DOWNLOAD_RANGE_TARGET_MS / (ms ? ms : 1);
+
+    if (size < ctx->config.range_length) {
+        size = ctx->config.range_length;
+    }
+    // a range delivered in order is not buffered, the limit only keeps the ranges balanced
+    if (size > ctx->config.range_max * HTTP_DOWNLOAD_CONN_MAX) {
+        size = ctx->config.range_max * HTTP_DOWNLOAD_CONN_MAX;
+    }
+    ctx->range_size = (size_t)size;
+}
+
+static void http_download_worker_fail(http_download_t *ctx, http_download_worker_t *w)
+{
+    uint32_t delay = HTTP_DOWNLOAD_RETRY_MIN_MS;
+
+    tuya_transporter_close(w->network);
+    http_download_response_free(w);
+    w->connected = false;
+    if (w->fails < MAX_RETRY_TIMES) {
+        w->fails++;
+    }
+    delay <<= (w->fails - 1);
+    if (delay > HTTP_DOWNLOAD_RETRY_MAX_MS) {
+        delay = HTTP_DOWNLOAD_RETRY_MAX_MS;
+    }
+    w->retry_at = tal_system_get_millisecond() + delay;
+    w->state = DL_STATE_NETWORK_RECONNECT;
+
+    // a lossy link loses less with shorter ranges
+    ctx->range_size /= 2;
+    if (ctx->range_size < ctx->config.range_length) {
+        ctx->range_size = ctx->config.range_length;
+    }
+    PR_WARN("file download connection error, retry in %dms", delay);
+}
+
+/* takes the next range, a range behind another one in flight is received into the worker buffer */
+static int http_download_worker_assign(http_download_t *ctx, http_download_worker_t *w)
+{
+    size_t len = ctx->range_size;
+
+    if (ctx->next_start != ctx->received_size) {
+        if (NULL == w->buffer) {
+            w->buffer = tal_malloc(ctx->config.range_max);
+            if (NULL == w->buffer) {
+                return OPRT_MALLOC_FAILED;
+            }
+        }
+        if (len > ctx->config.range_max) {
+            len = ctx->config.range_max;
+        }
+    }
+    if (len > ctx->file_size - ctx->next_start) {
+        len = ctx->file_size - ctx->next_start;
+    }
+
+    w->start = ctx->next_start;
+    w->len = len;
+    w->got = 0;
+    w->sent = 0;
+    ctx->next_start += len;
+
+    return OPRT_OK;
+}
+
+/* one step of a connection, returns true when it made progress */
+static bool http_download_worker_run(http_download_t *ctx, http_download_worker_t *w)
+{
+    int rt = OPRT_OK;
+    int32_t read_size = 0;
+    size_t len = 0;
+    bool head = false;
+
+    switch (w->state) {
+    case DL_STATE_IDLE:
+        if (ctx->next_start >= ctx->file_size) {
+            return false;
+        }
+        if (OPRT_OK != http_download_worker_assign(ctx, w)) {
+            return false;
+        }
+        w->state = w->connected ? DL_STATE_RANGE_REQUEST : DL_STATE_NETWORK_CONNECT;
+        return true;
+
+    case DL_STATE_NETWORK_RECONNECT:
+        if (tal_system_get_millisecond() < w->retry_at) {
+            return false;
+        }
+        w->state = DL_STATE_NETWORK_CONNECT;
+        // fall through
+    case DL_STATE_NETWORK_CONNECT:
+        rt = tuya_transporter_connect(w->network, ctx->host, ctx->port, ctx->config.timeout_ms);
+        if (OPRT_OK != rt) {
+            http_download_worker_fail(ctx, w);
+            return false;
+        }
+        w->connected = true;
+        w->state = DL_STATE_RANGE_REQUEST;
+        return true;
+
+    case DL_STATE_RANGE_REQUEST:
+        rt = http_download_range_request(ctx, w, w->start + w->got, w->start + w->len - 1);
+        if (OPRT_OK != rt) {
+            http_download_worker_fail(ctx, w);
+            return false;
+        }
+        w->req_time = tal_system_get_millisecond();
+        w->state = DL_STATE_DATE_GET;
+        return true;
+
+    case DL_STATE_DATE_GET:
+        head = (w->start + w->sent == ctx->received_size);
+        if (head && w->sent < w->got) {
+            http_download_emit_copy(ctx, w->buffer + w->sent, w->got - w->sent);
+            w->sent = w->got;
+        }
+        if (w->got == w->len) {
+            if (w->sent < w->len) {
+                // wait until the ranges before it are delivered
+                return false;
+            }
+            http_download_range_adapt(ctx, w->len, tal_system_get_millisecond() - w->req_time);
+            w->fails = 0;
+            w->state = DL_STATE_IDLE;
+            return true;
+        }
+
+        len = w->len - w->got;
+        if (head) {
+            // in order, straight into the event buffer
+            if (len > ctx->config.range_length - ctx->remain_len) {
+                len = ctx->config.range_length - ctx->remain_len;
+            }
+            read_size = http_download_recv(w, ctx->buffer + ctx->remain_len, len);
+        } else {
+            read_size = http_download_recv(w, w->buffer + w->got, len);
+        }
+        if (read_size <= 0) {
+            PR_WARN("file download range get error:%d, goto retry", read_size);
+            http_download_worker_fail(ctx, w);
+            return false;
+        }
+        w->got += read_size;
+        if (head) {
+            w->sent = w->got;
+            http_download_emit(ctx, read_size);
+        }
+        return true;
+
+    default:
+        return false;
+    }
+}
+
 /*-----------------------------------------------------------*/
 static int http_file_download_init(http_download_t *ctx, http_download_config_t *config)
 {
     int rt = OPRT_OK;
+    uint8_t i = 0;
 
     if (NULL == ctx || NULL == config || NULL == config->url) {
         return OPRT_INVALID_PARM;
@@ -145,7 +413,22 @@ static int http_file_download_init(http_download_t *ctx, http_download_config_t
     if (config->range_length == 0) {
         ctx->config.range_length = RANGE_REQUEST_LENGTH_DEFAULT;
     }
+    if (config->range_max == 0) {
+        ctx->config.range_max = RANGE_REQUEST_MAX_DEFAULT;
+    }
+    if (ctx->config.range_max < ctx->config.range_length) {
+        ctx->config.range_max = ctx->config.range_length;
+    }
+    if (config->conn_num == 0) {
+        ctx->config.conn_num = 1;
+    } else if (config->conn_num > HTTP_DOWNLOAD_CONN_MAX) {
+        ctx->config.conn_num = HTTP_DOWNLOAD_CONN_MAX;
+    }
+    ctx->range_size = ctx->config.range_max;
+    ctx->received_size = ctx->config.offset;
+    ctx->next_start = ctx->config.offset;
     ctx->event.user_data = ctx->config.user_data;
+    ctx->event.offset = ctx->config.offset;
 
     /* url parse to host port path */
     struct http_parser_url purl;
@@ -195,142 +478,147 @@ static int http_file_download_init(http_download_t *ctx, http_download_config_t
     requestInfo->pPath = ctx->path;
     requestInfo->pathLen = strlen(ctx->path);
     requestInfo->reqFlags = HTTP_REQUEST_KEEP_ALIVE_FLAG;
-    /* Set the buffer used for storing request headers. */
 
-    HTTPRequestHeaders_t *requestHeaders = &ctx->requestHeaders;
-    requestHeaders->bufferLen = 512;
-    requestHeaders->pBuffer = tal_malloc(requestHeaders->bufferLen);
-    TUYA_CHECK_NULL_RETURN(requestHeaders->pBuffer, OPRT_MALLOC_FAILED);
+    ctx->workers = tal_calloc(ctx->config.conn_num, sizeof(http_download_worker_t));
+    TUYA_CHECK_NULL_RETURN(ctx->workers, OPRT_MALLOC_FAILED);
+
+    for (i = 0; i < ctx->config.conn_num; i++) {
+        /* Set the buffer used for storing request headers. */
+        HTTPRequestHeaders_t *requestHeaders = &ctx->workers[i].requestHeaders;
+        requestHeaders->bufferLen = 512;
+        requestHeaders->pBuffer = tal_malloc(requestHeaders->bufferLen);
+        TUYA_CHECK_NULL_RETURN(requestHeaders->pBuffer, OPRT_MALLOC_FAILED);
+    }
 
     return rt;
 }
 
-int http_file_download(http_download_config_t *config)
+static int http_download_worker_transport_init(http_download_t *ctx, http_download_worker_t *w)
 {
     int rt = OPRT_OK;
 
-    http_download_t *ctx = tal_calloc(1, sizeof(http_download_t));
-    TUYA_CHECK_NULL_GOTO(ctx, __exit);
-    TUYA_CALL_ERR_GOTO(http_file_download_init(ctx, config), __exit);
     /* TLS pre init */
-    TUYA_TRANSPORT_TYPE_E transport_type = (config->cacert == NULL) ? TRANSPORT_TYPE_TCP : TRANSPORT_TYPE_TLS;
-    NetworkContext_t network;
-    TUYA_CHECK_NULL_GOTO(network = tuya_transporter_create(transport_type, NULL), __exit);
+    TUYA_TRANSPORT_TYPE_E transport_type =
+        (ctx->config.cacert == NULL) ? TRANSPORT_TYPE_TCP : TRANSPORT_TYPE_TLS;
+    TUYA_CHECK_NULL_RETURN(w->network = tuya_transporter_create(transport_type, NULL), OPRT_MALLOC_FAILED);
     if (transport_type == TRANSPORT_TYPE_TLS) {
         tuya_tls_config_t tls_config = {
-            .ca_cert = (char *)config->cacert,
-            .ca_cert_size = config->cacert_len,
+            .ca_cert = (char *)ctx->config.cacert,
+            .ca_cert_size = ctx->config.cacert_len,
             .hostname = (char *)ctx->host,
             .port = ctx->port,
             .mode = TUYA_TLS_SERVER_CERT_MODE,
             .verify = true,
         };
 
-        TUYA_CALL_ERR_GOTO(tuya_transporter_ctrl(network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config), __exit);
+        TUYA_CALL_ERR_RETURN(tuya_transporter_ctrl(w->network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config));
     }
     /* http client TransportInterface */
-    ctx->transport.pNetworkContext = (NetworkContext_t *)&network;
-    ctx->transport.send = NetworkTransportSend;
-    ctx->transport.recv = NetworkTransportRecv;
+    w->transport.pNetworkContext = (NetworkContext_t *)&w->network;
+    w->transport.send = NetworkTransportSend;
+    w->transport.recv = NetworkTransportRecv;
+    w->state = DL_STATE_NETWORK_CONNECT;
 
-    ctx->state = DL_STATE_NETWORK_CONNECT;
-    TIME_T download_time = tal_time_get_posix();
+    return rt;
+}
 
-    bool is_completed = false;
+/* sleeps until the earliest reconnect when no connection can make progress */
+static void http_download_idle_wait(http_download_t *ctx)
+{
+    SYS_TIME_T now = tal_system_get_millisecond();
+    SYS_TIME_T wake = now + 100;
+    uint8_t i = 0;
 
-    int32_t read_size = 0;
+    for (i = 0; i < ctx->config.conn_num; i++) {
+        if (ctx->workers[i].state == DL_STATE_NETWORK_RECONNECT && ctx->workers[i].retry_at < wake) {
+            wake = ctx->workers[i].retry_at;
+        }
+    }
+    if (wake > now) {
+        tal_system_sleep(wake - now);
+    }
+}
 
-    if (ctx->config.event_handler) {
-        ctx->config.event_handler(DL_EVENT_START, &ctx->event);
+int http_file_download(http_download_config_t *config)
+{
+    int rt = OPRT_OK;
+    uint8_t i = 0;
+    bool progress = false;
+    http_download_worker_t *w = NULL;
+
+    http_download_t *ctx = tal_calloc(1, sizeof(http_download_t));
+    TUYA_CHECK_NULL_GOTO(ctx, __exit);
+    TUYA_CALL_ERR_GOTO(http_file_download_init(ctx, config), __exit);
+    for (i = 0; i < ctx->config.conn_num; i++) {
+        TUYA_CALL_ERR_GOTO(http_download_worker_transport_init(ctx, &ctx->workers[i]), __exit);
     }
 
-    do {
+    TIME_T download_time = tal_time_get_posix();
 
-        switch (ctx->state) {
+    bool is_completed = false;
+    bool is_sized = false;
 
-        case DL_STATE_NETWORK_CONNECT:
-            rt = tuya_transporter_connect(network, ctx->host, ctx->port, config->timeout_ms);
-            if (OPRT_OK == rt) {
-                ctx->state = DL_STATE_FILESIZE_GET;
-            } else {
-                ctx->state = DL_STATE_NETWORK_RECONNECT;
-            }
-            break;
+    if (ctx->config.event_handler) {
+        ctx->config.event_handler(DL_EVENT_START, &ctx->event);
+    }
 
-        case DL_STATE_FILESIZE_GET:
-            if (0 == ctx->file_size) {
-                rt = http_download_filesize_get(ctx);
-            }
-            if (OPRT_OK != rt) {
-                ctx->state = DL_STATE_NETWORK_RECONNECT;
-                break;
-            }
-            if (ctx->config.event_handler) {
-                ctx->event.file_size = ctx->file_size;
-                ctx->config.event_handler(DL_EVENT_ON_FILESIZE, &ctx->event);
-            }
-            ctx->state = DL_STATE_RANGE_REQUEST;
-            break;
-
-        case DL_STATE_RANGE_REQUEST:
-            rt = http_download_range_request(ctx, ctx->received_size, ctx->file_size);
-            if (OPRT_OK != rt) {
-                ctx->state = DL_STATE_NETWORK_RECONNECT;
-                break;
-            }
-            ctx->state = DL_STATE_DATE_GET;
+    /* the first connection gets the file size */
+    w = &ctx->workers[0];
+    while (((tal_time_get_posix() - download_time) < HTTP_DOWNLOAD_TIMEOUT)) {
+        if (w->state == DL_STATE_NETWORK_RECONNECT) {
+            http_download_idle_wait(ctx);
+        }
+        if (!http_download_worker_run(ctx, w)) {
+            continue;
+        }
+        rt = (0 == ctx->file_size) ? http_download_filesize_get(ctx, w) : OPRT_OK;
+        if (OPRT_OK != rt) {
+            http_download_worker_fail(ctx, w);
+            continue;
+        }
+        w->state = DL_STATE_IDLE;
+        break;
+    }
 
-        case DL_STATE_DATE_GET: {
-            read_size = HTTPClient_Recv(&ctx->transport, &ctx->response, ctx->buffer + ctx->remain_len,
-                                        ctx->config.range_length - ctx->remain_len);
+    is_sized = (w->state == DL_STATE_IDLE);
+    if (is_sized) {
+        if (ctx->config.event_handler) {
+            ctx->event.file_size = ctx->file_size;
+            ctx->config.event_handler(DL_EVENT_ON_FILESIZE, &ctx->event);
+        }
+        download_time = tal_time_get_posix();
+        /* connections without a range yet start connecting when they get one */
+        for (i = 1; i < ctx->config.conn_num; i++) {
+            ctx->workers[i].state = DL_STATE_IDLE;
+        }
+        is_completed = (ctx->received_size >= ctx->file_size);
+    }
 
-            if (read_size <= 0) {
-                PR_WARN("file download range get error:%d, goto retry", rt);
-                ctx->state = DL_STATE_NETWORK_RECONNECT;
-                break;
-            }
-            if (ctx->config.event_handler) {
-                ctx->event.data = (uint8_t *)ctx->buffer;
-                ctx->event.data_len = read_size + ctx->remain_len;
-                ctx->event.offset = ctx->received_size - ctx->remain_len;
-                ctx->event.remain_len = ctx->remain_len;
-                ctx->config.event_handler(DL_EVENT_ON_DATA, &ctx->event);
-                if (ctx->event.remain_len) {
-                    memmove(ctx->buffer, ctx->buffer + (ctx->event.data_len - ctx->event.remain_len),
-                            ctx->event.remain_len);
-                }
-                ctx->remain_len = ctx->event.remain_len;
-                ctx->received_size += read_size;
+    while (is_sized && !is_completed && OPRT_OK == ctx->event.error &&
+           ((tal_time_get_posix() - download_time) < HTTP_DOWNLOAD_TIMEOUT)) {
+        progress = false;
+        for (i = 0; i < ctx->config.conn_num; i++) {
+            if (http_download_worker_run(ctx, &ctx->workers[i])) {
+                progress = true;
             }
+        }
+        if (progress) {
             //! reset time
             download_time = tal_time_get_posix();
-            /* File download complete? */
-            if (ctx->received_size >= ctx->file_size) {
-                ctx->state = DL_STATE_COMPLETE;
-            }
-            break;
+        } else {
+            http_download_idle_wait(ctx);
         }
+        /* File download complete? */
+        is_completed = (ctx->received_size >= ctx->file_size);
+    }
 
-        case DL_STATE_NETWORK_RECONNECT:
-            tuya_transporter_close(network);
-            tal_system_sleep(3000);
-            ctx->state = DL_STATE_NETWORK_CONNECT;
-            break;
-
-        case DL_STATE_COMPLETE:
-            PR_INFO("Download Complete!");
-            is_completed = true;
-            if (ctx->config.event_handler) {
-                ctx->config.event_handler(DL_EVENT_FINISH, &ctx->event);
-            }
-            break;
+    if (is_completed && OPRT_OK == ctx->event.error) {
+        PR_INFO("Download Complete!");
+        if (ctx->config.event_handler) {
+            ctx->config.event_handler(DL_EVENT_FINISH, &ctx->event);
         }
-    } while (((tal_time_get_posix() - download_time) < HTTP_DOWNLOAD_TIMEOUT) && !is_completed);
-
-    tuya_transporter_close(network);
-    tuya_transporter_destroy(network);
-
-    if (!is_completed) {
+    } else {
+        rt = (OPRT_OK != ctx->event.error) ? ctx->event.error : OPRT_TIMEOUT;
         if (ctx->config.event_handler) {
             ctx->config.event_handler(DL_EVENT_FAULT, &ctx->event);
         }
@@ -338,17 +626,31 @@ int http_file_download(http_download_config_t *config)
 
 __exit:
     if (ctx) {
+        if (ctx->workers) {
+            for (i = 0; i < ctx->config.conn_num; i++) {
+                w = &ctx->workers[i];
+                if (w->network) {
+                    tuya_transporter_close(w->network);
+                    tuya_transporter_destroy(w->network);
+                }
+                if (w->requestHeaders.pBuffer) {
+                    tal_free(w->requestHeaders.pBuffer);
+                }
+                http_download_response_free(w);
+                if (w->buffer) {
+                    tal_free(w->buffer);
+                }
+            }
+            tal_free(ctx->workers);
+        }
         if (ctx->host) {
             tal_free(ctx->host);
         }
         if (ctx->path) {
             tal_free(ctx->path);
         }
-        if (ctx->requestHeaders.pBuffer) {
-            tal_free(ctx->requestHeaders.pBuffer);
-        }
-        if (ctx->response.pBuffer) {
-            tal_free(ctx->response.pBuffer);
+        if (ctx->buffer) {
+            tal_free(ctx->buffer);
         }
 
         tal_free(ctx);
@@ -16,6 +16,7 @@
 #include "tkl_memory.h"
 #include "tal_api.h"
 #include "tdl_display_manage.h"
+#include "tdl_display_pixel.h"
 
 #if defined(ENABLE_LVGL_DMA2D) && (ENABLE_LVGL_DMA2D == 1)
 #include "tkl_dma2d.h"
@@ -39,6 +40,8 @@ static void disp_deinit(void);
 
 static void disp_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p);
 
+static void disp_monitor(lv_disp_drv_t * disp_drv, uint32_t time, uint32_t px);
+
 static uint8_t * __disp_draw_buf_align_alloc(uint32_t size_bytes);
 
 static uint8_t __disp_get_pixels_size_bytes(TUYA_DISPLAY_PIXEL_FMT_E pixel_fmt);
@@ -55,10 +58,14 @@ static TDL_DISP_DEV_INFO_T sg_display_info;
 
 #if 1
 static TDL_DISP_FRAME_BUFF_T sg_display_fb;
+static TDL_DISP_DIRTY_AREA_T sg_dirty_area;
 static uint8_t *sg_frame_1 = NULL;
 #if defined(ENABLE_LVGL_DUAL_DISP_BUFF) && (ENABLE_LVGL_DUAL_DISP_BUFF == 1)
 static uint8_t *sg_frame_2 = NULL;
 #endif
+#if defined(ENABLE_LVGL_SWAP_CHAIN) && (ENABLE_LVGL_SWAP_CHAIN == 1)
+static bool sg_swap_chain = false;
+#endif
 #else
 static TDL_DISP_FRAME_BUFF_T *sg_p_display_fb = NULL; 
 static TDL_DISP_FRAME_BUFF_T *sg_p_display_fb_1 = NULL;
@@ -67,6 +74,8 @@ static TDL_DISP_FRAME_BUFF_T *sg_p_display_fb_2 = NULL;
 #endif
 #endif
 
+static lv_port_disp_stat_t sg_disp_stat;
+
 /**********************
  *      MACROS
  **********************/
@@ -112,22 +121,38 @@ void lv_port_disp_init(char *device)
 
     uint32_t buf_len = (sg_display_info.height / LV_DRAW_BUF_PARTS) * sg_display_info.width * per_pixel_byte;
 
-    /* Example for 2) */
     static lv_disp_draw_buf_t draw_buf_dsc_2;
-    static uint8_t *buf_2_1;
-    buf_2_1 = __disp_draw_buf_align_alloc(buf_len);
-    if (buf_2_1 == NULL) {
-        PR_ERR("malloc failed");
-        return;
+
+#if defined(ENABLE_LVGL_SWAP_CHAIN) && (ENABLE_LVGL_SWAP_CHAIN == 1)
+    /* Example for 3) in direct mode:
+     * LVGL renders straight into the two display frame buffers, only the invalidated areas*/
+    if (__disp_get_pixels_size_bytes(sg_display_info.fmt) == sizeof(lv_color_t) && LV_COLOR_16_SWAP == 0 &&
+        sg_frame_1 && sg_frame_2) {
+        lv_disp_draw_buf_init(&draw_buf_dsc_2, sg_frame_1, sg_frame_2, sg_display_info.width * sg_display_info.height);
+        sg_swap_chain = true;
+        PR_NOTICE("lvgl renders into the display frame buffers");
     }
 
-    static uint8_t *buf_2_2;
-    buf_2_2 = __disp_draw_buf_align_alloc(buf_len);
-    if (buf_2_2 == NULL) {
-        PR_ERR("malloc failed");
-        return;
+    if (false == sg_swap_chain) {
+#else
+    {
+#endif
+        /* Example for 2) */
+        static uint8_t *buf_2_1;
+        buf_2_1 = __disp_draw_buf_align_alloc(buf_len);
+        if (buf_2_1 == NULL) {
+            PR_ERR("malloc failed");
+            return;
+        }
+
+        static uint8_t *buf_2_2;
+        buf_2_2 = __disp_draw_buf_align_alloc(buf_len);
+        if (buf_2_2 == NULL) {
+            PR_ERR("malloc failed");
+            return;
+        }
+        lv_disp_draw_buf_init(&draw_buf_dsc_2, buf_2_1, buf_2_2, buf_len/per_pixel_byte);   /*Initialize the display buffer*/
     }
-    lv_disp_draw_buf_init(&draw_buf_dsc_2, buf_2_1, buf_2_2, buf_len/per_pixel_byte);   /*Initialize the display buffer*/
 
     /*-----------------------------------
      * Register the display in LVGL
@@ -148,6 +173,14 @@ void lv_port_disp_init(char *device)
     /*Set a display buffer*/
     disp_drv.draw_buf = &draw_buf_dsc_2;
 
+#if defined(ENABLE_LVGL_SWAP_CHAIN) && (ENABLE_LVGL_SWAP_CHAIN == 1)
+    /*Draw on the absolute coordinates of the frame buffers, see __disp_swap_chain_flush()*/
+    disp_drv.direct_mode = sg_swap_chain;
+#endif
+
+    /*Called after every refresh with its render time, feeds lv_port_disp_get_stat()*/
+    disp_drv.monitor_cb = disp_monitor;
+
     /*Required for Example 3)*/
     //disp_drv.full_refresh = 1;
 
@@ -173,6 +206,18 @@ void lv_port_disp_deinit(void)
     disp_deinit();
 }
 
+void lv_port_disp_get_stat(lv_port_disp_stat_t *stat)
+{
+    if (stat) {
+        memcpy(stat, &sg_disp_stat, sizeof(lv_port_disp_stat_t));
+    }
+}
+
+void lv_port_disp_reset_stat(void)
+{
+    memset(&sg_disp_stat, 0, sizeof(lv_port_disp_stat_t));
+}
+
 #if defined(ENABLE_LVGL_DMA2D) && (ENABLE_LVGL_DMA2D == 1)
 static SEM_HANDLE sg_dma2d_finish_sem = NULL;
 static bool sg_is_wait_dma2d = false;
@@ -416,74 +461,43 @@ static uint8_t __disp_get_pixels_size_bytes(TUYA_DISPLAY_PIXEL_FMT_E pixel_fmt)
     }
 }
 
-static void __disp_mono_write_point(uint32_t x, uint32_t y, bool enable, TDL_DISP_FRAME_BUFF_T *fb)
-{
-    if(NULL == fb || x >= fb->width || y >= fb->height) {
-        PR_ERR("Point (%d, %d) out of bounds", x, y);
-        return;
-    }
-
-    uint32_t write_byte_index = y * (fb->width/8) + x/8;
-    uint8_t write_bit = x%8;
-
-    if (enable) {
-        fb->frame[write_byte_index] |= (1 << write_bit);
-    } else {
-        fb->frame[write_byte_index] &= ~(1 << write_bit);
-    }
-}
-
-static void __disp_i2_write_point(uint32_t x, uint32_t y, uint8_t color, TDL_DISP_FRAME_BUFF_T *fb)
-{
-    if(NULL == fb || x >= fb->width || y >= fb->height) {
-        PR_ERR("Point (%d, %d) out of bounds", x, y);
-        return;
-    }
-
-    uint32_t write_byte_index = y * (fb->width/4) + x/4;
-    uint8_t write_bit = (x%4)*2;
-    uint8_t cleared = fb->frame[write_byte_index] & (~(0x03 << write_bit)); // Clear the bits we are going to write
-
-    fb->frame[write_byte_index] = cleared | ((color & 0x03) << write_bit);
-}
-
 static void __disp_fill_display_framebuffer(const lv_area_t * area, uint8_t * px_map,\
                                             TDL_DISP_FRAME_BUFF_T *fb)
 {
-    uint32_t offset = 0, x = 0, y = 0;
+    uint32_t offset = 0, y = 0;
 
     if(NULL == area || NULL == px_map || NULL == fb) {
         PR_ERR("Invalid parameters: area or px_map or fb is NULL");
         return;
     }
     
-    if(fb->fmt == TUYA_PIXEL_FMT_MONOCHROME) {
-        for(y = area->y1 ; y <= area->y2; y++) {
-            for(x = area->x1; x <= area->x2; x++) {
-                uint16_t *px_map_u16 = (uint16_t *)px_map;
-                bool enable = (px_map_u16[offset++]> 0x8FFF) ? false : true;
-                __disp_mono_write_point(x, y, enable, fb);
-            }
+    if(fb->fmt == TUYA_PIXEL_FMT_MONOCHROME || fb->fmt == TUYA_PIXEL_FMT_I2) {
+        uint16_t *px_map_u16 = (uint16_t *)px_map;
+        int32_t area_w = lv_area_get_width(area);
+        uint32_t num = 0;
+
+        if(area->x1 < 0 || area->y1 < 0 || area->x1 >= fb->width) {
+            PR_ERR("Area (%d, %d) out of bounds", area->x1, area->y1);
+            return;
         }
-    }else if(fb->fmt == TUYA_PIXEL_FMT_I2) { 
-        for(y = area->y1 ; y <= area->y2; y++) {
-            for(x = area->x1; x <= area->x2; x++) {
-                lv_color16_t *px_map_color16 = (lv_color16_t *)px_map;
-            #if LV_COLOR_16_SWAP == 0
-                uint8_t grey2 = ~((px_map_color16[offset].ch.red + px_map_color16[offset].ch.green*2 +\
-                                 px_map_color16[offset].ch.blue) >> 2);
-            #else 
-                uint8_t green = (px_map_color16[offset].ch.green_l) + ((px_map_color16[offset].ch.green_h)<<3);
-                uint8_t grey2 = ~((px_map_color16[offset].ch.red + green*2 +\
-                                 px_map_color16[offset].ch.blue) >> 2);
-            #endif
-                offset++;
-                __disp_i2_write_point(x, y, grey2, fb);
+        num = ((uint32_t)area->x2 < fb->width) ? (uint32_t)area_w : (fb->width - area->x1);
+
+    #if LV_COLOR_16_SWAP == 1
+        tdl_disp_rgb565_swap(px_map_u16, area_w * lv_area_get_height(area));
+    #endif
+
+        for(y = area->y1; y <= area->y2 && y < fb->height; y++) {
+            if(fb->fmt == TUYA_PIXEL_FMT_MONOCHROME) {
+                tdl_disp_rgb565_to_mono(&px_map_u16[offset], num, fb->frame + y * (fb->width/8), area->x1,\
+                                        TDL_DISP_MONO_THRESHOLD_DEF);
+            }else {
+                tdl_disp_rgb565_to_i2(&px_map_u16[offset], num, fb->frame + y * (fb->width/4), area->x1);
             }
+            offset += area_w;
         }
     }else {
         #if LV_COLOR_16_SWAP == 1
-            lv_draw_sw_rgb565_swap(px_map, lv_area_get_width(area) * lv_area_get_height(area));
+            tdl_disp_rgb565_swap((uint16_t *)px_map, lv_area_get_width(area) * lv_area_get_height(area));
         #endif
 
 #if defined(ENABLE_LVGL_DMA2D) && (ENABLE_LVGL_DMA2D == 1)
@@ -502,6 +516,7 @@ static void __disp_fill_display_framebuffer(const lv_area_t * area, uint8_t * px
             color_ptr += width * per_pixel_byte;
         }
 #endif
+        sg_disp_stat.copy_bytes += lv_area_get_size(area) * __disp_get_pixels_size_bytes(fb->fmt);
     }
 }
 
@@ -515,6 +530,69 @@ static void __disp_framebuffer_memcpy(TDL_DISP_DEV_INFO_T *dev_info,\
 #else
     memcpy(dst_frame, src_frame, frame_size);
 #endif
+    sg_disp_stat.copy_bytes += frame_size;
+}
+#endif
+
+static void __disp_add_dirty_area(const lv_area_t * area)
+{
+    TDL_DISP_AREA_T dirty = {
+        .x1 = (uint16_t)area->x1,
+        .y1 = (uint16_t)area->y1,
+        .x2 = (uint16_t)area->x2,
+        .y2 = (uint16_t)area->y2,
+    };
+
+    tdl_disp_dirty_area_add(&sg_dirty_area, &dirty);
+}
+
+#if defined(ENABLE_LVGL_SWAP_CHAIN) && (ENABLE_LVGL_SWAP_CHAIN == 1)
+/*Copy the areas of the frame just shown into the buffer LVGL renders the next frame into,
+ *so both buffers hold the same picture again*/
+static void __disp_swap_chain_sync(TDL_DISP_DIRTY_AREA_T *sync, uint8_t *dst_frame, uint8_t *src_frame)
+{
+    uint32_t stride = sg_display_fb.width * sizeof(lv_color_t);
+    uint32_t offset = 0, line_len = 0, y = 0;
+    uint8_t i = 0;
+
+    for (i = 0; i < sync->num; i++) {
+        TDL_DISP_AREA_T *area = &sync->area[i];
+
+        offset = area->y1 * stride + area->x1 * sizeof(lv_color_t);
+        line_len = (area->x2 - area->x1 + 1) * sizeof(lv_color_t);
+        for (y = area->y1; y <= area->y2; y++) {
+            memcpy(dst_frame + offset, src_frame + offset, line_len);
+            offset += stride;
+        }
+        sg_disp_stat.copy_bytes += line_len * (area->y2 - area->y1 + 1);
+    }
+}
+
+/*In direct mode every flush_cb gets the whole frame buffer LVGL rendered into,
+ *the invalidated areas of the refresh are read from the display once the last one is done*/
+static void __disp_swap_chain_flush(lv_disp_drv_t * disp_drv, lv_color_t * color_p)
+{
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    TDL_DISP_DIRTY_AREA_T sync;
+    uint8_t *next_frame = NULL;
+    uint16_t i = 0;
+
+    if (!lv_disp_flush_is_last(disp_drv) || NULL == disp) {
+        return;
+    }
+
+    for (i = 0; i < disp->inv_p; i++) {
+        if (disp->inv_area_joined[i] == 0) {
+            __disp_add_dirty_area(&disp->inv_areas[i]);
+        }
+    }
+    memcpy(&sync, &sg_dirty_area, sizeof(TDL_DISP_DIRTY_AREA_T));
+
+    sg_display_fb.frame = (uint8_t *)color_p;
+    tdl_disp_dev_flush_area(sg_tdl_disp_hdl, &sg_display_fb, &sg_dirty_area);
+
+    next_frame = (sg_display_fb.frame == sg_frame_1) ? sg_frame_2 : sg_frame_1;
+    __disp_swap_chain_sync(&sync, next_frame, sg_display_fb.frame);
 }
 #endif
 
@@ -541,15 +619,28 @@ static void disp_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_colo
 {
     uint8_t *color_ptr = (uint8_t *)color_p;
     lv_area_t *target_area = (lv_area_t *)area;
+    uint32_t start_ms = lv_tick_get();
 
+#if defined(ENABLE_LVGL_SWAP_CHAIN) && (ENABLE_LVGL_SWAP_CHAIN == 1)
+    if (sg_swap_chain) {
+        if (disp_flush_enabled) {
+            __disp_swap_chain_flush(disp_drv, color_p);
+        }
+        sg_disp_stat.flush_ms += lv_tick_elaps(start_ms);
+        lv_disp_flush_ready(disp_drv);
+        return;
+    }
+#endif
 
     if(disp_flush_enabled) {
 
 #if 1
         __disp_fill_display_framebuffer(target_area, color_ptr, &sg_display_fb);
+        __disp_add_dirty_area(target_area);
 
+        /*Only the areas rendered in this refresh are sent to the panel*/
         if (lv_disp_flush_is_last(disp_drv)) {
-            tdl_disp_dev_flush(sg_tdl_disp_hdl, &sg_display_fb);
+            tdl_disp_dev_flush_area(sg_tdl_disp_hdl, &sg_display_fb, &sg_dirty_area);
 
 #if defined(ENABLE_LVGL_DUAL_DISP_BUFF) && (ENABLE_LVGL_DUAL_DISP_BUFF == 1)
             uint8_t *next_frame = (sg_display_fb.frame == sg_frame_1) ? \
@@ -577,12 +668,22 @@ static void disp_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_colo
         }
     }
 
+    sg_disp_stat.flush_ms += lv_tick_elaps(start_ms);
+
     /*IMPORTANT!!!
      *Inform the graphics library that you are ready with the flushing*/
     lv_disp_flush_ready(disp_drv);
 
 }
 
+/*Called by LVGL after every refresh: `time` is the render and flush time in ms, `px` the refreshed pixels*/
+static void disp_monitor(lv_disp_drv_t * disp_drv, uint32_t time, uint32_t px)
+{
+    sg_disp_stat.frames++;
+    sg_disp_stat.refr_ms += time;
+    sg_disp_stat.refr_px += px;
+}
+
 /*OPTIONAL: GPU INTERFACE*/
 
 /*If your MCU has hardware accelerator (GPU) then you can use it to fill a memory with a color*/
@@ -16,6 +16,7 @@
 #include "tkl_memory.h"
 #include "tal_api.h"
 #include "tdl_display_manage.h"
+#include "tdl_display_pixel.h"
 
 #if defined(ENABLE_LVGL_DMA2D) && (ENABLE_LVGL_DMA2D == 1)
 #include "tkl_dma2d.h"
@@ -48,6 +49,8 @@ static void disp_deinit(void);
 
 static void disp_flush(lv_display_t * disp, const lv_area_t * area, uint8_t * px_map);
 
+static void disp_refr_event_cb(lv_event_t * e);
+
 static uint8_t * __disp_draw_buf_align_alloc(uint32_t size_bytes);
 
 static lv_color_format_t __disp_get_lv_color_format(TUYA_DISPLAY_PIXEL_FMT_E pixel_fmt);
@@ -67,6 +70,7 @@ static TDL_DISP_DEV_INFO_T sg_display_info;
 
 #if 1
 static TDL_DISP_FRAME_BUFF_T sg_display_fb;
+static TDL_DISP_DIRTY_AREA_T sg_dirty_area;
 static uint8_t *sg_frame_1 = NULL;
 #if defined(ENABLE_LVGL_DUAL_DISP_BUFF) && (ENABLE_LVGL_DUAL_DISP_BUFF == 1)
 static uint8_t *sg_frame_2 = NULL;
@@ -80,6 +84,9 @@ static TDL_DISP_FRAME_BUFF_T *sg_p_display_fb_2 = NULL;
 #endif
 
 static uint8_t *sg_rotate_buf = NULL;
+static lv_port_disp_stat_t sg_disp_stat;
+static uint32_t sg_refr_start_ms = 0;
+static uint32_t sg_refr_px = 0;
 /**********************
  *      MACROS
  **********************/
@@ -102,6 +109,10 @@ void lv_port_disp_init(char *device)
     lv_display_t * disp = lv_display_create(sg_display_info.width, sg_display_info.height);
     lv_display_set_flush_cb(disp, disp_flush);
 
+    /*Time every refresh, feeds lv_port_disp_get_stat()*/
+    lv_display_add_event_cb(disp, disp_refr_event_cb, LV_EVENT_REFR_START, NULL);
+    lv_display_add_event_cb(disp, disp_refr_event_cb, LV_EVENT_REFR_READY, NULL);
+
     lv_color_format_t color_format = __disp_get_lv_color_format(sg_display_info.fmt);
     PR_NOTICE("lv_color_format:%d", color_format);
     lv_display_set_color_format(disp, color_format);
@@ -153,6 +164,18 @@ void lv_port_disp_deinit(void)
     disp_deinit();
 }
 
+void lv_port_disp_get_stat(lv_port_disp_stat_t *stat)
+{
+    if (stat) {
+        memcpy(stat, &sg_disp_stat, sizeof(lv_port_disp_stat_t));
+    }
+}
+
+void lv_port_disp_reset_stat(void)
+{
+    memset(&sg_disp_stat, 0, sizeof(lv_port_disp_stat_t));
+}
+
 /**********************
  *   STATIC FUNCTIONS
  **********************/
@@ -422,69 +445,40 @@ static uint8_t __disp_get_pixels_size_bytes(TUYA_DISPLAY_PIXEL_FMT_E pixel_fmt)
     }
 }
 
-static void __disp_mono_write_point(uint32_t x, uint32_t y, bool enable, TDL_DISP_FRAME_BUFF_T *fb)
-{
-    if(NULL == fb || x >= fb->width || y >= fb->height) {
-        PR_ERR("Point (%d, %d) out of bounds", x, y);
-        return;
-    }
-
-    uint32_t write_byte_index = y * (fb->width/8) + x/8;
-    uint8_t write_bit = x%8;
-
-    if (enable) {
-        fb->frame[write_byte_index] |= (1 << write_bit);
-    } else {
-        fb->frame[write_byte_index] &= ~(1 << write_bit);
-    }
-}
-
-static void __disp_i2_write_point(uint32_t x, uint32_t y, uint8_t color, TDL_DISP_FRAME_BUFF_T *fb)
-{
-    if(NULL == fb || x >= fb->width || y >= fb->height) {
-        PR_ERR("Point (%d, %d) out of bounds", x, y);
-        return;
-    }
-
-    uint32_t write_byte_index = y * (fb->width/4) + x/4;
-    uint8_t write_bit = (x%4)*2;
-    uint8_t cleared = fb->frame[write_byte_index] & (~(0x03 << write_bit)); // Clear the bits we are going to write
-
-    fb->frame[write_byte_index] = cleared | ((color & 0x03) << write_bit);
-}
-
 static void __disp_fill_display_framebuffer(const lv_area_t * area, uint8_t * px_map, \
                                             lv_color_format_t cf, TDL_DISP_FRAME_BUFF_T *fb)
 {
-    uint32_t offset = 0, x = 0, y = 0;
+    uint32_t offset = 0, y = 0;
 
     if(NULL == area || NULL == px_map || NULL == fb) {
         PR_ERR("Invalid parameters: area or px_map or fb is NULL");
         return;
     }
     
-    if(fb->fmt == TUYA_PIXEL_FMT_MONOCHROME) {
-        for(y = area->y1 ; y <= area->y2; y++) {
-            for(x = area->x1; x <= area->x2; x++) {
-                uint16_t *px_map_u16 = (uint16_t *)px_map;
-                bool enable = (px_map_u16[offset++]> 0x8FFF) ? false : true;
-                __disp_mono_write_point(x, y, enable, fb);
-            }
+    if(fb->fmt == TUYA_PIXEL_FMT_MONOCHROME || fb->fmt == TUYA_PIXEL_FMT_I2) {
+        uint16_t *px_map_u16 = (uint16_t *)px_map;
+        int32_t area_w = lv_area_get_width(area);
+        uint32_t num = 0;
+
+        if(area->x1 < 0 || area->y1 < 0 || area->x1 >= fb->width) {
+            PR_ERR("Area (%d, %d) out of bounds", area->x1, area->y1);
+            return;
         }
-    }else if(fb->fmt == TUYA_PIXEL_FMT_I2) { 
-        for(y = area->y1 ; y <= area->y2; y++) {
-            for(x = area->x1; x <= area->x2; x++) {
-                lv_color16_t *px_map_color16 = (lv_color16_t *)px_map;
-                uint8_t grey2 = ~((px_map_color16[offset].red + px_map_color16[offset].green*2 +\
-                                 px_map_color16[offset].blue) >> 2);
-                offset++;
-                __disp_i2_write_point(x, y, grey2, fb);
+        num = ((uint32_t)area->x2 < fb->width) ? (uint32_t)area_w : (fb->width - area->x1);
+
+        for(y = area->y1; y <= area->y2 && y < fb->height; y++) {
+            if(fb->fmt == TUYA_PIXEL_FMT_MONOCHROME) {
+                tdl_disp_rgb565_to_mono(&px_map_u16[offset], num, fb->frame + y * (fb->width/8), area->x1,\
+                                        TDL_DISP_MONO_THRESHOLD_DEF);
+            }else {
+                tdl_disp_rgb565_to_i2(&px_map_u16[offset], num, fb->frame + y * (fb->width/4), area->x1);
             }
+            offset += area_w;
         }
     }else {
         if(LV_COLOR_FORMAT_RGB565 == cf) {
             if(sg_display_info.is_swap) {
-                lv_draw_sw_rgb565_swap(px_map, lv_area_get_width(area) * lv_area_get_height(area));
+                tdl_disp_rgb565_swap((uint16_t *)px_map, lv_area_get_width(area) * lv_area_get_height(area));
             }
         }
 
@@ -504,6 +498,7 @@ static void __disp_fill_display_framebuffer(const lv_area_t * area, uint8_t * px
             color_ptr += width * per_pixel_byte;
         }
 #endif
+        sg_disp_stat.copy_bytes += lv_area_get_size(area) * __disp_get_pixels_size_bytes(fb->fmt);
     }
 }
 
@@ -517,6 +512,7 @@ static void __disp_framebuffer_memcpy(TDL_DISP_DEV_INFO_T *dev_info,\
 #else
     memcpy(dst_frame, src_frame, frame_size);
 #endif
+    sg_disp_stat.copy_bytes += frame_size;
 }
 #endif
 
@@ -525,6 +521,18 @@ static void disp_deinit(void)
 
 }
 
+static void __disp_add_dirty_area(const lv_area_t * area)
+{
+    TDL_DISP_AREA_T dirty = {
+        .x1 = (uint16_t)area->x1,
+        .y1 = (uint16_t)area->y1,
+        .x2 = (uint16_t)area->x2,
+        .y2 = (uint16_t)area->y2,
+    };
+
+    tdl_disp_dirty_area_add(&sg_dirty_area, &dirty);
+}
+
 volatile bool disp_flush_enabled = true;
 
 /* Enable updating the screen (the flushing process) when disp_flush() is called by LVGL
@@ -549,6 +557,7 @@ static void disp_flush(lv_display_t * disp, const lv_area_t * area, uint8_t * px
 {
     uint8_t *color_ptr = px_map;
     lv_area_t *target_area = (lv_area_t *)area;
+    uint32_t start_ms = lv_tick_get();
 
     if (disp_flush_enabled) {
 
@@ -584,9 +593,11 @@ static void disp_flush(lv_display_t * disp, const lv_area_t * area, uint8_t * px
 
 #if 1
         __disp_fill_display_framebuffer(target_area, color_ptr, cf, &sg_display_fb);
+        __disp_add_dirty_area(target_area);
 
+        /*Only the areas rendered in this refresh are sent to the panel*/
         if (lv_display_flush_is_last(disp)) {
-            tdl_disp_dev_flush(sg_tdl_disp_hdl, &sg_display_fb);
+            tdl_disp_dev_flush_area(sg_tdl_disp_hdl, &sg_display_fb, &sg_dirty_area);
 
 #if defined(ENABLE_LVGL_DUAL_DISP_BUFF) && (ENABLE_LVGL_DUAL_DISP_BUFF == 1)
             uint8_t *next_frame = (sg_display_fb.frame == sg_frame_1) ? \
@@ -614,9 +625,25 @@ static void disp_flush(lv_display_t * disp, const lv_area_t * area, uint8_t * px
         }
     }
 
+    sg_refr_px += lv_area_get_size(area);
+    sg_disp_stat.flush_ms += lv_tick_elaps(start_ms);
+
     lv_display_flush_ready(disp);
 }
 
+static void disp_refr_event_cb(lv_event_t * e)
+{
+    if (lv_event_get_code(e) == LV_EVENT_REFR_START) {
+        sg_refr_start_ms = lv_tick_get();
+        sg_refr_px = 0;
+    } else if (sg_refr_px) {
+        /*Only refreshes that rendered something are frames*/
+        sg_disp_stat.frames++;
+        sg_disp_stat.refr_ms += lv_tick_elaps(sg_refr_start_ms);
+        sg_disp_stat.refr_px += sg_refr_px;
+    }
+}
+
 #else /*Enable this file at the top*/
 
 /*This dummy typedef exists purely to silence -Wpedantic.*/
@@ -30,6 +30,14 @@ extern "C" {
 /**********************
  *      TYPEDEFS
  **********************/
+/*Display port counters, see lv_port_disp_get_stat()*/
+typedef struct {
+    uint32_t frames;     /*Refreshes done by LVGL*/
+    uint32_t refr_ms;    /*Render and flush time of all the refreshes*/
+    uint64_t refr_px;    /*Pixels rendered*/
+    uint32_t flush_ms;   /*Time spent in the flush callback*/
+    uint64_t copy_bytes; /*Bytes copied by the port: draw buffer into frame buffer, frame buffer syncs*/
+} lv_port_disp_stat_t;
 
 /**********************
  * GLOBAL PROTOTYPES
@@ -45,6 +53,14 @@ void disp_enable_update(void);
  */
 void disp_disable_update(void);
 
+/* Get the counters of the display port, frame time = refr_ms / frames
+ */
+void lv_port_disp_get_stat(lv_port_disp_stat_t *stat);
+
+/* Clear the counters of the display port
+ */
+void lv_port_disp_reset_stat(void);
+
 /**********************
  *      MACROS
  **********************/
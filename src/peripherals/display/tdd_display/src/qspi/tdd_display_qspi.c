@@ -186,6 +186,62 @@ static OPERATE_RET __disp_qspi_send_frame(DISP_QSPI_BASE_CFG_T *p_cfg, TDL_DISP_
     return rt;
 }
 
+static OPERATE_RET __disp_qspi_send_area(DISP_QSPI_BASE_CFG_T *p_cfg, TDL_DISP_FRAME_BUFF_T *p_fb, \
+                                         TDL_DISP_AREA_T *area, uint8_t pixel_bytes)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TUYA_QSPI_CMD_T qspi_cmd = {0};
+    uint32_t stride = 0, line_len = 0, lines = 0, y = 0;
+    uint8_t *line = NULL;
+
+    if (NULL == p_cfg || NULL == p_fb || NULL == area) {
+        return OPRT_INVALID_PARM;
+    }
+
+    stride   = p_fb->width * pixel_bytes;
+    line_len = (area->x2 - area->x1 + 1) * pixel_bytes;
+    lines    = area->y2 - area->y1 + 1;
+    line     = p_fb->frame + area->y1 * stride + area->x1 * pixel_bytes;
+
+    // full width rows are contiguous in the frame buffer
+    if (line_len == stride) {
+        line_len *= lines;
+        lines = 1;
+    }
+
+    memset(&qspi_cmd, 0x00, SIZEOF(TUYA_QSPI_CMD_T));
+
+    tkl_qspi_force_cs_pin(p_cfg->port, 0);
+
+    qspi_cmd.op = TUYA_QSPI_WRITE;
+
+    qspi_cmd.cmd[0]    = p_cfg->pixel_pre_cmd.cmd;
+    qspi_cmd.cmd_size  = 1;
+    qspi_cmd.cmd_lines = p_cfg->pixel_pre_cmd.cmd_lines;
+
+    for(uint32_t i = 0; i < p_cfg->pixel_pre_cmd.addr_size; i++) {
+        qspi_cmd.addr[i] = p_cfg->pixel_pre_cmd.addr[i];
+    }
+    qspi_cmd.addr_size = p_cfg->pixel_pre_cmd.addr_size;
+    qspi_cmd.addr_lines = p_cfg->pixel_pre_cmd.addr_lines;
+
+    qspi_cmd.data_size = 0;
+    qspi_cmd.dummy_cycle = 0;
+    rt = tkl_qspi_comand(p_cfg->port, &qspi_cmd);
+
+    for (y = 0; y < lines && OPRT_OK == rt; y++) {
+        rt = tkl_qspi_send(p_cfg->port, line, line_len);//dma
+        if (OPRT_OK == rt) {
+            rt = tal_semaphore_wait(sg_display_qspi.tx_sem, SEM_WAIT_FOREVER);
+        }
+        line += stride;
+    }
+
+    tkl_qspi_force_cs_pin(p_cfg->port, 1);
+
+    return rt;
+}
+
 static void __tdd_disp_reset(TUYA_GPIO_NUM_E rst_pin)
 {
     if(rst_pin >= TUYA_GPIO_NUM_MAX) {
@@ -348,6 +404,41 @@ static OPERATE_RET __tdd_display_qspi_flush(TDD_DISP_DEV_HANDLE_T device, TDL_DI
     return rt;
 }
 
+static OPERATE_RET __tdd_display_qspi_flush_area(TDD_DISP_DEV_HANDLE_T device, TDL_DISP_FRAME_BUFF_T *frame_buff, \
+                                                 TDL_DISP_AREA_T *area)
+{
+    OPERATE_RET rt = OPRT_OK;
+    DISP_QSPI_DEV_T *disp_qspi_dev = NULL;
+    uint8_t pixel_bytes = 0;
+
+    if (NULL == device || NULL == frame_buff || NULL == area) {
+        return OPRT_INVALID_PARM;
+    }
+
+    disp_qspi_dev = (DISP_QSPI_DEV_T *)device;
+
+    if (frame_buff->fmt == TUYA_PIXEL_FMT_RGB565) {
+        pixel_bytes = 2;
+    } else if (frame_buff->fmt == TUYA_PIXEL_FMT_RGB666 || frame_buff->fmt == TUYA_PIXEL_FMT_RGB888) {
+        pixel_bytes = 3;
+    }
+
+    // the qspi task sends whole frames asynchronously, only direct writes can update a part
+    if (0 == disp_qspi_dev->cfg.is_pixel_memory || NULL == disp_qspi_dev->set_window_cb || 0 == pixel_bytes) {
+        return OPRT_NOT_SUPPORTED;
+    }
+
+    tal_mutex_lock(sg_display_qspi.mutex);
+
+    disp_qspi_dev->set_window_cb(&disp_qspi_dev->cfg, area->x1, area->y1, area->x2, area->y2);
+
+    rt = __disp_qspi_send_area(&(disp_qspi_dev->cfg), frame_buff, area, pixel_bytes);
+
+    tal_mutex_unlock(sg_display_qspi.mutex);
+
+    return rt;
+}
+
 static OPERATE_RET __tdd_display_qspi_close(TDD_DISP_DEV_HANDLE_T device)
 {
     return OPRT_NOT_SUPPORTED;
@@ -390,9 +481,10 @@ OPERATE_RET tdd_disp_qspi_device_register(char *name, TDD_DISP_QSPI_CFG_T *qspi)
     memcpy(&disp_qspi_dev_info.power, &qspi->power, sizeof(TUYA_DISPLAY_IO_CTRL_T));
 
     TDD_DISP_INTFS_T disp_qspi_intfs = {
-        .open  = __tdd_display_qspi_open,
-        .flush = __tdd_display_qspi_flush,
-        .close = __tdd_display_qspi_close,
+        .open       = __tdd_display_qspi_open,
+        .flush      = __tdd_display_qspi_flush,
+        .flush_area = __tdd_display_qspi_flush_area,
+        .close      = __tdd_display_qspi_close,
     };
 
     TUYA_CALL_ERR_RETURN(tdl_disp_device_register(name, (TDD_DISP_DEV_HANDLE_T)disp_qspi_dev,\
@@ -17,6 +17,7 @@
 
 #include "tdd_display_spi.h"
 #include "tdd_disp_st7305.h"
+#include "tdl_display_pixel.h"
 
 /***********************************************************
 ***********************MACRO define**********************
@@ -76,9 +77,7 @@ static uint8_t ST7305_INIT_SEQ[] = {
 // BIT6 BIT4 BIT2 BIT0
 static void __tdd_st7305_convert(uint32_t width, uint32_t height, uint8_t *in_buf, uint8_t *out_buf)
 {
-    uint16_t k = 0, i = 0, j = 0, y = 0;
-    uint8_t b1 = 0, b2 = 0, mix = 0;
-    uint32_t width_bytes = 0, offset = 0;
+    uint32_t k = 0, i = 0, width_bytes = 0, offset = 0;
 
     if (NULL == in_buf || NULL == out_buf) {
         return;
@@ -88,30 +87,8 @@ static void __tdd_st7305_convert(uint32_t width, uint32_t height, uint8_t *in_bu
     width_bytes = width / 8;
     for (i = 0; i < height; i += 2) {
         k += offset;
-        for (j = 0; j < width_bytes; j += 3) {
-            for (y = 0; y < 3; y++) {
-                if ((j + y) >= width_bytes) {
-                    continue; // Avoid out of bounds
-                }
-
-                b1 = in_buf[i * width_bytes + j + y];
-                b2 = in_buf[(i + 1) * width_bytes + j + y];
-
-                // First 4 bits
-                mix = 0;
-                mix = ((b1 & 0x01) << 7) | ((b2 & 0x01) << 6) | ((b1 & 0x02) << 4) | ((b2 & 0x02) << 3) |
-                      ((b1 & 0x04) << 1) | ((b2 & 0x04)) | ((b1 & 0x08) >> 2) | ((b2 & 0x08) >> 3);
-                out_buf[k++] = mix;
-
-                // Second 4 bits
-                b1 >>= 4;
-                b2 >>= 4;
-                mix = 0;
-                mix = ((b1 & 0x01) << 7) | ((b2 & 0x01) << 6) | ((b1 & 0x02) << 4) | ((b2 & 0x02) << 3) |
-                      ((b1 & 0x04) << 1) | ((b2 & 0x04)) | ((b1 & 0x08) >> 2) | ((b2 & 0x08) >> 3);
-                out_buf[k++] = mix;
-            }
-        }
+        tdl_disp_interleave_rows(&in_buf[i * width_bytes], &in_buf[(i + 1) * width_bytes], width_bytes, &out_buf[k]);
+        k += width_bytes * 2;
     }
 }
 
@@ -193,6 +193,72 @@ static OPERATE_RET __tdd_display_spi_flush(TDD_DISP_DEV_HANDLE_T device, TDL_DIS
     return rt;
 }
 
+static uint8_t __disp_spi_get_pixel_bytes(TUYA_DISPLAY_PIXEL_FMT_E fmt)
+{
+    switch (fmt) {
+    case TUYA_PIXEL_FMT_RGB565:
+        return 2;
+    case TUYA_PIXEL_FMT_RGB666:
+    case TUYA_PIXEL_FMT_RGB888:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+static OPERATE_RET __tdd_display_spi_flush_area(TDD_DISP_DEV_HANDLE_T device, TDL_DISP_FRAME_BUFF_T *frame_buff,
+                                                TDL_DISP_AREA_T *area)
+{
+    OPERATE_RET rt = OPRT_OK;
+    DISP_SPI_DEV_T *disp_spi_dev = NULL;
+    uint8_t pixel_bytes = 0;
+    uint32_t stride = 0, line_len = 0, y = 0;
+    uint8_t *line = NULL;
+
+    if (NULL == device || NULL == frame_buff || NULL == area) {
+        return OPRT_INVALID_PARM;
+    }
+
+    disp_spi_dev = (DISP_SPI_DEV_T *)device;
+
+    pixel_bytes = __disp_spi_get_pixel_bytes(frame_buff->fmt);
+    if (0 == pixel_bytes) {
+        return OPRT_NOT_SUPPORTED;
+    }
+
+    if (disp_spi_dev->set_window_cb) {
+        disp_spi_dev->set_window_cb(&disp_spi_dev->cfg, area->x1, area->y1, area->x2, area->y2);
+    } else {
+        __disp_spi_set_window(&disp_spi_dev->cfg, area->x1, area->y1, area->x2, area->y2);
+    }
+
+    tdd_disp_spi_send_cmd(&disp_spi_dev->cfg, disp_spi_dev->cfg.cmd_ramwr);
+
+    stride = frame_buff->width * pixel_bytes;
+    line_len = (area->x2 - area->x1 + 1) * pixel_bytes;
+    line = frame_buff->frame + area->y1 * stride + area->x1 * pixel_bytes;
+
+    // full width rows are contiguous in the frame buffer
+    if (line_len == stride) {
+        return tdd_disp_spi_send_data(&disp_spi_dev->cfg, line, line_len * (area->y2 - area->y1 + 1));
+    }
+
+    tkl_gpio_write(disp_spi_dev->cfg.cs_pin, TUYA_GPIO_LEVEL_LOW);
+    tkl_gpio_write(disp_spi_dev->cfg.dc_pin, TUYA_GPIO_LEVEL_HIGH);
+
+    for (y = area->y1; y <= area->y2; y++) {
+        rt = __disp_spi_send(disp_spi_dev->cfg.port, line, line_len);
+        if (OPRT_OK != rt) {
+            break;
+        }
+        line += stride;
+    }
+
+    tkl_gpio_write(disp_spi_dev->cfg.cs_pin, TUYA_GPIO_LEVEL_HIGH);
+
+    return rt;
+}
+
 static OPERATE_RET __tdd_display_spi_close(TDD_DISP_DEV_HANDLE_T device)
 {
     return OPRT_NOT_SUPPORTED;
@@ -411,9 +477,10 @@ OPERATE_RET tdd_disp_spi_device_register(char *name, TDD_DISP_SPI_CFG_T *spi)
     memcpy(&disp_spi_dev_info.power, &spi->power, sizeof(TUYA_DISPLAY_IO_CTRL_T));
 
     TDD_DISP_INTFS_T disp_spi_intfs = {
-        .open  = __tdd_display_spi_open,
-        .flush = __tdd_display_spi_flush,
-        .close = __tdd_display_spi_close,
+        .open       = __tdd_display_spi_open,
+        .flush      = __tdd_display_spi_flush,
+        .flush_area = __tdd_display_spi_flush_area,
+        .close      = __tdd_display_spi_close,
     };
 
     TUYA_CALL_ERR_RETURN(tdl_disp_device_register(name, (TDD_DISP_DEV_HANDLE_T)disp_spi_dev,\
@@ -71,6 +71,9 @@ typedef struct {
 typedef struct {
     OPERATE_RET (*open)(TDD_DISP_DEV_HANDLE_T device);
     OPERATE_RET (*flush)(TDD_DISP_DEV_HANDLE_T device, TDL_DISP_FRAME_BUFF_T *frame_buff);
+    // optional, sends one area of the frame buffer, OPRT_NOT_SUPPORTED falls back to flush
+    OPERATE_RET (*flush_area)(TDD_DISP_DEV_HANDLE_T device, TDL_DISP_FRAME_BUFF_T *frame_buff,
+                              TDL_DISP_AREA_T *area);
     OPERATE_RET (*close)(TDD_DISP_DEV_HANDLE_T device);
 } TDD_DISP_INTFS_T;
 
@@ -23,6 +23,7 @@ extern "C" {
 /***********************************************************
 ************************macro define************************
 ***********************************************************/
+#define TDL_DISP_DIRTY_AREA_MAX 8
 
 /***********************************************************
 ***********************typedef define***********************
@@ -56,6 +57,24 @@ struct TDL_DISP_FRAME_BUFF_T {
     uint8_t *frame;
 };
 
+/**
+ * @brief A rectangle of the panel, both corners inclusive.
+ */
+typedef struct {
+    uint16_t x1;
+    uint16_t y1;
+    uint16_t x2;
+    uint16_t y2;
+} TDL_DISP_AREA_T;
+
+/**
+ * @brief Areas of a frame buffer changed since the last flush.
+ */
+typedef struct {
+    uint8_t num;
+    TDL_DISP_AREA_T area[TDL_DISP_DIRTY_AREA_MAX];
+} TDL_DISP_DIRTY_AREA_T;
+
 typedef struct {
     TUYA_DISPLAY_TYPE_E type;
     TUYA_DISPLAY_ROTATION_E rotation;
@@ -154,6 +173,45 @@ void tdl_disp_free_frame_buff(TDL_DISP_FRAME_BUFF_T *frame_buff);
  */
 OPERATE_RET tdl_disp_dev_flush(TDL_DISP_HANDLE_T disp_hdl, TDL_DISP_FRAME_BUFF_T *frame_buff);
 
+/**
+ * @brief Empties a dirty area list.
+ *
+ * @param dirty Pointer to the dirty area list.
+ *
+ * @return None.
+ */
+void tdl_disp_dirty_area_reset(TDL_DISP_DIRTY_AREA_T *dirty);
+
+/**
+ * @brief Adds a changed area to a dirty area list.
+ *
+ * The area is merged with an area already in the list when they overlap or when
+ * sending their bounding box costs less than setting up one more window. When the
+ * list is full, the area is merged with the entry whose bounding box grows least.
+ *
+ * @param dirty Pointer to the dirty area list.
+ * @param area The changed area in panel coordinates.
+ *
+ * @return None.
+ */
+void tdl_disp_dirty_area_add(TDL_DISP_DIRTY_AREA_T *dirty, TDL_DISP_AREA_T *area);
+
+/**
+ * @brief Flushes only the dirty areas of the frame buffer to the display device.
+ *
+ * Each area is sent with its own column/row window. The whole frame buffer is
+ * flushed instead when the dirty areas cover most of the panel, or when the driver
+ * cannot update a part of the panel.
+ *
+ * @param disp_hdl Handle to the display device.
+ * @param frame_buff Pointer to the frame buffer holding the whole panel.
+ * @param dirty Pointer to the dirty area list, emptied on return.
+ *
+ * @return Returns OPRT_OK on success, or an appropriate error code if flushing fails.
+ */
+OPERATE_RET tdl_disp_dev_flush_area(TDL_DISP_HANDLE_T disp_hdl, TDL_DISP_FRAME_BUFF_T *frame_buff,
+                                    TDL_DISP_DIRTY_AREA_T *dirty);
+
 /**
  * @brief Closes and deinitializes a display device.
  *
@@ -0,0 +1,133 @@
+/**
+ * @file tdl_display_pixel.h
+ * @brief TDL display pixel format conversion kernels
+ *
+ * This file provides row oriented pixel conversion routines shared by the LVGL ports
+ * and the display drivers: RGB565 to 1-bit and 2-bit grey, RGB565 byte swap, RGB888
+ * to RGB565 and the bit reordering needed by monochrome controllers. The kernels
+ * assemble whole output bytes and words instead of addressing every pixel.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#ifndef __TDL_DISPLAY_PIXEL_H__
+#define __TDL_DISPLAY_PIXEL_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+// RGB565 values at or below the threshold are set (dark) in a monochrome frame
+#define TDL_DISP_MONO_THRESHOLD_DEF 0x8FFF
+
+/***********************************************************
+********************function declaration********************
+***********************************************************/
+/**
+ * @brief Converts a row of RGB565 pixels to 1-bit pixels with a fixed threshold.
+ *
+ * Pixel x of the row is bit (x % 8) of byte (x / 8). A pixel whose RGB565 value is
+ * at or below the threshold is set.
+ *
+ * @param src RGB565 pixels.
+ * @param num Number of pixels.
+ * @param dst_row Start of the destination row.
+ * @param x Position of the first pixel in the destination row.
+ * @param threshold RGB565 threshold, TDL_DISP_MONO_THRESHOLD_DEF by default.
+ *
+ * @return None.
+ */
+void tdl_disp_rgb565_to_mono(const uint16_t *src, uint32_t num, uint8_t *dst_row, uint32_t x, uint16_t threshold);
+
+/**
+ * @brief Converts a row of RGB565 pixels to 1-bit pixels with 4x4 ordered dithering.
+ *
+ * The luma of every pixel is compared with a Bayer matrix threshold, dark pixels are set.
+ *
+ * @param src RGB565 pixels.
+ * @param num Number of pixels.
+ * @param dst_row Start of the destination row.
+ * @param x Position of the first pixel in the destination row.
+ * @param y Row number, selects the row of the dither matrix.
+ *
+ * @return None.
+ */
+void tdl_disp_rgb565_to_mono_dither(const uint16_t *src, uint32_t num, uint8_t *dst_row, uint32_t x, uint32_t y);
+
+/**
+ * @brief Converts a row of RGB565 pixels to 2-bit grey.
+ *
+ * Pixel x of the row takes bits ((x % 4) * 2) of byte (x / 4). Level 3 is black
+ * and level 0 is white.
+ *
+ * @param src RGB565 pixels.
+ * @param num Number of pixels.
+ * @param dst_row Start of the destination row.
+ * @param x Position of the first pixel in the destination row.
+ *
+ * @return None.
+ */
+void tdl_disp_rgb565_to_i2(const uint16_t *src, uint32_t num, uint8_t *dst_row, uint32_t x);
+
+/**
+ * @brief Swaps the two bytes of RGB565 pixels in place.
+ *
+ * @param buf RGB565 pixels.
+ * @param num Number of pixels.
+ *
+ * @return None.
+ */
+void tdl_disp_rgb565_swap(uint16_t *buf, uint32_t num);
+
+/**
+ * @brief Converts RGB888 pixels, stored as blue, green, red bytes, to RGB565.
+ *
+ * @param src RGB888 pixels.
+ * @param num Number of pixels.
+ * @param dst RGB565 pixels.
+ *
+ * @return None.
+ */
+void tdl_disp_rgb888_to_rgb565(const uint8_t *src, uint32_t num, uint16_t *dst);
+
+/**
+ * @brief Reorders a monochrome frame into vertical pages of 8 rows.
+ *
+ * Byte c of page p holds column c of rows 8p..8p+7, the lowest row in bit 0. This is
+ * the memory layout of SSD1306 like controllers.
+ *
+ * @param src Monochrome frame, width / 8 bytes per row.
+ * @param width Frame width in pixels.
+ * @param height Frame height in pixels.
+ * @param dst Paged frame, width bytes per page.
+ *
+ * @return None.
+ */
+void tdl_disp_mono_to_page(const uint8_t *src, uint32_t width, uint32_t height, uint8_t *dst);
+
+/**
+ * @brief Interleaves the bits of two rows as needed by ST7305/ST7306 controllers.
+ *
+ * Every source byte pair gives two output bytes: bits 0-3 of both rows first, then
+ * bits 4-7, with bit n of row0 in output bit (7 - 2n) and bit n of row1 in (6 - 2n).
+ *
+ * @param row0 Upper row.
+ * @param row1 Lower row.
+ * @param len Bytes per row.
+ * @param dst Output, 2 * len bytes.
+ *
+ * @return None.
+ */
+void tdl_disp_interleave_rows(const uint8_t *row0, const uint8_t *row1, uint32_t len, uint8_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TDL_DISPLAY_PIXEL_H__ */
@@ -29,6 +29,11 @@
 ***********************************************************/
 #define TDL_DISP_DRAW_BUF_ALIGN 4
 
+// pixels worth sending instead of setting up one more window (CASET/RASET/RAMWR)
+#define TDL_DISP_AREA_MERGE_PIXELS 512
+// dirty pixels, in percent of the panel, above which the whole frame is sent
+#define TDL_DISP_AREA_FULL_PERCENT 70
+
 /***********************************************************
 ***********************typedef define***********************
 ***********************************************************/
@@ -236,6 +241,180 @@ OPERATE_RET tdl_disp_dev_flush(TDL_DISP_HANDLE_T disp_hdl, TDL_DISP_FRAME_BUFF_T
     return OPRT_OK;
 }
 
+static uint32_t __area_pixels(TDL_DISP_AREA_T *area)
+{
+    return (uint32_t)(area->x2 - area->x1 + 1) * (area->y2 - area->y1 + 1);
+}
+
+static void __area_bounding(TDL_DISP_AREA_T *a, TDL_DISP_AREA_T *b, TDL_DISP_AREA_T *out)
+{
+    out->x1 = MIN(a->x1, b->x1);
+    out->y1 = MIN(a->y1, b->y1);
+    out->x2 = MAX(a->x2, b->x2);
+    out->y2 = MAX(a->y2, b->y2);
+}
+
+static bool __area_should_merge(TDL_DISP_AREA_T *a, TDL_DISP_AREA_T *b)
+{
+    TDL_DISP_AREA_T bound;
+    uint32_t send_pixels = __area_pixels(a) + __area_pixels(b);
+
+    if (a->x1 <= b->x2 && b->x1 <= a->x2 && a->y1 <= b->y2 && b->y1 <= a->y2) {
+        TDL_DISP_AREA_T common = {
+            .x1 = MAX(a->x1, b->x1),
+            .y1 = MAX(a->y1, b->y1),
+            .x2 = MIN(a->x2, b->x2),
+            .y2 = MIN(a->y2, b->y2),
+        };
+        send_pixels -= __area_pixels(&common);
+    }
+
+    __area_bounding(a, b, &bound);
+
+    return (__area_pixels(&bound) <= send_pixels + TDL_DISP_AREA_MERGE_PIXELS);
+}
+
+static void __area_remove(TDL_DISP_DIRTY_AREA_T *dirty, uint8_t idx)
+{
+    dirty->num--;
+    dirty->area[idx] = dirty->area[dirty->num];
+}
+
+/**
+ * @brief Empties a dirty area list.
+ *
+ * @param dirty Pointer to the dirty area list.
+ *
+ * @return None.
+ */
+void tdl_disp_dirty_area_reset(TDL_DISP_DIRTY_AREA_T *dirty)
+{
+    if (dirty) {
+        dirty->num = 0;
+    }
+}
+
+/**
+ * @brief Adds a changed area to a dirty area list.
+ *
+ * The area is merged with an area already in the list when they overlap or when
+ * sending their bounding box costs less than setting up one more window. When the
+ * list is full, the area is merged with the entry whose bounding box grows least.
+ *
+ * @param dirty Pointer to the dirty area list.
+ * @param area The changed area in panel coordinates.
+ *
+ * @return None.
+ */
+void tdl_disp_dirty_area_add(TDL_DISP_DIRTY_AREA_T *dirty, TDL_DISP_AREA_T *area)
+{
+    TDL_DISP_AREA_T add, bound;
+    uint32_t grow = 0, min_grow = 0xFFFFFFFF;
+    uint8_t i = 0, best = 0;
+
+    if (NULL == dirty || NULL == area || area->x1 > area->x2 || area->y1 > area->y2) {
+        return;
+    }
+
+    add = *area;
+
+    // a merged area is bigger and may now absorb another entry, so start over
+    for (i = 0; i < dirty->num;) {
+        if (__area_should_merge(&dirty->area[i], &add)) {
+            __area_bounding(&dirty->area[i], &add, &add);
+            __area_remove(dirty, i);
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+
+    if (dirty->num >= TDL_DISP_DIRTY_AREA_MAX) {
+        for (i = 0; i < dirty->num; i++) {
+            __area_bounding(&dirty->area[i], &add, &bound);
+            grow = __area_pixels(&bound) - __area_pixels(&dirty->area[i]);
+            if (grow < min_grow) {
+                min_grow = grow;
+                best = i;
+            }
+        }
+        __area_bounding(&dirty->area[best], &add, &add);
+        __area_remove(dirty, best);
+    }
+
+    dirty->area[dirty->num++] = add;
+}
+
+/**
+ * @brief Flushes only the dirty areas of the frame buffer to the display device.
+ *
+ * Each area is sent with its own column/row window. The whole frame buffer is
+ * flushed instead when the dirty areas cover most of the panel, or when the driver
+ * cannot update a part of the panel.
+ *
+ * @param disp_hdl Handle to the display device.
+ * @param frame_buff Pointer to the frame buffer holding the whole panel.
+ * @param dirty Pointer to the dirty area list, emptied on return.
+ *
+ * @return Returns OPRT_OK on success, or an appropriate error code if flushing fails.
+ */
+OPERATE_RET tdl_disp_dev_flush_area(TDL_DISP_HANDLE_T disp_hdl, TDL_DISP_FRAME_BUFF_T *frame_buff,
+                                    TDL_DISP_DIRTY_AREA_T *dirty)
+{
+    OPERATE_RET rt = OPRT_OK;
+    DISPLAY_DEVICE_T *display_dev = NULL;
+    TDL_DISP_AREA_T area;
+    uint32_t dirty_pixels = 0;
+    uint8_t i = 0;
+
+    if (NULL == disp_hdl || NULL == frame_buff || NULL == dirty) {
+        return OPRT_INVALID_PARM;
+    }
+
+    display_dev = (DISPLAY_DEVICE_T *)disp_hdl;
+
+    if (false == display_dev->is_open) {
+        return OPRT_COM_ERROR;
+    }
+
+    if (0 == dirty->num || 0 == frame_buff->width || 0 == frame_buff->height) {
+        return OPRT_OK;
+    }
+
+    // areas are clipped to the frame, empty ones are dropped
+    for (i = 0; i < dirty->num;) {
+        area = dirty->area[i];
+        if (area.x1 >= frame_buff->width || area.y1 >= frame_buff->height) {
+            __area_remove(dirty, i);
+            continue;
+        }
+        dirty->area[i].x2 = MIN(area.x2, frame_buff->width - 1);
+        dirty->area[i].y2 = MIN(area.y2, frame_buff->height - 1);
+        dirty_pixels += __area_pixels(&dirty->area[i]);
+        i++;
+    }
+
+    if (NULL == display_dev->intfs.flush_area ||
+        dirty_pixels * 100 >= (uint32_t)frame_buff->width * frame_buff->height * TDL_DISP_AREA_FULL_PERCENT) {
+        dirty->num = 0;
+        return tdl_disp_dev_flush(disp_hdl, frame_buff);
+    }
+
+    for (i = 0; i < dirty->num; i++) {
+        rt = display_dev->intfs.flush_area(display_dev->tdd_hdl, frame_buff, &dirty->area[i]);
+        if (OPRT_NOT_SUPPORTED == rt) {
+            dirty->num = 0;
+            return tdl_disp_dev_flush(disp_hdl, frame_buff);
+        } else if (OPRT_OK != rt) {
+            break;
+        }
+    }
+
+    dirty->num = 0;
+
+    return rt;
+}
+
 /**
  * @brief Retrieves information about a registered display device.
  *
@@ -0,0 +1,296 @@
+/**
+ * @file tdl_display_pixel.c
+ * @brief TDL display pixel format conversion kernels
+ *
+ * This file implements the row oriented pixel conversion routines declared in
+ * tdl_display_pixel.h. The routines are plain C so they build for every target: each
+ * loop iteration produces a whole output byte or word (8 pixels for 1-bit, 4 pixels for
+ * 2-bit, 2 pixels per 32-bit word for RGB888 to RGB565), and bit reordering is done with
+ * 64-bit transposes and lookup tables instead of per pixel shifts.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tdl_display_pixel.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define RGB565_R(px) (((px) >> 11) & 0x1F)
+#define RGB565_G(px) (((px) >> 5) & 0x3F)
+#define RGB565_B(px) ((px) & 0x1F)
+
+// 0..254 luma of an RGB565 pixel, BT.601 weights scaled to the 5/6/5 bit fields
+#define RGB565_LUMA(px) ((RGB565_R(px) * 157 + RGB565_G(px) * 152 + RGB565_B(px) * 60) >> 6)
+
+// 2-bit grey level, r + 2g + b is 0..188 and (sum * 87) >> 12 equals sum * 4 / 189
+#define RGB565_I2(px) (3 - (((RGB565_R(px) + (RGB565_G(px) << 1) + RGB565_B(px)) * 87) >> 12))
+
+#define RGB888_TO_RGB565(b, g, r) ((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | ((b) >> 3))
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define TDL_DISP_PIXEL_LITTLE_ENDIAN 1
+#else
+#define TDL_DISP_PIXEL_LITTLE_ENDIAN 0
+#endif
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static const uint8_t sg_bayer4x4[4][4] = {
+    {8, 136, 40, 168},
+    {200, 72, 232, 104},
+    {56, 184, 24, 152},
+    {248, 120, 216, 88},
+};
+
+// bit n of a nibble moved to bit (7 - 2n)
+static const uint8_t sg_nibble_spread[16] = {
+    0x00, 0x80, 0x20, 0xA0, 0x08, 0x88, 0x28, 0xA8,
+    0x02, 0x82, 0x22, 0xA2, 0x0A, 0x8A, 0x2A, 0xAA,
+};
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static inline uint8_t __mono_threshold_byte(const uint16_t *src, uint16_t threshold)
+{
+    return (uint8_t)((src[0] <= threshold) | ((src[1] <= threshold) << 1) | ((src[2] <= threshold) << 2) |
+                     ((src[3] <= threshold) << 3) | ((src[4] <= threshold) << 4) | ((src[5] <= threshold) << 5) |
+                     ((src[6] <= threshold) << 6) | ((src[7] <= threshold) << 7));
+}
+
+static inline uint8_t __mono_dither_byte(const uint16_t *src, const uint8_t *bayer)
+{
+    uint8_t b = 0;
+    uint32_t i = 0;
+
+    for (i = 0; i < 8; i++) {
+        b |= (uint8_t)((RGB565_LUMA(src[i]) < bayer[i & 3]) << i);
+    }
+
+    return b;
+}
+
+static inline void __mono_write_bit(uint8_t *dst, uint32_t x, bool set)
+{
+    if (set) {
+        dst[x / 8] |= (1 << (x % 8));
+    } else {
+        dst[x / 8] &= ~(1 << (x % 8));
+    }
+}
+
+void tdl_disp_rgb565_to_mono(const uint16_t *src, uint32_t num, uint8_t *dst_row, uint32_t x, uint16_t threshold)
+{
+    uint8_t *dst = NULL;
+
+    if (NULL == src || NULL == dst_row) {
+        return;
+    }
+
+    while (num > 0 && (x & 7)) {
+        __mono_write_bit(dst_row, x++, (*src++ <= threshold));
+        num--;
+    }
+
+    dst = dst_row + x / 8;
+    while (num >= 8) {
+        *dst++ = __mono_threshold_byte(src, threshold);
+        src += 8;
+        x += 8;
+        num -= 8;
+    }
+
+    while (num > 0) {
+        __mono_write_bit(dst_row, x++, (*src++ <= threshold));
+        num--;
+    }
+}
+
+void tdl_disp_rgb565_to_mono_dither(const uint16_t *src, uint32_t num, uint8_t *dst_row, uint32_t x, uint32_t y)
+{
+    const uint8_t *bayer = NULL;
+    uint8_t *dst = NULL;
+
+    if (NULL == src || NULL == dst_row) {
+        return;
+    }
+
+    bayer = sg_bayer4x4[y & 3];
+
+    while (num > 0 && (x & 7)) {
+        __mono_write_bit(dst_row, x, (RGB565_LUMA(*src) < bayer[x & 3]));
+        src++;
+        x++;
+        num--;
+    }
+
+    // x is a multiple of 8 here, so the matrix column restarts at 0 for every byte
+    dst = dst_row + x / 8;
+    while (num >= 8) {
+        *dst++ = __mono_dither_byte(src, bayer);
+        src += 8;
+        x += 8;
+        num -= 8;
+    }
+
+    while (num > 0) {
+        __mono_write_bit(dst_row, x, (RGB565_LUMA(*src) < bayer[x & 3]));
+        src++;
+        x++;
+        num--;
+    }
+}
+
+void tdl_disp_rgb565_to_i2(const uint16_t *src, uint32_t num, uint8_t *dst_row, uint32_t x)
+{
+    uint8_t *dst = NULL;
+    uint32_t shift = 0;
+
+    if (NULL == src || NULL == dst_row) {
+        return;
+    }
+
+    while (num > 0 && (x & 3)) {
+        shift = (x % 4) * 2;
+        dst_row[x / 4] = (dst_row[x / 4] & ~(0x03 << shift)) | (RGB565_I2(*src) << shift);
+        src++;
+        x++;
+        num--;
+    }
+
+    dst = dst_row + x / 4;
+    while (num >= 4) {
+        *dst++ = (uint8_t)(RGB565_I2(src[0]) | (RGB565_I2(src[1]) << 2) | (RGB565_I2(src[2]) << 4) |
+                           (RGB565_I2(src[3]) << 6));
+        src += 4;
+        x += 4;
+        num -= 4;
+    }
+
+    while (num > 0) {
+        shift = (x % 4) * 2;
+        dst_row[x / 4] = (dst_row[x / 4] & ~(0x03 << shift)) | (RGB565_I2(*src) << shift);
+        src++;
+        x++;
+        num--;
+    }
+}
+
+void tdl_disp_rgb565_swap(uint16_t *buf, uint32_t num)
+{
+    uint32_t i = 0;
+
+    if (NULL == buf) {
+        return;
+    }
+
+    // per pixel, in blocks of 8 with a fixed count that compilers turn into byte shuffles where the target has them
+    for (; num >= 8; num -= 8, buf += 8) {
+        for (i = 0; i < 8; i++) {
+            buf[i] = (uint16_t)((buf[i] << 8) | (buf[i] >> 8));
+        }
+    }
+    for (i = 0; i < num; i++) {
+        buf[i] = (uint16_t)((buf[i] << 8) | (buf[i] >> 8));
+    }
+}
+
+void tdl_disp_rgb888_to_rgb565(const uint8_t *src, uint32_t num, uint16_t *dst)
+{
+    if (NULL == src || NULL == dst) {
+        return;
+    }
+
+#if TDL_DISP_PIXEL_LITTLE_ENDIAN
+    // four pixels are three source words and two destination words, memcpy keeps the accesses alignment safe
+    uint32_t w[3], out[2];
+
+    while (num >= 4) {
+        memcpy(w, src, sizeof(w));
+        out[0] = RGB888_TO_RGB565(w[0] & 0xFF, (w[0] >> 8) & 0xFF, (w[0] >> 16) & 0xFF) |
+                 (RGB888_TO_RGB565(w[0] >> 24, w[1] & 0xFF, (w[1] >> 8) & 0xFF) << 16);
+        out[1] = RGB888_TO_RGB565((w[1] >> 16) & 0xFF, w[1] >> 24, w[2] & 0xFF) |
+                 (RGB888_TO_RGB565((w[2] >> 8) & 0xFF, (w[2] >> 16) & 0xFF, w[2] >> 24) << 16);
+        memcpy(dst, out, sizeof(out));
+        src += sizeof(w);
+        dst += 4;
+        num -= 4;
+    }
+#endif
+
+    while (num > 0) {
+        *dst++ = (uint16_t)RGB888_TO_RGB565(src[0], src[1], src[2]);
+        src += 3;
+        num--;
+    }
+}
+
+// transposes an 8x8 bit block, bit (8 * row + col) moves to bit (8 * col + row)
+static inline uint64_t __transpose8x8(uint64_t x)
+{
+    uint64_t t = 0;
+
+    t = 0x0F0F0F0F00000000ULL & (x ^ (x << 28));
+    x ^= t ^ (t >> 28);
+    t = 0x3333000033330000ULL & (x ^ (x << 14));
+    x ^= t ^ (t >> 14);
+    t = 0x5500550055005500ULL & (x ^ (x << 7));
+    x ^= t ^ (t >> 7);
+
+    return x;
+}
+
+void tdl_disp_mono_to_page(const uint8_t *src, uint32_t width, uint32_t height, uint8_t *dst)
+{
+    uint32_t width_bytes = 0, page = 0, rows = 0, col = 0, m = 0, k = 0;
+    uint8_t *out = NULL, mix = 0;
+    uint64_t block = 0;
+
+    if (NULL == src || NULL == dst) {
+        return;
+    }
+
+    width_bytes = width / 8;
+
+    for (page = 0; page * 8 < height; page++) {
+        rows = ((height - page * 8) < 8) ? (height - page * 8) : 8;
+        out = dst + page * width;
+
+        for (col = 0; col < width_bytes; col++) {
+            block = 0;
+            for (m = 0; m < rows; m++) {
+                block |= (uint64_t)src[(page * 8 + m) * width_bytes + col] << (8 * m);
+            }
+            block = __transpose8x8(block);
+            for (k = 0; k < 8; k++) {
+                *out++ = (uint8_t)(block >> (8 * k));
+            }
+        }
+
+        // columns of a width that is not a multiple of 8
+        for (k = width_bytes * 8; k < width; k++) {
+            mix = 0;
+            for (m = 0; m < rows; m++) {
+                mix |= ((src[(page * 8 + m) * width_bytes + k / 8] >> (k % 8)) & 0x01) << m;
+            }
+            *out++ = mix;
+        }
+    }
+}
+
+void tdl_disp_interleave_rows(const uint8_t *row0, const uint8_t *row1, uint32_t len, uint8_t *dst)
+{
+    uint32_t i = 0;
+
+    if (NULL == row0 || NULL == row1 || NULL == dst) {
+        return;
+    }
+
+    for (i = 0; i < len; i++) {
+        *dst++ = sg_nibble_spread[row0[i] & 0x0F] | (sg_nibble_spread[row1[i] & 0x0F] >> 1);
+        *dst++ = sg_nibble_spread[row0[i] >> 4] | (sg_nibble_spread[row1[i] >> 4] >> 1);
+    }
+}
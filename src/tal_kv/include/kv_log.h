@@ -0,0 +1,157 @@
+/**
+ * @file kv_log.h
+ * @brief Log-structured key-value engine on top of littlefs.
+ *
+ * Records are appended to a few segment files in one directory and located
+ * through a hash index kept in RAM, so a set costs one append and one sync
+ * instead of rewriting a file per key. Every record carries a CRC. Writes
+ * between kv_log_batch_begin() and kv_log_batch_commit() are synced once and
+ * take effect together after a power loss. Segments whose records have been
+ * overwritten are reclaimed by kv_log_compact().
+ *
+ * The engine does no locking, the caller serializes the calls.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __KV_LOG_H__
+#define __KV_LOG_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tuya_cloud_types.h"
+#include "lfs.h"
+
+#ifndef KV_LOG_SEGMENT_SIZE
+#define KV_LOG_SEGMENT_SIZE (16 * 1024)
+#endif
+
+#ifndef KV_LOG_SEGMENT_NUM
+#define KV_LOG_SEGMENT_NUM 4
+#endif
+
+typedef struct kv_log kv_log_t;
+
+typedef struct {
+    uint32_t keys;     // keys in the index
+    uint32_t segments; // segment files
+    uint32_t bytes;    // bytes in all segments
+    uint32_t live;     // bytes of the records the index points to
+    uint32_t syncs;    // lfs_file_sync() calls
+    uint32_t compacts; // segments reclaimed
+} kv_log_stat_t;
+
+/**
+ * @brief Opens the log in a directory, creates it when missing and rebuilds the
+ * index from the segments.
+ *
+ * @param[in] lfs mounted littlefs
+ * @param[in] dir directory of the segment files
+ * @param[out] log the log handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET kv_log_open(lfs_t *lfs, const char *dir, kv_log_t **log);
+
+/**
+ * @brief Closes the log and frees the index. An open batch is dropped.
+ *
+ * @param[in] log the log handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET kv_log_close(kv_log_t *log);
+
+/**
+ * @brief Appends a new value of a key.
+ *
+ * @param[in] log the log handle
+ * @param[in] key the key, at most 255 bytes
+ * @param[in] value the value
+ * @param[in] length the value length
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET kv_log_set(kv_log_t *log, const char *key, const uint8_t *value, size_t length);
+
+/**
+ * @brief Reads the value of a key into a buffer from tal_malloc(), with a
+ * trailing '\0' that is not counted in length.
+ *
+ * @param[in] log the log handle
+ * @param[in] key the key
+ * @param[out] value the value, free it with tal_free()
+ * @param[out] length the value length
+ *
+ * @return OPRT_OK on success, OPRT_NOT_FOUND if the key does not exist.
+ */
+OPERATE_RET kv_log_get(kv_log_t *log, const char *key, uint8_t **value, size_t *length);
+
+/**
+ * @brief Appends a delete record of a key.
+ *
+ * @param[in] log the log handle
+ * @param[in] key the key
+ *
+ * @return OPRT_OK on success, OPRT_NOT_FOUND if the key does not exist.
+ */
+OPERATE_RET kv_log_del(kv_log_t *log, const char *key);
+
+/**
+ * @brief Starts a batch, the following sets and deletes are not synced until
+ * kv_log_batch_commit().
+ *
+ * @param[in] log the log handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET kv_log_batch_begin(kv_log_t *log);
+
+/**
+ * @brief Ends a batch with a commit record and one sync. When that fails the
+ * records of the batch are removed and the index is back to its state at
+ * kv_log_batch_begin(), the batch is ended either way.
+ *
+ * @param[in] log the log handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET kv_log_batch_commit(kv_log_t *log);
+
+/**
+ * @brief Checks whether there are more segments than KV_LOG_SEGMENT_NUM, or
+ * the oldest one holds no live record. Always FALSE inside a batch.
+ *
+ * @param[in] log the log handle
+ *
+ * @return TRUE when kv_log_compact() has work to do
+ */
+BOOL_T kv_log_need_compact(kv_log_t *log);
+
+/**
+ * @brief Copies the live records of the oldest segment to the newest one and
+ * removes it, until at most KV_LOG_SEGMENT_NUM segments are left.
+ *
+ * @param[in] log the log handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET kv_log_compact(kv_log_t *log);
+
+/**
+ * @brief Reads the counters of the log.
+ *
+ * @param[in] log the log handle
+ * @param[out] stat the counters
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET kv_log_stat_get(kv_log_t *log, kv_log_stat_t *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __KV_LOG_H__ */
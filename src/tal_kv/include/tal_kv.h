@@ -53,6 +53,15 @@ typedef struct {
     uint16_t len; // property length
 } kv_db_t;
 
+/**
+ * @brief format of a record written by tal_kv_serialize_set_fmt()
+ *
+ */
+typedef enum {
+    KV_SERIALIZE_JSON = 0, // JSON text, raw data in base64
+    KV_SERIALIZE_BIN,      // binary TLV, 16-bit key IDs and varint lengths
+} KV_SERIALIZE_FMT_E;
+
 #define TAL_LV_KEY_LEN 16
 
 typedef struct {
@@ -60,6 +69,18 @@ typedef struct {
     char key[TAL_LV_KEY_LEN + 1];
 } tal_kv_cfg_t;
 
+/**
+ * @brief counters of the decrypted value cache of tal_kv_get()
+ *
+ */
+typedef struct {
+    uint32_t hits;      // values served from RAM
+    uint32_t misses;    // values read from flash
+    uint32_t evictions; // values dropped for the byte budget
+    uint32_t entries;   // values in the cache
+    uint32_t bytes;     // bytes used of KV_CACHE_SIZE
+} tal_kv_cache_stat_t;
+
 /**
  * @brief Initializes the TAL Key-Value (KV) module.
  *
@@ -102,6 +123,40 @@ int tal_kv_set(const char *key, const uint8_t *value, size_t length);
  */
 int tal_kv_get(const char *key, uint8_t **value, size_t *length);
 
+/**
+ * @brief Retrieves a read-only view of the value of a key.
+ *
+ * The view shares the buffer of the value cache instead of copying it, and
+ * stays valid after the key is set or deleted again. Release it with
+ * tal_kv_put_ref(), not tal_kv_free().
+ *
+ * @param key The key to retrieve the value for.
+ * @param value A pointer that will point to the value, '\0' terminated.
+ * @param length A pointer to a variable that will store the length of the
+ * value.
+ *
+ * @return 0 if the value was successfully retrieved, or a negative error code
+ * if an error occurred.
+ */
+int tal_kv_get_ref(const char *key, const uint8_t **value, size_t *length);
+
+/**
+ * @brief Releases a view returned by tal_kv_get_ref().
+ *
+ * @param value The value returned by tal_kv_get_ref().
+ * @return 0 on success, or a negative error code if an error occurred.
+ */
+int tal_kv_put_ref(const uint8_t *value);
+
+/**
+ * @brief Reads the counters of the value cache, also printed by the
+ * "kv cache" command.
+ *
+ * @param stat A pointer to the structure that will store the counters.
+ * @return 0 on success, or a negative error code if an error occurred.
+ */
+int tal_kv_cache_stat_get(tal_kv_cache_stat_t *stat);
+
 /**
  * @brief Frees the memory allocated for a value in the TAL Key-Value store.
  *
@@ -125,6 +180,27 @@ int tal_kv_free(uint8_t *value);
  */
 int tal_kv_del(const char *key);
 
+/**
+ * @brief Starts a batch of tal_kv_set() and tal_kv_del() calls.
+ *
+ * The calling thread holds the key-value store until tal_kv_batch_commit(),
+ * other threads wait. With ENABLE_KV_LOG the writes of the batch are synced to
+ * flash once at the commit and survive a power loss all together or not at
+ * all. Without it every write still goes to flash on its own.
+ *
+ * @return 0 on success, or a negative error code if the calling thread
+ * already runs a batch.
+ */
+int tal_kv_batch_begin(void);
+
+/**
+ * @brief Ends the batch started by tal_kv_batch_begin() on the calling thread.
+ *
+ * @return 0 if the batch was committed, or a negative error code if an error
+ * occurred.
+ */
+int tal_kv_batch_commit(void);
+
 /**
  * @brief Serializes and sets the value of a key in the key-value database.
  *
@@ -153,6 +229,36 @@ int tal_kv_serialize_set(const char *key, kv_db_t *db, size_t dbcnt);
  */
 int tal_kv_serialize_get(const char *key, kv_db_t *db, size_t dbcnt);
 
+/**
+ * @brief Serializes the key-value database in the given format and sets it
+ * using the specified key.
+ *
+ * KV_SERIALIZE_BIN identifies the keys by a 16-bit hash, two keys of one
+ * database with the same hash are rejected with an error.
+ *
+ * @param key The key to set in the database.
+ * @param db A pointer to the key-value database.
+ * @param dbcnt The size of the key-value database.
+ * @param fmt The format of the stored record.
+ * @return Returns 0 on success, or a negative error code on failure.
+ */
+int tal_kv_serialize_set_fmt(const char *key, kv_db_t *db, size_t dbcnt, KV_SERIALIZE_FMT_E fmt);
+
+/**
+ * @brief Retrieves a record stored in either format into the key-value
+ * database, and rewrites it in the given format when it was stored in the
+ * other one, so records written by older firmware migrate on the first read.
+ *
+ * tal_kv_serialize_get() reads both formats as well but never rewrites.
+ *
+ * @param key The key to retrieve.
+ * @param db The database to fill.
+ * @param dbcnt The size of the key-value database.
+ * @param fmt The format the record is kept in.
+ * @return Returns 0 on success, or a negative error code on failure.
+ */
+int tal_kv_serialize_get_fmt(const char *key, kv_db_t *db, size_t dbcnt, KV_SERIALIZE_FMT_E fmt);
+
 /**
  * @brief Executes the TAL KV command.
  *
@@ -0,0 +1,1001 @@
+/**
+ * @file kv_log.c
+ * @brief Log-structured key-value engine on top of littlefs.
+ *
+ * A segment is a file named by its 8 digit hex id in the log directory. Records
+ * are only appended to the segment with the highest id; when it grows beyond
+ * KV_LOG_SEGMENT_SIZE the next write starts a new one. A record is a header,
+ * the key and the value:
+ *
+ *   | magic | type | flags | key_len | rsv | val_len | crc | key | value |
+ *
+ * The CRC-32 covers the header (crc field 0), the key and the value. Records
+ * written inside a batch carry KV_LOG_REC_F_BATCH and only count after the
+ * COMMIT record that ends the batch, so a batch is applied all or nothing when
+ * the index is rebuilt at open. An unfinished batch at the end of a segment is
+ * cut off, and a batch that fails to commit is cut off right away, so a later
+ * COMMIT never picks up its records.
+ *
+ * The index maps each key to the segment and offset of its newest record. The
+ * oldest segment is reclaimed by copying its live records to the newest one,
+ * a delete record is dropped with it since no older segment is left.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "kv_log.h"
+#include "crc32i.h"
+#include "tal_api.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define KV_LOG_REC_MAGIC 0x4B56
+
+#define KV_LOG_REC_SET    1
+#define KV_LOG_REC_DEL    2
+#define KV_LOG_REC_COMMIT 3
+
+#define KV_LOG_REC_F_BATCH 0x01
+
+#define KV_LOG_KEY_MAX  255
+#define KV_LOG_HASH_NUM 32
+#define KV_LOG_DIR_LEN  32
+#define KV_LOG_PATH_LEN (KV_LOG_DIR_LEN + 10)
+#define KV_LOG_BUF_LEN  64
+
+#define KV_LOG_REC_SIZE(key_len, val_len) (sizeof(kv_log_rec_t) + (key_len) + (val_len))
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    uint16_t magic;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t key_len;
+    uint16_t rsv;
+    uint32_t val_len;
+    uint32_t crc;
+} kv_log_rec_t;
+
+typedef struct kv_log_ent {
+    struct kv_log_ent *next;
+    uint32_t seg;     // segment id of the newest record
+    uint32_t off;     // offset of the record in the segment
+    uint32_t val_len;
+    uint16_t key_len;
+    uint8_t type;     // record type, only used for batch records at open
+    char key[1];
+} kv_log_ent_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t size; // bytes of valid records
+    uint32_t live; // bytes of the records the index points to
+} kv_log_seg_t;
+
+struct kv_log {
+    lfs_t *lfs;
+    char dir[KV_LOG_DIR_LEN];
+    kv_log_ent_t *hash[KV_LOG_HASH_NUM];
+    kv_log_seg_t *segs; // ascending id, records are appended to the last one
+    uint32_t seg_num;
+    uint32_t seg_cap;
+    lfs_file_t file; // the last segment
+    BOOL_T file_open;
+    BOOL_T batch;
+    uint32_t batch_off; // size of the last segment when the batch began
+    uint32_t keys;
+    uint32_t syncs;
+    uint32_t compacts;
+};
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint32_t __kv_log_hash(const char *key, uint16_t key_len)
+{
+    uint32_t h = 2166136261u;
+    uint16_t i = 0;
+
+    for (i = 0; i < key_len; i++) {
+        h = (h ^ (uint8_t)key[i]) * 16777619u;
+    }
+
+    return h % KV_LOG_HASH_NUM;
+}
+
+static void __kv_log_path(kv_log_t *log, uint32_t id, char *path)
+{
+    snprintf(path, KV_LOG_PATH_LEN, "%s/%08x", log->dir, (unsigned int)id);
+}
+
+static kv_log_seg_t *__kv_log_seg_find(kv_log_t *log, uint32_t id)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < log->seg_num; i++) {
+        if (log->segs[i].id == id) {
+            return &log->segs[i];
+        }
+    }
+
+    return NULL;
+}
+
+static kv_log_seg_t *__kv_log_seg_last(kv_log_t *log)
+{
+    return &log->segs[log->seg_num - 1];
+}
+
+static OPERATE_RET __kv_log_seg_add(kv_log_t *log, uint32_t id)
+{
+    kv_log_seg_t *segs = NULL;
+
+    if (log->seg_num == log->seg_cap) {
+        segs = tal_malloc((log->seg_cap + 4) * sizeof(kv_log_seg_t));
+        if (NULL == segs) {
+            return OPRT_MALLOC_FAILED;
+        }
+        if (log->segs) {
+            memcpy(segs, log->segs, log->seg_num * sizeof(kv_log_seg_t));
+            tal_free(log->segs);
+        }
+        log->segs = segs;
+        log->seg_cap += 4;
+    }
+
+    log->segs[log->seg_num].id = id;
+    log->segs[log->seg_num].size = 0;
+    log->segs[log->seg_num].live = 0;
+    log->seg_num++;
+
+    return OPRT_OK;
+}
+
+static kv_log_ent_t *__kv_log_find(kv_log_t *log, const char *key, uint16_t key_len, kv_log_ent_t ***link)
+{
+    kv_log_ent_t **pp = &log->hash[__kv_log_hash(key, key_len)];
+
+    for (; *pp; pp = &(*pp)->next) {
+        if ((*pp)->key_len == key_len && 0 == memcmp((*pp)->key, key, key_len)) {
+            break;
+        }
+    }
+
+    if (link) {
+        *link = pp;
+    }
+
+    return *pp;
+}
+
+static kv_log_ent_t *__kv_log_ent_new(const char *key, uint16_t key_len, uint32_t seg, uint32_t off,
+                                      uint32_t val_len)
+{
+    kv_log_ent_t *ent = tal_malloc(sizeof(kv_log_ent_t) + key_len);
+
+    if (ent) {
+        ent->next = NULL;
+        ent->seg = seg;
+        ent->off = off;
+        ent->val_len = val_len;
+        ent->key_len = key_len;
+        ent->type = KV_LOG_REC_SET;
+        memcpy(ent->key, key, key_len);
+        ent->key[key_len] = '\0';
+    }
+
+    return ent;
+}
+
+static void __kv_log_live_sub(kv_log_t *log, kv_log_ent_t *ent)
+{
+    kv_log_seg_t *seg = __kv_log_seg_find(log, ent->seg);
+
+    if (seg) {
+        seg->live -= KV_LOG_REC_SIZE(ent->key_len, ent->val_len);
+    }
+}
+
+static void __kv_log_live_add(kv_log_t *log, kv_log_ent_t *ent)
+{
+    kv_log_seg_t *seg = __kv_log_seg_find(log, ent->seg);
+
+    if (seg) {
+        seg->live += KV_LOG_REC_SIZE(ent->key_len, ent->val_len);
+    }
+}
+
+/* points the key to a new record */
+static OPERATE_RET __kv_log_index_put(kv_log_t *log, const char *key, uint16_t key_len, uint32_t seg, uint32_t off,
+                                      uint32_t val_len)
+{
+    kv_log_ent_t **link = NULL;
+    kv_log_ent_t *ent = __kv_log_find(log, key, key_len, &link);
+
+    if (ent) {
+        __kv_log_live_sub(log, ent);
+        ent->seg = seg;
+        ent->off = off;
+        ent->val_len = val_len;
+    } else {
+        ent = __kv_log_ent_new(key, key_len, seg, off, val_len);
+        if (NULL == ent) {
+            return OPRT_MALLOC_FAILED;
+        }
+        *link = ent;
+        log->keys++;
+    }
+    __kv_log_live_add(log, ent);
+
+    return OPRT_OK;
+}
+
+static BOOL_T __kv_log_index_del(kv_log_t *log, const char *key, uint16_t key_len)
+{
+    kv_log_ent_t **link = NULL;
+    kv_log_ent_t *ent = __kv_log_find(log, key, key_len, &link);
+
+    if (NULL == ent) {
+        return FALSE;
+    }
+
+    __kv_log_live_sub(log, ent);
+    *link = ent->next;
+    tal_free(ent);
+    log->keys--;
+
+    return TRUE;
+}
+
+static uint32_t __kv_log_rec_crc(kv_log_rec_t *rec, const void *key, const void *value)
+{
+    kv_log_rec_t hdr = *rec;
+    uint32_t crc = hash_crc32i_init();
+
+    hdr.crc = 0;
+    crc = hash_crc32i_update(crc, &hdr, sizeof(hdr));
+    if (rec->key_len) {
+        crc = hash_crc32i_update(crc, key, rec->key_len);
+    }
+    if (rec->val_len) {
+        crc = hash_crc32i_update(crc, value, rec->val_len);
+    }
+
+    return hash_crc32i_finish(crc);
+}
+
+/* the last segment is read through its append handle, older ones are opened for the read */
+static lfs_file_t *__kv_log_reader_open(kv_log_t *log, uint32_t seg, lfs_file_t *tmp)
+{
+    char path[KV_LOG_PATH_LEN];
+
+    if (seg == __kv_log_seg_last(log)->id && log->file_open) {
+        return &log->file;
+    }
+
+    __kv_log_path(log, seg, path);
+    if (LFS_ERR_OK != lfs_file_open(log->lfs, tmp, path, LFS_O_RDONLY)) {
+        return NULL;
+    }
+
+    return tmp;
+}
+
+static void __kv_log_reader_close(kv_log_t *log, lfs_file_t *file)
+{
+    if (file != &log->file) {
+        lfs_file_close(log->lfs, file);
+    }
+}
+
+static OPERATE_RET __kv_log_read_at(kv_log_t *log, lfs_file_t *file, uint32_t off, void *buf, uint32_t len)
+{
+    if (lfs_file_seek(log->lfs, file, off, LFS_SEEK_SET) < 0) {
+        return OPRT_KVS_RD_FAIL;
+    }
+    if (len && lfs_file_read(log->lfs, file, buf, len) != (lfs_ssize_t)len) {
+        return OPRT_KVS_RD_FAIL;
+    }
+
+    return OPRT_OK;
+}
+
+/* reads and checks the value of an index entry */
+static OPERATE_RET __kv_log_read_value(kv_log_t *log, kv_log_ent_t *ent, uint8_t **value)
+{
+    OPERATE_RET rt = OPRT_OK;
+    lfs_file_t tmp, *file = NULL;
+    kv_log_rec_t rec;
+    char key[KV_LOG_KEY_MAX];
+    uint8_t *buf = NULL;
+
+    buf = tal_malloc(ent->val_len + 1);
+    if (NULL == buf) {
+        return OPRT_MALLOC_FAILED;
+    }
+
+    file = __kv_log_reader_open(log, ent->seg, &tmp);
+    if (NULL == file) {
+        tal_free(buf);
+        return OPRT_KVS_RD_FAIL;
+    }
+
+    rt = __kv_log_read_at(log, file, ent->off, &rec, sizeof(rec));
+    if (OPRT_OK == rt && (rec.key_len != ent->key_len || rec.val_len != ent->val_len)) {
+        rt = OPRT_KVS_RD_FAIL;
+    }
+    if (OPRT_OK == rt && rec.key_len && lfs_file_read(log->lfs, file, key, rec.key_len) != rec.key_len) {
+        rt = OPRT_KVS_RD_FAIL;
+    }
+    if (OPRT_OK == rt && rec.val_len && lfs_file_read(log->lfs, file, buf, rec.val_len) != (lfs_ssize_t)rec.val_len) {
+        rt = OPRT_KVS_RD_FAIL;
+    }
+    __kv_log_reader_close(log, file);
+
+    if (OPRT_OK == rt && rec.crc != __kv_log_rec_crc(&rec, key, buf)) {
+        PR_ERR("kv log %s crc error at %08x:%d", ent->key, ent->seg, ent->off);
+        rt = OPRT_KVS_RD_FAIL;
+    }
+
+    if (OPRT_OK != rt) {
+        tal_free(buf);
+        return rt;
+    }
+
+    buf[ent->val_len] = '\0';
+    *value = buf;
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __kv_log_file_open(kv_log_t *log)
+{
+    char path[KV_LOG_PATH_LEN];
+    kv_log_seg_t *seg = __kv_log_seg_last(log);
+    int err = 0;
+
+    __kv_log_path(log, seg->id, path);
+    err = lfs_file_open(log->lfs, &log->file, path, LFS_O_RDWR | LFS_O_CREAT);
+    if (LFS_ERR_OK != err) {
+        PR_ERR("kv log open %s err %d", path, err);
+        return OPRT_KVS_WR_FAIL;
+    }
+    log->file_open = TRUE;
+
+    // drop a damaged tail, the next record is appended after the last valid one
+    if (lfs_file_size(log->lfs, &log->file) > (lfs_soff_t)seg->size) {
+        PR_WARN("kv log %s truncated to %d", path, seg->size);
+        lfs_file_truncate(log->lfs, &log->file, seg->size);
+        lfs_file_sync(log->lfs, &log->file);
+    }
+
+    return OPRT_OK;
+}
+
+static void __kv_log_file_close(kv_log_t *log)
+{
+    if (log->file_open) {
+        lfs_file_close(log->lfs, &log->file);
+        log->file_open = FALSE;
+    }
+}
+
+/* starts a new segment */
+static OPERATE_RET __kv_log_roll(kv_log_t *log)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    __kv_log_file_close(log);
+
+    rt = __kv_log_seg_add(log, __kv_log_seg_last(log)->id + 1);
+    if (OPRT_OK != rt) {
+        __kv_log_file_open(log);
+        return rt;
+    }
+
+    return __kv_log_file_open(log);
+}
+
+static OPERATE_RET __kv_log_append(kv_log_t *log, uint8_t type, const char *key, uint16_t key_len,
+                                   const uint8_t *value, uint32_t val_len, uint32_t *off)
+{
+    kv_log_seg_t *seg = __kv_log_seg_last(log);
+    kv_log_rec_t rec;
+    lfs_ssize_t ret = 0;
+
+    if (!log->file_open) {
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = KV_LOG_REC_MAGIC;
+    rec.type = type;
+    rec.flags = (log->batch && KV_LOG_REC_COMMIT != type) ? KV_LOG_REC_F_BATCH : 0;
+    rec.key_len = key_len;
+    rec.val_len = val_len;
+    rec.crc = __kv_log_rec_crc(&rec, key, value);
+
+    if (lfs_file_seek(log->lfs, &log->file, seg->size, LFS_SEEK_SET) < 0) {
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    ret = lfs_file_write(log->lfs, &log->file, &rec, sizeof(rec));
+    if (ret == sizeof(rec) && key_len) {
+        ret = lfs_file_write(log->lfs, &log->file, key, key_len);
+        ret = (ret == key_len) ? (lfs_ssize_t)sizeof(rec) : -1;
+    }
+    if (ret == sizeof(rec) && val_len) {
+        ret = lfs_file_write(log->lfs, &log->file, value, val_len);
+        ret = (ret == (lfs_ssize_t)val_len) ? (lfs_ssize_t)sizeof(rec) : -1;
+    }
+    if (ret != sizeof(rec)) {
+        PR_ERR("kv log write err %d", ret);
+        lfs_file_truncate(log->lfs, &log->file, seg->size);
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    if (off) {
+        *off = seg->size;
+    }
+    seg->size += KV_LOG_REC_SIZE(key_len, val_len);
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __kv_log_sync(kv_log_t *log)
+{
+    log->syncs++;
+    if (LFS_ERR_OK != lfs_file_sync(log->lfs, &log->file)) {
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    return OPRT_OK;
+}
+
+static void __kv_log_apply(kv_log_t *log, uint8_t type, const char *key, uint16_t key_len, uint32_t seg,
+                           uint32_t off, uint32_t val_len)
+{
+    if (KV_LOG_REC_SET == type) {
+        __kv_log_index_put(log, key, key_len, seg, off, val_len);
+    } else {
+        __kv_log_index_del(log, key, key_len);
+    }
+}
+
+static BOOL_T __kv_log_rec_valid(kv_log_rec_t *rec, uint32_t off, uint32_t size)
+{
+    if (KV_LOG_REC_MAGIC != rec->magic || rec->key_len > KV_LOG_KEY_MAX) {
+        return FALSE;
+    }
+    if (rec->type < KV_LOG_REC_SET || rec->type > KV_LOG_REC_COMMIT) {
+        return FALSE;
+    }
+    if (rec->val_len > size || off + KV_LOG_REC_SIZE(rec->key_len, rec->val_len) > size) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* checks the CRC of a record whose header and key were read, the value is streamed */
+static BOOL_T __kv_log_rec_check(kv_log_t *log, lfs_file_t *file, kv_log_rec_t *rec, const char *key)
+{
+    kv_log_rec_t hdr = *rec;
+    uint8_t buf[KV_LOG_BUF_LEN];
+    uint32_t crc = hash_crc32i_init();
+    uint32_t left = rec->val_len, len = 0;
+
+    hdr.crc = 0;
+    crc = hash_crc32i_update(crc, &hdr, sizeof(hdr));
+    if (rec->key_len) {
+        crc = hash_crc32i_update(crc, key, rec->key_len);
+    }
+    while (left) {
+        len = (left > sizeof(buf)) ? sizeof(buf) : left;
+        if (lfs_file_read(log->lfs, file, buf, len) != (lfs_ssize_t)len) {
+            return FALSE;
+        }
+        crc = hash_crc32i_update(crc, buf, len);
+        left -= len;
+    }
+
+    return (rec->crc == hash_crc32i_finish(crc)) ? TRUE : FALSE;
+}
+
+static void __kv_log_ent_list_free(kv_log_ent_t **list)
+{
+    kv_log_ent_t *ent = NULL;
+
+    while (*list) {
+        ent = *list;
+        *list = ent->next;
+        tal_free(ent);
+    }
+}
+
+/* adds the records of one segment to the index, records of an unfinished batch are dropped */
+static OPERATE_RET __kv_log_replay(kv_log_t *log, kv_log_seg_t *seg)
+{
+    char path[KV_LOG_PATH_LEN];
+    char key[KV_LOG_KEY_MAX];
+    lfs_file_t file;
+    kv_log_rec_t rec;
+    kv_log_ent_t *staged = NULL, **tail = &staged, *ent = NULL;
+    uint32_t off = 0, size = 0, batch_off = 0;
+
+    __kv_log_path(log, seg->id, path);
+    if (LFS_ERR_OK != lfs_file_open(log->lfs, &file, path, LFS_O_RDONLY)) {
+        return OPRT_KVS_RD_FAIL;
+    }
+    size = lfs_file_size(log->lfs, &file);
+
+    while (off + sizeof(rec) <= size) {
+        if (lfs_file_read(log->lfs, &file, &rec, sizeof(rec)) != sizeof(rec) || !__kv_log_rec_valid(&rec, off, size)) {
+            break;
+        }
+        if (rec.key_len && lfs_file_read(log->lfs, &file, key, rec.key_len) != rec.key_len) {
+            break;
+        }
+        if (!__kv_log_rec_check(log, &file, &rec, key)) {
+            break;
+        }
+
+        if (KV_LOG_REC_COMMIT == rec.type) {
+            while (staged) {
+                ent = staged;
+                staged = ent->next;
+                __kv_log_apply(log, ent->type, ent->key, ent->key_len, ent->seg, ent->off, ent->val_len);
+                tal_free(ent);
+            }
+            tail = &staged;
+            batch_off = 0;
+        } else if (rec.flags & KV_LOG_REC_F_BATCH) {
+            if (NULL == staged) {
+                batch_off = off;
+            }
+            ent = __kv_log_ent_new(key, rec.key_len, seg->id, off, rec.val_len);
+            if (ent) {
+                ent->type = rec.type;
+                *tail = ent;
+                tail = &ent->next;
+            }
+        } else {
+            // a batch followed by a plain record was abandoned, its records never count
+            __kv_log_ent_list_free(&staged);
+            tail = &staged;
+            batch_off = 0;
+            __kv_log_apply(log, rec.type, key, rec.key_len, seg->id, off, rec.val_len);
+        }
+
+        off += KV_LOG_REC_SIZE(rec.key_len, rec.val_len);
+    }
+    lfs_file_close(log->lfs, &file);
+
+    if (off != size) {
+        PR_WARN("kv log %s invalid record at %d of %d", path, off, size);
+    }
+    // the next record goes where the unfinished batch began, the file is truncated there when it is opened
+    if (staged) {
+        PR_WARN("kv log %s drop uncommitted batch at %d", path, batch_off);
+        __kv_log_ent_list_free(&staged);
+        off = batch_off;
+    }
+
+    seg->size = off;
+
+    return OPRT_OK;
+}
+
+static BOOL_T __kv_log_seg_id_parse(const char *name, uint32_t *id)
+{
+    uint32_t v = 0;
+    int i = 0;
+
+    for (i = 0; i < 8; i++) {
+        if (name[i] >= '0' && name[i] <= '9') {
+            v = (v << 4) | (name[i] - '0');
+        } else if (name[i] >= 'a' && name[i] <= 'f') {
+            v = (v << 4) | (name[i] - 'a' + 10);
+        } else {
+            return FALSE;
+        }
+    }
+    if (name[8] != '\0' || 0 == v) {
+        return FALSE;
+    }
+    *id = v;
+
+    return TRUE;
+}
+
+static OPERATE_RET __kv_log_scan(kv_log_t *log)
+{
+    OPERATE_RET rt = OPRT_OK;
+    lfs_dir_t dir;
+    struct lfs_info info;
+    kv_log_seg_t tmp;
+    uint32_t id = 0, i = 0, j = 0;
+
+    if (LFS_ERR_OK != lfs_dir_open(log->lfs, &dir, log->dir)) {
+        return OPRT_KVS_RD_FAIL;
+    }
+    while (lfs_dir_read(log->lfs, &dir, &info) > 0) {
+        if (LFS_TYPE_REG == info.type && __kv_log_seg_id_parse(info.name, &id)) {
+            rt = __kv_log_seg_add(log, id);
+            if (OPRT_OK != rt) {
+                break;
+            }
+        }
+    }
+    lfs_dir_close(log->lfs, &dir);
+
+    // replay in write order
+    for (i = 1; i < log->seg_num; i++) {
+        tmp = log->segs[i];
+        for (j = i; j > 0 && log->segs[j - 1].id > tmp.id; j--) {
+            log->segs[j] = log->segs[j - 1];
+        }
+        log->segs[j] = tmp;
+    }
+
+    for (i = 0; OPRT_OK == rt && i < log->seg_num; i++) {
+        rt = __kv_log_replay(log, &log->segs[i]);
+    }
+
+    return rt;
+}
+
+static void __kv_log_index_clear(kv_log_t *log)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < KV_LOG_HASH_NUM; i++) {
+        __kv_log_ent_list_free(&log->hash[i]);
+    }
+    for (i = 0; i < log->seg_num; i++) {
+        log->segs[i].live = 0;
+    }
+    log->keys = 0;
+}
+
+/* cuts off the records of the open batch and rebuilds the index they already changed, the file is reopened since a
+ * handle whose sync failed does not sync again */
+static OPERATE_RET __kv_log_batch_drop(kv_log_t *log)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t i = 0;
+
+    log->batch = FALSE;
+    __kv_log_file_close(log);
+    __kv_log_seg_last(log)->size = log->batch_off;
+    rt = __kv_log_file_open(log);
+
+    __kv_log_index_clear(log);
+    for (i = 0; i < log->seg_num; i++) {
+        __kv_log_replay(log, &log->segs[i]);
+    }
+
+    return rt;
+}
+
+static void __kv_log_free(kv_log_t *log)
+{
+    __kv_log_index_clear(log);
+    if (log->segs) {
+        tal_free(log->segs);
+    }
+    tal_free(log);
+}
+
+OPERATE_RET kv_log_open(lfs_t *lfs, const char *dir, kv_log_t **log)
+{
+    OPERATE_RET rt = OPRT_OK;
+    kv_log_t *p = NULL;
+    int err = 0;
+
+    if (NULL == lfs || NULL == dir || NULL == log || strlen(dir) >= KV_LOG_DIR_LEN) {
+        return OPRT_INVALID_PARM;
+    }
+
+    p = tal_malloc(sizeof(kv_log_t));
+    if (NULL == p) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(p, 0, sizeof(kv_log_t));
+    p->lfs = lfs;
+    strcpy(p->dir, dir);
+
+    err = lfs_mkdir(lfs, dir);
+    if (LFS_ERR_OK != err && LFS_ERR_EXIST != err) {
+        PR_ERR("kv log mkdir %s err %d", dir, err);
+        rt = OPRT_KVS_WR_FAIL;
+        goto __ERR;
+    }
+
+    rt = __kv_log_scan(p);
+    if (OPRT_OK != rt) {
+        goto __ERR;
+    }
+    if (0 == p->seg_num) {
+        rt = __kv_log_seg_add(p, 1);
+        if (OPRT_OK != rt) {
+            goto __ERR;
+        }
+    }
+
+    rt = __kv_log_file_open(p);
+    if (OPRT_OK != rt) {
+        goto __ERR;
+    }
+
+    PR_DEBUG("kv log %s: %d keys in %d segments", dir, p->keys, p->seg_num);
+    *log = p;
+
+    return OPRT_OK;
+
+__ERR:
+    __kv_log_free(p);
+    return rt;
+}
+
+OPERATE_RET kv_log_close(kv_log_t *log)
+{
+    if (NULL == log) {
+        return OPRT_INVALID_PARM;
+    }
+
+    // an open batch was never committed, it is cut off before closing the file persists it
+    if (log->batch && log->file_open) {
+        lfs_file_truncate(log->lfs, &log->file, log->batch_off);
+    }
+    if (log->file_open) {
+        __kv_log_sync(log);
+    }
+    __kv_log_file_close(log);
+    __kv_log_free(log);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET kv_log_set(kv_log_t *log, const char *key, const uint8_t *value, size_t length)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint16_t key_len = 0;
+    uint32_t off = 0;
+
+    if (NULL == log || NULL == key || (NULL == value && length)) {
+        return OPRT_INVALID_PARM;
+    }
+    key_len = strlen(key);
+    if (0 == key_len || key_len > KV_LOG_KEY_MAX) {
+        return OPRT_INVALID_PARM;
+    }
+
+    if (!log->batch && __kv_log_seg_last(log)->size >= KV_LOG_SEGMENT_SIZE) {
+        rt = __kv_log_roll(log);
+        if (OPRT_OK != rt) {
+            return rt;
+        }
+    }
+
+    rt = __kv_log_append(log, KV_LOG_REC_SET, key, key_len, value, length, &off);
+    if (OPRT_OK == rt && !log->batch) {
+        rt = __kv_log_sync(log);
+    }
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+
+    return __kv_log_index_put(log, key, key_len, __kv_log_seg_last(log)->id, off, length);
+}
+
+OPERATE_RET kv_log_get(kv_log_t *log, const char *key, uint8_t **value, size_t *length)
+{
+    OPERATE_RET rt = OPRT_OK;
+    kv_log_ent_t *ent = NULL;
+
+    if (NULL == log || NULL == key || NULL == value || NULL == length) {
+        return OPRT_INVALID_PARM;
+    }
+
+    ent = __kv_log_find(log, key, strlen(key), NULL);
+    if (NULL == ent) {
+        return OPRT_NOT_FOUND;
+    }
+
+    rt = __kv_log_read_value(log, ent, value);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+    *length = ent->val_len;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET kv_log_del(kv_log_t *log, const char *key)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint16_t key_len = 0;
+
+    if (NULL == log || NULL == key) {
+        return OPRT_INVALID_PARM;
+    }
+    key_len = strlen(key);
+    if (NULL == __kv_log_find(log, key, key_len, NULL)) {
+        return OPRT_NOT_FOUND;
+    }
+
+    if (!log->batch && __kv_log_seg_last(log)->size >= KV_LOG_SEGMENT_SIZE) {
+        rt = __kv_log_roll(log);
+        if (OPRT_OK != rt) {
+            return rt;
+        }
+    }
+
+    rt = __kv_log_append(log, KV_LOG_REC_DEL, key, key_len, NULL, 0, NULL);
+    if (OPRT_OK == rt && !log->batch) {
+        rt = __kv_log_sync(log);
+    }
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+    __kv_log_index_del(log, key, key_len);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET kv_log_batch_begin(kv_log_t *log)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    if (NULL == log || log->batch) {
+        return OPRT_INVALID_PARM;
+    }
+
+    // a batch stays in one segment, so its commit record is found with it
+    if (__kv_log_seg_last(log)->size >= KV_LOG_SEGMENT_SIZE) {
+        rt = __kv_log_roll(log);
+        if (OPRT_OK != rt) {
+            return rt;
+        }
+    }
+    log->batch = TRUE;
+    log->batch_off = __kv_log_seg_last(log)->size;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET kv_log_batch_commit(kv_log_t *log)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    if (NULL == log || !log->batch) {
+        return OPRT_INVALID_PARM;
+    }
+
+    rt = __kv_log_append(log, KV_LOG_REC_COMMIT, NULL, 0, NULL, 0, NULL);
+    if (OPRT_OK == rt) {
+        rt = __kv_log_sync(log);
+    }
+    if (OPRT_OK != rt) {
+        PR_ERR("kv log commit err %d, batch dropped", rt);
+        __kv_log_batch_drop(log);
+        return rt;
+    }
+    log->batch = FALSE;
+
+    return OPRT_OK;
+}
+
+BOOL_T kv_log_need_compact(kv_log_t *log)
+{
+    if (NULL == log || log->batch || log->seg_num < 2) {
+        return FALSE;
+    }
+
+    return (log->seg_num > KV_LOG_SEGMENT_NUM || 0 == log->segs[0].live) ? TRUE : FALSE;
+}
+
+/* moves the live records of the oldest segment to the last one and removes it */
+static OPERATE_RET __kv_log_compact_oldest(kv_log_t *log)
+{
+    OPERATE_RET rt = OPRT_OK;
+    char path[KV_LOG_PATH_LEN];
+    uint32_t id = log->segs[0].id, i = 0, off = 0;
+    kv_log_ent_t *ent = NULL;
+    uint8_t *value = NULL;
+    int err = 0;
+
+    for (i = 0; i < KV_LOG_HASH_NUM && log->segs[0].live; i++) {
+        for (ent = log->hash[i]; ent; ent = ent->next) {
+            if (ent->seg != id) {
+                continue;
+            }
+            rt = __kv_log_read_value(log, ent, &value);
+            if (OPRT_OK != rt) {
+                // keep the segment, the record may be read again later
+                return rt;
+            }
+            rt = __kv_log_append(log, KV_LOG_REC_SET, ent->key, ent->key_len, value, ent->val_len, &off);
+            tal_free(value);
+            if (OPRT_OK != rt) {
+                return rt;
+            }
+            __kv_log_index_put(log, ent->key, ent->key_len, __kv_log_seg_last(log)->id, off, ent->val_len);
+        }
+    }
+
+    // the copies must be on flash before the originals go
+    rt = __kv_log_sync(log);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+
+    __kv_log_path(log, id, path);
+    err = lfs_remove(log->lfs, path);
+    if (LFS_ERR_OK != err && LFS_ERR_NOENT != err) {
+        PR_ERR("kv log remove %s err %d", path, err);
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    log->seg_num--;
+    memmove(&log->segs[0], &log->segs[1], log->seg_num * sizeof(kv_log_seg_t));
+    log->compacts++;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET kv_log_compact(kv_log_t *log)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t rounds = 0;
+
+    if (NULL == log) {
+        return OPRT_INVALID_PARM;
+    }
+    if (log->batch) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
+    // live data may not fit in fewer segments, give up after one pass over them
+    rounds = log->seg_num;
+    while (rounds-- && kv_log_need_compact(log)) {
+        if (__kv_log_seg_last(log)->size >= KV_LOG_SEGMENT_SIZE && log->segs[0].live) {
+            rt = __kv_log_roll(log);
+            if (OPRT_OK != rt) {
+                break;
+            }
+        }
+        rt = __kv_log_compact_oldest(log);
+        if (OPRT_OK != rt) {
+            break;
+        }
+    }
+
+    return rt;
+}
+
+OPERATE_RET kv_log_stat_get(kv_log_t *log, kv_log_stat_t *stat)
+{
+    uint32_t i = 0;
+
+    if (NULL == log || NULL == stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+    memset(stat, 0, sizeof(kv_log_stat_t));
+    stat->keys = log->keys;
+    stat->segments = log->seg_num;
+    stat->syncs = log->syncs;
+    stat->compacts = log->compacts;
+    for (i = 0; i < log->seg_num; i++) {
+        stat->bytes += log->segs[i].size;
+        stat->live += log->segs[i].live;
+    }
+
+    return OPRT_OK;
+}
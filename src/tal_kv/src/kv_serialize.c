@@ -15,6 +15,12 @@
  * includes optimizations for memory usage and processing time, making it
  * suitable for resource-constrained environments.
  *
+ * kv_serialize_bin() writes the same database as a compact binary record
+ * instead: a header of magic, version and field count, then one TLV per
+ * field with a 16-bit ID hashed from the key, the type, a varint length and
+ * the value. Integers are zigzag varints, strings and raw data are stored
+ * as they are, without quotes or base64.
+ *
  * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
  *
  */
@@ -26,6 +32,12 @@
 #include "cJSON.h"
 #include "mix_method.h"
 
+#define KV_BIN_MAGIC   0xB5
+#define KV_BIN_VERSION 1
+#define KV_BIN_HDR_LEN 2
+
+#define KV_VARINT_MAX 5
+
 /**
  * Serializes the key-value pairs in the given database into a JSON-formatted
  * string.
@@ -275,3 +287,328 @@ ERR_EXIT:
 
     return op_ret;
 }
+
+/* 16-bit ID of a key, FNV-1a folded */
+static uint16_t __kv_bin_id(const char *key)
+{
+    uint32_t h = 2166136261u;
+
+    while (*key) {
+        h = (h ^ (uint8_t)*key++) * 16777619u;
+    }
+
+    return (uint16_t)((h >> 16) ^ h);
+}
+
+/* writes a varint when buf is not NULL, returns its length */
+static uint32_t __kv_varint_put(uint8_t *buf, uint32_t v)
+{
+    uint32_t n = 0;
+
+    do {
+        if (buf) {
+            buf[n] = (v & 0x7F) | ((v > 0x7F) ? 0x80 : 0);
+        }
+        v >>= 7;
+        n++;
+    } while (v);
+
+    return n;
+}
+
+/* reads a varint, returns its length or 0 when it is truncated */
+static uint32_t __kv_varint_get(const uint8_t *buf, uint32_t len, uint32_t *v)
+{
+    uint32_t n = 0, val = 0;
+
+    for (n = 0; n < len && n < KV_VARINT_MAX; n++) {
+        val |= (uint32_t)(buf[n] & 0x7F) << (7 * n);
+        if (0 == (buf[n] & 0x80)) {
+            *v = val;
+            return n + 1;
+        }
+    }
+
+    return 0;
+}
+
+static int32_t __kv_bin_int_get(const kv_db_t *db)
+{
+    switch (db->tp) {
+    case KV_CHAR:
+        return *((char *)(db->val));
+    case KV_BYTE:
+        return *((uint8_t *)(db->val));
+    case KV_SHORT:
+        return *((int16_t *)(db->val));
+    case KV_USHORT:
+        return *((uint16_t *)(db->val));
+    default:
+        return *((int32_t *)(db->val));
+    }
+}
+
+/* writes the record when buf is not NULL, returns its length */
+static uint32_t __kv_bin_put(const kv_db_t *db, const uint32_t dbcnt, uint8_t *buf)
+{
+    uint32_t i = 0, offset = 0, len = 0, zz = 0;
+    int32_t v = 0;
+
+    if (buf) {
+        buf[0] = KV_BIN_MAGIC;
+        buf[1] = KV_BIN_VERSION;
+    }
+    offset = KV_BIN_HDR_LEN;
+    offset += __kv_varint_put(buf ? buf + offset : NULL, dbcnt);
+
+    for (i = 0; i < dbcnt; i++) {
+        uint16_t id = __kv_bin_id(db[i].key);
+        if (buf) {
+            buf[offset] = id & 0xFF;
+            buf[offset + 1] = id >> 8;
+            buf[offset + 2] = db[i].tp;
+        }
+        offset += 3;
+
+        if (db[i].tp <= KV_INT) {
+            v = __kv_bin_int_get(&db[i]);
+            zz = ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+            len = __kv_varint_put(NULL, zz);
+            offset += __kv_varint_put(buf ? buf + offset : NULL, len);
+            offset += __kv_varint_put(buf ? buf + offset : NULL, zz);
+            continue;
+        }
+
+        if (db[i].tp == KV_BOOL) {
+            offset += __kv_varint_put(buf ? buf + offset : NULL, 1);
+            if (buf) {
+                buf[offset] = (FALSE == *((BOOL_T *)(db[i].val))) ? 0 : 1;
+            }
+            offset++;
+            continue;
+        }
+
+        len = (db[i].tp == KV_STRING) ? strlen((char *)db[i].val) : db[i].len;
+        offset += __kv_varint_put(buf ? buf + offset : NULL, len);
+        if (buf && len) {
+            memcpy(buf + offset, db[i].val, len);
+        }
+        offset += len;
+    }
+
+    return offset;
+}
+
+/**
+ * @brief Serializes the key-value pairs in the given database into a binary
+ * record.
+ *
+ * @param db The pointer to the database containing the key-value pairs.
+ * @param dbcnt The number of key-value pairs in the database.
+ * @param out The pointer to store the record, free it with tal_free().
+ * @param out_len The pointer to store the length of the record.
+ * @return Returns OPRT_OK if serialization is successful, otherwise returns an
+ * error code.
+ */
+int kv_serialize_bin(const kv_db_t *db, const uint32_t dbcnt, uint8_t **out, uint32_t *out_len)
+{
+    uint32_t i = 0, j = 0, len = 0;
+    uint32_t seen[8] = {0}; // low 8 bits of the IDs so far
+    uint16_t id = 0;
+    uint8_t *buf = NULL;
+
+    for (i = 0; i < dbcnt; i++) {
+        if (db[i].tp > KV_RAW) {
+            PR_ERR("type invalid %d", db[i].tp);
+            return OPRT_COM_ERROR;
+        }
+        id = __kv_bin_id(db[i].key);
+        if (0 == (seen[(id & 0xFF) >> 5] & (1u << (id & 0x1F)))) {
+            seen[(id & 0xFF) >> 5] |= 1u << (id & 0x1F);
+            continue;
+        }
+        for (j = 0; j < i; j++) {
+            if (id == __kv_bin_id(db[j].key)) {
+                PR_ERR("key %s and %s share an id", db[i].key, db[j].key);
+                return OPRT_COM_ERROR;
+            }
+        }
+    }
+
+    len = __kv_bin_put(db, dbcnt, NULL);
+    buf = tal_malloc(len);
+    if (NULL == buf) {
+        PR_ERR("maloc fails %d", len);
+        return OPRT_MALLOC_FAILED;
+    }
+    __kv_bin_put(db, dbcnt, buf);
+
+    *out = buf;
+    *out_len = len;
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Checks whether a stored record was written by kv_serialize_bin().
+ *
+ * @param[in] in The record.
+ * @param[in] len The length of the record.
+ * @return TRUE for a binary record, FALSE for JSON.
+ */
+BOOL_T kv_serialize_is_bin(const uint8_t *in, uint32_t len)
+{
+    return (len >= KV_BIN_HDR_LEN && KV_BIN_MAGIC == in[0]) ? TRUE : FALSE;
+}
+
+/* finds the TLV of an ID, returns the value offset or 0 when it is missing */
+static uint32_t __kv_bin_find(const uint8_t *in, uint32_t len, uint16_t id, uint8_t *tp, uint32_t *vlen)
+{
+    uint32_t offset = KV_BIN_HDR_LEN, cnt = 0, n = 0, l = 0;
+
+    n = __kv_varint_get(in + offset, len - offset, &cnt);
+    if (0 == n) {
+        return 0;
+    }
+    offset += n;
+
+    while (cnt-- && offset + 3 < len) {
+        uint16_t tid = in[offset] | (in[offset + 1] << 8);
+        uint8_t ttp = in[offset + 2];
+        offset += 3;
+
+        n = __kv_varint_get(in + offset, len - offset, &l);
+        if (0 == n || l > len - offset - n) {
+            return 0;
+        }
+        offset += n;
+
+        if (tid == id) {
+            *tp = ttp;
+            *vlen = l;
+            return offset;
+        }
+        offset += l;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Deserializes a record of kv_serialize_bin() into a key-value
+ * database. Fields missing in the record are set to zero.
+ *
+ * @param[in] in The record.
+ * @param[in] len The length of the record.
+ * @param[in,out] db The key-value database to populate.
+ * @param[in] dbcnt The number of elements in the key-value database.
+ * @return Returns OPRT_OK if the deserialization is successful. Otherwise, it
+ * returns an error code indicating the failure reason.
+ */
+int kv_deserialize_bin(const uint8_t *in, uint32_t len, kv_db_t *db, const uint32_t dbcnt)
+{
+    int op_ret = OPRT_OK;
+    uint32_t i = 0, offset = 0, vlen = 0, zz = 0;
+    uint8_t tp = 0;
+    int32_t v = 0;
+
+    if (!kv_serialize_is_bin(in, len) || KV_BIN_VERSION != in[1]) {
+        PR_ERR("record version %d invalid", (len >= KV_BIN_HDR_LEN) ? in[1] : -1);
+        return OPRT_COM_ERROR;
+    }
+
+    for (i = 0; i < dbcnt; i++) {
+        offset = __kv_bin_find(in, len, __kv_bin_id(db[i].key), &tp, &vlen);
+        if (0 == offset) { // default set zero
+            memset(db[i].val, 0, db[i].len);
+            continue;
+        }
+        if ((db[i].tp <= KV_INT && tp > KV_INT) || (db[i].tp > KV_INT && tp != db[i].tp)) {
+            op_ret = OPRT_COM_ERROR;
+            goto ERR_EXIT;
+        }
+
+        if (db[i].tp <= KV_INT) {
+            if (0 == __kv_varint_get(in + offset, vlen, &zz)) {
+                op_ret = OPRT_COM_ERROR;
+                goto ERR_EXIT;
+            }
+            v = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+        }
+
+        switch (db[i].tp) {
+        case KV_CHAR: {
+            if (v < -128 || v > 127) {
+                op_ret = OPRT_COM_ERROR;
+                goto ERR_EXIT;
+            }
+            *((char *)db[i].val) = v;
+        } break;
+
+        case KV_BYTE: {
+            if (v < 0 || v > 255) {
+                op_ret = OPRT_COM_ERROR;
+                goto ERR_EXIT;
+            }
+            *((uint8_t *)db[i].val) = v;
+        } break;
+
+        case KV_SHORT: {
+            if (v < -32768 || v > 32767) {
+                op_ret = OPRT_COM_ERROR;
+                goto ERR_EXIT;
+            }
+            *((int16_t *)db[i].val) = v;
+        } break;
+
+        case KV_USHORT: {
+            if (v < 0 || v > 65535) {
+                op_ret = OPRT_COM_ERROR;
+                goto ERR_EXIT;
+            }
+            *((uint16_t *)db[i].val) = v;
+        } break;
+
+        case KV_INT: {
+            *((int *)db[i].val) = v;
+        } break;
+
+        case KV_BOOL: {
+            *((BOOL_T *)db[i].val) = (vlen && in[offset]) ? 1 : 0;
+        } break;
+
+        case KV_STRING: {
+            if (db[i].len < vlen + 1) {
+                op_ret = OPRT_COM_ERROR;
+                goto ERR_EXIT;
+            }
+            memcpy(db[i].val, in + offset, vlen);
+            ((char *)db[i].val)[vlen] = 0;
+        } break;
+
+        case KV_RAW: {
+            if (db[i].len < vlen) {
+                op_ret = OPRT_COM_ERROR;
+                goto ERR_EXIT;
+            }
+            memcpy(db[i].val, in + offset, vlen);
+            if (0 == vlen) {
+                db[i].len = 0;
+            }
+        } break;
+
+        default: {
+            PR_ERR("type invalid %d", db[i].tp);
+            op_ret = OPRT_COM_ERROR;
+            goto ERR_EXIT;
+        }
+        }
+    }
+
+    return OPRT_OK;
+
+ERR_EXIT:
+    PR_ERR("deserial fails %d", op_ret);
+
+    return op_ret;
+}
@@ -29,15 +29,61 @@
 #include "tkl_flash.h"
 #include "tal_api.h"
 #include "tal_security.h"
+#include "tkl_thread.h"
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+#include "kv_log.h"
+
+#define KV_LOG_DIR "kvlog"
+#endif
 
 // variables used by the filesystem
 static lfs_t lfs;
 static lfs_size_t lfs_flash_addr;
 static tal_kv_cfg_t lfs_kv_cfg;
 static MUTEX_HANDLE lfs_mutex;
+static TKL_THREAD_HANDLE lfs_batch_owner;
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+/* a key deleted inside a batch, its own file is removed at the commit */
+typedef struct kv_del_pending {
+    struct kv_del_pending *next;
+    char key[0];
+} kv_del_pending_t;
+
+static kv_log_t *lfs_kv_log;
+static BOOL_T lfs_kv_compact_pending;
+static kv_del_pending_t *lfs_kv_del_pending;
+#endif
+
+#ifndef KV_CACHE_SIZE
+#define KV_CACHE_SIZE 1024
+#endif
+
+/* a decrypted value, shared by the cache and the views of tal_kv_get_ref() */
+typedef struct kv_cache_ent {
+    struct kv_cache_ent *prev; // LRU list, the head is the most recent
+    struct kv_cache_ent *next;
+    uint32_t ref;
+    BOOL_T cached;
+    char *key;
+    size_t len;
+    uint8_t value[1]; // len + 1 bytes, then the key
+} kv_cache_ent_t;
+
+typedef struct {
+    kv_cache_ent_t *head;
+    kv_cache_ent_t *tail;
+    uint32_t bytes;
+    uint32_t gen; // bumped by every set and delete
+    tal_kv_cache_stat_t stat;
+} kv_cache_t;
+
+static kv_cache_t lfs_kv_cache;
 
 extern int kv_serialize(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len);
 extern int kv_deserialize(const char *in, kv_db_t *db, const uint32_t dbcnt);
+extern int kv_serialize_bin(const kv_db_t *db, const uint32_t dbcnt, uint8_t **out, uint32_t *out_len);
+extern int kv_deserialize_bin(const uint8_t *in, uint32_t len, kv_db_t *db, const uint32_t dbcnt);
+extern BOOL_T kv_serialize_is_bin(const uint8_t *in, uint32_t len);
 
 /**
  * Reads data from a user-provided block device.
@@ -178,9 +224,367 @@ int tal_kv_init(tal_kv_cfg_t *kv_cfg)
         err = lfs_mount(&lfs, &lfs_cfg);
     }
 
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+    if (LFS_ERR_OK == err) {
+        err = kv_log_open(&lfs, KV_LOG_DIR, &lfs_kv_log);
+        if (OPRT_OK != err) {
+            PR_ERR("kv log open fail %d", err);
+        }
+    }
+#endif
+
     return err;
 }
 
+/* the lock is already held by the thread inside tal_kv_batch_begin() */
+static BOOL_T __kv_batch_owned(void)
+{
+    TKL_THREAD_HANDLE self = NULL;
+
+    if (NULL == lfs_batch_owner) {
+        return FALSE;
+    }
+    tkl_thread_get_id(&self);
+
+    return (self == lfs_batch_owner) ? TRUE : FALSE;
+}
+
+static void __kv_lock(void)
+{
+    if (!__kv_batch_owned()) {
+        tal_mutex_lock(lfs_mutex);
+    }
+}
+
+static void __kv_unlock(void)
+{
+    if (!__kv_batch_owned()) {
+        tal_mutex_unlock(lfs_mutex);
+    }
+}
+
+#if !defined(ENABLE_KV_LOG) || (ENABLE_KV_LOG == 0)
+/* writes the encrypted value to the file named by the key */
+static int __kv_file_write(const char *key, const uint8_t *ec_data, uint32_t ec_len)
+{
+    int result;
+    lfs_file_t file;
+
+    result = lfs_file_open(&lfs, &file, key, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
+    if (LFS_ERR_OK != result) {
+        PR_ERR("lfs open %s err", key);
+        return result;
+    }
+    lfs_file_rewind(&lfs, &file);
+    result = lfs_file_write(&lfs, &file, ec_data, ec_len);
+    lfs_file_close(&lfs, &file);
+    if (result != ec_len) {
+        PR_ERR("kv write fail %d", result);
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    return OPRT_OK;
+}
+#endif
+
+/* reads the encrypted value from the file named by the key */
+static int __kv_file_read(const char *key, uint8_t **ec_data, uint32_t *ec_len)
+{
+    int result;
+    lfs_file_t file;
+    uint8_t *data = NULL;
+    uint32_t len = 0;
+
+    result = lfs_file_open(&lfs, &file, key, LFS_O_RDONLY);
+    if (LFS_ERR_OK != result) {
+        PR_ERR("lfs open %s %d err", key, result);
+        return result;
+    }
+    len = lfs_file_size(&lfs, &file);
+
+    data = tal_malloc(len + 1);
+    if (NULL == data) {
+        lfs_file_close(&lfs, &file);
+        return OPRT_MALLOC_FAILED;
+    }
+    PR_DEBUG("key:%s, len:%d", key, len);
+    result = lfs_file_read(&lfs, &file, data, len);
+    lfs_file_close(&lfs, &file);
+    if (result <= 0) {
+        tal_free(data);
+        PR_ERR("kv read error %d", result);
+        return OPRT_KVS_RD_FAIL;
+    }
+    *ec_data = data;
+    *ec_len = len;
+
+    return OPRT_OK;
+}
+
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+static void __kv_log_compact_cb(void *data)
+{
+    tal_mutex_lock(lfs_mutex);
+    kv_log_compact(lfs_kv_log);
+    lfs_kv_compact_pending = FALSE;
+    tal_mutex_unlock(lfs_mutex);
+}
+
+/* reclaims old segments in the system work queue, called with the lock held */
+static void __kv_log_compact_check(void)
+{
+    if (lfs_kv_compact_pending || NULL != lfs_batch_owner || !kv_log_need_compact(lfs_kv_log)) {
+        return;
+    }
+
+    lfs_kv_compact_pending = TRUE;
+    if (OPRT_OK != tal_workq_schedule(WORKQ_SYSTEM, __kv_log_compact_cb, NULL)) {
+        // the work queue is not up during early init
+        kv_log_compact(lfs_kv_log);
+        lfs_kv_compact_pending = FALSE;
+    }
+}
+
+static BOOL_T __kv_del_pending_find(const char *key)
+{
+    kv_del_pending_t *ent = lfs_kv_del_pending;
+
+    for (; ent; ent = ent->next) {
+        if (0 == strcmp(ent->key, key)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static int __kv_del_pending_add(const char *key)
+{
+    kv_del_pending_t *ent = tal_malloc(sizeof(kv_del_pending_t) + strlen(key) + 1);
+    if (NULL == ent) {
+        return OPRT_MALLOC_FAILED;
+    }
+    strcpy(ent->key, key);
+    ent->next = lfs_kv_del_pending;
+    lfs_kv_del_pending = ent;
+
+    return OPRT_OK;
+}
+
+/* ends the deletes of a batch, the files are only removed once the batch is committed */
+static void __kv_del_pending_flush(BOOL_T committed)
+{
+    kv_del_pending_t *ent = NULL;
+
+    while (lfs_kv_del_pending) {
+        ent = lfs_kv_del_pending;
+        lfs_kv_del_pending = ent->next;
+        if (committed) {
+            lfs_remove(&lfs, ent->key);
+        }
+        tal_free(ent);
+    }
+}
+
+/* reads a key from the log, a key still in its own file is moved into the log */
+static int __kv_log_read(const char *key, uint8_t **ec_data, uint32_t *ec_len)
+{
+    int result;
+    size_t len = 0;
+
+    result = kv_log_get(lfs_kv_log, key, ec_data, &len);
+    if (OPRT_NOT_FOUND != result) {
+        *ec_len = len;
+        return result;
+    }
+    if (NULL != lfs_batch_owner && __kv_del_pending_find(key)) {
+        // deleted in this batch, the file is still there until the commit
+        return LFS_ERR_NOENT;
+    }
+
+    result = __kv_file_read(key, ec_data, ec_len);
+    if (OPRT_OK != result || NULL != lfs_batch_owner) {
+        // the file is kept until a synced copy is in the log
+        return result;
+    }
+    if (OPRT_OK == kv_log_set(lfs_kv_log, key, *ec_data, *ec_len)) {
+        PR_DEBUG("key %s moved to kv log", key);
+        lfs_remove(&lfs, key);
+        __kv_log_compact_check();
+    }
+
+    return OPRT_OK;
+}
+#endif
+
+#define KV_CACHE_ENT_COST(ent) (sizeof(kv_cache_ent_t) + (ent)->len + strlen((ent)->key) + 1)
+
+static void __kv_cache_unlink(kv_cache_ent_t *ent)
+{
+    if (ent->prev) {
+        ent->prev->next = ent->next;
+    } else {
+        lfs_kv_cache.head = ent->next;
+    }
+    if (ent->next) {
+        ent->next->prev = ent->prev;
+    } else {
+        lfs_kv_cache.tail = ent->prev;
+    }
+    ent->prev = ent->next = NULL;
+}
+
+static void __kv_cache_push(kv_cache_ent_t *ent)
+{
+    ent->prev = NULL;
+    ent->next = lfs_kv_cache.head;
+    if (lfs_kv_cache.head) {
+        lfs_kv_cache.head->prev = ent;
+    } else {
+        lfs_kv_cache.tail = ent;
+    }
+    lfs_kv_cache.head = ent;
+}
+
+/* drops one reference, called with the lock held */
+static void __kv_cache_put(kv_cache_ent_t *ent)
+{
+    if (0 == --ent->ref) {
+        tal_free(ent);
+    }
+}
+
+/* takes the entry out of the cache, views keep it alive */
+static void __kv_cache_remove(kv_cache_ent_t *ent)
+{
+    __kv_cache_unlink(ent);
+    ent->cached = FALSE;
+    lfs_kv_cache.bytes -= KV_CACHE_ENT_COST(ent);
+    lfs_kv_cache.stat.entries--;
+    __kv_cache_put(ent);
+}
+
+static kv_cache_ent_t *__kv_cache_find(const char *key)
+{
+    kv_cache_ent_t *ent = NULL;
+
+    for (ent = lfs_kv_cache.head; ent; ent = ent->next) {
+        if (0 == strcmp(ent->key, key)) {
+            break;
+        }
+    }
+
+    return ent;
+}
+
+/* called with the lock held after the value of a key changed in flash */
+static void __kv_cache_invalidate(const char *key)
+{
+    kv_cache_ent_t *ent = __kv_cache_find(key);
+
+    lfs_kv_cache.gen++;
+    if (ent) {
+        __kv_cache_remove(ent);
+    }
+}
+
+/* reads and decrypts the value of a key */
+static int __kv_value_load(const char *key, uint8_t **value, size_t *length)
+{
+    int result;
+    uint8_t *ec_data = NULL;
+    uint32_t ec_len = 0;
+
+    __kv_lock();
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+    result = __kv_log_read(key, &ec_data, &ec_len);
+#else
+    result = __kv_file_read(key, &ec_data, &ec_len);
+#endif
+    __kv_unlock();
+    if (OPRT_OK != result) {
+        return result;
+    }
+
+    uint8_t *dec_data = NULL;
+    uint32_t dec_len = 0;
+    uint8_t iv[16];
+
+    memcpy(iv, lfs_kv_cfg.seed, 16);
+    result = tal_aes128_cbc_decode(ec_data, ec_len, (uint8_t *)lfs_kv_cfg.key, iv, &dec_data, (uint32_t *)&dec_len);
+    dec_len = tal_aes_get_actual_length(dec_data, dec_len);
+    tal_free(ec_data);
+    if (OPRT_OK != result || dec_len > ec_len) {
+        PR_ERR("key %s decrypt failed %d, %d-%d", key, result, dec_len, ec_len);
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+    *value = dec_data;
+    *length = (size_t)dec_len;
+    dec_data[dec_len] = 0;
+
+    return OPRT_OK;
+}
+
+/* returns the value of a key with one reference taken, from the cache or from flash */
+static int __kv_cache_get(const char *key, kv_cache_ent_t **out)
+{
+    int result;
+    kv_cache_ent_t *ent = NULL;
+    uint8_t *value = NULL;
+    size_t length = 0;
+    uint32_t gen = 0;
+
+    __kv_lock();
+    ent = __kv_cache_find(key);
+    if (ent) {
+        __kv_cache_unlink(ent);
+        __kv_cache_push(ent);
+        ent->ref++;
+        lfs_kv_cache.stat.hits++;
+        __kv_unlock();
+        *out = ent;
+        return OPRT_OK;
+    }
+    lfs_kv_cache.stat.misses++;
+    gen = lfs_kv_cache.gen;
+    __kv_unlock();
+
+    result = __kv_value_load(key, &value, &length);
+    if (OPRT_OK != result) {
+        return result;
+    }
+
+    ent = tal_malloc(sizeof(kv_cache_ent_t) + length + strlen(key) + 1);
+    if (NULL == ent) {
+        tal_free(value);
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(ent, 0, sizeof(kv_cache_ent_t));
+    ent->ref = 1;
+    ent->len = length;
+    memcpy(ent->value, value, length + 1);
+    ent->key = (char *)&ent->value[length + 1];
+    strcpy(ent->key, key);
+    tal_free(value);
+
+    __kv_lock();
+    // a value written while this one was read from flash is newer
+    if (gen == lfs_kv_cache.gen && NULL == __kv_cache_find(key) && KV_CACHE_ENT_COST(ent) <= KV_CACHE_SIZE / 2) {
+        while (lfs_kv_cache.tail && lfs_kv_cache.bytes + KV_CACHE_ENT_COST(ent) > KV_CACHE_SIZE) {
+            __kv_cache_remove(lfs_kv_cache.tail);
+            lfs_kv_cache.stat.evictions++;
+        }
+        ent->ref++;
+        ent->cached = TRUE;
+        __kv_cache_push(ent);
+        lfs_kv_cache.bytes += KV_CACHE_ENT_COST(ent);
+        lfs_kv_cache.stat.entries++;
+    }
+    __kv_unlock();
+    *out = ent;
+
+    return OPRT_OK;
+}
+
 /**
  * @brief Sets a key-value pair in the key-value store.
  *
@@ -197,7 +601,6 @@ int tal_kv_init(tal_kv_cfg_t *kv_cfg)
 int tal_kv_set(const char *key, const uint8_t *value, size_t length)
 {
     int result;
-    lfs_file_t file;
 
     PR_DEBUG("key:%s, len %d", key, length);
 
@@ -205,13 +608,6 @@ int tal_kv_set(const char *key, const uint8_t *value, size_t length)
         return OPRT_INVALID_PARM;
     }
 
-    tal_mutex_lock(lfs_mutex);
-    result = lfs_file_open(&lfs, &file, key, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
-    if (LFS_ERR_OK != result) {
-        tal_mutex_unlock(lfs_mutex);
-        PR_ERR("lfs open %s err", key);
-        return result;
-    }
     uint8_t *ec_data = NULL;
     uint32_t ec_len = 0;
     uint8_t iv[16];
@@ -220,22 +616,30 @@ int tal_kv_set(const char *key, const uint8_t *value, size_t length)
     result =
         tal_aes128_cbc_encode((uint8_t *)value, length, (uint8_t *)lfs_kv_cfg.key, iv, &ec_data, (uint32_t *)&ec_len);
     if (OPRT_OK != result) {
-        lfs_file_close(&lfs, &file);
-        tal_mutex_unlock(lfs_mutex);
         PR_DEBUG("key %s encrypt failed", key);
         return result;
     }
-    lfs_file_rewind(&lfs, &file);
-    result = lfs_file_write(&lfs, &file, ec_data, ec_len);
-    lfs_file_close(&lfs, &file);
-    tal_aes_free_data(ec_data);
-    tal_mutex_unlock(lfs_mutex);
-    if (result != ec_len) {
-        PR_ERR("kv write fail %d", result);
-        return OPRT_KVS_WR_FAIL;
+
+    __kv_lock();
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+    result = kv_log_set(lfs_kv_log, key, ec_data, ec_len);
+    if (OPRT_OK == result && NULL == lfs_batch_owner) {
+        // an older value may still sit in its own file, inside a batch it is
+        // kept as the value to fall back to and stays hidden behind the log
+        lfs_remove(&lfs, key);
+        __kv_log_compact_check();
+    } else if (OPRT_OK != result) {
+        PR_ERR("kv log set %s fail %d", key, result);
     }
+#else
+    result = __kv_file_write(key, ec_data, ec_len);
+#endif
+    // a failed write may have truncated the old value too
+    __kv_cache_invalidate(key);
+    __kv_unlock();
+    tal_aes_free_data(ec_data);
 
-    return OPRT_OK;
+    return result;
 }
 
 /**
@@ -256,54 +660,110 @@ int tal_kv_set(const char *key, const uint8_t *value, size_t length)
  */
 int tal_kv_get(const char *key, uint8_t **value, size_t *length)
 {
-    int result;
-    lfs_file_t file;
-
     if (NULL == key || NULL == value || NULL == length) {
         return OPRT_INVALID_PARM;
     }
 
-    tal_mutex_lock(lfs_mutex);
-    result = lfs_file_open(&lfs, &file, key, LFS_O_RDONLY);
-    if (LFS_ERR_OK != result) {
-        PR_ERR("lfs open %s %d err", key, result);
-        tal_mutex_unlock(lfs_mutex);
+#if (KV_CACHE_SIZE > 0)
+    int result;
+    kv_cache_ent_t *ent = NULL;
+
+    result = __kv_cache_get(key, &ent);
+    if (OPRT_OK != result) {
+        *length = 0;
         return result;
     }
-    uint8_t *ec_data = NULL;
-    uint32_t ec_len = lfs_file_size(&lfs, &file);
 
-    ec_data = tal_malloc(ec_len + 1);
-    if (NULL == ec_data) {
+    uint8_t *data = tal_malloc(ent->len + 1);
+    if (data) {
+        memcpy(data, ent->value, ent->len + 1);
+        *value = data;
+        *length = ent->len;
+    } else {
         result = OPRT_MALLOC_FAILED;
-        tal_mutex_unlock(lfs_mutex);
-        return result;
     }
-    PR_DEBUG("key:%s, len:%d", key, ec_len);
-    result = lfs_file_read(&lfs, &file, ec_data, ec_len);
-    lfs_file_close(&lfs, &file);
-    tal_mutex_unlock(lfs_mutex);
-    if (result <= 0) {
+    __kv_lock();
+    __kv_cache_put(ent);
+    __kv_unlock();
+
+    return result;
+#else
+    int result = __kv_value_load(key, value, length);
+    if (OPRT_OK != result) {
         *length = 0;
-        tal_free(ec_data);
-        PR_ERR("kv read error %d", result);
-        return OPRT_KVS_RD_FAIL;
     }
-    uint8_t *dec_data = NULL;
-    uint32_t dec_len = 0;
-    uint8_t iv[16];
 
-    memcpy(iv, lfs_kv_cfg.seed, 16);
-    result = tal_aes128_cbc_decode(ec_data, ec_len, (uint8_t *)lfs_kv_cfg.key, iv, &dec_data, (uint32_t *)&dec_len);
-    dec_len = tal_aes_get_actual_length(dec_data, dec_len);
-    tal_free(ec_data);
-    if (OPRT_OK != result || dec_len > ec_len) {
-        PR_ERR("key %s decrypt failed %d, %d-%d", key, result, dec_len, ec_len);
-        return OPRT_BUFFER_NOT_ENOUGH;
+    return result;
+#endif
+}
+
+/**
+ * @brief Retrieves a read-only view of the value of a key, shared with the
+ * value cache instead of copied.
+ *
+ * @param key The key to retrieve the value for.
+ * @param value A pointer that will point to the value, '\0' terminated.
+ * @param length A pointer to a variable that will store the length of the
+ * value.
+ *
+ * @return 0 if the value was successfully retrieved, or a negative error code
+ * if an error occurred.
+ */
+int tal_kv_get_ref(const char *key, const uint8_t **value, size_t *length)
+{
+    int result;
+    kv_cache_ent_t *ent = NULL;
+
+    if (NULL == key || NULL == value || NULL == length) {
+        return OPRT_INVALID_PARM;
     }
-    *value = dec_data;
-    *length = (size_t)dec_len;
-    dec_data[dec_len] = 0;
+
+    result = __kv_cache_get(key, &ent);
+    if (OPRT_OK != result) {
+        *length = 0;
+        return result;
+    }
+    *value = ent->value;
+    *length = ent->len;
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Releases a view returned by tal_kv_get_ref().
+ *
+ * @param value The value returned by tal_kv_get_ref().
+ * @return 0 on success, or a negative error code if an error occurred.
+ */
+int tal_kv_put_ref(const uint8_t *value)
+{
+    if (NULL == value) {
+        return OPRT_INVALID_PARM;
+    }
+
+    __kv_lock();
+    __kv_cache_put((kv_cache_ent_t *)(value - offsetof(kv_cache_ent_t, value)));
+    __kv_unlock();
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Reads the counters of the value cache.
+ *
+ * @param stat A pointer to the structure that will store the counters.
+ * @return 0 on success, or a negative error code if an error occurred.
+ */
+int tal_kv_cache_stat_get(tal_kv_cache_stat_t *stat)
+{
+    if (NULL == stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+    __kv_lock();
+    *stat = lfs_kv_cache.stat;
+    stat->bytes = lfs_kv_cache.bytes;
+    __kv_unlock();
 
     return OPRT_OK;
 }
@@ -321,9 +781,30 @@ int tal_kv_del(const char *key)
 {
     PR_DEBUG("key:%s", key);
 
-    tal_mutex_lock(lfs_mutex);
+    __kv_lock();
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+    int result = LFS_ERR_NOENT;
+    struct lfs_info info;
+
+    if (NULL == lfs_batch_owner) {
+        result = lfs_remove(&lfs, key);
+    } else if (!__kv_del_pending_find(key) && LFS_ERR_OK == lfs_stat(&lfs, key, &info)) {
+        // inside a batch the file is only hidden, a batch that is not committed keeps it
+        if (OPRT_OK != __kv_del_pending_add(key)) {
+            __kv_unlock();
+            return OPRT_MALLOC_FAILED;
+        }
+        result = LFS_ERR_OK;
+    }
+    if (OPRT_OK == kv_log_del(lfs_kv_log, key)) {
+        result = LFS_ERR_OK;
+        __kv_log_compact_check();
+    }
+#else
     int result = lfs_remove(&lfs, key);
-    tal_mutex_unlock(lfs_mutex);
+#endif
+    __kv_cache_invalidate(key);
+    __kv_unlock();
     if (LFS_ERR_OK == result) {
         PR_DEBUG("Deleted successfully");
         return OPRT_OK;
@@ -334,6 +815,60 @@ int tal_kv_del(const char *key)
     return OPRT_COM_ERROR;
 }
 
+/**
+ * @brief Starts a batch of tal_kv_set() and tal_kv_del() calls.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+int tal_kv_batch_begin(void)
+{
+    TKL_THREAD_HANDLE self = NULL;
+
+    if (__kv_batch_owned()) {
+        return OPRT_COM_ERROR;
+    }
+
+    tal_mutex_lock(lfs_mutex);
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+    int result = kv_log_batch_begin(lfs_kv_log);
+    if (OPRT_OK != result) {
+        tal_mutex_unlock(lfs_mutex);
+        return result;
+    }
+#endif
+    tkl_thread_get_id(&self);
+    lfs_batch_owner = self;
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Ends the batch started by tal_kv_batch_begin().
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+int tal_kv_batch_commit(void)
+{
+    int result = OPRT_OK;
+
+    if (!__kv_batch_owned()) {
+        return OPRT_COM_ERROR;
+    }
+
+    lfs_batch_owner = NULL;
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+    result = kv_log_batch_commit(lfs_kv_log);
+    if (OPRT_OK != result) {
+        PR_ERR("kv log commit fail %d", result);
+    }
+    __kv_del_pending_flush(OPRT_OK == result);
+    __kv_log_compact_check();
+#endif
+    tal_mutex_unlock(lfs_mutex);
+
+    return result;
+}
+
 /**
  * @brief Frees the memory allocated for a value in the TAL Key-Value store.
  *
@@ -365,6 +900,14 @@ int tal_kv_free(uint8_t *value)
  */
 void tal_kv_cmd(int argc, char *argv[])
 {
+    if (argc == 2 && 0 == strcmp("cache", argv[1])) {
+        tal_kv_cache_stat_t stat;
+        tal_kv_cache_stat_get(&stat);
+        PR_DEBUG("kv cache hits %d, misses %d, evictions %d, entries %d, bytes %d/%d", stat.hits, stat.misses,
+                 stat.evictions, stat.entries, stat.bytes, KV_CACHE_SIZE);
+        return;
+    }
+
     if (argc < 3) {
         return;
     }
@@ -405,6 +948,22 @@ void tal_kv_cmd(int argc, char *argv[])
  * error code.
  */
 int tal_kv_serialize_set(const char *key, kv_db_t *db, size_t dbcnt)
+{
+    return tal_kv_serialize_set_fmt(key, db, dbcnt, KV_SERIALIZE_JSON);
+}
+
+/**
+ * @brief Serializes key-value data in the given format and sets it using the
+ * specified key.
+ *
+ * @param key The key to set the serialized data.
+ * @param db Pointer to the key-value database.
+ * @param dbcnt The number of key-value pairs in the database.
+ * @param fmt The format of the stored record.
+ * @return Returns OPRT_OK if the operation is successful, otherwise returns an
+ * error code.
+ */
+int tal_kv_serialize_set_fmt(const char *key, kv_db_t *db, size_t dbcnt, KV_SERIALIZE_FMT_E fmt)
 {
     if (NULL == db || 0 == dbcnt) {
         return OPRT_INVALID_PARM;
@@ -414,12 +973,16 @@ int tal_kv_serialize_set(const char *key, kv_db_t *db, size_t dbcnt)
     uint32_t len = 0;
     int ret = OPRT_OK;
 
-    ret = kv_serialize(db, dbcnt, &buf, &len);
+    if (KV_SERIALIZE_BIN == fmt) {
+        ret = kv_serialize_bin(db, dbcnt, (uint8_t **)&buf, &len);
+    } else {
+        ret = kv_serialize(db, dbcnt, &buf, &len);
+    }
     if (OPRT_OK != ret) {
         PR_ERR("kv_serialize  fail. %d", ret);
         return ret;
     }
-    PR_TRACE("write buf:%s", buf);
+    PR_TRACE("write %s len:%d", key, len);
     ret = tal_kv_set(key, (const uint8_t *)buf, len);
     tal_free(buf);
     if (OPRT_OK != ret) {
@@ -429,6 +992,33 @@ int tal_kv_serialize_set(const char *key, kv_db_t *db, size_t dbcnt)
     return ret;
 }
 
+/* reads a record in either format, returns the format it was stored in */
+static int __kv_serialize_read(const char *key, kv_db_t *db, size_t dbcnt, KV_SERIALIZE_FMT_E *stored)
+{
+    const uint8_t *buf = NULL;
+    size_t len = 0;
+    int ret = OPRT_OK;
+
+    ret = tal_kv_get_ref(key, &buf, &len);
+    if (OPRT_OK != ret) {
+        PR_ERR("kv_get fails %s %d", key, ret);
+        return ret;
+    }
+    if (kv_serialize_is_bin(buf, len)) {
+        *stored = KV_SERIALIZE_BIN;
+        ret = kv_deserialize_bin(buf, len, db, dbcnt);
+    } else {
+        *stored = KV_SERIALIZE_JSON;
+        ret = kv_deserialize((const char *)buf, db, dbcnt);
+    }
+    tal_kv_put_ref(buf);
+    if (OPRT_OK != ret) {
+        PR_ERR("kv_deserialize fail. %d", ret);
+    }
+
+    return ret;
+}
+
 /**
  * @brief Serializes and retrieves the value associated with a given key from
  * the key-value database.
@@ -445,23 +1035,40 @@ int tal_kv_serialize_set(const char *key, kv_db_t *db, size_t dbcnt)
  */
 int tal_kv_serialize_get(const char *key, kv_db_t *db, size_t dbcnt)
 {
+    KV_SERIALIZE_FMT_E stored = KV_SERIALIZE_JSON;
+
     if (NULL == db || 0 == dbcnt || NULL == key) {
         return OPRT_INVALID_PARM;
     }
 
-    uint8_t *buf = NULL;
-    size_t len = 0;
+    return __kv_serialize_read(key, db, dbcnt, &stored);
+}
+
+/**
+ * @brief Retrieves and deserializes a record stored in either format, and
+ * rewrites it in the given format if it was stored in the other one.
+ *
+ * @param key The key for which to retrieve the value.
+ * @param db Pointer to the array where the deserialized value will be stored.
+ * @param dbcnt The size of the `db` array.
+ * @param fmt The format the record is kept in.
+ * @return Returns `OPRT_INVALID_PARM` if any of the input parameters are
+ * invalid, or an error code indicating the success or failure of the operation.
+ */
+int tal_kv_serialize_get_fmt(const char *key, kv_db_t *db, size_t dbcnt, KV_SERIALIZE_FMT_E fmt)
+{
+    KV_SERIALIZE_FMT_E stored = KV_SERIALIZE_JSON;
     int ret = OPRT_OK;
 
-    ret = tal_kv_get(key, &buf, &len);
-    if (OPRT_OK != ret) {
-        PR_ERR("kv_get fails %s %d", key, ret);
-        return ret;
+    if (NULL == db || 0 == dbcnt || NULL == key) {
+        return OPRT_INVALID_PARM;
     }
-    ret = kv_deserialize((char *)buf, db, dbcnt);
-    tal_free(buf);
-    if (OPRT_OK != ret) {
-        PR_ERR("kv_deserialize fail. %d", ret);
+
+    ret = __kv_serialize_read(key, db, dbcnt, &stored);
+    if (OPRT_OK == ret && stored != fmt) {
+        // the values were read, a failed rewrite only keeps the old format
+        PR_DEBUG("kv %s migrate to format %d", key, fmt);
+        tal_kv_serialize_set_fmt(key, db, dbcnt, fmt);
     }
 
     return ret;
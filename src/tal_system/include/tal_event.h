@@ -77,6 +77,12 @@ typedef struct {
  */
 typedef int (*EVENT_SUBSCRIBE_CB)(void *data);
 
+/**
+ * @brief number of hash buckets of the event names
+ *
+ */
+#define EVENT_HASH_NUM (32)
+
 /**
  * @brief the subscirbe node
  *
@@ -87,20 +93,46 @@ typedef struct {
     SUBSCRIBE_TYPE_E type;             // the subscribe type
     EVENT_SUBSCRIBE_CB cb;             // the subscribe callback function
     struct tuya_list_head node;        // list node, used to attch to the event node
+    uint32_t run_cnt;                  // callback calls
+    uint32_t run_ms_max;               // longest callback call
+    uint32_t run_ms_total;             // time spent in the callback
 } SUBSCRIBE_NODE_T;
 
+/**
+ * @brief the publish counters of an event
+ *
+ */
+typedef struct {
+    uint32_t publish_cnt;      // tal_event_publish() calls
+    uint32_t publish_ms_max;   // longest tal_event_publish() call
+    uint32_t publish_ms_total; // time spent in tal_event_publish()
+    uint32_t async_cnt;        // tal_event_publish_async() calls
+    uint32_t queue_ms_max;     // longest wait of an async publish for its dispatch
+    uint32_t queue_ms_total;   // time async publishes waited for their dispatch
+} EVENT_STAT_T;
+
 /**
  * @brief the event node
  *
  */
 typedef struct {
     MUTEX_HANDLE mutex; // mutex, protection the event publish and subscribe
-
     char name[EVENT_NAME_MAX_LEN + 1];    // name, the event name
     struct tuya_list_head node;           // list node, used to attach to the event manage module
     struct tuya_list_head subscribe_root; // subscibe root, used to manage the subscriber
+    struct tuya_list_head hash_node;      // list node, used to attach to the name hash bucket
+    struct tuya_list_head async_root;     // async publishes waiting for dispatch, protected by the manage mutex
+    BOOL_T async_scheduled;               // a work item drains async_root
+    EVENT_STAT_T stat;                    // publish counters
 } EVENT_NODE_T;
 
+/**
+ * @brief the interned id of an event, stays valid for the life time of the
+ * process
+ *
+ */
+typedef EVENT_NODE_T *EVENT_ID_T;
+
 /**
  * @brief the event manage node
  *
@@ -112,6 +144,7 @@ typedef struct {
     struct tuya_list_head event_root;          // event root, used to manage the event
     struct tuya_list_head free_subscribe_root; // free subscriber list, used to manage the
                                                // subscribe which not found the event
+    struct tuya_list_head hash_root[EVENT_HASH_NUM]; // event name hash buckets
 } EVENT_MANAGE_T;
 
 /**
@@ -132,6 +165,75 @@ OPERATE_RET tal_event_init(void);
  */
 OPERATE_RET tal_event_publish(const char *name, void *data);
 
+/**
+ * @brief: get the interned id of an event, the event is created if it does
+ * not exist yet. Resolve the id once and publish with it to skip the name
+ * lookup.
+ *
+ * @param[in] name: event name
+ * @param[out] id: event id
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_event_id_get(const char *name, EVENT_ID_T *id);
+
+/**
+ * @brief: publish event by id
+ *
+ * @param[in] id: event id from tal_event_id_get
+ * @param[in] data: event data
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_event_publish_id(EVENT_ID_T id, void *data);
+
+/**
+ * @brief: publish event without waiting for the subscribers
+ *
+ * The subscribers run later in the system work queue. Async publishes of one
+ * event reach every subscriber in publish order, they are not ordered against
+ * tal_event_publish of the same event.
+ *
+ * @param[in] name: event name
+ * @param[in] data: event data
+ * @param[in] len: bytes of data to copy for the subscribers, 0 to pass the
+ * data pointer as it is, it must then stay valid until they ran
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_event_publish_async(const char *name, void *data, uint32_t len);
+
+/**
+ * @brief: publish event by id without waiting for the subscribers, see
+ * tal_event_publish_async
+ *
+ * @param[in] id: event id from tal_event_id_get
+ * @param[in] data: event data
+ * @param[in] len: bytes of data to copy for the subscribers, 0 to pass the
+ * data pointer as it is
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_event_publish_async_id(EVENT_ID_T id, void *data, uint32_t len);
+
+/**
+ * @brief: get the publish counters of an event
+ *
+ * @param[in] name: event name
+ * @param[out] stat: the counters
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_event_stat_get(const char *name, EVENT_STAT_T *stat);
+
+/**
+ * @brief: print the publish counters of every event and the run time of its
+ * subscribers
+ *
+ * @return none
+ */
+void tal_event_stat_dump(void);
+
 /**
  * @brief: subscribe event
  *
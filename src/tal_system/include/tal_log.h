@@ -350,6 +350,36 @@ void tal_log_color_set(const TAL_LOG_LEVEL_E level, TAL_LOG_DISPLAY_MODE_E displ
 OPERATE_RET tal_log_color_print_raw(TAL_LOG_DISPLAY_MODE_E display_mode, TAL_LOG_FONT_COLOR_E font_color,
                                     TAL_LOG_BACKGROUND_COLOR_E background_color, const char *pFmt, ...);
 
+/**
+ * @brief switch the deferred log mode, the lines are formatted and output by a
+ * low priority task
+ *
+ * @param[in] enable, TRUE to defer the log lines
+ *
+ * @note The format of a deferred line must stay valid, string arguments are
+ * copied. Needs TAL_LOG_DEFER_BUF_SIZE > 0.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_log_set_deferred(BOOL_T enable);
+
+/**
+ * @brief print the queued lines of the deferred mode on the calling thread
+ *
+ * @note This API is used before an assert or crash stops the system.
+ *
+ * @return NONE
+ */
+void tal_log_flush(void);
+
+/**
+ * @brief get the lines the deferred mode dropped on a full ring
+ *
+ * @return the lines dropped since start
+ */
+uint32_t tal_log_get_dropped(void);
+
 #ifdef __cplusplus
 }
 #endif /* __TAL_LOG_H__ */
@@ -10,6 +10,12 @@
  * executing background tasks and time-sensitive operations within Tuya-based
  * IoT applications.
  *
+ * A workqueue is either one thread draining a FIFO, or a pool of several
+ * worker threads created by tal_workqueue_create_pool(). The pool keeps a
+ * deque per worker and priority, a worker runs several items per wake-up and
+ * idle workers steal from busy ones. Both kinds share the same handle and API,
+ * but the items of a pool may run concurrently and in any order.
+ *
  * @note This file is part of the Tuya IoT Development Platform and is intended
  * for use in Tuya-based applications. It is subject to the platform's license
  * and copyright terms.
@@ -39,6 +45,31 @@ typedef struct {
 } WORK_ITEM_T;
 typedef BOOL_T (*WORKQUEUE_TRAVERSE_CB)(WORK_ITEM_T *item, void *ctx);
 
+/**
+ * @brief priority of a work item, higher priorities are dequeued first
+ *
+ */
+typedef enum {
+    WORKQUEUE_PRIO_HIGH = 0,
+    WORKQUEUE_PRIO_NORMAL,
+    WORKQUEUE_PRIO_LOW,
+    WORKQUEUE_PRIO_NUM
+} WORKQUEUE_PRIO_E;
+
+/**
+ * @brief counters of a workqueue, times are in ms
+ *
+ */
+typedef struct {
+    uint32_t executed;       // items executed
+    uint32_t stolen;         // items a worker took from another worker
+    uint32_t wakeups;        // times a worker woke up for new items
+    uint32_t queue_ms_max;   // longest wait of an item in the queue
+    uint32_t queue_ms_total; // time items waited in the queue
+    uint32_t run_ms_max;     // longest item callback
+    uint32_t run_ms_total;   // time spent in item callbacks
+} WORKQUEUE_STAT_T;
+
 /**
  * @brief create and initialize a workqueue which runs in thread context
  *
@@ -52,6 +83,22 @@ typedef BOOL_T (*WORKQUEUE_TRAVERSE_CB)(WORK_ITEM_T *item, void *ctx);
  */
 OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_cfg, WORKQUEUE_HANDLE *handle);
 
+/**
+ * @brief create a workqueue served by a pool of worker threads
+ *
+ * @param[in] worker_num the number of worker threads
+ * @param[in] queue_len the maximum number of items of each priority that the
+ * workqueue can contain
+ * @param[in] thread_cfg thread param of the workers, the name gets the worker
+ * index appended
+ * @param[out] handle the workqueue handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_create_pool(const uint8_t worker_num, const uint16_t queue_len, THREAD_CFG_T *thread_cfg,
+                                      WORKQUEUE_HANDLE *handle);
+
 /**
  * @brief put work task in workqueue
  *
@@ -76,6 +123,20 @@ OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, voi
  */
 OPERATE_RET tal_workqueue_schedule_instant(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data);
 
+/**
+ * @brief put work task in workqueue with a priority
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ * @param[in] prio the work priority, a single thread workqueue puts
+ * WORKQUEUE_PRIO_HIGH in front and the others at the back
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_schedule_prio(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data, WORKQUEUE_PRIO_E prio);
+
 /**
  * @brief cancel work task in workqueue
  *
@@ -109,6 +170,17 @@ OPERATE_RET tal_workqueue_traverse(WORKQUEUE_HANDLE handle, WORKQUEUE_TRAVERSE_C
  */
 uint16_t tal_workqueue_get_num(WORKQUEUE_HANDLE handle);
 
+/**
+ * @brief get the counters of the workqueue, summed over its workers
+ *
+ * @param[in] handle the workqueue handle
+ * @param[out] stat the counters
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_stat_get(WORKQUEUE_HANDLE handle, WORKQUEUE_STAT_T *stat);
+
 /**
  * @brief release the workqueue
  *
@@ -120,7 +192,7 @@ uint16_t tal_workqueue_get_num(WORKQUEUE_HANDLE handle);
 OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle);
 
 /**
- * @brief get thread handle of the workqueue
+ * @brief get thread handle of the workqueue, the first worker of a pool
  *
  * @param[in] handle the workqueue handle
  *
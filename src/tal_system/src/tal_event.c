@@ -20,6 +20,8 @@
  * - Subscription management (addition, deletion, retrieval)
  * - Event dispatching to subscribed listeners
  * - Thread-safe operations through mutex locking
+ * - Interned event ids and asynchronous publish through the system work queue
+ * - Publish latency and subscriber run time counters
  * - Debugging utilities for event and subscription dumping
  *
  * This implementation leverages the Tuya IoT SDK's infrastructure, including
@@ -34,8 +36,39 @@
 #include "tal_event.h"
 #include "tal_api.h"
 
+/**
+ * @brief an asynchronous publish waiting in the queue of its event
+ *
+ */
+typedef struct {
+    struct tuya_list_head node; // list node, used to attach to the event async root
+    SYS_TIME_T publish_ms;      // publish time, used to record the queue latency
+    void *data;                 // the event data, point to buf when copied
+    uint8_t buf[0];             // copy of the event data
+} EVENT_ASYNC_MSG_T;
+
 static EVENT_MANAGE_T g_event_manager = {0};
 
+static uint32_t _event_name_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+
+    return hash % EVENT_HASH_NUM;
+}
+
+static void _event_time_record(uint32_t ms, uint32_t *max, uint32_t *total)
+{
+    if (ms > *max) {
+        *max = ms;
+    }
+    *total += ms;
+}
+
 BOOL_T _event_name_is_valid(const char *name)
 {
     if (!name) {
@@ -62,6 +95,8 @@ BOOL_T _event_desc_is_valid(const char *desc)
     return TRUE;
 }
 
+EVENT_NODE_T *_event_node_get(const char *name);
+
 EVENT_NODE_T *_event_node_create_init(const char *name)
 {
     // allocate memory
@@ -73,10 +108,20 @@ EVENT_NODE_T *_event_node_create_init(const char *name)
     memcpy(event->name, name, strlen(name));
     event->name[strlen(name)] = '\0';
     INIT_LIST_HEAD(&event->subscribe_root);
+    INIT_LIST_HEAD(&event->async_root);
     tal_mutex_create_init(&event->mutex);
 
     tal_mutex_lock(g_event_manager.mutex);
 
+    // another thread may have created it meanwhile, the event is interned
+    EVENT_NODE_T *exist = _event_node_get(name);
+    if (exist) {
+        tal_mutex_unlock(g_event_manager.mutex);
+        tal_mutex_release(event->mutex);
+        tal_free(event);
+        return exist;
+    }
+
     // need check if there have free subscriber which subscribe this event
     struct tuya_list_head *free_pos = NULL;
     struct tuya_list_head *free_next = NULL;
@@ -100,6 +145,7 @@ EVENT_NODE_T *_event_node_create_init(const char *name)
 
     // at last, need add this event to event manage root
     tuya_list_add_tail(&event->node, &g_event_manager.event_root);
+    tuya_list_add_tail(&event->hash_node, &g_event_manager.hash_root[_event_name_hash(name)]);
     g_event_manager.event_cnt++;
 
     tal_mutex_unlock(g_event_manager.mutex);
@@ -109,13 +155,13 @@ EVENT_NODE_T *_event_node_create_init(const char *name)
 
 EVENT_NODE_T *_event_node_get(const char *name)
 {
-    // try to get event from event root
+    // try to get event from its hash bucket
     EVENT_NODE_T *entry = NULL;
     struct tuya_list_head *pos = NULL;
-    tuya_list_for_each(pos, &g_event_manager.event_root)
+    tuya_list_for_each(pos, &g_event_manager.hash_root[_event_name_hash(name)])
     {
         // find by name
-        entry = tuya_list_entry(pos, EVENT_NODE_T, node);
+        entry = tuya_list_entry(pos, EVENT_NODE_T, hash_node);
         if (0 == strcmp(entry->name, name)) {
             return entry;
         }
@@ -165,12 +211,16 @@ OPERATE_RET _event_node_dispatch(EVENT_NODE_T *event, void *data)
     struct tuya_list_head *p = NULL;
     struct tuya_list_head *n = NULL;
     SUBSCRIBE_NODE_T *entry = NULL;
+    SYS_TIME_T start = 0;
     tuya_list_for_each_safe(p, n, &event->subscribe_root)
     {
-        // find and call cb one by one
+        // find and call cb one by one, and record how long it runs
         entry = tuya_list_entry(p, SUBSCRIBE_NODE_T, node);
         if (entry->cb) {
+            start = tal_system_get_millisecond();
             TUYA_CALL_ERR_LOG(entry->cb(data));
+            entry->run_cnt++;
+            _event_time_record(tal_system_get_millisecond() - start, &entry->run_ms_max, &entry->run_ms_total);
         }
 
         // one-time event should be removed after dispatch
@@ -217,6 +267,9 @@ OPERATE_RET _event_node_add_subscribe(EVENT_NODE_T *event, SUBSCRIBE_NODE_T *sub
     new_entry = (SUBSCRIBE_NODE_T *)tal_malloc(sizeof(SUBSCRIBE_NODE_T));
     TUYA_CHECK_NULL_RETURN(new_entry, OPRT_MALLOC_FAILED);
     memcpy(new_entry, subscribe, sizeof(SUBSCRIBE_NODE_T));
+    new_entry->run_cnt = 0;
+    new_entry->run_ms_max = 0;
+    new_entry->run_ms_total = 0;
 
     // try to add, if emergence, add to first, otherwise, add to tail
     if (subscribe->type == SUBSCRIBE_TYPE_EMERGENCY) {
@@ -262,6 +315,91 @@ OPERATE_RET _event_node_del_subscribe(EVENT_NODE_T *event, SUBSCRIBE_NODE_T *sub
     return rt;
 }
 
+OPERATE_RET _event_node_publish(EVENT_NODE_T *event, void *data)
+{
+    OPERATE_RET rt = OPRT_OK;
+    SYS_TIME_T start = tal_system_get_millisecond();
+
+    // to keep the consistency, dispatch will done in mutex lock
+    tal_mutex_lock(event->mutex);
+    // try to dispatch event to all subscribe
+    // if one of the subscribe failed, it will continue but will return failed
+    // to record the execute status
+    TUYA_CALL_ERR_LOG(_event_node_dispatch(event, data));
+
+    event->stat.publish_cnt++;
+    _event_time_record(tal_system_get_millisecond() - start, &event->stat.publish_ms_max,
+                       &event->stat.publish_ms_total);
+    tal_mutex_unlock(event->mutex);
+
+    return rt;
+}
+
+static void _event_async_work(void *data)
+{
+    EVENT_NODE_T *event = (EVENT_NODE_T *)data;
+    EVENT_ASYNC_MSG_T *msg = NULL;
+
+    // drain the queue in publish order, one work item per event keeps the
+    // order for every subscriber
+    for (;;) {
+        tal_mutex_lock(g_event_manager.mutex);
+        if (tuya_list_empty(&event->async_root)) {
+            event->async_scheduled = FALSE;
+            tal_mutex_unlock(g_event_manager.mutex);
+            break;
+        }
+        msg = tuya_list_entry(event->async_root.next, EVENT_ASYNC_MSG_T, node);
+        tuya_list_del(&msg->node);
+        tal_mutex_unlock(g_event_manager.mutex);
+
+        tal_mutex_lock(event->mutex);
+        _event_time_record(tal_system_get_millisecond() - msg->publish_ms, &event->stat.queue_ms_max,
+                           &event->stat.queue_ms_total);
+        _event_node_dispatch(event, msg->data);
+        tal_mutex_unlock(event->mutex);
+
+        tal_free(msg);
+    }
+}
+
+OPERATE_RET _event_node_publish_async(EVENT_NODE_T *event, void *data, uint32_t len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    BOOL_T schedule = FALSE;
+
+    EVENT_ASYNC_MSG_T *msg = tal_malloc(sizeof(EVENT_ASYNC_MSG_T) + len);
+    TUYA_CHECK_NULL_RETURN(msg, OPRT_MALLOC_FAILED);
+    msg->publish_ms = tal_system_get_millisecond();
+    if (len > 0) {
+        memcpy(msg->buf, data, len);
+        msg->data = msg->buf;
+    } else {
+        msg->data = data;
+    }
+
+    tal_mutex_lock(g_event_manager.mutex);
+    tuya_list_add_tail(&msg->node, &event->async_root);
+    event->stat.async_cnt++;
+    if (!event->async_scheduled) {
+        event->async_scheduled = TRUE;
+        schedule = TRUE;
+    }
+    tal_mutex_unlock(g_event_manager.mutex);
+
+    if (schedule) {
+        rt = tal_workq_schedule(WORKQ_SYSTEM, _event_async_work, event);
+        if (OPRT_OK != rt) {
+            // no work queue yet, dispatch in the caller
+            PR_DEBUG("event %s async schedule fail %d, dispatch now", event->name, rt);
+            _event_async_work(event);
+            rt = OPRT_OK;
+        }
+    }
+
+    return rt;
+}
+
 #if 0
 int _ty_event_dump()
 {
@@ -337,6 +475,9 @@ OPERATE_RET tal_event_init(void)
 
     INIT_LIST_HEAD(&g_event_manager.event_root);
     INIT_LIST_HEAD(&g_event_manager.free_subscribe_root);
+    for (int i = 0; i < EVENT_HASH_NUM; i++) {
+        INIT_LIST_HEAD(&g_event_manager.hash_root[i]);
+    }
     tal_mutex_create_init(&g_event_manager.mutex);
     g_event_manager.event_cnt = 0;
     g_event_manager.inited = TRUE;
@@ -382,16 +523,177 @@ OPERATE_RET tal_event_publish(const char *name, void *data)
         TUYA_CHECK_NULL_RETURN(event, OPRT_MALLOC_FAILED);
     }
 
-    // to keep the consistency, dispatch will done in mutex lock
-    tal_mutex_lock(event->mutex);
-    // try to dispatch event to all subscribe
-    // if one of the subscribe failed, it will continue but will return failed
-    // to record the execute status
-    TUYA_CALL_ERR_LOG(_event_node_dispatch(event, data));
+    TUYA_CALL_ERR_LOG(_event_node_publish(event, data));
+
+    return rt;
+}
+
+/**
+ * @brief Gets the interned id of an event.
+ *
+ * The event is created when it does not exist yet. The id stays valid for the
+ * life time of the process, publishing by id skips the name lookup.
+ *
+ * @param[in] name The name of the event.
+ * @param[out] id The id of the event.
+ * @return The operation result. Returns OPRT_OK on success, or an error code on
+ * failure.
+ */
+OPERATE_RET tal_event_id_get(const char *name, EVENT_ID_T *id)
+{
+    if (g_event_manager.inited != TRUE) {
+        tal_event_init();
+    }
 
+    if (!_event_name_is_valid(name)) {
+        return OPRT_BASE_EVENT_INVALID_EVENT_NAME;
+    }
+
+    if (NULL == id) {
+        return OPRT_INVALID_PARM;
+    }
+
+    EVENT_NODE_T *event = _event_node_get(name);
+    if (!event) {
+        event = _event_node_create_init(name);
+        TUYA_CHECK_NULL_RETURN(event, OPRT_MALLOC_FAILED);
+    }
+
+    *id = event;
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Publishes an event by its interned id.
+ *
+ * @param[in] id The event id from tal_event_id_get.
+ * @param[in] data The data associated with the event.
+ * @return The operation result. Returns OPRT_OK on success, or an error code on
+ * failure.
+ */
+OPERATE_RET tal_event_publish_id(EVENT_ID_T id, void *data)
+{
+    if (NULL == id) {
+        return OPRT_INVALID_PARM;
+    }
+
+    return _event_node_publish(id, data);
+}
+
+/**
+ * @brief Publishes an event without waiting for the subscribers.
+ *
+ * The data is queued on the event and the subscribers are called from the
+ * system work queue. One work item drains the queue of an event, so every
+ * subscriber sees the async publishes of the event in publish order. When the
+ * work queue is not available the subscribers are called before returning.
+ *
+ * @param[in] name The name of the event to publish.
+ * @param[in] data The data associated with the event.
+ * @param[in] len The bytes of data to copy, 0 to pass the data pointer as it
+ * is.
+ * @return The operation result. Returns OPRT_OK on success, or an error code on
+ * failure.
+ */
+OPERATE_RET tal_event_publish_async(const char *name, void *data, uint32_t len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    EVENT_ID_T id = NULL;
+
+    TUYA_CALL_ERR_RETURN(tal_event_id_get(name, &id));
+
+    return tal_event_publish_async_id(id, data, len);
+}
+
+/**
+ * @brief Publishes an event by its interned id without waiting for the
+ * subscribers, see tal_event_publish_async.
+ *
+ * @param[in] id The event id from tal_event_id_get.
+ * @param[in] data The data associated with the event.
+ * @param[in] len The bytes of data to copy, 0 to pass the data pointer as it
+ * is.
+ * @return The operation result. Returns OPRT_OK on success, or an error code on
+ * failure.
+ */
+OPERATE_RET tal_event_publish_async_id(EVENT_ID_T id, void *data, uint32_t len)
+{
+    if (NULL == id || (len > 0 && NULL == data)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    return _event_node_publish_async(id, data, len);
+}
+
+/**
+ * @brief Gets the publish counters of an event.
+ *
+ * @param[in] name The name of the event.
+ * @param[out] stat The counters.
+ * @return The operation result. Returns OPRT_OK on success, or an error code on
+ * failure.
+ */
+OPERATE_RET tal_event_stat_get(const char *name, EVENT_STAT_T *stat)
+{
+    if (g_event_manager.inited != TRUE) {
+        tal_event_init();
+    }
+
+    if (!_event_name_is_valid(name)) {
+        return OPRT_BASE_EVENT_INVALID_EVENT_NAME;
+    }
+
+    if (NULL == stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+    EVENT_NODE_T *event = _event_node_get(name);
+    if (!event) {
+        return OPRT_NOT_FOUND;
+    }
+
+    tal_mutex_lock(event->mutex);
+    memcpy(stat, &event->stat, sizeof(EVENT_STAT_T));
     tal_mutex_unlock(event->mutex);
 
-    return rt;
+    return OPRT_OK;
+}
+
+/**
+ * @brief Prints the publish counters of every event and the run time of its
+ * subscribers, times are in milliseconds.
+ *
+ * @return none
+ */
+void tal_event_stat_dump(void)
+{
+    if (g_event_manager.inited != TRUE) {
+        return;
+    }
+
+    struct tuya_list_head *e_pos = NULL;
+    struct tuya_list_head *s_pos = NULL;
+    EVENT_NODE_T *event = NULL;
+    SUBSCRIBE_NODE_T *subscribe = NULL;
+
+    // events are never removed, the list is walked without the manage mutex
+    // as a subscriber may publish while holding its event mutex
+    tuya_list_for_each(e_pos, &g_event_manager.event_root)
+    {
+        event = tuya_list_entry(e_pos, EVENT_NODE_T, node);
+        tal_mutex_lock(event->mutex);
+        PR_NOTICE("event %-16s publish %d max %d total %d, async %d queue max %d total %d", event->name,
+                  event->stat.publish_cnt, event->stat.publish_ms_max, event->stat.publish_ms_total,
+                  event->stat.async_cnt, event->stat.queue_ms_max, event->stat.queue_ms_total);
+        tuya_list_for_each(s_pos, &event->subscribe_root)
+        {
+            subscribe = tuya_list_entry(s_pos, SUBSCRIBE_NODE_T, node);
+            PR_NOTICE("    %-32s run %d max %d total %d", subscribe->desc, subscribe->run_cnt,
+                      subscribe->run_ms_max, subscribe->run_ms_total);
+        }
+        tal_mutex_unlock(event->mutex);
+    }
 }
 
 /**
@@ -13,6 +13,8 @@
  * - Configurable log levels ranging from debug to critical errors.
  * - Support for multiple log output destinations through callback registration.
  * - Thread-safe log message output using mutexes.
+ * - An optional deferred mode, the callers queue the arguments into a ring and
+ *   a low priority task formats and outputs the lines.
  * - Integration with Tuya's IoT SDK for memory management and system utilities.
  *
  * The logging system is implemented using a linked list to manage output
@@ -38,6 +40,8 @@
 #include "tal_system.h"
 #include "tal_time_service.h"
 #include "tal_memory.h"
+#include "tal_thread.h"
+#include "tal_semaphore.h"
 
 /***********************************************************
 *************************micro define***********************
@@ -77,6 +81,58 @@ typedef struct {
 
 #define DEF_OUTPUT_NAME "def_output"
 
+#ifndef TAL_LOG_DEFER_BUF_SIZE
+#define TAL_LOG_DEFER_BUF_SIZE 0
+#endif
+
+#if (TAL_LOG_DEFER_BUF_SIZE > 0)
+#define LOG_DEFER_REC_MAX    256 // a longer record is cut at the last argument that fits
+#define LOG_DEFER_STACK_SIZE 4096
+
+/* argument types of a conversion, integers are kept as 64 bit */
+#define LOG_ARG_NONE   0
+#define LOG_ARG_SINT   1
+#define LOG_ARG_UINT   2
+#define LOG_ARG_DOUBLE 3
+#define LOG_ARG_PTR    4
+#define LOG_ARG_STR    5
+
+typedef struct {
+    uint16_t len; // record bytes with the arguments
+    uint8_t level;
+    uint8_t cut;  // arguments missing at the end
+    uint32_t line;
+    const char *file;
+    const char *fmt;
+    SYS_TICK_T time_ms;
+} LOG_DEFER_REC_S;
+
+typedef struct {
+    uint8_t type;
+    uint8_t len;       // chars of the conversion from '%'
+    uint8_t body_len;  // chars of '%', flags, width and precision
+    uint8_t mod[2];    // length modifier, 0 for none
+    char conv;
+    BOOL_T width_star; // width and precision taken from int arguments
+    BOOL_T prec_star;
+    int prec; // -1 for none
+} LOG_SPEC_S;
+
+typedef struct {
+    BOOL_T enable;
+    BOOL_T starting; // a caller is creating the task
+    THREAD_HANDLE thread;
+    SEM_HANDLE sem;
+    uint8_t *ring;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t used;
+    uint32_t dropped; // not reported yet
+    uint32_t dropped_total;
+    uint64_t rec[LOG_DEFER_REC_MAX / sizeof(uint64_t)]; // the record being printed, under the log mutex
+} LOG_DEFER_S;
+#endif
+
 /***********************************************************
 *************************variable define********************
 ***********************************************************/
@@ -91,6 +147,10 @@ const LOG_TEXT_STYLE_S sDefaultStyle[LOG_LEVEL_MAX + 1] = {
     {TAL_LOG_DISPLAY_MODE_DEFAULT, TAL_LOG_FONT_COLOR_GREEN, TAL_LOG_BACKGROUND_COLOR_DEFAULT},
     {TAL_LOG_DISPLAY_MODE_DEFAULT, TAL_LOG_FONT_COLOR_WHITE, TAL_LOG_BACKGROUND_COLOR_DEFAULT}};
 
+#if (TAL_LOG_DEFER_BUF_SIZE > 0)
+static LOG_DEFER_S sg_log_defer;
+#endif
+
 /***********************************************************
 *************************function define********************
 ***********************************************************/
@@ -336,6 +396,566 @@ OPERATE_RET tal_log_get_level(TAL_LOG_LEVEL_E *level)
     return OPRT_OK;
 }
 
+static const char *__log_file_name(const char *pFile)
+{
+    int pos = 0;
+
+    if (NULL == pFile) {
+        return "Null";
+    }
+    pos = tal_log_strrchr((char *)pFile, '/');
+    if (pos < 0) {
+        pos = tal_log_strrchr((char *)pFile, '\\');
+    }
+
+    return (pos >= 0) ? pFile + pos + 1 : pFile;
+}
+
+/* color and "[time module level][file:line] " into the log buffer, time_ms 0 for now */
+static int __log_head(LOG_LEVEL logLevel, const char *pFile, uint32_t line, SYS_TICK_T time_ms)
+{
+    int len = 0;
+    int cnt = 0;
+    const char *pTmpModuleName = "ty";
+    const char *pTmpFilename = __log_file_name(pFile);
+
+    // color prefix
+    if (pLogManage->log_color.enable_color) {
+        cnt = snprintf(pLogManage->log_buf, pLogManage->log_buf_len, "\033[%d;%d;%dm",
+                       pLogManage->log_color.style[logLevel].display_mode,
+                       pLogManage->log_color.style[logLevel].font_color,
+                       pLogManage->log_color.style[logLevel].background_color);
+        if (cnt <= 0) {
+            return -1;
+        }
+        len += cnt;
+    }
+
+    POSIX_TM_S tm;
+    memset(&tm, 0, sizeof(tm));
+
+    if (pLogManage->ms_level == FALSE) {
+        tal_time_get_local_time_custom((TIME_T)(time_ms / 1000), &tm);
+        cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len,
+                       "[%02d-%02d %02d:%02d:%02d %s %s][%s:%" PRIu32 "] ", tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+                       tm.tm_min, tm.tm_sec, pTmpModuleName, sLevelStr[logLevel], pTmpFilename, line);
+    } else {
+        if (0 == time_ms) {
+            time_ms = tal_time_get_posix_ms();
+        }
+        TIME_T sec = (TIME_T)(time_ms / 1000);
+        uint32_t ms = (uint32_t)(time_ms % 1000);
+        tal_time_get_local_time_custom(sec, &tm);
+        cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len,
+                       "[%02d-%02d %02d:%02d:%02d:%" PRIu32 " %s %s][%s:%" PRIu32 "] ", tm.tm_mon + 1, tm.tm_mday,
+                       tm.tm_hour, tm.tm_min, tm.tm_sec, ms, pTmpModuleName, sLevelStr[logLevel], pTmpFilename, line);
+    }
+    if (cnt <= 0) {
+        return -1;
+    }
+    len += cnt;
+
+    return (len < pLogManage->log_buf_len) ? len : pLogManage->log_buf_len - 1;
+}
+
+/* ends the line in the log buffer and outputs it */
+static OPERATE_RET __log_tail(int len)
+{
+    int cnt = 0;
+    char *p_suffix = (pLogManage->log_color.enable_color) ? "\033[0m\r\n" : "\r\n";
+
+    if (len > (int)(pLogManage->log_buf_len - strlen(p_suffix) - 1)) { // 1 -> "\0"
+        len = pLogManage->log_buf_len - strlen(p_suffix) - 1;
+    }
+    cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, "%s", p_suffix);
+    if (cnt <= 0) {
+        return OPRT_BASE_LOG_MNG_FORMAT_STRING_FAILED;
+    }
+    len += cnt;
+    pLogManage->log_buf[len] = '\0';
+
+    __output_logManage_buf();
+
+    return OPRT_OK;
+}
+
+#if (TAL_LOG_DEFER_BUF_SIZE > 0)
+/* parses the conversion at fmt, which points to '%' */
+static void __log_spec_parse(const char *fmt, LOG_SPEC_S *spec)
+{
+    const char *p = fmt + 1;
+
+    memset(spec, 0, sizeof(LOG_SPEC_S));
+    spec->prec = -1;
+    while (*p && strchr("-+ #0'", *p)) {
+        p++;
+    }
+    if ('*' == *p) {
+        spec->width_star = TRUE;
+        p++;
+    }
+    while (isdigit((unsigned char)*p)) {
+        p++;
+    }
+    if ('.' == *p) {
+        p++;
+        spec->prec = 0;
+        if ('*' == *p) {
+            spec->prec_star = TRUE;
+            p++;
+        }
+        while (isdigit((unsigned char)*p)) {
+            spec->prec = spec->prec * 10 + (*p - '0');
+            p++;
+        }
+    }
+    spec->body_len = (uint8_t)(p - fmt);
+    if (*p && strchr("hlLqjzZt", *p)) {
+        spec->mod[0] = *p++;
+        if (('h' == spec->mod[0] || 'l' == spec->mod[0]) && *p == spec->mod[0]) {
+            spec->mod[1] = *p++;
+        }
+    }
+    spec->conv = *p;
+    spec->len = (uint8_t)(p - fmt) + (*p ? 1 : 0);
+
+    switch (spec->conv) {
+    case 'd':
+    case 'i':
+        spec->type = LOG_ARG_SINT;
+        break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+    case 'c':
+        spec->type = LOG_ARG_UINT;
+        break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec->type = LOG_ARG_DOUBLE;
+        break;
+    case 'p':
+    case 'n':
+        spec->type = LOG_ARG_PTR;
+        break;
+    case 's':
+        spec->type = LOG_ARG_STR;
+        break;
+    default:
+        // "%%", or a conversion printed as it is
+        spec->type = LOG_ARG_NONE;
+        break;
+    }
+}
+
+/* the integer argument of a conversion, by its length modifier */
+static uint64_t __log_arg_int(const LOG_SPEC_S *spec, va_list *ap)
+{
+    BOOL_T sign = (LOG_ARG_SINT == spec->type);
+
+    switch (spec->mod[0]) {
+    case 'h':
+        if (spec->mod[1]) {
+            return sign ? (uint64_t)(int64_t)(signed char)va_arg(*ap, int) : (unsigned char)va_arg(*ap, int);
+        }
+        return sign ? (uint64_t)(int64_t)(short)va_arg(*ap, int) : (unsigned short)va_arg(*ap, int);
+    case 'l':
+        if (spec->mod[1]) {
+            return (uint64_t)va_arg(*ap, long long);
+        }
+        return sign ? (uint64_t)(int64_t)va_arg(*ap, long) : (uint64_t)va_arg(*ap, unsigned long);
+    case 'q':
+    case 'L':
+        return (uint64_t)va_arg(*ap, long long);
+    case 'j':
+        return (uint64_t)va_arg(*ap, intmax_t);
+    case 'z':
+    case 'Z':
+        return sign ? (uint64_t)(int64_t)(intptr_t)va_arg(*ap, size_t) : (uint64_t)va_arg(*ap, size_t);
+    case 't':
+        return (uint64_t)(int64_t)va_arg(*ap, ptrdiff_t);
+    default:
+        return sign ? (uint64_t)(int64_t)va_arg(*ap, int) : (uint64_t)va_arg(*ap, unsigned int);
+    }
+}
+
+/* copies the arguments after the record header, in the order of the format */
+static uint16_t __log_defer_encode(uint8_t *rec, const char *pFmt, va_list *ap)
+{
+    LOG_DEFER_REC_S *hdr = (LOG_DEFER_REC_S *)rec;
+    uint32_t len = sizeof(LOG_DEFER_REC_S);
+    LOG_SPEC_S spec;
+    uint64_t value = 0;
+    double dvalue = 0;
+    const char *str = NULL;
+    const char *end = NULL;
+    int n = 0;
+
+    for (; *pFmt; pFmt++) {
+        if ('%' != *pFmt) {
+            continue;
+        }
+        __log_spec_parse(pFmt, &spec);
+        pFmt += spec.len ? spec.len - 1 : 0;
+        if (LOG_ARG_NONE == spec.type) {
+            continue;
+        }
+        if (len + 3 * sizeof(uint64_t) > LOG_DEFER_REC_MAX) {
+            hdr->cut = 1;
+            break;
+        }
+        if (spec.width_star) {
+            value = (uint64_t)(int64_t)va_arg(*ap, int);
+            memcpy(rec + len, &value, sizeof(value));
+            len += sizeof(value);
+        }
+        if (spec.prec_star) {
+            n = va_arg(*ap, int);
+            spec.prec = n;
+            value = (uint64_t)(int64_t)n;
+            memcpy(rec + len, &value, sizeof(value));
+            len += sizeof(value);
+        }
+        if (LOG_ARG_DOUBLE == spec.type) {
+            dvalue = ('L' == spec.mod[0]) ? (double)va_arg(*ap, long double) : va_arg(*ap, double);
+            memcpy(rec + len, &dvalue, sizeof(dvalue));
+            len += sizeof(dvalue);
+        } else if (LOG_ARG_PTR == spec.type) {
+            value = (uint64_t)(uintptr_t)va_arg(*ap, void *);
+            memcpy(rec + len, &value, sizeof(value));
+            len += sizeof(value);
+        } else if (LOG_ARG_STR == spec.type) {
+            // the string is copied, the caller may free it once the call returns
+            str = va_arg(*ap, const char *);
+            if (NULL == str) {
+                str = "(null)";
+            }
+            n = LOG_DEFER_REC_MAX - len - 1;
+            if (spec.prec >= 0 && spec.prec < n) {
+                n = spec.prec;
+            }
+            end = memchr(str, '\0', n);
+            if (end) {
+                n = end - str;
+            }
+            memcpy(rec + len, str, n);
+            len += n;
+            rec[len++] = '\0';
+        } else {
+            value = __log_arg_int(&spec, ap);
+            memcpy(rec + len, &value, sizeof(value));
+            len += sizeof(value);
+        }
+    }
+    hdr->len = (uint16_t)len;
+
+    return hdr->len;
+}
+
+/* the format with the arguments of the record after the head in the log buffer */
+static int __log_defer_format(const uint8_t *rec, int len)
+{
+    const LOG_DEFER_REC_S *hdr = (const LOG_DEFER_REC_S *)rec;
+    const char *pFmt = hdr->fmt;
+    uint32_t pos = sizeof(LOG_DEFER_REC_S);
+    LOG_SPEC_S spec;
+    char conv[24];
+    int64_t star[2];
+    uint8_t stars = 0;
+    uint64_t value = 0;
+    double dvalue = 0;
+    const char *str = NULL;
+    int cnt = 0;
+
+    while (*pFmt && len < pLogManage->log_buf_len - 1) {
+        if ('%' != *pFmt) {
+            pLogManage->log_buf[len++] = *pFmt++;
+            continue;
+        }
+        __log_spec_parse(pFmt, &spec);
+        if ('%' == spec.conv) {
+            pLogManage->log_buf[len++] = '%';
+            pFmt += spec.len;
+            continue;
+        }
+        if (LOG_ARG_NONE == spec.type || spec.body_len + 4 > sizeof(conv)) {
+            // printed as it is
+            for (cnt = 0; cnt < spec.len && len < pLogManage->log_buf_len - 1; cnt++) {
+                pLogManage->log_buf[len++] = *pFmt++;
+            }
+            continue;
+        }
+        if (pos >= hdr->len) {
+            // the arguments from here did not fit the record
+            break;
+        }
+        stars = 0;
+        if (spec.width_star) {
+            memcpy(&star[stars++], rec + pos, sizeof(int64_t));
+            pos += sizeof(int64_t);
+        }
+        if (spec.prec_star) {
+            memcpy(&star[stars++], rec + pos, sizeof(int64_t));
+            pos += sizeof(int64_t);
+        }
+
+        pFmt += spec.len;
+        if ('n' == spec.conv) {
+            // nothing is written back to the caller
+            pos += sizeof(uint64_t);
+            continue;
+        }
+
+        // the conversion with the modifier of the stored type
+        memcpy(conv, pFmt - spec.len, spec.body_len);
+        cnt = spec.body_len;
+        if (LOG_ARG_SINT == spec.type || (LOG_ARG_UINT == spec.type && 'c' != spec.conv)) {
+            conv[cnt++] = 'l';
+            conv[cnt++] = 'l';
+        }
+        conv[cnt++] = spec.conv;
+        conv[cnt] = '\0';
+
+#define LOG_DEFER_SNPRINTF(arg)                                                                                        \
+    (0 == stars)   ? snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, conv, arg)                    \
+    : (1 == stars) ? snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, conv, (int)star[0], arg)      \
+                   : snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, conv, (int)star[0],          \
+                              (int)star[1], arg)
+        if (LOG_ARG_STR == spec.type) {
+            str = (const char *)rec + pos;
+            pos += strlen(str) + 1;
+            cnt = LOG_DEFER_SNPRINTF(str);
+        } else if (LOG_ARG_DOUBLE == spec.type) {
+            memcpy(&dvalue, rec + pos, sizeof(dvalue));
+            pos += sizeof(dvalue);
+            cnt = LOG_DEFER_SNPRINTF(dvalue);
+        } else {
+            memcpy(&value, rec + pos, sizeof(value));
+            pos += sizeof(value);
+            if (LOG_ARG_PTR == spec.type) {
+                cnt = LOG_DEFER_SNPRINTF((void *)(uintptr_t)value);
+            } else if ('c' == spec.conv) {
+                cnt = LOG_DEFER_SNPRINTF((int)value);
+            } else {
+                cnt = LOG_DEFER_SNPRINTF((long long)value);
+            }
+        }
+#undef LOG_DEFER_SNPRINTF
+        if (cnt < 0) {
+            return -1;
+        }
+        len += cnt;
+        if (len > pLogManage->log_buf_len - 1) {
+            len = pLogManage->log_buf_len - 1;
+        }
+    }
+    if (hdr->cut) {
+        cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, "...");
+        len += (cnt > 0) ? cnt : 0;
+    }
+
+    return len;
+}
+
+/* queues the record, counts it as dropped when the ring is full */
+static void __log_defer_push(const uint8_t *rec, uint16_t len)
+{
+    LOG_DEFER_S *defer = &sg_log_defer;
+    BOOL_T wake = FALSE;
+    uint32_t n = 0;
+
+    TAL_ENTER_CRITICAL();
+    if (TAL_LOG_DEFER_BUF_SIZE - defer->used < len) {
+        defer->dropped++;
+        defer->dropped_total++;
+    } else {
+        wake = (0 == defer->used);
+        n = TAL_LOG_DEFER_BUF_SIZE - defer->head;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(defer->ring + defer->head, rec, n);
+        memcpy(defer->ring, rec + n, len - n);
+        defer->head = (defer->head + len) % TAL_LOG_DEFER_BUF_SIZE;
+        defer->used += len;
+    }
+    TAL_EXIT_CRITICAL();
+
+    if (wake) {
+        tal_semaphore_post(defer->sem);
+    }
+}
+
+/* takes the oldest record into defer->rec, 0 when the ring is empty */
+static uint16_t __log_defer_pop(void)
+{
+    LOG_DEFER_S *defer = &sg_log_defer;
+    uint8_t *rec = (uint8_t *)defer->rec;
+    uint16_t len = 0;
+    uint32_t n = 0;
+
+    TAL_ENTER_CRITICAL();
+    if (defer->used) {
+        // the length leads the record and may wrap as well
+        rec[0] = defer->ring[defer->tail];
+        rec[1] = defer->ring[(defer->tail + 1) % TAL_LOG_DEFER_BUF_SIZE];
+        memcpy(&len, rec, sizeof(len));
+        n = TAL_LOG_DEFER_BUF_SIZE - defer->tail;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(rec, defer->ring + defer->tail, n);
+        memcpy(rec + n, defer->ring, len - n);
+        defer->tail = (defer->tail + len) % TAL_LOG_DEFER_BUF_SIZE;
+        defer->used -= len;
+    }
+    TAL_EXIT_CRITICAL();
+
+    return len;
+}
+
+/* prints the queued records in order, under the log mutex */
+static void __log_defer_flush_locked(void)
+{
+    LOG_DEFER_S *defer = &sg_log_defer;
+    LOG_DEFER_REC_S *hdr = (LOG_DEFER_REC_S *)defer->rec;
+    uint32_t dropped = 0;
+    int len = 0;
+
+    if (NULL == defer->ring) {
+        return;
+    }
+    while (__log_defer_pop()) {
+        len = __log_head(hdr->level, hdr->file, hdr->line, hdr->time_ms);
+        if (len >= 0) {
+            len = __log_defer_format((const uint8_t *)defer->rec, len);
+        }
+        if (len >= 0) {
+            __log_tail(len);
+        }
+    }
+
+    TAL_ENTER_CRITICAL();
+    dropped = defer->dropped;
+    defer->dropped = 0;
+    TAL_EXIT_CRITICAL();
+    if (dropped) {
+        len = __log_head(TAL_LOG_LEVEL_WARN, __FILE__, __LINE__, 0);
+        if (len >= 0) {
+            len += snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len,
+                            "%" PRIu32 " log records dropped, the ring is full", dropped);
+            __log_tail(len);
+        }
+    }
+}
+
+static void __log_defer_task(void *args)
+{
+    while (1) {
+        tal_semaphore_wait(sg_log_defer.sem, SEM_WAIT_FOREVER);
+        if (NULL == pLogManage) {
+            continue;
+        }
+        tal_mutex_lock(pLogManage->mutex);
+        __log_defer_flush_locked();
+        tal_mutex_unlock(pLogManage->mutex);
+    }
+}
+
+/* returns the flag before it was set */
+static BOOL_T __log_defer_starting_set(BOOL_T starting)
+{
+    BOOL_T old = FALSE;
+
+    TAL_ENTER_CRITICAL();
+    old = sg_log_defer.starting;
+    sg_log_defer.starting = starting;
+    TAL_EXIT_CRITICAL();
+
+    return old;
+}
+
+/* creates the ring, the semaphore and the task once. The log mutex is only taken to publish them, the thread
+ * creation logs and the mutex need not be recursive */
+static OPERATE_RET __log_defer_start(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    LOG_DEFER_S *defer = &sg_log_defer;
+    THREAD_CFG_T thrd_param = {LOG_DEFER_STACK_SIZE, THREAD_PRIO_6, "log_defer"};
+    THREAD_HANDLE thread = NULL;
+    SEM_HANDLE sem = NULL;
+    uint8_t *ring = NULL;
+
+    if (__log_defer_starting_set(TRUE)) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+    if (defer->thread) {
+        goto __EXIT;
+    }
+
+    ring = tal_malloc(TAL_LOG_DEFER_BUF_SIZE);
+    if (NULL == ring) {
+        rt = OPRT_MALLOC_FAILED;
+        goto __EXIT;
+    }
+    rt = tal_semaphore_create_init(&sem, 0, 1);
+    if (OPRT_OK != rt) {
+        tal_free(ring);
+        goto __EXIT;
+    }
+
+    // the task waits on the semaphore, it is published first
+    tal_mutex_lock(pLogManage->mutex);
+    defer->ring = ring;
+    defer->sem = sem;
+    tal_mutex_unlock(pLogManage->mutex);
+
+    rt = tal_thread_create_and_start(&thread, NULL, NULL, __log_defer_task, NULL, &thrd_param);
+    if (OPRT_OK != rt) {
+        tal_mutex_lock(pLogManage->mutex);
+        defer->ring = NULL;
+        defer->sem = NULL;
+        tal_mutex_unlock(pLogManage->mutex);
+        tal_semaphore_release(sem);
+        tal_free(ring);
+        goto __EXIT;
+    }
+    defer->thread = thread;
+
+__EXIT:
+    __log_defer_starting_set(FALSE);
+    return rt;
+}
+
+static OPERATE_RET __log_defer_print(LOG_LEVEL logLevel, const char *pFile, uint32_t line, const char *pFmt, va_list ap)
+{
+    uint64_t rec[LOG_DEFER_REC_MAX / sizeof(uint64_t)];
+    LOG_DEFER_REC_S *hdr = (LOG_DEFER_REC_S *)rec;
+    va_list args;
+    uint16_t len = 0;
+
+    hdr->level = logLevel;
+    hdr->cut = 0;
+    hdr->line = line;
+    hdr->file = pFile;
+    hdr->fmt = pFmt;
+    hdr->time_ms = tal_time_get_posix_ms();
+    va_copy(args, ap);
+    len = __log_defer_encode((uint8_t *)rec, pFmt, &args);
+    va_end(args);
+    __log_defer_push((const uint8_t *)rec, len);
+
+    return OPRT_OK;
+}
+#endif
+
 /**
  * @brief Prints a log message with the specified log level, file name, line
  * number, and format string.
@@ -365,6 +985,7 @@ OPERATE_RET tal_log_get_level(TAL_LOG_LEVEL_E *level)
  */
 OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, const char *pFmt, va_list ap)
 {
+    OPERATE_RET rt = OPRT_OK;
     int len = 0;
     int cnt = 0;
 
@@ -378,84 +999,106 @@ OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, const char
     if (logLevel > tmpLogLevel) {
         return OPRT_BASE_LOG_MNG_PRINT_LOG_LEVEL_HIGHER;
     }
-    const char *pTmpModuleName = "ty";
-    const char *pTmpFilename = NULL;
-
-    if (NULL == pFile) {
-        pTmpFilename = "Null";
-    } else {
-        int pos = 0;
-        pTmpFilename = pFile;
-        pos = tal_log_strrchr((char *)pFile, '/');
-        if (pos < 0) {
-            pos = tal_log_strrchr((char *)pFile, '\\');
-            if (pos >= 0) {
-                pTmpFilename = pFile + pos + 1;
-            }
-        } else {
-            pTmpFilename = pFile + pos + 1;
-        }
+#if (TAL_LOG_DEFER_BUF_SIZE > 0)
+    if (sg_log_defer.enable) {
+        return __log_defer_print(logLevel, pFile, line, pFmt, ap);
     }
+#endif
     tal_mutex_lock(pLogManage->mutex);
 
-    // color prefix
-    if (pLogManage->log_color.enable_color) {
-        cnt = snprintf(pLogManage->log_buf, pLogManage->log_buf_len, "\033[%d;%d;%dm",
-                       pLogManage->log_color.style[logLevel].display_mode,
-                       pLogManage->log_color.style[logLevel].font_color,
-                       pLogManage->log_color.style[logLevel].background_color);
-        if (cnt <= 0) {
-            goto ERR_EXIT;
-        }
-        len += cnt;
-    }
-
-    POSIX_TM_S tm;
-    memset(&tm, 0, sizeof(tm));
-
-    if (pLogManage->ms_level == FALSE) {
-        tal_time_get_local_time_custom(0, &tm);
-        cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len,
-                       "[%02d-%02d %02d:%02d:%02d %s %s][%s:%" PRIu32 "] ", tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
-                       tm.tm_min, tm.tm_sec, pTmpModuleName, sLevelStr[logLevel], pTmpFilename, line);
-    } else {
-        SYS_TICK_T time_ms = tal_time_get_posix_ms();
-        TIME_T sec = (TIME_T)(time_ms / 1000);
-        uint32_t ms = (uint32_t)(time_ms % 1000);
-        tal_time_get_local_time_custom(sec, &tm);
-        cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len,
-                       "[%02d-%02d %02d:%02d:%02d:%" PRIu32 " %s %s][%s:%" PRIu32 "] ", tm.tm_mon + 1, tm.tm_mday,
-                       tm.tm_hour, tm.tm_min, tm.tm_sec, ms, pTmpModuleName, sLevelStr[logLevel], pTmpFilename, line);
-    }
-    if (cnt <= 0) {
+    len = __log_head(logLevel, pFile, line, 0);
+    if (len < 0) {
         goto ERR_EXIT;
     }
-    len += cnt;
     cnt = vsnprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, pFmt, ap);
     if (cnt <= 0) {
         goto ERR_EXIT;
     }
     len += cnt;
 
-    char *p_suffix = (pLogManage->log_color.enable_color) ? "\033[0m\r\n" : "\r\n";
-    if (len > (int)(pLogManage->log_buf_len - strlen(p_suffix) - 1)) { // 1 -> "\0"
-        len = pLogManage->log_buf_len - strlen(p_suffix) - 1;
+    rt = __log_tail(len);
+    tal_mutex_unlock(pLogManage->mutex);
+
+    return rt;
+
+ERR_EXIT:
+    tal_mutex_unlock(pLogManage->mutex);
+    return OPRT_BASE_LOG_MNG_FORMAT_STRING_FAILED;
+}
+
+/**
+ * @brief Switches the deferred log mode.
+ *
+ * In the deferred mode tal_log_print() copies the format pointer, the arguments
+ * and a time stamp into a ring of TAL_LOG_DEFER_BUF_SIZE bytes and returns, a
+ * low priority task formats and outputs the records. The format must stay valid,
+ * string arguments are copied. Records that find the ring full are counted and
+ * reported by the task. Switching it off prints the queued records.
+ *
+ * @param enable TRUE to defer the log lines
+ * @return OPRT_OK on success, OPRT_NOT_SUPPORTED when TAL_LOG_DEFER_BUF_SIZE is 0.
+ * Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tal_log_set_deferred(BOOL_T enable)
+{
+#if (TAL_LOG_DEFER_BUF_SIZE > 0)
+    OPERATE_RET rt = OPRT_OK;
+    LOG_DEFER_S *defer = &sg_log_defer;
+
+    if (!pLogManage) {
+        return OPRT_INVALID_PARM;
     }
-    cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, "%s", p_suffix);
-    if (cnt <= 0) {
-        goto ERR_EXIT;
+
+    if (enable && NULL == defer->thread) {
+        rt = __log_defer_start();
+        if (OPRT_OK != rt) {
+            return rt;
+        }
     }
-    len += cnt;
-    pLogManage->log_buf[len] = '\0';
 
-    __output_logManage_buf();
+    tal_mutex_lock(pLogManage->mutex);
+    defer->enable = enable;
+    if (!enable) {
+        __log_defer_flush_locked();
+    }
     tal_mutex_unlock(pLogManage->mutex);
 
     return OPRT_OK;
+#else
+    return enable ? OPRT_NOT_SUPPORTED : OPRT_OK;
+#endif
+}
 
-ERR_EXIT:
+/**
+ * @brief Prints the queued records of the deferred mode on the calling thread.
+ *
+ * For an assert or a crash handler before the system stops, and before output
+ * that must not come ahead of the queued lines.
+ */
+void tal_log_flush(void)
+{
+#if (TAL_LOG_DEFER_BUF_SIZE > 0)
+    if (!pLogManage) {
+        return;
+    }
+    tal_mutex_lock(pLogManage->mutex);
+    __log_defer_flush_locked();
     tal_mutex_unlock(pLogManage->mutex);
-    return OPRT_BASE_LOG_MNG_FORMAT_STRING_FAILED;
+#endif
+}
+
+/**
+ * @brief Gets the number of records the deferred mode dropped on a full ring.
+ *
+ * @return the records dropped since start
+ */
+uint32_t tal_log_get_dropped(void)
+{
+#if (TAL_LOG_DEFER_BUF_SIZE > 0)
+    return sg_log_defer.dropped_total;
+#else
+    return 0;
+#endif
 }
 
 /**
@@ -523,6 +1166,9 @@ OPERATE_RET tal_log_print_raw(const char *pFmt, ...)
     va_list ap;
 
     tal_mutex_lock(pLogManage->mutex);
+#if (TAL_LOG_DEFER_BUF_SIZE > 0)
+    __log_defer_flush_locked();
+#endif
     va_start(ap, pFmt);
     opRet = __PrintLogVRaw(pFmt, ap);
     va_end(ap);
@@ -544,6 +1190,8 @@ void tal_log_release(void)
     if (!pLogManage) {
         return;
     }
+    // the task stays, it waits for records of the next log init
+    tal_log_set_deferred(FALSE);
 
     while (!tuya_list_empty(&(pLogManage->log_list))) {
         LOG_OUT_NODE_S *log_out_nd = NULL;
@@ -695,6 +1343,9 @@ OPERATE_RET tal_log_color_print_raw(TAL_LOG_DISPLAY_MODE_E display_mode, TAL_LOG
     }
 
     tal_mutex_lock(pLogManage->mutex);
+#if (TAL_LOG_DEFER_BUF_SIZE > 0)
+    __log_defer_flush_locked();
+#endif
     va_start(ap, pFmt);
     if (pLogManage->log_color.enable_color) {
         cnt = snprintf(pLogManage->log_buf, pLogManage->log_buf_len, "\033[%d;%d;%dm", display_mode, font_color,
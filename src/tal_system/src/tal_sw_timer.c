@@ -12,6 +12,19 @@
 #define STACK_SIZE_TIMERQ (4 * 1024)
 #endif
 
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+#ifndef SW_TIMER_WHEEL_TICK_MS
+#define SW_TIMER_WHEEL_TICK_MS 10
+#endif
+
+// 4 levels of 64 slots, level n covers 64^(n+1) ticks
+#define TIMER_WHEEL_BITS   6
+#define TIMER_WHEEL_SIZE   (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK   (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_DETACHED 0xFF
+#endif
+
 typedef struct {
     LIST_HEAD node;
 
@@ -23,10 +36,28 @@ typedef struct {
     BOOL_T is_running;
     TIMER_ID timer_id;
     TIMER_TYPE type;
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+    uint8_t level;
+    uint8_t slot;
+#endif
 } TIMER_T;
 
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+typedef struct {
+    LIST_HEAD slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+    uint64_t bitmap[TIMER_WHEEL_LEVELS]; // non-empty slots of each level
+    uint64_t cur_tick;                   // next tick to be processed
+    uint32_t cnt;                        // timers attached to the wheel
+} TIMER_WHEEL_T;
+#endif
+
 typedef struct {
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+    TIMER_WHEEL_T wheel;
+#else
     LIST_HEAD list_active;
+#endif
+    LIST_HEAD list_expired; // expired timers waiting for their callbacks
     LIST_HEAD list_standby;
     MUTEX_HANDLE mutex;
     uint16_t total_cnt;
@@ -40,6 +71,202 @@ typedef struct {
 
 static SW_TIMER_MGR_T s_timer_mgr;
 
+static uint64_t __timer_now_ms(void)
+{
+    TIME_S nowSecTime = 0;
+    TIME_MS nowMsTime = 0;
+
+    tal_time_get_system_time(&nowSecTime, &nowMsTime);
+
+    return (uint64_t)nowSecTime * 1000 + (uint64_t)nowMsTime;
+}
+
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+static int __timer_ctz64(uint64_t val)
+{
+    int n = 0;
+
+    while (!(val & 1)) {
+        val >>= 1;
+        n++;
+    }
+
+    return n;
+}
+
+static void __timer_detach(TIMER_T *timer)
+{
+    TIMER_WHEEL_T *wheel = &s_timer_mgr.wheel;
+
+    tuya_list_del(&(timer->node));
+
+    if (TIMER_WHEEL_DETACHED != timer->level) {
+        if (tuya_list_empty(&(wheel->slots[timer->level][timer->slot]))) {
+            wheel->bitmap[timer->level] &= ~(1ULL << timer->slot);
+        }
+        timer->level = TIMER_WHEEL_DETACHED;
+        wheel->cnt--;
+    }
+}
+
+static void __timer_wheel_insert(TIMER_T *timer)
+{
+    TIMER_WHEEL_T *wheel = &s_timer_mgr.wheel;
+    uint64_t expire_tick = (timer->expire_time + SW_TIMER_WHEEL_TICK_MS - 1) / SW_TIMER_WHEEL_TICK_MS;
+    uint8_t level = 0;
+
+    if (expire_tick < wheel->cur_tick) {
+        expire_tick = wheel->cur_tick;
+    }
+
+    // pick the lowest level whose range still reaches the expire tick
+    while ((level < TIMER_WHEEL_LEVELS - 1) && (((expire_tick >> (level * TIMER_WHEEL_BITS)) -
+                                                  (wheel->cur_tick >> (level * TIMER_WHEEL_BITS))) > TIMER_WHEEL_MASK)) {
+        level++;
+    }
+
+    // beyond the top level, park in its farthest slot and re-cascade later
+    if (((expire_tick >> (level * TIMER_WHEEL_BITS)) - (wheel->cur_tick >> (level * TIMER_WHEEL_BITS))) >
+        TIMER_WHEEL_MASK) {
+        expire_tick = wheel->cur_tick + ((uint64_t)TIMER_WHEEL_MASK << (level * TIMER_WHEEL_BITS));
+    }
+
+    timer->level = level;
+    timer->slot = (expire_tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+    tuya_list_add_tail(&(timer->node), &(wheel->slots[level][timer->slot]));
+    wheel->bitmap[level] |= (1ULL << timer->slot);
+    wheel->cnt++;
+}
+
+static void __timer_attach(TIMER_T *timer)
+{
+    TIMER_WHEEL_T *wheel = &s_timer_mgr.wheel;
+
+    __timer_detach(timer);
+
+    if (0 == wheel->cnt) {
+        // nothing pending, skip the idle ticks instead of catching up later
+        uint64_t now_tick = __timer_now_ms() / SW_TIMER_WHEEL_TICK_MS;
+        if (now_tick > wheel->cur_tick) {
+            wheel->cur_tick = now_tick;
+        }
+    }
+
+    __timer_wheel_insert(timer);
+}
+
+static void __timer_cascade(uint8_t level, uint8_t slot)
+{
+    TIMER_WHEEL_T *wheel = &s_timer_mgr.wheel;
+    struct tuya_list_head *p = NULL;
+    struct tuya_list_head *n = NULL;
+    TIMER_T *timer = NULL;
+
+    tuya_list_for_each_safe(p, n, &(wheel->slots[level][slot]))
+    {
+        timer = tuya_list_entry(p, TIMER_T, node);
+        __timer_detach(timer);
+        __timer_wheel_insert(timer);
+    }
+}
+
+static uint64_t __timer_next_tick(void)
+{
+    TIMER_WHEEL_T *wheel = &s_timer_mgr.wheel;
+    uint64_t next_tick = (uint64_t)-1;
+    uint64_t pos = 0, bits = 0, tick = 0;
+    uint8_t level = 0, idx = 0;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (0 == wheel->bitmap[level]) {
+            continue;
+        }
+
+        pos = wheel->cur_tick >> (level * TIMER_WHEEL_BITS);
+        idx = pos & TIMER_WHEEL_MASK;
+        // rotate so bit 0 is the current slot, the lowest set bit is the nearest one
+        bits = (idx) ? ((wheel->bitmap[level] >> idx) | (wheel->bitmap[level] << (TIMER_WHEEL_SIZE - idx)))
+                     : wheel->bitmap[level];
+        // level 0 expires slots, upper levels only need to wake up for the cascade
+        tick = (pos + __timer_ctz64(bits)) << (level * TIMER_WHEEL_BITS);
+        if (tick < next_tick) {
+            next_tick = tick;
+        }
+    }
+
+    return next_tick;
+}
+
+static void __timer_collect(uint64_t nowMS, SYS_TIME_T *next_expired)
+{
+    TIMER_WHEEL_T *wheel = &s_timer_mgr.wheel;
+    uint64_t now_tick = nowMS / SW_TIMER_WHEEL_TICK_MS;
+    uint64_t next_tick = 0, bits = 0;
+    uint8_t level = 0, idx = 0;
+    struct tuya_list_head *p = NULL;
+    struct tuya_list_head *n = NULL;
+    TIMER_T *timer = NULL;
+
+    while (wheel->cnt && wheel->cur_tick <= now_tick) {
+        idx = wheel->cur_tick & TIMER_WHEEL_MASK;
+
+        if (0 == idx) {
+            // find the highest level that wraps at this tick, then cascade top-down
+            level = 1;
+            while ((level < TIMER_WHEEL_LEVELS - 1) &&
+                   (0 == ((wheel->cur_tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK))) {
+                level++;
+            }
+            for (; level > 0; level--) {
+                __timer_cascade(level, (wheel->cur_tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK);
+            }
+        }
+
+        tuya_list_for_each_safe(p, n, &(wheel->slots[0][idx]))
+        {
+            timer = tuya_list_entry(p, TIMER_T, node);
+            __timer_detach(timer);
+            if (timer->expire_time > nowMS) {
+                // parked beyond the wheel range, not due yet
+                __timer_wheel_insert(timer);
+            } else {
+                tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_expired));
+            }
+        }
+
+        // jump to the next non-empty level 0 slot or the next cascade point
+        bits = (idx == TIMER_WHEEL_MASK) ? 0 : (wheel->bitmap[0] & (~0ULL << (idx + 1)));
+        next_tick = wheel->cur_tick - idx + ((bits) ? __timer_ctz64(bits) : TIMER_WHEEL_SIZE);
+        wheel->cur_tick = (next_tick > now_tick) ? (now_tick + 1) : next_tick;
+    }
+
+    if (0 == wheel->cnt) {
+        *next_expired = SEM_WAIT_FOREVER;
+        return;
+    }
+
+    next_tick = __timer_next_tick() * SW_TIMER_WHEEL_TICK_MS;
+    *next_expired = (next_tick > nowMS) ? (SYS_TIME_T)(next_tick - nowMS) : 0;
+}
+
+static void __timer_dump_list(LIST_HEAD *list);
+
+static void __timer_dump_active(void)
+{
+    uint8_t level = 0, slot = 0;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < TIMER_WHEEL_SIZE; slot++) {
+            __timer_dump_list(&(s_timer_mgr.wheel.slots[level][slot]));
+        }
+    }
+}
+#else
+static void __timer_detach(TIMER_T *timer)
+{
+    tuya_list_del(&(timer->node));
+}
+
 static void __timer_attach(TIMER_T *timer)
 {
     tuya_list_del(&(timer->node));
@@ -65,28 +292,44 @@ static void __timer_attach(TIMER_T *timer)
     }
 }
 
-static void __timer_dump(void)
+static void __timer_collect(uint64_t nowMS, SYS_TIME_T *next_expired)
 {
-    struct tuya_list_head *p = NULL;
     TIMER_T *timer = NULL;
-    TAL_TIMER_CB *cb = NULL;
-    TIMER_ID *timer_id = NULL;
+    struct tuya_list_head *p = NULL;
+    struct tuya_list_head *n = NULL;
 
-    TIME_S nowSecTime = 0;
-    TIME_MS nowMsTime = 0;
+    *next_expired = SEM_WAIT_FOREVER;
 
-    tal_time_get_system_time(&nowSecTime, &nowMsTime);
+    tuya_list_for_each_safe(p, n, &(s_timer_mgr.list_active))
+    {
+        timer = tuya_list_entry(p, TIMER_T, node);
 
-    if (nowSecTime < 30) {
-        return;
+        if (timer->expire_time > nowMS) {
+            *next_expired = timer->expire_time - nowMS;
+            break;
+        }
+
+        tuya_list_del(&(timer->node));
+        tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_expired));
     }
+}
 
-    PR_NOTICE("current time:%d%03d", nowSecTime, nowMsTime);
+static void __timer_dump_list(LIST_HEAD *list);
 
-    tal_mutex_lock(s_timer_mgr.mutex);
+static void __timer_dump_active(void)
+{
+    __timer_dump_list(&(s_timer_mgr.list_active));
+}
+#endif
 
-    PR_NOTICE("running timers count:%d", s_timer_mgr.running_cnt);
-    tuya_list_for_each(p, &(s_timer_mgr.list_active))
+static void __timer_dump_list(LIST_HEAD *list)
+{
+    struct tuya_list_head *p = NULL;
+    TIMER_T *timer = NULL;
+    TAL_TIMER_CB *cb = NULL;
+    TIMER_ID *timer_id = NULL;
+
+    tuya_list_for_each(p, list)
     {
         timer = tuya_list_entry(p, TIMER_T, node);
         cb = &(timer->cb);
@@ -98,75 +341,82 @@ static void __timer_dump(void)
         }
         PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
     }
+}
 
-    PR_NOTICE("standby timers count:%d", s_timer_mgr.total_cnt - s_timer_mgr.running_cnt);
-    tuya_list_for_each(p, &(s_timer_mgr.list_standby))
-    {
-        timer = tuya_list_entry(p, TIMER_T, node);
-        cb = &(timer->cb);
-        if (timer->data) {
-            timer_id = timer->data;
-            if (*timer_id == timer->timer_id) {
-                cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
-            }
-        }
-        PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
+static void __timer_dump(void)
+{
+    TIME_S nowSecTime = 0;
+    TIME_MS nowMsTime = 0;
+
+    tal_time_get_system_time(&nowSecTime, &nowMsTime);
+
+    if (nowSecTime < 30) {
+        return;
     }
 
+    PR_NOTICE("current time:%d%03d", nowSecTime, nowMsTime);
+
+    tal_mutex_lock(s_timer_mgr.mutex);
+
+    PR_NOTICE("running timers count:%d", s_timer_mgr.running_cnt);
+    __timer_dump_active();
+    __timer_dump_list(&(s_timer_mgr.list_expired));
+
+    PR_NOTICE("standby timers count:%d", s_timer_mgr.total_cnt - s_timer_mgr.running_cnt);
+    __timer_dump_list(&(s_timer_mgr.list_standby));
+
     tal_mutex_unlock(s_timer_mgr.mutex);
 }
 
 static void __timer_dispatch(SYS_TIME_T *next_expired)
 {
-    TIME_S nowSecTime = 0;
-    TIME_MS nowMsTime = 0;
     uint64_t nowMS = 0;
     TIMER_T *timer = NULL;
     TAL_TIMER_CB timer_cb = NULL;
-    struct tuya_list_head *p = NULL;
+    TIMER_ID timer_id = NULL;
+    void *timer_data = NULL;
 
-    *next_expired = SEM_WAIT_FOREVER;
-
-    do {
-        tal_time_get_system_time(&nowSecTime, &nowMsTime);
-        nowMS = (uint64_t)nowSecTime * 1000 + (uint64_t)nowMsTime;
+    while (1) {
+        nowMS = __timer_now_ms();
 
+        // move every due timer out of the active set in one go
         tal_mutex_lock(s_timer_mgr.mutex);
+        __timer_collect(nowMS, next_expired);
+        if (tuya_list_empty(&(s_timer_mgr.list_expired))) {
+            tal_mutex_unlock(s_timer_mgr.mutex);
+            break;
+        }
+        tal_mutex_unlock(s_timer_mgr.mutex);
 
-        timer_cb = NULL;
-        tuya_list_for_each(p, &(s_timer_mgr.list_active))
-        {
-            timer = tuya_list_entry(p, TIMER_T, node);
-
-            if (timer->expire_time > nowMS) {
-                p = &(s_timer_mgr.list_active);
-                *next_expired = timer->expire_time - nowMS;
-            } else {
-                timer_cb = timer->cb;
-
-                if (TAL_TIMER_ONCE == timer->type) {
-                    timer->is_running = FALSE;
-                    s_timer_mgr.running_cnt--;
-                    tuya_list_del(&(timer->node));
-                    tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
-                } else {
-                    timer->expire_time = nowMS + timer->interval;
-                    __timer_attach(timer);
-                }
+        // timers stopped or deleted by an earlier callback have already left list_expired
+        while (1) {
+            tal_mutex_lock(s_timer_mgr.mutex);
+            if (tuya_list_empty(&(s_timer_mgr.list_expired))) {
+                tal_mutex_unlock(s_timer_mgr.mutex);
+                break;
             }
 
-            break;
-        }
+            timer = tuya_list_entry(s_timer_mgr.list_expired.next, TIMER_T, node);
+            timer_cb = timer->cb;
+            timer_id = timer->timer_id;
+            timer_data = timer->data;
 
-        tal_mutex_unlock(s_timer_mgr.mutex);
+            if (TAL_TIMER_ONCE == timer->type) {
+                timer->is_running = FALSE;
+                s_timer_mgr.running_cnt--;
+                tuya_list_del(&(timer->node));
+                tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
+            } else {
+                timer->expire_time = nowMS + timer->interval;
+                __timer_attach(timer);
+            }
+            tal_mutex_unlock(s_timer_mgr.mutex);
 
-        if (timer_cb) {
             s_timer_mgr.last_cb = timer_cb;
-            timer_cb(timer->timer_id, timer->data);
-            timer_cb = NULL;
+            timer_cb(timer_id, timer_data);
             s_timer_mgr.last_cb = NULL;
         }
-    } while (p != &(s_timer_mgr.list_active));
+    }
 }
 
 static void __timer_thread_cb(void *data)
@@ -201,7 +451,18 @@ OPERATE_RET tal_sw_timer_init(void)
     tal_mutex_create_init(&s_timer_mgr.mutex);
     tal_semaphore_create_init(&s_timer_mgr.sem, 0, 2);
 
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+    uint8_t level = 0, slot = 0;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < TIMER_WHEEL_SIZE; slot++) {
+            INIT_LIST_HEAD(&(s_timer_mgr.wheel.slots[level][slot]));
+        }
+    }
+    s_timer_mgr.wheel.cur_tick = __timer_now_ms() / SW_TIMER_WHEEL_TICK_MS;
+#else
     INIT_LIST_HEAD(&(s_timer_mgr.list_active));
+#endif
+    INIT_LIST_HEAD(&(s_timer_mgr.list_expired));
     INIT_LIST_HEAD(&(s_timer_mgr.list_standby));
 
     THREAD_CFG_T thread_cfg = {.stackDepth = STACK_SIZE_TIMERQ, .priority = THREAD_PRIO_0, .thrdname = "sys_timer"};
@@ -240,6 +501,9 @@ OPERATE_RET tal_sw_timer_create(TAL_TIMER_CB func, void *arg, TIMER_ID *timer_id
     timer->cb = func;
     timer->data = arg;
     timer->timer_id = (TIMER_ID)timer;
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+    timer->level = TIMER_WHEEL_DETACHED;
+#endif
 
     tal_mutex_lock(s_timer_mgr.mutex);
     s_timer_mgr.total_cnt++;
@@ -270,7 +534,7 @@ OPERATE_RET tal_sw_timer_delete(TIMER_ID timer_id)
     TIMER_T *timer = (TIMER_T *)timer_id;
 
     tal_mutex_lock(s_timer_mgr.mutex);
-    tuya_list_del(&(timer->node));
+    __timer_detach(timer);
     s_timer_mgr.total_cnt--;
     if (timer->is_running) {
         s_timer_mgr.running_cnt--;
@@ -305,7 +569,7 @@ OPERATE_RET tal_sw_timer_stop(TIMER_ID timer_id)
         timer->is_running = FALSE;
 
         s_timer_mgr.running_cnt--;
-        tuya_list_del(&(timer->node));
+        __timer_detach(timer);
         tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
     }
     tal_mutex_unlock(s_timer_mgr.mutex);
@@ -395,10 +659,7 @@ OPERATE_RET tal_sw_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE ti
     }
 
     TIMER_T *timer = (TIMER_T *)timer_id;
-
-    TIME_S secTime = 0;
-    TIME_MS msTime = 0;
-    tal_time_get_system_time(&secTime, &msTime);
+    uint64_t nowMS = __timer_now_ms();
 
     tal_mutex_lock(s_timer_mgr.mutex);
 
@@ -412,7 +673,7 @@ OPERATE_RET tal_sw_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE ti
     }
 
     timer->type = timer_type;
-    timer->expire_time = (uint64_t)secTime * 1000 + (uint64_t)msTime + timer->interval;
+    timer->expire_time = nowMS + timer->interval;
     __timer_attach(timer);
 
     tal_mutex_unlock(s_timer_mgr.mutex);
@@ -442,8 +703,12 @@ OPERATE_RET tal_sw_timer_trigger(TIMER_ID timer_id)
     tal_mutex_lock(s_timer_mgr.mutex);
     timer->expire_time = 0;
     if (timer->is_running) {
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+        __timer_attach(timer);
+#else
         tuya_list_del(&(timer->node));
         tuya_list_add(&(timer->node), &(s_timer_mgr.list_active));
+#endif
     }
     tal_mutex_unlock(s_timer_mgr.mutex);
     tal_semaphore_post(s_timer_mgr.sem);
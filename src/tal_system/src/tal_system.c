@@ -127,6 +127,8 @@ void tal_system_sleep(uint32_t time_ms)
  */
 void tal_system_reset(void)
 {
+    // the deferred log lines would be lost
+    tal_log_flush();
     tkl_system_reset();
 }
 
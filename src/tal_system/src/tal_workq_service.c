@@ -15,6 +15,7 @@
  * - Dynamic allocation and scheduling of tasks within work queues.
  * - Thread-safe task submission and execution.
  * - Configurable task stack sizes and queue lengths.
+ * - An optional pool of worker threads serving the system work queue.
  *
  * The implementation utilizes static handles for system and high-priority work
  * queues, and defines configurable parameters for stack sizes and maximum
@@ -45,6 +46,10 @@
 #define STACK_SIZE_WORK_QUEUE (5 * 1024)
 #endif
 
+#ifndef WORKQ_SYSTEM_WORKER_NUM
+#define WORKQ_SYSTEM_WORKER_NUM 1
+#endif
+
 #ifndef STACK_SIZE_MSG_QUEUE
 #define STACK_SIZE_MSG_QUEUE (4 * 1024)
 #endif
@@ -73,7 +78,12 @@ OPERATE_RET tal_workq_init(void)
     thread_cfg.stackDepth += 1024;
 #endif
     thread_cfg.thrdname = "wq_system";
+#if (WORKQ_SYSTEM_WORKER_NUM > 1)
+    TUYA_CALL_ERR_GOTO(
+        tal_workqueue_create_pool(WORKQ_SYSTEM_WORKER_NUM, MAX_NODE_NUM_WORK_QUEUE, &thread_cfg, &wq_system), ERR_EXIT);
+#else
     TUYA_CALL_ERR_GOTO(tal_workqueue_create(MAX_NODE_NUM_WORK_QUEUE, &thread_cfg, &wq_system), ERR_EXIT);
+#endif
 
     thread_cfg.priority = THREAD_PRIO_1;
     thread_cfg.stackDepth = STACK_SIZE_MSG_QUEUE;
@@ -189,7 +199,14 @@ static BOOL_T _dump_cb(WORK_ITEM_T *item, void *ctx)
 
 void tal_workq_dump(WORKQ_SERVICE_E service)
 {
+    WORKQUEUE_STAT_T stat = {0};
+
     PR_NOTICE("---------workq-%d dump begin---------", service);
+    if (OPRT_OK == tal_workqueue_stat_get(tal_workq_get_handle(service), &stat)) {
+        PR_NOTICE("executed %d stolen %d wakeups %d queue ms max %d total %d run ms max %d total %d", stat.executed,
+                  stat.stolen, stat.wakeups, stat.queue_ms_max, stat.queue_ms_total, stat.run_ms_max,
+                  stat.run_ms_total);
+    }
     tal_workqueue_traverse(tal_workq_get_handle(service), _dump_cb, NULL);
     tal_thread_diagnose(tal_workqueue_get_thread(tal_workq_get_handle(service)));
     PR_NOTICE("---------workq-%d dump end---------", service);
@@ -16,6 +16,9 @@
  * - Implementation of the work queue thread callback for task execution.
  * - Synchronization mechanisms to ensure thread-safe operation and task
  * execution.
+ * - A pool variant with several workers, a deque per worker and priority,
+ * batched dequeue and work stealing between the workers.
+ * - Queue latency and run time counters.
  *
  * The implementation leverages Tuya's infrastructure components, such as
  * queues, threads, and semaphores, to provide a robust and efficient work queue
@@ -31,27 +34,91 @@
  *
  */
 
+#include <stdio.h>
 #include "tuya_queue.h"
 #include "tal_log.h"
 #include "tal_memory.h"
+#include "tal_mutex.h"
 #include "tal_thread.h"
 #include "tal_system.h"
 #include "tal_semaphore.h"
 #include "tal_workqueue.h"
 #include "tal_sw_timer.h"
 
+// items a pool worker takes per wake-up
+#ifndef WORKQUEUE_BATCH_NUM
+#define WORKQUEUE_BATCH_NUM 4
+#endif
+
+#define WORKQUEUE_NAME_LEN 16
+
+typedef struct {
+    WORK_ITEM_T item;      // keep first, traverse callbacks get a WORK_ITEM_T *
+    SYS_TIME_T enqueue_ms; // schedule time, used to record the queue latency
+} WORK_NODE_T;
+
+typedef struct {
+    WORK_NODE_T *node;
+    uint16_t head;
+    uint16_t cnt;
+} WORK_RING_T;
+
+struct tal_workqueue;
+
 typedef struct {
+    struct tal_workqueue *owner;
+    uint8_t index;
+    char name[WORKQUEUE_NAME_LEN];
+    THREAD_HANDLE thread;
+    SEM_HANDLE sem;
+    MUTEX_HANDLE mutex;                   // protects ring and batch
+    WORK_RING_T ring[WORKQUEUE_PRIO_NUM]; // deques, one per priority
+    WORK_NODE_T batch[WORKQUEUE_BATCH_NUM];
+    uint8_t batch_cnt;
+    volatile BOOL_T sleeping;
+    WORKQUEUE_CB last_cb; // used to debug which cb is blocked
+    WORKQUEUE_STAT_T stat;
+} WORK_WORKER_T;
+
+typedef struct tal_workqueue {
     TUYA_QUEUE_HANDLE queue;
     THREAD_HANDLE thread;
     SEM_HANDLE sem;
     WORKQUEUE_CB last_cb; // used to debug which cb is blocked
+    WORKQUEUE_STAT_T stat;
+
+    // pool variant, worker_num is 0 for the single thread workqueue
+    uint8_t worker_num;
+    uint8_t next_worker;
+    uint16_t ring_len;
+    WORK_WORKER_T *worker;
 } TAL_WORKQUEUE_T;
 
+static void __work_stat_record(WORKQUEUE_STAT_T *stat, WORK_NODE_T *node)
+{
+    SYS_TIME_T start = tal_system_get_millisecond();
+    uint32_t ms = start - node->enqueue_ms;
+
+    if (ms > stat->queue_ms_max) {
+        stat->queue_ms_max = ms;
+    }
+    stat->queue_ms_total += ms;
+
+    node->item.cb(node->item.data);
+
+    ms = tal_system_get_millisecond() - start;
+    if (ms > stat->run_ms_max) {
+        stat->run_ms_max = ms;
+    }
+    stat->run_ms_total += ms;
+    stat->executed++;
+}
+
 static void __work_thread_cb(void *data)
 {
     OPERATE_RET op_ret = OPRT_OK;
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)data;
-    WORK_ITEM_T work_item = {0};
+    WORK_NODE_T work_node = {0};
 
     while (THREAD_STATE_RUNNING == tal_thread_get_state(workqueue->thread)) {
         op_ret = tal_semaphore_wait(workqueue->sem, SEM_WAIT_FOREVER);
@@ -60,15 +127,15 @@ static void __work_thread_cb(void *data)
             continue;
         }
 
-        op_ret = tuya_queue_output(workqueue->queue, &work_item);
+        op_ret = tuya_queue_output(workqueue->queue, &work_node);
         if (OPRT_OK != op_ret) {
             tal_system_sleep(10);
             continue;
         }
 
-        if (work_item.cb) {
-            workqueue->last_cb = work_item.cb;
-            work_item.cb(work_item.data);
+        if (work_node.item.cb) {
+            workqueue->last_cb = work_node.item.cb;
+            __work_stat_record(&workqueue->stat, &work_node);
             workqueue->last_cb = NULL;
         }
     }
@@ -97,6 +164,224 @@ static BOOL_T __work_cancel_traverse(void *item, void *ctx)
     return TRUE;
 }
 
+/***********************************************************
+************************pool variant************************
+***********************************************************/
+static WORK_NODE_T *__ring_at(WORK_RING_T *ring, uint16_t ring_len, uint16_t i)
+{
+    return &ring->node[(ring->head + i) % ring_len];
+}
+
+static uint16_t __worker_pending(WORK_WORKER_T *worker)
+{
+    uint16_t num = worker->batch_cnt;
+
+    for (int prio = 0; prio < WORKQUEUE_PRIO_NUM; prio++) {
+        num += worker->ring[prio].cnt;
+    }
+
+    return num;
+}
+
+/* moves up to max items of the highest non-empty priority of src into the
+ * batch of dst, both mutexes held by the caller */
+static uint8_t __worker_take(TAL_WORKQUEUE_T *workqueue, WORK_WORKER_T *dst, WORK_WORKER_T *src, uint8_t max)
+{
+    WORK_RING_T *ring = NULL;
+    uint8_t num = 0;
+
+    for (int prio = 0; prio < WORKQUEUE_PRIO_NUM; prio++) {
+        ring = &src->ring[prio];
+        while (ring->cnt > 0 && num < max) {
+            dst->batch[num++] = *__ring_at(ring, workqueue->ring_len, 0);
+            ring->head = (ring->head + 1) % workqueue->ring_len;
+            ring->cnt--;
+        }
+        if (num > 0) {
+            break;
+        }
+    }
+    dst->batch_cnt = num;
+
+    return num;
+}
+
+/* takes half of the items of the first busy worker, mutexes are locked in
+ * worker order so two thieves never wait for each other */
+static uint8_t __worker_steal(TAL_WORKQUEUE_T *workqueue, WORK_WORKER_T *self)
+{
+    WORK_WORKER_T *victim = NULL, *first = NULL, *second = NULL;
+    uint16_t pending = 0;
+    uint8_t num = 0;
+
+    for (uint8_t i = 1; i < workqueue->worker_num && 0 == num; i++) {
+        victim = &workqueue->worker[(self->index + i) % workqueue->worker_num];
+        if (0 == __worker_pending(victim) - victim->batch_cnt) {
+            continue;
+        }
+
+        first = (victim->index < self->index) ? victim : self;
+        second = (victim->index < self->index) ? self : victim;
+        tal_mutex_lock(first->mutex);
+        tal_mutex_lock(second->mutex);
+        pending = __worker_pending(victim) - victim->batch_cnt;
+        num = __worker_take(workqueue, self, victim, (pending + 1) / 2 < WORKQUEUE_BATCH_NUM ? (pending + 1) / 2
+                                                                                         : WORKQUEUE_BATCH_NUM);
+        tal_mutex_unlock(second->mutex);
+        tal_mutex_unlock(first->mutex);
+    }
+    self->stat.stolen += num;
+
+    return num;
+}
+
+static uint8_t __worker_fill(TAL_WORKQUEUE_T *workqueue, WORK_WORKER_T *self)
+{
+    uint8_t num = 0;
+
+    tal_mutex_lock(self->mutex);
+    num = __worker_take(workqueue, self, self, WORKQUEUE_BATCH_NUM);
+    tal_mutex_unlock(self->mutex);
+
+    if (0 == num) {
+        num = __worker_steal(workqueue, self);
+    }
+
+    return num;
+}
+
+static void __pool_work_thread_cb(void *data)
+{
+    WORK_WORKER_T *self = (WORK_WORKER_T *)data;
+    TAL_WORKQUEUE_T *workqueue = self->owner;
+    WORK_NODE_T work_node = {0};
+    uint8_t num = 0;
+
+    while (THREAD_STATE_RUNNING == tal_thread_get_state(self->thread)) {
+        num = __worker_fill(workqueue, self);
+        if (0 == num) {
+            // announce the sleep before the last look, a schedule after it
+            // posts the semaphore
+            self->sleeping = TRUE;
+            num = __worker_fill(workqueue, self);
+            if (0 == num) {
+                tal_semaphore_wait(self->sem, SEM_WAIT_FOREVER);
+                self->sleeping = FALSE;
+                self->stat.wakeups++;
+                continue;
+            }
+            self->sleeping = FALSE;
+        }
+
+        for (uint8_t i = 0; i < num; i++) {
+            // the batch may be cancelled meanwhile, read it under the mutex
+            tal_mutex_lock(self->mutex);
+            work_node = self->batch[i];
+            tal_mutex_unlock(self->mutex);
+
+            if (work_node.item.cb) {
+                self->last_cb = work_node.item.cb;
+                __work_stat_record(&self->stat, &work_node);
+                self->last_cb = NULL;
+            }
+        }
+
+        tal_mutex_lock(self->mutex);
+        self->batch_cnt = 0;
+        tal_mutex_unlock(self->mutex);
+    }
+}
+
+static OPERATE_RET __pool_schedule(TAL_WORKQUEUE_T *workqueue, WORK_NODE_T *work_node, WORKQUEUE_PRIO_E prio,
+                                   BOOL_T front)
+{
+    WORK_WORKER_T *worker = NULL;
+    WORK_RING_T *ring = NULL;
+    BOOL_T is_self = FALSE;
+    uint16_t pending = 0;
+    uint8_t start = 0, i = 0;
+
+    // a worker scheduling more work keeps it local, others spread round robin
+    start = workqueue->next_worker++ % workqueue->worker_num;
+    for (i = 0; i < workqueue->worker_num; i++) {
+        if (OPRT_OK == tal_thread_is_self(workqueue->worker[i].thread, &is_self) && is_self) {
+            start = i;
+            break;
+        }
+    }
+
+    // a full deque overflows to the next worker
+    for (i = 0; i < workqueue->worker_num; i++) {
+        worker = &workqueue->worker[(start + i) % workqueue->worker_num];
+        ring = &worker->ring[prio];
+
+        tal_mutex_lock(worker->mutex);
+        if (ring->cnt < workqueue->ring_len) {
+            if (front) {
+                ring->head = (ring->head + workqueue->ring_len - 1) % workqueue->ring_len;
+                ring->node[ring->head] = *work_node;
+            } else {
+                *__ring_at(ring, workqueue->ring_len, ring->cnt) = *work_node;
+            }
+            ring->cnt++;
+            pending = __worker_pending(worker);
+            tal_mutex_unlock(worker->mutex);
+            break;
+        }
+        tal_mutex_unlock(worker->mutex);
+    }
+    if (i == workqueue->worker_num) {
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+
+    if (worker->sleeping) {
+        return tal_semaphore_post(worker->sem);
+    }
+
+    // the worker is busy, wake an idle one to steal the backlog
+    if (pending > 1) {
+        for (i = 0; i < workqueue->worker_num; i++) {
+            if (workqueue->worker[i].sleeping) {
+                return tal_semaphore_post(workqueue->worker[i].sem);
+            }
+        }
+    }
+
+    return OPRT_OK;
+}
+
+static void __pool_release(TAL_WORKQUEUE_T *workqueue)
+{
+    WORK_WORKER_T *worker = NULL;
+    uint32_t count = 1;
+
+    for (uint8_t i = 0; i < workqueue->worker_num; i++) {
+        worker = &workqueue->worker[i];
+        if (worker->thread) {
+            tal_thread_delete(worker->thread);
+            tal_semaphore_post(worker->sem);
+            while (THREAD_STATE_DELETE != tal_thread_get_state(worker->thread)) {
+                tal_system_sleep(10);
+                if ((count++) % 500 == 0) {
+                    PR_NOTICE("%p still running", worker->thread);
+                }
+            }
+        }
+        if (worker->sem) {
+            tal_semaphore_release(worker->sem);
+        }
+        if (worker->mutex) {
+            tal_mutex_release(worker->mutex);
+        }
+        if (worker->ring[0].node) {
+            tal_free(worker->ring[0].node);
+        }
+    }
+
+    tal_free(workqueue->worker);
+    tal_free(workqueue);
+}
+
 /**
  * @brief create and initialize a workqueue which runs in thread context
  *
@@ -122,7 +407,7 @@ OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_
         return OPRT_MALLOC_FAILED;
     }
 
-    op_ret = tuya_queue_create(queue_len, sizeof(WORK_ITEM_T), &workqueue->queue);
+    op_ret = tuya_queue_create(queue_len, sizeof(WORK_NODE_T), &workqueue->queue);
     if (OPRT_OK != op_ret) {
         tal_free(workqueue);
         return op_ret;
@@ -147,6 +432,85 @@ OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_
     return op_ret;
 }
 
+/**
+ * @brief create a workqueue served by a pool of worker threads
+ *
+ * @param[in] worker_num the number of worker threads
+ * @param[in] queue_len the maximum number of items of each priority that the
+ * workqueue can contain
+ * @param[in] thread_cfg thread param of the workers, the name gets the worker
+ * index appended
+ * @param[out] handle the workqueue handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_create_pool(const uint8_t worker_num, const uint16_t queue_len, THREAD_CFG_T *thread_cfg,
+                                      WORKQUEUE_HANDLE *handle)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TAL_WORKQUEUE_T *workqueue = NULL;
+    WORK_WORKER_T *worker = NULL;
+    THREAD_CFG_T worker_cfg;
+    uint8_t i = 0;
+    int prio = 0;
+
+    if ((0 == worker_num) || (0 == queue_len) || (NULL == thread_cfg) || (NULL == handle)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    workqueue = (TAL_WORKQUEUE_T *)tal_calloc(1, sizeof(TAL_WORKQUEUE_T));
+    if (NULL == workqueue) {
+        return OPRT_MALLOC_FAILED;
+    }
+
+    workqueue->worker = (WORK_WORKER_T *)tal_calloc(worker_num, sizeof(WORK_WORKER_T));
+    if (NULL == workqueue->worker) {
+        tal_free(workqueue);
+        return OPRT_MALLOC_FAILED;
+    }
+    workqueue->worker_num = worker_num;
+    workqueue->ring_len = (queue_len + worker_num - 1) / worker_num;
+
+    for (i = 0; i < worker_num; i++) {
+        worker = &workqueue->worker[i];
+        worker->owner = workqueue;
+        worker->index = i;
+
+        worker->ring[0].node = (WORK_NODE_T *)tal_calloc(WORKQUEUE_PRIO_NUM * workqueue->ring_len, sizeof(WORK_NODE_T));
+        if (NULL == worker->ring[0].node) {
+            rt = OPRT_MALLOC_FAILED;
+            goto __EXIT;
+        }
+        for (prio = 1; prio < WORKQUEUE_PRIO_NUM; prio++) {
+            worker->ring[prio].node = worker->ring[0].node + prio * workqueue->ring_len;
+        }
+
+        TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&worker->mutex), __EXIT);
+        TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&worker->sem, 0, 1), __EXIT);
+    }
+
+    // start the workers once they can all be stolen from
+    for (i = 0; i < worker_num; i++) {
+        worker = &workqueue->worker[i];
+        snprintf(worker->name, sizeof(worker->name), "%.12s%d", thread_cfg->thrdname ? thread_cfg->thrdname : "wq", i);
+        worker_cfg = *thread_cfg;
+        worker_cfg.thrdname = worker->name;
+        TUYA_CALL_ERR_GOTO(
+            tal_thread_create_and_start(&worker->thread, NULL, NULL, __pool_work_thread_cb, worker, &worker_cfg),
+            __EXIT);
+    }
+
+    *handle = workqueue;
+
+    return OPRT_OK;
+
+__EXIT:
+    __pool_release(workqueue);
+
+    return rt;
+}
+
 /**
  * @brief put work task in workqueue
  *
@@ -158,6 +522,21 @@ OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_
  * tuya_error_code.h
  */
 OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data)
+{
+    return tal_workqueue_schedule_prio(handle, cb, data, WORKQUEUE_PRIO_NORMAL);
+}
+
+/**
+ * @brief put work task in workqueue, instant will be dequeued first
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_schedule_instant(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data)
 {
     OPERATE_RET op_ret = OPRT_OK;
 
@@ -166,9 +545,13 @@ OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, voi
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    WORK_ITEM_T work_item = {.cb = cb, .data = data};
+    WORK_NODE_T work_node = {.item = {.cb = cb, .data = data}, .enqueue_ms = tal_system_get_millisecond()};
+
+    if (workqueue->worker_num) {
+        return __pool_schedule(workqueue, &work_node, WORKQUEUE_PRIO_HIGH, TRUE);
+    }
 
-    op_ret = tuya_queue_input(workqueue->queue, &work_item);
+    op_ret = tuya_queue_input_instant(workqueue->queue, &work_node);
     if (OPRT_OK == op_ret) {
         op_ret = tal_semaphore_post(workqueue->sem);
     }
@@ -177,27 +560,37 @@ OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, voi
 }
 
 /**
- * @brief put work task in workqueue, instant will be dequeued first
+ * @brief put work task in workqueue with a priority
  *
  * @param[in] handle the workqueue handle
  * @param[in] cb the work callback
  * @param[in] data the work data
+ * @param[in] prio the work priority, a single thread workqueue puts
+ * WORKQUEUE_PRIO_HIGH in front and the others at the back
  *
  * @return OPRT_OK on success. Others on error, please refer to
  * tuya_error_code.h
  */
-OPERATE_RET tal_workqueue_schedule_instant(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data)
+OPERATE_RET tal_workqueue_schedule_prio(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data, WORKQUEUE_PRIO_E prio)
 {
     OPERATE_RET op_ret = OPRT_OK;
 
-    if ((NULL == handle) || (NULL == cb)) {
+    if ((NULL == handle) || (NULL == cb) || (prio >= WORKQUEUE_PRIO_NUM)) {
         return OPRT_INVALID_PARM;
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    WORK_ITEM_T work_item = {.cb = cb, .data = data};
+    WORK_NODE_T work_node = {.item = {.cb = cb, .data = data}, .enqueue_ms = tal_system_get_millisecond()};
+
+    if (workqueue->worker_num) {
+        return __pool_schedule(workqueue, &work_node, prio, FALSE);
+    }
 
-    op_ret = tuya_queue_input_instant(workqueue->queue, &work_item);
+    if (WORKQUEUE_PRIO_HIGH == prio) {
+        op_ret = tuya_queue_input_instant(workqueue->queue, &work_node);
+    } else {
+        op_ret = tuya_queue_input(workqueue->queue, &work_node);
+    }
     if (OPRT_OK == op_ret) {
         op_ret = tal_semaphore_post(workqueue->sem);
     }
@@ -224,6 +617,10 @@ OPERATE_RET tal_workqueue_cancel(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
     WORK_ITEM_T work_item = {.cb = cb, .data = data};
 
+    if (workqueue->worker_num) {
+        return tal_workqueue_traverse(handle, (WORKQUEUE_TRAVERSE_CB)__work_cancel_traverse, &work_item);
+    }
+
     return tuya_queue_traverse(workqueue->queue, __work_cancel_traverse, &work_item);
 }
 
@@ -244,7 +641,31 @@ OPERATE_RET tal_workqueue_traverse(WORKQUEUE_HANDLE handle, WORKQUEUE_TRAVERSE_C
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    return tuya_queue_traverse(workqueue->queue, (TRAVERSE_CB)cb, ctx);
+    WORK_WORKER_T *worker = NULL;
+    WORK_RING_T *ring = NULL;
+    BOOL_T next = TRUE;
+
+    if (0 == workqueue->worker_num) {
+        return tuya_queue_traverse(workqueue->queue, (TRAVERSE_CB)cb, ctx);
+    }
+
+    // the batches of the workers are not run yet, they are traversed too
+    for (uint8_t i = 0; i < workqueue->worker_num && next; i++) {
+        worker = &workqueue->worker[i];
+        tal_mutex_lock(worker->mutex);
+        for (uint8_t j = 0; j < worker->batch_cnt && next; j++) {
+            next = cb(&worker->batch[j].item, ctx);
+        }
+        for (int prio = 0; prio < WORKQUEUE_PRIO_NUM && next; prio++) {
+            ring = &worker->ring[prio];
+            for (uint16_t j = 0; j < ring->cnt && next; j++) {
+                next = cb(&__ring_at(ring, workqueue->ring_len, j)->item, ctx);
+            }
+        }
+        tal_mutex_unlock(worker->mutex);
+    }
+
+    return OPRT_OK;
 }
 
 /**
@@ -261,12 +682,71 @@ uint16_t tal_workqueue_get_num(WORKQUEUE_HANDLE handle)
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    WORK_WORKER_T *worker = NULL;
+    uint16_t num = 0;
+
+    if (0 == workqueue->worker_num) {
+        if (workqueue->last_cb) {
+            PR_NOTICE("%p:last_cb %p", workqueue->thread, workqueue->last_cb);
+        }
 
-    if (workqueue->last_cb) {
-        PR_NOTICE("%p:last_cb %p", workqueue->thread, workqueue->last_cb);
+        return tuya_queue_get_used_num(workqueue->queue);
     }
 
-    return tuya_queue_get_used_num(workqueue->queue);
+    for (uint8_t i = 0; i < workqueue->worker_num; i++) {
+        worker = &workqueue->worker[i];
+        if (worker->last_cb) {
+            PR_NOTICE("%p:last_cb %p", worker->thread, worker->last_cb);
+        }
+        tal_mutex_lock(worker->mutex);
+        num += __worker_pending(worker);
+        tal_mutex_unlock(worker->mutex);
+    }
+
+    return num;
+}
+
+/**
+ * @brief get the counters of the workqueue, summed over its workers
+ *
+ * @param[in] handle the workqueue handle
+ * @param[out] stat the counters
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_stat_get(WORKQUEUE_HANDLE handle, WORKQUEUE_STAT_T *stat)
+{
+    if (NULL == handle || NULL == stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    WORKQUEUE_STAT_T *src = NULL;
+
+    if (0 == workqueue->worker_num) {
+        memcpy(stat, &workqueue->stat, sizeof(WORKQUEUE_STAT_T));
+        return OPRT_OK;
+    }
+
+    // the counters are written by their worker only, a snapshot is good enough
+    memset(stat, 0, sizeof(WORKQUEUE_STAT_T));
+    for (uint8_t i = 0; i < workqueue->worker_num; i++) {
+        src = &workqueue->worker[i].stat;
+        stat->executed += src->executed;
+        stat->stolen += src->stolen;
+        stat->wakeups += src->wakeups;
+        stat->queue_ms_total += src->queue_ms_total;
+        stat->run_ms_total += src->run_ms_total;
+        if (src->queue_ms_max > stat->queue_ms_max) {
+            stat->queue_ms_max = src->queue_ms_max;
+        }
+        if (src->run_ms_max > stat->run_ms_max) {
+            stat->run_ms_max = src->run_ms_max;
+        }
+    }
+
+    return OPRT_OK;
 }
 
 /**
@@ -287,6 +767,11 @@ OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle)
     uint32_t count = 1;
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
 
+    if (workqueue->worker_num) {
+        __pool_release(workqueue);
+        return OPRT_OK;
+    }
+
     op_ret = tal_thread_delete(workqueue->thread);
     if (OPRT_OK != op_ret) {
         return op_ret;
@@ -309,7 +794,7 @@ OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle)
 }
 
 /**
- * @brief get thread handle of the workqueue
+ * @brief get thread handle of the workqueue, the first worker of a pool
  *
  * @param[in] handle the workqueue handle
  *
@@ -322,6 +807,10 @@ THREAD_HANDLE tal_workqueue_get_thread(WORKQUEUE_HANDLE handle)
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    if (workqueue->worker_num) {
+        return workqueue->worker[0].thread;
+    }
+
     return workqueue->thread;
 }
 
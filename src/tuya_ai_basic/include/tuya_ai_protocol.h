@@ -395,6 +395,12 @@ typedef struct {
 } AI_EVENT_ONE_SHOT_T;
 #pragma pack()
 
+typedef struct {
+    uint32_t packets; // packets written to the transporter
+    uint32_t bytes;   // bytes written to the transporter
+    uint32_t copied;  // payload bytes copied before encryption
+} AI_SEND_STAT_T;
+
 /**
  * @brief send ai client hello
  *
@@ -688,4 +694,11 @@ void tuya_ai_basic_pkt_free(char *data);
  * @return
  */
 void tuya_ai_basic_set_frag_flag(bool flag);
+
+/**
+ * @brief get send statistics
+ *
+ * @param[out] stat packets/bytes sent and payload bytes copied since init
+ */
+void tuya_ai_basic_get_send_stat(AI_SEND_STAT_T *stat);
 #endif
\ No newline at end of file
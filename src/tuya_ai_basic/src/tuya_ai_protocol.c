@@ -28,6 +28,8 @@
 #include "tuya_transporter.h"
 #include "mbedtls/hkdf.h"
 #include "mbedtls/chacha20.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/constant_time.h"
 #include "mix_method.h"
 #include "tuya_iot.h"
 #include "cJSON.h"
@@ -64,9 +66,33 @@
 typedef struct {
     AI_FRAG_FLAG frag_flag;
     uint32_t offset;
+    uint32_t size;
     char *data;
 } AI_RECV_FRAG_MNG_T;
 
+typedef enum {
+    AI_RECV_HEAD = 0, // fixed packet head
+    AI_RECV_LEN,      // optional iv and packet length
+    AI_RECV_BODY,     // payload and signature
+} AI_RECV_STATE_E;
+
+/**
+ * receive parser state, kept across tuya_ai_basic_pkt_read calls so a read
+ * timeout in the middle of a packet resumes where it stopped
+ **/
+typedef struct {
+    AI_RECV_STATE_E state;
+    uint32_t offset;      // raw bytes of the current packet in recv_buf
+    uint32_t need;        // raw bytes the current state waits for
+    uint32_t head_len;
+    uint32_t payload_len;
+    AI_FRAG_FLAG frag_flag;
+    uint32_t crypt_in;    // payload bytes already fed to the cipher
+    uint32_t plain_len;   // plain text bytes written to plain
+    char *plain;          // plain text destination
+    uint8_t sign_data[64]; // sign input, picked up before the raw bytes are overwritten
+} AI_RECV_CTX_T;
+
 typedef struct {
     uint32_t offset;
 } AI_SEND_FRAG_MNG_T;
@@ -89,7 +115,14 @@ typedef struct {
     AI_RECV_FRAG_MNG_T recv_frag_mng;
     AI_SEND_FRAG_MNG_T send_frag_mng[2]; // 0:image,1:file
     bool frag_flag;
+#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
+    mbedtls_gcm_context gcm_ctx;      // keyed once per crypt key, reused for every packet
+    mbedtls_gcm_context gcm_recv_ctx; // decrypt side, the recv thread owns it
+#endif
+    AI_SEND_STAT_T send_stat;
+    AI_RECV_CTX_T recv_ctx;
     char recv_buf[AI_MAX_FRAGMENT_LENGTH + AI_ADD_PKT_LEN];
+    char send_buf[AI_MAX_FRAGMENT_LENGTH]; // packets are built and encrypted in place here
 } AI_BASIC_PROTO_T;
 
 static AI_BASIC_PROTO_T *ai_basic_proto = NULL;
@@ -144,6 +177,16 @@ static OPERATE_RET __ai_generate_crypt_key()
     rt = mbedtls_hkdf(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const unsigned char *)slat, salt_len,
                       (const unsigned char *)ikm, ikm_len, (const unsigned char *)info, info_len,
                       (unsigned char *)ai_basic_proto->crypt_key, AI_KEY_LEN);
+#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
+    if (OPRT_OK == rt) {
+        rt = mbedtls_gcm_setkey(&ai_basic_proto->gcm_ctx, MBEDTLS_CIPHER_ID_AES,
+                                (const unsigned char *)ai_basic_proto->crypt_key, AI_KEY_LEN * 8);
+    }
+    if (OPRT_OK == rt) {
+        rt = mbedtls_gcm_setkey(&ai_basic_proto->gcm_recv_ctx, MBEDTLS_CIPHER_ID_AES,
+                                (const unsigned char *)ai_basic_proto->crypt_key, AI_KEY_LEN * 8);
+    }
+#endif
     return rt;
 }
 
@@ -201,6 +244,10 @@ static void __ai_basic_proto_deinit(void)
         if (ai_basic_proto->mutex) {
             tal_mutex_release(ai_basic_proto->mutex);
         }
+#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
+        mbedtls_gcm_free(&ai_basic_proto->gcm_ctx);
+        mbedtls_gcm_free(&ai_basic_proto->gcm_recv_ctx);
+#endif
         __ai_atop_cfg_free();
         if (ai_basic_proto->connection_id) {
             OS_FREE(ai_basic_proto->connection_id);
@@ -236,6 +283,7 @@ static void __ai_basic_proto_reinit(void)
     ai_basic_proto->sl = AI_PACKET_SECURITY_LEVEL;
     memset(ai_basic_proto->decrypt_iv, 0, AI_IV_LEN);
     memset(&ai_basic_proto->recv_frag_mng, 0, sizeof(ai_basic_proto->recv_frag_mng));
+    memset(&ai_basic_proto->recv_ctx, 0, sizeof(ai_basic_proto->recv_ctx));
     tal_mutex_unlock(ai_basic_proto->mutex);
     PR_NOTICE("ai proto reinit success");
     return;
@@ -250,6 +298,10 @@ static OPERATE_RET __ai_basic_proto_init(void)
         ai_basic_proto = OS_MALLOC(sizeof(AI_BASIC_PROTO_T));
         TUYA_CHECK_NULL_RETURN(ai_basic_proto, OPRT_MALLOC_FAILED);
         memset(ai_basic_proto, 0, sizeof(AI_BASIC_PROTO_T));
+#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
+        mbedtls_gcm_init(&ai_basic_proto->gcm_ctx);
+        mbedtls_gcm_init(&ai_basic_proto->gcm_recv_ctx);
+#endif
         TUYA_CALL_ERR_GOTO(__ai_generate_crypt_key(), EXIT);
         TUYA_CALL_ERR_GOTO(__ai_generate_sign_key(), EXIT);
         TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&ai_basic_proto->mutex), EXIT);
@@ -526,136 +578,134 @@ static int __ai_encrypt_add_pkcs(char *p, uint32_t len)
     return (len + cz);
 }
 
-static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *data, uint32_t len, char *output, uint32_t *en_len)
+/**
+ * sl4 is decrypted while the packet streams in (__ai_recv_decrypt), the other
+ * levels go through here once the whole payload is received; output may be data
+ **/
+static OPERATE_RET __ai_decrypt_packet(char *data, uint32_t len, char *output, uint32_t *de_len)
 {
     OPERATE_RET rt = OPRT_OK;
-    int data_out_len = 0;
     char *key = __ai_get_crypt_key();
     TUYA_CHECK_NULL_RETURN(key, OPRT_COM_ERROR);
 
-    AI_PACKET_SL sl = __ai_get_sl(type, false);
+    AI_PACKET_SL sl = __ai_get_sl(0, true);
     if (sl == AI_PACKET_SL2) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL2)
-        memcpy(output, data, len);
-        data_out_len = __ai_encrypt_add_pkcs(output, len);
         char nonce[12] = {0};
-        memcpy(nonce, ai_basic_proto->encrypt_iv, sizeof(nonce));
+        memcpy(nonce, ai_basic_proto->decrypt_iv, sizeof(nonce));
         rt = mbedtls_chacha20_crypt((uint8_t *)key, (uint8_t *)nonce, 0, len, (uint8_t *)data, (uint8_t *)output);
         if (OPRT_OK != rt) {
             PR_ERR("chacha20_crypt error:%d", rt);
             return rt;
         }
-        *en_len = data_out_len;
+        *de_len = len - output[len - 1];
 #endif
     } else if (sl == AI_PACKET_SL3) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL3)
-        memcpy(output, data, len);
-        data_out_len = tal_pkcs7padding_buffer((uint8_t *)output, len);
-        rt = tal_aes256_cbc_encode_raw((uint8_t *)output, data_out_len, (uint8_t *)key,
-                                       (uint8_t *)ai_basic_proto->encrypt_iv, (uint8_t *)output);
+        rt = tal_aes256_cbc_decode_raw((uint8_t *)data, len, (uint8_t *)key, (uint8_t *)ai_basic_proto->decrypt_iv,
+                                       (uint8_t *)output);
         if (OPRT_OK != rt) {
-            PR_ERR("aes128_cbc_encode error:%d", rt);
+            PR_ERR("aes128_cbc_decode error:%d", rt);
             return rt;
         }
-        *en_len = data_out_len;
-#endif
-    } else if (sl == AI_PACKET_SL4) {
-#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
-        uint8_t tag[AI_GCM_TAG_LEN] = {0};
-        memcpy(output, data, len);
-        data_out_len = __ai_encrypt_add_pkcs(output, len);
-
-        const cipher_params_t en_input = {
-            .cipher_type = MBEDTLS_CIPHER_AES_256_GCM,
-            .key = (unsigned char *)key,
-            .key_len = AI_KEY_LEN,
-            .nonce = (uint8_t *)ai_basic_proto->encrypt_iv,
-            .nonce_len = AI_IV_LEN,
-            .ad = NULL,
-            .ad_len = 0,
-            .data = (uint8_t *)output,
-            .data_len = data_out_len,
-        };
-        rt = mbedtls_cipher_auth_encrypt_wrapper(&en_input, (uint8_t *)output, (size_t *)en_len, tag, sizeof(tag));
-        if (rt != OPRT_OK) {
-            PR_ERR("aes128_gcm_encode error:%x", rt);
-        }
-        memcpy(output + *en_len, tag, sizeof(tag));
-        *en_len += sizeof(tag);
-        // tuya_debug_hex_dump("encrypt_data", 64, (uint8_t *)output, *en_len);
+        *de_len = len - output[len - 1];
 #endif
     } else if (sl == AI_PACKET_SL0) {
-        AI_PROTO_D("sl:%d do not need crypt", sl);
-        memcpy(output, data, len);
-        *en_len = len;
+        AI_PROTO_D("sl:%d do not need crypt ", sl);
+        if (output != data) {
+            memcpy(output, data, len);
+        }
+        *de_len = len;
     } else {
-        PR_ERR("sl:%d err", sl);
+        AI_PROTO_D("sl:%d err", sl);
         rt = OPRT_COM_ERROR;
     }
 
     return rt;
 }
 
-static OPERATE_RET __ai_decrypt_packet(char *data, uint32_t len, char *output, uint32_t *de_len)
+static OPERATE_RET __ai_encrypt_payload(AI_PACKET_PT type, char *buf, uint32_t head_len, char *data,
+                                        uint32_t data_len, uint32_t *en_len)
 {
     OPERATE_RET rt = OPRT_OK;
+    uint32_t len = head_len + data_len;
     char *key = __ai_get_crypt_key();
     TUYA_CHECK_NULL_RETURN(key, OPRT_COM_ERROR);
 
-    AI_PACKET_SL sl = __ai_get_sl(0, true);
+    AI_PACKET_SL sl = __ai_get_sl(type, false);
     if (sl == AI_PACKET_SL2) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL2)
+        // the pkcs padding stays in plain text, only head and data are xored
         char nonce[12] = {0};
-        memcpy(nonce, ai_basic_proto->decrypt_iv, sizeof(nonce));
-        rt = mbedtls_chacha20_crypt((uint8_t *)key, (uint8_t *)nonce, 0, len, (uint8_t *)data, (uint8_t *)output);
+        mbedtls_chacha20_context ctx;
+        memcpy(nonce, ai_basic_proto->encrypt_iv, sizeof(nonce));
+        mbedtls_chacha20_init(&ctx);
+        rt = mbedtls_chacha20_setkey(&ctx, (uint8_t *)key);
+        if (OPRT_OK == rt) {
+            rt = mbedtls_chacha20_starts(&ctx, (uint8_t *)nonce, 0);
+        }
+        if (OPRT_OK == rt) {
+            rt = mbedtls_chacha20_update(&ctx, head_len, (uint8_t *)buf, (uint8_t *)buf);
+        }
+        if (OPRT_OK == rt) {
+            rt = mbedtls_chacha20_update(&ctx, data_len, (uint8_t *)data, (uint8_t *)(buf + head_len));
+        }
+        mbedtls_chacha20_free(&ctx);
         if (OPRT_OK != rt) {
             PR_ERR("chacha20_crypt error:%d", rt);
             return rt;
         }
-        *de_len = len - output[len - 1];
+        *en_len = __ai_encrypt_add_pkcs(buf, len);
 #endif
     } else if (sl == AI_PACKET_SL3) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL3)
-        rt = tal_aes256_cbc_decode_raw((uint8_t *)data, len, (uint8_t *)key, (uint8_t *)ai_basic_proto->decrypt_iv,
-                                       (uint8_t *)output);
+        // cbc chains whole blocks, the data has to sit behind the head first
+        memcpy(buf + head_len, data, data_len);
+        ai_basic_proto->send_stat.copied += data_len;
+        *en_len = tal_pkcs7padding_buffer((uint8_t *)buf, len);
+        rt = tal_aes256_cbc_encode_raw((uint8_t *)buf, *en_len, (uint8_t *)key, (uint8_t *)ai_basic_proto->encrypt_iv,
+                                       (uint8_t *)buf);
         if (OPRT_OK != rt) {
-            PR_ERR("aes128_cbc_decode error:%d", rt);
+            PR_ERR("aes128_cbc_encode error:%d", rt);
             return rt;
         }
-        *de_len = len - output[len - 1];
 #endif
     } else if (sl == AI_PACKET_SL4) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
-        // tuya_debug_hex_dump("decrypt_data", 64, (uint8_t *)data, len - AI_GCM_TAG_LEN);
-        // tuya_debug_hex_dump("decrypt_key", 64, (uint8_t *)key, AI_KEY_LEN);
-        // tuya_debug_hex_dump("decrypt_iv", 64, (uint8_t *)ai_basic_proto->decrypt_iv, AI_IV_LEN);
-        // tuya_debug_hex_dump("decrypt_tag", 64, (uint8_t *)(data + len - AI_GCM_TAG_LEN), AI_GCM_TAG_LEN);
-        const cipher_params_t de_input = {
-            .cipher_type = MBEDTLS_CIPHER_AES_256_GCM,
-            .key = (unsigned char *)key,
-            .key_len = AI_KEY_LEN,
-            .nonce = (uint8_t *)ai_basic_proto->decrypt_iv,
-            .nonce_len = AI_IV_LEN,
-            .ad = NULL,
-            .ad_len = 0,
-            .data = (uint8_t *)data,
-            .data_len = len - AI_GCM_TAG_LEN,
-        };
-
-        rt = mbedtls_cipher_auth_decrypt_wrapper(&de_input, (uint8_t *)output, (size_t *)de_len,
-                                                 (uint8_t *)(data + len - AI_GCM_TAG_LEN), AI_GCM_TAG_LEN);
-        if (rt != OPRT_OK) {
-            PR_ERR("aes128_gcm_decode error:%x", rt);
+        // stream head (in place), data and padding through gcm straight into the send buffer
+        mbedtls_gcm_context *ctx = &ai_basic_proto->gcm_ctx;
+        uint8_t pkcs[16];
+        uint32_t pad_len = 16 - len % 16;
+        size_t olen = 0;
+        memset(pkcs, pad_len, pad_len);
+
+        rt = mbedtls_gcm_starts(ctx, MBEDTLS_GCM_ENCRYPT, (uint8_t *)ai_basic_proto->encrypt_iv, AI_IV_LEN);
+        if (OPRT_OK == rt) {
+            rt = mbedtls_gcm_update(ctx, (uint8_t *)buf, head_len, (uint8_t *)buf, head_len, &olen);
+        }
+        if (OPRT_OK == rt) {
+            rt = mbedtls_gcm_update(ctx, (uint8_t *)data, data_len, (uint8_t *)(buf + head_len), data_len, &olen);
+        }
+        if (OPRT_OK == rt) {
+            rt = mbedtls_gcm_update(ctx, pkcs, pad_len, (uint8_t *)(buf + len), pad_len, &olen);
+        }
+        *en_len = len + pad_len;
+        if (OPRT_OK == rt) {
+            rt = mbedtls_gcm_finish(ctx, NULL, 0, &olen, (uint8_t *)(buf + *en_len), AI_GCM_TAG_LEN);
+        }
+        if (OPRT_OK != rt) {
+            PR_ERR("aes128_gcm_encode error:%x", rt);
             return rt;
         }
-        *de_len = *de_len - output[*de_len - 1];
+        *en_len += AI_GCM_TAG_LEN;
 #endif
     } else if (sl == AI_PACKET_SL0) {
-        AI_PROTO_D("sl:%d do not need crypt ", sl);
-        memcpy(output, data, len);
-        *de_len = len;
+        AI_PROTO_D("sl:%d do not need crypt", sl);
+        memcpy(buf + head_len, data, data_len);
+        ai_basic_proto->send_stat.copied += data_len;
+        *en_len = len;
     } else {
-        AI_PROTO_D("sl:%d err", sl);
+        PR_ERR("sl:%d err", sl);
         rt = OPRT_COM_ERROR;
     }
 
@@ -666,14 +716,10 @@ static OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, char *payload_buf,
                                      AI_FRAG_FLAG frag, uint32_t origin_len)
 {
     OPERATE_RET rt = OPRT_OK;
-    uint32_t idx = 0, attr_len = 0, packet_len = 0;
+    uint32_t idx = 0, attr_len = 0;
     uint32_t offset = 0;
     TUYA_CHECK_NULL_RETURN(info, OPRT_INVALID_PARM);
-    packet_len = __ai_get_send_payload_len(info, frag);
-
-    char *buf = OS_MALLOC(packet_len);
-    TUYA_CHECK_NULL_RETURN(buf, OPRT_MALLOC_FAILED);
-    memset(buf, 0, packet_len);
+    char *buf = payload_buf;
 
     if (tuya_ai_is_need_attr(frag)) {
         AI_PAYLOAD_HEAD_T payload_head = {0};
@@ -714,7 +760,6 @@ static OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, char *payload_buf,
                     memcpy(buf + offset, info->attrs[idx]->value.str, attr_idx_len);
                 } else {
                     PR_ERR("unknow payload type:%d", payload_type);
-                    OS_FREE(buf);
                     return OPRT_COM_ERROR;
                 }
                 offset += attr_idx_len;
@@ -728,17 +773,14 @@ static OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, char *payload_buf,
         offset += sizeof(info->len);
     }
 
-    memcpy(buf + offset, info->data, info->len);
-    offset += info->len;
-    AI_PROTO_D("payload len:%d, offset:%d", packet_len, offset);
+    AI_PROTO_D("payload len:%d, offset:%d", offset + info->len, offset);
 
-    // tuya_debug_hex_dump("payload_uncrypt", 64, (uint8_t *)buf, packet_len);
-    rt = __ai_encrypt_packet(info->type, buf, packet_len, payload_buf, payload_len);
+    // the payload head is already in place, data is encrypted from the caller's buffer
+    rt = __ai_encrypt_payload(info->type, buf, offset, info->data, info->len, payload_len);
     if (OPRT_OK != rt) {
         PR_ERR("encrypt packet failed, rt:%d", rt);
     }
 
-    OS_FREE(buf);
     return rt;
 }
 
@@ -852,7 +894,6 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
     OPERATE_RET rt = OPRT_OK;
     uint32_t payload_len = 0, offset = 0;
     AI_PACKET_SL sl = __ai_get_sl(info->type, false);
-    uint8_t signature[AI_SIGN_LEN] = {0};
     if (ai_basic_proto->sequence_out >= 0xFFFF) {
         ai_basic_proto->sequence_out = 1;
     }
@@ -864,9 +905,8 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
         PR_ERR("send packet too long, len: %d", uncrypt_len);
         return OPRT_COM_ERROR;
     }
-    char *send_pkt_buf = OS_MALLOC(uncrypt_len);
-    TUYA_CHECK_NULL_RETURN(send_pkt_buf, OPRT_MALLOC_FAILED);
-    memset(send_pkt_buf, 0, uncrypt_len);
+    // every byte up to offset is written below, no need to clear the buffer
+    char *send_pkt_buf = ai_basic_proto->send_buf;
 
     uint32_t head_len = sizeof(AI_PACKET_HEAD_T);
     // AI_PROTO_D("head len:%d", head_len);
@@ -891,7 +931,7 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
 
     rt = __ai_pack_payload(info, send_pkt_buf + offset, &payload_len, frag, origin_len);
     if (OPRT_OK != rt) {
-        goto EXIT;
+        return rt;
     }
     length = UNI_HTONL(payload_len + AI_SIGN_LEN);
 
@@ -901,12 +941,11 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
         memcpy(send_pkt_buf + head_len, &length, sizeof(length));
     }
 
-    rt = __ai_packet_sign(send_pkt_buf, signature);
+    offset += payload_len;
+    rt = __ai_packet_sign(send_pkt_buf, (uint8_t *)(send_pkt_buf + offset));
     if (OPRT_OK != rt) {
-        goto EXIT;
+        return rt;
     }
-    offset += payload_len;
-    memcpy(send_pkt_buf + offset, signature, AI_SIGN_LEN);
     offset += AI_SIGN_LEN;
 
     AI_PROTO_D("send packet len:%d", payload_len + AI_SIGN_LEN);
@@ -920,14 +959,24 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
     if (rt != offset) {
         PR_ERR("send to cloud failed, rt:%d, len:%d", rt, offset);
     } else {
+        ai_basic_proto->send_stat.packets++;
+        ai_basic_proto->send_stat.bytes += offset;
         rt = OPRT_OK;
     }
 
-EXIT:
-    OS_FREE(send_pkt_buf);
     return rt;
 }
 
+void tuya_ai_basic_get_send_stat(AI_SEND_STAT_T *stat)
+{
+    if (!ai_basic_proto || !stat) {
+        return;
+    }
+    tal_mutex_lock(ai_basic_proto->mutex);
+    memcpy(stat, &ai_basic_proto->send_stat, sizeof(AI_SEND_STAT_T));
+    tal_mutex_unlock(ai_basic_proto->mutex);
+}
+
 void tuya_ai_free_attribute(AI_ATTRIBUTE_T *attr)
 {
     if (!attr) {
@@ -1373,61 +1422,17 @@ OPERATE_RET tuya_ai_basic_conn_close(AI_STATUS_CODE code)
     return rt;
 }
 
-static int __ai_baisc_read_pkt_head(char *recv_buf)
+static bool __ai_recv_buf_owned(char *data)
 {
-    int offset = sizeof(AI_PACKET_HEAD_T);
-    int need_recv_len = offset;
-    int total_recv_len = 0;
-    int recv_len = 0;
-
-    while (total_recv_len < need_recv_len) {
-        recv_len = tuya_transporter_read(ai_basic_proto->transporter, (uint8_t *)recv_buf + total_recv_len,
-                                         need_recv_len - total_recv_len, AI_DEFAULT_TIMEOUT_MS);
-        if (recv_len <= 0) {
-            if (total_recv_len == 0) {
-                return recv_len;
-            } else {
-                if (recv_len == OPRT_RESOURCE_NOT_READY) {
-                    continue;
-                } else {
-                    PR_ERR("recv head err, rt:%d, %d", recv_len, need_recv_len);
-                    return OPRT_COM_ERROR;
-                }
-            }
-        }
-        total_recv_len += recv_len;
-    }
-
-    need_recv_len = sizeof(uint32_t);
-    AI_PACKET_HEAD_T *head = (AI_PACKET_HEAD_T *)recv_buf;
-    if (head->iv_flag) {
-        need_recv_len += AI_IV_LEN;
-    }
-
-    total_recv_len = 0;
-    while (total_recv_len < need_recv_len) {
-        recv_len = tuya_transporter_read(ai_basic_proto->transporter, (uint8_t *)recv_buf + offset + total_recv_len,
-                                         need_recv_len - total_recv_len, AI_DEFAULT_TIMEOUT_MS);
-        if (recv_len <= 0) {
-            if (recv_len == OPRT_RESOURCE_NOT_READY) {
-                continue;
-            }
-            PR_ERR("recv length err, rt:%d, %d", recv_len, need_recv_len);
-            return OPRT_COM_ERROR;
-        }
-        total_recv_len += recv_len;
-    }
-    offset += need_recv_len;
-
-    if (head->iv_flag) {
-        memcpy(ai_basic_proto->decrypt_iv, recv_buf + sizeof(AI_PACKET_HEAD_T), AI_IV_LEN);
-    }
-    // AI_PROTO_D("recv head len:%d", offset);
-    return offset;
+    return (data >= ai_basic_proto->recv_buf) && (data < ai_basic_proto->recv_buf + sizeof(ai_basic_proto->recv_buf));
 }
 
 void tuya_ai_basic_pkt_free(char *data)
 {
+    if (__ai_recv_buf_owned(data)) {
+        // plain text decrypted in place, the buffer is reused by the next read
+        return;
+    }
     if (data == ai_basic_proto->recv_frag_mng.data) {
         OS_FREE(data);
         ai_basic_proto->recv_frag_mng.data = NULL;
@@ -1450,195 +1455,381 @@ static bool __ai_basic_get_frag_flag(void)
 {
     return ai_basic_proto->frag_flag;
 }
-OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *out_frag)
+
+static void __ai_recv_reset(void)
+{
+    memset(&ai_basic_proto->recv_ctx, 0, sizeof(AI_RECV_CTX_T));
+}
+
+static bool __ai_recv_pending(void)
+{
+    AI_RECV_CTX_T *ctx = &ai_basic_proto->recv_ctx;
+    AI_FRAG_FLAG frag_flag = ai_basic_proto->recv_frag_mng.frag_flag;
+    return (ctx->state != AI_RECV_HEAD) || (ctx->offset != 0) || (frag_flag == AI_PACKET_FRAG_START) ||
+           (frag_flag == AI_PACKET_FRAG_ING);
+}
+
+static void __ai_recv_sign_window(uint32_t from, uint32_t to, uint32_t win, uint32_t win_len, uint8_t *dst)
+{
+    uint32_t start = MAX(from, win);
+    uint32_t end = MIN(to, win + win_len);
+    if (start < end) {
+        memcpy(dst + start - win, ai_basic_proto->recv_buf + start, end - start);
+    }
+}
+
+static void __ai_recv_sign_collect(uint32_t from, uint32_t to)
+{
+    // same bytes as __ai_packet_sign: the whole packet up to 64 bytes, else the first and the last 32
+    AI_RECV_CTX_T *ctx = &ai_basic_proto->recv_ctx;
+    uint32_t total = ctx->head_len + ctx->payload_len;
+    if (total <= sizeof(ctx->sign_data)) {
+        __ai_recv_sign_window(from, to, 0, total, ctx->sign_data);
+    } else {
+        __ai_recv_sign_window(from, to, 0, 32, ctx->sign_data);
+        __ai_recv_sign_window(from, to, total - 32, 32, ctx->sign_data + 32);
+    }
+}
+
+static OPERATE_RET __ai_recv_sign_check(void)
 {
     OPERATE_RET rt = OPRT_OK;
     uint8_t calc_sign[AI_SIGN_LEN] = {0};
-    uint8_t packet_sign[AI_SIGN_LEN] = {0};
-    char *decrypt_buf = NULL;
-    char *recv_buf = ai_basic_proto->recv_buf;
-    TUYA_CHECK_NULL_RETURN(recv_buf, OPRT_COM_ERROR);
+    AI_RECV_CTX_T *ctx = &ai_basic_proto->recv_ctx;
+    char *sign_key = __ai_get_sign_key();
+    TUYA_CHECK_NULL_RETURN(sign_key, OPRT_COM_ERROR);
 
-    memset(recv_buf, 0, sizeof(ai_basic_proto->recv_buf));
-    AI_PROTO_D("recv packet ing");
-    int recv_len = __ai_baisc_read_pkt_head(recv_buf);
-    if (recv_len <= 0) {
-        goto EXIT;
+    uint32_t sign_len = MIN(ctx->head_len + ctx->payload_len, sizeof(ctx->sign_data));
+    rt = tal_sha256_mac((uint8_t *)sign_key, AI_KEY_LEN, ctx->sign_data, sign_len, calc_sign);
+    if (OPRT_OK != rt) {
+        PR_ERR("packet sign failed, rt:%d", rt);
+        return rt;
+    }
+    if (memcmp(calc_sign, ai_basic_proto->recv_buf + ctx->head_len + ctx->payload_len, sizeof(calc_sign))) {
+        PR_ERR("packet sign error");
+        return OPRT_RESOURCE_NOT_READY;
     }
+    AI_PROTO_D("sign ok");
+    return OPRT_OK;
+}
 
-    AI_PACKET_HEAD_T *head = (AI_PACKET_HEAD_T *)recv_buf;
-    AI_PROTO_D("recv packet ver:%d", head->version);
-    AI_PROTO_D("recv packet seq:%d", UNI_NTOHS(head->sequence));
-    AI_PROTO_D("recv packet frag:%d", head->frag_flag);
-    AI_PROTO_D("recv packet sl:%d", head->security_level);
-    AI_PROTO_D("recv packet iv flag:%d", head->iv_flag);
+/**
+ * @brief pick where the payload plain text goes once the packet head is known
+ *
+ * sl4 decrypts into the start of recv_buf, trailing the cipher text by the
+ * head length as gcm requires, or straight behind the reassembled fragments.
+ * the other levels decrypt in place when the payload is complete.
+ */
+static OPERATE_RET __ai_recv_body_start(AI_FRAG_FLAG frag_flag)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_RECV_CTX_T *ctx = &ai_basic_proto->recv_ctx;
 
-    uint32_t head_len = __ai_get_head_len(recv_buf);
-    uint32_t packet_len = __ai_get_packet_len(recv_buf);
+    ctx->plain = ai_basic_proto->recv_buf + ctx->head_len;
+#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
+    if (__ai_get_sl(0, true) == AI_PACKET_SL4) {
+        AI_RECV_FRAG_MNG_T *frag = &ai_basic_proto->recv_frag_mng;
+        if (ctx->payload_len < AI_GCM_TAG_LEN) {
+            PR_ERR("recv packet too short, payload len:%u", ctx->payload_len);
+            return OPRT_COM_ERROR;
+        }
+        ctx->plain = ai_basic_proto->recv_buf;
+        if (!__ai_basic_get_frag_flag() && frag->data &&
+            ((frag_flag == AI_PACKET_FRAG_ING) || (frag_flag == AI_PACKET_FRAG_END))) {
+            if (frag->offset + ctx->payload_len > frag->size) {
+                PR_ERR("frag overflow, offset:%u, payload len:%u, size:%u", frag->offset, ctx->payload_len,
+                       frag->size);
+                return OPRT_COM_ERROR;
+            }
+            ctx->plain = frag->data + frag->offset;
+        }
+        rt = mbedtls_gcm_starts(&ai_basic_proto->gcm_recv_ctx, MBEDTLS_GCM_DECRYPT,
+                                (uint8_t *)ai_basic_proto->decrypt_iv, AI_IV_LEN);
+        if (OPRT_OK != rt) {
+            PR_ERR("gcm starts error:%x", rt);
+        }
+    }
+#endif
+    return rt;
+}
 
-    AI_PROTO_D("recv head len:%d", head_len);
-    AI_PROTO_D("recv packet len:%d", packet_len);
+static OPERATE_RET __ai_recv_decrypt(bool finish)
+{
+    OPERATE_RET rt = OPRT_OK;
+#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
+    AI_RECV_CTX_T *ctx = &ai_basic_proto->recv_ctx;
+    mbedtls_gcm_context *gcm = &ai_basic_proto->gcm_recv_ctx;
+    uint32_t cipher_len = ctx->payload_len - AI_GCM_TAG_LEN;
+    uint32_t avail = MIN(ctx->offset - ctx->head_len, cipher_len);
+    size_t olen = 0;
 
-    if (packet_len + head_len > sizeof(ai_basic_proto->recv_buf)) {
-        PR_ERR("recv packet too long, pkt len:%u, head len:%u", packet_len, head_len);
-        recv_len = OPRT_RESOURCE_NOT_READY;
-        goto EXIT;
+    if (__ai_get_sl(0, true) != AI_PACKET_SL4) {
+        return OPRT_OK;
     }
 
-    uint16_t sequence = UNI_NTOHS(head->sequence);
-    if (sequence <= ai_basic_proto->sequence_in) {
-        PR_ERR("sequence error, in:%d, pre:%d", sequence, ai_basic_proto->sequence_in);
-        goto EXIT;
+    if (avail > ctx->crypt_in) {
+        uint32_t len = avail - ctx->crypt_in;
+        rt = mbedtls_gcm_update(gcm, (uint8_t *)(ai_basic_proto->recv_buf + ctx->head_len + ctx->crypt_in), len,
+                                (uint8_t *)(ctx->plain + ctx->plain_len), len + 15, &olen);
+        if (OPRT_OK != rt) {
+            PR_ERR("gcm update error:%x", rt);
+            return rt;
+        }
+        ctx->crypt_in = avail;
+        ctx->plain_len += olen;
+    }
+    if (finish) {
+        uint8_t tag[AI_GCM_TAG_LEN] = {0};
+        rt = mbedtls_gcm_finish(gcm, (uint8_t *)(ctx->plain + ctx->plain_len), 15, &olen, tag, sizeof(tag));
+        if (OPRT_OK != rt) {
+            PR_ERR("gcm finish error:%x", rt);
+            return rt;
+        }
+        ctx->plain_len += olen;
+        if (mbedtls_ct_memcmp(tag, ai_basic_proto->recv_buf + ctx->head_len + cipher_len, sizeof(tag))) {
+            PR_ERR("aes128_gcm_decode tag error");
+            return OPRT_COM_ERROR;
+        }
+    }
+#endif
+    return rt;
+}
+
+static OPERATE_RET __ai_recv_plain(uint32_t *de_len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_RECV_CTX_T *ctx = &ai_basic_proto->recv_ctx;
+
+    if (__ai_get_sl(0, true) == AI_PACKET_SL4) {
+        rt = __ai_recv_decrypt(true);
+        if (OPRT_OK != rt) {
+            return rt;
+        }
+        uint8_t pad = (ctx->plain_len > 0) ? (uint8_t)ctx->plain[ctx->plain_len - 1] : 0;
+        if ((pad == 0) || (pad > ctx->plain_len)) {
+            PR_ERR("decrypt padding error:%d, %d", pad, ctx->plain_len);
+            return OPRT_COM_ERROR;
+        }
+        *de_len = ctx->plain_len - pad;
+    } else {
+        rt = __ai_decrypt_packet(ctx->plain, ctx->payload_len, ctx->plain, de_len);
     }
+    return rt;
+}
+
+/**
+ * @brief feed the socket into the receive state machine until one packet is complete
+ *
+ * @return OPRT_OK when a whole packet is in recv_buf, OPRT_RESOURCE_NOT_READY when
+ * the read timed out (the parsed part is kept for the next call), others on error
+ */
+static OPERATE_RET __ai_recv_packet(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_RECV_CTX_T *ctx = &ai_basic_proto->recv_ctx;
+    char *recv_buf = ai_basic_proto->recv_buf;
+    AI_PACKET_HEAD_T *head = (AI_PACKET_HEAD_T *)recv_buf;
+    int recv_len = 0;
 
-    ai_basic_proto->sequence_in = sequence;
-    if (sequence >= 0xFFFF) {
-        ai_basic_proto->sequence_in = 0;
+    if (ctx->state == AI_RECV_HEAD) {
+        ctx->need = sizeof(AI_PACKET_HEAD_T);
     }
 
-    uint32_t continue_recv_len = 0;
-    int offset = recv_len;
-    while (packet_len + head_len > offset) {
-        continue_recv_len = packet_len + head_len - offset;
-        recv_len = tuya_transporter_read(ai_basic_proto->transporter, (uint8_t *)(recv_buf + offset), continue_recv_len,
-                                         AI_DEFAULT_TIMEOUT_MS);
-        if (recv_len <= 0) {
-            if (recv_len == OPRT_RESOURCE_NOT_READY) {
+    while (1) {
+        if (ctx->offset < ctx->need) {
+            recv_len = tuya_transporter_read(ai_basic_proto->transporter, (uint8_t *)(recv_buf + ctx->offset),
+                                             ctx->need - ctx->offset, AI_DEFAULT_TIMEOUT_MS);
+            if (recv_len <= 0) {
+                if ((ctx->state == AI_RECV_HEAD) && (ctx->offset == 0)) {
+                    return (recv_len == 0) ? OPRT_RESOURCE_NOT_READY : recv_len;
+                }
+                if (recv_len == OPRT_RESOURCE_NOT_READY) {
+                    return recv_len;
+                }
+                PR_ERR("recv packet err, rt:%d, state:%d, %d/%d", recv_len, ctx->state, ctx->offset, ctx->need);
+                return OPRT_COM_ERROR;
+            }
+            if (ctx->state == AI_RECV_BODY) {
+                __ai_recv_sign_collect(ctx->offset, ctx->offset + recv_len);
+            }
+            ctx->offset += recv_len;
+            if (ctx->state == AI_RECV_BODY) {
+                TUYA_CALL_ERR_RETURN(__ai_recv_decrypt(false));
+            }
+            if (ctx->offset < ctx->need) {
                 continue;
             }
-            PR_ERR("continue read failed, rt:%d, %d", recv_len, continue_recv_len);
-            goto EXIT;
         }
-        offset += recv_len;
-    }
 
-    rt = __ai_packet_sign(recv_buf, calc_sign);
-    if (OPRT_OK != rt) {
-        PR_ERR("packet sign failed, rt:%d", rt);
-        goto EXIT;
-    }
+        if (ctx->state == AI_RECV_HEAD) {
+            AI_PROTO_D("recv packet ver:%d", head->version);
+            AI_PROTO_D("recv packet seq:%d", UNI_NTOHS(head->sequence));
+            AI_PROTO_D("recv packet frag:%d", head->frag_flag);
+            AI_PROTO_D("recv packet sl:%d", head->security_level);
+            AI_PROTO_D("recv packet iv flag:%d", head->iv_flag);
+            ctx->head_len = __ai_get_head_len(recv_buf);
+            ctx->need = ctx->head_len;
+            ctx->state = AI_RECV_LEN;
+        } else if (ctx->state == AI_RECV_LEN) {
+            uint32_t packet_len = __ai_get_packet_len(recv_buf);
+            AI_PROTO_D("recv head len:%d", ctx->head_len);
+            AI_PROTO_D("recv packet len:%d", packet_len);
+            if ((packet_len < AI_SIGN_LEN) || (packet_len + ctx->head_len > sizeof(ai_basic_proto->recv_buf))) {
+                PR_ERR("recv packet len error, pkt len:%u, head len:%u", packet_len, ctx->head_len);
+                return OPRT_COM_ERROR;
+            }
 
-    AI_PROTO_D("sign ok");
-    uint32_t payload_len = __ai_get_payload_len(recv_buf);
-    char *payload = recv_buf + head_len;
-    memcpy(packet_sign, payload + payload_len, AI_SIGN_LEN);
-    if (memcmp(calc_sign, packet_sign, sizeof(calc_sign))) {
-        PR_ERR("packet sign error");
-        // tuya_debug_hex_dump("calc_sign", AI_SIGN_LEN, calc_sign, AI_SIGN_LEN);
-        // tuya_debug_hex_dump("packet_sign", AI_SIGN_LEN, packet_sign, AI_SIGN_LEN);
-        recv_len = OPRT_RESOURCE_NOT_READY;
-        goto EXIT;
+            uint16_t sequence = UNI_NTOHS(head->sequence);
+            if (sequence <= ai_basic_proto->sequence_in) {
+                PR_ERR("sequence error, in:%d, pre:%d", sequence, ai_basic_proto->sequence_in);
+                return OPRT_COM_ERROR;
+            }
+            ai_basic_proto->sequence_in = sequence;
+            if (sequence >= 0xFFFF) {
+                ai_basic_proto->sequence_in = 0;
+            }
+
+            if (head->iv_flag) {
+                memcpy(ai_basic_proto->decrypt_iv, recv_buf + sizeof(AI_PACKET_HEAD_T), AI_IV_LEN);
+            }
+            ctx->frag_flag = head->frag_flag;
+            ctx->payload_len = packet_len - AI_SIGN_LEN;
+            ctx->need = ctx->head_len + packet_len;
+            ctx->state = AI_RECV_BODY;
+            __ai_recv_sign_collect(0, ctx->head_len);
+            TUYA_CALL_ERR_RETURN(__ai_recv_body_start(ctx->frag_flag));
+        } else {
+            return rt;
+        }
     }
+}
 
+OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *out_frag)
+{
+    OPERATE_RET rt = OPRT_OK;
     uint32_t decrypt_len = 0;
-    decrypt_buf = OS_MALLOC(packet_len + head_len + AI_ADD_PKT_LEN);
-    TUYA_CHECK_NULL_RETURN(decrypt_buf, OPRT_MALLOC_FAILED);
-    memset(decrypt_buf, 0, packet_len + head_len + AI_ADD_PKT_LEN);
-    rt = __ai_decrypt_packet(payload, payload_len, decrypt_buf, &decrypt_len);
-    if (OPRT_OK != rt) {
-        PR_ERR("decrypt packet failed, rt:%d", rt);
-        goto EXIT;
-    }
-    AI_PROTO_D("decrypt len:%d", decrypt_len);
-    AI_PROTO_D("frag flag:%d, sdk frag flag:%d", head->frag_flag, __ai_basic_get_frag_flag());
+    AI_RECV_CTX_T *ctx = &ai_basic_proto->recv_ctx;
+    AI_RECV_FRAG_MNG_T *frag = &ai_basic_proto->recv_frag_mng;
+
+    AI_PROTO_D("recv packet ing");
+    while (1) {
+        rt = __ai_recv_packet();
+        if (OPRT_RESOURCE_NOT_READY == rt) {
+            // read timed out, whatever is parsed so far is kept for the next call
+            return rt;
+        }
+        if (OPRT_OK != rt) {
+            goto EXIT;
+        }
+
+        AI_FRAG_FLAG current_frag_flag = ctx->frag_flag;
+        TUYA_CALL_ERR_GOTO(__ai_recv_sign_check(), EXIT);
+        rt = __ai_recv_plain(&decrypt_len);
+        if (OPRT_OK != rt) {
+            PR_ERR("decrypt packet failed, rt:%d", rt);
+            goto EXIT;
+        }
+        AI_PROTO_D("decrypt len:%d", decrypt_len);
+        AI_PROTO_D("frag flag:%d, sdk frag flag:%d", current_frag_flag, __ai_basic_get_frag_flag());
+        char *plain = ctx->plain;
+        __ai_recv_reset();
+
+        if (__ai_basic_get_frag_flag()) {
+            // every fragment goes up as it is, no reassembly copy
+            *out = plain;
+            *out_len = decrypt_len;
+            *out_frag = current_frag_flag;
+            break;
+        }
 
-    if (!__ai_basic_get_frag_flag()) {
-        AI_FRAG_FLAG current_frag_flag = head->frag_flag;
-        AI_FRAG_FLAG last_frag_flag = ai_basic_proto->recv_frag_mng.frag_flag;
+        AI_FRAG_FLAG last_frag_flag = frag->frag_flag;
         if ((last_frag_flag == AI_PACKET_FRAG_START) || (last_frag_flag == AI_PACKET_FRAG_ING)) {
             if ((current_frag_flag != AI_PACKET_FRAG_ING) && (current_frag_flag != AI_PACKET_FRAG_END)) {
                 PR_ERR("recv start frag packet, but not continue %d, %d", current_frag_flag, last_frag_flag);
+                rt = OPRT_COM_ERROR;
                 goto EXIT;
             }
         }
 
-        AI_PROTO_D("frag flag:%d", head->frag_flag);
-        AI_PROTO_D("frag mng info, flag:%d, offset:%d", ai_basic_proto->recv_frag_mng.frag_flag,
-                   ai_basic_proto->recv_frag_mng.offset);
+        AI_PROTO_D("frag mng info, flag:%d, offset:%d", frag->frag_flag, frag->offset);
         if (current_frag_flag == AI_PACKET_FRAG_START) {
             uint32_t origin_len = 0, frag_offset = 0, attr_len = 0, frag_total_len = 0;
-            AI_PAYLOAD_HEAD_T *pkt_head = (AI_PAYLOAD_HEAD_T *)decrypt_buf;
+            AI_PAYLOAD_HEAD_T *pkt_head = (AI_PAYLOAD_HEAD_T *)plain;
             if (pkt_head->attribute_flag == AI_HAS_ATTR) {
                 frag_offset = sizeof(AI_PAYLOAD_HEAD_T);
-                memcpy(&attr_len, decrypt_buf + frag_offset, sizeof(attr_len));
+                memcpy(&attr_len, plain + frag_offset, sizeof(attr_len));
                 frag_offset += sizeof(attr_len);
                 attr_len = UNI_NTOHL(attr_len);
                 frag_offset += attr_len;
-                memcpy(&origin_len, decrypt_buf + frag_offset, sizeof(origin_len));
+                memcpy(&origin_len, plain + frag_offset, sizeof(origin_len));
                 origin_len = UNI_NTOHL(origin_len);
                 AI_PROTO_D("recv start frag packet with attr, origin len:%d", origin_len);
             } else {
-                memcpy(&origin_len, decrypt_buf + sizeof(AI_PAYLOAD_HEAD_T), sizeof(origin_len));
+                memcpy(&origin_len, plain + sizeof(AI_PAYLOAD_HEAD_T), sizeof(origin_len));
                 origin_len = UNI_NTOHL(origin_len);
                 AI_PROTO_D("recv start frag packet, origin len:%d", origin_len);
             }
             if (origin_len <= decrypt_len) {
                 PR_ERR("origin len error, origin len:%d, decrypt len:%d", origin_len, decrypt_len);
+                rt = OPRT_COM_ERROR;
                 goto EXIT;
             }
-            memset(&ai_basic_proto->recv_frag_mng, 0, sizeof(AI_RECV_FRAG_MNG_T));
-            ai_basic_proto->recv_frag_mng.frag_flag = current_frag_flag;
+            if (frag->data) {
+                OS_FREE(frag->data);
+            }
+            memset(frag, 0, sizeof(AI_RECV_FRAG_MNG_T));
             frag_total_len = origin_len + frag_offset + AI_ADD_PKT_LEN;
             AI_PROTO_D("frag_total_len %d", frag_total_len);
-            ai_basic_proto->recv_frag_mng.data = OS_MALLOC(frag_total_len);
-            if (!ai_basic_proto->recv_frag_mng.data) {
-                PR_ERR("malloc origin data failed len:%d", decrypt_len);
+            frag->data = OS_MALLOC(frag_total_len);
+            if (!frag->data) {
+                PR_ERR("malloc origin data failed len:%d", frag_total_len);
+                rt = OPRT_MALLOC_FAILED;
                 goto EXIT;
             }
-            AI_PROTO_D("malloc recv_frag_mng data addr %p", ai_basic_proto->recv_frag_mng.data);
-            memset(ai_basic_proto->recv_frag_mng.data, 0, frag_total_len);
-            memcpy(ai_basic_proto->recv_frag_mng.data, decrypt_buf, decrypt_len);
-            ai_basic_proto->recv_frag_mng.offset = decrypt_len;
-            OS_FREE(decrypt_buf);
-            decrypt_buf = NULL;
-            rt = tuya_ai_basic_pkt_read(out, out_len, out_frag);
-            if (rt != OPRT_OK) {
-                PR_ERR("read continue frag packet failed, rt:%d", rt);
+            AI_PROTO_D("malloc recv_frag_mng data addr %p", frag->data);
+            memcpy(frag->data, plain, decrypt_len);
+            frag->size = frag_total_len;
+            frag->offset = decrypt_len;
+            frag->frag_flag = current_frag_flag;
+        } else if ((current_frag_flag == AI_PACKET_FRAG_ING) || (current_frag_flag == AI_PACKET_FRAG_END)) {
+            if (!frag->data) {
+                PR_ERR("recv frag %d without start", current_frag_flag);
+                rt = OPRT_COM_ERROR;
                 goto EXIT;
             }
-        } else if (current_frag_flag == AI_PACKET_FRAG_ING) {
-            memcpy(ai_basic_proto->recv_frag_mng.data + ai_basic_proto->recv_frag_mng.offset, decrypt_buf, decrypt_len);
-            ai_basic_proto->recv_frag_mng.frag_flag = current_frag_flag;
-            ai_basic_proto->recv_frag_mng.offset += decrypt_len;
-            OS_FREE(decrypt_buf);
-            decrypt_buf = NULL;
-            rt = tuya_ai_basic_pkt_read(out, out_len, out_frag);
-            if (rt != OPRT_OK) {
-                PR_ERR("read continue ing frag packet failed, rt:%d", rt);
-                goto EXIT;
+            if (plain != frag->data + frag->offset) {
+                if (frag->offset + decrypt_len > frag->size) {
+                    PR_ERR("frag overflow, offset:%u, len:%u, size:%u", frag->offset, decrypt_len, frag->size);
+                    rt = OPRT_COM_ERROR;
+                    goto EXIT;
+                }
+                memcpy(frag->data + frag->offset, plain, decrypt_len);
+            }
+            frag->offset += decrypt_len;
+            frag->frag_flag = current_frag_flag;
+            if (current_frag_flag == AI_PACKET_FRAG_END) {
+                *out = frag->data;
+                *out_len = frag->offset;
+                *out_frag = AI_PACKET_NO_FRAG;
+                break;
             }
-        } else if (current_frag_flag == AI_PACKET_FRAG_END) {
-            memcpy(ai_basic_proto->recv_frag_mng.data + ai_basic_proto->recv_frag_mng.offset, decrypt_buf, decrypt_len);
-            ai_basic_proto->recv_frag_mng.frag_flag = current_frag_flag;
-            ai_basic_proto->recv_frag_mng.offset += decrypt_len;
-            OS_FREE(decrypt_buf);
-            decrypt_buf = NULL;
-            *out = ai_basic_proto->recv_frag_mng.data;
-            *out_len = ai_basic_proto->recv_frag_mng.offset;
-            *out_frag = AI_PACKET_NO_FRAG;
         } else {
-            *out = decrypt_buf;
+            *out = plain;
             *out_len = decrypt_len;
             *out_frag = AI_PACKET_NO_FRAG;
+            break;
         }
-    } else {
-        *out = decrypt_buf;
-        *out_len = decrypt_len;
-        *out_frag = head->frag_flag;
     }
     AI_PROTO_D("recv packet len:%d", *out_len);
     return rt;
 
 EXIT:
-    if (decrypt_buf) {
-        OS_FREE(decrypt_buf);
-        decrypt_buf = NULL;
+    __ai_recv_reset();
+    if (frag->data) {
+        OS_FREE(frag->data);
     }
-    if (ai_basic_proto->recv_frag_mng.data) {
-        OS_FREE(ai_basic_proto->recv_frag_mng.data);
-    }
-    memset(&ai_basic_proto->recv_frag_mng, 0, SIZEOF(AI_RECV_FRAG_MNG_T));
-    return recv_len;
+    memset(frag, 0, SIZEOF(AI_RECV_FRAG_MNG_T));
+    return rt;
 }
 
 OPERATE_RET tuya_parse_user_attrs(char *in, uint32_t attr_len, AI_ATTRIBUTE_T **attr_out, uint32_t *attr_num)
@@ -1751,7 +1942,9 @@ OPERATE_RET tuya_ai_auth_resp(void)
     uint32_t de_len = 0;
     AI_FRAG_FLAG frag = AI_PACKET_NO_FRAG;
 
-    rt = tuya_ai_basic_pkt_read(&de_buf, &de_len, &frag);
+    do {
+        rt = tuya_ai_basic_pkt_read(&de_buf, &de_len, &frag);
+    } while ((OPRT_RESOURCE_NOT_READY == rt) && __ai_recv_pending());
     if (OPRT_OK != rt) {
         PR_ERR("recv auth resp failed, rt:%d", rt);
         return rt;
@@ -1760,7 +1953,7 @@ OPERATE_RET tuya_ai_auth_resp(void)
     AI_PAYLOAD_HEAD_T *packet = (AI_PAYLOAD_HEAD_T *)de_buf;
     if (packet->attribute_flag != AI_HAS_ATTR) {
         PR_ERR("auth resp packet has no attribute");
-        OS_FREE(de_buf);
+        tuya_ai_basic_pkt_free(de_buf);
         return OPRT_COM_ERROR;
     }
 
@@ -1776,7 +1969,7 @@ OPERATE_RET tuya_ai_auth_resp(void)
         PR_ERR("auth resp packet type error %d", packet->type);
         rt = OPRT_COM_ERROR;
     }
-    OS_FREE(de_buf);
+    tuya_ai_basic_pkt_free(de_buf);
     return rt;
 }
 
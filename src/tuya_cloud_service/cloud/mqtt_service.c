@@ -34,6 +34,7 @@
 #include "crc32i.h"
 #include "tal_api.h"
 #include "tuya_protocol.h"
+#include "tuya_json_reader.h"
 
 static void on_subscribe_message_default(uint16_t msgid, const mqtt_client_message_t *msg, void *userdata);
 
@@ -92,11 +93,150 @@ static int tuya_mqtt_signature_tool(const tuya_meta_info_t *input, tuya_mqtt_acc
     return OPRT_OK;
 }
 
+/* -------------------------------------------------------------------------- */
+/*                         Subscribe topics and filters                       */
+/* -------------------------------------------------------------------------- */
+static uint32_t mqtt_topic_hash(const char *topic, size_t topic_length)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < topic_length; i++) {
+        hash = (hash ^ (uint8_t)topic[i]) * 16777619u;
+    }
+
+    return hash % TUYA_MQTT_SUBSCRIBE_HASH_NUM;
+}
+
+/* length of the level at topic, up to the next '/' */
+static size_t mqtt_topic_level_length(const char *level, const char *end)
+{
+    const char *p = level;
+
+    while (p < end && *p != '/') {
+        p++;
+    }
+    return p - level;
+}
+
+static mqtt_topic_node_t *mqtt_topic_node_get(mqtt_topic_node_t **list, const char *level, size_t level_length,
+                                              bool create)
+{
+    mqtt_topic_node_t *node = *list;
+
+    for (; node; node = node->next) {
+        if (node->level_length == level_length && !memcmp(node->level, level, level_length)) {
+            return node;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    node = tal_calloc(1, sizeof(mqtt_topic_node_t) + level_length);
+    if (!node) {
+        return NULL;
+    }
+    memcpy(node->level, level, level_length);
+    node->level_length = level_length;
+    node->next = *list;
+    *list = node;
+    return node;
+}
+
+/* frees the filter levels left without handles */
+static void mqtt_topic_node_prune(mqtt_topic_node_t **list)
+{
+    while (*list) {
+        mqtt_topic_node_t *node = *list;
+        mqtt_topic_node_prune(&node->child);
+        if (!node->child && !node->handles) {
+            *list = node->next;
+            tal_free(node);
+        } else {
+            list = &node->next;
+        }
+    }
+}
+
+/* the handles of a topic: a bucket of the table, or the last level of a filter */
+static mqtt_subscribe_handle_t **mqtt_subscribe_handles_get(tuya_mqtt_context_t *context, const char *topic,
+                                                            size_t topic_length, bool create)
+{
+    mqtt_topic_node_t **list = &context->subscribe_filters;
+    mqtt_topic_node_t *node = NULL;
+    const char *level = topic, *end = topic + topic_length;
+    size_t level_length = 0;
+
+    if (!memchr(topic, '+', topic_length) && !memchr(topic, '#', topic_length)) {
+        return &context->subscribe_table[mqtt_topic_hash(topic, topic_length)];
+    }
+
+    for (;;) {
+        level_length = mqtt_topic_level_length(level, end);
+        node = mqtt_topic_node_get(list, level, level_length, create);
+        if (!node) {
+            return NULL;
+        }
+        level += level_length;
+        if (level >= end) {
+            return &node->handles;
+        }
+        level++;
+        list = &node->child;
+    }
+}
+
+static void mqtt_subscribe_handles_call(mqtt_subscribe_handle_t *target, uint16_t msgid,
+                                        const mqtt_client_message_t *msg)
+{
+    for (; target; target = target->next) {
+        target->cb(msgid, msg, target->userdata);
+    }
+}
+
+/* walks the filter levels matching the topic from level on */
+static void mqtt_topic_filter_distribute(mqtt_topic_node_t *node, const char *topic, const char *level,
+                                         const char *end, uint16_t msgid, const mqtt_client_message_t *msg)
+{
+    size_t level_length = mqtt_topic_level_length(level, end);
+    bool last = (level + level_length >= end);
+    mqtt_topic_node_t *multi = NULL;
+
+    for (; node; node = node->next) {
+        bool wildcard = (1 == node->level_length && ('+' == node->level[0] || '#' == node->level[0]));
+
+        // wildcards at the first level do not match the topics starting with '$'
+        if (wildcard && level == topic && '$' == *topic) {
+            continue;
+        }
+        if (wildcard && '#' == node->level[0]) {
+            mqtt_subscribe_handles_call(node->handles, msgid, msg);
+            continue;
+        }
+        if (!wildcard && (node->level_length != level_length || memcmp(node->level, level, level_length))) {
+            continue;
+        }
+
+        if (!last) {
+            mqtt_topic_filter_distribute(node->child, topic, level + level_length + 1, end, msgid, msg);
+            continue;
+        }
+        mqtt_subscribe_handles_call(node->handles, msgid, msg);
+        // "a/#" also matches "a"
+        multi = mqtt_topic_node_get(&node->child, "#", 1, false);
+        if (multi) {
+            mqtt_subscribe_handles_call(multi->handles, msgid, msg);
+        }
+    }
+}
+
 /**
  * @brief Registers a callback function for handling MQTT subscribe messages.
  *
  * This function allows you to register a callback function that will be called
- * when an MQTT subscribe message is received.
+ * when an MQTT subscribe message is received. The topic may be a filter with
+ * the '+' and '#' wildcards.
  *
  * @param context The MQTT context.
  * @param topic The topic to subscribe to.
@@ -119,10 +259,23 @@ int tuya_mqtt_subscribe_message_callback_register(tuya_mqtt_context_t *context,
         return OPRT_COM_ERROR;
     }
 
+    if (!cb) {
+        cb = on_subscribe_message_default;
+    }
+    size_t topic_length = strlen(topic);
+
+    /* LOCK */
+    mqtt_subscribe_handle_t **handles = mqtt_subscribe_handles_get(context, topic, topic_length, true);
+    if (!handles) {
+        PR_ERR("malloc error");
+        mqtt_topic_node_prune(&context->subscribe_filters);
+        return OPRT_MALLOC_FAILED;
+    }
+
     /* Repetition filter */
-    mqtt_subscribe_handle_t *target = context->subscribe_list;
+    mqtt_subscribe_handle_t *target = *handles;
     while (target) {
-        if (!memcmp(target->topic, topic, target->topic_length) && target->cb == cb) {
+        if (target->topic_length == topic_length && !memcmp(target->topic, topic, topic_length) && target->cb == cb) {
             PR_WARN("Repetition:%s", topic);
             return OPRT_OK;
         }
@@ -131,24 +284,22 @@ int tuya_mqtt_subscribe_message_callback_register(tuya_mqtt_context_t *context,
 
     /* Intser new handle */
     mqtt_subscribe_handle_t *newtarget = tal_calloc(1, sizeof(mqtt_subscribe_handle_t));
-    if (!newtarget) {
+    if (newtarget) {
+        newtarget->topic = tal_calloc(1, topic_length + 1); // strdup
+    }
+    if (!newtarget || !newtarget->topic) {
         PR_ERR("malloc error");
+        tal_free(newtarget);
+        mqtt_topic_node_prune(&context->subscribe_filters);
         return OPRT_MALLOC_FAILED;
     }
 
-    newtarget->topic_length = strlen(topic);
-    newtarget->topic = tal_calloc(1, newtarget->topic_length + 1); // strdup
-    strcpy(newtarget->topic, topic);
-
-    if (cb) {
-        newtarget->cb = cb;
-    } else {
-        newtarget->cb = on_subscribe_message_default;
-    }
+    newtarget->topic_length = topic_length;
+    memcpy(newtarget->topic, topic, topic_length);
+    newtarget->cb = cb;
     newtarget->userdata = userdata;
-    /* LOCK */
-    newtarget->next = context->subscribe_list;
-    context->subscribe_list = newtarget;
+    newtarget->next = *handles;
+    *handles = newtarget;
     /* UNLOCK */
     return OPRT_OK;
 }
@@ -176,8 +327,8 @@ int tuya_mqtt_subscribe_message_callback_unregister(tuya_mqtt_context_t *context
 
     /* LOCK */
     /* Remove object form list */
-    mqtt_subscribe_handle_t **target = &context->subscribe_list;
-    while (*target) {
+    mqtt_subscribe_handle_t **target = mqtt_subscribe_handles_get(context, topic, topic_length, false);
+    while (target && *target) {
         mqtt_subscribe_handle_t *entry = *target;
         if (entry->topic_length == topic_length && !memcmp(topic, entry->topic, topic_length)) {
             *target = entry->next;
@@ -187,6 +338,7 @@ int tuya_mqtt_subscribe_message_callback_unregister(tuya_mqtt_context_t *context
             target = &entry->next;
         }
     }
+    mqtt_topic_node_prune(&context->subscribe_filters);
     /* UNLOCK */
 
     uint16_t msgid = mqtt_client_unsubscribe(context->mqtt_client, topic, MQTT_QOS_1);
@@ -204,18 +356,60 @@ static void mqtt_subscribe_message_distribute(tuya_mqtt_context_t *context, uint
     size_t topic_length = strlen(msg->topic);
 
     /* LOCK */
-    mqtt_subscribe_handle_t *target = context->subscribe_list;
+    mqtt_subscribe_handle_t *target = context->subscribe_table[mqtt_topic_hash(topic, topic_length)];
     for (; target; target = target->next) {
         if (target->topic_length == topic_length && !memcmp(topic, target->topic, target->topic_length)) {
             target->cb(msgid, msg, target->userdata);
         }
     }
+    if (context->subscribe_filters) {
+        mqtt_topic_filter_distribute(context->subscribe_filters, topic, topic, topic + topic_length, msgid, msg);
+    }
     /* UNLOCK */
 }
 
 /* -------------------------------------------------------------------------- */
 /*                       Tuya internal subscribe message                      */
 /* -------------------------------------------------------------------------- */
+/* reads protocol, t and the data span of the message envelope without a cJSON tree */
+static int tuya_protocol_envelope_read(char *jsonstr, size_t len, int *protocol_id, const char **data,
+                                       size_t *data_len)
+{
+    tuya_json_reader_t reader;
+    const char *key = NULL;
+    size_t key_len = 0;
+    bool has_protocol = false, has_t = false;
+    char *value = NULL;
+    int ret = 0;
+
+    *data = NULL;
+    tuya_json_reader_init(&reader, jsonstr, len);
+    if (OPRT_OK != tuya_json_reader_object_enter(&reader)) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+
+    while (1 == (ret = tuya_json_reader_object_next(&reader, &key, &key_len))) {
+        if (8 == key_len && 0 == memcmp(key, "protocol", 8) && TUYA_JSON_NUMBER == tuya_json_reader_peek(&reader)) {
+            ret = tuya_json_reader_int(&reader, protocol_id);
+            has_protocol = true;
+        } else if (4 == key_len && 0 == memcmp(key, "data", 4)) {
+            ret = tuya_json_reader_skip(&reader, &value, data_len);
+            *data = value;
+        } else {
+            ret = tuya_json_reader_skip(&reader, NULL, NULL);
+            has_t |= (1 == key_len && 't' == key[0]);
+        }
+        if (OPRT_OK != ret) {
+            return OPRT_CJSON_PARSE_ERR;
+        }
+    }
+    if (ret < 0) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+
+    return (has_protocol && has_t && *data) ? OPRT_OK : OPRT_CJSON_GET_ERR;
+}
+
 static int tuya_protocol_message_parse_process(tuya_mqtt_context_t *context, const uint8_t *payload, size_t payload_len)
 {
     int ret = OPRT_OK;
@@ -230,13 +424,48 @@ static int tuya_protocol_message_parse_process(tuya_mqtt_context_t *context, con
 
     PR_DEBUG("Data JSON:%s", jsonstr);
 
+    /* dispatch */
+    tuya_protocol_event_t event;
+    tuya_protocol_handle_t *target = NULL;
+    int protocol_id = 0;
+    bool raw_only = true;
+
+    memset(&event, 0, sizeof(event));
+
+    /* envelope, the cJSON tree is only built when a handler of the protocol needs it */
+    if (OPRT_OK == tuya_protocol_envelope_read(jsonstr, strlen(jsonstr), &protocol_id, &event.data_str,
+                                               &event.data_len)) {
+        /* LOCK */
+        for (target = context->protocol_list; target; target = target->next) {
+            if (target->id == protocol_id && !target->raw) {
+                raw_only = false;
+            }
+        }
+        /* UNLOCK */
+
+        if (raw_only) {
+            event.event_id = protocol_id;
+
+            /* LOCK */
+            for (target = context->protocol_list; target; target = target->next) {
+                if (target->id == protocol_id) {
+                    event.user_data = target->user_data, target->cb(&event);
+                }
+            }
+            /* UNLOCK */
+
+            tal_free(jsonstr);
+            return OPRT_OK;
+        }
+    }
+
     /* json parse */
     cJSON *root = NULL;
     cJSON *json = NULL;
     root = cJSON_Parse((const char *)jsonstr);
-    tal_free(jsonstr);
     if (NULL == root) {
         PR_ERR("JSON parse error");
+        tal_free(jsonstr);
         return OPRT_CJSON_PARSE_ERR;
     }
 
@@ -245,34 +474,34 @@ static int tuya_protocol_message_parse_process(tuya_mqtt_context_t *context, con
         (NULL == cJSON_GetObjectItem(root, "data"))) {
         PR_ERR("param is no correct");
         cJSON_Delete(root);
+        tal_free(jsonstr);
         return OPRT_CJSON_GET_ERR;
     }
 
     /* protocol ID */
-    int protocol_id = cJSON_GetObjectItem(root, "protocol")->valueint;
+    protocol_id = cJSON_GetObjectItem(root, "protocol")->valueint;
     json = cJSON_GetObjectItem(root, "data");
     if (NULL == json) {
         PR_ERR("get json err");
         cJSON_Delete(root);
+        tal_free(jsonstr);
         return OPRT_CJSON_GET_ERR;
     }
 
-    /* dispatch */
-    tuya_protocol_event_t event;
     event.event_id = protocol_id;
     event.root_json = root;
-    event.data = cJSON_GetObjectItem(root, "data");
+    event.data = json;
 
     /* LOCK */
-    tuya_protocol_handle_t *target = context->protocol_list;
-    for (; target; target = target->next) {
-        if (target->id == protocol_id) {
+    for (target = context->protocol_list; target; target = target->next) {
+        if (target->id == protocol_id && (!target->raw || event.data_str)) {
             event.user_data = target->user_data, target->cb(&event);
         }
     }
     /* UNLOCK */
 
     cJSON_Delete(root);
+    tal_free(jsonstr);
     return OPRT_OK;
 }
 
@@ -331,6 +560,67 @@ static void mqtt_client_subscribed_cb(void *client, uint16_t msgid, void *userda
     PR_DEBUG("Subscribe successed ID:%d", msgid);
 }
 
+/* -------------------------------------------------------------------------- */
+/*                        Publishes waiting for PUBACK                        */
+/* -------------------------------------------------------------------------- */
+static void mqtt_publish_handle_add(tuya_mqtt_context_t *context, mqtt_publish_handle_t *handle)
+{
+    handle->next = NULL;
+    handle->prev = context->publish_tail;
+    if (context->publish_tail) {
+        context->publish_tail->next = handle;
+    } else {
+        context->publish_list = handle;
+    }
+    context->publish_tail = handle;
+
+    if (handle->msgid <= 0) {
+        context->publish_unsent++;
+        return;
+    }
+    mqtt_publish_handle_t **bucket = &context->publish_table[handle->msgid % TUYA_MQTT_PUBLISH_HASH_NUM];
+    handle->hash_next = *bucket;
+    *bucket = handle;
+}
+
+/* indexes a handle by the msgid it was sent with */
+static void mqtt_publish_handle_sent(tuya_mqtt_context_t *context, mqtt_publish_handle_t *handle)
+{
+    mqtt_publish_handle_t **bucket = &context->publish_table[handle->msgid % TUYA_MQTT_PUBLISH_HASH_NUM];
+
+    context->publish_unsent--;
+    handle->hash_next = *bucket;
+    *bucket = handle;
+}
+
+static void mqtt_publish_handle_remove(tuya_mqtt_context_t *context, mqtt_publish_handle_t *handle)
+{
+    if (handle->msgid > 0) {
+        mqtt_publish_handle_t **bucket = &context->publish_table[handle->msgid % TUYA_MQTT_PUBLISH_HASH_NUM];
+        for (; *bucket; bucket = &(*bucket)->hash_next) {
+            if (*bucket == handle) {
+                *bucket = handle->hash_next;
+                break;
+            }
+        }
+    } else {
+        context->publish_unsent--;
+    }
+
+    if (handle->prev) {
+        handle->prev->next = handle->next;
+    } else {
+        context->publish_list = handle->next;
+    }
+    if (handle->next) {
+        handle->next->prev = handle->prev;
+    } else {
+        context->publish_tail = handle->prev;
+    }
+    tal_free(handle->payload);
+    tal_free(handle);
+}
+
 static void mqtt_client_puback_cb(void *client, uint16_t msgid, void *userdata)
 {
     client = client;
@@ -339,14 +629,11 @@ static void mqtt_client_puback_cb(void *client, uint16_t msgid, void *userdata)
 
     /* LOCK */
     /* publish async process */
-    mqtt_publish_handle_t **next_handle = &context->publish_list;
-    for (; *next_handle; next_handle = &(*next_handle)->next) {
-        mqtt_publish_handle_t *entry = *next_handle;
+    mqtt_publish_handle_t *entry = context->publish_table[msgid % TUYA_MQTT_PUBLISH_HASH_NUM];
+    for (; entry; entry = entry->hash_next) {
         if (msgid == entry->msgid) {
             entry->cb(OPRT_OK, entry->user_data);
-            *next_handle = entry->next;
-            tal_free(entry->payload);
-            tal_free(entry);
+            mqtt_publish_handle_remove(context, entry);
             break;
         }
     }
@@ -511,23 +798,9 @@ int tuya_mqtt_stop(tuya_mqtt_context_t *context)
     return OPRT_OK;
 }
 
-/**
- * @brief Registers a MQTT protocol with the given context.
- *
- * This function registers a MQTT protocol with the specified context. The
- * protocol is identified by the protocol ID. When a message with the registered
- * protocol ID is received, the provided callback function will be called.
- *
- * @param[in] context The MQTT context to register the protocol with.
- * @param[in] protocol_id The ID of the protocol to register.
- * @param[in] cb The callback function to be called when a message with the
- * registered protocol ID is received.
- * @param[in] user_data User data to be passed to the callback function.
- *
- * @return 0 on success, negative error code on failure.
- */
-int tuya_mqtt_protocol_register(tuya_mqtt_context_t *context, uint16_t protocol_id, tuya_protocol_callback_t cb,
-                                void *user_data)
+/* adds a protocol handler, raw handlers take the data object as text */
+static int tuya_mqtt_protocol_handle_add(tuya_mqtt_context_t *context, uint16_t protocol_id,
+                                         tuya_protocol_callback_t cb, void *user_data, bool raw)
 {
     if (context == NULL || context->is_inited == false || cb == NULL) {
         return OPRT_INVALID_PARM;
@@ -550,6 +823,7 @@ int tuya_mqtt_protocol_register(tuya_mqtt_context_t *context, uint16_t protocol_
     new_handle->id = protocol_id;
     new_handle->cb = cb;
     new_handle->user_data = user_data;
+    new_handle->raw = raw;
     new_handle->next = context->protocol_list;
     context->protocol_list = new_handle;
     /* UNLOCK */
@@ -557,6 +831,47 @@ int tuya_mqtt_protocol_register(tuya_mqtt_context_t *context, uint16_t protocol_
     return OPRT_OK;
 }
 
+/**
+ * @brief Registers a MQTT protocol with the given context.
+ *
+ * This function registers a MQTT protocol with the specified context. The
+ * protocol is identified by the protocol ID. When a message with the registered
+ * protocol ID is received, the provided callback function will be called.
+ *
+ * @param[in] context The MQTT context to register the protocol with.
+ * @param[in] protocol_id The ID of the protocol to register.
+ * @param[in] cb The callback function to be called when a message with the
+ * registered protocol ID is received.
+ * @param[in] user_data User data to be passed to the callback function.
+ *
+ * @return 0 on success, negative error code on failure.
+ */
+int tuya_mqtt_protocol_register(tuya_mqtt_context_t *context, uint16_t protocol_id, tuya_protocol_callback_t cb,
+                                void *user_data)
+{
+    return tuya_mqtt_protocol_handle_add(context, protocol_id, cb, user_data, false);
+}
+
+/**
+ * @brief Registers a MQTT protocol handler that takes the data object as text.
+ *
+ * The message of the protocol is only parsed into a cJSON tree when a handler
+ * registered with tuya_mqtt_protocol_register() needs it.
+ *
+ * @param[in] context The MQTT context to register the protocol with.
+ * @param[in] protocol_id The ID of the protocol to register.
+ * @param[in] cb The callback function, gets event->data_str and
+ * event->data_len.
+ * @param[in] user_data User data to be passed to the callback function.
+ *
+ * @return 0 on success, negative error code on failure.
+ */
+int tuya_mqtt_protocol_register_raw(tuya_mqtt_context_t *context, uint16_t protocol_id, tuya_protocol_callback_t cb,
+                                    void *user_data)
+{
+    return tuya_mqtt_protocol_handle_add(context, protocol_id, cb, user_data, true);
+}
+
 /**
  * Unregisters a protocol from the Tuya MQTT service.
  *
@@ -654,9 +969,8 @@ int tuya_mqtt_client_publish_common(tuya_mqtt_context_t *context, const char *to
         return OPRT_OK;
     }
 
-    mqtt_publish_handle_t *handle = tal_malloc(sizeof(mqtt_publish_handle_t));
+    mqtt_publish_handle_t *handle = tal_calloc(1, sizeof(mqtt_publish_handle_t));
     TUYA_CHECK_NULL_RETURN(handle, OPRT_MALLOC_FAILED);
-    handle->next = NULL;
     handle->msgid = 0;
     handle->topic = (char *)topic;
     handle->timeout = tal_time_get_posix() + timeout_ms;
@@ -665,6 +979,7 @@ int tuya_mqtt_client_publish_common(tuya_mqtt_context_t *context, const char *to
     handle->payload_length = payload_length;
     handle->payload = tal_malloc(payload_length);
     if (handle->payload == NULL) {
+        tal_free(handle);
         return OPRT_MALLOC_FAILED;
     }
     memcpy(handle->payload, payload, payload_length);
@@ -674,16 +989,9 @@ int tuya_mqtt_client_publish_common(tuya_mqtt_context_t *context, const char *to
                                             handle->payload_length, MQTT_QOS_1);
     }
 
-    if (context->publish_list == NULL) {
-        context->publish_list = handle;
-        return OPRT_OK;
-    }
-
-    mqtt_publish_handle_t *last = context->publish_list;
-    while (last->next != NULL) {
-        last = last->next;
-    }
-    last->next = handle;
+    /* LOCK */
+    mqtt_publish_handle_add(context, handle);
+    /* UNLOCK */
 
     return OPRT_OK;
 }
@@ -852,22 +1160,27 @@ int tuya_mqtt_loop(tuya_mqtt_context_t *context)
     }
 
     /* LOCK */
-    /* publish async process */
-    mqtt_publish_handle_t **next_handle = &context->publish_list;
-    for (; *next_handle; next_handle = &(*next_handle)->next) {
-        mqtt_publish_handle_t *entry = *next_handle;
-
-        if (entry->timeout <= tal_time_get_posix()) {
-            entry->cb(OPRT_TIMEOUT, entry->user_data);
-            *next_handle = entry->next;
-            tal_free(entry->payload);
-            tal_free(entry);
-            continue;
-        }
+    /* publish async process, the timeouts change once a second and are only checked then */
+    TIME_T now = tal_time_get_posix();
+    if (context->publish_unsent > 0 || now != context->publish_check_time) {
+        context->publish_check_time = now;
+        mqtt_publish_handle_t *entry = context->publish_list, *next = NULL;
+        for (; entry; entry = next) {
+            next = entry->next;
+
+            if (entry->timeout <= now) {
+                entry->cb(OPRT_TIMEOUT, entry->user_data);
+                mqtt_publish_handle_remove(context, entry);
+                continue;
+            }
 
-        if (entry->msgid <= 0) {
-            entry->msgid =
-                mqtt_client_publish(context->mqtt_client, entry->topic, entry->payload, entry->payload_length, 1);
+            if (entry->msgid <= 0) {
+                entry->msgid =
+                    mqtt_client_publish(context->mqtt_client, entry->topic, entry->payload, entry->payload_length, 1);
+                if (entry->msgid > 0) {
+                    mqtt_publish_handle_sent(context, entry);
+                }
+            }
         }
     }
     /* UNLOCK */
@@ -41,6 +41,10 @@ extern "C" {
 #define TUYA_MQTT_TOPIC_MAXLEN      (64U)
 #define TUYA_MQTT_TOPIC_MAXLEN      (64U)
 
+// buckets of the subscribed topics and of the publishes waiting for PUBACK
+#define TUYA_MQTT_SUBSCRIBE_HASH_NUM (32U)
+#define TUYA_MQTT_PUBLISH_HASH_NUM   (16U)
+
 // Tuya mqtt protocol
 #define PRO_DATA_PUSH            4  /* device -> cloud push dp data */
 #define PRO_CMD                  5  /* cloud -> device send dp data */
@@ -127,6 +131,9 @@ typedef struct {
     uint16_t event_id;
     cJSON *root_json;
     cJSON *data;
+    /* text of the data object, not '\0' terminated, always set for raw handlers */
+    const char *data_str;
+    size_t data_len;
     void *user_data;
 } tuya_protocol_event_t;
 
@@ -139,6 +146,7 @@ typedef struct tuya_protocol_handle {
     uint16_t id;
     tuya_protocol_callback_t cb;
     void *user_data;
+    bool raw;
 } tuya_protocol_handle_t;
 
 typedef void (*mqtt_subscribe_message_cb_t)(uint16_t msgid, const mqtt_client_message_t *msg, void *userdata);
@@ -151,10 +159,21 @@ typedef struct mqtt_subscribe_handle {
     void *userdata;
 } mqtt_subscribe_handle_t;
 
+/* a level of the topic filters with '+' or '#', holds the handles of the filters ending at it */
+typedef struct mqtt_topic_node {
+    struct mqtt_topic_node *next;
+    struct mqtt_topic_node *child;
+    mqtt_subscribe_handle_t *handles;
+    size_t level_length;
+    char level[0];
+} mqtt_topic_node_t;
+
 typedef void (*mqtt_publish_notify_cb_t)(int result, void *user_data);
 
 typedef struct mqtt_publish_handle {
     struct mqtt_publish_handle *next;
+    struct mqtt_publish_handle *prev;
+    struct mqtt_publish_handle *hash_next; // bucket of the msgid, once sent
     uint16_t msgid;
     int timeout;
     char *topic;
@@ -168,8 +187,13 @@ typedef struct {
     void *mqtt_client;
     tuya_mqtt_access_t signature;
     tuya_protocol_handle_t *protocol_list;
-    mqtt_subscribe_handle_t *subscribe_list;
+    mqtt_subscribe_handle_t *subscribe_table[TUYA_MQTT_SUBSCRIBE_HASH_NUM];
+    mqtt_topic_node_t *subscribe_filters;
     mqtt_publish_handle_t *publish_list;
+    mqtt_publish_handle_t *publish_tail;
+    mqtt_publish_handle_t *publish_table[TUYA_MQTT_PUBLISH_HASH_NUM];
+    uint32_t publish_unsent;
+    uint32_t publish_check_time;
     BackoffAlgorithmContext_t backoff_algorithm;
     uint32_t sequence_in;
     uint32_t sequence_out;
@@ -265,6 +289,24 @@ bool tuya_mqtt_connected(tuya_mqtt_context_t *context);
 int tuya_mqtt_protocol_register(tuya_mqtt_context_t *context, uint16_t protocol_id, tuya_protocol_callback_t cb,
                                 void *user_data);
 
+/**
+ * @brief Registers a MQTT protocol handler that takes the data object as text.
+ *
+ * The callback gets event->data_str and event->data_len, root_json and data
+ * are NULL. While every handler of a protocol is registered this way the
+ * message is not parsed into a cJSON tree, only the envelope is read.
+ *
+ * @param context The MQTT context to register the protocol with.
+ * @param protocol_id The ID of the protocol to register.
+ * @param cb The callback function to be called when a message with the
+ * registered protocol ID is received.
+ * @param user_data User data to be passed to the callback function.
+ *
+ * @return 0 on success, or a negative error code on failure.
+ */
+int tuya_mqtt_protocol_register_raw(tuya_mqtt_context_t *context, uint16_t protocol_id, tuya_protocol_callback_t cb,
+                                    void *user_data);
+
 /**
  * @brief Unregisters a MQTT protocol with the specified protocol ID and
  * callback function.
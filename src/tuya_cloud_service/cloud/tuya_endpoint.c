@@ -166,9 +166,11 @@ int tuya_endpoint_domain_get(tuya_endpoint_t *endpoint)
         {"mqtt.port", KV_USHORT, &endpoint->mqtt.port, sizeof(endpoint->mqtt.port)},
     };
 
-    ret = tal_kv_serialize_get("endpoint.domain", kvdb, sizeof(kvdb) / sizeof(kvdb[0]));
+    // the json record is the only one, older firmware reads and removes it after a rollback. A binary
+    // record written by earlier builds of this firmware is rewritten as json.
+    ret = tal_kv_serialize_get_fmt("endpoint.domain", kvdb, sizeof(kvdb) / sizeof(kvdb[0]), KV_SERIALIZE_JSON);
     if (ret != OPRT_OK) {
-        PR_ERR("tal_kv_serialize_set error:%d", ret);
+        PR_ERR("tal_kv_serialize_get error:%d", ret);
     }
 
     return ret;
@@ -202,11 +204,16 @@ int tuya_endpoint_domain_set(tuya_endpoint_t *endpoint)
         {"mqtt.port", KV_USHORT, &endpoint->mqtt.port, sizeof(endpoint->mqtt.port)},
     };
 
+    // stays in the json format older firmware reads, so a rollback finds the current domain
     ret = tal_kv_serialize_set("endpoint.domain", kvdb, sizeof(kvdb) / sizeof(kvdb[0]));
     if (ret != OPRT_OK) {
         PR_ERR("tal_kv_serialize_set error:%d", ret);
+        return ret;
     }
 
+    // binary copy left by earlier builds of this firmware, nothing reads it any more
+    tal_kv_del("endpoint.domain.bin");
+
     return ret;
 }
 
@@ -249,6 +256,7 @@ int tuya_endpoint_remove(void)
     tal_kv_del("regist_key");
     tal_kv_del("endpoint.cert");
     tal_kv_del("endpoint.domain");
+    tal_kv_del("endpoint.domain.bin");
 
     return OPRT_OK;
 }
@@ -269,13 +269,9 @@ static int client_activate_process(tuya_iot_client_t *client, const char *token)
 static void mqtt_service_dp_receive_on(tuya_protocol_event_t *ev)
 {
     tuya_iot_client_t *client = ev->user_data;
-    cJSON *data = (cJSON *)(ev->data);
-    if (NULL == cJSON_GetObjectItem(data, "dps")) {
-        PR_ERR("not found dps");
-        return;
-    }
 
-    tuya_iot_dp_parse(client, DP_CMD_MQ, cJSON_DetachItemFromObject(ev->root_json, "data"));
+    // raw handler, the data object is decoded from its text on the work queue
+    tuya_iot_dp_parse_str(client, DP_CMD_MQ, ev->data_str, ev->data_len);
 }
 
 static void mqtt_service_reset_cmd_on(tuya_protocol_event_t *ev)
@@ -492,7 +488,7 @@ static int run_state_mqtt_connect_start(tuya_iot_client_t *client)
     }
 
     /* callback register */
-    tuya_mqtt_protocol_register(&client->mqctx, PRO_CMD, mqtt_service_dp_receive_on, client);
+    tuya_mqtt_protocol_register_raw(&client->mqctx, PRO_CMD, mqtt_service_dp_receive_on, client);
     tuya_mqtt_protocol_register(&client->mqctx, PRO_GW_RESET, mqtt_service_reset_cmd_on, client);
     tuya_mqtt_protocol_register(&client->mqctx, PRO_UPGD_REQ, mqtt_service_upgrade_notify_on, client);
     tuya_mqtt_protocol_register(&client->mqctx, PRO_MQ_DPCACHE_NOTIFY, mqtt_atop_dp_cache_notify_cb, client);
@@ -580,6 +576,7 @@ int tuya_iot_init(tuya_iot_client_t *client, const tuya_iot_config_t *config)
     tuya_register_center_init();
     /* Load Tuya cloud endpoint config */
     tuya_endpoint_init();
+    tuya_iot_dp_init();
     /* Try to read the local activation data.
      * If the reading is successful, the device has been activated. */
     if (activated_data_read(client->config.storage_namespace, &client->activate) == OPRT_OK) {
@@ -715,6 +712,7 @@ int tuya_iot_reset(tuya_iot_client_t *client)
  */
 int tuya_iot_destroy(tuya_iot_client_t *client)
 {
+    tuya_iot_dp_deinit();
     return OPRT_OK;
 }
 
@@ -1036,6 +1034,7 @@ int tuya_iot_activated_data_remove(tuya_iot_client_t *client)
     }
 
     /* Clean client local data */
+    tuya_iot_dp_deinit();
     dp_schema_delete(client->activate.devid);
     tal_kv_del((const char *)(client->activate.schemaId));
     tal_kv_del((const char *)(client->config.storage_namespace));
@@ -20,6 +20,55 @@
 #include "tuya_endpoint.h"
 #include "iotdns.h"
 #include "mix_method.h"
+#include "tuya_ota_pipe.h"
+#if defined(ENABLE_OTA_DELTA) && (ENABLE_OTA_DELTA == 1)
+#include "tuya_ota_delta.h"
+#include "tkl_flash.h"
+#endif
+
+#ifndef OTA_DOWNLOAD_CONN_NUM
+#define OTA_DOWNLOAD_CONN_NUM 1
+#endif
+
+#ifndef OTA_PIPELINE_BUF_NUM
+#define OTA_PIPELINE_BUF_NUM 0
+#endif
+
+#ifndef OTA_CHECKPOINT_INTERVAL
+#define OTA_CHECKPOINT_INTERVAL 0
+#endif
+
+/* the checkpoint keeps the state of the software sha256 behind the tal handle, the data before it is not read
+ * back, so only a platform that keeps it across tal_ota_start_notify() resumes */
+#if (OTA_CHECKPOINT_INTERVAL > 0) && defined(ENABLE_PLATFORM_OTA_RESUME) && !defined(ENABLE_PLATFORM_SHA256)
+#include "mbedtls/sha256.h"
+#if !defined(MBEDTLS_SHA256_ALT)
+#define OTA_CHECKPOINT_ENABLE 1
+#endif
+#endif
+
+#if defined(OTA_CHECKPOINT_ENABLE)
+#define OTA_CHECKPOINT_KEY     "ota_ckpt"
+#define OTA_CHECKPOINT_VERSION 1
+
+typedef struct {
+    uint8_t version;
+    uint8_t channel;
+    uint32_t file_size;
+    uint32_t offset;               // bytes written and hashed
+    uint8_t image_id[32];          // firmware hmac
+    mbedtls_sha256_context sha256; // hash of the bytes before offset
+} tuya_ota_checkpoint_t;
+#endif
+
+#if defined(ENABLE_OTA_DELTA) && (ENABLE_OTA_DELTA == 1)
+typedef enum {
+    OTA_IMAGE_UNKNOWN, // waiting for the first bytes
+    OTA_IMAGE_FULL,
+    OTA_IMAGE_DELTA,
+    OTA_IMAGE_BROKEN, // the patch failed, the rest is dropped
+} tuya_ota_image_t;
+#endif
 
 typedef struct {
     tuya_ota_config_t config;
@@ -29,6 +78,18 @@ typedef struct {
     uint8_t progress_percent;
     THREAD_HANDLE upgrade_thrd;
     TKL_HASH_HANDLE sha256;
+#if defined(OTA_CHECKPOINT_ENABLE)
+    tuya_ota_checkpoint_t checkpoint;
+#endif
+#if (OTA_PIPELINE_BUF_NUM > 1)
+    tuya_ota_pipe_t *pipe;
+#endif
+#if defined(ENABLE_OTA_DELTA) && (ENABLE_OTA_DELTA == 1)
+    uint8_t image;           // tuya_ota_image_t
+    uint32_t old_addr;       // flash address of the running image
+    uint32_t delta_new_size; // size of the image the patch makes
+    tuya_ota_delta_t *delta;
+#endif
 } tuya_ota_t;
 
 int tuya_ota_upgrade_status_report(tuya_ota_t *handle, int status);
@@ -36,6 +97,199 @@ int tuya_ota_upgrade_progress_report(tuya_ota_t *handle, int percent);
 
 static tuya_ota_t *s_ota_ctx;
 
+#if defined(OTA_CHECKPOINT_ENABLE)
+/* the offset to resume the download at, 0 without a checkpoint of this image */
+static size_t ota_checkpoint_load(tuya_ota_t *ota)
+{
+    tuya_ota_checkpoint_t *ckpt = &ota->checkpoint;
+    uint8_t *value = NULL;
+    size_t length = 0;
+    uint8_t image_id[32];
+
+    memset(ckpt, 0, sizeof(tuya_ota_checkpoint_t));
+    if (0 != ota->channel || OPRT_OK != tal_kv_get(OTA_CHECKPOINT_KEY, &value, &length)) {
+        return 0;
+    }
+    if (length == sizeof(tuya_ota_checkpoint_t)) {
+        memcpy(ckpt, value, length);
+    }
+    tal_kv_free(value);
+
+    ascs2hex(image_id, (uint8_t *)(ota->msg.fw_hmac), FW_HMAC_LEN);
+    if (ckpt->version != OTA_CHECKPOINT_VERSION || ckpt->channel != ota->channel ||
+        ckpt->file_size != ota->msg.file_size || ckpt->offset >= ckpt->file_size ||
+        memcmp(ckpt->image_id, image_id, sizeof(image_id))) {
+        PR_DEBUG("ota checkpoint of another image dropped");
+        tal_kv_del(OTA_CHECKPOINT_KEY);
+        memset(ckpt, 0, sizeof(tuya_ota_checkpoint_t));
+        return 0;
+    }
+
+    PR_INFO("ota resume at %d of %d", ckpt->offset, ckpt->file_size);
+    return ckpt->offset;
+}
+
+/* saves the hash state once another OTA_CHECKPOINT_INTERVAL KB are written */
+static void ota_checkpoint_save(tuya_ota_t *ota, size_t offset)
+{
+    tuya_ota_checkpoint_t *ckpt = &ota->checkpoint;
+
+    if (0 != ota->channel || offset < ckpt->offset + OTA_CHECKPOINT_INTERVAL * 1024) {
+        return;
+    }
+    ckpt->version = OTA_CHECKPOINT_VERSION;
+    ckpt->channel = ota->channel;
+    ckpt->file_size = ota->msg.file_size;
+    ckpt->offset = offset;
+    ascs2hex(ckpt->image_id, (uint8_t *)(ota->msg.fw_hmac), FW_HMAC_LEN);
+    memcpy(&ckpt->sha256, ota->sha256, sizeof(mbedtls_sha256_context));
+    if (OPRT_OK != tal_kv_set(OTA_CHECKPOINT_KEY, (const uint8_t *)ckpt, sizeof(tuya_ota_checkpoint_t))) {
+        PR_WARN("ota checkpoint save failed");
+    }
+}
+#endif
+
+static void ota_progress_update(tuya_ota_t *ota, size_t offset, size_t file_size)
+{
+    uint8_t percent = offset * 100 / file_size;
+    if (percent - ota->progress_percent > 5) {
+        PR_DEBUG("File Download Percent: %d%%", percent);
+        tuya_ota_upgrade_progress_report(ota, percent);
+        ota->progress_percent = percent;
+    }
+}
+
+#if defined(ENABLE_OTA_DELTA) && (ENABLE_OTA_DELTA == 1)
+static OPERATE_RET ota_delta_read(uint32_t offset, uint8_t *buf, uint32_t len, void *user_data)
+{
+    tuya_ota_t *ota = (tuya_ota_t *)user_data;
+
+    return tkl_flash_read(ota->old_addr + offset, buf, len);
+}
+
+static OPERATE_RET ota_delta_write(uint8_t *data, size_t len, size_t offset, uint32_t *remain_len, void *user_data)
+{
+    tuya_ota_t *ota = (tuya_ota_t *)user_data;
+    TUYA_OTA_DATA_T ota_pack;
+
+    ota_pack.total_len = ota->delta_new_size;
+    ota_pack.offset = offset;
+    ota_pack.data = data;
+    ota_pack.len = len;
+    ota_pack.pri_data = NULL;
+    *remain_len = 0;
+    return tal_ota_data_process(&ota_pack, remain_len);
+}
+
+/* starts the update once the first bytes tell a delta patch from a full image */
+static OPERATE_RET ota_image_start(tuya_ota_t *ota, uint8_t *data, size_t len, size_t offset)
+{
+    OPERATE_RET rt = OPRT_OK;
+    tuya_ota_delta_header_t header;
+    TUYA_FLASH_BASE_INFO_T info;
+    tuya_ota_delta_cfg_t cfg = {
+        .out_size = ota->config.range_size,
+        .read = ota_delta_read,
+        .write = ota_delta_write,
+        .user_data = ota,
+    };
+
+    // a download resumed from a checkpoint is always a full image
+    if (0 != offset || !tuya_ota_delta_header_parse(data, len, &header)) {
+        ota->image = OTA_IMAGE_FULL;
+        return tal_ota_start_notify(ota->event.file_size, TUYA_OTA_FULL, TUYA_OTA_PATH_AIR);
+    }
+
+    PR_NOTICE("delta ota, image %d -> %d, patch %d", header.old_size, header.new_size, ota->event.file_size);
+    memset(&info, 0, sizeof(info));
+    TUYA_CALL_ERR_RETURN(tkl_flash_get_one_type_info(TUYA_FLASH_TYPE_APP, &info));
+    if (0 == info.partition_num || header.old_size > info.partition[0].size) {
+        return OPRT_NOT_SUPPORTED;
+    }
+    ota->old_addr = info.partition[0].start_addr;
+    ota->delta_new_size = header.new_size;
+    TUYA_CALL_ERR_RETURN(tuya_ota_delta_create(&cfg, &ota->delta));
+    ota->image = OTA_IMAGE_DELTA;
+
+    return tal_ota_start_notify(header.new_size, TUYA_OTA_FULL, TUYA_OTA_PATH_AIR);
+}
+
+/* applies the patch, the file hmac covers the patch and the patch header the new image */
+static OPERATE_RET ota_image_delta_write(tuya_ota_t *ota, uint8_t *data, size_t len, size_t offset)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    rt = tuya_ota_delta_apply(ota->delta, data, len);
+    if (OPRT_OK != rt) {
+        PR_ERR("delta ota apply err %d", rt);
+        ota->image = OTA_IMAGE_BROKEN;
+        return rt;
+    }
+    tal_sha256_update_ret(ota->sha256, data, len);
+    ota_progress_update(ota, offset, ota->event.file_size);
+
+    return OPRT_OK;
+}
+#endif
+
+/* hashes and writes the firmware of channel 0, on the download thread or on the pipe writer */
+static OPERATE_RET ota_data_write(uint8_t *data, size_t len, size_t offset, uint32_t *remain_len, void *user_data)
+{
+    tuya_ota_t *ota = (tuya_ota_t *)user_data;
+    TUYA_OTA_DATA_T ota_pack;
+    OPERATE_RET rt = OPRT_OK;
+
+#if defined(ENABLE_OTA_DELTA) && (ENABLE_OTA_DELTA == 1)
+    if (OTA_IMAGE_UNKNOWN == ota->image) {
+        if (0 == offset && len < TUYA_OTA_DELTA_HEADER_LEN && len < ota->event.file_size) {
+            *remain_len = len;
+            return OPRT_OK;
+        }
+        rt = ota_image_start(ota, data, len, offset);
+        if (OPRT_OK != rt) {
+            PR_ERR("ota image start err %d", rt);
+            ota->image = OTA_IMAGE_BROKEN;
+        }
+    }
+    if (OTA_IMAGE_BROKEN == ota->image) {
+        // the hash stays short, the hmac check fails
+        *remain_len = 0;
+        return OPRT_COM_ERROR;
+    }
+    if (OTA_IMAGE_DELTA == ota->image) {
+        *remain_len = 0;
+        return ota_image_delta_write(ota, data, len, offset);
+    }
+#endif
+
+    ota_pack.total_len = ota->event.file_size;
+    ota_pack.offset = offset;
+    ota_pack.data = data;
+    ota_pack.len = len;
+    ota_pack.pri_data = NULL;
+    *remain_len = 0;
+    rt = tal_ota_data_process(&ota_pack, remain_len);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+    tal_sha256_update_ret(ota->sha256, data, len - *remain_len);
+#if defined(OTA_CHECKPOINT_ENABLE)
+    ota_checkpoint_save(ota, offset + len - *remain_len);
+#endif
+    ota_progress_update(ota, offset, ota->event.file_size);
+
+    return OPRT_OK;
+}
+
+static void ota_fault_report(tuya_ota_t *ota)
+{
+    tuya_ota_upgrade_status_report(ota, TUS_UPGRD_EXEC);
+    if (ota->config.event_cb) {
+        ota->event.id = TUYA_OTA_EVENT_FAULT;
+        ota->config.event_cb(&ota->msg, &ota->event);
+    }
+}
+
 static void file_download_event_cb(http_download_event_id_t id, http_download_event_t *event)
 {
     tuya_ota_t *ota = (tuya_ota_t *)event->user_data;
@@ -44,6 +298,7 @@ static void file_download_event_cb(http_download_event_id_t id, http_download_ev
     uint8_t file_hmac[32];
     uint8_t self_hmac[32];
     uint8_t file_sha256[32 * 2 + 1] = {0};
+    bool image_ok = true;
 
     switch (id) {
     case DL_EVENT_START:
@@ -51,12 +306,40 @@ static void file_download_event_cb(http_download_event_id_t id, http_download_ev
         tuya_ota_upgrade_status_report(ota, TUS_UPGRDING);
         tal_sha256_create_init(&ota->sha256);
         tal_sha256_starts_ret(ota->sha256, 0);
+#if defined(ENABLE_OTA_DELTA) && (ENABLE_OTA_DELTA == 1)
+        ota->image = OTA_IMAGE_UNKNOWN;
+#endif
+#if defined(OTA_CHECKPOINT_ENABLE)
+        if (event->offset) {
+            memcpy(ota->sha256, &ota->checkpoint.sha256, sizeof(mbedtls_sha256_context));
+        }
+#endif
+#if (OTA_PIPELINE_BUF_NUM > 1)
+        if (0 == ota->channel) {
+            tuya_ota_pipe_cfg_t pipe_cfg = {
+                .buf_num = OTA_PIPELINE_BUF_NUM,
+                .buf_size = ota->config.range_size,
+                .stack_size = 4096,
+                .write = ota_data_write,
+                .user_data = ota,
+            };
+            // without the pipe the data is written on the download thread
+            if (OPRT_OK != tuya_ota_pipe_create(&pipe_cfg, &ota->pipe)) {
+                ota->pipe = NULL;
+            }
+        }
+#endif
         break;
 
     case DL_EVENT_ON_FILESIZE:
         PR_DEBUG("DL_EVENT_ON_FILESIZE");
+        ota->event.file_size = event->file_size;
         if (0 == ota->channel) {
+#if defined(ENABLE_OTA_DELTA) && (ENABLE_OTA_DELTA == 1)
+            // started by the first data, the size of the image is in the patch header
+#else
             tal_ota_start_notify(event->file_size, TUYA_OTA_FULL, TUYA_OTA_PATH_AIR);
+#endif
         } else if (event_cb) {
             ota->event.id = TUYA_OTA_EVENT_START;
             ota->event.file_size = event->file_size;
@@ -69,18 +352,22 @@ static void file_download_event_cb(http_download_event_id_t id, http_download_ev
         PR_DEBUG("DL_EVENT_ON_DATA:%d", event->data_len);
         PR_DEBUG("event->file_size %d, offset:%d, last remain %d", event->file_size, event->offset, event->remain_len);
         if (0 == ota->channel) {
-            TUYA_OTA_DATA_T ota_pack;
-
-            ota_pack.total_len = event->file_size;
-            ota_pack.offset = event->offset;
-            ota_pack.data = event->data;
-            ota_pack.len = event->data_len;
-            ota_pack.pri_data = NULL;
-            tal_ota_data_process(&ota_pack, (uint32_t *)&event->remain_len);
-            if (event->remain_len) {
-                tal_sha256_update_ret(ota->sha256, event->data, event->data_len - event->remain_len);
-            } else {
-                tal_sha256_update_ret(ota->sha256, event->data, event->data_len);
+            OPERATE_RET rt = OPRT_OK;
+#if (OTA_PIPELINE_BUF_NUM > 1)
+            if (ota->pipe) {
+                // the pipe takes all of it and keeps what the flash does not consume, a write error of the
+                // writer task comes back with a later call
+                rt = tuya_ota_pipe_write(ota->pipe, event->data, event->data_len, event->offset);
+                event->remain_len = 0;
+            } else
+#endif
+            {
+                rt = ota_data_write(event->data, event->data_len, event->offset, (uint32_t *)&event->remain_len, ota);
+            }
+            if (OPRT_OK != rt) {
+                // no use downloading the rest, the download ends with DL_EVENT_FAULT
+                PR_ERR("ota write err %d, stop the download", rt);
+                event->error = rt;
             }
         } else if (event_cb) {
             ota->event.id = TUYA_OTA_EVENT_ON_DATA;
@@ -88,12 +375,7 @@ static void file_download_event_cb(http_download_event_id_t id, http_download_ev
             ota->event.data_len = event->data_len;
             ota->event.offset = event->offset;
             event_cb(&ota->msg, &ota->event);
-        }
-        uint8_t percent = event->offset * 100 / event->file_size;
-        if (percent - ota->progress_percent > 5) {
-            PR_DEBUG("File Download Percent: %d%%", percent);
-            tuya_ota_upgrade_progress_report(ota, percent);
-            ota->progress_percent = percent;
+            ota_progress_update(ota, event->offset, event->file_size);
         }
         break;
     }
@@ -101,13 +383,38 @@ static void file_download_event_cb(http_download_event_id_t id, http_download_ev
     case DL_EVENT_FINISH:
         PR_DEBUG("DL_EVENT_FINISH");
         PR_DEBUG("File Download Percent: %d%%", 100);
+#if (OTA_PIPELINE_BUF_NUM > 1)
+        if (ota->pipe) {
+            // the last buffers are written here, an error fails the image
+            if (OPRT_OK != tuya_ota_pipe_finish(ota->pipe)) {
+                image_ok = false;
+            }
+            tuya_ota_pipe_destroy(ota->pipe);
+            ota->pipe = NULL;
+        }
+#endif
+#if defined(ENABLE_OTA_DELTA) && (ENABLE_OTA_DELTA == 1)
+        if (ota->delta) {
+            if (OTA_IMAGE_DELTA != ota->image || OPRT_OK != tuya_ota_delta_finish(ota->delta)) {
+                ota->image = OTA_IMAGE_BROKEN;
+            }
+            tuya_ota_delta_destroy(ota->delta);
+            ota->delta = NULL;
+        }
+        image_ok = image_ok &&
+                   ((0 != ota->channel) || (OTA_IMAGE_FULL == ota->image) || (OTA_IMAGE_DELTA == ota->image));
+#endif
         tal_sha256_finish_ret(ota->sha256, file_hmac);
         tal_sha256_free(ota->sha256);
+#if defined(OTA_CHECKPOINT_ENABLE)
+        // a mismatch would come back from the checkpoint as well
+        tal_kv_del(OTA_CHECKPOINT_KEY);
+#endif
         hex2str((uint8_t *)file_sha256, file_hmac, 32);
         tal_sha256_mac((const uint8_t *)client->activate.seckey, strlen(client->activate.seckey), file_sha256, 32 * 2,
                        file_hmac);
         ascs2hex(self_hmac, (uint8_t *)(ota->msg.fw_hmac), FW_HMAC_LEN);
-        if ((memcmp(self_hmac, file_hmac, 32) == 0)) {
+        if (image_ok && (memcmp(self_hmac, file_hmac, 32) == 0)) {
             PR_DEBUG("file hmac check success");
             tuya_ota_upgrade_progress_report(ota, 100);
             tuya_ota_upgrade_status_report(ota, TUS_UPGRD_FINI);
@@ -117,16 +424,28 @@ static void file_download_event_cb(http_download_event_id_t id, http_download_ev
                 ota->event.id = TUYA_OTA_EVENT_FINISH;
                 event_cb(&ota->msg, &ota->event);
             }
+        } else if (!image_ok) {
+            PR_ERR("ota image write failed");
+            ota_fault_report(ota);
         }
         break;
 
     case DL_EVENT_FAULT:
         PR_DEBUG("DL_EVENT_FAULT");
-        tuya_ota_upgrade_status_report(ota, TUS_UPGRD_EXEC);
-        if (event_cb) {
-            ota->event.id = TUYA_OTA_EVENT_FAULT;
-            event_cb(&ota->msg, &ota->event);
+        // the checkpoint stays for the next attempt
+#if (OTA_PIPELINE_BUF_NUM > 1)
+        if (ota->pipe) {
+            tuya_ota_pipe_destroy(ota->pipe);
+            ota->pipe = NULL;
         }
+#endif
+#if defined(ENABLE_OTA_DELTA) && (ENABLE_OTA_DELTA == 1)
+        tuya_ota_delta_destroy(ota->delta);
+        ota->delta = NULL;
+#endif
+        tal_sha256_free(ota->sha256);
+        ota->sha256 = NULL;
+        ota_fault_report(ota);
         break;
 
     default:
@@ -170,6 +489,7 @@ static void ota_process_thread_func(void *arg)
     tuya_iotdns_query_domain_certs(ota->msg.fw_url, &cert, &cert_len);
 
     http_download_config_t download_cfg;
+    memset(&download_cfg, 0, sizeof(http_download_config_t));
     download_cfg.file_size = ota->msg.file_size;
     download_cfg.range_length = ota->config.range_size;
     download_cfg.timeout_ms = ota->config.timeout_ms;
@@ -178,6 +498,10 @@ static void ota_process_thread_func(void *arg)
     download_cfg.url = ota->msg.fw_url;
     download_cfg.event_handler = file_download_event_cb;
     download_cfg.user_data = ota;
+    download_cfg.conn_num = OTA_DOWNLOAD_CONN_NUM;
+#if defined(OTA_CHECKPOINT_ENABLE)
+    download_cfg.offset = ota_checkpoint_load(ota);
+#endif
 
     http_file_download(&download_cfg);
     tal_free(cert);
@@ -0,0 +1,452 @@
+/**
+ * @file tuya_ota_delta.c
+ * @brief Streaming apply of delta OTA patches against the running firmware.
+ *
+ * The patch is parsed byte by byte by a small state machine, so it may arrive
+ * in pieces of any size. New bytes go to an output buffer that is handed to
+ * the write callback when full, old bytes are read through a window of
+ * OTA_DELTA_OLD_WINDOW bytes.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tal_api.h"
+#include "tuya_ota_delta.h"
+
+#ifndef OTA_DELTA_OLD_WINDOW
+#define OTA_DELTA_OLD_WINDOW 256
+#endif
+
+#define OTA_DELTA_OP_END  0
+#define OTA_DELTA_OP_ADD  1
+#define OTA_DELTA_OP_DATA 2
+
+typedef enum {
+    DELTA_ST_HEADER,
+    DELTA_ST_OP,
+    DELTA_ST_ADD_LEN,
+    DELTA_ST_ADD_SEEK,
+    DELTA_ST_ADD_ZERO,
+    DELTA_ST_ADD_LIT_LEN,
+    DELTA_ST_ADD_LIT,
+    DELTA_ST_DATA_LEN,
+    DELTA_ST_DATA,
+    DELTA_ST_END,
+} tuya_ota_delta_state_t;
+
+struct tuya_ota_delta {
+    tuya_ota_delta_cfg_t cfg;
+    tuya_ota_delta_header_t header;
+    uint8_t state;
+    uint8_t varint_shift;
+    uint32_t varint;
+    uint32_t op_left;  // new bytes left in the operation
+    uint32_t run_left; // literal bytes left in the run
+    uint32_t old_pos;
+    uint32_t new_pos; // new bytes produced
+    TKL_HASH_HANDLE sha256;
+    uint8_t *out;
+    size_t out_len;
+    size_t out_offset; // new image offset of out[0]
+    uint8_t old[OTA_DELTA_OLD_WINDOW];
+    uint32_t old_off; // old image offset of old[0]
+    uint32_t old_len;
+    uint8_t head[TUYA_OTA_DELTA_HEADER_LEN];
+    uint8_t head_len;
+};
+
+static uint32_t __delta_u32_get(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+BOOL_T tuya_ota_delta_header_parse(const uint8_t *data, size_t len, tuya_ota_delta_header_t *header)
+{
+    if (NULL == data || len < TUYA_OTA_DELTA_HEADER_LEN || memcmp(data, TUYA_OTA_DELTA_MAGIC, 4) ||
+        data[4] != TUYA_OTA_DELTA_VERSION) {
+        return FALSE;
+    }
+    if (header) {
+        header->old_size = __delta_u32_get(data + 8);
+        header->new_size = __delta_u32_get(data + 12);
+        memcpy(header->old_sha256, data + 16, 32);
+        memcpy(header->new_sha256, data + 48, 32);
+    }
+
+    return TRUE;
+}
+
+/* hands the output buffer to the write callback, keeps what it did not consume */
+static OPERATE_RET __delta_out_flush(tuya_ota_delta_t *delta)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t remain_len = 0;
+
+    rt = delta->cfg.write(delta->out, delta->out_len, delta->out_offset, &remain_len, delta->cfg.user_data);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+    if (remain_len > delta->out_len || (remain_len == delta->out_len && delta->out_len == delta->cfg.out_size)) {
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+    if (remain_len) {
+        memmove(delta->out, delta->out + (delta->out_len - remain_len), remain_len);
+    }
+    delta->out_offset += delta->out_len - remain_len;
+    delta->out_len = remain_len;
+
+    return OPRT_OK;
+}
+
+/* room for at least one byte in the output buffer */
+static OPERATE_RET __delta_out_room(tuya_ota_delta_t *delta)
+{
+    if (delta->out_len < delta->cfg.out_size) {
+        return OPRT_OK;
+    }
+    return __delta_out_flush(delta);
+}
+
+/* the old byte at old_pos, through the window */
+static OPERATE_RET __delta_old_get(tuya_ota_delta_t *delta, uint8_t *value)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t len = 0;
+
+    if (delta->old_pos >= delta->header.old_size) {
+        return OPRT_INVALID_PARM;
+    }
+    if (delta->old_pos < delta->old_off || delta->old_pos >= delta->old_off + delta->old_len) {
+        len = delta->header.old_size - delta->old_pos;
+        if (len > OTA_DELTA_OLD_WINDOW) {
+            len = OTA_DELTA_OLD_WINDOW;
+        }
+        rt = delta->cfg.read(delta->old_pos, delta->old, len, delta->cfg.user_data);
+        if (OPRT_OK != rt) {
+            return rt;
+        }
+        delta->old_off = delta->old_pos;
+        delta->old_len = len;
+    }
+    *value = delta->old[delta->old_pos - delta->old_off];
+
+    return OPRT_OK;
+}
+
+/* one new byte, the old byte plus diff or the literal */
+static OPERATE_RET __delta_put(tuya_ota_delta_t *delta, uint8_t value, bool add)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t old = 0;
+
+    if (delta->new_pos >= delta->header.new_size || 0 == delta->op_left) {
+        return OPRT_INVALID_PARM;
+    }
+    if (add) {
+        TUYA_CALL_ERR_RETURN(__delta_old_get(delta, &old));
+        value += old;
+        delta->old_pos++;
+    }
+    TUYA_CALL_ERR_RETURN(__delta_out_room(delta));
+    delta->out[delta->out_len++] = value;
+    tal_sha256_update_ret(delta->sha256, &value, 1);
+    delta->new_pos++;
+    delta->op_left--;
+
+    return rt;
+}
+
+/* a run of old bytes taken as they are, a window at a time */
+static OPERATE_RET __delta_put_old(tuya_ota_delta_t *delta, uint32_t len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t old = 0;
+    uint32_t n = 0;
+
+    if (len > delta->op_left || len > delta->header.new_size - delta->new_pos ||
+        len > delta->header.old_size - delta->old_pos) {
+        return OPRT_INVALID_PARM;
+    }
+    while (len) {
+        TUYA_CALL_ERR_RETURN(__delta_old_get(delta, &old));
+        TUYA_CALL_ERR_RETURN(__delta_out_room(delta));
+        n = delta->old_len - (delta->old_pos - delta->old_off);
+        if (n > delta->cfg.out_size - delta->out_len) {
+            n = delta->cfg.out_size - delta->out_len;
+        }
+        if (n > len) {
+            n = len;
+        }
+        memcpy(delta->out + delta->out_len, delta->old + (delta->old_pos - delta->old_off), n);
+        tal_sha256_update_ret(delta->sha256, delta->out + delta->out_len, n);
+        delta->out_len += n;
+        delta->old_pos += n;
+        delta->new_pos += n;
+        delta->op_left -= n;
+        len -= n;
+    }
+
+    return rt;
+}
+
+/* a run of literal new bytes */
+static OPERATE_RET __delta_put_data(tuya_ota_delta_t *delta, const uint8_t *data, uint32_t len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t n = 0;
+
+    if (len > delta->op_left || len > delta->header.new_size - delta->new_pos) {
+        return OPRT_INVALID_PARM;
+    }
+    while (len) {
+        TUYA_CALL_ERR_RETURN(__delta_out_room(delta));
+        n = delta->cfg.out_size - delta->out_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(delta->out + delta->out_len, data, n);
+        tal_sha256_update_ret(delta->sha256, data, n);
+        delta->out_len += n;
+        delta->new_pos += n;
+        delta->op_left -= n;
+        data += n;
+        len -= n;
+    }
+
+    return rt;
+}
+
+/* the old image must be the one the patch was made from */
+static OPERATE_RET __delta_old_verify(tuya_ota_delta_t *delta)
+{
+    OPERATE_RET rt = OPRT_OK;
+    TKL_HASH_HANDLE sha256 = NULL;
+    uint8_t digest[32];
+    uint32_t off = 0, len = 0;
+
+    TUYA_CALL_ERR_RETURN(tal_sha256_create_init(&sha256));
+    tal_sha256_starts_ret(sha256, 0);
+    for (off = 0; off < delta->header.old_size; off += len) {
+        len = delta->header.old_size - off;
+        if (len > OTA_DELTA_OLD_WINDOW) {
+            len = OTA_DELTA_OLD_WINDOW;
+        }
+        rt = delta->cfg.read(off, delta->old, len, delta->cfg.user_data);
+        if (OPRT_OK != rt) {
+            tal_sha256_free(sha256);
+            return rt;
+        }
+        tal_sha256_update_ret(sha256, delta->old, len);
+    }
+    tal_sha256_finish_ret(sha256, digest);
+    tal_sha256_free(sha256);
+    delta->old_len = 0;
+
+    if (memcmp(digest, delta->header.old_sha256, sizeof(digest))) {
+        PR_ERR("delta patch is not for the running image");
+        return OPRT_NOT_SUPPORTED;
+    }
+
+    return OPRT_OK;
+}
+
+/* collects a varint, returns 1 when it is complete */
+static int __delta_varint(tuya_ota_delta_t *delta, uint8_t byte)
+{
+    if (delta->varint_shift > 28) {
+        return OPRT_INVALID_PARM;
+    }
+    delta->varint |= (uint32_t)(byte & 0x7f) << delta->varint_shift;
+    delta->varint_shift += 7;
+    if (byte & 0x80) {
+        return 0;
+    }
+    delta->varint_shift = 0;
+    return 1;
+}
+
+OPERATE_RET tuya_ota_delta_create(const tuya_ota_delta_cfg_t *cfg, tuya_ota_delta_t **delta)
+{
+    OPERATE_RET rt = OPRT_OK;
+    tuya_ota_delta_t *d = NULL;
+
+    if (NULL == cfg || NULL == delta || NULL == cfg->read || NULL == cfg->write || 0 == cfg->out_size) {
+        return OPRT_INVALID_PARM;
+    }
+
+    d = tal_calloc(1, sizeof(tuya_ota_delta_t));
+    TUYA_CHECK_NULL_RETURN(d, OPRT_MALLOC_FAILED);
+    memcpy(&d->cfg, cfg, sizeof(tuya_ota_delta_cfg_t));
+    d->out = tal_malloc(cfg->out_size);
+    if (NULL == d->out) {
+        rt = OPRT_MALLOC_FAILED;
+        goto __EXIT;
+    }
+    TUYA_CALL_ERR_GOTO(tal_sha256_create_init(&d->sha256), __EXIT);
+    tal_sha256_starts_ret(d->sha256, 0);
+    d->state = DELTA_ST_HEADER;
+
+    *delta = d;
+    return OPRT_OK;
+
+__EXIT:
+    tuya_ota_delta_destroy(d);
+    return rt;
+}
+
+OPERATE_RET tuya_ota_delta_apply(tuya_ota_delta_t *delta, const uint8_t *data, size_t len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t n = 0;
+    int done = 0;
+
+    if (NULL == delta) {
+        return OPRT_INVALID_PARM;
+    }
+
+    while (len) {
+        switch (delta->state) {
+        case DELTA_ST_HEADER:
+            n = TUYA_OTA_DELTA_HEADER_LEN - delta->head_len;
+            if (n > len) {
+                n = len;
+            }
+            memcpy(delta->head + delta->head_len, data, n);
+            delta->head_len += n;
+            data += n;
+            len -= n;
+            if (delta->head_len < TUYA_OTA_DELTA_HEADER_LEN) {
+                break;
+            }
+            if (!tuya_ota_delta_header_parse(delta->head, delta->head_len, &delta->header)) {
+                return OPRT_INVALID_PARM;
+            }
+            TUYA_CALL_ERR_RETURN(__delta_old_verify(delta));
+            delta->state = DELTA_ST_OP;
+            break;
+
+        case DELTA_ST_OP:
+            delta->varint = 0;
+            if (OTA_DELTA_OP_ADD == *data) {
+                delta->state = DELTA_ST_ADD_LEN;
+            } else if (OTA_DELTA_OP_DATA == *data) {
+                delta->state = DELTA_ST_DATA_LEN;
+            } else if (OTA_DELTA_OP_END == *data) {
+                delta->state = DELTA_ST_END;
+            } else {
+                return OPRT_INVALID_PARM;
+            }
+            data++;
+            len--;
+            break;
+
+        case DELTA_ST_ADD_LEN:
+        case DELTA_ST_ADD_SEEK:
+        case DELTA_ST_ADD_ZERO:
+        case DELTA_ST_ADD_LIT_LEN:
+        case DELTA_ST_DATA_LEN:
+            done = __delta_varint(delta, *data);
+            data++;
+            len--;
+            if (done < 0) {
+                return OPRT_INVALID_PARM;
+            } else if (0 == done) {
+                break;
+            }
+            n = delta->varint;
+            delta->varint = 0;
+            if (DELTA_ST_ADD_LEN == delta->state) {
+                delta->op_left = n;
+                delta->state = DELTA_ST_ADD_SEEK;
+            } else if (DELTA_ST_ADD_SEEK == delta->state) {
+                // zigzag
+                delta->old_pos += (n & 1) ? -(int32_t)((n >> 1) + 1) : (int32_t)(n >> 1);
+                delta->state = delta->op_left ? DELTA_ST_ADD_ZERO : DELTA_ST_OP;
+            } else if (DELTA_ST_ADD_ZERO == delta->state) {
+                TUYA_CALL_ERR_RETURN(__delta_put_old(delta, n));
+                delta->state = delta->op_left ? DELTA_ST_ADD_LIT_LEN : DELTA_ST_OP;
+            } else if (DELTA_ST_ADD_LIT_LEN == delta->state) {
+                if (0 == n || n > delta->op_left) {
+                    return OPRT_INVALID_PARM;
+                }
+                delta->run_left = n;
+                delta->state = DELTA_ST_ADD_LIT;
+            } else {
+                delta->op_left = n;
+                delta->state = n ? DELTA_ST_DATA : DELTA_ST_OP;
+            }
+            break;
+
+        case DELTA_ST_ADD_LIT:
+            while (len && delta->run_left) {
+                TUYA_CALL_ERR_RETURN(__delta_put(delta, *data, true));
+                data++;
+                len--;
+                delta->run_left--;
+            }
+            if (0 == delta->run_left) {
+                delta->state = delta->op_left ? DELTA_ST_ADD_ZERO : DELTA_ST_OP;
+            }
+            break;
+
+        case DELTA_ST_DATA:
+            n = (len < delta->op_left) ? len : delta->op_left;
+            TUYA_CALL_ERR_RETURN(__delta_put_data(delta, data, n));
+            data += n;
+            len -= n;
+            if (0 == delta->op_left) {
+                delta->state = DELTA_ST_OP;
+            }
+            break;
+
+        case DELTA_ST_END:
+        default:
+            // nothing may follow the end
+            return OPRT_INVALID_PARM;
+        }
+    }
+
+    return rt;
+}
+
+OPERATE_RET tuya_ota_delta_finish(tuya_ota_delta_t *delta)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t digest[32];
+
+    if (NULL == delta) {
+        return OPRT_INVALID_PARM;
+    }
+    if (DELTA_ST_END != delta->state || delta->new_pos != delta->header.new_size) {
+        PR_ERR("delta patch ends early, state %d new %d/%d", delta->state, delta->new_pos, delta->header.new_size);
+        return OPRT_COM_ERROR;
+    }
+    // the image ends with this data, the write callback takes all of it
+    TUYA_CALL_ERR_RETURN(__delta_out_flush(delta));
+    if (delta->out_len) {
+        return OPRT_COM_ERROR;
+    }
+
+    tal_sha256_finish_ret(delta->sha256, digest);
+    if (memcmp(digest, delta->header.new_sha256, sizeof(digest))) {
+        PR_ERR("delta new image sha256 mismatch");
+        return OPRT_COM_ERROR;
+    }
+
+    return rt;
+}
+
+void tuya_ota_delta_destroy(tuya_ota_delta_t *delta)
+{
+    if (NULL == delta) {
+        return;
+    }
+    if (delta->sha256) {
+        tal_sha256_free(delta->sha256);
+    }
+    if (delta->out) {
+        tal_free(delta->out);
+    }
+    tal_free(delta);
+}
@@ -0,0 +1,135 @@
+/**
+ * @file tuya_ota_delta.h
+ * @brief Streaming apply of delta OTA patches against the running firmware.
+ *
+ * A patch made by tools/ota_delta.py starts with a header of
+ * TUYA_OTA_DELTA_HEADER_LEN bytes: the magic "TYDP", the version, the sizes
+ * and SHA-256 of the old and the new image. A list of operations follows:
+ *
+ * - ADD:  varint len, zigzag varint seek of the old position, then the
+ *         difference of len new bytes to the old bytes at that position, as
+ *         pairs of varint zero run, varint literal run and the literal bytes
+ * - DATA: varint len, then len new bytes
+ * - END
+ *
+ * The patch is applied as it arrives, the RAM used is the output buffer and a
+ * small window on the old image. The old image is checked against its SHA-256
+ * before the first byte is written, the new one when the patch ends.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#ifndef __TUYA_OTA_DELTA_H__
+#define __TUYA_OTA_DELTA_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tuya_cloud_types.h"
+
+#define TUYA_OTA_DELTA_MAGIC      "TYDP"
+#define TUYA_OTA_DELTA_VERSION    1
+#define TUYA_OTA_DELTA_HEADER_LEN 80
+
+typedef struct {
+    uint32_t old_size;
+    uint32_t new_size;
+    uint8_t old_sha256[32];
+    uint8_t new_sha256[32];
+} tuya_ota_delta_header_t;
+
+/**
+ * @brief Reads the old image.
+ *
+ * @param[in] offset offset in the old image
+ * @param[out] buf the data
+ * @param[in] len bytes to read
+ * @param[in] user_data user data of the delta
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+typedef OPERATE_RET (*tuya_ota_delta_read_cb_t)(uint32_t offset, uint8_t *buf, uint32_t len, void *user_data);
+
+/**
+ * @brief Writes the new image, the same contract as tal_ota_data_process():
+ * the last remain_len bytes are not consumed and are passed again.
+ *
+ * @param[in] data the data
+ * @param[in] len the data length
+ * @param[in] offset offset in the new image
+ * @param[out] remain_len bytes at the end of the data that were not consumed
+ * @param[in] user_data user data of the delta
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+typedef OPERATE_RET (*tuya_ota_delta_write_cb_t)(uint8_t *data, size_t len, size_t offset, uint32_t *remain_len,
+                                                 void *user_data);
+
+typedef struct {
+    size_t out_size;                 // output buffer, the most data of one write callback
+    tuya_ota_delta_read_cb_t read;   // reads the running image
+    tuya_ota_delta_write_cb_t write; // writes the new image
+    void *user_data;
+} tuya_ota_delta_cfg_t;
+
+typedef struct tuya_ota_delta tuya_ota_delta_t;
+
+/**
+ * @brief Checks whether the data starts a delta patch of a supported version.
+ *
+ * @param[in] data the first bytes of the file
+ * @param[in] len the data length, at least TUYA_OTA_DELTA_HEADER_LEN
+ * @param[out] header the header, may be NULL
+ *
+ * @return TRUE for a delta patch
+ */
+BOOL_T tuya_ota_delta_header_parse(const uint8_t *data, size_t len, tuya_ota_delta_header_t *header);
+
+/**
+ * @brief Allocates the buffers of a patch apply.
+ *
+ * @param[in] cfg the configuration
+ * @param[out] delta the delta handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ota_delta_create(const tuya_ota_delta_cfg_t *cfg, tuya_ota_delta_t **delta);
+
+/**
+ * @brief Applies the next bytes of the patch, from the header on.
+ *
+ * The old image is read and checked once the header is complete.
+ *
+ * @param[in] delta the delta handle
+ * @param[in] data the patch data
+ * @param[in] len the data length
+ *
+ * @return OPRT_OK on success, OPRT_NOT_SUPPORTED for a patch of another old
+ * image, OPRT_INVALID_PARM for a malformed patch, or the error of a callback.
+ */
+OPERATE_RET tuya_ota_delta_apply(tuya_ota_delta_t *delta, const uint8_t *data, size_t len);
+
+/**
+ * @brief Writes the rest of the new image and checks it.
+ *
+ * @param[in] delta the delta handle
+ *
+ * @return OPRT_OK when the patch ended and the new image matches its SHA-256,
+ * OPRT_COM_ERROR otherwise, or the error of the write callback.
+ */
+OPERATE_RET tuya_ota_delta_finish(tuya_ota_delta_t *delta);
+
+/**
+ * @brief Frees the delta.
+ *
+ * @param[in] delta the delta handle
+ */
+void tuya_ota_delta_destroy(tuya_ota_delta_t *delta);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TUYA_OTA_DELTA_H__ */
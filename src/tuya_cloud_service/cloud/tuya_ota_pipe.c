@@ -0,0 +1,228 @@
+/**
+ * @file tuya_ota_pipe.c
+ * @brief Writer task that commits OTA data behind the download.
+ *
+ * Buffers circulate between two queues: the download thread takes a free one,
+ * fills it and posts it to the writer, the writer commits it and posts it back.
+ * The writer keeps the bytes the write callback did not consume in a work
+ * buffer of its own and puts the next data behind them, so the callback sees
+ * the same stream as tal_ota_data_process() on the download thread.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tal_api.h"
+#include "tuya_ota_pipe.h"
+
+typedef struct {
+    size_t offset;
+    size_t len;
+    uint8_t data[0];
+} tuya_ota_pipe_buf_t;
+
+struct tuya_ota_pipe {
+    tuya_ota_pipe_cfg_t cfg;
+    QUEUE_HANDLE free_queue; // buffers the download may fill
+    QUEUE_HANDLE data_queue; // buffers for the writer, NULL stops it
+    SEM_HANDLE stopped;
+    THREAD_HANDLE thread;
+    uint8_t *bufs;
+    uint8_t *work; // data not consumed by the write callback, then the next data
+    size_t work_len;
+    size_t work_offset;
+    bool running;
+    volatile bool abort;
+    volatile OPERATE_RET status;
+};
+
+#define OTA_PIPE_BUF(pipe, i)                                                                                          \
+    ((tuya_ota_pipe_buf_t *)((pipe)->bufs + (i) * (sizeof(tuya_ota_pipe_buf_t) + (pipe)->cfg.buf_size)))
+
+static OPERATE_RET __ota_pipe_commit(tuya_ota_pipe_t *pipe, tuya_ota_pipe_buf_t *buf)
+{
+    OPERATE_RET rt = OPRT_OK;
+    size_t done = 0, n = 0;
+    uint32_t remain_len = 0;
+
+    if (0 == pipe->work_len) {
+        pipe->work_offset = buf->offset;
+    }
+
+    while (done < buf->len) {
+        n = pipe->cfg.buf_size - pipe->work_len;
+        if (n > buf->len - done) {
+            n = buf->len - done;
+        }
+        memcpy(pipe->work + pipe->work_len, buf->data + done, n);
+        pipe->work_len += n;
+        done += n;
+
+        remain_len = 0;
+        rt = pipe->cfg.write(pipe->work, pipe->work_len, pipe->work_offset, &remain_len, pipe->cfg.user_data);
+        if (OPRT_OK != rt) {
+            return rt;
+        }
+        if (remain_len > pipe->work_len || (remain_len == pipe->work_len && pipe->work_len == pipe->cfg.buf_size)) {
+            // nothing consumed from a full work buffer, more data cannot help
+            return OPRT_EXCEED_UPPER_LIMIT;
+        }
+        if (remain_len) {
+            memmove(pipe->work, pipe->work + (pipe->work_len - remain_len), remain_len);
+        }
+        pipe->work_offset += pipe->work_len - remain_len;
+        pipe->work_len = remain_len;
+    }
+
+    return OPRT_OK;
+}
+
+static void __ota_pipe_task(void *arg)
+{
+    tuya_ota_pipe_t *pipe = (tuya_ota_pipe_t *)arg;
+    tuya_ota_pipe_buf_t *buf = NULL;
+    OPERATE_RET rt = OPRT_OK;
+
+    while (1) {
+        if (OPRT_OK != tal_queue_fetch(pipe->data_queue, &buf, SEM_WAIT_FOREVER)) {
+            continue;
+        }
+        if (NULL == buf) {
+            break;
+        }
+        // after an error the buffers only go back to the download
+        if (OPRT_OK == pipe->status && !pipe->abort) {
+            rt = __ota_pipe_commit(pipe, buf);
+            if (OPRT_OK != rt) {
+                PR_ERR("ota pipe write at %d fail:%d", pipe->work_offset, rt);
+                pipe->status = rt;
+            }
+        }
+        tal_queue_post(pipe->free_queue, &buf, SEM_WAIT_FOREVER);
+    }
+
+    // the pipe may be freed once this is posted
+    tal_semaphore_post(pipe->stopped);
+}
+
+OPERATE_RET tuya_ota_pipe_create(const tuya_ota_pipe_cfg_t *cfg, tuya_ota_pipe_t **pipe)
+{
+    OPERATE_RET rt = OPRT_OK;
+    tuya_ota_pipe_t *p = NULL;
+    tuya_ota_pipe_buf_t *buf = NULL;
+    uint8_t i = 0;
+
+    if (NULL == cfg || NULL == pipe || NULL == cfg->write || cfg->buf_num < 2 || 0 == cfg->buf_size) {
+        return OPRT_INVALID_PARM;
+    }
+
+    p = tal_calloc(1, sizeof(tuya_ota_pipe_t));
+    TUYA_CHECK_NULL_RETURN(p, OPRT_MALLOC_FAILED);
+    memcpy(&p->cfg, cfg, sizeof(tuya_ota_pipe_cfg_t));
+
+    p->bufs = tal_malloc(cfg->buf_num * (sizeof(tuya_ota_pipe_buf_t) + cfg->buf_size));
+    p->work = tal_malloc(cfg->buf_size);
+    if (NULL == p->bufs || NULL == p->work) {
+        rt = OPRT_MALLOC_FAILED;
+        goto __EXIT;
+    }
+    TUYA_CALL_ERR_GOTO(tal_queue_create_init(&p->free_queue, sizeof(tuya_ota_pipe_buf_t *), cfg->buf_num), __EXIT);
+    // one more for the stop message
+    TUYA_CALL_ERR_GOTO(tal_queue_create_init(&p->data_queue, sizeof(tuya_ota_pipe_buf_t *), cfg->buf_num + 1),
+                       __EXIT);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&p->stopped, 0, 1), __EXIT);
+    for (i = 0; i < cfg->buf_num; i++) {
+        buf = OTA_PIPE_BUF(p, i);
+        TUYA_CALL_ERR_GOTO(tal_queue_post(p->free_queue, &buf, 0), __EXIT);
+    }
+
+    THREAD_CFG_T thrd_param = {0};
+    thrd_param.priority = THREAD_PRIO_3;
+    thrd_param.stackDepth = cfg->stack_size ? cfg->stack_size : 4096;
+    thrd_param.thrdname = "ota_pipe";
+    TUYA_CALL_ERR_GOTO(tal_thread_create_and_start(&p->thread, NULL, NULL, __ota_pipe_task, p, &thrd_param), __EXIT);
+    p->running = true;
+
+    *pipe = p;
+    return OPRT_OK;
+
+__EXIT:
+    tuya_ota_pipe_destroy(p);
+    return rt;
+}
+
+OPERATE_RET tuya_ota_pipe_write(tuya_ota_pipe_t *pipe, const uint8_t *data, size_t len, size_t offset)
+{
+    tuya_ota_pipe_buf_t *buf = NULL;
+    size_t n = 0;
+
+    if (NULL == pipe || !pipe->running) {
+        return OPRT_INVALID_PARM;
+    }
+
+    while (len) {
+        if (OPRT_OK != pipe->status) {
+            return pipe->status;
+        }
+        // backpressure, wait for the writer to give a buffer back
+        if (OPRT_OK != tal_queue_fetch(pipe->free_queue, &buf, SEM_WAIT_FOREVER)) {
+            continue;
+        }
+        n = (len < pipe->cfg.buf_size) ? len : pipe->cfg.buf_size;
+        memcpy(buf->data, data, n);
+        buf->offset = offset;
+        buf->len = n;
+        tal_queue_post(pipe->data_queue, &buf, SEM_WAIT_FOREVER);
+        data += n;
+        offset += n;
+        len -= n;
+    }
+
+    return pipe->status;
+}
+
+OPERATE_RET tuya_ota_pipe_finish(tuya_ota_pipe_t *pipe)
+{
+    tuya_ota_pipe_buf_t *stop = NULL;
+
+    if (NULL == pipe) {
+        return OPRT_INVALID_PARM;
+    }
+    if (pipe->running) {
+        tal_queue_post(pipe->data_queue, &stop, SEM_WAIT_FOREVER);
+        tal_semaphore_wait_forever(pipe->stopped);
+        tal_thread_delete(pipe->thread);
+        pipe->thread = NULL;
+        pipe->running = false;
+    }
+
+    return pipe->status;
+}
+
+void tuya_ota_pipe_destroy(tuya_ota_pipe_t *pipe)
+{
+    if (NULL == pipe) {
+        return;
+    }
+
+    // the buffers still queued are dropped
+    pipe->abort = true;
+    tuya_ota_pipe_finish(pipe);
+
+    if (pipe->stopped) {
+        tal_semaphore_release(pipe->stopped);
+    }
+    if (pipe->data_queue) {
+        tal_queue_free(pipe->data_queue);
+    }
+    if (pipe->free_queue) {
+        tal_queue_free(pipe->free_queue);
+    }
+    if (pipe->work) {
+        tal_free(pipe->work);
+    }
+    if (pipe->bufs) {
+        tal_free(pipe->bufs);
+    }
+    tal_free(pipe);
+}
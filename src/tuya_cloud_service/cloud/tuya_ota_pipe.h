@@ -0,0 +1,96 @@
+/**
+ * @file tuya_ota_pipe.h
+ * @brief Writer task that commits OTA data behind the download.
+ *
+ * The download thread copies every piece of the image into one of a few
+ * buffers and goes back to the socket, a writer task hands the buffers in
+ * order to the write callback, which hashes them and writes the flash. When
+ * all buffers are waiting for the writer the download thread blocks, so a
+ * slow flash throttles the download instead of growing the memory.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#ifndef __TUYA_OTA_PIPE_H__
+#define __TUYA_OTA_PIPE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tuya_cloud_types.h"
+
+/**
+ * @brief Commits data on the writer task, the same contract as
+ * tal_ota_data_process(): the last remain_len bytes are not consumed and are
+ * passed again, in front of the next data.
+ *
+ * @param[in] data the data
+ * @param[in] len the data length
+ * @param[in] offset file offset of the data
+ * @param[out] remain_len bytes at the end of the data that were not consumed
+ * @param[in] user_data user data of the pipe
+ *
+ * @return OPRT_OK on success, an error stops the pipe and is returned by
+ * tuya_ota_pipe_write() and tuya_ota_pipe_finish().
+ */
+typedef OPERATE_RET (*tuya_ota_pipe_write_cb_t)(uint8_t *data, size_t len, size_t offset, uint32_t *remain_len,
+                                                void *user_data);
+
+typedef struct {
+    uint8_t buf_num;                // buffers between the download and the writer, at least 2
+    size_t buf_size;                // size of a buffer, also the most data of one write callback
+    uint32_t stack_size;            // stack of the writer task
+    tuya_ota_pipe_write_cb_t write; // runs on the writer task
+    void *user_data;
+} tuya_ota_pipe_cfg_t;
+
+typedef struct tuya_ota_pipe tuya_ota_pipe_t;
+
+/**
+ * @brief Allocates the buffers and starts the writer task.
+ *
+ * @param[in] cfg the configuration
+ * @param[out] pipe the pipe handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ota_pipe_create(const tuya_ota_pipe_cfg_t *cfg, tuya_ota_pipe_t **pipe);
+
+/**
+ * @brief Queues data for the writer, blocks while no buffer is free.
+ *
+ * The data must continue the data queued before.
+ *
+ * @param[in] pipe the pipe handle
+ * @param[in] data the data
+ * @param[in] len the data length
+ * @param[in] offset file offset of the data
+ *
+ * @return OPRT_OK on success, the error of the write callback once it failed.
+ */
+OPERATE_RET tuya_ota_pipe_write(tuya_ota_pipe_t *pipe, const uint8_t *data, size_t len, size_t offset);
+
+/**
+ * @brief Waits until the writer has committed all queued data and stops it.
+ *
+ * @param[in] pipe the pipe handle
+ *
+ * @return OPRT_OK on success, the error of the write callback once it failed.
+ */
+OPERATE_RET tuya_ota_pipe_finish(tuya_ota_pipe_t *pipe);
+
+/**
+ * @brief Stops the writer if tuya_ota_pipe_finish() was not called and frees
+ * the pipe.
+ *
+ * @param[in] pipe the pipe handle
+ */
+void tuya_ota_pipe_destroy(tuya_ota_pipe_t *pipe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TUYA_OTA_PIPE_H__ */
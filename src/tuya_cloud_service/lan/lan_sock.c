@@ -6,11 +6,13 @@
  * The mechanism is designed to manage multiple socket readers, handle socket
  * events efficiently, and provide a clean shutdown process.
  *
- * The implementation utilizes a select-based approach to monitor and react to
- * socket events across multiple sockets. It supports operations such as adding
- * a new socket reader, updating existing readers, and removing readers. Error
- * handling and socket event detection are integral parts of the loop to ensure
- * robust operation.
+ * The loop waits on a backend chosen at build time, epoll on Linux and select
+ * on the other platforms, and sleeps until a socket has I/O or another thread
+ * wakes it up through an eventfd (a loopback datagram socket with select)
+ * after posting a registration change or queuing data to send. It supports
+ * operations such as adding a new socket reader, updating existing readers,
+ * and removing readers. Error handling and socket event detection are integral
+ * parts of the loop to ensure robust operation.
  *
  * Additionally, the file includes utility functions for setting up the
  * environment for socket event handling, including initializing and
@@ -30,6 +32,37 @@
 #include "tal_network.h"
 #include "tuya_lan.h"
 
+#if OPERATING_SYSTEM == SYSTEM_LINUX
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define LAN_SLOOP_USING_EPOLL 1
+#else
+#define LAN_SLOOP_USING_SELECT 1
+#endif
+
+// the loop sleeps this long at most while a pre_select handler is registered
+#ifndef LAN_SLOOP_IDLE_MS
+#define LAN_SLOOP_IDLE_MS (5 * 1000)
+#endif
+
+// the wakeup socket of the select backend binds a random port of the dynamic range
+#define LAN_SLOOP_WAKEUP_PORT_MIN  49152
+#define LAN_SLOOP_WAKEUP_PORT_NUM  16384
+#define LAN_SLOOP_WAKEUP_BIND_TRY  8
+#define LAN_SLOOP_WAKEUP_PROBE_MS  100
+
+// select timeout when the wakeup socket is unavailable
+#define LAN_SLOOP_POLL_MS 1000
+
+#define LAN_SLOOP_EVENT_NUM 8
+#define LAN_SLOOP_WAKE_TAG  0xFFFFFFFF
+
+#define SLOOP_EV_READ  0x01
+#define SLOOP_EV_WRITE 0x02
+#define SLOOP_EV_ERR   0x04
+
 #pragma pack(1)
 
 #define LAN_UDP_READER_CNT 5
@@ -38,8 +71,20 @@ typedef struct LAN_SLOOP_S {
     THREAD_HANDLE thread;
     int cnt;
     sloop_sock_t *readers;
+    uint8_t *events;  // interest of every reader, SLOOP_EV_*
+    uint8_t *revents; // readiness of every reader after a wait, SLOOP_EV_*
     BOOL_T terminate;
     QUEUE_HANDLE queue;
+    int wake_fd; // wakes the loop up from another thread
+#if defined(LAN_SLOOP_USING_EPOLL)
+    int epoll_fd;
+#else
+    TUYA_FD_SET_T *rfds;
+    TUYA_FD_SET_T *wfds;
+    TUYA_FD_SET_T *efds;
+    uint16_t wake_port;
+    BOOL_T wake_err; // a wakeup datagram could not be sent, poll every LAN_SLOOP_POLL_MS
+#endif
 } LAN_SLOOP_S, *P_LAN_SLOOP_S;
 #pragma pack()
 
@@ -55,17 +100,305 @@ static uint32_t __ty_sock_get_reader_num(void)
     return (LAN_UDP_READER_CNT + tuya_lan_get_client_num());
 }
 
-static void __sock_table_set_fds(TUYA_FD_SET_T *rfds, TUYA_FD_SET_T *efds)
+/***********************************************************
+*********************** loop backend ***********************
+***********************************************************/
+#if defined(LAN_SLOOP_USING_EPOLL)
+/* epoll keeps the interest list in the kernel, a wait costs the ready socks only */
+static OPERATE_RET __sloop_backend_init(void)
 {
-    int idx;
+    struct epoll_event ev = {.events = EPOLLIN, .data.u32 = LAN_SLOOP_WAKE_TAG};
+
+    g_sloop->wake_fd = -1;
+    g_sloop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (g_sloop->epoll_fd < 0) {
+        PR_ERR("epoll create err:%d", errno);
+        return OPRT_COM_ERROR;
+    }
+
+    g_sloop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_sloop->wake_fd < 0 || epoll_ctl(g_sloop->epoll_fd, EPOLL_CTL_ADD, g_sloop->wake_fd, &ev) < 0) {
+        PR_ERR("eventfd err:%d", errno);
+        return OPRT_COM_ERROR;
+    }
+
+    return OPRT_OK;
+}
+
+static void __sloop_backend_deinit(void)
+{
+    if (g_sloop->wake_fd >= 0) {
+        close(g_sloop->wake_fd);
+        g_sloop->wake_fd = -1;
+    }
+    if (g_sloop->epoll_fd >= 0) {
+        close(g_sloop->epoll_fd);
+        g_sloop->epoll_fd = -1;
+    }
+}
+
+static uint32_t __sloop_epoll_events(uint8_t events)
+{
+    return EPOLLIN | ((events & SLOOP_EV_WRITE) ? EPOLLOUT : 0);
+}
+
+static void __sloop_backend_add(int idx)
+{
+    struct epoll_event ev = {.events = __sloop_epoll_events(g_sloop->events[idx]), .data.u32 = idx};
+
+    if (epoll_ctl(g_sloop->epoll_fd, EPOLL_CTL_ADD, g_sloop->readers[idx].sock, &ev) < 0) {
+        // an update of a registered sock
+        if (errno != EEXIST || epoll_ctl(g_sloop->epoll_fd, EPOLL_CTL_MOD, g_sloop->readers[idx].sock, &ev) < 0) {
+            PR_ERR("epoll add sock %d err:%d", g_sloop->readers[idx].sock, errno);
+        }
+    }
+}
+
+static void __sloop_backend_mod(int idx, uint8_t events)
+{
+    struct epoll_event ev = {.events = __sloop_epoll_events(events), .data.u32 = idx};
+
+    g_sloop->events[idx] = events;
+    if (epoll_ctl(g_sloop->epoll_fd, EPOLL_CTL_MOD, g_sloop->readers[idx].sock, &ev) < 0) {
+        PR_ERR("epoll mod sock %d err:%d", g_sloop->readers[idx].sock, errno);
+    }
+}
+
+static void __sloop_backend_del(int idx)
+{
+    struct epoll_event ev = {0};
+
+    epoll_ctl(g_sloop->epoll_fd, EPOLL_CTL_DEL, g_sloop->readers[idx].sock, &ev);
+}
+
+static int __sloop_backend_wait(uint32_t ms_timeout, BOOL_T forever)
+{
+    struct epoll_event evs[LAN_SLOOP_EVENT_NUM];
+    uint64_t count = 0;
+    int i, n, ready = 0;
+    uint32_t idx;
+
+    n = epoll_wait(g_sloop->epoll_fd, evs, LAN_SLOOP_EVENT_NUM, forever ? -1 : (int)ms_timeout);
+    if (n < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    for (i = 0; i < n; i++) {
+        idx = evs[i].data.u32;
+        if (idx == LAN_SLOOP_WAKE_TAG) {
+            while (read(g_sloop->wake_fd, &count, sizeof(count)) > 0) {
+            }
+            continue;
+        }
+        if (idx >= __ty_sock_get_reader_num()) {
+            continue;
+        }
+        // a hang up is read as the end of the stream
+        if (evs[i].events & (EPOLLIN | EPOLLHUP)) {
+            g_sloop->revents[idx] |= SLOOP_EV_READ;
+        }
+        if (evs[i].events & EPOLLOUT) {
+            g_sloop->revents[idx] |= SLOOP_EV_WRITE;
+        }
+        if (evs[i].events & EPOLLERR) {
+            g_sloop->revents[idx] |= SLOOP_EV_ERR;
+        }
+        ready++;
+    }
+
+    return ready;
+}
+
+static void __sloop_backend_wakeup(void)
+{
+    uint64_t one = 1;
+
+    if (write(g_sloop->wake_fd, &one, sizeof(one)) < 0) {
+        // the counter is already set, the loop wakes up anyway
+    }
+}
+
+#else
+/* select on the TKL, woken up by a datagram to a loopback socket */
+static OPERATE_RET __sloop_wakeup_sock_bind(void)
+{
+    int i;
+    uint16_t port;
+
+    // TAL cannot tell the port the stack picked for port 0, so choose one and retry if it is taken
+    for (i = 0; i < LAN_SLOOP_WAKEUP_BIND_TRY; i++) {
+        port = LAN_SLOOP_WAKEUP_PORT_MIN + tal_system_get_random(LAN_SLOOP_WAKEUP_PORT_NUM - 1);
+        if (tal_net_bind(g_sloop->wake_fd, tal_net_str2addr("127.0.0.1"), port) == 0) {
+            g_sloop->wake_port = port;
+            return OPRT_OK;
+        }
+    }
+
+    return OPRT_SOCK_ERR;
+}
+
+static OPERATE_RET __sloop_wakeup_sock_probe(void)
+{
+    uint8_t drain[4];
+    TUYA_IP_ADDR_T addr = 0;
+    uint16_t port = 0;
+
+    // lwIP without loopback accepts the datagram but never delivers it
+    if (tal_net_send_to(g_sloop->wake_fd, "w", 1, tal_net_str2addr("127.0.0.1"), g_sloop->wake_port) != 1) {
+        return OPRT_SEND_ERR;
+    }
+    tal_net_fd_zero(g_sloop->rfds);
+    tal_net_fd_set(g_sloop->wake_fd, g_sloop->rfds);
+    if (tal_net_select(g_sloop->wake_fd + 1, g_sloop->rfds, NULL, NULL, LAN_SLOOP_WAKEUP_PROBE_MS) <= 0 ||
+        tal_net_recvfrom(g_sloop->wake_fd, drain, sizeof(drain), &addr, &port) <= 0) {
+        return OPRT_RECV_ERR;
+    }
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __sloop_backend_init(void)
+{
+    g_sloop->rfds = tal_malloc(sizeof(TUYA_FD_SET_T));
+    g_sloop->wfds = tal_malloc(sizeof(TUYA_FD_SET_T));
+    g_sloop->efds = tal_malloc(sizeof(TUYA_FD_SET_T));
+    if (g_sloop->rfds == NULL || g_sloop->wfds == NULL || g_sloop->efds == NULL) {
+        PR_ERR("malloc err");
+        return OPRT_MALLOC_FAILED;
+    }
+
+    g_sloop->wake_fd = tal_net_socket_create(PROTOCOL_UDP);
+    if (g_sloop->wake_fd < 0) {
+        PR_WARN("wakeup sock create err, poll every %dms", LAN_SLOOP_POLL_MS);
+        return OPRT_OK;
+    }
+    tal_net_set_block(g_sloop->wake_fd, false);
+    if (OPRT_OK != __sloop_wakeup_sock_bind() || OPRT_OK != __sloop_wakeup_sock_probe()) {
+        PR_WARN("wakeup sock unavailable, poll every %dms", LAN_SLOOP_POLL_MS);
+        tal_net_close(g_sloop->wake_fd);
+        g_sloop->wake_fd = -1;
+    }
+
+    return OPRT_OK;
+}
+
+static void __sloop_backend_deinit(void)
+{
+    if (g_sloop->wake_fd >= 0) {
+        tal_net_close(g_sloop->wake_fd);
+        g_sloop->wake_fd = -1;
+    }
+    if (g_sloop->rfds) {
+        tal_free(g_sloop->rfds);
+        g_sloop->rfds = NULL;
+    }
+    if (g_sloop->wfds) {
+        tal_free(g_sloop->wfds);
+        g_sloop->wfds = NULL;
+    }
+    if (g_sloop->efds) {
+        tal_free(g_sloop->efds);
+        g_sloop->efds = NULL;
+    }
+}
+
+static void __sloop_backend_add(int idx)
+{
+}
+
+static void __sloop_backend_mod(int idx, uint8_t events)
+{
+    g_sloop->events[idx] = events;
+}
+
+static void __sloop_backend_del(int idx)
+{
+}
+
+static int __sloop_backend_wait(uint32_t ms_timeout, BOOL_T forever)
+{
+    uint8_t drain[4];
+    TUYA_IP_ADDR_T addr = 0;
+    uint16_t port = 0;
+    int idx, n, ready = 0;
+    int max_sock = g_sloop->wake_fd;
+    BOOL_T wcnt = FALSE;
+
+    tal_net_fd_zero(g_sloop->rfds);
+    tal_net_fd_zero(g_sloop->wfds);
+    tal_net_fd_zero(g_sloop->efds);
+    if (g_sloop->wake_fd >= 0) {
+        tal_net_fd_set(g_sloop->wake_fd, g_sloop->rfds);
+    }
+    if (g_sloop->wake_fd < 0 || g_sloop->wake_err) {
+        ms_timeout = LAN_SLOOP_POLL_MS;
+        forever = FALSE;
+    }
     for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
-        if (g_sloop->readers[idx].sock >= 0) {
-            tal_net_fd_set(g_sloop->readers[idx].sock, rfds);
-            tal_net_fd_set(g_sloop->readers[idx].sock, efds);
+        if (g_sloop->readers[idx].sock < 0) {
+            continue;
         }
+        tal_net_fd_set(g_sloop->readers[idx].sock, g_sloop->rfds);
+        tal_net_fd_set(g_sloop->readers[idx].sock, g_sloop->efds);
+        if (g_sloop->events[idx] & SLOOP_EV_WRITE) {
+            tal_net_fd_set(g_sloop->readers[idx].sock, g_sloop->wfds);
+            wcnt = TRUE;
+        }
+        if (g_sloop->readers[idx].sock > max_sock) {
+            max_sock = g_sloop->readers[idx].sock;
+        }
+    }
+    if (max_sock < 0) {
+        tal_system_sleep(ms_timeout);
+        return 0;
+    }
+
+    n = tal_net_select(max_sock + 1, g_sloop->rfds, wcnt ? g_sloop->wfds : NULL, g_sloop->efds,
+                       forever ? LAN_SLOOP_IDLE_MS : ms_timeout);
+    if (n <= 0) {
+        return n;
+    }
+
+    if (g_sloop->wake_fd >= 0 && tal_net_fd_isset(g_sloop->wake_fd, g_sloop->rfds)) {
+        while (tal_net_recvfrom(g_sloop->wake_fd, drain, sizeof(drain), &addr, &port) > 0) {
+        }
+    }
+    for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
+        if (g_sloop->readers[idx].sock < 0) {
+            continue;
+        }
+        if (tal_net_fd_isset(g_sloop->readers[idx].sock, g_sloop->rfds)) {
+            g_sloop->revents[idx] |= SLOOP_EV_READ;
+        }
+        if (wcnt && tal_net_fd_isset(g_sloop->readers[idx].sock, g_sloop->wfds)) {
+            g_sloop->revents[idx] |= SLOOP_EV_WRITE;
+        }
+        if (tal_net_fd_isset(g_sloop->readers[idx].sock, g_sloop->efds)) {
+            g_sloop->revents[idx] |= SLOOP_EV_ERR;
+        }
+        if (g_sloop->revents[idx]) {
+            ready++;
+        }
+    }
+
+    return ready;
+}
+
+static void __sloop_backend_wakeup(void)
+{
+    if (g_sloop->wake_fd >= 0 && !g_sloop->wake_err &&
+        tal_net_send_to(g_sloop->wake_fd, "w", 1, tal_net_str2addr("127.0.0.1"), g_sloop->wake_port) != 1 &&
+        tal_net_get_errno() != UNW_EAGAIN && tal_net_get_errno() != UNW_EWOULDBLOCK) {
+        // a full socket buffer means the loop has wakeups pending anyway
+        PR_WARN("wakeup send err, poll every %dms", LAN_SLOOP_POLL_MS);
+        g_sloop->wake_err = TRUE;
     }
 }
+#endif
 
+/***********************************************************
+************************ sock table ************************
+***********************************************************/
 static void __sock_select_err_handle()
 {
     int idx;
@@ -79,6 +412,26 @@ static void __sock_select_err_handle()
     return;
 }
 
+/* asks the socks with a write handler whether they have queued data */
+static void __sock_table_update_events(void)
+{
+    int idx;
+    uint8_t events;
+    for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
+        if (g_sloop->readers[idx].sock < 0 || NULL == g_sloop->readers[idx].write) {
+            continue;
+        }
+        events = SLOOP_EV_READ;
+        // only socks with queued data, an idle sock is always writable
+        if (g_sloop->readers[idx].want_write && g_sloop->readers[idx].want_write(g_sloop->readers[idx].sock)) {
+            events |= SLOOP_EV_WRITE;
+        }
+        if (events != g_sloop->events[idx]) {
+            __sloop_backend_mod(idx, events);
+        }
+    }
+}
+
 void __ty_sock_loop_deinit(void)
 {
     if (NULL == g_sloop) {
@@ -96,12 +449,20 @@ void __ty_sock_loop_deinit(void)
                 g_sloop->readers[idx].read = NULL;
                 g_sloop->readers[idx].err = NULL;
                 g_sloop->readers[idx].quit = NULL;
+                g_sloop->readers[idx].want_write = NULL;
+                g_sloop->readers[idx].write = NULL;
                 g_sloop->cnt--;
             }
         }
         tal_free(g_sloop->readers);
         g_sloop->readers = NULL;
     }
+    if (g_sloop->events) {
+        tal_free(g_sloop->events);
+        g_sloop->events = NULL;
+        g_sloop->revents = NULL;
+    }
+    __sloop_backend_deinit();
     if (g_sloop->queue) {
         tal_queue_free(g_sloop->queue);
     }
@@ -147,6 +508,9 @@ void __ty_add_sock_reader(sloop_sock_t sock_info)
         return;
     }
 
+    g_sloop->events[idx] = SLOOP_EV_READ;
+    __sloop_backend_add(idx);
+
     return;
 }
 
@@ -156,12 +520,17 @@ void __ty_del_sock_reader(int sock)
     for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
         if (g_sloop->readers[idx].sock == sock) {
             PR_DEBUG("unreg lan sock %d and close it", sock);
+            __sloop_backend_del(idx);
             tal_net_close(g_sloop->readers[idx].sock);
             g_sloop->readers[idx].sock = -1;
             // g_sloop->readers[idx].pre_select = NULL;
             g_sloop->readers[idx].read = NULL;
             g_sloop->readers[idx].err = NULL;
             g_sloop->readers[idx].quit = NULL;
+            g_sloop->readers[idx].want_write = NULL;
+            g_sloop->readers[idx].write = NULL;
+            g_sloop->events[idx] = 0;
+            g_sloop->revents[idx] = 0;
             g_sloop->cnt--;
             break;
         }
@@ -179,43 +548,33 @@ void tuya_sock_loop_run(void *data)
 {
     int actv_cnt = 0;
     int idx = 0;
-    TUYA_FD_SET_T *rfds, *efds;
+    BOOL_T has_pre_select = FALSE;
     sloop_sock_t queue_data = {0};
 
-    rfds = tal_malloc(sizeof(TUYA_FD_SET_T));
-    efds = tal_malloc(sizeof(TUYA_FD_SET_T));
-    if (rfds == NULL || efds == NULL) {
-        PR_ERR("malloc err");
-        goto Err;
-    }
-    memset(rfds, 0, sizeof(TUYA_FD_SET_T));
-    memset(efds, 0, sizeof(TUYA_FD_SET_T));
-
     // while (tuya_get_sock_loop_terminate() &&
     // tal_thread_get_state(g_sloop->thread) == THREAD_STATE_RUNNING) {
     while (tuya_get_sock_loop_terminate()) {
+        // registrations are posted with a wakeup, take all of them
         memset(&queue_data, 0, sizeof(sloop_sock_t));
-        if (tal_queue_fetch(g_sloop->queue, &queue_data, 0) == 0) {
+        while (tal_queue_fetch(g_sloop->queue, &queue_data, 0) == 0) {
             if (queue_data.read) {
                 __ty_add_sock_reader(queue_data);
             } else {
                 __ty_del_sock_reader(queue_data.sock);
             }
+            memset(&queue_data, 0, sizeof(sloop_sock_t));
         }
+        has_pre_select = FALSE;
         for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
             if (g_sloop->readers[idx].pre_select) {
                 g_sloop->readers[idx].pre_select();
+                has_pre_select = TRUE;
             }
         }
-        if (g_sloop->cnt == 0) {
-            tal_system_sleep(2000);
-            continue;
-        }
+        __sock_table_update_events();
 
-        tal_net_fd_zero(rfds);
-        tal_net_fd_zero(efds);
-        __sock_table_set_fds(rfds, efds);
-        actv_cnt = tal_net_select(g_sloop->max_sock + 1, rfds, NULL, efds, 1 * 1000);
+        // sleep until I/O or a wakeup, pre_select handlers still run every LAN_SLOOP_IDLE_MS
+        actv_cnt = __sloop_backend_wait(LAN_SLOOP_IDLE_MS, !has_pre_select);
         if (actv_cnt < 0) {
             PR_ERR("errno:%d", tal_net_get_errno());
             __sock_select_err_handle();
@@ -223,40 +582,33 @@ void tuya_sock_loop_run(void *data)
             continue;
         } else if (actv_cnt == 0) {
             continue;
-        } else {
-            for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
-                if (g_sloop->readers[idx].sock >= 0) {
-                    if (0 == tal_net_fd_isset(g_sloop->readers[idx].sock, efds)) {
-                        continue;
-                    }
-                    if (g_sloop->readers[idx].err) {
-                        PR_ERR("socket err:%d, sock:%d, idx:%d", tal_net_get_errno(), g_sloop->readers[idx].sock, idx);
-                        g_sloop->readers[idx].err(g_sloop->readers[idx].sock);
-                    }
-                    actv_cnt--;
-                    if (0 == actv_cnt) {
-                        break;
-                    }
+        }
+
+        for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
+            if (g_sloop->readers[idx].sock >= 0 && (g_sloop->revents[idx] & SLOOP_EV_ERR)) {
+                if (g_sloop->readers[idx].err) {
+                    PR_ERR("socket err:%d, sock:%d, idx:%d", tal_net_get_errno(), g_sloop->readers[idx].sock, idx);
+                    g_sloop->readers[idx].err(g_sloop->readers[idx].sock);
                 }
             }
         }
 
-        if (0 == actv_cnt) {
-            continue;
+        // flush queued data first, a read may queue a reply behind it
+        for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
+            if (g_sloop->readers[idx].sock >= 0 && (g_sloop->revents[idx] & SLOOP_EV_WRITE)) {
+                if (g_sloop->readers[idx].write) {
+                    g_sloop->readers[idx].write(g_sloop->readers[idx].sock);
+                }
+            }
         }
 
         for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
-            if (g_sloop->readers[idx].sock >= 0) {
-                if (tal_net_fd_isset(g_sloop->readers[idx].sock, rfds)) {
-                    if (g_sloop->readers[idx].read) {
-                        g_sloop->readers[idx].read(g_sloop->readers[idx].sock);
-                        actv_cnt--;
-                        if (0 == actv_cnt) {
-                            break;
-                        }
-                    }
+            if (g_sloop->readers[idx].sock >= 0 && (g_sloop->revents[idx] & SLOOP_EV_READ)) {
+                if (g_sloop->readers[idx].read) {
+                    g_sloop->readers[idx].read(g_sloop->readers[idx].sock);
                 }
             }
+            g_sloop->revents[idx] = 0;
         }
     }
 
@@ -266,14 +618,6 @@ void tuya_sock_loop_run(void *data)
         }
     }
 
-Err:
-    if (rfds) {
-        tal_free(rfds);
-    }
-    if (efds) {
-        tal_free(efds);
-    }
-
     tuya_lan_exit();
     __ty_sock_loop_deinit();
 
@@ -306,6 +650,10 @@ OPERATE_RET tuya_sock_loop_init(void)
     }
     memset(g_sloop, 0, sizeof(LAN_SLOOP_S));
     g_sloop->terminate = TRUE;
+    g_sloop->wake_fd = -1;
+#if defined(LAN_SLOOP_USING_EPOLL)
+    g_sloop->epoll_fd = -1;
+#endif
 
     op_ret = tal_queue_create_init(&g_sloop->queue, sizeof(sloop_sock_t), LAN_QUEUE_NUM);
     if (OPRT_OK != op_ret) {
@@ -323,6 +671,20 @@ OPERATE_RET tuya_sock_loop_init(void)
     for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
         g_sloop->readers[idx].sock = -1;
     }
+
+    g_sloop->events = tal_malloc(2 * __ty_sock_get_reader_num());
+    if (NULL == g_sloop->events) {
+        PR_ERR("tal_malloc err");
+        op_ret = OPRT_MALLOC_FAILED;
+        goto Err;
+    }
+    memset(g_sloop->events, 0, 2 * __ty_sock_get_reader_num());
+    g_sloop->revents = g_sloop->events + __ty_sock_get_reader_num();
+
+    op_ret = __sloop_backend_init();
+    if (OPRT_OK != op_ret) {
+        goto Err;
+    }
     THREAD_CFG_T thread_cfg = {.priority = THREAD_PRIO_2, .stackDepth = STACK_SIZE_LAN, .thrdname = "lan_sock_loop"};
 
     op_ret = tal_thread_create_and_start(&g_sloop->thread, NULL, NULL, tuya_sock_loop_run, NULL, &thread_cfg);
@@ -360,6 +722,7 @@ OPERATE_RET tuya_reg_lan_sock(sloop_sock_t sock_info)
         PR_ERR("queue post err");
         return op_ret;
     }
+    __sloop_backend_wakeup();
     PR_DEBUG("reg post queue %d", sock_info.sock);
     return OPRT_OK;
 }
@@ -385,6 +748,7 @@ OPERATE_RET tuya_unreg_lan_sock(int sock)
         PR_ERR("queue post err");
         return op_ret;
     }
+    __sloop_backend_wakeup();
     PR_DEBUG("unreg post queue %d", sock);
     return OPRT_OK;
 }
@@ -402,6 +766,22 @@ void tuya_sock_loop_disable(void)
     }
 
     g_sloop->terminate = FALSE;
+    __sloop_backend_wakeup();
+}
+
+/**
+ * @brief Wakes the socket loop up from another thread.
+ *
+ * The loop sleeps until one of its sockets has I/O. A sender that queued data
+ * on a socket calls this so the loop asks the want_write handlers again.
+ */
+void tuya_sock_loop_wakeup(void)
+{
+    if (NULL == g_sloop) {
+        return;
+    }
+
+    __sloop_backend_wakeup();
 }
 
 /**
@@ -452,6 +832,9 @@ void tuya_dump_lan_sock_reader(void)
             if (g_sloop->readers[idx].quit) {
                 PR_DEBUG("quit:%p", g_sloop->readers[idx].quit);
             }
+            if (g_sloop->readers[idx].write) {
+                PR_DEBUG("write:%p", g_sloop->readers[idx].write);
+            }
         }
     }
     PR_DEBUG("**************lan sock reader info dump end**************");
@@ -57,6 +57,23 @@ typedef void (*sloop_sock_err)(int sock);
  */
 typedef void (*sloop_sock_quit)();
 
+/**
+ * @brief sock write interest handler, called before every select
+ *
+ * @param[in] sock fd
+ *
+ * @return TRUE when the sock has queued data and waits for write readiness
+ */
+typedef BOOL_T (*sloop_sock_want_write)(int sock);
+
+/**
+ * @brief sock write handler, called when the sock is writable
+ *
+ * @param[in] sock fd
+ *
+ */
+typedef void (*sloop_sock_write)(int sock);
+
 /**
  * @brief reg sock info
  *
@@ -67,6 +84,8 @@ typedef struct sloop_sock_t {
     sloop_sock_read read;
     sloop_sock_err err;
     sloop_sock_quit quit;
+    sloop_sock_want_write want_write; // optional, NULL for read only socks
+    sloop_sock_write write;           // optional, NULL for read only socks
 } sloop_sock_t;
 
 /**
@@ -97,6 +116,13 @@ OPERATE_RET tuya_unreg_lan_sock(int sock);
  */
 void tuya_sock_loop_disable();
 
+/**
+ * @brief wake the sock loop up, e.g. after queuing data on a sock with a
+ * write handler
+ *
+ */
+void tuya_sock_loop_wakeup(void);
+
 /**
  * @brief get sock loop terminate vaule
  *
@@ -46,6 +46,10 @@
 #define RAND_LEN       16
 #define SESSIONKEY_LEN 16
 
+#ifndef LAN_SESSION_TX_BUF_SIZE
+#define LAN_SESSION_TX_BUF_SIZE LAN_FRAME_MAX_LEN
+#endif
+
 typedef struct {
     BOOL_T active;
     BOOL_T fault;
@@ -57,6 +61,11 @@ typedef struct {
     uint8_t randB[RAND_LEN];
     uint8_t hmac[HMAC_LEN];
     uint8_t secret_key[SESSIONKEY_LEN];
+    // outbound ring, frames are serialized in place and sent by the sock loop
+    uint8_t *tx_buf;  // LAN_SESSION_TX_BUF_SIZE bytes, allocated on the first send
+    uint32_t tx_head; // first unsent byte
+    uint32_t tx_tail; // end of the queued bytes
+    uint32_t tx_wrap; // end of the bytes from tx_head when the ring wrapped, 0 otherwise
 } lan_session_t;
 
 typedef struct {
@@ -113,6 +122,9 @@ static lan_mgr_t *lan_mgr_get(void)
 
 static void lan_session_free(lan_session_t *session)
 {
+    if (session->tx_buf) {
+        tal_free(session->tx_buf);
+    }
     memset(session, 0, sizeof(lan_session_t));
     session->fd = -1;
 }
@@ -427,6 +439,72 @@ static int lan_get_valid_socket_num(lan_mgr_t *lan)
     return (num - fault_cnt);
 }
 
+static BOOL_T lan_tx_pending(lan_session_t *session)
+{
+    return (session->tx_wrap || session->tx_head != session->tx_tail);
+}
+
+/* contiguous room for a frame, after the queued bytes or from the ring start */
+static uint8_t *lan_tx_reserve(lan_session_t *session, uint32_t len, uint32_t *pos)
+{
+    if (session->tx_wrap) {
+        if (session->tx_head - session->tx_tail < len) {
+            return NULL;
+        }
+        *pos = session->tx_tail;
+    } else if (LAN_SESSION_TX_BUF_SIZE - session->tx_tail >= len) {
+        *pos = session->tx_tail;
+    } else if (session->tx_head >= len) {
+        *pos = 0;
+    } else {
+        return NULL;
+    }
+
+    return session->tx_buf + *pos;
+}
+
+static void lan_tx_commit(lan_session_t *session, uint32_t pos, uint32_t len)
+{
+    if (0 == session->tx_wrap && pos < session->tx_tail) {
+        session->tx_wrap = session->tx_tail;
+    }
+    session->tx_tail = pos + len;
+}
+
+/* sends the queued bytes until the socket would block, call with the lan mutex held */
+static int lan_tx_flush(lan_session_t *session)
+{
+    int ret = 0;
+    uint32_t len = 0;
+
+    while (lan_tx_pending(session)) {
+        len = (session->tx_wrap ? session->tx_wrap : session->tx_tail) - session->tx_head;
+        ret = tal_net_send(session->fd, session->tx_buf + session->tx_head, len);
+        if (ret < 0) {
+            if ((tal_net_get_errno() == UNW_EINTR) || (tal_net_get_errno() == UNW_EAGAIN)) {
+                break;
+            }
+            PR_ERR("fd:%d send err, errno:%d", session->fd, tal_net_get_errno());
+            return OPRT_SVC_LAN_SEND_ERR;
+        }
+
+        session->tx_head += ret;
+        if (session->tx_wrap && session->tx_head == session->tx_wrap) {
+            session->tx_head = 0;
+            session->tx_wrap = 0;
+        }
+        if (0 == session->tx_wrap && session->tx_head == session->tx_tail) {
+            session->tx_head = 0;
+            session->tx_tail = 0;
+        }
+        if ((uint32_t)ret < len) {
+            break;
+        }
+    }
+
+    return OPRT_OK;
+}
+
 static int lan_send(lan_session_t *session, uint32_t fr_num, uint32_t fr_type, uint32_t ret_code, uint8_t *data,
                     uint32_t len, BOOL_T encryption)
 {
@@ -439,16 +517,6 @@ static int lan_send(lan_session_t *session, uint32_t fr_num, uint32_t fr_type, u
         PR_ERR("session->active == false");
         return OPRT_COM_ERROR;
     }
-    tal_mutex_lock(s_lan_mgr->mutex);
-    if (session->fault == true) {
-        PR_ERR("session is error");
-        tal_mutex_unlock(s_lan_mgr->mutex);
-        return OPRT_SVC_LAN_SOCKET_FAULT;
-    }
-    tal_mutex_unlock(s_lan_mgr->mutex);
-
-    uint8_t *send_buf = NULL;
-    uint32_t send_len = 0;
 
     PR_TRACE("tcp sendbuf socket:%d fr_num:%u fr_type:%d ret:%d len:%d", session->fd, fr_num, fr_type, ret_code, len);
 
@@ -464,54 +532,68 @@ static int lan_send(lan_session_t *session, uint32_t fr_num, uint32_t fr_type, u
         //! TODO:
         return OPRT_COM_ERROR;
     }
-    int plaintext_len = sizeof(lpv35_plaintext_data_t) + len;
-    lpv35_plaintext_data_t *plaintext_data = tal_malloc(plaintext_len);
-    if (plaintext_data == NULL) {
-        PR_ERR("plaintext_data fail");
-        return OPRT_MALLOC_FAILED;
-    }
-    memset(plaintext_data, 0, plaintext_len);
-    plaintext_data->ret_code = ret_code;
-    memcpy(plaintext_data->data, data, len);
     // lpv3.5 test arch
-    lpv35_frame_object_t frame = {.sequence = session->sequence_out++,
-                                  .type = fr_type,
-                                  .data = (void *)plaintext_data,
-                                  .data_len = plaintext_len};
-    send_buf = tal_malloc(lpv35_frame_buffer_size_get(&frame));
-    if (send_buf == NULL) {
-        PR_ERR("send_buf malloc fail");
-        tal_free(plaintext_data);
-        return OPRT_MALLOC_FAILED;
+    lpv35_frame_object_t frame = {.type = fr_type, .data_len = sizeof(lpv35_plaintext_data_t) + len};
+    uint32_t frame_len = lpv35_frame_buffer_size_get(&frame);
+    if (frame_len > LAN_SESSION_TX_BUF_SIZE) {
+        PR_ERR("frame len %d is out of limit", frame_len);
+        return OPRT_EXCEED_UPPER_LIMIT;
     }
-    memset(send_buf, 0, lpv35_frame_buffer_size_get(&frame));
-    op_ret = lpv35_frame_serialize(key, 16, &frame, send_buf, (int *)&send_len);
-    tal_free(plaintext_data);
+
+    tal_mutex_lock(s_lan_mgr->mutex);
+    if (session->fault == true) {
+        PR_ERR("session is error");
+        tal_mutex_unlock(s_lan_mgr->mutex);
+        return OPRT_SVC_LAN_SOCKET_FAULT;
+    }
+    if (NULL == session->tx_buf) {
+        session->tx_buf = tal_malloc(LAN_SESSION_TX_BUF_SIZE);
+        if (NULL == session->tx_buf) {
+            PR_ERR("tx_buf malloc fail");
+            tal_mutex_unlock(s_lan_mgr->mutex);
+            return OPRT_MALLOC_FAILED;
+        }
+    }
+
+    // the app does not read fast enough, let the caller decide instead of waiting here
+    uint32_t pos = 0;
+    uint8_t *send_buf = lan_tx_reserve(session, frame_len, &pos);
+    if (NULL == send_buf) {
+        PR_WARN("fd:%d tx queue full, drop fr_type:%d len:%d", session->fd, fr_type, frame_len);
+        tal_mutex_unlock(s_lan_mgr->mutex);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+
+    // the plaintext goes where the ciphertext will be, the frame is encrypted in place
+    uint8_t *plaintext =
+        send_buf + LPV35_FRAME_HEAD_SIZE + sizeof(lpv35_additional_data_t) + LPV35_FRAME_NONCE_SIZE;
+    memcpy(plaintext, &ret_code, sizeof(uint32_t));
+    if (len) {
+        memcpy(plaintext + sizeof(lpv35_plaintext_data_t), data, len);
+    }
+    frame.sequence = session->sequence_out++;
+    frame.data = plaintext;
+
+    int send_len = 0;
+    op_ret = lpv35_frame_serialize(key, 16, &frame, send_buf, &send_len);
     if (op_ret != OPRT_OK) {
         PR_ERR("lpv35_frame_serialize fail:%d", op_ret);
-        tal_free(send_buf);
+        tal_mutex_unlock(s_lan_mgr->mutex);
         return OPRT_COM_ERROR;
     }
-    tal_mutex_lock(s_lan_mgr->mutex);
-    int ret = tal_net_send(session->fd, send_buf, send_len);
-    if (ret <= 0 || ret != send_len) {
-        if ((tal_net_get_errno() == UNW_EINTR) || (tal_net_get_errno() == UNW_EAGAIN)) {
-            tal_system_sleep(100);
-            ret = tal_net_send(session->fd, send_buf, send_len);
-            if (ret <= 0 || ret != send_len) {
-                op_ret = OPRT_SVC_LAN_SEND_ERR;
-            }
-        } else {
-            op_ret = OPRT_SVC_LAN_SEND_ERR;
-        }
-    }
+    lan_tx_commit(session, pos, send_len);
 
-    tal_free(send_buf);
+    // whatever the socket does not take now is sent when the sock loop finds it writable
+    op_ret = lan_tx_flush(session);
     if (op_ret == OPRT_SVC_LAN_SEND_ERR) {
         lan_session_fault_set(session);
-        PR_ERR("ret:%d send_len:%d errno:%d", ret, send_len, tal_net_get_errno());
     }
+    BOOL_T pending = lan_tx_pending(session);
     tal_mutex_unlock(s_lan_mgr->mutex);
+
+    if (pending) {
+        tuya_sock_loop_wakeup();
+    }
     return op_ret;
 }
 
@@ -634,7 +716,8 @@ static void lan_make_udp_packets(uint8_t **out, int *p_olen)
  * reported.
  * @return Returns an integer value indicating the success or failure of the
  * operation. A return value of 0 indicates success, while a non-zero value
- * indicates failure.
+ * indicates failure. OPRT_EXCEED_UPPER_LIMIT means the send queue of every
+ * session was full and the report was dropped.
  */
 int tuya_lan_dp_report(char *dpstr)
 {
@@ -660,17 +743,26 @@ int tuya_lan_dp_report(char *dpstr)
 
     lan_session_t *session = lan_sessions_get();
     int i = 0;
+    int sent = 0, full = 0;
 
     for (i = 0; i < lan->cfg->client_num; i++) {
         if (session[i].active && session[i].fault == false && session[i].secret_key[0] != '\0') {
             op_ret = lan_send(&session[i], 0, FRM_TP_STAT_REPORT, 0, out, out_len, false);
-            if (OPRT_OK != op_ret) {
+            if (OPRT_OK == op_ret) {
+                sent++;
+            } else if (OPRT_EXCEED_UPPER_LIMIT == op_ret) {
+                full++;
+            } else {
                 PR_ERR("tcp_send op_ret:%d", op_ret);
             }
         }
     }
     tal_free(out);
 
+    if (0 == sent && full) {
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+
     return OPRT_OK;
 }
 
@@ -845,6 +937,38 @@ static void lan_tcp_client_sock_err(int fd)
     return;
 }
 
+static BOOL_T lan_tcp_client_sock_want_write(int fd)
+{
+    BOOL_T pending = FALSE;
+
+    lan_mgr_t *lan = lan_mgr_get();
+    lan_session_t *session = lan_session_get_by_fd(fd);
+    if (NULL == lan || NULL == session) {
+        return FALSE;
+    }
+
+    tal_mutex_lock(lan->mutex);
+    pending = session->active && !session->fault && lan_tx_pending(session);
+    tal_mutex_unlock(lan->mutex);
+
+    return pending;
+}
+
+static void lan_tcp_client_sock_write(int fd)
+{
+    lan_mgr_t *lan = lan_mgr_get();
+    lan_session_t *session = lan_session_get_by_fd(fd);
+    if (NULL == lan || NULL == session) {
+        return;
+    }
+
+    tal_mutex_lock(lan->mutex);
+    if (session->active && !session->fault && OPRT_OK != lan_tx_flush(session)) {
+        lan_session_fault_set(session);
+    }
+    tal_mutex_unlock(lan->mutex);
+}
+
 static void lan_tcp_client_sock_read(int32_t fd)
 {
     int ret = 0;
@@ -1031,7 +1155,9 @@ static void lan_tcp_serv_sock_read(int32_t fd)
                               .pre_select = NULL,
                               .read = lan_tcp_client_sock_read,
                               .err = lan_tcp_client_sock_err,
-                              .quit = NULL};
+                              .quit = NULL,
+                              .want_write = lan_tcp_client_sock_want_write,
+                              .write = lan_tcp_client_sock_write};
 
     ret = tuya_reg_lan_sock(sock_info);
     if (OPRT_OK != ret) {
@@ -1340,13 +1466,14 @@ int tuya_lan_exit(void)
  * @param[in] data refer to LAN_PRO_HEAD_APP_S
  * @param[in] len refer to LAN_PRO_HEAD_APP_S
  *
- * @return OPRT_OK on success. Others on error, please refer to
- * tuya_error_code.h
+ * @return OPRT_OK on success, OPRT_EXCEED_UPPER_LIMIT when the send queue of
+ * every session was full. Others on error, please refer to tuya_error_code.h
  */
 int tuya_lan_data_report(uint32_t fr_type, uint32_t ret_code, uint8_t *data, uint32_t len)
 {
     int op_ret = OPRT_OK;
     int i = 0;
+    int sent = 0, full = 0;
 
     lan_mgr_t *lan = lan_mgr_get();
     if (NULL == lan) {
@@ -1364,12 +1491,20 @@ int tuya_lan_data_report(uint32_t fr_type, uint32_t ret_code, uint8_t *data, uin
     for (i = 0; i < lan->cfg->client_num; i++) {
         if (session[i].active && session[i].fault == false) {
             op_ret = lan_send(&session[i], 0, fr_type, ret_code, data, len, true);
-            if (OPRT_OK != op_ret) {
+            if (OPRT_OK == op_ret) {
+                sent++;
+            } else if (OPRT_EXCEED_UPPER_LIMIT == op_ret) {
+                full++;
+            } else {
                 PR_ERR("tcp_send op_ret:%d", op_ret);
             }
         }
     }
 
+    if (0 == sent && full) {
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+
     return OPRT_OK;
 }
 
@@ -103,8 +103,8 @@ int tuya_lan_enable(void);
  * @param[in] data refer to LAN_PRO_HEAD_APP_S
  * @param[in] len refer to LAN_PRO_HEAD_APP_S
  *
- * @return OPRT_OK on success. Others on error, please refer to
- * tuya_error_code.h
+ * @return OPRT_OK on success, OPRT_EXCEED_UPPER_LIMIT when the send queue of
+ * every session was full. Others on error, please refer to tuya_error_code.h
  */
 int tuya_lan_data_report(uint32_t fr_type, uint32_t ret_code, uint8_t *data, uint32_t len);
 
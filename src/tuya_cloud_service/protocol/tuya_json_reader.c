@@ -0,0 +1,499 @@
+/**
+ * @file tuya_json_reader.c
+ * @brief Implementation of the pull JSON reader.
+ *
+ * The reader keeps only a cursor into the buffer. Values are located by a
+ * single forward scan, strings are unescaped over their own text, which is
+ * never shorter than the result, and numbers take a plain integer fast path
+ * before falling back to strtod() for fractions and exponents. The text comes
+ * from the network, so skipped values are checked for commas, colons and
+ * matching brackets as strictly as cJSON does.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+
+#include "tuya_json_reader.h"
+#include "tuya_error_code.h"
+
+/* nesting a skipped value may have, one bit per level tells an object from an array */
+#define JSON_READER_DEPTH_MAX 32
+
+static void json_skip_ws(tuya_json_reader_t *reader)
+{
+    while (reader->cur < reader->end &&
+           (' ' == *reader->cur || '\t' == *reader->cur || '\r' == *reader->cur || '\n' == *reader->cur)) {
+        reader->cur++;
+    }
+}
+
+static bool json_literal(tuya_json_reader_t *reader, const char *literal, size_t len)
+{
+    if ((size_t)(reader->end - reader->cur) < len || 0 != memcmp(reader->cur, literal, len)) {
+        return false;
+    }
+    reader->cur += len;
+    return true;
+}
+
+/* moves the cursor past the closing quote of the string at the cursor */
+static int json_string_end(tuya_json_reader_t *reader)
+{
+    char *p = reader->cur + 1;
+
+    while (p < reader->end && '"' != *p) {
+        if ('\\' == *p) {
+            p++;
+        }
+        p++;
+    }
+    if (p >= reader->end) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+    reader->cur = p + 1;
+    return OPRT_OK;
+}
+
+static int json_hex4(const char *p, uint32_t *code)
+{
+    uint32_t value = 0;
+
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return OPRT_CJSON_PARSE_ERR;
+        }
+    }
+    *code = value;
+    return OPRT_OK;
+}
+
+static char *json_utf8_put(char *out, uint32_t code)
+{
+    if (code < 0x80) {
+        *out++ = (char)code;
+    } else if (code < 0x800) {
+        *out++ = (char)(0xC0 | (code >> 6));
+        *out++ = (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        *out++ = (char)(0xE0 | (code >> 12));
+        *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (code & 0x3F));
+    } else {
+        *out++ = (char)(0xF0 | (code >> 18));
+        *out++ = (char)(0x80 | ((code >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (code & 0x3F));
+    }
+    return out;
+}
+
+/**
+ * @brief Initializes a reader on a JSON buffer.
+ *
+ * @param reader The reader.
+ * @param json The JSON text, json[len] must be '\0'.
+ * @param len The length of the JSON text.
+ */
+void tuya_json_reader_init(tuya_json_reader_t *reader, char *json, size_t len)
+{
+    reader->cur = json;
+    reader->end = json + len;
+}
+
+/**
+ * @brief Returns the type of the next value without consuming it.
+ *
+ * @param reader The reader.
+ * @return The type, TUYA_JSON_INVALID at the end of the buffer or on a
+ * character that cannot start a value.
+ */
+tuya_json_type_t tuya_json_reader_peek(tuya_json_reader_t *reader)
+{
+    json_skip_ws(reader);
+    if (reader->cur >= reader->end) {
+        return TUYA_JSON_INVALID;
+    }
+
+    switch (*reader->cur) {
+    case '{':
+        return TUYA_JSON_OBJECT;
+    case '[':
+        return TUYA_JSON_ARRAY;
+    case '"':
+        return TUYA_JSON_STRING;
+    case 't':
+        return TUYA_JSON_TRUE;
+    case 'f':
+        return TUYA_JSON_FALSE;
+    case 'n':
+        return TUYA_JSON_NULL;
+    default:
+        if ('-' == *reader->cur || (*reader->cur >= '0' && *reader->cur <= '9')) {
+            return TUYA_JSON_NUMBER;
+        }
+        return TUYA_JSON_INVALID;
+    }
+}
+
+/**
+ * @brief Consumes the '{' of the next value.
+ *
+ * @param reader The reader.
+ * @return OPRT_OK on success, OPRT_CJSON_PARSE_ERR if the value is not an
+ * object.
+ */
+int tuya_json_reader_object_enter(tuya_json_reader_t *reader)
+{
+    if (TUYA_JSON_OBJECT != tuya_json_reader_peek(reader)) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+    reader->cur++;
+    return OPRT_OK;
+}
+
+/**
+ * @brief Reads the key of the next member of the current object and leaves
+ * the reader on its value, which must be read or skipped before the next call.
+ *
+ * @param reader The reader.
+ * @param key The key in the buffer.
+ * @param key_len The length of the key.
+ * @return 1 when a member is read, 0 when the closing '}' is consumed,
+ * OPRT_CJSON_PARSE_ERR on malformed input.
+ */
+int tuya_json_reader_object_next(tuya_json_reader_t *reader, const char **key, size_t *key_len)
+{
+    char *start = NULL;
+    char *prev = reader->cur;
+
+    // the object was just entered when the text before the cursor is '{', else a value was read
+    while (' ' == prev[-1] || '\t' == prev[-1] || '\r' == prev[-1] || '\n' == prev[-1]) {
+        prev--;
+    }
+
+    json_skip_ws(reader);
+    if (reader->cur >= reader->end) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+    if ('}' == *reader->cur) {
+        reader->cur++;
+        return 0;
+    }
+    if ('{' != prev[-1]) {
+        // members after the first one are separated by exactly one comma
+        if (',' != *reader->cur) {
+            return OPRT_CJSON_PARSE_ERR;
+        }
+        reader->cur++;
+        json_skip_ws(reader);
+    }
+    if (reader->cur >= reader->end || '"' != *reader->cur) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+
+    start = reader->cur + 1;
+    if (OPRT_OK != json_string_end(reader)) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+    *key = start;
+    *key_len = reader->cur - 1 - start;
+
+    json_skip_ws(reader);
+    if (reader->cur >= reader->end || ':' != *reader->cur) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+    reader->cur++;
+    return 1;
+}
+
+/**
+ * @brief Reads a string value, unescaped and '\0' terminated in the buffer.
+ *
+ * @param reader The reader.
+ * @param str The string in the buffer.
+ * @param len The length of the string, may be NULL.
+ * @return OPRT_OK on success, OPRT_CJSON_PARSE_ERR on malformed input or if the
+ * value is not a string.
+ */
+int tuya_json_reader_string(tuya_json_reader_t *reader, char **str, size_t *len)
+{
+    char *in = NULL, *out = NULL;
+    uint32_t code = 0, low = 0;
+
+    if (TUYA_JSON_STRING != tuya_json_reader_peek(reader)) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+
+    in = out = reader->cur + 1;
+    while (in < reader->end && '"' != *in) {
+        if ('\\' != *in) {
+            *out++ = *in++;
+            continue;
+        }
+        if (in + 1 >= reader->end) {
+            return OPRT_CJSON_PARSE_ERR;
+        }
+        switch (in[1]) {
+        case '"':
+        case '\\':
+        case '/':
+            *out++ = in[1];
+            break;
+        case 'b':
+            *out++ = '\b';
+            break;
+        case 'f':
+            *out++ = '\f';
+            break;
+        case 'n':
+            *out++ = '\n';
+            break;
+        case 'r':
+            *out++ = '\r';
+            break;
+        case 't':
+            *out++ = '\t';
+            break;
+        case 'u':
+            if (reader->end - in < 6 || OPRT_OK != json_hex4(in + 2, &code)) {
+                return OPRT_CJSON_PARSE_ERR;
+            }
+            // a surrogate pair takes the next \uXXXX as well
+            if (code >= 0xD800 && code <= 0xDBFF) {
+                if (reader->end - in < 12 || '\\' != in[6] || 'u' != in[7] || OPRT_OK != json_hex4(in + 8, &low) ||
+                    low < 0xDC00 || low > 0xDFFF) {
+                    return OPRT_CJSON_PARSE_ERR;
+                }
+                code = 0x10000 + (((code & 0x3FF) << 10) | (low & 0x3FF));
+                in += 6;
+            }
+            out = json_utf8_put(out, code);
+            in += 4;
+            break;
+        default:
+            return OPRT_CJSON_PARSE_ERR;
+        }
+        in += 2;
+    }
+    if (in >= reader->end) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+
+    *out = '\0';
+    *str = reader->cur + 1;
+    if (len) {
+        *len = out - *str;
+    }
+    reader->cur = in + 1;
+    return OPRT_OK;
+}
+
+/**
+ * @brief Reads a number value as an int, fractions are truncated and values
+ * out of range saturate, the same as cJSON valueint.
+ *
+ * @param reader The reader.
+ * @param value The value.
+ * @return OPRT_OK on success, OPRT_CJSON_PARSE_ERR if the value is not a
+ * number.
+ */
+int tuya_json_reader_int(tuya_json_reader_t *reader, int *value)
+{
+    char *p = NULL;
+    bool negative = false;
+    int64_t number = 0;
+    double real = 0;
+
+    if (TUYA_JSON_NUMBER != tuya_json_reader_peek(reader)) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+
+    p = reader->cur;
+    if ('-' == *p) {
+        negative = true;
+        p++;
+    }
+    if (p >= reader->end || *p < '0' || *p > '9') {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+    while (p < reader->end && *p >= '0' && *p <= '9') {
+        if (number <= INT_MAX) {
+            number = number * 10 + (*p - '0');
+        }
+        p++;
+    }
+
+    if (p < reader->end && ('.' == *p || 'e' == *p || 'E' == *p)) {
+        real = strtod(reader->cur, &p);
+        if (p > reader->end) {
+            return OPRT_CJSON_PARSE_ERR;
+        }
+        if (real >= INT_MAX) {
+            *value = INT_MAX;
+        } else if (real <= (double)INT_MIN) {
+            *value = INT_MIN;
+        } else {
+            *value = (int)real;
+        }
+    } else {
+        number = negative ? -number : number;
+        if (number >= INT_MAX) {
+            *value = INT_MAX;
+        } else if (number <= INT_MIN) {
+            *value = INT_MIN;
+        } else {
+            *value = (int)number;
+        }
+    }
+
+    reader->cur = p;
+    return OPRT_OK;
+}
+
+/**
+ * @brief Reads a true or false value.
+ *
+ * @param reader The reader.
+ * @param value The value.
+ * @return OPRT_OK on success, OPRT_CJSON_PARSE_ERR if the value is not a
+ * boolean.
+ */
+int tuya_json_reader_bool(tuya_json_reader_t *reader, bool *value)
+{
+    json_skip_ws(reader);
+    if (json_literal(reader, "true", 4)) {
+        *value = true;
+        return OPRT_OK;
+    }
+    if (json_literal(reader, "false", 5)) {
+        *value = false;
+        return OPRT_OK;
+    }
+    return OPRT_CJSON_PARSE_ERR;
+}
+
+/**
+ * @brief Skips the next value and returns its text.
+ *
+ * @param reader The reader.
+ * @param value The value text in the buffer, may be NULL.
+ * @param len The length of the value text, may be NULL.
+ * @return OPRT_OK on success, OPRT_CJSON_PARSE_ERR on malformed input.
+ */
+int tuya_json_reader_skip(tuya_json_reader_t *reader, char **value, size_t *len)
+{
+    char *start = NULL;
+    uint32_t objects = 0; // bit n is set when level n is an object
+    int depth = 0;
+    int dummy = 0;
+
+    json_skip_ws(reader);
+    start = reader->cur;
+    do {
+        switch (tuya_json_reader_peek(reader)) {
+        case TUYA_JSON_OBJECT:
+        case TUYA_JSON_ARRAY:
+            if (depth >= JSON_READER_DEPTH_MAX) {
+                return OPRT_CJSON_PARSE_ERR;
+            }
+            if ('{' == *reader->cur) {
+                objects |= (1U << depth);
+            } else {
+                objects &= ~(1U << depth);
+            }
+            depth++;
+            reader->cur++;
+            json_skip_ws(reader);
+            if (reader->cur < reader->end && ((objects >> (depth - 1)) & 1 ? '}' : ']') == *reader->cur) {
+                // empty object or array
+                reader->cur++;
+                depth--;
+                break;
+            }
+            if ((objects >> (depth - 1)) & 1) {
+                if (reader->cur >= reader->end || '"' != *reader->cur || OPRT_OK != json_string_end(reader)) {
+                    return OPRT_CJSON_PARSE_ERR;
+                }
+                json_skip_ws(reader);
+                if (reader->cur >= reader->end || ':' != *reader->cur) {
+                    return OPRT_CJSON_PARSE_ERR;
+                }
+                reader->cur++;
+            }
+            // the first member is read by the next round
+            continue;
+
+        case TUYA_JSON_STRING:
+            if (OPRT_OK != json_string_end(reader)) {
+                return OPRT_CJSON_PARSE_ERR;
+            }
+            break;
+
+        case TUYA_JSON_NUMBER:
+            if (OPRT_OK != tuya_json_reader_int(reader, &dummy)) {
+                return OPRT_CJSON_PARSE_ERR;
+            }
+            break;
+
+        case TUYA_JSON_TRUE:
+        case TUYA_JSON_FALSE:
+        case TUYA_JSON_NULL:
+            if (!json_literal(reader, "true", 4) && !json_literal(reader, "false", 5) &&
+                !json_literal(reader, "null", 4)) {
+                return OPRT_CJSON_PARSE_ERR;
+            }
+            break;
+
+        default:
+            return OPRT_CJSON_PARSE_ERR;
+        }
+
+        // a value is complete, close the containers it ends and find the next member
+        while (depth > 0) {
+            json_skip_ws(reader);
+            if (reader->cur >= reader->end) {
+                return OPRT_CJSON_PARSE_ERR;
+            }
+            if (((objects >> (depth - 1)) & 1 ? '}' : ']') == *reader->cur) {
+                reader->cur++;
+                depth--;
+                continue;
+            }
+            if (',' != *reader->cur) {
+                return OPRT_CJSON_PARSE_ERR;
+            }
+            reader->cur++;
+            if ((objects >> (depth - 1)) & 1) {
+                json_skip_ws(reader);
+                if (reader->cur >= reader->end || '"' != *reader->cur || OPRT_OK != json_string_end(reader)) {
+                    return OPRT_CJSON_PARSE_ERR;
+                }
+                json_skip_ws(reader);
+                if (reader->cur >= reader->end || ':' != *reader->cur) {
+                    return OPRT_CJSON_PARSE_ERR;
+                }
+                reader->cur++;
+            }
+            break;
+        }
+    } while (depth > 0);
+
+    if (value) {
+        *value = start;
+    }
+    if (len) {
+        *len = reader->cur - start;
+    }
+    return OPRT_OK;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file tuya_json_reader.h
+ * @brief Pull reader for JSON text that decodes values in place.
+ *
+ * The reader walks a '\0' terminated JSON buffer without building a tree.
+ * Object keys are returned as spans of the buffer, values are decoded by the
+ * typed read functions or skipped, and strings are unescaped in the buffer
+ * itself. It is meant for hot protocol paths that only need a few members of
+ * a message, everything else keeps using cJSON.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#ifndef __TUYA_JSON_READER_H__
+#define __TUYA_JSON_READER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tuya_cloud_types.h"
+
+/**
+ * @brief type of the next value of the reader
+ */
+typedef uint8_t tuya_json_type_t;
+#define TUYA_JSON_INVALID 0
+#define TUYA_JSON_OBJECT  1
+#define TUYA_JSON_ARRAY   2
+#define TUYA_JSON_STRING  3
+#define TUYA_JSON_NUMBER  4
+#define TUYA_JSON_TRUE    5
+#define TUYA_JSON_FALSE   6
+#define TUYA_JSON_NULL    7
+
+typedef struct {
+    char *cur;
+    char *end;
+} tuya_json_reader_t;
+
+/**
+ * @brief Initializes a reader on a JSON buffer.
+ *
+ * @param reader The reader.
+ * @param json The JSON text, json[len] must be '\0'.
+ * @param len The length of the JSON text.
+ */
+void tuya_json_reader_init(tuya_json_reader_t *reader, char *json, size_t len);
+
+/**
+ * @brief Returns the type of the next value without consuming it.
+ *
+ * @param reader The reader.
+ * @return The type, TUYA_JSON_INVALID at the end of the buffer or on a
+ * character that cannot start a value.
+ */
+tuya_json_type_t tuya_json_reader_peek(tuya_json_reader_t *reader);
+
+/**
+ * @brief Consumes the '{' of the next value.
+ *
+ * @param reader The reader.
+ * @return OPRT_OK on success, OPRT_CJSON_PARSE_ERR if the value is not an
+ * object.
+ */
+int tuya_json_reader_object_enter(tuya_json_reader_t *reader);
+
+/**
+ * @brief Reads the key of the next member of the current object and leaves
+ * the reader on its value, which must be read or skipped before the next call.
+ *
+ * The key is not unescaped and not '\0' terminated.
+ *
+ * @param reader The reader.
+ * @param key The key in the buffer.
+ * @param key_len The length of the key.
+ * @return 1 when a member is read, 0 when the closing '}' is consumed,
+ * OPRT_CJSON_PARSE_ERR on malformed input.
+ */
+int tuya_json_reader_object_next(tuya_json_reader_t *reader, const char **key, size_t *key_len);
+
+/**
+ * @brief Reads a string value, unescaped and '\0' terminated in the buffer.
+ *
+ * @param reader The reader.
+ * @param str The string in the buffer.
+ * @param len The length of the string, may be NULL.
+ * @return OPRT_OK on success, OPRT_CJSON_PARSE_ERR on malformed input or if the
+ * value is not a string.
+ */
+int tuya_json_reader_string(tuya_json_reader_t *reader, char **str, size_t *len);
+
+/**
+ * @brief Reads a number value as an int, fractions are truncated and values
+ * out of range saturate, the same as cJSON valueint.
+ *
+ * @param reader The reader.
+ * @param value The value.
+ * @return OPRT_OK on success, OPRT_CJSON_PARSE_ERR if the value is not a
+ * number.
+ */
+int tuya_json_reader_int(tuya_json_reader_t *reader, int *value);
+
+/**
+ * @brief Reads a true or false value.
+ *
+ * @param reader The reader.
+ * @param value The value.
+ * @return OPRT_OK on success, OPRT_CJSON_PARSE_ERR if the value is not a
+ * boolean.
+ */
+int tuya_json_reader_bool(tuya_json_reader_t *reader, bool *value);
+
+/**
+ * @brief Skips the next value and returns its text.
+ *
+ * Nested objects and arrays are checked for commas, colons and matching
+ * brackets, up to 32 levels deep.
+ *
+ * @param reader The reader.
+ * @param value The value text in the buffer, may be NULL.
+ * @param len The length of the value text, may be NULL.
+ * @return OPRT_OK on success, OPRT_CJSON_PARSE_ERR on malformed input.
+ */
+int tuya_json_reader_skip(tuya_json_reader_t *reader, char **value, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TUYA_JSON_READER_H__ */
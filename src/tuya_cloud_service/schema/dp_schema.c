@@ -18,6 +18,7 @@
 #include "cJSON.h"
 #include "mix_method.h"
 #include "tal_api.h"
+#include "tuya_json_reader.h"
 
 #define MAX_ITEM_LEN 1024
 
@@ -35,6 +36,20 @@ typedef struct {
 
 static dp_schema_mgr_t s_dsmgr = {0};
 
+#if (DP_RECV_POOL_NUM > 32)
+#error "DP_RECV_POOL_NUM must not exceed 32"
+#endif
+
+#if (DP_RECV_POOL_NUM > 0)
+typedef struct {
+    /** bit n set when block n is in use, guarded by s_dsmgr.mutex */
+    uint32_t used;
+    uint64_t block[DP_RECV_POOL_NUM][(DP_RECV_POOL_SIZE + 7) / 8];
+} dp_recv_pool_t;
+
+static dp_recv_pool_t s_recv_pool;
+#endif
+
 /**
  * @brief Appends a JSON string to the given data with the specified time, type,
  * and repetition sequence.
@@ -118,16 +133,11 @@ __err_exit:
  */
 dp_node_t *dp_node_find(dp_schema_t *schema, int id)
 {
-    int i;
-    dp_node_t *dpnode = NULL;
-
-    for (i = 0; i < schema->num; i++) {
-        if (schema->node[i].desc.id == id) {
-            dpnode = &schema->node[i];
-            break;
-        }
+    if (id < 0 || id >= DP_ID_INDEX_NUM || 0 == schema->index[id]) {
+        return NULL;
     }
-    return dpnode;
+
+    return &schema->node[schema->index[id] - 1];
 }
 
 /**
@@ -168,20 +178,12 @@ dp_schema_t *dp_schema_find(const char *devid)
  */
 dp_node_t *dp_node_find_by_devid(char *devid, int id)
 {
-    int i;
-    dp_node_t *dpnode = NULL;
-
     dp_schema_t *schema = dp_schema_find(devid);
     if (NULL == schema) {
         return NULL;
     }
-    for (i = 0; i < schema->num; i++) {
-        if (schema->node[i].desc.id == id) {
-            dpnode = &schema->node[i];
-            break;
-        }
-    }
-    return dpnode;
+
+    return dp_node_find(schema, id);
 }
 
 static __attribute__((unused)) OPERATE_RET dp_obj_equal_resp(dp_schema_t *schema, uint8_t *dpid, uint8_t num,
@@ -454,6 +456,8 @@ int dp_data_recv_parse(dp_recv_msg_t *msg, dp_recv_cb_t dp_recv_cb)
     tal_mutex_unlock(schema->mutex);
 
     if (dpobj) {
+        // dps with an invalid value are left out
+        dpobj->dpscnt = i;
         if (dp_recv_cb) {
             // tal_mutex_unlock(schema->mutex);
             dp_recv_cb(T_OBJ, dpobj, msg->user_data);
@@ -471,6 +475,295 @@ __err_exit:
     return op_ret;
 }
 
+/**
+ * Allocates a buffer for a received dp command.
+ *
+ * @param size The buffer size.
+ * @return The buffer, or NULL on failure.
+ */
+void *dp_recv_buf_malloc(size_t size)
+{
+#if (DP_RECV_POOL_NUM > 0)
+    if (size <= DP_RECV_POOL_SIZE && s_dsmgr.mutex) {
+        tal_mutex_lock(s_dsmgr.mutex);
+        for (int i = 0; i < DP_RECV_POOL_NUM; i++) {
+            if (0 == (s_recv_pool.used & (1UL << i))) {
+                s_recv_pool.used |= (1UL << i);
+                tal_mutex_unlock(s_dsmgr.mutex);
+                return s_recv_pool.block[i];
+            }
+        }
+        tal_mutex_unlock(s_dsmgr.mutex);
+    }
+#endif
+
+    return tal_malloc(size);
+}
+
+/**
+ * Frees a buffer of dp_recv_buf_malloc().
+ *
+ * @param ptr The buffer.
+ */
+void dp_recv_buf_free(void *ptr)
+{
+    if (NULL == ptr) {
+        return;
+    }
+
+#if (DP_RECV_POOL_NUM > 0)
+    if ((uint8_t *)ptr >= (uint8_t *)s_recv_pool.block &&
+        (uint8_t *)ptr < (uint8_t *)s_recv_pool.block + sizeof(s_recv_pool.block)) {
+        int i = ((uint8_t *)ptr - (uint8_t *)s_recv_pool.block) / sizeof(s_recv_pool.block[0]);
+        tal_mutex_lock(s_dsmgr.mutex);
+        s_recv_pool.used &= ~(1UL << i);
+        tal_mutex_unlock(s_dsmgr.mutex);
+        return;
+    }
+#endif
+
+    tal_free(ptr);
+}
+
+/* dp id of a "dps" key, the same as atoi() of the key */
+static int dp_key_id(const char *key, size_t len)
+{
+    int id = 0;
+
+    for (size_t i = 0; i < len && key[i] >= '0' && key[i] <= '9' && id < DP_ID_INDEX_NUM; i++) {
+        id = id * 10 + (key[i] - '0');
+    }
+
+    return id;
+}
+
+/* decodes one dps member into dpobj->dps[i], FALSE when it is skipped */
+static BOOL_T dp_value_read(tuya_json_reader_t *reader, dp_node_t *dpnode, dp_obj_t *dp)
+{
+    tuya_json_type_t type = tuya_json_reader_peek(reader);
+    bool value_bool = FALSE;
+    int value_int = 0;
+    char *value_str = NULL;
+
+    switch (dpnode->desc.prop_tp) {
+    case PROP_BOOL: {
+        if (TUYA_JSON_TRUE != type && TUYA_JSON_FALSE != type) {
+            break;
+        }
+        tuya_json_reader_bool(reader, &value_bool);
+        dp->value.dp_bool = value_bool;
+        return TRUE;
+    }
+
+    case PROP_VALUE: {
+        if (TUYA_JSON_NUMBER != type || OPRT_OK != tuya_json_reader_int(reader, &value_int)) {
+            break;
+        }
+        dp->value.dp_value = value_int;
+        return TRUE;
+    }
+
+    case PROP_STR: {
+        if (TUYA_JSON_STRING != type || OPRT_OK != tuya_json_reader_string(reader, &value_str, NULL)) {
+            break;
+        }
+        dp->value.dp_str = value_str;
+        return TRUE;
+    }
+
+    case PROP_ENUM: {
+        // like dp_data_recv_parse(), a value that is not a string is taken as the first enum
+        if (TUYA_JSON_STRING != type) {
+            tuya_json_reader_skip(reader, NULL, NULL);
+            return TRUE;
+        }
+        if (OPRT_OK != tuya_json_reader_string(reader, &value_str, NULL)) {
+            return FALSE;
+        }
+        int j = 0;
+        for (j = 0; j < dpnode->prop.prop_enum.cnt; j++) {
+            if (0 == strcmp(dpnode->prop.prop_enum.pp_enum[j], value_str)) {
+                break;
+            }
+        }
+        if (j >= dpnode->prop.prop_enum.cnt) {
+            PR_ERR("dp enum value[%s] invalid", value_str);
+            return FALSE;
+        }
+        dp->value.dp_enum = j;
+        return TRUE;
+    }
+
+    case PROP_BITMAP: {
+        // cJSON valueint is 0 for anything but a number
+        if (TUYA_JSON_NUMBER != type || OPRT_OK != tuya_json_reader_int(reader, &value_int)) {
+            tuya_json_reader_skip(reader, NULL, NULL);
+        }
+        dp->value.dp_value = value_int;
+        return TRUE;
+    }
+
+    default: {
+        PR_ERR("dp prop_tp[%d] invalude", dpnode->desc.prop_tp);
+        break;
+    }
+    } /* end of switch */
+
+    tuya_json_reader_skip(reader, NULL, NULL);
+    return FALSE;
+}
+
+/**
+ * Parses the received data from its text and invokes the callback function.
+ *
+ * @param msg The pointer to the received message.
+ * @param dp_recv_cb The callback function to be invoked.
+ * @return The result of the parsing operation.
+ */
+int dp_data_recv_parse_str(dp_recv_msg_t *msg, dp_recv_cb_t dp_recv_cb)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+    tuya_json_reader_t reader;
+    const char *key = NULL;
+    size_t key_len = 0;
+    char *dps_str = NULL, *value_str = NULL;
+    size_t dps_len = 0, value_len = 0;
+    uint16_t dpscnt = 0;
+    dp_obj_recv_t *dpobj = NULL;
+    dp_node_t *dpnode = NULL;
+    dp_schema_t *schema = NULL;
+    int ret = 0, i = 0;
+
+    if (NULL == msg->data_str) {
+        return OPRT_INVALID_PARM;
+    }
+
+    // the data object, only "devId" and "dps" are of interest
+    tuya_json_reader_init(&reader, msg->data_str, msg->data_len);
+    if (OPRT_OK != tuya_json_reader_object_enter(&reader)) {
+        return OPRT_CJSON_PARSE_ERR;
+    }
+    while (1 == (ret = tuya_json_reader_object_next(&reader, &key, &key_len))) {
+        if (5 == key_len && 0 == memcmp(key, "devId", 5) && TUYA_JSON_STRING == tuya_json_reader_peek(&reader)) {
+            ret = tuya_json_reader_string(&reader, &msg->devid, NULL);
+        } else if (3 == key_len && 0 == memcmp(key, "dps", 3) && TUYA_JSON_OBJECT == tuya_json_reader_peek(&reader)) {
+            ret = tuya_json_reader_skip(&reader, &dps_str, &dps_len);
+        } else {
+            ret = tuya_json_reader_skip(&reader, NULL, NULL);
+        }
+        if (OPRT_OK != ret) {
+            break;
+        }
+    }
+    if (ret < 0) {
+        PR_ERR("dp data parse err");
+        return OPRT_CJSON_PARSE_ERR;
+    }
+
+    schema = dp_schema_find(msg->devid);
+    if (NULL == schema || NULL == dps_str) {
+        PR_ERR("dev null or no dps");
+        return OPRT_COM_ERROR;
+    }
+
+    tal_mutex_lock(schema->mutex);
+    tuya_json_reader_init(&reader, dps_str, dps_len);
+    tuya_json_reader_object_enter(&reader);
+    while (1 == tuya_json_reader_object_next(&reader, &key, &key_len)) {
+        tuya_json_reader_skip(&reader, NULL, NULL);
+        dpnode = dp_node_find(schema, dp_key_id(key, key_len));
+        if (dpnode == NULL) {
+            PR_ERR("DP ID %d Invalid", dp_key_id(key, key_len));
+            continue;
+        }
+        if ((schema->actv.preprocess == TRUE) && (dpnode->desc.passive == PSV_TRUE)) {
+            dpnode->desc.passive = PSV_F_ONCE;
+        }
+        if (T_OBJ == dpnode->desc.type) {
+            dpscnt++;
+        }
+    }
+    tal_mutex_unlock(schema->mutex);
+
+    if (dpscnt) {
+        dpobj = (dp_obj_recv_t *)dp_recv_buf_malloc(sizeof(dp_obj_recv_t) + (dpscnt * sizeof(dp_obj_t)));
+        if (NULL == dpobj) {
+            PR_ERR("malloc err:%d", dpscnt);
+            return OPRT_MALLOC_FAILED;
+        }
+        memset(dpobj, 0, (sizeof(dp_obj_recv_t) + (dpscnt * sizeof(dp_obj_t))));
+        dpobj->cmd_tp = msg->cmd;
+        dpobj->dtt_tp = (dp_trans_type_t)msg->dt_tp;
+        dpobj->devid = msg->devid;
+        dpobj->dpscnt = dpscnt;
+    }
+
+    tal_mutex_lock(schema->mutex);
+    tuya_json_reader_init(&reader, dps_str, dps_len);
+    tuya_json_reader_object_enter(&reader);
+    while (1 == tuya_json_reader_object_next(&reader, &key, &key_len)) {
+        dpnode = dp_node_find(schema, dp_key_id(key, key_len));
+        if (NULL == dpnode) {
+            tuya_json_reader_skip(&reader, NULL, NULL);
+            continue;
+        }
+        if (T_RAW == dpnode->desc.type && TUYA_JSON_STRING == tuya_json_reader_peek(&reader)) { // raw dp process
+            if (OPRT_OK != tuya_json_reader_string(&reader, &value_str, &value_len)) {
+                continue;
+            }
+            dp_raw_recv_t *dpraw = dp_recv_buf_malloc(sizeof(dp_raw_recv_t) + value_len);
+            if (NULL == dpraw) {
+                tal_mutex_unlock(schema->mutex);
+                op_ret = OPRT_MALLOC_FAILED;
+                goto __err_exit;
+            }
+            memset(dpraw, 0, sizeof(dp_raw_recv_t) + value_len);
+
+            dpraw->devid = msg->devid;
+            dpraw->cmd_tp = msg->cmd;
+            dpraw->dp.id = dpnode->desc.id;
+            dpraw->dtt_tp = msg->dt_tp;
+            dpraw->dp.len = tuya_base64_decode(value_str, dpraw->dp.data);
+
+            if (dp_recv_cb) {
+                tal_mutex_unlock(schema->mutex);
+                dp_recv_cb(T_RAW, dpraw, msg->user_data);
+                tal_mutex_lock(schema->mutex);
+            }
+            dp_recv_buf_free(dpraw);
+            continue;
+        }
+
+        dpnode->pv_stat = PV_STAT_LOCAL;
+
+        // only T_OBJ dps were counted
+        if (i >= dpscnt) {
+            tuya_json_reader_skip(&reader, NULL, NULL);
+            continue;
+        }
+        if (!dp_value_read(&reader, dpnode, &dpobj->dps[i])) {
+            continue;
+        }
+        dpobj->dps[i].id = dpnode->desc.id;
+        dpobj->dps[i].type = dpnode->desc.prop_tp;
+        dpobj->dps[i].time_stamp = tal_time_get_posix();
+        i++;
+    }
+    tal_mutex_unlock(schema->mutex);
+
+    if (dpobj) {
+        dpobj->dpscnt = i;
+    }
+    if (dpobj && dp_recv_cb) {
+        dp_recv_cb(T_OBJ, dpobj, msg->user_data);
+    }
+
+__err_exit:
+    dp_recv_buf_free(dpobj);
+
+    return op_ret;
+}
+
 /**
  * Retrieves the PV (Property Value) status for a specific data point (DP)
  * schema.
@@ -728,6 +1021,78 @@ static bool dp_type_check(dp_rept_type_t dp_rept_type, dp_obj_t *dp, dp_node_t *
     return TRUE;
 }
 
+/* length of a string as a quoted json string, escaped like cJSON does */
+static uint16_t dp_json_str_len(const char *str)
+{
+    uint16_t len = 2;
+
+    for (; *str; str++) {
+        switch (*str) {
+        case '"':
+        case '\\':
+        case '\b':
+        case '\f':
+        case '\n':
+        case '\r':
+        case '\t':
+            len += 2;
+            break;
+        default:
+            len += ((uint8_t)*str < 32) ? 6 : 1;
+            break;
+        }
+    }
+
+    return len;
+}
+
+/* writes a string as a quoted json string, returns the bytes written */
+static uint16_t dp_json_str_write(char *out, const char *str)
+{
+    char *p = out;
+
+    *p++ = '"';
+    for (; *str; str++) {
+        switch (*str) {
+        case '"':
+        case '\\':
+            *p++ = '\\';
+            *p++ = *str;
+            break;
+        case '\b':
+            *p++ = '\\';
+            *p++ = 'b';
+            break;
+        case '\f':
+            *p++ = '\\';
+            *p++ = 'f';
+            break;
+        case '\n':
+            *p++ = '\\';
+            *p++ = 'n';
+            break;
+        case '\r':
+            *p++ = '\\';
+            *p++ = 'r';
+            break;
+        case '\t':
+            *p++ = '\\';
+            *p++ = 't';
+            break;
+        default:
+            if ((uint8_t)*str < 32) {
+                p += sprintf(p, "\\u%04x", (uint8_t)*str);
+            } else {
+                *p++ = *str;
+            }
+            break;
+        }
+    }
+    *p++ = '"';
+
+    return p - out;
+}
+
 /**
  * @brief Performs a validity check on the given data point (DP) repetition.
  *
@@ -785,7 +1150,8 @@ int dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
         }
 
         case PROP_STR: {
-            dpvalid->len += 2 * strlen(dp->value.dp_str) + 15;
+            // "id": + escaped string + ,
+            dpvalid->len += dp_json_str_len(dp->value.dp_str) + 10;
         } break;
 
         case PROP_ENUM: {
@@ -836,22 +1202,24 @@ int dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
  */
 int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, dp_rept_out_t *dpout)
 {
-    uint16_t i, j;
+    uint16_t i;
     uint16_t offset = 0;
     uint16_t time_offset = 0;
     OPERATE_RET op_ret = OPRT_OK;
     char *dpstr = NULL;
     char *dptimestr = NULL;
     bool is_need_time = false;
+    uint16_t index[DP_ID_INDEX_NUM];
 
-    dpstr = (char *)tal_malloc(dpvalid->len);
+    // valid check sized every dp, plus the braces and the terminator
+    dpstr = (char *)tal_malloc(dpvalid->len + 2);
     if (NULL == dpstr) {
         PR_ERR("malloc err:%d", dpvalid->len);
         return OPRT_MALLOC_FAILED;
     }
     // STAT type DP needs to assemble a timestamp
     if ((T_STAT_REPT == dpin->rept_type) && dpvalid->timelen && dpout->timejson) {
-        dptimestr = (char *)tal_malloc(dpvalid->timelen);
+        dptimestr = (char *)tal_malloc(dpvalid->timelen + 2);
         if (NULL == dptimestr) {
             PR_ERR("malloc err:%d", dpvalid->timelen);
             op_ret = OPRT_MALLOC_FAILED;
@@ -864,20 +1232,14 @@ int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
         dptimestr[time_offset++] = '{';
     }
 
+    dp_rept_in_index(dpin, index);
     for (i = 0; i < dpvalid->num; i++) {
-        dp_obj_t *dp = NULL;
-        for (j = 0; j < dpin->dpscnt; j++) {
-            if (dpvalid->dpid[i] == dpin->dps[j].id) {
-                dp = &dpin->dps[j];
-                break;
-            }
-        }
-        if (NULL == dp) {
+        if (0 == index[dpvalid->dpid[i]]) {
             PR_DEBUG("dp not found");
             op_ret = OPRT_SVC_DP_ID_NOT_FOUND;
             goto __err_exit;
         }
-        // dp_obj_t  *dp     = &dpin->dps[dpvalid->dpid[i]];
+        dp_obj_t *dp = &dpin->dps[index[dpvalid->dpid[i]] - 1];
         dp_node_t *dpnode = dp_node_find(schema, dp->id);
         if (NULL == dpnode) {
             PR_DEBUG("dp->id = %d not found", dp->id);
@@ -911,13 +1273,9 @@ int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
         }
 
         case PROP_STR: {
-            cJSON *temp_str = cJSON_CreateString(dp->value.dp_str);
-            char *tmp_data = cJSON_PrintUnformatted(temp_str);
-            if (tmp_data) {
-                offset += sprintf(dpstr + offset, "\"%d\":%s,", dp->id, tmp_data);
-            }
-            tal_free(tmp_data);
-            cJSON_Delete(temp_str);
+            offset += sprintf(dpstr + offset, "\"%d\":", dp->id);
+            offset += dp_json_str_write(dpstr + offset, dp->value.dp_str);
+            dpstr[offset++] = ',';
             break;
         }
 
@@ -957,6 +1315,26 @@ __err_exit:
     return op_ret;
 }
 
+/**
+ * @brief Builds the index of the dps of a report by dp id.
+ *
+ * index[id] is the position of the first dp with that id in dpin->dps plus 1,
+ * or 0 if the report does not contain the id.
+ *
+ * @param dpin The input data for the DP report.
+ * @param index The index, DP_ID_INDEX_NUM entries.
+ */
+void dp_rept_in_index(dp_rept_in_t *dpin, uint16_t index[DP_ID_INDEX_NUM])
+{
+    uint16_t i;
+
+    memset(index, 0, DP_ID_INDEX_NUM * sizeof(index[0]));
+    // backwards, so the first dp of an id wins
+    for (i = dpin->dpscnt; i > 0; i--) {
+        index[dpin->dps[i - 1].id] = i;
+    }
+}
+
 // int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin,
 // dp_rept_out_t *dpout)
 // {
@@ -1546,6 +1924,10 @@ int dp_schema_create(char *devid, char *schema_json, dp_schema_t **dp_schema_out
         return OPRT_MALLOC_FAILED;
     }
     memset(dp_schema, 0, sizeof(dp_schema_t) + nodenum * sizeof(dp_node_t));
+    // guards the pool of dp_recv_buf_malloc()
+    if (NULL == s_dsmgr.mutex && OPRT_OK != tal_mutex_create_init(&s_dsmgr.mutex)) {
+        s_dsmgr.mutex = NULL;
+    }
     op_ret = tal_mutex_create_init(&(dp_schema->mutex));
     if (OPRT_OK != op_ret) {
         PR_ERR("mutex create fail:%d", op_ret);
@@ -1562,6 +1944,10 @@ int dp_schema_create(char *devid, char *schema_json, dp_schema_t **dp_schema_out
         PR_ERR("dp_node_parse fail:%d", op_ret);
         goto __exit;
     }
+    // dp id index, the first node of an id wins like the former linear search
+    for (int i = nodenum; i > 0; i--) {
+        dp_schema->index[dp_schema->node[i - 1].desc.id] = i;
+    }
     dp_schema->actv.preprocess = other_attr.preprocess;
     dp_schema->actv.attach_dp_if = TRUE;
     strncpy(dp_schema->devid, devid, DEV_ID_LEN);
@@ -27,6 +27,11 @@ extern "C" {
 
 #define DEV_ID_LEN 25
 
+/**
+ * @brief number of possible dp ids, the size of a dp id index
+ */
+#define DP_ID_INDEX_NUM 256
+
 /**
  * @brief  Definition of dp property type
  */
@@ -329,6 +334,8 @@ typedef struct {
     dp_prop_actv_t actv;
     /** exclusive access to dp */
     MUTEX_HANDLE mutex;
+    /** dp id to position in node + 1, 0 if the id is not in the schema */
+    uint8_t index[DP_ID_INDEX_NUM];
     /** count of dp */
     uint8_t num;
     /** dp info */
@@ -349,11 +356,25 @@ typedef struct {
 #define DP_DUMP_STAT_LOCAL_FLAG (1 << 1)
 #define DP_APPEND_HEADER_FLAG   (1 << 2)
 
+/**
+ * @brief blocks kept for received dp commands, 0 to always use the heap
+ */
+#ifndef DP_RECV_POOL_NUM
+#define DP_RECV_POOL_NUM 4
+#endif
+
+#ifndef DP_RECV_POOL_SIZE
+#define DP_RECV_POOL_SIZE 512
+#endif
+
 typedef struct {
     char *devid;
     dp_cmd_type_t cmd;
     dp_trans_type_t dt_tp;
     cJSON *data_js;
+    /** the data object as text for dp_data_recv_parse_str(), '\0' terminated */
+    char *data_str;
+    size_t data_len;
     void *user_data;
 } dp_recv_msg_t;
 
@@ -361,7 +382,7 @@ typedef struct {
     dp_rept_type_t rept_type;
     uint32_t flags;
     dp_raw_t *dp;
-    uint8_t dpscnt;
+    uint16_t dpscnt;
     dp_obj_t *dps;
 } dp_rept_in_t;
 
@@ -371,7 +392,7 @@ typedef struct {
 } dp_rept_out_t;
 
 typedef struct {
-    uint8_t num;
+    uint16_t num;
     uint16_t len;
     uint16_t timelen;
     dp_schema_t *schema;
@@ -453,6 +474,38 @@ dp_pv_stat_t dp_pv_stat_get(dp_schema_t *schema, uint8_t id);
  */
 int dp_data_recv_parse(dp_recv_msg_t *msg, dp_recv_cb_t dp_recv_cb);
 
+/**
+ * @brief Parses the received data from its text and invokes the callback
+ * function.
+ *
+ * Same as dp_data_recv_parse(), but "devId" and "dps" are read from
+ * msg->data_str with the streaming JSON reader instead of a cJSON tree. The
+ * text is decoded in place, so string dps and msg->devid point into it. When
+ * the data has a "devId" it replaces msg->devid.
+ *
+ * @param msg Pointer to the received message structure.
+ * @param dp_recv_cb Callback function to handle the parsed data.
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int dp_data_recv_parse_str(dp_recv_msg_t *msg, dp_recv_cb_t dp_recv_cb);
+
+/**
+ * @brief Allocates a buffer for a received dp command, from a block of the
+ * pool when size fits in DP_RECV_POOL_SIZE and one is free, else from the
+ * heap.
+ *
+ * @param size The buffer size.
+ * @return The buffer, free it with dp_recv_buf_free(). NULL on failure.
+ */
+void *dp_recv_buf_malloc(size_t size);
+
+/**
+ * @brief Frees a buffer of dp_recv_buf_malloc().
+ *
+ * @param ptr The buffer.
+ */
+void dp_recv_buf_free(void *ptr);
+
 /**
  * @brief Performs a validity check on the given data point (DP) schema and
  * input.
@@ -485,6 +538,17 @@ int dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
  */
 int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, dp_rept_out_t *dpout);
 
+/**
+ * @brief Builds the index of the dps of a report by dp id.
+ *
+ * index[id] is the position of the first dp with that id in dpin->dps plus 1,
+ * or 0 if the report does not contain the id.
+ *
+ * @param dpin The input data for the DP report.
+ * @param index The index, DP_ID_INDEX_NUM entries.
+ */
+void dp_rept_in_index(dp_rept_in_t *dpin, uint16_t index[DP_ID_INDEX_NUM]);
+
 /**
  * Appends a JSON string to the given data point schema.
  *
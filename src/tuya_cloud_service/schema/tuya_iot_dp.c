@@ -30,6 +30,45 @@
 #include "ble_dp.h"
 #endif
 
+#ifndef DP_REPORT_MERGE_WINDOW_MS
+#define DP_REPORT_MERGE_WINDOW_MS 0
+#endif
+
+#ifndef DP_REPORT_MERGE_DPS_MAX
+#define DP_REPORT_MERGE_DPS_MAX 32
+#endif
+
+#ifndef DP_REPORT_BUDGET
+#define DP_REPORT_BUDGET 4
+#endif
+
+#define DP_REPT_MERGE_DEV_NUM 4
+
+#if (DP_REPORT_MERGE_WINDOW_MS > 0)
+typedef struct {
+    char devid[DEV_ID_LEN + 1];
+    tuya_iot_client_t *client;
+    MUTEX_HANDLE mutex;
+    DELAYED_WORK_HANDLE flush_work;
+    bool flush_armed;
+    /** reports using the context and whether it left s_rept_merge, both under s_rept_merge_mutex */
+    uint8_t users;
+    bool dead;
+    /** flags of the queued dps, a report with other flags sends them first */
+    int flags;
+    /** queued since */
+    SYS_TIME_T first_ms;
+    /** publish budget, the time the next report is due if reports were evenly spaced */
+    SYS_TIME_T budget_ms;
+    uint16_t num;
+    dp_obj_t dps[DP_REPORT_MERGE_DPS_MAX];
+    tuya_iot_dp_rept_stat_t stat;
+} dp_rept_merge_t;
+
+static MUTEX_HANDLE s_rept_merge_mutex = NULL;
+static dp_rept_merge_t *s_rept_merge[DP_REPT_MERGE_DEV_NUM];
+#endif
+
 static DELAYED_WORK_HANDLE s_tmm_dp_sync = NULL;
 
 int tuya_iot_dp_sync_start(tuya_iot_client_t *client, uint32_t timeout_s);
@@ -198,43 +237,74 @@ int tuya_iot_dp_parse(tuya_iot_client_t *client, dp_cmd_type_t cmd_tp, cJSON *cm
     return tal_workq_schedule(WORKQ_HIGHTPRI, tuya_iot_dp_parse_on_worq, msg);
 }
 
+static void tuya_iot_dp_parse_str_on_worq(void *args)
+{
+    dp_recv_msg_t *msg = (dp_recv_msg_t *)args;
+
+    int op_ret = dp_data_recv_parse_str(msg, tuya_iot_dp_event_dispatch);
+    if (OPRT_OK != op_ret) {
+        PR_ERR("handle_recv_dp err:%d", op_ret);
+    }
+
+    dp_recv_buf_free(msg);
+}
+
 /**
- * @brief Reports device object data to the Tuya IoT cloud service.
+ * @brief Parses the device data point command received from the Tuya IoT
+ * platform as JSON text.
  *
- * This function is used to report the device object data to the Tuya IoT cloud
- * service.
+ * The text is copied with the message into one buffer of
+ * dp_recv_buf_malloc() and decoded on the work queue by
+ * dp_data_recv_parse_str(), no cJSON tree is built.
  *
  * @param client The Tuya IoT client instance.
- * @param devid The device ID.
- * @param dps An array of device object data.
- * @param dpscnt The number of device object data elements in the array.
- * @param flags Additional flags for the report.
+ * @param cmd_tp The type of the data point command.
+ * @param data The data object of the command, need not be '\0' terminated.
+ * @param len The length of the data object.
  *
- * @return The result of the operation. Returns 0 on success, or a negative
- * error code on failure.
+ * @return The status of the parsing operation.
+ *     - 0: Success
+ *     - Other values: Error codes
  */
-int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_t *dps, uint16_t dpscnt, int flags)
+int tuya_iot_dp_parse_str(tuya_iot_client_t *client, dp_cmd_type_t cmd_tp, const char *data, size_t len)
 {
-    int ret = OPRT_OK;
-
-    if (!client->is_activated) {
-        PR_DEBUG("client no active");
-        return OPRT_COM_ERROR;
-    }
-    if (NULL == dps || 0 == dpscnt) {
+    if (data == NULL || 0 == len) {
+        PR_ERR("data null");
         return OPRT_INVALID_PARM;
     }
 
-    dp_schema_t *schema = dp_schema_find(devid);
-    if (NULL == schema) {
-        return OPRT_INVALID_PARM;
+    dp_recv_msg_t *msg = dp_recv_buf_malloc(sizeof(dp_recv_msg_t) + len + 1);
+    if (NULL == msg) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(msg, 0, sizeof(dp_recv_msg_t));
+    msg->cmd = cmd_tp;
+    msg->devid = client->activate.devid;
+    msg->dt_tp = DTT_SCT_UNC;
+    msg->data_str = (char *)(msg + 1);
+    msg->data_len = len;
+    msg->user_data = client;
+    memcpy(msg->data_str, data, len);
+    msg->data_str[len] = '\0';
+
+    int rt = tal_workq_schedule(WORKQ_HIGHTPRI, tuya_iot_dp_parse_str_on_worq, msg);
+    if (OPRT_OK != rt) {
+        dp_recv_buf_free(msg);
     }
+    return rt;
+}
+
+/* checks the dps against the schema and sends them on the first connected channel */
+static int dp_obj_report_send(tuya_iot_client_t *client, dp_schema_t *schema, const char *devid, dp_obj_t *dps,
+                              uint16_t dpscnt, int flags)
+{
+    int ret = OPRT_OK;
 
     dp_rept_valid_t *dpvalid = tal_malloc(sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpscnt);
     if (NULL == dpvalid) {
         return OPRT_MALLOC_FAILED;
     }
-    memset(dpvalid, 0, sizeof(sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpscnt));
+    memset(dpvalid, 0, sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpscnt);
 
     PR_DEBUG("dp report: devid %s, dps 0x%08x, dpscnt %d, flags %d", devid ? devid : "null", dps, dpscnt, flags);
 
@@ -264,16 +334,13 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
         ble_dpin->flags = flags;
         ble_dpin->rept_type = T_OBJ_REPT;
         ble_dpin->dpscnt = dpvalid->num;
-        ble_dpin->dps = (dp_obj_t *)(ble_dpin + sizeof(dp_rept_in_t));
+        ble_dpin->dps = (dp_obj_t *)(ble_dpin + 1);
         //! copy vaild dpid
-        int i, j;
+        uint16_t index[DP_ID_INDEX_NUM];
+        int i;
+        dp_rept_in_index(&dpin, index);
         for (i = 0; i < dpvalid->num; i++) {
-            for (j = 0; j < dpin.dpscnt; j++) {
-                if (dpvalid->dpid[i] != dpin.dps[j].id) {
-                    continue;
-                }
-                memcpy(&ble_dpin->dps[i], &dpin.dps[j], sizeof(dp_obj_t));
-            }
+            memcpy(&ble_dpin->dps[i], &dpin.dps[index[dpvalid->dpid[i]] - 1], sizeof(dp_obj_t));
         }
         PR_DEBUG("ble channel report");
         ret = tuya_ble_dp_report(ble_dpin);
@@ -320,6 +387,405 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
     return ret;
 }
 
+#if (DP_REPORT_MERGE_WINDOW_MS > 0)
+/* ms until the budget allows the next report, 0 when it may be sent now */
+static uint32_t dp_rept_merge_budget_wait(dp_rept_merge_t *merge, SYS_TIME_T now)
+{
+#if (DP_REPORT_BUDGET > 0)
+    // up to DP_REPORT_BUDGET reports may go out back to back, then one every 1000 / DP_REPORT_BUDGET ms
+    SYS_TIME_T allow = merge->budget_ms - (DP_REPORT_BUDGET - 1) * (1000 / DP_REPORT_BUDGET);
+
+    if ((int64_t)(allow - now) > 0) {
+        return (uint32_t)(allow - now);
+    }
+#endif
+
+    return 0;
+}
+
+/* sends the queued dps in one report, called with merge->mutex held */
+static int dp_rept_merge_flush(dp_rept_merge_t *merge)
+{
+    SYS_TIME_T now = tal_system_get_millisecond();
+    uint32_t delay = (uint32_t)(now - merge->first_ms);
+    dp_schema_t *schema = NULL;
+    uint16_t i = 0;
+    int ret = OPRT_OK;
+
+    if (0 == merge->num) {
+        return OPRT_OK;
+    }
+
+    merge->stat.messages++;
+    merge->stat.delay_ms_total += delay;
+    if (delay > merge->stat.delay_ms_max) {
+        merge->stat.delay_ms_max = delay;
+    }
+#if (DP_REPORT_BUDGET > 0)
+    merge->budget_ms = ((int64_t)(merge->budget_ms - now) > 0 ? merge->budget_ms : now) + 1000 / DP_REPORT_BUDGET;
+#endif
+
+    schema = dp_schema_find(merge->devid);
+    if (NULL == schema || !merge->client->is_activated) {
+        ret = OPRT_COM_ERROR;
+    } else {
+        ret = dp_obj_report_send(merge->client, schema, merge->devid, merge->dps, merge->num, merge->flags);
+    }
+    merge->stat.last_result = ret;
+    // no dp left after the checks is not a failure, all of them were reported already
+    if (OPRT_OK != ret && OPRT_SVC_DP_ID_NOT_FOUND != ret) {
+        merge->stat.send_errors++;
+        PR_ERR("merged dp report of %s fail:%d", merge->devid, ret);
+        // the dps are kept in the local state, the dp sync reports them again like after a failed publish
+        if (schema && merge->client->is_activated) {
+            tuya_iot_dp_sync_start(merge->client, 5);
+        }
+    }
+
+    for (i = 0; i < merge->num; i++) {
+        if (PROP_STR == merge->dps[i].type) {
+            tal_free(merge->dps[i].value.dp_str);
+        }
+    }
+    merge->num = 0;
+
+    return ret;
+}
+
+/* releases a context taken out of s_rept_merge, runs on the flush workqueue so no flush of it is running */
+static void dp_rept_merge_release(void *data)
+{
+    dp_rept_merge_t *merge = (dp_rept_merge_t *)data;
+    uint16_t i = 0;
+
+    tal_workq_cancel_delayed(merge->flush_work);
+    for (i = 0; i < merge->num; i++) {
+        if (PROP_STR == merge->dps[i].type) {
+            tal_free(merge->dps[i].value.dp_str);
+        }
+    }
+    tal_mutex_release(merge->mutex);
+    tal_free(merge);
+}
+
+/* takes a context out of s_rept_merge, called with s_rept_merge_mutex held. True if the caller has to
+ * release it, else a report still uses it and the last one releases it in dp_rept_merge_put() */
+static bool dp_rept_merge_detach(dp_rept_merge_t *merge)
+{
+    bool found = false;
+
+    for (int i = 0; i < DP_REPT_MERGE_DEV_NUM; i++) {
+        if (s_rept_merge[i] == merge) {
+            s_rept_merge[i] = NULL;
+            found = true;
+        }
+    }
+    if (found) {
+        merge->dead = true;
+    }
+
+    return found && 0 == merge->users;
+}
+
+/* drops the reference taken by dp_rept_merge_get() */
+static void dp_rept_merge_put(dp_rept_merge_t *merge)
+{
+    bool release = false;
+
+    tal_mutex_lock(s_rept_merge_mutex);
+    merge->users--;
+    release = merge->dead && 0 == merge->users;
+    tal_mutex_unlock(s_rept_merge_mutex);
+
+    if (release && OPRT_OK != tal_workq_schedule(WORKQ_HIGHTPRI, dp_rept_merge_release, merge)) {
+        dp_rept_merge_release(merge);
+    }
+}
+
+static void dp_rept_merge_flush_on_worq(void *data)
+{
+    dp_rept_merge_t *merge = (dp_rept_merge_t *)data;
+    uint32_t wait = 0;
+    bool release = false;
+
+    tal_mutex_lock(merge->mutex);
+    merge->flush_armed = false;
+    wait = dp_rept_merge_budget_wait(merge, tal_system_get_millisecond());
+    if (merge->num && wait) {
+        // over budget, keep merging until the budget allows the report
+        merge->stat.budget_waits++;
+        merge->flush_armed = true;
+        tal_workq_start_delayed(merge->flush_work, wait, LOOP_ONCE);
+    } else {
+        dp_rept_merge_flush(merge);
+    }
+    tal_mutex_unlock(merge->mutex);
+
+    // the window is closed, a device removed since then gives its slot back
+    if (!merge->flush_armed && NULL == dp_schema_find(merge->devid)) {
+        tal_mutex_lock(s_rept_merge_mutex);
+        release = dp_rept_merge_detach(merge);
+        tal_mutex_unlock(s_rept_merge_mutex);
+        if (release) {
+            PR_DEBUG("dp report merge of %s released", merge->devid);
+            dp_rept_merge_release(merge);
+        }
+    }
+}
+
+/* the merge context of a device, created on its first report, dp_rept_merge_put() gives it back */
+static dp_rept_merge_t *dp_rept_merge_get(tuya_iot_client_t *client, const char *devid)
+{
+    dp_rept_merge_t *merge = NULL;
+    int i = 0, slot = -1;
+
+    if (NULL == s_rept_merge_mutex) {
+        return NULL;
+    }
+
+    tal_mutex_lock(s_rept_merge_mutex);
+    for (i = 0; i < DP_REPT_MERGE_DEV_NUM; i++) {
+        if (s_rept_merge[i] && 0 == strcmp(s_rept_merge[i]->devid, devid)) {
+            merge = s_rept_merge[i];
+            goto __exit;
+        }
+        if (NULL == s_rept_merge[i] && slot < 0) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        goto __exit;
+    }
+
+    merge = tal_calloc(1, sizeof(dp_rept_merge_t));
+    if (NULL == merge) {
+        goto __exit;
+    }
+    strncpy(merge->devid, devid, DEV_ID_LEN);
+    merge->client = client;
+    if (OPRT_OK != tal_mutex_create_init(&merge->mutex) ||
+        OPRT_OK != tal_workq_init_delayed(WORKQ_HIGHTPRI, dp_rept_merge_flush_on_worq, merge, &merge->flush_work)) {
+        if (merge->mutex) {
+            tal_mutex_release(merge->mutex);
+        }
+        tal_free(merge);
+        merge = NULL;
+        goto __exit;
+    }
+    s_rept_merge[slot] = merge;
+
+__exit:
+    if (merge) {
+        merge->users++;
+    }
+    tal_mutex_unlock(s_rept_merge_mutex);
+    return merge;
+}
+
+/* queues the dps of a report, a newer value of a state dp replaces the queued one */
+static int dp_rept_merge_add(dp_rept_merge_t *merge, dp_schema_t *schema, dp_obj_t *dps, uint16_t dpscnt, int flags)
+{
+    dp_node_t *dpnode = NULL;
+    dp_obj_t *dp = NULL;
+    char *str = NULL;
+    bool record = false;
+    uint16_t i = 0, j = 0;
+    int ret = OPRT_OK, rt = OPRT_OK;
+
+    tal_mutex_lock(merge->mutex);
+    if (merge->num && merge->flags != flags) {
+        ret = dp_rept_merge_flush(merge);
+    }
+    merge->flags = flags;
+    merge->stat.calls++;
+    merge->stat.dps += dpscnt;
+
+    for (i = 0; i < dpscnt; i++) {
+        tal_mutex_lock(schema->mutex);
+        dpnode = dp_node_find(schema, dps[i].id);
+        record = dpnode && (0 != dps[i].time_stamp || DST_NONE != dpnode->desc.stat);
+        tal_mutex_unlock(schema->mutex);
+        if (NULL == dpnode) {
+            PR_ERR("dp %d not in schema", dps[i].id);
+            continue;
+        }
+        if (PROP_STR == dps[i].type) {
+            str = mm_strdup(dps[i].value.dp_str ? dps[i].value.dp_str : "");
+            if (NULL == str) {
+                PR_ERR("dp %d str copy fail", dps[i].id);
+                continue;
+            }
+        }
+
+        for (j = 0; j < merge->num && merge->dps[j].id != dps[i].id; j++) {
+        }
+        if (j < merge->num && !record) {
+            dp = &merge->dps[j];
+            if (PROP_STR == dp->type) {
+                tal_free(dp->value.dp_str);
+            }
+            merge->stat.overwritten++;
+        } else {
+            // a report carries one value of a dp, a queued record value goes out first
+            if (j < merge->num || merge->num >= DP_REPORT_MERGE_DPS_MAX) {
+                rt = dp_rept_merge_flush(merge);
+                ret = (OPRT_OK == ret) ? rt : ret;
+            }
+            if (0 == merge->num) {
+                merge->first_ms = tal_system_get_millisecond();
+            }
+            dp = &merge->dps[merge->num++];
+        }
+
+        *dp = dps[i];
+        if (PROP_STR == dp->type) {
+            dp->value.dp_str = str;
+        }
+    }
+
+    if (merge->num >= DP_REPORT_MERGE_DPS_MAX) {
+        rt = dp_rept_merge_flush(merge);
+        ret = (OPRT_OK == ret) ? rt : ret;
+    } else if (merge->num && !merge->flush_armed) {
+        merge->flush_armed = true;
+        tal_workq_start_delayed(merge->flush_work, DP_REPORT_MERGE_WINDOW_MS, LOOP_ONCE);
+    }
+    tal_mutex_unlock(merge->mutex);
+
+    // the result of the reports this call sent, the dps still queued are counted in the stat when sent
+    return ret;
+}
+#endif
+
+/**
+ * @brief Initializes the dp report merging, called once by tuya_iot_init().
+ *
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tuya_iot_dp_init(void)
+{
+#if (DP_REPORT_MERGE_WINDOW_MS > 0)
+    if (NULL == s_rept_merge_mutex) {
+        return tal_mutex_create_init(&s_rept_merge_mutex);
+    }
+#endif
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Releases the dp report merge contexts, the queued dps are dropped.
+ *
+ * @return OPRT_OK on success, or a negative error code on failure.
+ */
+int tuya_iot_dp_deinit(void)
+{
+#if (DP_REPORT_MERGE_WINDOW_MS > 0)
+    if (NULL == s_rept_merge_mutex) {
+        return OPRT_OK;
+    }
+
+    for (int i = 0; i < DP_REPT_MERGE_DEV_NUM; i++) {
+        tal_mutex_lock(s_rept_merge_mutex);
+        dp_rept_merge_t *merge = s_rept_merge[i];
+        bool release = merge && dp_rept_merge_detach(merge);
+        tal_mutex_unlock(s_rept_merge_mutex);
+        if (release && OPRT_OK != tal_workq_schedule(WORKQ_HIGHTPRI, dp_rept_merge_release, merge)) {
+            dp_rept_merge_release(merge);
+        }
+    }
+#endif
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Reports device object data to the Tuya IoT cloud service.
+ *
+ * This function is used to report the device object data to the Tuya IoT cloud
+ * service. With DP_REPORT_MERGE_WINDOW_MS the dps are queued and sent together
+ * with the other reports of the device in the window. OPRT_OK then means the
+ * dps are queued; the result of the report is in tuya_iot_dp_rept_stat_get()
+ * and a failed report is sent again by the dp sync.
+ *
+ * @param client The Tuya IoT client instance.
+ * @param devid The device ID.
+ * @param dps An array of device object data.
+ * @param dpscnt The number of device object data elements in the array.
+ * @param flags Additional flags for the report.
+ *
+ * @return The result of the operation. Returns 0 on success, or a negative
+ * error code on failure.
+ */
+int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_t *dps, uint16_t dpscnt, int flags)
+{
+    if (!client->is_activated) {
+        PR_DEBUG("client no active");
+        return OPRT_COM_ERROR;
+    }
+    if (NULL == dps || 0 == dpscnt) {
+        return OPRT_INVALID_PARM;
+    }
+
+    dp_schema_t *schema = dp_schema_find(devid);
+    if (NULL == schema) {
+        return OPRT_INVALID_PARM;
+    }
+
+#if (DP_REPORT_MERGE_WINDOW_MS > 0)
+    dp_rept_merge_t *merge = dp_rept_merge_get(client, devid);
+    if (merge) {
+        int ret = dp_rept_merge_add(merge, schema, dps, dpscnt, flags);
+        dp_rept_merge_put(merge);
+        return ret;
+    }
+#endif
+
+    return dp_obj_report_send(client, schema, devid, dps, dpscnt, flags);
+}
+
+/**
+ * @brief Reads the counters of the dp report merging of a device.
+ *
+ * @param devid The device ID.
+ * @param stat The counters.
+ *
+ * @return OPRT_OK on success, OPRT_NOT_FOUND if the device has not reported
+ * yet or merging is disabled.
+ */
+int tuya_iot_dp_rept_stat_get(const char *devid, tuya_iot_dp_rept_stat_t *stat)
+{
+    if (NULL == devid || NULL == stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+#if (DP_REPORT_MERGE_WINDOW_MS > 0)
+    int ret = OPRT_NOT_FOUND;
+
+    if (NULL == s_rept_merge_mutex) {
+        return OPRT_NOT_FOUND;
+    }
+
+    // a context in s_rept_merge is not released while the mutex is held
+    tal_mutex_lock(s_rept_merge_mutex);
+    for (int i = 0; i < DP_REPT_MERGE_DEV_NUM; i++) {
+        dp_rept_merge_t *merge = s_rept_merge[i];
+        if (merge && 0 == strcmp(merge->devid, devid)) {
+            tal_mutex_lock(merge->mutex);
+            *stat = merge->stat;
+            tal_mutex_unlock(merge->mutex);
+            ret = OPRT_OK;
+            break;
+        }
+    }
+    tal_mutex_unlock(s_rept_merge_mutex);
+
+    return ret;
+#else
+    return OPRT_NOT_FOUND;
+#endif
+}
+
 /**
  * @brief Dumps the object representation of the Tuya IoT data point (DP) for a
  * specific device.
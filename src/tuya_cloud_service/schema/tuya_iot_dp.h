@@ -23,6 +23,43 @@ extern "C" {
 
 #include "tuya_iot.h"
 
+/**
+ * @brief counters of the dp report merging of a device
+ */
+typedef struct {
+    /** tuya_iot_dp_obj_report() calls, calls - messages is the reports saved */
+    uint32_t calls;
+    /** dps of these calls */
+    uint32_t dps;
+    /** reports sent */
+    uint32_t messages;
+    /** queued dps replaced by a newer value */
+    uint32_t overwritten;
+    /** window ends that waited for the publish budget */
+    uint32_t budget_waits;
+    /** time the first dp of a report was queued, max and total */
+    uint32_t delay_ms_max;
+    uint32_t delay_ms_total;
+    /** reports that failed, their dps are sent again by the dp sync */
+    uint32_t send_errors;
+    /** result of the last report sent */
+    int last_result;
+} tuya_iot_dp_rept_stat_t;
+
+/**
+ * @brief Initializes the dp report merging, called once by tuya_iot_init().
+ *
+ * @return int
+ */
+int tuya_iot_dp_init(void);
+
+/**
+ * @brief Releases the dp report merge contexts, the queued dps are dropped.
+ *
+ * @return int
+ */
+int tuya_iot_dp_deinit(void);
+
 /**
  * @brief
  *
@@ -33,6 +70,18 @@ extern "C" {
  */
 int tuya_iot_dp_parse(tuya_iot_client_t *client, dp_cmd_type_t tp, cJSON *cmd_js);
 
+/**
+ * @brief Parses a dp command from the text of its data object, without a
+ * cJSON tree.
+ *
+ * @param client
+ * @param tp
+ * @param data
+ * @param len
+ * @return int
+ */
+int tuya_iot_dp_parse_str(tuya_iot_client_t *client, dp_cmd_type_t tp, const char *data, size_t len);
+
 /**
  * @brief
  *
@@ -66,6 +115,15 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
  */
 int tuya_iot_dp_raw_report(tuya_iot_client_t *client, const char *devid, dp_raw_t *dp, uint32_t timeout);
 
+/**
+ * @brief Reads the counters of the dp report merging of a device.
+ *
+ * @param devid
+ * @param stat
+ * @return int
+ */
+int tuya_iot_dp_rept_stat_get(const char *devid, tuya_iot_dp_rept_stat_t *stat);
+
 /**
  * @brief
  *
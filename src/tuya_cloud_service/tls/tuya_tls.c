@@ -38,6 +38,7 @@
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/hkdf.h"
 #include "mbedtls/aes.h"
+#include "mbedtls/sha256.h"
 
 #define TLS_URL_LEN (128 + 16)
 
@@ -50,15 +51,38 @@ typedef struct {
     mbedtls_pk_context client_pkey;
     int socket_fd;
     int overtime_s;
+    bool peer_verified;
     MUTEX_HANDLE mutex;
     MUTEX_HANDLE read_mutex;
 } tuya_mbedtls_context_t;
 
 #define TLS_HANDSHAKE_TIMEOUT (18) // s
 
+#ifndef TUYA_TLS_SESSION_CACHE_NUM
+#define TUYA_TLS_SESSION_CACHE_NUM (2)
+#endif
+#define TLS_SESSION_LIFETIME (2 * 60 * 60) // s
+#define TLS_SESSION_DIGEST_LEN (32)
+
+#if (TUYA_TLS_SESSION_CACHE_NUM > 0)
+typedef struct {
+    bool valid;
+    char hostname[TLS_URL_LEN];
+    int port;
+    unsigned char digest[TLS_SESSION_DIGEST_LEN]; // of the CA, verify mode, PSK and client cert
+    TIME_T saved_time;
+    mbedtls_ssl_session session;
+} tuya_tls_session_cache_t;
+#endif
+
 static tuya_tls_pre_conn_cb s_pre_conn_cb = NULL;
 static mbedtls_entropy_context ty_entropy;
 static mbedtls_ctr_drbg_context ty_ctr_drbg;
+static tuya_tls_stat_t s_tls_stat;
+#if (TUYA_TLS_SESSION_CACHE_NUM > 0)
+static tuya_tls_session_cache_t s_session_cache[TUYA_TLS_SESSION_CACHE_NUM];
+static MUTEX_HANDLE s_session_mutex = NULL;
+#endif
 
 /* -------------------------------------------------------------------------- */
 /*                                  TLS Mutex                                 */
@@ -139,6 +163,194 @@ static __attribute__((unused)) void *__tuya_tls_calloc(size_t nmemb, size_t size
     return ptr;
 }
 
+/* -------------------------------------------------------------------------- */
+/*                              TLS Session Cache                             */
+/* -------------------------------------------------------------------------- */
+/*
+ * The last session of every host:port is kept after a successful handshake and
+ * offered again on the next connect. A server that still knows the session ID
+ * (or accepts the ticket) skips the certificate exchange and the ECDHE key
+ * exchange, otherwise the handshake silently falls back to a full one.
+ *
+ * A resumed handshake skips the checks of the connection, so a session is only
+ * offered to a connection with the same CA, verify mode, PSK and client
+ * certificate as the one that made it.
+ */
+#if (TUYA_TLS_SESSION_CACHE_NUM > 0)
+static void __tuya_tls_session_digest_add(mbedtls_sha256_context *ctx, const void *data, uint32_t len)
+{
+    unsigned char len_buf[4] = {len >> 24, len >> 16, len >> 8, len};
+
+    mbedtls_sha256_update(ctx, len_buf, sizeof(len_buf));
+    if (data && len > 0) {
+        mbedtls_sha256_update(ctx, data, len);
+    }
+}
+
+static void __tuya_tls_session_digest(const tuya_tls_config_t *config, unsigned char *digest)
+{
+    mbedtls_sha256_context ctx;
+    unsigned char flags[2] = {(unsigned char)config->mode, (unsigned char)config->verify};
+
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    __tuya_tls_session_digest_add(&ctx, flags, sizeof(flags));
+    __tuya_tls_session_digest_add(&ctx, config->ca_cert, config->ca_cert_size);
+    __tuya_tls_session_digest_add(&ctx, config->psk_id, config->psk_id_size);
+    __tuya_tls_session_digest_add(&ctx, config->psk_key, config->psk_key_size);
+    __tuya_tls_session_digest_add(&ctx, config->client_cert, config->client_cert_size);
+    __tuya_tls_session_digest_add(&ctx, config->client_pkey, config->client_pkey_size);
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+}
+
+static tuya_tls_session_cache_t *__tuya_tls_session_find(const char *hostname, int port, const unsigned char *digest)
+{
+    int i = 0;
+
+    for (i = 0; i < TUYA_TLS_SESSION_CACHE_NUM; i++) {
+        if (s_session_cache[i].valid && s_session_cache[i].port == port &&
+            0 == strcmp(s_session_cache[i].hostname, hostname) &&
+            0 == memcmp(s_session_cache[i].digest, digest, TLS_SESSION_DIGEST_LEN)) {
+            return &s_session_cache[i];
+        }
+    }
+
+    return NULL;
+}
+
+static bool __tuya_tls_session_load(mbedtls_ssl_context *p_ssl_ctx, const char *hostname, int port,
+                                    const unsigned char *digest, unsigned char *id, size_t *id_len)
+{
+    bool loaded = false;
+    tuya_tls_session_cache_t *entry = NULL;
+
+    *id_len = 0;
+    if (NULL == s_session_mutex || NULL == hostname) {
+        return false;
+    }
+
+    tal_mutex_lock(s_session_mutex);
+    entry = __tuya_tls_session_find(hostname, port, digest);
+    if (entry && (tal_time_get_posix() - entry->saved_time) < TLS_SESSION_LIFETIME) {
+        if (0 == mbedtls_ssl_set_session(p_ssl_ctx, &entry->session)) {
+            *id_len = entry->session.MBEDTLS_PRIVATE(id_len);
+            memcpy(id, entry->session.MBEDTLS_PRIVATE(id), *id_len);
+            loaded = true;
+        }
+    }
+    tal_mutex_unlock(s_session_mutex);
+
+    return loaded;
+}
+
+static void __tuya_tls_session_save(mbedtls_ssl_context *p_ssl_ctx, const char *hostname, int port,
+                                    const unsigned char *digest)
+{
+    int i = 0;
+    tuya_tls_session_cache_t *entry = NULL;
+
+    if (NULL == s_session_mutex || NULL == hostname || strlen(hostname) >= TLS_URL_LEN) {
+        return;
+    }
+
+    tal_mutex_lock(s_session_mutex);
+    entry = __tuya_tls_session_find(hostname, port, digest);
+    if (NULL == entry) {
+        // take a free slot, or replace the oldest session
+        entry = &s_session_cache[0];
+        for (i = 0; i < TUYA_TLS_SESSION_CACHE_NUM; i++) {
+            if (!s_session_cache[i].valid) {
+                entry = &s_session_cache[i];
+                break;
+            }
+            if (s_session_cache[i].saved_time < entry->saved_time) {
+                entry = &s_session_cache[i];
+            }
+        }
+    }
+
+    if (entry->valid) {
+        mbedtls_ssl_session_free(&entry->session);
+        entry->valid = false;
+    }
+
+    mbedtls_ssl_session_init(&entry->session);
+    if (0 == mbedtls_ssl_get_session(p_ssl_ctx, &entry->session)) {
+        strcpy(entry->hostname, hostname);
+        entry->port = port;
+        memcpy(entry->digest, digest, TLS_SESSION_DIGEST_LEN);
+        entry->saved_time = tal_time_get_posix();
+        entry->valid = true;
+    } else {
+        mbedtls_ssl_session_free(&entry->session);
+    }
+    tal_mutex_unlock(s_session_mutex);
+}
+
+static void __tuya_tls_session_drop(const char *hostname, int port, const unsigned char *digest)
+{
+    tuya_tls_session_cache_t *entry = NULL;
+
+    if (NULL == s_session_mutex || NULL == hostname) {
+        return;
+    }
+
+    tal_mutex_lock(s_session_mutex);
+    entry = __tuya_tls_session_find(hostname, port, digest);
+    if (entry) {
+        mbedtls_ssl_session_free(&entry->session);
+        entry->valid = false;
+    }
+    tal_mutex_unlock(s_session_mutex);
+}
+#endif
+
+/**
+ * @brief Drops all cached TLS sessions, the next connects do a full handshake.
+ */
+void tuya_tls_session_cache_clear(void)
+{
+#if (TUYA_TLS_SESSION_CACHE_NUM > 0)
+    int i = 0;
+
+    if (NULL == s_session_mutex) {
+        return;
+    }
+
+    tal_mutex_lock(s_session_mutex);
+    for (i = 0; i < TUYA_TLS_SESSION_CACHE_NUM; i++) {
+        if (s_session_cache[i].valid) {
+            mbedtls_ssl_session_free(&s_session_cache[i].session);
+            s_session_cache[i].valid = false;
+        }
+    }
+    tal_mutex_unlock(s_session_mutex);
+#endif
+}
+
+/**
+ * @brief Reads the handshake counters.
+ *
+ * @param[out] stat handshake counters since boot
+ */
+void tuya_tls_stat_get(tuya_tls_stat_t *stat)
+{
+    if (stat) {
+        *stat = s_tls_stat;
+    }
+}
+
+/* called for every certificate of the peer chain, so only during a full handshake */
+static int __tuya_tls_verify_cb(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+    tuya_mbedtls_context_t *tls_context = (tuya_mbedtls_context_t *)ctx;
+
+    tls_context->peer_verified = true;
+
+    return 0;
+}
+
 #if defined(ENABLE_MBEDTLS_DEBUG) && (ENABLE_MBEDTLS_DEBUG == 1)
 static void __tuya_tls_export_keys(void *p_expkey, mbedtls_ssl_key_export_type type, const unsigned char *secret,
                                    size_t secret_len, const unsigned char client_random[32],
@@ -336,6 +548,7 @@ static OPERATE_RET mbedtls_cert_pkey_parse(tuya_tls_hander p_tls_handler)
     if (config->verify) {
         PR_DEBUG("mbedtls authmode: MBEDTLS_SSL_VERIFY_REQUIRED");
         mbedtls_ssl_conf_authmode(&(tls_context->conf_ctx), MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_verify(&(tls_context->conf_ctx), __tuya_tls_verify_cb, tls_context);
     } else {
 
         PR_DEBUG("mbedtls authmode: MBEDTLS_SSL_VERIFY_NONE");
@@ -425,6 +638,16 @@ OPERATE_RET tuya_tls_init(void)
     }
     mbedtls_ctr_drbg_set_prediction_resistance(&ty_ctr_drbg, MBEDTLS_CTR_DRBG_PR_OFF);
 
+#if (TUYA_TLS_SESSION_CACHE_NUM > 0)
+    if (NULL == s_session_mutex) {
+        op_ret = tal_mutex_create_init(&s_session_mutex);
+        if (op_ret != OPRT_OK) {
+            PR_ERR("session mutex create fail. %d", op_ret);
+            goto exit;
+        }
+    }
+#endif
+
     PR_NOTICE("tuya_tls_init ok!");
 
     return OPRT_OK;
@@ -549,6 +772,12 @@ tuya_tls_config_t *tuya_tls_config_get(tuya_tls_hander p_tls_handler)
 OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int port_num, int socket_fd, int overtime_s)
 {
     OPERATE_RET op_ret;
+    bool resuming = false, resumed = false;
+    unsigned char resume_id[32];
+#if (TUYA_TLS_SESSION_CACHE_NUM > 0)
+    unsigned char session_digest[TLS_SESSION_DIGEST_LEN];
+#endif
+    size_t resume_id_len = 0;
     tuya_mbedtls_context_t *tls_context = (tuya_mbedtls_context_t *)p_tls_handler;
 
     if (NULL == p_tls_handler || socket_fd < 0) {
@@ -557,6 +786,7 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
     }
 
     tls_context->config.hostname = hostname;
+    tls_context->peer_verified = false;
     tls_context->config.port = port_num;
     tls_context->config.timeout = overtime_s;
     tls_context->config.exception_cb =
@@ -632,6 +862,11 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
         goto tuya_tls_connect_EXIT;
     }
 
+#if (TUYA_TLS_SESSION_CACHE_NUM > 0)
+    __tuya_tls_session_digest(&tls_context->config, session_digest);
+    resuming = __tuya_tls_session_load(p_ssl_ctx, hostname, port_num, session_digest, resume_id, &resume_id_len);
+#endif
+
     /* BIO default config */
     tls_context->socket_fd = socket_fd;
     tls_context->overtime_s = overtime_s;
@@ -678,7 +913,27 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
         goto tuya_tls_connect_EXIT;
     }
 
-    PR_DEBUG("handshake finish for %s. set send/recv to user set", (hostname ? hostname : ""));
+    if (resuming) {
+        // a resumed handshake does not verify the peer again and keeps the offered session ID
+        if (tls_context->config.verify && tls_context->config.psk_key_size == 0) {
+            resumed = !tls_context->peer_verified;
+        } else {
+            mbedtls_ssl_session *p_session = p_ssl_ctx->MBEDTLS_PRIVATE(session);
+            resumed = (resume_id_len > 0 && resume_id_len == p_session->MBEDTLS_PRIVATE(id_len) &&
+                       0 == memcmp(resume_id, p_session->MBEDTLS_PRIVATE(id), resume_id_len));
+        }
+    }
+    if (resumed) {
+        s_tls_stat.resumed_handshakes++;
+    } else {
+        s_tls_stat.full_handshakes++;
+    }
+#if (TUYA_TLS_SESSION_CACHE_NUM > 0)
+    __tuya_tls_session_save(p_ssl_ctx, hostname, port_num, session_digest);
+#endif
+
+    PR_DEBUG("handshake finish for %s%s. set send/recv to user set", (hostname ? hostname : ""),
+             (resumed ? " (resumed)" : ""));
     if (tls_context->config.f_send && tls_context->config.f_recv) {
         mbedtls_ssl_set_bio(p_ssl_ctx, tls_context->config.user_data, tls_context->config.f_send,
                             tls_context->config.f_recv, NULL);
@@ -690,6 +945,12 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
     return OPRT_OK;
 
 tuya_tls_connect_EXIT:
+    s_tls_stat.failed_handshakes++;
+#if (TUYA_TLS_SESSION_CACHE_NUM > 0)
+    if (resuming) {
+        __tuya_tls_session_drop(hostname, port_num, session_digest);
+    }
+#endif
 
     PR_ERR("TUYA_TLS faild Connect %s:%d", (hostname ? hostname : ""), port_num);
 
@@ -783,6 +1044,32 @@ int tuya_tls_read(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len)
     return value;
 }
 
+/**
+ * @brief Sends the TLS close_notify alert, must be called before the socket is
+ * closed. Servers drop the session of a connection closed without it, so the
+ * next connect could not resume it.
+ *
+ * @param[in] tls_handler refer to tuya_tls_hander
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_tls_close_notify(tuya_tls_hander tls_handler)
+{
+    if (tls_handler == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tuya_mbedtls_context_t *tls_context = (tuya_mbedtls_context_t *)tls_handler;
+
+    // nothing is sent before the handshake is over
+    if (0 != mbedtls_ssl_close_notify(&(tls_context->ssl_ctx))) {
+        return OPRT_COM_ERROR;
+    }
+
+    return OPRT_OK;
+}
+
 /**
  * @brief generated random
  *
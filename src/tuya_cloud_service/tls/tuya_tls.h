@@ -62,6 +62,12 @@ typedef enum {
  */
 typedef void (*tuya_tls_event_cb)(tuya_tls_event_t event, void *p_args);
 
+typedef struct {
+    uint32_t full_handshakes;    // handshakes with certificate and key exchange
+    uint32_t resumed_handshakes; // handshakes that resumed a cached session
+    uint32_t failed_handshakes;
+} tuya_tls_stat_t;
+
 typedef struct {
     tuya_tls_mode_t mode;
     char *hostname;
@@ -198,6 +204,17 @@ int tuya_tls_write(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len);
  */
 int tuya_tls_read(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len);
 
+/**
+ * @brief send the close_notify alert before the socket is closed, so the
+ * server keeps the session for resumption
+ *
+ * @param[in] tls_handler refer to tuya_tls_hander
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_tls_close_notify(tuya_tls_hander tls_handler);
+
 /**
  * @brief generated random
  *
@@ -221,6 +238,22 @@ OPERATE_RET tuya_tls_disconnect(tuya_tls_hander tls_handler);
  */
 const tuya_tls_config_t *tuya_tls_psk_mode_config_get(void);
 
+/**
+ * @brief Drops all cached TLS sessions.
+ *
+ * The last session of every host:port is kept to resume the next connection
+ * without a full handshake. Call this when the sessions must not be reused,
+ * e.g. after the certificates changed.
+ */
+void tuya_tls_session_cache_clear(void);
+
+/**
+ * @brief Reads the handshake counters.
+ *
+ * @param[out] stat handshake counters since boot
+ */
+void tuya_tls_stat_get(tuya_tls_stat_t *stat);
+
 /**
  * Retrieves the callback function for Tuya TLS events.
  *
@@ -121,6 +121,9 @@ OPERATE_RET tuya_tls_transporter_close(tuya_transporter_t t)
 
     PR_DEBUG("tls transporter close socket fd:%d", tls_transporter->socket_fd);
     if (tls_transporter->socket_fd >= 0) {
+        if (tls_transporter->tls_handler) {
+            tuya_tls_close_notify(tls_transporter->tls_handler);
+        }
         tuya_transporter_close(tls_transporter->tcp_transporter);
         tls_transporter->socket_fd = -1;
     } else {
@@ -109,7 +109,8 @@ int rtp_packet_getsize()
 static int rtp_payload_find(int payload, const char *encoding, struct rtp_payload_delegate_t *codec)
 {
     assert(payload >= 0 && payload <= 127);
-    if (payload >= RTP_PAYLOAD_DYNAMIC && encoding) {
+    // 36-95 are unassigned and resolved by name like dynamic types (95 is used for H.265)
+    if (payload > RTP_PAYLOAD_AV1X && encoding) {
         if (0 == strcasecmp(encoding, "H264")) {
             // H.264 video (MPEG-4 Part 10) (RFC 6184)
             codec->encoder = rtp_h264_encode();
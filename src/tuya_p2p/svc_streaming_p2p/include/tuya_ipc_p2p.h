@@ -39,6 +39,21 @@ typedef struct tagMediaFrame {
     UINT64_T timestamp;    ///< timestamp is ms
 } MEDIA_FRAME;
 
+/**
+ * @brief per session send statistics, see tuya_ipc_p2p_get_session_stat
+ */
+typedef struct {
+    INT_T session;        ///< rtc session handle, -1 when the slot is idle
+    UINT_T queue_depth;   ///< frames waiting to be sent
+    UINT_T queue_max;     ///< high-water mark of queue_depth
+    UINT_T sent_frames;   ///< frames handed to the transport
+    UINT_T drop_queue;    ///< frames dropped because the send queue was full
+    UINT_T drop_send;     ///< frames dropped because the transport buffer was full
+    UINT_T drop_wait_key; ///< video frames skipped while waiting for an i frame
+} TUYA_IPC_P2P_SESSION_STAT_T;
+
+#define TUYA_IPC_P2P_MAX_SESSION (32) ///< upper limit of max_client_num
+
 typedef INT_T (*tuya_p2p_rtc_disconnect_cb_t)();
 typedef INT_T (*tuya_p2p_rtc_get_frame_cb_t)(MEDIA_FRAME *pMediaFrame);
 
@@ -78,6 +93,57 @@ OPERATE_RET tuya_p2p_rtc_register_get_audio_frame_cb(tuya_p2p_rtc_get_frame_cb_t
 INT_T OnGetVideoFrameCallback(MEDIA_FRAME *pMediaFrame);
 INT_T OnGetAudioFrameCallback(MEDIA_FRAME *pMediaFrame);
 
+/**
+ * @brief wake the thread that calls the get frame callbacks
+ *
+ * Once the callbacks return no frame the thread asks again after a frame
+ * interval. A producer feeding the callbacks may call this when it has a new
+ * frame to have it pulled at once, it is not required.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ipc_p2p_notify_frame_ready(VOID);
+
+/**
+ * @brief push an encoded video frame to every session playing live video
+ *
+ * The frame is packetized once and shared by all sessions, the send thread is
+ * woken right away. Use it instead of the get frame callbacks, which have to
+ * be called from a thread of their own. Frames of one media type must be pushed
+ * from one thread.
+ *
+ * @param[in] p_frame frame, the data is copied before returning
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ipc_p2p_push_video_frame(IN MEDIA_FRAME *p_frame);
+
+/**
+ * @brief push an encoded audio frame to every session playing live audio
+ *
+ * @param[in] p_frame frame, the data is copied before returning
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ipc_p2p_push_audio_frame(IN MEDIA_FRAME *p_frame);
+
+/**
+ * @brief get the number of session slots
+ *
+ * @return max_client_num given to p2p_init, limited to TUYA_IPC_P2P_MAX_SESSION
+ */
+INT_T tuya_ipc_p2p_get_session_num(VOID);
+
+/**
+ * @brief get the send queue depth and drop counters of a session slot
+ *
+ * @param[in] index slot, 0 ~ tuya_ipc_p2p_get_session_num() - 1
+ * @param[out] p_stat statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ipc_p2p_get_session_stat(IN INT_T index, OUT TUYA_IPC_P2P_SESSION_STAT_T *p_stat);
+
 // OPERATE_RET tuya_ipc_tranfser_init(IN CONST TUYA_IPC_P2P_VAR_T *p_var);
 // OPERATE_RET tuya_ipc_tranfser_quit(VOID);
 // OPERATE_RET tuya_ipc_get_client_conn_info(OUT UINT_T *p_client_num, OUT CLIENT_CONNECT_INFO_T **p_p_conn_info);
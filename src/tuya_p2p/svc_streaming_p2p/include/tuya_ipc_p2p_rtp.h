@@ -0,0 +1,150 @@
+/**
+ * @file tuya_ipc_p2p_rtp.h
+ * @brief RTP packetizer of the p2p media channels
+ *
+ * A packer keeps one RTP encoder alive for its stream and writes the packets
+ * of a media frame back to back into the frame buffer, every packet preceded
+ * by the transport extension header. The whole frame is then handed to the
+ * transport with a single send call. Frame buffers are recycled through a
+ * fixed number of pooled frames, so a steady stream does not allocate.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __TUYA_IPC_P2P_RTP_H__
+#define __TUYA_IPC_P2P_RTP_H__
+
+#include "tuya_cloud_types.h"
+#include "tuya_ipc_p2p_inner.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define TUYA_IPC_P2P_RTP_EXT_MAX_LEN (sizeof(C2C_AV_TRANS_FIXED_HEADER) + 12) ///< head + ext(8) + rtp_len(4)
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef VOID *TUYA_IPC_P2P_RTP_HANDLE;
+
+/**
+ * @brief one packetized media frame
+ */
+typedef struct {
+    INT_T ref;        ///< users still holding the frame, managed by the caller
+    INT_T channel;    ///< transport channel, set by the caller
+    BOOL_T key_frame; ///< video i frame, set by the caller
+    UINT_T media_len; ///< raw frame length
+    UINT_T fix_len;   ///< extension header length in front of every rtp packet
+    UINT_T pkt_num;   ///< number of packets in data
+    UINT_T len;       ///< used bytes of data
+    UINT_T size;      ///< allocated bytes of data
+    UCHAR_T *data;    ///< packets back to back: extension header + rtp
+    VOID *packer;     ///< packer the frame is returned to
+} TUYA_IPC_P2P_RTP_FRAME_T;
+
+/**
+ * @brief packer counters, see tuya_ipc_p2p_rtp_get_stat
+ */
+typedef struct {
+    UINT_T frames;       ///< frames packetized
+    UINT_T packets;      ///< rtp packets written
+    UINT64_T bytes;      ///< packet bytes including the extension headers
+    UINT_T allocs;       ///< heap allocations of frames and frame buffers
+    UINT_T pool_hits;    ///< frames served from the pool
+    UINT_T encoder_init; ///< rtp encoders created, once per codec change
+} TUYA_IPC_P2P_RTP_STAT_T;
+
+/***********************************************************
+********************function declaration********************
+***********************************************************/
+/**
+ * @brief create a packer
+ *
+ * @param[in] ssrc rtp ssrc of the stream
+ * @param[in] pool_num released frames kept for reuse
+ * @param[out] p_handle packer handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ipc_p2p_rtp_create(IN UINT_T ssrc, IN UINT_T pool_num, OUT TUYA_IPC_P2P_RTP_HANDLE *p_handle);
+
+/**
+ * @brief destroy a packer, all its frames have to be freed before
+ *
+ * @param[in] handle packer handle
+ *
+ * @return VOID
+ */
+VOID tuya_ipc_p2p_rtp_destroy(IN TUYA_IPC_P2P_RTP_HANDLE handle);
+
+/**
+ * @brief get an empty frame, from the pool if one is available
+ *
+ * @param[in] handle packer handle
+ * @param[in] media_len raw length of the frame that will be packed
+ *
+ * @return frame, NULL on failure
+ */
+TUYA_IPC_P2P_RTP_FRAME_T *tuya_ipc_p2p_rtp_frame_alloc(IN TUYA_IPC_P2P_RTP_HANDLE handle, IN UINT_T media_len);
+
+/**
+ * @brief return a frame to the pool of its packer
+ *
+ * @param[in] frame frame from tuya_ipc_p2p_rtp_frame_alloc
+ *
+ * @return VOID
+ */
+VOID tuya_ipc_p2p_rtp_frame_free(IN TUYA_IPC_P2P_RTP_FRAME_T *frame);
+
+/**
+ * @brief packetize one media frame
+ *
+ * The rtp encoder is kept between frames and only recreated when the codec
+ * changes, the sequence number continues across the change.
+ *
+ * @param[in] handle packer handle
+ * @param[in] payload rtp payload type
+ * @param[in] codec_name rtp payload name, "H264", "H265", "PCMU"...
+ * @param[in] ext_head extension header put in front of every packet, its last 4 bytes take the rtp length
+ * @param[in] fix_len length of ext_head, at most TUYA_IPC_P2P_RTP_EXT_MAX_LEN
+ * @param[in] data media data, annex-b for video
+ * @param[in] len length of data
+ * @param[in] timestamp rtp timestamp
+ * @param[in,out] frame empty frame that takes the packets
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ipc_p2p_rtp_pack(IN TUYA_IPC_P2P_RTP_HANDLE handle, IN INT_T payload, IN CONST CHAR_T *codec_name,
+                                  IN CONST CHAR_T *ext_head, IN UINT_T fix_len, IN CONST UCHAR_T *data, IN UINT_T len,
+                                  IN UINT_T timestamp, INOUT TUYA_IPC_P2P_RTP_FRAME_T *frame);
+
+/**
+ * @brief write the request id into the extension header of every packet
+ *
+ * @param[in,out] frame packed frame
+ * @param[in] request_id request id of the receiving session
+ *
+ * @return VOID
+ */
+VOID tuya_ipc_p2p_rtp_set_request_id(INOUT TUYA_IPC_P2P_RTP_FRAME_T *frame, IN UINT_T request_id);
+
+/**
+ * @brief get the packer counters
+ *
+ * @param[in] handle packer handle
+ * @param[out] p_stat counters since the packer was created
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ipc_p2p_rtp_get_stat(IN TUYA_IPC_P2P_RTP_HANDLE handle, OUT TUYA_IPC_P2P_RTP_STAT_T *p_stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TUYA_IPC_P2P_RTP_H__ */
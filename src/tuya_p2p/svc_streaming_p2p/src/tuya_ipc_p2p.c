@@ -10,12 +10,13 @@
 #include "tal_system.h"
 #include "tal_memory.h"
 #include "tal_thread.h"
+#include "tal_semaphore.h"
 #include "tuya_ipc_p2p.h"
 #include "tuya_ipc_p2p_error.h"
 #include "tuya_ipc_p2p_inner.h"
 #include "tuya_ipc_p2p_common.h"
 #include "tuya_media_service_rtc.h"
-#include "rtp-payload.h"
+#include "tuya_ipc_p2p_rtp.h"
 
 #define TUYA_CMD_CHANNEL        (0) // Signaling channel, signal mode refer to P2P_CMD_E
 #define TUYA_VDATA_CHANNEL      (1) // Video data channel
@@ -33,6 +34,11 @@
 #define P2P_RECV_TIMEOUT            (30)
 
 #define P2P_CHECK_USER_TIMES (10000) // 10s
+
+#define P2P_SESSION_QUEUE_LEN (16)         // Frames queued per session before dropping
+#define P2P_FRAME_MAX_LEN     (300 * 1024) // Largest media frame accepted
+#define P2P_FRAME_POOL_NUM    (4)          // Released frames kept per channel for reuse
+#define P2P_PULL_POLL_MS      (10)         // Pull retry when the video fps is unknown or audio is on
 // Password synchronization structure
 typedef struct P2P_CMD_PASSWD_ {
     int mark;        // Custom identification mark
@@ -67,19 +73,16 @@ typedef struct P2P_CMD_PARSE_ {
 #define OFFSET(TYPE, MEMBER) ((SIZE_T)(&(((TYPE *)0)->MEMBER)))
 
 #define STACK_SIZE_P2P_MEDIA_SEND 65536
+#define STACK_SIZE_P2P_MEDIA_PULL 65536
 #define STACK_SIZE_P2P_MEDIA_RECV 65536
 #define STACK_SIZE_P2P_CMD_SEND   65536
 #define STACK_SIZE_P2P_CMD_RECV   65536
 #define STACK_SIZE_P2P_DETECT     65536
 #define STACK_SIZE_P2P_LISTEN     131072
 
-typedef struct {
-    INT_T client;
-    INT_T channel;
-    CHAR_T *p_rtp_buff;                         // RTP data buffer, reference size MTU+100
-    INT_T fix_len;                              // Supplementary private header data
-    CHAR_T ext_head_buff[P2P_EXT_HEAD_MAX_LEN]; // According to extended video header protocol head+ext(8)+rtp_len
-} RTP_PACK_NAL_ARG_T;
+// One media frame, packetized once and shared by all sessions that queued it.
+// ref is protected by the context mutex
+typedef TUYA_IPC_P2P_RTP_FRAME_T P2P_FRAME_T;
 
 typedef enum {
     P2P_IDLE = 0,
@@ -99,42 +102,51 @@ typedef struct {
 } P2P_DATA_PARSE_T;
 
 typedef struct {
-    MUTEX_HANDLE cmutex;
-    TUYA_IPC_P2P_AUTH_T str_P2p_auth;
     /*******client*******/
+    INT_T index;   // Slot in the session table
     INT_T session; // Save session number
     INT_T status;  // Session status  0 not started
     /*******p2p server*******/
     P2P_CMD_E cmd; // Signal status information
     P2P_CMD_PARSE_T pb_resp_head;
-    CHAR_T *p_video_rtp_buff; // Video RTP data buffer, reference size MTU+100
-    CHAR_T *p_audio_rtp_buff; // Audio RTP data buffer, reference size MTU+100
-    USHORT_T video_seq_num;   // Video RTP packet sequence number
-    USHORT_T audio_seq_num;   // Audio RTP packet sequence number
-    BOOL_T key_frame;
-    UINT64_T v_pts;                                  // Video PTS
-    UINT64_T v_timestamp;                            // Video absolute time (ms)
-    UINT64_T a_pts;                                  // Audio PTS
-    UINT64_T a_timestamp;                            // Audio absolute time (ms)
     INT_T video_req_id;                              // Video request ID, used for preview, playback and other services
     INT_T audio_req_id;                              // Audio request ID
     TRANSFER_VIDEO_CLARITY_TYPE_INNER_E cur_clarity; // Current video clarity type
     P2P_DATA_PARSE_T proto_parse;
-    TRANS_IPC_AV_INFO_T av_Info; // TODO currently video parameters must be consistent
+    /******* send queue, protected by the context mutex *******/
+    P2P_FRAME_T *queue[P2P_SESSION_QUEUE_LEN];
+    UINT_T q_head;
+    UINT_T q_cnt;
+    BOOL_T wait_key_frame; // Video was dropped, skip P frames until the next I frame
+    TUYA_IPC_P2P_SESSION_STAT_T stat;
+} P2P_SESSION_T;
+
+typedef struct {
+    MUTEX_HANDLE cmutex; // Session status, commands and send queues
+    TUYA_IPC_P2P_AUTH_T str_P2p_auth;
+    INT_T session_num;
+    P2P_SESSION_T *sessions;
+    SEM_HANDLE cmd_sem;                              // Posted when a session starts running
+    SEM_HANDLE send_sem;                             // Posted when a frame is queued
+    SEM_HANDLE pull_sem;                             // Posted when audio/video starts or a frame callback is set
+    TUYA_IPC_P2P_RTP_HANDLE video_packer;            // Video RTP packetizer, kept across frames
+    TUYA_IPC_P2P_RTP_HANDLE audio_packer;            // Audio RTP packetizer, kept across frames
+    TRANSFER_VIDEO_CLARITY_TYPE_INNER_E cur_clarity; // Clarity of the live stream, last set by a session
+    TRANS_IPC_AV_INFO_T av_Info;                     // TODO currently video parameters must be consistent
 
     tuya_p2p_rtc_disconnect_cb_t on_disconnect_callback;
     tuya_p2p_rtc_get_frame_cb_t on_get_video_frame_callback;
     tuya_p2p_rtc_get_frame_cb_t on_get_audio_frame_callback;
     THREAD_HANDLE cmd_recv_proc_thread;   // Command receive thread handle
-    THREAD_HANDLE video_send_proc_thread; // Video send thread handle
+    THREAD_HANDLE video_send_proc_thread; // Media send thread handle
+    THREAD_HANDLE media_pull_proc_thread; // Frame callback thread handle
     // TAL_VENC_FRAME_T tal_video_frame;
     // TAL_AUDIO_FRAME_INFO_T tal_audio_frame;
     MEDIA_FRAME media_frame;
     MEDIA_FRAME media_audio_frame;
-    /******* p2p server*******/
-} P2P_SESSION_T;
+} P2P_CTX_T;
 
-STATIC P2P_SESSION_T *sg_p2p_session = NULL;
+STATIC P2P_CTX_T *sg_p2p_ctx = NULL;
 INT_T g_listen_start = 0;               // Flag variable to control listen thread start or stop
 THREAD_HANDLE g_listen_thrd_hdl = NULL; // Listen thread handle
 
@@ -142,20 +154,12 @@ OPERATE_RET p2p_deal_with_listen(INT_T session);
 OPERATE_RET p2p_get_userinfo(INT_T session, INT_T p2pType);
 IPC_STREAM_TYPE p2p_get_chn_idx(TRANSFER_VIDEO_CLARITY_TYPE_INNER_E cur_clarity);
 TRANSFER_VIDEO_CLARITY_TYPE p2p_clarity_trans(TRANSFER_VIDEO_CLARITY_TYPE_INNER_E type);
-INT_T p2p_prepare_video_send_resource(P2P_SESSION_T *pSession);
-INT_T p2p_release_video_send_resource(P2P_SESSION_T *pSession);
-INT_T p2p_prepare_audio_send_resource(P2P_SESSION_T *pSession);
-INT_T p2p_release_audio_send_resource(P2P_SESSION_T *pSession);
 INT_T __p2p_session_clear(P2P_SESSION_T *pSession);
 INT_T __p2p_session_all_stop(P2P_SESSION_T *pSession);
 INT_T __p2p_session_release_va(P2P_SESSION_T *pSession);
 VOID __p2p_thread_exit(THREAD_HANDLE thread);
 VOID __p2p_rtc_close(INT_T rtc_session, INT_T reason, P2P_SESSION_T* p2p_session);
 
-void *rtp_alloc(void *param, int bytes);
-void rtp_free(void *param, void *packet);
-int rtp_pack_packet_handler(void *param, const void *packet, int bytes, uint32_t timestamp, int flags);
-
 void ctx_listen_thread_func(void *arg)
 {
     printf("listen task start\n");
@@ -206,25 +210,29 @@ OPERATE_RET p2p_rtc_listen_stop()
 
 P2P_SESSION_T *p2p_get_idle_session(INT_T *index)
 {
-    INT_T status = -1;
     INT_T i;
-    if (sg_p2p_session == NULL)
+    if (sg_p2p_ctx == NULL)
         return NULL;
     PR_DEBUG("p2p_get_idle_session begin\n");
-    status = sg_p2p_session->status;
-    if (P2P_SESSION_IDLE == status) {
-        *index = i;
-        sg_p2p_session->status = P2P_SESSION_INITING;
-        return sg_p2p_session;
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
+    for (i = 0; i < sg_p2p_ctx->session_num; i++) {
+        if (P2P_SESSION_IDLE == sg_p2p_ctx->sessions[i].status) {
+            *index = i;
+            sg_p2p_ctx->sessions[i].status = P2P_SESSION_INITING;
+            tal_mutex_unlock(sg_p2p_ctx->cmutex);
+            return &sg_p2p_ctx->sessions[i];
+        }
     }
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
     PR_DEBUG("p2p_get_idle_session end\n");
     return NULL;
 }
 
 OPERATE_RET p2p_deal_with_listen(INT_T session)
 {
-    OPERATE_RET ret = OPRT_OK;
     BOOL_T userCheckEnable = FALSE;
+    P2P_SESSION_T *pSession = NULL;
+    INT_T index = 0;
 
     // First verify user information, close corresponding session if not qualified
     if (OPRT_OK != p2p_get_userinfo(session, 1)) {
@@ -234,7 +242,7 @@ OPERATE_RET p2p_deal_with_listen(INT_T session)
         if (FALSE == userCheckEnable) {
             PR_ERR("resend p2p passwd to service");
             // Resend passwd once
-            if (OPRT_OK == tuya_ipc_p2p_update_pw(sg_p2p_session->str_P2p_auth.p2p_passwd)) {
+            if (OPRT_OK == tuya_ipc_p2p_update_pw(sg_p2p_ctx->str_P2p_auth.p2p_passwd)) {
                 userCheckEnable = TRUE;
             }
         }
@@ -247,20 +255,26 @@ OPERATE_RET p2p_deal_with_listen(INT_T session)
         userCheckEnable = TRUE;
     }
 
-    // Request session-related resources
-    if (OPRT_OK != (ret = p2p_prepare_video_send_resource(sg_p2p_session))) {
-        goto RET;
-    }
-    if (OPRT_OK != (ret = p2p_prepare_audio_send_resource(sg_p2p_session))) {
-        goto RET;
+    pSession = p2p_get_idle_session(&index);
+    if (NULL == pSession) {
+        PR_ERR("no idle session for rtc session[%d]", session);
+        __p2p_rtc_close(session, RTC_CLOSE_REASON_SESSION_FULL, NULL);
+        return OPRT_COM_ERROR;
     }
 
     // Save connection information
-    sg_p2p_session->session = session;
-    sg_p2p_session->status = P2P_SESSION_RUNNING;
-
-RET:
-    return ret;
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
+    pSession->session = session;
+    pSession->status = P2P_SESSION_RUNNING;
+    memset(&pSession->proto_parse, 0x00, sizeof(pSession->proto_parse));
+    pSession->proto_parse.read_size = P2P_CMD_HEAD_LEN;
+    pSession->proto_parse.flag = READ_HEADER_PART;
+    memset(&pSession->stat, 0x00, sizeof(pSession->stat));
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
+    tal_semaphore_post(sg_p2p_ctx->cmd_sem);
+
+    PR_DEBUG("rtc session[%d] running in slot[%d]", session, index);
+    return OPRT_OK;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
@@ -335,11 +349,11 @@ OPERATE_RET p2p_get_userinfo(INT_T session, INT_T p2pType)
     tal_md5_create_init(&md5);
     tal_md5_starts_ret(md5);
     unsigned char decrypt[16];
-    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_session->str_P2p_auth.p2p_passwd),
-                       strlen(sg_p2p_session->str_P2p_auth.p2p_passwd));
+    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_ctx->str_P2p_auth.p2p_passwd),
+                       strlen(sg_p2p_ctx->str_P2p_auth.p2p_passwd));
     tal_md5_update_ret(md5, (BYTE_T *)"||", 2);
-    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_session->str_P2p_auth.gw_local_key),
-                       strlen(sg_p2p_session->str_P2p_auth.gw_local_key));
+    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_ctx->str_P2p_auth.gw_local_key),
+                       strlen(sg_p2p_ctx->str_P2p_auth.gw_local_key));
     tal_md5_finish_ret(md5, decrypt);
     tal_md5_free(md5);
 
@@ -351,7 +365,7 @@ OPERATE_RET p2p_get_userinfo(INT_T session, INT_T p2pType)
     }
     sign[offset] = 0;
 
-    if (strcmp(strUserInfo.user, sg_p2p_session->str_P2p_auth.p2p_name) == 0 && strcmp(strUserInfo.passwd, sign) == 0) {
+    if (strcmp(strUserInfo.user, sg_p2p_ctx->str_P2p_auth.p2p_name) == 0 && strcmp(strUserInfo.passwd, sign) == 0) {
         PR_DEBUG("auth success");
         return OPRT_OK;
     }
@@ -359,8 +373,8 @@ OPERATE_RET p2p_get_userinfo(INT_T session, INT_T p2pType)
     CHAR_T lk_dm5[32 + 1] = {0};
     tal_md5_create_init(&md5);
     tal_md5_starts_ret(md5);
-    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_session->str_P2p_auth.gw_local_key),
-                       strlen(sg_p2p_session->str_P2p_auth.gw_local_key));
+    tal_md5_update_ret(md5, (BYTE_T *)(sg_p2p_ctx->str_P2p_auth.gw_local_key),
+                       strlen(sg_p2p_ctx->str_P2p_auth.gw_local_key));
     tal_md5_finish_ret(md5, decrypt);
     tal_md5_free(md5);
     offset = 0;
@@ -430,113 +444,25 @@ TRANSFER_VIDEO_CLARITY_TYPE p2p_clarity_trans(TRANSFER_VIDEO_CLARITY_TYPE_INNER_
     return eVideoClarityHigh;
 }
 
-INT_T p2p_prepare_video_send_resource(P2P_SESSION_T *pSession)
-{
-    if (pSession == NULL) {
-        PR_DEBUG("session is NULL");
-        return OPRT_INVALID_PARM;
-    }
-
-    if (NULL != pSession->p_video_rtp_buff) {
-        return OPRT_OK;
-    }
-
-    pSession->p_video_rtp_buff = (CHAR_T *)Malloc(P2P_RTP_PACK_LEN);
-    if (NULL == pSession->p_video_rtp_buff) {
-        PR_ERR("session:[%d] video rtp buffer malloc failed", pSession->session);
-        return OPRT_MALLOC_FAILED;
-    }
-    memset(pSession->p_video_rtp_buff, 0x00, P2P_RTP_PACK_LEN);
-
-    PR_DEBUG("session:[%d] malloc video send buffer success", pSession->session);
-    return OPRT_OK;
-}
-
-INT_T p2p_release_video_send_resource(P2P_SESSION_T *pSession)
-{
-    if (pSession == NULL) {
-        PR_DEBUG("session is NULL");
-        return OPRT_INVALID_PARM;
-    }
-
-    if (NULL == pSession->p_video_rtp_buff) {
-        return OPRT_OK;
-    }
-
-    Free(pSession->p_video_rtp_buff);
-    pSession->p_video_rtp_buff = NULL;
-
-    PR_DEBUG("session:[%d] release video send buffer success", pSession->session);
-    return OPRT_OK;
-}
-
-INT_T p2p_prepare_audio_send_resource(P2P_SESSION_T *pSession)
-{
-    if (pSession == NULL) {
-        PR_DEBUG("session is NULL");
-        return OPRT_INVALID_PARM;
-    }
-
-    if (NULL != pSession->p_audio_rtp_buff) {
-        return OPRT_OK;
-    }
-
-    pSession->p_audio_rtp_buff = (CHAR_T *)Malloc(P2P_RTP_PACK_LEN);
-    if (NULL == pSession->p_audio_rtp_buff) {
-        PR_ERR("session:[%d] audio rtp buffer malloc failed", pSession->session);
-        return OPRT_MALLOC_FAILED;
-    }
-    memset(pSession->p_audio_rtp_buff, 0x00, P2P_RTP_PACK_LEN);
-
-    PR_DEBUG("session:[%d] malloc audio send buffer success", pSession->session);
-    return OPRT_OK;
-}
-
-INT_T p2p_release_audio_send_resource(P2P_SESSION_T *pSession)
-{
-    if (pSession == NULL) {
-        PR_DEBUG("session is NULL");
-        return OPRT_INVALID_PARM;
-    }
-
-    if (NULL == pSession->p_audio_rtp_buff) {
-        return OPRT_OK;
-    }
-
-    Free(pSession->p_audio_rtp_buff);
-    pSession->p_audio_rtp_buff = NULL;
-
-    PR_DEBUG("session:[%d] release audio send buffer success", pSession->session);
-    return OPRT_OK;
-}
-
-OPERATE_RET p2p_send_rtp_data(INT_T client, INT_T channel, CHAR_T *buff, INT_T length)
+// Drop one session reference, called with the context mutex held
+STATIC VOID __p2p_frame_put(P2P_FRAME_T *frame)
 {
-    if (channel < TUYA_VDATA_CHANNEL || channel > TUYA_ADATA_CHANNEL) {
-        PR_ERR("input errorclient[%d]channel[%d]", client, channel);
-        return OPRT_INVALID_PARM;
+    frame->ref--;
+    if (frame->ref <= 0) {
+        tuya_ipc_p2p_rtp_frame_free(frame);
     }
-    INT_T ret = 0;
-    // Send data
-    if ((0 == (P2P_VIDEO & sg_p2p_session->cmd)) && (0 == (P2P_PB_VIDEO & sg_p2p_session->cmd)) &&
-        (0 == (P2P_AUDIO & sg_p2p_session->cmd)) && (0 == (P2P_PB_AUDIO & sg_p2p_session->cmd))) {
-        return OPRT_OK;
-    }
-    ret = tuya_p2p_rtc_send_data(sg_p2p_session->session, channel, buff, length, -1);
-    if (ret != length) {
-        PR_ERR("Write data failed [%d][%d]", ret, length);
-    }
-    return OPRT_OK;
+    return;
 }
 
 /***********************************************************
  *  Function: __p2p_ext_protocol_pack
- *  Note:Transport extension protocol packet assembly
- *  Input: client channel number, pResult result buffer, type 0/1 video/audio
- *  Output: pResultLen result buffer size
+ *  Note:Transport extension protocol packet assembly, the request id is filled per session when sending
+ *  Input: type 0/1 video/audio, key_frame video I frame, time_ms frame time
+ *  Output: p_result result buffer, p_result_len result buffer size
  *  Return:
  ***********************************************************/
-STATIC VOID __p2p_ext_protocol_pack(INT_T client, INT_T type, CHAR_T *p_result, INT_T *p_result_len)
+STATIC VOID __p2p_ext_protocol_pack(INT_T type, BOOL_T key_frame, UINT64_T time_ms, CHAR_T *p_result,
+                                    INT_T *p_result_len)
 {
     if (NULL == p_result || NULL == p_result_len) {
         PR_ERR("input error");
@@ -544,54 +470,48 @@ STATIC VOID __p2p_ext_protocol_pack(INT_T client, INT_T type, CHAR_T *p_result,
     }
 
     INT_T fix_len = 0; // 20180428 supplementary header data
-    UINT64_T tmpTime;
-    INT_T ipcChan = client;
-    IPC_STREAM_E curClirtyChn = p2p_get_chn_idx(sg_p2p_session->cur_clarity);
+    IPC_STREAM_E curClirtyChn = p2p_get_chn_idx(sg_p2p_ctx->cur_clarity);
     C2C_AV_TRANS_FIXED_HEADER *pav_Info = (C2C_AV_TRANS_FIXED_HEADER *)p_result;
 
     if (0 == type) {
-        tmpTime = sg_p2p_session->v_timestamp;
-        pav_Info->request_id = sg_p2p_session->video_req_id;
-        if (TRUE == sg_p2p_session->key_frame) {
+        if (TRUE == key_frame) {
             fix_len = sizeof(C2C_AV_TRANS_FIXED_HEADER) + EXT_PROTOCOL_V0_LEN;
             pav_Info->extension_length = 8;
             *(BYTE_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER)] = TY_EXT_VIDEO_PARAM;
             *(BYTE_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 1] = 0;
             *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 2] =
-                (SHORT_T)sg_p2p_session->av_Info.width[curClirtyChn];
+                (SHORT_T)sg_p2p_ctx->av_Info.width[curClirtyChn];
             *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 4] =
-                (SHORT_T)sg_p2p_session->av_Info.height[curClirtyChn];
+                (SHORT_T)sg_p2p_ctx->av_Info.height[curClirtyChn];
             *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 6] =
-                (SHORT_T)sg_p2p_session->av_Info.fps[curClirtyChn];
+                (SHORT_T)sg_p2p_ctx->av_Info.fps[curClirtyChn];
         } else {
             fix_len = sizeof(C2C_AV_TRANS_FIXED_HEADER) + 4;
             pav_Info->extension_length = 0;
         }
     } else {
-        tmpTime = sg_p2p_session->a_timestamp;
-        pav_Info->request_id = sg_p2p_session->audio_req_id;
         fix_len = sizeof(C2C_AV_TRANS_FIXED_HEADER) + EXT_PROTOCOL_V0_LEN;
         pav_Info->extension_length = 8;
         *(BYTE_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER)] = TY_EXT_AUDIO_PARAM;
         *(BYTE_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 1] = 0;
-        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 2] = (SHORT_T)sg_p2p_session->av_Info.audio_sample;
-        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 4] = (SHORT_T)sg_p2p_session->av_Info.audio_channel;
-        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 6] = (SHORT_T)sg_p2p_session->av_Info.audio_databits;
+        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 2] = (SHORT_T)sg_p2p_ctx->av_Info.audio_sample;
+        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 4] = (SHORT_T)sg_p2p_ctx->av_Info.audio_channel;
+        *(SHORT_T *)&p_result[sizeof(C2C_AV_TRANS_FIXED_HEADER) + 6] = (SHORT_T)sg_p2p_ctx->av_Info.audio_databits;
     }
-    pav_Info->time_ms = tmpTime;
+    pav_Info->request_id = 0;
+    pav_Info->time_ms = time_ms;
     *p_result_len = fix_len;
 
     return;
 }
 
-STATIC OPERATE_RET __p2p_check_free_buffer_size(INT_T client, INT_T channel, INT_T len)
+STATIC OPERATE_RET __p2p_check_free_buffer_size(INT_T session, INT_T channel, INT_T len)
 {
     OPERATE_RET ret = OPRT_OK;
     INT_T sendFreeSize = 0;
     INT_T writeSize = 0;
 
-    ret = tuya_p2p_rtc_check_buffer(sg_p2p_session->session, channel, (uint32_t *)&writeSize, NULL,
-                                    (uint32_t *)&sendFreeSize);
+    ret = tuya_p2p_rtc_check_buffer(session, channel, (uint32_t *)&writeSize, NULL, (uint32_t *)&sendFreeSize);
     if (OPRT_OK != ret) {
         return ret;
     }
@@ -602,7 +522,7 @@ STATIC OPERATE_RET __p2p_check_free_buffer_size(INT_T client, INT_T channel, INT
         STATIC INT_T retry_sum = 0; // Total retry count when buffer is full
         if (retry_sum % 100 == 0) {
             PR_ERR("Check_Buffer not enough writeSize[%d] sendFreeSize[%d] len[%d] session[%d] channel[%d]", writeSize,
-                   sendFreeSize, len, sg_p2p_session->session, channel);
+                   sendFreeSize, len, session, channel);
         }
         retry_sum++;
         ret = OPRT_RESOURCE_NOT_READY;
@@ -611,110 +531,49 @@ STATIC OPERATE_RET __p2p_check_free_buffer_size(INT_T client, INT_T channel, INT
 }
 
 /***********************************************************
- *  Function: __p2p_pack_h265_rtp_and_send
- *  Note:IPC stream data assembly RTP and send
- *  Input: pData data header address, len data length, client channel number
+ *  Function: __p2p_frame_pack
+ *  Note:Assemble one media frame into RTP packets stored in the shared frame
+ *  Input: packer channel packetizer, frame shared frame, payload/codec_name RTP payload, p_frame media frame
  *  Output: none
  *  Return:
  ***********************************************************/
-STATIC OPERATE_RET __p2p_pack_h265_rtp_and_send(INT_T client, CHAR_T *pData, INT_T len)
+STATIC OPERATE_RET __p2p_frame_pack(TUYA_IPC_P2P_RTP_HANDLE packer, P2P_FRAME_T *frame, INT_T payload,
+                                    CHAR_T *codec_name, MEDIA_FRAME *p_frame)
 {
-    if (NULL == pData) {
-        PR_ERR("input error");
-        return OPRT_INVALID_PARM;
-    }
+    CHAR_T ext_head_buff[P2P_EXT_HEAD_MAX_LEN] = {0}; // According to extended video header protocol
+    INT_T fix_len = 0;
 
-    OPERATE_RET ret = __p2p_check_free_buffer_size(client, TUYA_VDATA_CHANNEL, len);
-    if (OPRT_OK != ret) {
-        return ret;
-    }
+    __p2p_ext_protocol_pack((TUYA_VDATA_CHANNEL == frame->channel) ? 0 : 1, frame->key_frame, p_frame->timestamp,
+                            ext_head_buff, &fix_len);
 
-    if (NULL == sg_p2p_session->p_video_rtp_buff) {
-        PR_ERR("video rtp buffer is NULL");
-        return OPRT_INVALID_PARM;
-    }
+    UINT_T timestamp = (UINT_T)((p_frame->pts == 0) ? p_frame->timestamp * 1000 : p_frame->pts);
 
-    RTP_PACK_NAL_ARG_T rtp_pack_nal_arg;
-    rtp_pack_nal_arg.client = client;
-    rtp_pack_nal_arg.channel = TUYA_VDATA_CHANNEL;
-    rtp_pack_nal_arg.p_rtp_buff = sg_p2p_session->p_video_rtp_buff;
-    memset(rtp_pack_nal_arg.ext_head_buff, 0, P2P_EXT_HEAD_MAX_LEN);
-    __p2p_ext_protocol_pack(client, 0, rtp_pack_nal_arg.ext_head_buff, &rtp_pack_nal_arg.fix_len);
-
-    void *pRtpDelegate = NULL;
-    struct rtp_payload_t rtp_packer;
-    rtp_packer.alloc = rtp_alloc;
-    rtp_packer.free = rtp_free;
-    rtp_packer.packet = rtp_pack_packet_handler;
-    uint16_t seq = sg_p2p_session->video_seq_num;
-    uint32_t ssrc = 10;
-    uint32_t timestamp = (UINT_T)sg_p2p_session->v_pts;
-    pRtpDelegate = rtp_payload_encode_create(/*H265_PAY_LOAD*/ 95, "H265", seq, ssrc, &rtp_packer, &rtp_pack_nal_arg);
-    ret = rtp_payload_encode_input(pRtpDelegate, pData, len, timestamp);
-    if (OPRT_OK != ret) {
-        PR_ERR("rtp_payload_encode_input h264 error:%d", ret);
-    }
-    rtp_payload_encode_getinfo(pRtpDelegate, &sg_p2p_session->video_seq_num, &timestamp);
-    rtp_payload_encode_destroy(pRtpDelegate);
-
-    return ret;
+    return tuya_ipc_p2p_rtp_pack(packer, payload, codec_name, ext_head_buff, fix_len, p_frame->data, p_frame->size,
+                                 timestamp, frame);
 }
 
 /***********************************************************
- *  Function: __p2p_pack_h264_rtp_and_send
- *  Note:IPC stream data assembly RTP and send
- *  Input: pData data header address, len data length, client channel number
+ *  Function: __p2p_pack_h265_rtp
+ *  Note:IPC stream data assembly RTP
+ *  Input: frame shared frame, p_frame media frame
  *  Output: none
  *  Return:
  ***********************************************************/
-STATIC OPERATE_RET __p2p_pack_h264_rtp_and_send(INT_T client, CHAR_T *pData, INT_T len)
+STATIC OPERATE_RET __p2p_pack_h265_rtp(P2P_FRAME_T *frame, MEDIA_FRAME *p_frame)
 {
-    if (NULL == pData) {
-        PR_ERR("input error");
-        return OPRT_INVALID_PARM;
-    }
-
-    UINT_T max_frame_size = /*tuya_ipc_media_adapter_get_max_frame(0, 0, 0)*/ (300 * 1024);
-    if (len > max_frame_size) {
-        PR_ERR("frame len too big[%d]", len);
-        return OPRT_INVALID_PARM;
-    }
-
-    OPERATE_RET ret;
-    ret = __p2p_check_free_buffer_size(client, TUYA_VDATA_CHANNEL, len);
-    if (OPRT_OK != ret) {
-        return ret;
-    }
-
-    if (NULL == sg_p2p_session->p_video_rtp_buff) {
-        PR_ERR("video rtp buffer is NULL");
-        return OPRT_INVALID_PARM;
-    }
-
-    RTP_PACK_NAL_ARG_T rtp_pack_nal_arg;
-    rtp_pack_nal_arg.client = client;
-    rtp_pack_nal_arg.channel = TUYA_VDATA_CHANNEL;
-    rtp_pack_nal_arg.p_rtp_buff = sg_p2p_session->p_video_rtp_buff;
-    memset(rtp_pack_nal_arg.ext_head_buff, 0, P2P_EXT_HEAD_MAX_LEN);
-    __p2p_ext_protocol_pack(client, 0, rtp_pack_nal_arg.ext_head_buff, &rtp_pack_nal_arg.fix_len);
-
-    void *pRtpDelegate = NULL;
-    struct rtp_payload_t rtp_packer;
-    rtp_packer.alloc = rtp_alloc;
-    rtp_packer.free = rtp_free;
-    rtp_packer.packet = rtp_pack_packet_handler;
-    uint16_t seq = sg_p2p_session->video_seq_num;
-    uint32_t ssrc = 10;
-    uint32_t timestamp = (UINT_T)sg_p2p_session->v_pts;
-    pRtpDelegate = rtp_payload_encode_create(/*H264_PAY_LOAD*/ 96, "H264", seq, ssrc, &rtp_packer, &rtp_pack_nal_arg);
-    ret = rtp_payload_encode_input(pRtpDelegate, pData, len, timestamp);
-    if (OPRT_OK != ret) {
-        PR_ERR("rtp_payload_encode_input h264 error:%d", ret);
-    }
-    rtp_payload_encode_getinfo(pRtpDelegate, &sg_p2p_session->video_seq_num, &timestamp);
-    rtp_payload_encode_destroy(pRtpDelegate);
+    return __p2p_frame_pack(sg_p2p_ctx->video_packer, frame, /*H265_PAY_LOAD*/ 95, "H265", p_frame);
+}
 
-    return ret;
+/***********************************************************
+ *  Function: __p2p_pack_h264_rtp
+ *  Note:IPC stream data assembly RTP
+ *  Input: frame shared frame, p_frame media frame
+ *  Output: none
+ *  Return:
+ ***********************************************************/
+STATIC OPERATE_RET __p2p_pack_h264_rtp(P2P_FRAME_T *frame, MEDIA_FRAME *p_frame)
+{
+    return __p2p_frame_pack(sg_p2p_ctx->video_packer, frame, /*H264_PAY_LOAD*/ 96, "H264", p_frame);
 }
 
 /***********************************************************
@@ -789,50 +648,14 @@ STATIC OPERATE_RET __p2p_pack_h264_rtp_and_send(INT_T client, CHAR_T *pData, INT
 // }
 
 /***********************************************************
- *  Function: __p2p_pack_g711_rtp_and_send
- *  Note:IPC audio data assembly RTP and send
- *  Input: pData data header address, len data length, client channel number, mode g711 mode
+ *  Function: __p2p_pack_g711_rtp
+ *  Note:IPC audio data assembly RTP
+ *  Input: frame shared frame, p_frame media frame, mode g711 mode
  *  Output: none
  *  Return:
  ***********************************************************/
-STATIC OPERATE_RET __p2p_pack_g711_rtp_and_send(INT_T client, CHAR_T *pData, INT_T len, INT_T mode)
+STATIC OPERATE_RET __p2p_pack_g711_rtp(P2P_FRAME_T *frame, MEDIA_FRAME *p_frame, INT_T mode)
 {
-    if (NULL == pData) {
-        PR_ERR("data[%p] client num [%d]", pData, client);
-        return OPRT_INVALID_PARM;
-    }
-
-    if (len > P2P_RTP_PACK_LEN) {
-        PR_ERR("data too big %d", len);
-        return OPRT_INVALID_PARM;
-    }
-
-    OPERATE_RET ret = OPRT_OK;
-    ret = __p2p_check_free_buffer_size(client, TUYA_ADATA_CHANNEL, len);
-    if (OPRT_OK != ret) {
-        return ret;
-    }
-
-    if (NULL == sg_p2p_session->p_audio_rtp_buff) {
-        PR_ERR("audio rtp buffer is NULL");
-        return OPRT_INVALID_PARM;
-    }
-
-    RTP_PACK_NAL_ARG_T rtp_pack_nal_arg;
-    rtp_pack_nal_arg.client = client;
-    rtp_pack_nal_arg.channel = TUYA_ADATA_CHANNEL;
-    rtp_pack_nal_arg.p_rtp_buff = sg_p2p_session->p_audio_rtp_buff;
-    memset(rtp_pack_nal_arg.ext_head_buff, 0, P2P_EXT_HEAD_MAX_LEN);
-    __p2p_ext_protocol_pack(client, 1, rtp_pack_nal_arg.ext_head_buff, &rtp_pack_nal_arg.fix_len);
-
-    void *pRtpDelegate = NULL;
-    struct rtp_payload_t rtp_packer;
-    rtp_packer.alloc = rtp_alloc;
-    rtp_packer.free = rtp_free;
-    rtp_packer.packet = rtp_pack_packet_handler;
-    uint16_t seq = sg_p2p_session->audio_seq_num;
-    uint32_t ssrc = 11;
-    uint32_t timestamp = (UINT_T)sg_p2p_session->a_pts;
     int payload = 0;
     char *codec_name = NULL;
     if (TY_AV_CODEC_AUDIO_G711U == mode) {
@@ -845,15 +668,197 @@ STATIC OPERATE_RET __p2p_pack_g711_rtp_and_send(INT_T client, CHAR_T *pData, INT
         codec_name = "PCM";
         payload = 99 /*RTP_PCM_PAYLOAD*/;
     }
-    pRtpDelegate = rtp_payload_encode_create(payload, codec_name, seq, ssrc, &rtp_packer, &rtp_pack_nal_arg);
-    ret = rtp_payload_encode_input(pRtpDelegate, pData, len, timestamp);
+
+    return __p2p_frame_pack(sg_p2p_ctx->audio_packer, frame, payload, codec_name, p_frame);
+}
+
+/***********************************************************
+ *  Function: __p2p_session_want_frame
+ *  Note:Whether a session takes frames of a channel, called with the context mutex held
+ *  Input: pSession session, channel TUYA_VDATA_CHANNEL/TUYA_ADATA_CHANNEL, key_frame video I frame
+ *  Output: none
+ *  Return: TRUE if the frame is queued to the session
+ ***********************************************************/
+STATIC BOOL_T __p2p_session_want_frame(P2P_SESSION_T *pSession, INT_T channel, BOOL_T key_frame)
+{
+    if (P2P_SESSION_RUNNING != pSession->status) {
+        return FALSE;
+    }
+    if (TUYA_ADATA_CHANNEL == channel) {
+        return (P2P_AUDIO & pSession->cmd) ? TRUE : FALSE;
+    }
+    if (!(P2P_VIDEO & pSession->cmd)) {
+        return FALSE;
+    }
+    // A viewer that missed video can only decode again from the next I frame
+    if (pSession->wait_key_frame && !key_frame) {
+        pSession->stat.drop_wait_key++;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// Release all queued frames, called with the context mutex held
+STATIC VOID __p2p_session_queue_flush(P2P_SESSION_T *pSession)
+{
+    while (pSession->q_cnt > 0) {
+        __p2p_frame_put(pSession->queue[pSession->q_head]);
+        pSession->queue[pSession->q_head] = NULL;
+        pSession->q_head = (pSession->q_head + 1) % P2P_SESSION_QUEUE_LEN;
+        pSession->q_cnt--;
+    }
+    pSession->stat.queue_depth = 0;
+    return;
+}
+
+// Queue a frame to a session, called with the context mutex held
+STATIC VOID __p2p_session_enqueue(P2P_SESSION_T *pSession, P2P_FRAME_T *frame)
+{
+    BOOL_T is_video = (TUYA_VDATA_CHANNEL == frame->channel);
+
+    if (P2P_SESSION_QUEUE_LEN == pSession->q_cnt) {
+        if (!(is_video && frame->key_frame)) {
+            pSession->stat.drop_queue++;
+            if (is_video) {
+                pSession->wait_key_frame = TRUE;
+            }
+            return;
+        }
+        // The stream restarts at an I frame, everything still queued is stale
+        pSession->stat.drop_queue += pSession->q_cnt;
+        __p2p_session_queue_flush(pSession);
+    }
+    if (is_video && frame->key_frame) {
+        pSession->wait_key_frame = FALSE;
+    }
+
+    frame->ref++;
+    pSession->queue[(pSession->q_head + pSession->q_cnt) % P2P_SESSION_QUEUE_LEN] = frame;
+    pSession->q_cnt++;
+    pSession->stat.queue_depth = pSession->q_cnt;
+    if (pSession->stat.queue_max < pSession->q_cnt) {
+        pSession->stat.queue_max = pSession->q_cnt;
+    }
+    return;
+}
+
+/***********************************************************
+ *  Function: __p2p_push_frame
+ *  Note:Packetize a frame once and queue it to every session that takes it
+ *  Input: channel TUYA_VDATA_CHANNEL/TUYA_ADATA_CHANNEL, p_frame media frame
+ *  Output: none
+ *  Return:
+ ***********************************************************/
+STATIC OPERATE_RET __p2p_push_frame(INT_T channel, MEDIA_FRAME *p_frame)
+{
+    OPERATE_RET ret = OPRT_OK;
+    P2P_FRAME_T *frame = NULL;
+    UINT_T mask = 0;
+    INT_T i = 0;
+
+    if (NULL == sg_p2p_ctx || NULL == p_frame || NULL == p_frame->data) {
+        PR_ERR("input error");
+        return OPRT_INVALID_PARM;
+    }
+    if (p_frame->size > ((TUYA_VDATA_CHANNEL == channel) ? P2P_FRAME_MAX_LEN : P2P_RTP_PACK_LEN)) {
+        PR_ERR("frame len too big[%d]", p_frame->size);
+        return OPRT_INVALID_PARM;
+    }
+
+    BOOL_T key_frame = (TUYA_VDATA_CHANNEL == channel) && (eVideoIFrame == p_frame->type);
+
+    // Nothing is packetized while no session takes the frame
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
+    for (i = 0; i < sg_p2p_ctx->session_num; i++) {
+        if (__p2p_session_want_frame(&sg_p2p_ctx->sessions[i], channel, key_frame)) {
+            mask |= (1U << i);
+        }
+    }
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
+    if (0 == mask) {
+        return OPRT_OK;
+    }
+
+    frame = tuya_ipc_p2p_rtp_frame_alloc(
+        (TUYA_VDATA_CHANNEL == channel) ? sg_p2p_ctx->video_packer : sg_p2p_ctx->audio_packer, p_frame->size);
+    if (NULL == frame) {
+        PR_ERR("frame malloc failed len[%d]", p_frame->size);
+        return OPRT_MALLOC_FAILED;
+    }
+    frame->channel = channel;
+    frame->key_frame = key_frame;
+
+    if (TUYA_VDATA_CHANNEL == channel) {
+        if (TY_AV_CODEC_VIDEO_H265 != sg_p2p_ctx->av_Info.video_codec[0]) {
+            ret = __p2p_pack_h264_rtp(frame, p_frame);
+        } else {
+            ret = __p2p_pack_h265_rtp(frame, p_frame);
+        }
+    } else {
+        TY_AV_CODEC_ID type = sg_p2p_ctx->av_Info.audio_codec;
+        if (TY_AV_CODEC_AUDIO_G711A == type || TY_AV_CODEC_AUDIO_G711U == type || TY_AV_CODEC_AUDIO_PCM == type) {
+            ret = __p2p_pack_g711_rtp(frame, p_frame, type);
+        } else {
+            // TY_AV_CODEC_AUDIO_AAC_ADTS, see __p2p_pack_aac_rtp_and_send
+            ret = OPRT_NOT_SUPPORTED;
+        }
+    }
     if (OPRT_OK != ret) {
-        PR_ERR("rtp_payload_encode_input h264 error:%d", ret);
+        tuya_ipc_p2p_rtp_frame_free(frame);
+        return ret;
     }
-    rtp_payload_encode_getinfo(pRtpDelegate, &sg_p2p_session->audio_seq_num, &timestamp);
-    rtp_payload_encode_destroy(pRtpDelegate);
 
-    return ret;
+    // Sessions that stopped meanwhile are skipped, the frame is freed if nobody took it
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
+    for (i = 0; i < sg_p2p_ctx->session_num; i++) {
+        P2P_SESSION_T *pSession = &sg_p2p_ctx->sessions[i];
+        if ((mask & (1U << i)) && P2P_SESSION_RUNNING == pSession->status &&
+            (pSession->cmd & ((TUYA_VDATA_CHANNEL == channel) ? P2P_VIDEO : P2P_AUDIO))) {
+            __p2p_session_enqueue(pSession, frame);
+        }
+    }
+    if (0 == frame->ref) {
+        tuya_ipc_p2p_rtp_frame_free(frame);
+        frame = NULL;
+    }
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
+
+    if (NULL != frame) {
+        tal_semaphore_post(sg_p2p_ctx->send_sem);
+    }
+
+    return OPRT_OK;
+}
+
+/***********************************************************
+ *  Function: __p2p_session_send_frame
+ *  Note:Send the packets of a shared frame to one session
+ *  Input: session rtc session, req_id request id of the session, frame shared frame
+ *  Output: none
+ *  Return:
+ ***********************************************************/
+STATIC OPERATE_RET __p2p_session_send_frame(INT_T session, INT_T req_id, P2P_FRAME_T *frame)
+{
+    OPERATE_RET ret = OPRT_OK;
+    INT_T len = 0;
+
+    ret = __p2p_check_free_buffer_size(session, frame->channel, frame->media_len);
+    if (OPRT_OK != ret) {
+        return ret;
+    }
+
+    // Only the send thread touches queued packets, so the request id can be patched in place
+    tuya_ipc_p2p_rtp_set_request_id(frame, req_id);
+    // The channel is a byte stream, all packets of the frame go out in one call
+    len = tuya_p2p_rtc_send_data(session, frame->channel, (CHAR_T *)frame->data, frame->len, -1);
+    if (len != frame->len) {
+        // A partial frame leaves the receiver mid packet, the caller drops it and waits for an I frame
+        PR_ERR("Write data failed [%d][%d]", len, frame->len);
+        return OPRT_SEND_ERR;
+    }
+
+    return OPRT_OK;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -870,19 +875,60 @@ OPERATE_RET tuya_ipc_p2p_set_limit_mode(BOOL_T islimit)
 
 OPERATE_RET tuya_ipc_init_trans_av_info(TRANS_IPC_AV_INFO_T *av_info)
 {
-    memcpy(&sg_p2p_session->av_Info, av_info, sizeof(TRANS_IPC_AV_INFO_T));
+    memcpy(&sg_p2p_ctx->av_Info, av_info, sizeof(TRANS_IPC_AV_INFO_T));
     return OPRT_OK;
 }
 
 OPERATE_RET tuya_p2p_rtc_register_get_video_frame_cb(tuya_p2p_rtc_get_frame_cb_t pCallback)
 {
-    sg_p2p_session->on_get_video_frame_callback = pCallback;
+    sg_p2p_ctx->on_get_video_frame_callback = pCallback;
+    tal_semaphore_post(sg_p2p_ctx->pull_sem);
     return OPRT_OK;
 }
 
 OPERATE_RET tuya_p2p_rtc_register_get_audio_frame_cb(tuya_p2p_rtc_get_frame_cb_t pCallback)
 {
-    sg_p2p_session->on_get_audio_frame_callback = pCallback;
+    sg_p2p_ctx->on_get_audio_frame_callback = pCallback;
+    tal_semaphore_post(sg_p2p_ctx->pull_sem);
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ipc_p2p_notify_frame_ready(VOID)
+{
+    if (NULL == sg_p2p_ctx || NULL == sg_p2p_ctx->pull_sem) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
+    return tal_semaphore_post(sg_p2p_ctx->pull_sem);
+}
+
+OPERATE_RET tuya_ipc_p2p_push_video_frame(IN MEDIA_FRAME *p_frame)
+{
+    return __p2p_push_frame(TUYA_VDATA_CHANNEL, p_frame);
+}
+
+OPERATE_RET tuya_ipc_p2p_push_audio_frame(IN MEDIA_FRAME *p_frame)
+{
+    return __p2p_push_frame(TUYA_ADATA_CHANNEL, p_frame);
+}
+
+INT_T tuya_ipc_p2p_get_session_num(VOID)
+{
+    return (NULL == sg_p2p_ctx) ? 0 : sg_p2p_ctx->session_num;
+}
+
+OPERATE_RET tuya_ipc_p2p_get_session_stat(IN INT_T index, OUT TUYA_IPC_P2P_SESSION_STAT_T *p_stat)
+{
+    if (NULL == sg_p2p_ctx || NULL == p_stat || index < 0 || index >= sg_p2p_ctx->session_num) {
+        return OPRT_INVALID_PARM;
+    }
+
+    P2P_SESSION_T *pSession = &sg_p2p_ctx->sessions[index];
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
+    memcpy(p_stat, &pSession->stat, sizeof(TUYA_IPC_P2P_SESSION_STAT_T));
+    p_stat->session = (P2P_SESSION_IDLE == pSession->status) ? -1 : pSession->session;
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
+
     return OPRT_OK;
 }
 
@@ -901,9 +947,12 @@ STATIC INT_T __p2p_session_trans_video_start(P2P_SESSION_T *pSession)
         PR_ERR("param error or video started");
         return OPRT_INVALID_PARM;
     }
-    // Wait for previous data transmission to end
-    PR_DEBUG("session[%d]video video_start wait_concurr_idle", pSession->session);
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
     pSession->cmd |= P2P_VIDEO;
+    // Nothing can be decoded before an I frame
+    pSession->wait_key_frame = TRUE;
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
+    tal_semaphore_post(sg_p2p_ctx->pull_sem);
     PR_DEBUG("session[%d] video start success", pSession->session);
     return OPRT_OK;
 }
@@ -921,7 +970,9 @@ STATIC INT_T __p2p_session_trans_video_stop(P2P_SESSION_T *pSession)
         PR_ERR("param error or session cmd[%d]", pSession->cmd);
         return OPRT_INVALID_PARM;
     }
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
     pSession->cmd &= ~P2P_VIDEO;
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
     PR_DEBUG("session[%d] video stop success", pSession->session);
     return OPRT_OK;
 }
@@ -941,7 +992,10 @@ STATIC INT_T __p2p_session_trans_audio_start(P2P_SESSION_T *pSession)
     }
 
     PR_DEBUG("session[%d] send audio start to dev", pSession->session);
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
     pSession->cmd |= P2P_AUDIO;
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
+    tal_semaphore_post(sg_p2p_ctx->pull_sem);
     PR_DEBUG("session:[%d] audio start success", pSession->session);
     return OPRT_OK;
 }
@@ -959,7 +1013,9 @@ STATIC INT_T __p2p_session_trans_audio_stop(P2P_SESSION_T *pSession)
         PR_ERR("param error or audio not start");
         return OPRT_INVALID_PARM;
     }
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
     pSession->cmd &= ~P2P_AUDIO;
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
     PR_DEBUG("session:[%d] audio stop success", pSession->session);
     return OPRT_OK;
 }
@@ -1107,6 +1163,7 @@ STATIC INT_T __p2p_session_cmd_parse_server(P2P_SESSION_T *pSession, VOID *pData
             if (0 != parm->channel) {
                 PR_DEBUG("session [%d] recv chn[%d]", pSession->session, parm->channel);
                 pSession->cur_clarity = parm->channel;
+                sg_p2p_ctx->cur_clarity = parm->channel;
             }
             if (OPRT_OK != __p2p_session_trans_video_start(pSession)) {
                 PR_ERR("CTRL VIDEO START failed");
@@ -1293,37 +1350,33 @@ STATIC INT_T __p2p_read_cmd(P2P_SESSION_T *pSession)
 STATIC void __p2p_cmd_recv_proc(PVOID_T pArg)
 {
     P2P_SESSION_T *pSession = NULL;
-    INT_T ret;
-
-    memset(&sg_p2p_session->proto_parse, 0x00, sizeof(sg_p2p_session->proto_parse));
-    sg_p2p_session->proto_parse.read_size = P2P_CMD_HEAD_LEN;
-    sg_p2p_session->proto_parse.flag = READ_HEADER_PART;
-    while (tal_thread_get_state(sg_p2p_session->cmd_recv_proc_thread) == THREAD_STATE_RUNNING) {
-        if (P2P_SESSION_IDLE == sg_p2p_session->status) {
-            tal_system_sleep(5);
-            continue;
-        }
-        pSession = sg_p2p_session;
-        tal_mutex_lock(pSession->cmutex);
-        if (P2P_SESSION_CLOSING == pSession->status) {
-            tal_mutex_unlock(pSession->cmutex);
-            tal_system_sleep(5);
-            continue;
-        }
-        if (P2P_SESSION_RUNNING != pSession->status) {
-            tal_mutex_unlock(pSession->cmutex);
-            continue;
+    INT_T ret, i, status, running;
+
+    while (tal_thread_get_state(sg_p2p_ctx->cmd_recv_proc_thread) == THREAD_STATE_RUNNING) {
+        running = 0;
+        for (i = 0; i < sg_p2p_ctx->session_num; i++) {
+            pSession = &sg_p2p_ctx->sessions[i];
+            tal_mutex_lock(sg_p2p_ctx->cmutex);
+            status = pSession->status;
+            tal_mutex_unlock(sg_p2p_ctx->cmutex);
+            if (P2P_SESSION_RUNNING != status) {
+                continue;
+            }
+            running++;
+
+            ret = __p2p_read_cmd(pSession);
+            if (0 != ret) {
+                PR_ERR("session[%d] read cmd failed [%d]", pSession->session, ret);
+                __p2p_session_clear(pSession);
+                //__p2p_wait_concurr_idle(pSession, WAIT_ALL_BUF);
+                __p2p_session_release_va(pSession);
+                tuya_p2p_rtc_notify_exit();
+            }
         }
-        tal_mutex_unlock(pSession->cmutex);
-
-        ret = __p2p_read_cmd(pSession);
-        if (0 != ret) {
-            PR_ERR("session[%d] read cmd failed [%d]", pSession->session, ret);
-            __p2p_session_clear(pSession);
-            //__p2p_wait_concurr_idle(pSession, WAIT_ALL_BUF);
-            __p2p_session_release_va(pSession);
-            tuya_p2p_rtc_notify_exit();
-            printf("pSession->cmd: %d\n", sg_p2p_session->cmd);
+
+        if (0 == running) {
+            // Sleep until p2p_deal_with_listen hands over a session
+            tal_semaphore_wait_forever(sg_p2p_ctx->cmd_sem);
         }
     }
 
@@ -1333,111 +1386,146 @@ STATIC void __p2p_cmd_recv_proc(PVOID_T pArg)
 }
 
 /***********************************************************
- *  Function: __p2p_video_send_proc
- *  Note:Video data transmission thread
+ *  Function: __p2p_media_send_proc
+ *  Note:Media data transmission thread, woken by __p2p_push_frame
  *  Input:
  *  Output: none
  *  Return:
  ***********************************************************/
 STATIC void __p2p_media_send_proc(PVOID_T pArg)
 {
-    INT_T index = 0;
-    UINT_T runCnt = 0;
     P2P_SESSION_T *pSession = NULL;
-    OPERATE_RET op_ret = -1;
-    TY_AV_CODEC_ID type;
-    type = sg_p2p_session->av_Info.audio_codec;
-    // type = TY_AV_CODEC_AUDIO_PCM;
+    P2P_FRAME_T *frame = NULL;
+    OPERATE_RET op_ret = OPRT_OK;
+    BOOL_T busy = FALSE;
+    INT_T session, req_id, i;
+
+    PR_DEBUG("into p2p media send");
+
+    while (tal_thread_get_state(sg_p2p_ctx->video_send_proc_thread) == THREAD_STATE_RUNNING) {
+        tal_semaphore_wait_forever(sg_p2p_ctx->send_sem);
+
+        // One frame per session and round, so a slow viewer does not hold back the others
+        do {
+            busy = FALSE;
+            for (i = 0; i < sg_p2p_ctx->session_num; i++) {
+                pSession = &sg_p2p_ctx->sessions[i];
+                tal_mutex_lock(sg_p2p_ctx->cmutex);
+                if (0 == pSession->q_cnt) {
+                    tal_mutex_unlock(sg_p2p_ctx->cmutex);
+                    continue;
+                }
+                frame = pSession->queue[pSession->q_head];
+                pSession->queue[pSession->q_head] = NULL;
+                pSession->q_head = (pSession->q_head + 1) % P2P_SESSION_QUEUE_LEN;
+                pSession->q_cnt--;
+                pSession->stat.queue_depth = pSession->q_cnt;
+                session = pSession->session;
+                if (TUYA_VDATA_CHANNEL == frame->channel) {
+                    req_id = (P2P_VIDEO & pSession->cmd) ? pSession->video_req_id : -1;
+                } else {
+                    req_id = (P2P_AUDIO & pSession->cmd) ? pSession->audio_req_id : -1;
+                }
+                tal_mutex_unlock(sg_p2p_ctx->cmutex);
+                busy = TRUE;
 
-    PR_DEBUG("into p2p video send");
+                // The queue reference keeps the frame alive while it is sent
+                op_ret = (-1 == req_id) ? OPRT_OK : __p2p_session_send_frame(session, req_id, frame);
 
-    while (tal_thread_get_state(sg_p2p_session->video_send_proc_thread) == THREAD_STATE_RUNNING) {
-        if (runCnt % 2000 == 0) {
-            PR_DEBUG("media send proc alive [%d]", runCnt);
-        }
-        runCnt++;
+                tal_mutex_lock(sg_p2p_ctx->cmutex);
+                if (-1 == req_id) {
+                    // Stopped while the frame was queued
+                } else if (OPRT_OK == op_ret) {
+                    pSession->stat.sent_frames++;
+                } else {
+                    pSession->stat.drop_send++;
+                    if (TUYA_VDATA_CHANNEL == frame->channel) {
+                        pSession->wait_key_frame = TRUE;
+                    }
+                }
+                __p2p_frame_put(frame);
+                tal_mutex_unlock(sg_p2p_ctx->cmutex);
+            }
+        } while (busy);
+    }
 
-        if (P2P_SESSION_IDLE == sg_p2p_session->status) {
-            tal_system_sleep(5);
-            continue;
-        }
+    PR_ERR("media send task exit");
+    return;
+}
+
+/***********************************************************
+ *  Function: __p2p_pull_interval
+ *  Note:Time to wait before the frame callbacks are asked again
+ *  Input: audio audio is pulled as well
+ *  Output: none
+ *  Return: wait time in ms
+ ***********************************************************/
+STATIC UINT_T __p2p_pull_interval(BOOL_T audio)
+{
+    UINT_T fps = sg_p2p_ctx->av_Info.fps[TUYA_IPC_P2P_DEFAULT_CAMERA];
 
-        pSession = sg_p2p_session;
-        tal_mutex_lock(pSession->cmutex);
-        INT_T status = pSession->status;
-        P2P_CMD_E cmd = pSession->cmd;
+    if (audio || 0 == fps || fps > 1000 / P2P_PULL_POLL_MS) {
+        return P2P_PULL_POLL_MS;
+    }
 
-        if (P2P_SESSION_CLOSING == pSession->status) {
-            tal_mutex_unlock(pSession->cmutex);
-            tal_system_sleep(5);
-            continue;
-        }
-        if (P2P_SESSION_RUNNING != status) {
-            tal_mutex_unlock(pSession->cmutex);
-            continue;
+    return 1000 / fps;
+}
+
+/***********************************************************
+ *  Function: __p2p_media_pull_proc
+ *  Note:Pull frames from the registered frame callbacks and push them to the sessions
+ *  Input:
+ *  Output: none
+ *  Return:
+ ***********************************************************/
+STATIC void __p2p_media_pull_proc(PVOID_T pArg)
+{
+    P2P_CMD_E cmd = P2P_IDLE;
+    BOOL_T got = FALSE;
+    INT_T i;
+
+    PR_DEBUG("into p2p media pull");
+
+    while (tal_thread_get_state(sg_p2p_ctx->media_pull_proc_thread) == THREAD_STATE_RUNNING) {
+        cmd = P2P_IDLE;
+        tal_mutex_lock(sg_p2p_ctx->cmutex);
+        for (i = 0; i < sg_p2p_ctx->session_num; i++) {
+            if (P2P_SESSION_RUNNING == sg_p2p_ctx->sessions[i].status) {
+                cmd |= sg_p2p_ctx->sessions[i].cmd;
+            }
         }
+        tal_mutex_unlock(sg_p2p_ctx->cmutex);
 
-        // The judgment when both are not opened should be placed at the end, otherwise it will appear: users close
-        // audio and video at the same time, but do not release resources This judgment cannot be omitted, otherwise
-        // thread idle running will occur
-        if (!(P2P_VIDEO & cmd) && !(P2P_AUDIO & cmd)) {
-            // pSession->p2p_buff_stat.live_video = P2P_BUFF_IDLE;
-            // pSession->p2p_buff_stat.live_audio = P2P_BUFF_IDLE;
-            tal_mutex_unlock(pSession->cmutex);
-            tal_system_sleep(5);
+        BOOL_T video = (P2P_VIDEO & cmd) && (NULL != sg_p2p_ctx->on_get_video_frame_callback);
+        BOOL_T audio = (P2P_AUDIO & cmd) && (NULL != sg_p2p_ctx->on_get_audio_frame_callback);
+        if (!video && !audio) {
+            // Nobody is watching or frames are pushed with tuya_ipc_p2p_push_video/audio_frame
+            tal_semaphore_wait_forever(sg_p2p_ctx->pull_sem);
             continue;
         }
-        tal_mutex_unlock(pSession->cmutex);
 
-        if (P2P_VIDEO & cmd) {
-            if (sg_p2p_session->on_get_video_frame_callback == NULL) {
-                tal_system_sleep(10);
-                continue;
-            }
-            MEDIA_FRAME *pMediaFrame = &sg_p2p_session->media_frame;
-            op_ret = sg_p2p_session->on_get_video_frame_callback(pMediaFrame); // OnGetVideoFrameCallback(pMediaFrame)
-            if (op_ret == OPRT_OK) {
-                pSession->v_pts = (pMediaFrame->pts == 0) ? pMediaFrame->timestamp * 1000 : pMediaFrame->pts;
-                pSession->v_timestamp = pMediaFrame->timestamp;
-                if (eVideoIFrame == pMediaFrame->type) {
-                    pSession->key_frame = TRUE;
-                } else {
-                    pSession->key_frame = FALSE;
-                }
-                if (TY_AV_CODEC_VIDEO_H265 != sg_p2p_session->av_Info.video_codec[0]) {
-                    op_ret = __p2p_pack_h264_rtp_and_send(index, (CHAR_T *)pMediaFrame->data, pMediaFrame->size);
-                } else {
-                    op_ret = __p2p_pack_h265_rtp_and_send(index, (CHAR_T *)pMediaFrame->data, pMediaFrame->size);
-                }
-            } else {
-                // Buffer has no data yet
-                tal_system_sleep(10);
+        got = FALSE;
+        if (video) {
+            MEDIA_FRAME *pMediaFrame = &sg_p2p_ctx->media_frame;
+            if (OPRT_OK == sg_p2p_ctx->on_get_video_frame_callback(pMediaFrame)) {
+                __p2p_push_frame(TUYA_VDATA_CHANNEL, pMediaFrame);
+                got = TRUE;
             }
         }
-        if (P2P_AUDIO & cmd) {
-            if (sg_p2p_session->on_get_audio_frame_callback == NULL) {
-                tal_system_sleep(10);
-                continue;
-            }
-            MEDIA_FRAME *pMediaFrame = &sg_p2p_session->media_audio_frame;
-            op_ret = sg_p2p_session->on_get_audio_frame_callback(pMediaFrame); // OnGetAudioFrameCallback(pMediaFrame)
-            if (op_ret == OPRT_OK) {
-                pSession->a_pts = (pMediaFrame->pts == 0) ? pMediaFrame->timestamp * 1000 : pMediaFrame->pts;
-                pSession->a_timestamp = pMediaFrame->timestamp;
-                if (TY_AV_CODEC_AUDIO_AAC_ADTS == type) {
-                    // op_ret = __p2p_pack_aac_rtp_and_send((CHAR_T *)node_a.data, node_a.size,index);
-                } else if (TY_AV_CODEC_AUDIO_G711A == type || TY_AV_CODEC_AUDIO_G711U == type ||
-                           TY_AV_CODEC_AUDIO_PCM == type) {
-                    op_ret = __p2p_pack_g711_rtp_and_send(index, (CHAR_T *)pMediaFrame->data, pMediaFrame->size, type);
-                }
-            } else {
-                // Buffer has no data yet
-                tal_system_sleep(10);
+        if (audio) {
+            MEDIA_FRAME *pMediaFrame = &sg_p2p_ctx->media_audio_frame;
+            if (OPRT_OK == sg_p2p_ctx->on_get_audio_frame_callback(pMediaFrame)) {
+                __p2p_push_frame(TUYA_ADATA_CHANNEL, pMediaFrame);
+                got = TRUE;
             }
         }
+        if (!got) {
+            // Ask again after a frame interval, tuya_ipc_p2p_notify_frame_ready wakes up earlier
+            tal_semaphore_wait(sg_p2p_ctx->pull_sem, __p2p_pull_interval(audio));
+        }
     } // while
 
-    PR_ERR("video send task exit");
+    PR_ERR("media pull task exit");
     return;
 }
 
@@ -1456,12 +1544,11 @@ INT_T __p2p_session_clear(P2P_SESSION_T *pSession)
  ***********************************************************/
 INT_T __p2p_session_all_stop(P2P_SESSION_T *pSession)
 {
-    tal_mutex_lock(pSession->cmutex);
     if (NULL == pSession) {
         PR_ERR("param error");
-        tal_mutex_unlock(pSession->cmutex);
         return OPRT_INVALID_PARM;
     }
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
     if (P2P_VIDEO & pSession->cmd) {
         pSession->cmd &= ~P2P_VIDEO;
     }
@@ -1471,7 +1558,7 @@ INT_T __p2p_session_all_stop(P2P_SESSION_T *pSession)
     if ((P2P_PB_VIDEO & pSession->cmd) || (P2P_PB_PAUSE & pSession->cmd)) {
         pSession->cmd &= ~P2P_PB_VIDEO;
     }
-    tal_mutex_unlock(pSession->cmutex);
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
     return OPRT_OK;
 }
 
@@ -1479,72 +1566,107 @@ INT_T __p2p_session_release_va(P2P_SESSION_T *pSession)
 {
     // All functions closed
     PR_DEBUG("release va session[%d]", pSession->session);
-    tal_mutex_lock(pSession->cmutex);
-    if (pSession->p_video_rtp_buff) {
-        Free(pSession->p_video_rtp_buff);
-        pSession->p_video_rtp_buff = NULL;
-    }
-    if (pSession->p_audio_rtp_buff) {
-        Free(pSession->p_audio_rtp_buff);
-        pSession->p_audio_rtp_buff = NULL;
-    }
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
+    __p2p_session_queue_flush(pSession);
+    pSession->q_head = 0;
+    pSession->wait_key_frame = FALSE;
     // memset(&pSession->session, 0x00, sizeof(P2P_SESSION_T) - OFFSET(P2P_SESSION_T, session));//Clear variables
     // outside the lock memset(&pSession->str_P2p_auth, 0, sizeof(pSession->str_P2p_auth));
     pSession->cur_clarity = TY_VIDEO_CLARITY_INNER_HIGH;
     pSession->status = P2P_SESSION_IDLE;
     pSession->cmd = P2P_IDLE;
     memset(&pSession->pb_resp_head, 0, sizeof(pSession->pb_resp_head));
-    pSession->video_seq_num = 0;
-    pSession->audio_seq_num = 0;
-    pSession->key_frame = false;
-    pSession->v_pts = 0;
-    pSession->v_timestamp = 0;
-    pSession->a_pts = 0;
-    pSession->a_timestamp = 0;
     pSession->video_req_id = 0;
     pSession->audio_req_id = 0;
-    // if (pSession->media_frame.data != NULL) {
-    //     free(pSession->media_frame.data);
-    //     pSession->media_frame.data = NULL;
-    // }
-    // memset(&pSession->media_frame, 0, sizeof(pSession->media_frame));
-    // if (pSession->media_audio_frame.data != NULL) {
-    //     free(pSession->media_audio_frame.data);
-    //     pSession->media_audio_frame.data = NULL;
-    // }
-    // memset(&pSession->media_audio_frame, 0, sizeof(pSession->media_audio_frame));
     memset(&pSession->proto_parse, 0, sizeof(pSession->proto_parse));
-    memset(&pSession->av_Info, 0, sizeof(pSession->av_Info));
-    if (pSession->on_disconnect_callback)
-        pSession->on_disconnect_callback(); // Notify upper layer when receiving disconnect signal from cloud
-    tal_mutex_unlock(pSession->cmutex);
+    if (sg_p2p_ctx->on_disconnect_callback)
+        sg_p2p_ctx->on_disconnect_callback(); // Notify upper layer when receiving disconnect signal from cloud
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
     return 0;
 }
 
 OPERATE_RET p2p_init(IN CONST TUYA_IPC_P2P_VAR_T *p_var)
 {
     OPERATE_RET ret = OPRT_OK;
+    INT_T i;
 
     // Initialize session information
-    sg_p2p_session = (P2P_SESSION_T *)Malloc(sizeof(P2P_SESSION_T));
-    if (NULL == sg_p2p_session) {
-        PR_ERR("malloc p2p session failed");
+    sg_p2p_ctx = (P2P_CTX_T *)Malloc(sizeof(P2P_CTX_T));
+    if (NULL == sg_p2p_ctx) {
+        PR_ERR("malloc p2p ctx failed");
         return OPRT_MALLOC_FAILED;
     }
-    memset(sg_p2p_session, 0, sizeof(P2P_SESSION_T));
-    tal_mutex_create_init(sg_p2p_session->cmutex);
+    memset(sg_p2p_ctx, 0, sizeof(P2P_CTX_T));
+
+    // Session slots are tracked in a bit mask while a frame is packetized
+    sg_p2p_ctx->session_num = p_var->max_client_num;
+    if (sg_p2p_ctx->session_num <= 0) {
+        sg_p2p_ctx->session_num = 1;
+    } else if (sg_p2p_ctx->session_num > TUYA_IPC_P2P_MAX_SESSION) {
+        sg_p2p_ctx->session_num = TUYA_IPC_P2P_MAX_SESSION;
+    }
+    sg_p2p_ctx->sessions = (P2P_SESSION_T *)Malloc(sg_p2p_ctx->session_num * sizeof(P2P_SESSION_T));
+    if (NULL == sg_p2p_ctx->sessions) {
+        PR_ERR("malloc p2p session failed");
+        ret = OPRT_MALLOC_FAILED;
+        goto RET;
+    }
+    memset(sg_p2p_ctx->sessions, 0, sg_p2p_ctx->session_num * sizeof(P2P_SESSION_T));
+    for (i = 0; i < sg_p2p_ctx->session_num; i++) {
+        sg_p2p_ctx->sessions[i].index = i;
+        sg_p2p_ctx->sessions[i].session = -1;
+        sg_p2p_ctx->sessions[i].cur_clarity = TY_VIDEO_CLARITY_INNER_HIGH;
+    }
+
+    if (OPRT_OK != (ret = tal_mutex_create_init(&sg_p2p_ctx->cmutex)) ||
+        OPRT_OK != (ret = tal_semaphore_create_init(&sg_p2p_ctx->cmd_sem, 0, 1)) ||
+        OPRT_OK != (ret = tal_semaphore_create_init(&sg_p2p_ctx->send_sem, 0, 1)) ||
+        OPRT_OK != (ret = tal_semaphore_create_init(&sg_p2p_ctx->pull_sem, 0, 1))) {
+        PR_ERR("create p2p mutex/semaphore failed");
+        goto RET;
+    }
+    if (OPRT_OK != (ret = tuya_ipc_p2p_rtp_create(10, P2P_FRAME_POOL_NUM, &sg_p2p_ctx->video_packer)) ||
+        OPRT_OK != (ret = tuya_ipc_p2p_rtp_create(11, P2P_FRAME_POOL_NUM, &sg_p2p_ctx->audio_packer))) {
+        PR_ERR("create rtp packer failed");
+        goto RET;
+    }
+
     // Get password and other verification information
-    memset(&(sg_p2p_session->str_P2p_auth), 0x00, sizeof(TUYA_IPC_P2P_AUTH_T));
-    tuya_ipc_get_p2p_auth(&(sg_p2p_session->str_P2p_auth));
+    memset(&(sg_p2p_ctx->str_P2p_auth), 0x00, sizeof(TUYA_IPC_P2P_AUTH_T));
+    tuya_ipc_get_p2p_auth(&(sg_p2p_ctx->str_P2p_auth));
     tuya_ipc_check_p2p_auth_update();
 
-    sg_p2p_session->cur_clarity = TY_VIDEO_CLARITY_INNER_HIGH;
+    sg_p2p_ctx->cur_clarity = TY_VIDEO_CLARITY_INNER_HIGH;
+
+    // Initialize
+    int bufSize = P2P_FRAME_MAX_LEN; // MAX_MEDIA_FRAME_SIZE
+    // memset(&sg_p2p_ctx->tal_video_frame, 0, sizeof(sg_p2p_ctx->tal_video_frame));
+    // sg_p2p_ctx->tal_video_frame.pbuf = (char*)malloc(bufSize);
+    // sg_p2p_ctx->tal_video_frame.buf_size = bufSize;
+
+    memset(&sg_p2p_ctx->media_frame, 0, sizeof(sg_p2p_ctx->media_frame));
+    sg_p2p_ctx->media_frame.data = (UCHAR_T *)malloc(bufSize);
+    sg_p2p_ctx->media_frame.size = bufSize;
+
+    bufSize = 1280;
+    // memset(&sg_p2p_ctx->tal_audio_frame, 0, sizeof(sg_p2p_ctx->tal_audio_frame));
+    // sg_p2p_ctx->tal_audio_frame.pbuf = (char*)malloc(bufSize);
+    // sg_p2p_ctx->tal_audio_frame.buf_size = bufSize;
+
+    memset(&sg_p2p_ctx->media_audio_frame, 0, sizeof(sg_p2p_ctx->media_audio_frame));
+    sg_p2p_ctx->media_audio_frame.data = (UCHAR_T *)malloc(bufSize);
+    sg_p2p_ctx->media_audio_frame.size = bufSize;
+
+    memcpy(&sg_p2p_ctx->av_Info, &p_var->av_info, sizeof(TRANS_IPC_AV_INFO_T));
+    sg_p2p_ctx->on_disconnect_callback = p_var->on_disconnect_callback;
+    sg_p2p_ctx->on_get_video_frame_callback = p_var->on_get_video_frame_callback;
+    sg_p2p_ctx->on_get_audio_frame_callback = p_var->on_get_audio_frame_callback;
 
     // Start media-related threads
     THREAD_CFG_T thrd_param = {STACK_SIZE_P2P_MEDIA_RECV, THREAD_PRIO_2, NULL};
     thrd_param.stackDepth = STACK_SIZE_P2P_CMD_RECV;
     thrd_param.thrdname = (char *)"p2p_cmd_recv";
-    ret = tal_thread_create_and_start(&(sg_p2p_session->cmd_recv_proc_thread), NULL, NULL, __p2p_cmd_recv_proc, NULL,
+    ret = tal_thread_create_and_start(&(sg_p2p_ctx->cmd_recv_proc_thread), NULL, NULL, __p2p_cmd_recv_proc, NULL,
                                       &thrd_param);
     if (ret != OPRT_OK) {
         PR_ERR("create p2p_cmd_recv task failed");
@@ -1552,47 +1674,26 @@ OPERATE_RET p2p_init(IN CONST TUYA_IPC_P2P_VAR_T *p_var)
     }
     thrd_param.stackDepth = STACK_SIZE_P2P_MEDIA_SEND;
     thrd_param.thrdname = (char *)"p2p_media_send";
-    ret = tal_thread_create_and_start(&(sg_p2p_session->video_send_proc_thread), NULL, NULL, __p2p_media_send_proc,
-                                      NULL, &thrd_param);
+    ret = tal_thread_create_and_start(&(sg_p2p_ctx->video_send_proc_thread), NULL, NULL, __p2p_media_send_proc, NULL,
+                                      &thrd_param);
     if (ret != OPRT_OK) {
         PR_ERR("create p2p_media_send task failed");
         goto RET;
     }
-
-    // Initialize
-    int bufSize = 300 * 1024; // MAX_MEDIA_FRAME_SIZE
-    // memset(&sg_p2p_session->tal_video_frame, 0, sizeof(sg_p2p_session->tal_video_frame));
-    // sg_p2p_session->tal_video_frame.pbuf = (char*)malloc(bufSize);
-    // sg_p2p_session->tal_video_frame.buf_size = bufSize;
-
-    memset(&sg_p2p_session->media_frame, 0, sizeof(sg_p2p_session->media_frame));
-    sg_p2p_session->media_frame.data = (UCHAR_T *)malloc(bufSize);
-    sg_p2p_session->media_frame.size = bufSize;
-
-    bufSize = 1280;
-    // memset(&sg_p2p_session->tal_audio_frame, 0, sizeof(sg_p2p_session->tal_audio_frame));
-    // sg_p2p_session->tal_audio_frame.pbuf = (char*)malloc(bufSize);
-    // sg_p2p_session->tal_audio_frame.buf_size = bufSize;
-
-    memset(&sg_p2p_session->media_audio_frame, 0, sizeof(sg_p2p_session->media_audio_frame));
-    sg_p2p_session->media_audio_frame.data = (UCHAR_T *)malloc(bufSize);
-    sg_p2p_session->media_audio_frame.size = bufSize;
-
-    memcpy(&sg_p2p_session->av_Info, &p_var->av_info, sizeof(TRANS_IPC_AV_INFO_T));
-    sg_p2p_session->on_disconnect_callback = p_var->on_disconnect_callback;
-    sg_p2p_session->on_get_video_frame_callback = p_var->on_get_video_frame_callback;
-    sg_p2p_session->on_get_audio_frame_callback = p_var->on_get_audio_frame_callback;
+    thrd_param.stackDepth = STACK_SIZE_P2P_MEDIA_PULL;
+    thrd_param.thrdname = (char *)"p2p_media_pull";
+    ret = tal_thread_create_and_start(&(sg_p2p_ctx->media_pull_proc_thread), NULL, NULL, __p2p_media_pull_proc, NULL,
+                                      &thrd_param);
+    if (ret != OPRT_OK) {
+        PR_ERR("create p2p_media_pull task failed");
+        goto RET;
+    }
 
     return OPRT_OK;
 
 RET:
-    if (NULL != sg_p2p_session->p_video_rtp_buff) {
-        p2p_release_video_send_resource(sg_p2p_session);
-    }
-    if (NULL != sg_p2p_session->p_audio_rtp_buff) {
-        p2p_release_audio_send_resource(sg_p2p_session);
-    }
-    __p2p_thread_exit(sg_p2p_session->cmd_recv_proc_thread);
+    __p2p_thread_exit(sg_p2p_ctx->cmd_recv_proc_thread);
+    __p2p_thread_exit(sg_p2p_ctx->video_send_proc_thread);
     return ret;
 }
 
@@ -1617,8 +1718,20 @@ OPERATE_RET tuya_imm_p2p_close(VOID)
 
 OPERATE_RET tuya_imm_p2p_alive_cnt()
 {
-    // return tuya_ipc_p2p_alive_cnt();
-    return 0;
+    INT_T i, cnt = 0;
+
+    if (NULL == sg_p2p_ctx) {
+        return 0;
+    }
+    tal_mutex_lock(sg_p2p_ctx->cmutex);
+    for (i = 0; i < sg_p2p_ctx->session_num; i++) {
+        if (P2P_SESSION_RUNNING == sg_p2p_ctx->sessions[i].status) {
+            cnt++;
+        }
+    }
+    tal_mutex_unlock(sg_p2p_ctx->cmutex);
+
+    return cnt;
 }
 
 OPERATE_RET tuya_imm_p2p_delete_video_finish(IN CONST CHAR_T *dev_id, IN CONST UINT_T client,
@@ -1692,34 +1805,6 @@ OPERATE_RET tuya_imm_p2p_album_play_send_finish(IN CONST CHAR_T *dev_id, IN CONS
     return 0;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////
-void *rtp_alloc(void *param, int bytes)
-{
-    int nBufferSize = bytes;
-    unsigned char *pBuffer = (unsigned char *)malloc(nBufferSize);
-    memset(pBuffer, 0, nBufferSize);
-    return pBuffer;
-}
-
-void rtp_free(void *param, void *packet)
-{
-    free(packet);
-    packet = NULL;
-    return;
-}
-
-int rtp_pack_packet_handler(void *param, const void *packet, int bytes, uint32_t timestamp, int flags)
-{
-    //return 0;
-    CHAR_T *buf = (CHAR_T *)packet;
-    INT_T len = bytes;
-    RTP_PACK_NAL_ARG_T *nal_arg = (RTP_PACK_NAL_ARG_T *)param;
-    memcpy(nal_arg->p_rtp_buff, nal_arg->ext_head_buff, nal_arg->fix_len);
-    *(INT_T *)&nal_arg->p_rtp_buff[nal_arg->fix_len - 4] = len;
-    memcpy(nal_arg->p_rtp_buff + nal_arg->fix_len, buf, len);
-    return p2p_send_rtp_data(nal_arg->client, nal_arg->channel, nal_arg->p_rtp_buff, len + nal_arg->fix_len);
-}
-
 ////////////////////////////////////////////////////////////////////////////////////////////
 
 INT_T OnGetVideoFrameCallback(MEDIA_FRAME *pMediaFrame)
@@ -0,0 +1,342 @@
+/**
+ * @file tuya_ipc_p2p_rtp.c
+ * @brief RTP packetizer of the p2p media channels
+ *
+ * The rtp encoder does not own packet buffers: its alloc callback hands out
+ * the space behind the extension header of the next packet in the frame, so
+ * every packet is serialized in place and the frame buffer is the only copy.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <stddef.h>
+#include <string.h>
+#include "tal_log.h"
+#include "tal_mutex.h"
+#include "tal_memory.h"
+#include "tuya_ipc_p2p_rtp.h"
+#include "rtp-payload.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define P2P_RTP_PKT_OVERHEAD (TUYA_IPC_P2P_RTP_EXT_MAX_LEN + 12 + 3) // ext head + rtp head + fu header
+#define P2P_RTP_PKT_EXTRA    (8)                                     // SPS/PPS/SEI and short NAL units
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    MUTEX_HANDLE mutex; // Encoder state and pool
+    VOID *encoder;      // rtp_payload_encode_create handle, kept across frames
+    INT_T payload;      // Payload type of the encoder, -1 before the first frame
+    USHORT_T seq;       // Next sequence number, carried over when the encoder is recreated
+    UINT_T ssrc;
+
+    /******* frame being packed *******/
+    TUYA_IPC_P2P_RTP_FRAME_T *frame;
+    CONST CHAR_T *ext_head;
+    OPERATE_RET ret;
+
+    /******* released frames *******/
+    UINT_T pool_num;
+    UINT_T pool_cnt;
+    TUYA_IPC_P2P_RTP_FRAME_T **pool;
+
+    TUYA_IPC_P2P_RTP_STAT_T stat;
+} P2P_RTP_PACKER_T;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+STATIC OPERATE_RET __p2p_rtp_frame_reserve(P2P_RTP_PACKER_T *packer, TUYA_IPC_P2P_RTP_FRAME_T *frame, UINT_T need)
+{
+    if (frame->len + need <= frame->size) {
+        return OPRT_OK;
+    }
+
+    UINT_T size = MAX(frame->size * 2, frame->len + need);
+    UCHAR_T *data = (UCHAR_T *)tal_realloc(frame->data, size);
+    if (NULL == data) {
+        return OPRT_MALLOC_FAILED;
+    }
+    frame->data = data;
+    frame->size = size;
+    packer->stat.allocs++;
+
+    return OPRT_OK;
+}
+
+// rtp_payload_t.alloc: the packet is serialized right behind its extension header
+STATIC void *__p2p_rtp_alloc(void *param, int bytes)
+{
+    P2P_RTP_PACKER_T *packer = (P2P_RTP_PACKER_T *)param;
+    TUYA_IPC_P2P_RTP_FRAME_T *frame = packer->frame;
+
+    if (OPRT_OK != __p2p_rtp_frame_reserve(packer, frame, frame->fix_len + bytes)) {
+        packer->ret = OPRT_MALLOC_FAILED;
+        return NULL;
+    }
+
+    return frame->data + frame->len + frame->fix_len;
+}
+
+STATIC void __p2p_rtp_free(void *param, void *packet)
+{
+    // Packets live in the frame buffer
+    return;
+}
+
+// rtp_payload_t.packet: close the packet with its extension header
+STATIC int __p2p_rtp_packet(void *param, const void *packet, int bytes, uint32_t timestamp, int flags)
+{
+    P2P_RTP_PACKER_T *packer = (P2P_RTP_PACKER_T *)param;
+    TUYA_IPC_P2P_RTP_FRAME_T *frame = packer->frame;
+    UCHAR_T *p = frame->data + frame->len;
+
+    if (packet != p + frame->fix_len) {
+        PR_ERR("rtp packet not in frame");
+        packer->ret = OPRT_COM_ERROR;
+        return -1;
+    }
+
+    memcpy(p, packer->ext_head, frame->fix_len - sizeof(INT_T));
+    memcpy(p + frame->fix_len - sizeof(INT_T), &bytes, sizeof(INT_T));
+    frame->len += frame->fix_len + bytes;
+    frame->pkt_num++;
+
+    return 0;
+}
+
+STATIC OPERATE_RET __p2p_rtp_encoder_init(P2P_RTP_PACKER_T *packer, INT_T payload, CONST CHAR_T *codec_name)
+{
+    struct rtp_payload_t handler;
+    uint32_t timestamp = 0;
+
+    if (NULL != packer->encoder) {
+        rtp_payload_encode_getinfo(packer->encoder, &packer->seq, &timestamp);
+        rtp_payload_encode_destroy(packer->encoder);
+        packer->encoder = NULL;
+        packer->payload = -1;
+    }
+
+    handler.alloc = __p2p_rtp_alloc;
+    handler.free = __p2p_rtp_free;
+    handler.packet = __p2p_rtp_packet;
+    packer->encoder =
+        rtp_payload_encode_create(payload, codec_name, packer->seq, packer->ssrc, &handler, (VOID *)packer);
+    if (NULL == packer->encoder) {
+        PR_ERR("rtp_payload_encode_create %s failed", codec_name);
+        return OPRT_MALLOC_FAILED;
+    }
+    packer->payload = payload;
+    packer->stat.encoder_init++;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ipc_p2p_rtp_create(IN UINT_T ssrc, IN UINT_T pool_num, OUT TUYA_IPC_P2P_RTP_HANDLE *p_handle)
+{
+    OPERATE_RET ret = OPRT_OK;
+
+    if (NULL == p_handle) {
+        return OPRT_INVALID_PARM;
+    }
+
+    P2P_RTP_PACKER_T *packer = (P2P_RTP_PACKER_T *)Malloc(sizeof(P2P_RTP_PACKER_T));
+    if (NULL == packer) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(packer, 0x00, sizeof(P2P_RTP_PACKER_T));
+    packer->payload = -1;
+    packer->ssrc = ssrc;
+    packer->pool_num = pool_num;
+    if (pool_num > 0) {
+        packer->pool = (TUYA_IPC_P2P_RTP_FRAME_T **)Malloc(pool_num * sizeof(TUYA_IPC_P2P_RTP_FRAME_T *));
+        if (NULL == packer->pool) {
+            Free(packer);
+            return OPRT_MALLOC_FAILED;
+        }
+    }
+    ret = tal_mutex_create_init(&packer->mutex);
+    if (OPRT_OK != ret) {
+        Free(packer->pool);
+        Free(packer);
+        return ret;
+    }
+
+    *p_handle = packer;
+
+    return OPRT_OK;
+}
+
+VOID tuya_ipc_p2p_rtp_destroy(IN TUYA_IPC_P2P_RTP_HANDLE handle)
+{
+    P2P_RTP_PACKER_T *packer = (P2P_RTP_PACKER_T *)handle;
+
+    if (NULL == packer) {
+        return;
+    }
+    if (NULL != packer->encoder) {
+        rtp_payload_encode_destroy(packer->encoder);
+    }
+    while (packer->pool_cnt > 0) {
+        TUYA_IPC_P2P_RTP_FRAME_T *frame = packer->pool[--packer->pool_cnt];
+        Free(frame->data);
+        Free(frame);
+    }
+    Free(packer->pool);
+    tal_mutex_release(packer->mutex);
+    Free(packer);
+
+    return;
+}
+
+TUYA_IPC_P2P_RTP_FRAME_T *tuya_ipc_p2p_rtp_frame_alloc(IN TUYA_IPC_P2P_RTP_HANDLE handle, IN UINT_T media_len)
+{
+    P2P_RTP_PACKER_T *packer = (P2P_RTP_PACKER_T *)handle;
+    TUYA_IPC_P2P_RTP_FRAME_T *frame = NULL;
+    UCHAR_T *data = NULL;
+
+    if (NULL == packer) {
+        return NULL;
+    }
+
+    // One packet per rtp payload plus a few extra NAL units, grown while packing if needed
+    UINT_T pkt_cnt = media_len / (rtp_packet_getsize() - P2P_RTP_PKT_OVERHEAD) + P2P_RTP_PKT_EXTRA;
+    UINT_T size = media_len + pkt_cnt * P2P_RTP_PKT_OVERHEAD;
+
+    tal_mutex_lock(packer->mutex);
+    if (packer->pool_cnt > 0) {
+        frame = packer->pool[--packer->pool_cnt];
+        packer->stat.pool_hits++;
+    } else {
+        frame = (TUYA_IPC_P2P_RTP_FRAME_T *)Malloc(sizeof(TUYA_IPC_P2P_RTP_FRAME_T));
+        if (NULL == frame) {
+            tal_mutex_unlock(packer->mutex);
+            return NULL;
+        }
+        memset(frame, 0x00, sizeof(TUYA_IPC_P2P_RTP_FRAME_T));
+        packer->stat.allocs++;
+    }
+    if (frame->size < size) {
+        // Pooled buffers only grow, so the pool settles at the largest frames of the stream
+        data = (UCHAR_T *)tal_realloc(frame->data, size);
+        if (NULL == data) {
+            tal_mutex_unlock(packer->mutex);
+            Free(frame->data);
+            Free(frame);
+            return NULL;
+        }
+        frame->data = data;
+        frame->size = size;
+        packer->stat.allocs++;
+    }
+    tal_mutex_unlock(packer->mutex);
+
+    frame->ref = 0;
+    frame->channel = 0;
+    frame->key_frame = FALSE;
+    frame->media_len = media_len;
+    frame->fix_len = 0;
+    frame->pkt_num = 0;
+    frame->len = 0;
+    frame->packer = packer;
+
+    return frame;
+}
+
+VOID tuya_ipc_p2p_rtp_frame_free(IN TUYA_IPC_P2P_RTP_FRAME_T *frame)
+{
+    if (NULL == frame) {
+        return;
+    }
+
+    P2P_RTP_PACKER_T *packer = (P2P_RTP_PACKER_T *)frame->packer;
+    tal_mutex_lock(packer->mutex);
+    if (packer->pool_cnt < packer->pool_num) {
+        packer->pool[packer->pool_cnt++] = frame;
+        frame = NULL;
+    }
+    tal_mutex_unlock(packer->mutex);
+
+    if (NULL != frame) {
+        Free(frame->data);
+        Free(frame);
+    }
+
+    return;
+}
+
+OPERATE_RET tuya_ipc_p2p_rtp_pack(IN TUYA_IPC_P2P_RTP_HANDLE handle, IN INT_T payload, IN CONST CHAR_T *codec_name,
+                                  IN CONST CHAR_T *ext_head, IN UINT_T fix_len, IN CONST UCHAR_T *data, IN UINT_T len,
+                                  IN UINT_T timestamp, INOUT TUYA_IPC_P2P_RTP_FRAME_T *frame)
+{
+    OPERATE_RET ret = OPRT_OK;
+    P2P_RTP_PACKER_T *packer = (P2P_RTP_PACKER_T *)handle;
+
+    if (NULL == packer || NULL == codec_name || NULL == ext_head || NULL == data || NULL == frame ||
+        fix_len < sizeof(INT_T) || fix_len > TUYA_IPC_P2P_RTP_EXT_MAX_LEN) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(packer->mutex);
+    if (payload != packer->payload) {
+        ret = __p2p_rtp_encoder_init(packer, payload, codec_name);
+        if (OPRT_OK != ret) {
+            tal_mutex_unlock(packer->mutex);
+            return ret;
+        }
+    }
+
+    frame->fix_len = fix_len;
+    packer->frame = frame;
+    packer->ext_head = ext_head;
+    packer->ret = OPRT_OK;
+    ret = rtp_payload_encode_input(packer->encoder, data, len, timestamp);
+    if (OPRT_OK != ret) {
+        PR_ERR("rtp_payload_encode_input %s error:%d", codec_name, ret);
+        if (OPRT_OK != packer->ret) {
+            ret = packer->ret;
+        }
+    } else {
+        packer->stat.frames++;
+        packer->stat.packets += frame->pkt_num;
+        packer->stat.bytes += frame->len;
+    }
+    packer->frame = NULL;
+    packer->ext_head = NULL;
+    tal_mutex_unlock(packer->mutex);
+
+    return ret;
+}
+
+VOID tuya_ipc_p2p_rtp_set_request_id(INOUT TUYA_IPC_P2P_RTP_FRAME_T *frame, IN UINT_T request_id)
+{
+    UCHAR_T *p = frame->data;
+    UINT_T i = 0;
+    INT_T rtp_len = 0;
+
+    for (i = 0; i < frame->pkt_num; i++) {
+        memcpy(p + offsetof(C2C_AV_TRANS_FIXED_HEADER, request_id), &request_id, sizeof(request_id));
+        memcpy(&rtp_len, p + frame->fix_len - sizeof(INT_T), sizeof(INT_T));
+        p += frame->fix_len + rtp_len;
+    }
+
+    return;
+}
+
+OPERATE_RET tuya_ipc_p2p_rtp_get_stat(IN TUYA_IPC_P2P_RTP_HANDLE handle, OUT TUYA_IPC_P2P_RTP_STAT_T *p_stat)
+{
+    P2P_RTP_PACKER_T *packer = (P2P_RTP_PACKER_T *)handle;
+
+    if (NULL == packer || NULL == p_stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(packer->mutex);
+    memcpy(p_stat, &packer->stat, sizeof(TUYA_IPC_P2P_RTP_STAT_T));
+    tal_mutex_unlock(packer->mutex);
+
+    return OPRT_OK;
+}
@@ -0,0 +1,278 @@
+#!/usr/bin/env python3
+"""
+Delta OTA patch tool
+Makes the patches applied by src/tuya_cloud_service/cloud/tuya_ota_delta.c
+
+The new image is matched against the old one in the way of bsdiff: exact
+matches of at least MATCH_MIN bytes anchor a region, which is then extended as
+long as more than half of its bytes are equal. Such a region is stored as the
+bytewise difference to the old image, mostly zeros that are run-length coded,
+so code that only moved or whose addresses shifted costs a few bytes. Bytes no
+region covers are stored as they are.
+
+Usage:
+    ota_delta.py diff old.bin new.bin patch.bin
+    ota_delta.py apply old.bin patch.bin new.bin
+    ota_delta.py info patch.bin
+"""
+
+import sys
+import struct
+import hashlib
+import argparse
+
+MAGIC = b"TYDP"
+VERSION = 1
+HEADER = struct.Struct("<4sB3xII32s32s")
+
+OP_END = 0
+OP_ADD = 1
+OP_DATA = 2
+
+KEY_LEN = 12        # bytes hashed to find anchors
+KEY_STEP = 4        # old positions indexed, every KEY_STEP bytes
+KEY_CANDIDATES = 8  # old positions kept per key
+MATCH_MIN = 16      # shortest exact match taken as anchor
+ADD_MIN = 8         # shortest region stored as difference
+EXTEND_SLACK = 64   # bytes scanned past the best end of a region
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value - 1) << 1) | 1
+
+
+class Differ:
+    def __init__(self, old, new):
+        self.old = old
+        self.new = new
+        self.index = {}
+        for i in range(0, len(old) - KEY_LEN + 1, KEY_STEP):
+            cands = self.index.setdefault(old[i:i + KEY_LEN], [])
+            if len(cands) < KEY_CANDIDATES:
+                cands.append(i)
+
+    def match_len(self, p, q):
+        old, new = self.old, self.new
+        n = 0
+        limit = min(len(new) - p, len(old) - q)
+        while n + 32 <= limit and new[p + n:p + n + 32] == old[q + n:q + n + 32]:
+            n += 32
+        while n < limit and new[p + n] == old[q + n]:
+            n += 1
+        return n
+
+    def anchor(self, p):
+        """the old position of the longest exact match of new[p:], or None"""
+        best, best_len = None, MATCH_MIN - 1
+        for base in range(KEY_STEP):
+            if p + base + KEY_LEN > len(self.new):
+                break
+            for q in self.index.get(self.new[p + base:p + base + KEY_LEN], ()):
+                q -= base
+                if q < 0:
+                    continue
+                n = self.match_len(p, q)
+                if n > best_len:
+                    best, best_len = q, n
+            if best is not None:
+                break
+        return best
+
+    def extend(self, p, q, step, limit):
+        """length of the region from (p, q) in direction step where more than half of the bytes are equal"""
+        old, new = self.old, self.new
+        equal = score = best = i = 0
+        while i < limit:
+            a, b = p + step * i, q + step * i
+            if a < 0 or b < 0 or a >= len(new) or b >= len(old):
+                break
+            if new[a] == old[b]:
+                equal += 1
+            i += 1
+            if 2 * equal - i > score:
+                score, best = 2 * equal - i, i
+            elif i - best > EXTEND_SLACK:
+                break
+        return best
+
+    def diff(self):
+        new = self.new
+        ops = []
+        p = data_start = 0
+        old_pos = 0  # old position the next region is sought from
+        shift = 0    # old minus new position of the last region
+        while p < len(new):
+            if p == data_start:
+                n = self.extend(p, p + shift, 1, len(new) - p)
+                if n >= ADD_MIN:
+                    ops.append((OP_ADD, p, p + shift, n))
+                    p += n
+                    data_start = p
+                    continue
+            q = self.anchor(p)
+            if q is None:
+                p += 1
+                continue
+            shift = q - p
+            back = self.extend(p - 1, q - 1, -1, p - data_start)
+            p -= back
+            if p > data_start:
+                ops.append((OP_DATA, data_start, 0, p - data_start))
+            data_start = p
+        if p > data_start:
+            ops.append((OP_DATA, data_start, 0, p - data_start))
+        return ops
+
+    def encode(self, ops):
+        old, new = self.old, self.new
+        out = bytearray()
+        old_pos = 0
+        for op, p, q, n in ops:
+            if op == OP_DATA:
+                out += bytes([OP_DATA]) + varint(n) + new[p:p + n]
+                continue
+            out += bytes([OP_ADD]) + varint(n) + varint(zigzag(q - old_pos))
+            i = 0
+            while i < n:
+                z = i
+                while z < n and new[p + z] == old[q + z]:
+                    z += 1
+                lit = z
+                # a zero run shorter than 3 costs more as two varints than as literals
+                while lit < n:
+                    if new[p + lit] == old[q + lit]:
+                        run = lit
+                        while run < n and run - lit < 3 and new[p + run] == old[q + run]:
+                            run += 1
+                        if run - lit >= 3 or run == n:
+                            break
+                        lit = run
+                    else:
+                        lit += 1
+                out += varint(z - i)
+                if lit > z:
+                    out += varint(lit - z)
+                    out += bytes((new[p + k] - old[q + k]) & 0xFF for k in range(z, lit))
+                elif z < n:
+                    raise AssertionError("empty literal run")
+                i = lit
+            old_pos = q + n
+        out.append(OP_END)
+        return bytes(out)
+
+
+def make_patch(old, new):
+    differ = Differ(old, new)
+    body = differ.encode(differ.diff())
+    header = HEADER.pack(MAGIC, VERSION, len(old), len(new), hashlib.sha256(old).digest(),
+                         hashlib.sha256(new).digest())
+    return header + body
+
+
+def read_varint(patch, pos):
+    value = shift = 0
+    while True:
+        byte = patch[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def apply_patch(old, patch):
+    magic, version, old_size, new_size, old_sha, new_sha = HEADER.unpack_from(patch)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a delta patch")
+    if old_size != len(old) or hashlib.sha256(old).digest() != old_sha:
+        raise ValueError("patch is not for this old image")
+    new = bytearray()
+    pos = HEADER.size
+    old_pos = 0
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        n, pos = read_varint(patch, pos)
+        if op == OP_DATA:
+            new += patch[pos:pos + n]
+            pos += n
+            continue
+        if op != OP_ADD:
+            raise ValueError("bad operation %d at %d" % (op, pos - 1))
+        seek, pos = read_varint(patch, pos)
+        old_pos += (seek >> 1) if not seek & 1 else -((seek >> 1) + 1)
+        end = len(new) + n
+        while len(new) < end:
+            z, pos = read_varint(patch, pos)
+            new += old[old_pos:old_pos + z]
+            old_pos += z
+            if len(new) == end:
+                break
+            lit, pos = read_varint(patch, pos)
+            new += bytes((patch[pos + k] + old[old_pos + k]) & 0xFF for k in range(lit))
+            pos += lit
+            old_pos += lit
+    if len(new) != new_size or hashlib.sha256(new).digest() != new_sha:
+        raise ValueError("new image mismatch")
+    return bytes(new)
+
+
+def read_file(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def write_file(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Delta OTA patch tool")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    p_diff = sub.add_parser("diff", help="make a patch from old to new")
+    p_diff.add_argument("old")
+    p_diff.add_argument("new")
+    p_diff.add_argument("patch")
+    p_apply = sub.add_parser("apply", help="apply a patch to old")
+    p_apply.add_argument("old")
+    p_apply.add_argument("patch")
+    p_apply.add_argument("new")
+    p_info = sub.add_parser("info", help="print the header of a patch")
+    p_info.add_argument("patch")
+    args = parser.parse_args()
+
+    if args.cmd == "diff":
+        old, new = read_file(args.old), read_file(args.new)
+        patch = make_patch(old, new)
+        # the tool checks its own output before it is uploaded
+        apply_patch(old, patch)
+        write_file(args.patch, patch)
+        print("old %d B, new %d B, patch %d B (%.1f%% of new)" %
+              (len(old), len(new), len(patch), 100.0 * len(patch) / max(len(new), 1)))
+    elif args.cmd == "apply":
+        write_file(args.new, apply_patch(read_file(args.old), read_file(args.patch)))
+    else:
+        magic, version, old_size, new_size, old_sha, new_sha = HEADER.unpack_from(read_file(args.patch))
+        print("magic %s version %d" % (magic.decode(errors="replace"), version))
+        print("old %d B sha256 %s" % (old_size, old_sha.hex()))
+        print("new %d B sha256 %s" % (new_size, new_sha.hex()))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())